@@ -1,64 +1,322 @@
 #include <string.h>
-#include <sys/stat.h>
+#include <unicode/uchar.h>
+#include <unicode/utf16.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
-#include <utils/Log.h>
-
 #include "minikin/Hyphenator.h"
+#include "minikin/Utf8Text.h"
 
 using minikin::HyphenationType;
 using minikin::Hyphenator;
+using minikin::U16StringPiece;
+using minikin::Utf8Text;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Word = std::vector<uint16_t>;
+
+struct Language {
+    std::string locale;
+    std::string path;
+    const Hyphenator* hyphenator = nullptr;
+};
 
-Hyphenator* loadHybFile(const char* fn, int minPrefix, int minSuffix, const char* language) {
-    struct stat statbuf;
-    int status = stat(fn, &statbuf);
-    if (status < 0) {
-        fprintf(stderr, "error opening %s\n", fn);
-        return nullptr;
-    }
-    size_t size = statbuf.st_size;
-    FILE* f = fopen(fn, "rb");
-    if (f == NULL) {
-        fprintf(stderr, "error opening %s\n", fn);
-        return nullptr;
-    }
-    uint8_t* buf = new uint8_t[size];
-    size_t read_size = fread(buf, 1, size, f);
-    fclose(f);
-    if (read_size < size) {
-        fprintf(stderr, "error reading %s\n", fn);
-        delete[] buf;
-        return nullptr;
-    }
-    return Hyphenator::loadBinary(buf, minPrefix, minSuffix, language);
+struct Options {
+    std::vector<Language> languages;
+    size_t minPrefix = 2;
+    size_t minSuffix = 3;
+    bool mmap = true;
+    const char* corpusPath = nullptr;
+    uint32_t threads = 1;
+    uint32_t iterations = 1;
+    std::vector<const char*> words;
+};
+
+void printUsage() {
+    fprintf(stderr,
+            "usage: hyphtool [options] [word...]\n"
+            "  --hyb LOCALE=PATH   the hyb file of a locale, may be repeated\n"
+            "                      (default en=/tmp/en.hyb)\n"
+            "  --min-prefix N      the minimum number of letters before a break (default 2)\n"
+            "  --min-suffix N      the minimum number of letters after a break (default 3)\n"
+            "  --no-mmap           read the hyb files into memory instead of mapping them\n"
+            "  --corpus PATH       benchmark the words of the UTF-8 text file instead of printing\n"
+            "                      the hyphenation of the words given as arguments\n"
+            "  --threads N         the number of threads hyphenating the corpus (default 1)\n"
+            "  --iterations N      the number of passes of each thread over the corpus\n"
+            "                      (default 1)\n"
+            "A '-' in a word given as argument is a soft hyphen.\n");
 }
 
-int main(int argc, char** argv) {
-    Hyphenator* hyph = loadHybFile("/tmp/en.hyb", 2, 3, "en");  // should also be configurable
+bool parseNumber(const char* str, uint32_t* out) {
+    char* end;
+    const unsigned long value = strtoul(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || value > UINT32_MAX) {
+        fprintf(stderr, "not a number: %s\n", str);
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options* out) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || arg[1] != '-') {
+            out->words.push_back(arg);
+            continue;
+        }
+        if (strcmp(arg, "--no-mmap") == 0) {
+            out->mmap = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value of %s\n", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+        uint32_t number = 0;
+        if (strcmp(arg, "--hyb") == 0) {
+            const char* separator = strchr(value, '=');
+            if (separator == nullptr || separator == value || separator[1] == '\0') {
+                fprintf(stderr, "expected LOCALE=PATH: %s\n", value);
+                return false;
+            }
+            Language language;
+            language.locale.assign(value, separator);
+            language.path = separator + 1;
+            out->languages.push_back(std::move(language));
+        } else if (strcmp(arg, "--corpus") == 0) {
+            out->corpusPath = value;
+        } else if (strcmp(arg, "--min-prefix") == 0) {
+            if (!parseNumber(value, &number)) {
+                return false;
+            }
+            out->minPrefix = number;
+        } else if (strcmp(arg, "--min-suffix") == 0) {
+            if (!parseNumber(value, &number)) {
+                return false;
+            }
+            out->minSuffix = number;
+        } else if (strcmp(arg, "--threads") == 0 || strcmp(arg, "--iterations") == 0) {
+            if (!parseNumber(value, &number) || number == 0) {
+                fprintf(stderr, "%s must be positive\n", arg);
+                return false;
+            }
+            if (strcmp(arg, "--threads") == 0) {
+                out->threads = number;
+            } else {
+                out->iterations = number;
+            }
+        } else {
+            fprintf(stderr, "unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    if (out->languages.empty()) {
+        out->languages.push_back({"en", "/tmp/en.hyb"});
+    }
+    if (out->corpusPath == nullptr && out->words.empty()) {
+        fprintf(stderr, "no words to hyphenate\n");
+        return false;
+    }
+    return true;
+}
+
+bool readFile(const char* path, std::vector<uint8_t>* out) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t readSize;
+    while ((readSize = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        out->insert(out->end(), chunk, chunk + readSize);
+    }
+    const bool failed = ferror(fp);
+    fclose(fp);
+    return !failed;
+}
+
+// Loads the hyb file of the language and prints how long it took and the memory it uses.
+bool load(const Options& options, Language* language) {
+    const Clock::time_point start = Clock::now();
+    if (options.mmap) {
+        language->hyphenator = Hyphenator::loadFromFile(language->path, options.minPrefix,
+                                                        options.minSuffix, language->locale);
+    } else {
+        // The data must outlive the hyphenator, which lives until the tool exits.
+        std::vector<uint8_t>* data = new std::vector<uint8_t>();
+        if (readFile(language->path.c_str(), data) &&
+            Hyphenator::isValidBinary(data->data(), data->size())) {
+            language->hyphenator = Hyphenator::loadBinary(data->data(), options.minPrefix,
+                                                          options.minSuffix, language->locale);
+        }
+    }
+    const double loadUs =
+            std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    if (language->hyphenator == nullptr) {
+        fprintf(stderr, "error loading %s\n", language->path.c_str());
+        return false;
+    }
+    fprintf(stderr, "%s: loaded %s in %.1f us, patterns=%zu bytes tables=%zu bytes\n",
+            language->locale.c_str(), language->path.c_str(), loadUs,
+            language->hyphenator->getPatternDataSize(), language->hyphenator->getMemoryUsage());
+    return true;
+}
+
+// Returns true if the code point belongs to a word the line breakers would hyphenate.
+bool isWordChar(UChar32 c) {
+    return c == 0x00AD || u_hasBinaryProperty(c, UCHAR_ALPHABETIC) ||
+           (U_GET_GC_MASK(c) & U_GC_M_MASK) != 0;
+}
+
+// Splits the text into the runs of isWordChar characters.
+std::vector<Word> splitWords(const U16StringPiece& text) {
+    std::vector<Word> words;
+    uint32_t wordStart = 0;
+    uint32_t i = 0;
+    while (i < text.size()) {
+        const uint32_t charStart = i;
+        UChar32 c;
+        U16_NEXT(text.data(), i, text.size(), c);
+        if (!isWordChar(c)) {
+            if (wordStart < charStart) {
+                words.emplace_back(text.data() + wordStart, text.data() + charStart);
+            }
+            wordStart = i;
+        }
+    }
+    if (wordStart < text.size()) {
+        words.emplace_back(text.data() + wordStart, text.data() + text.size());
+    }
+    return words;
+}
+
+void appendUtf8(UChar32 c, std::string* out) {
+    if (c < 0x80) {
+        out->push_back(c);
+    } else if (c < 0x800) {
+        out->push_back(0xC0 | (c >> 6));
+        out->push_back(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out->push_back(0xE0 | (c >> 12));
+        out->push_back(0x80 | ((c >> 6) & 0x3F));
+        out->push_back(0x80 | (c & 0x3F));
+    } else {
+        out->push_back(0xF0 | (c >> 18));
+        out->push_back(0x80 | ((c >> 12) & 0x3F));
+        out->push_back(0x80 | ((c >> 6) & 0x3F));
+        out->push_back(0x80 | (c & 0x3F));
+    }
+}
+
+// Prints the word with a '-' at each hyphenation point.
+void printHyphenation(const Language& language, const Word& word) {
     std::vector<HyphenationType> result;
-    std::vector<uint16_t> word;
-    if (argc < 2) {
-        fprintf(stderr, "usage: hyphtool word\n");
+    language.hyphenator->hyphenate(word, &result);
+    std::string out;
+    uint32_t i = 0;
+    while (i < word.size()) {
+        if (result[i] != HyphenationType::DONT_BREAK) {
+            out.push_back('-');
+        }
+        UChar32 c;
+        U16_NEXT(word.data(), i, word.size(), c);
+        if (c != 0x00AD) {
+            appendUtf8(c, &out);
+        }
+    }
+    printf("%s: %s\n", language.locale.c_str(), out.c_str());
+}
+
+// Hyphenates the words options.iterations times on each of options.threads threads and prints the
+// throughput and the latency percentiles of a word.
+void benchmark(const Language& language, const std::vector<Word>& words, const Options& options) {
+    std::vector<std::vector<uint32_t>> latencies(options.threads);
+    std::vector<std::thread> threads;
+    const Clock::time_point start = Clock::now();
+    for (uint32_t t = 0; t < options.threads; t++) {
+        threads.emplace_back([&language, &words, &options, out = &latencies[t]]() {
+            out->reserve(words.size() * options.iterations);
+            std::vector<HyphenationType> result;
+            for (uint32_t iteration = 0; iteration < options.iterations; iteration++) {
+                for (const Word& word : words) {
+                    const Clock::time_point wordStart = Clock::now();
+                    language.hyphenator->hyphenate(word, &result);
+                    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - wordStart);
+                    out->push_back(std::min<int64_t>(ns.count(), UINT32_MAX));
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint32_t> all;
+    for (const std::vector<uint32_t>& threadLatencies : latencies) {
+        all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](size_t p) {
+        return all[std::min(all.size() - 1, all.size() * p / 100)];
+    };
+    printf("%s: %zu words x %u iterations on %u threads in %.3f s, %.0f words/s, "
+           "latency p50=%u ns p90=%u ns p99=%u ns max=%u ns\n",
+           language.locale.c_str(), words.size(), options.iterations, options.threads, seconds,
+           all.size() / seconds, percentile(50), percentile(90), percentile(99), all.back());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage();
         return 1;
     }
-    char* asciiword = argv[1];
-    size_t len = strlen(asciiword);
-    for (size_t i = 0; i < len; i++) {
-        uint32_t c = asciiword[i];
-        if (c == '-') {
-            c = 0x00AD;
+    for (Language& language : options.languages) {
+        if (!load(options, &language)) {
+            return 1;
         }
-        // ASCII (or possibly ISO Latin 1), but kinda painful to do utf conversion :(
-        word.push_back(c);
     }
-    hyph->hyphenate(word, &result);
-    for (size_t i = 0; i < len; i++) {
-        if (result[i] != HyphenationType::DONT_BREAK) {
-            printf("-");
+
+    if (options.corpusPath == nullptr) {
+        for (const char* arg : options.words) {
+            const Utf8Text text(arg, strlen(arg));
+            Word word(text.utf16().data(), text.utf16().data() + text.utf16().size());
+            std::replace(word.begin(), word.end(), uint16_t('-'), uint16_t(0x00AD));
+            for (const Language& language : options.languages) {
+                printHyphenation(language, word);
+            }
         }
-        printf("%c", word[i]);
+        return 0;
+    }
+
+    std::vector<uint8_t> corpus;
+    if (!readFile(options.corpusPath, &corpus)) {
+        fprintf(stderr, "error reading %s\n", options.corpusPath);
+        return 1;
+    }
+    const Utf8Text text(reinterpret_cast<const char*>(corpus.data()), corpus.size());
+    const std::vector<Word> words = splitWords(text.utf16());
+    if (words.empty()) {
+        fprintf(stderr, "no words in %s\n", options.corpusPath);
+        return 1;
+    }
+    for (const Language& language : options.languages) {
+        benchmark(language, words, options);
     }
-    printf("\n");
     return 0;
 }
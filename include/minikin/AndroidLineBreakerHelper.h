@@ -18,12 +18,53 @@
 #define MINIKIN_ANDROID_LINE_BREAKER_HELPERS_H
 
 #include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
 
 #include "minikin/LineBreaker.h"
 
 namespace minikin {
 namespace android {
 
+// The indents of the lines of a StaticLayout, with a sparse table of their maximums, so that the
+// largest indent of any range of lines is found in constant time.
+class LineIndents {
+public:
+    explicit LineIndents(std::vector<float>&& indents) : mIndents(std::move(indents)) {
+        // Level k holds the maximums of the ranges of 2^k indents, level 0 being the indents.
+        for (size_t length = 2; length <= mIndents.size(); length *= 2) {
+            const size_t count = mIndents.size() - length + 1;
+            const float* prev = mLevels.empty() ? mIndents.data() : &mLevels.back()[0];
+            std::vector<float> level(count);
+            for (size_t i = 0; i < count; ++i) {
+                level[i] = std::max(prev[i], prev[i + length / 2]);
+            }
+            mLevels.push_back(std::move(level));
+        }
+    }
+
+    const std::vector<float>& values() const { return mIndents; }
+
+    // Returns the largest indent of [start, end), which must not be empty.
+    float getMax(size_t start, size_t end) const {
+        const size_t length = end - start;
+        uint32_t level = 0;
+        while ((size_t(2) << level) <= length) {
+            level++;
+        }
+        if (level == 0) {
+            return mIndents[start];
+        }
+        const std::vector<float>& maximums = mLevels[level - 1];
+        return std::max(maximums[start], maximums[end - (size_t(1) << level)]);
+    }
+
+private:
+    const std::vector<float> mIndents;
+    std::vector<std::vector<float>> mLevels;
+};
+
 class AndroidLineWidth : public LineWidth {
 public:
     AndroidLineWidth(float firstWidth, int32_t firstLineCount, float restWidth,
@@ -32,6 +73,18 @@ public:
               mFirstLineCount(firstLineCount),
               mRestWidth(restWidth),
               mIndents(indents),
+              mIndentTable(nullptr),
+              mOffset(indentsOffset) {}
+
+    // Same as above, but getMin() looks the largest indents up in the table instead of scanning
+    // all of them, which matters when a layout wraps around images with thousands of indents.
+    AndroidLineWidth(float firstWidth, int32_t firstLineCount, float restWidth,
+                     const LineIndents& indents, int32_t indentsOffset)
+            : mFirstWidth(firstWidth),
+              mFirstLineCount(firstLineCount),
+              mRestWidth(restWidth),
+              mIndents(indents.values()),
+              mIndentTable(&indents),
               mOffset(indentsOffset) {}
 
     float getAt(size_t lineNo) const override {
@@ -45,6 +98,9 @@ public:
         // when mFirstLineCount is large. Instead, we measure the first line, all the lines that
         // have an indent, and the first line after firstWidth ends and restWidth starts.
         float minWidth = std::min(getAt(0), getAt(mFirstLineCount));
+        if (mIndentTable != nullptr) {
+            return std::min(minWidth, getMinIndentedWidth());
+        }
         for (size_t lineNo = 1; lineNo + mOffset < mIndents.size(); lineNo++) {
             minWidth = std::min(minWidth, getAt(lineNo));
         }
@@ -52,6 +108,25 @@ public:
     }
 
 private:
+    // Returns the smallest width of the lines from 1 which have an indent, or infinity if there
+    // are none. The widths of the lines are the same before mFirstLineCount and after it, so the
+    // smallest one of each part is its width minus its largest indent.
+    float getMinIndentedWidth() const {
+        float minWidth = std::numeric_limits<float>::infinity();
+        const size_t end = mIndents.size();
+        const size_t start = 1 + mOffset;
+        const size_t restStart = std::max<ssize_t>(start, (ssize_t)mFirstLineCount + mOffset);
+        const size_t firstEnd = std::min(restStart, end);
+        if (start < firstEnd) {
+            minWidth = std::max(0.0f, mFirstWidth - mIndentTable->getMax(start, firstEnd));
+        }
+        if (restStart < end) {
+            minWidth = std::min(minWidth,
+                                std::max(0.0f, mRestWidth - mIndentTable->getMax(restStart, end)));
+        }
+        return minWidth;
+    }
+
     float get(const std::vector<float>& vec, size_t lineNo) const {
         if (vec.empty()) {
             return 0;
@@ -68,6 +143,7 @@ private:
     const int32_t mFirstLineCount;
     const float mRestWidth;
     const std::vector<float>& mIndents;
+    const LineIndents* mIndentTable;  // Not owned. May be null.
     const int32_t mOffset;
 };
 
@@ -93,6 +169,40 @@ public:
                               TabStops(tabStops, tabStopSize, defaultTabStopWidth));
     }
 
+    // Same as above, but writes the result to out and reuses the memory of the previous calls.
+    // The extents of the lines are only computed if computeExtents is true. Not thread safe.
+    void computeBreaks(const U16StringPiece& textBuf, const MeasuredText& measuredText,
+                       // Line width arguments
+                       float firstWidth, int32_t firstWidthLineCount, float restWidth,
+                       int32_t indentsOffset,
+                       // Tab stop arguments
+                       const float* tabStops, int32_t tabStopSize, float defaultTabStopWidth,
+                       bool computeExtents, LineBreakResult* out) {
+        AndroidLineWidth lineWidth(firstWidth, firstWidthLineCount, restWidth, mIndents,
+                                   indentsOffset);
+        breakIntoLines(textBuf, mStrategy, mFrequency, mIsJustified, measuredText, lineWidth,
+                       TabStops(tabStops, tabStopSize, defaultTabStopWidth), computeExtents,
+                       &mScratch, out);
+    }
+
+    // Same as above, but writes the result to the one kept by this instance and returns it, so
+    // that building the layout of the same view again, e.g. when a list item is rebound, neither
+    // allocates the scratch memory of the line breaker nor the vectors of the result. The result
+    // is valid until the next call. Not thread safe.
+    const LineBreakResult& computeBreaks(const U16StringPiece& textBuf,
+                                         const MeasuredText& measuredText,
+                                         // Line width arguments
+                                         float firstWidth, int32_t firstWidthLineCount,
+                                         float restWidth, int32_t indentsOffset,
+                                         // Tab stop arguments
+                                         const float* tabStops, int32_t tabStopSize,
+                                         float defaultTabStopWidth, bool computeExtents) {
+        computeBreaks(textBuf, measuredText, firstWidth, firstWidthLineCount, restWidth,
+                      indentsOffset, tabStops, tabStopSize, defaultTabStopWidth, computeExtents,
+                      &mResult);
+        return mResult;
+    }
+
     inline BreakStrategy getStrategy() const { return mStrategy; }
     inline HyphenationFrequency getFrequency() const { return mFrequency; }
     inline bool isJustified() const { return mIsJustified; }
@@ -101,9 +211,11 @@ private:
     const BreakStrategy mStrategy;
     const HyphenationFrequency mFrequency;
     const bool mIsJustified;
-    const std::vector<float> mIndents;
+    const LineIndents mIndents;
     const std::vector<float> mLeftPaddings;
     const std::vector<float> mRightPaddings;
+    LineBreakScratch mScratch;
+    LineBreakResult mResult;
 };
 
 }  // namespace android
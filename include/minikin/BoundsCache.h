@@ -19,68 +19,60 @@
 
 #include "minikin/LayoutCache.h"
 
-#include <mutex>
+#include <memory>
 
-#include <utils/LruCache.h>
-
-#include "minikin/BoundsCache.h"
-#include "minikin/FontCollection.h"
-#include "minikin/Hasher.h"
+#include "minikin/CacheStats.h"
 #include "minikin/MinikinPaint.h"
+#include "minikin/MinikinRect.h"
 
 namespace minikin {
 
-// Cache entry
-struct BoundsValue {
-    MinikinRect rect;
-    float advance;
-};
-
-// Used for callback for LayoutCache.
-struct ValueExtractor {
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint);
-    std::unique_ptr<BoundsValue> value;
-};
-
-class BoundsCache : private android::OnEntryRemoved<LayoutCacheKey, BoundsValue*> {
+// Bounding boxes of layouts.
+//
+// The bounds are not cached separately, but stored lazily in the LayoutCache entry of the layout
+// they are computed from, so a bounds query costs one hash, one lookup and one lock, and a layout
+// already cached for drawing is not shaped again for measuring.
+class BoundsCache {
 public:
-    void clear() {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mCache.clear();
+    // Purges the LayoutCache the bounds are stored in, i.e. the layouts too.
+    void clear() { mLayoutCache->clear(); }
+
+    // Purges the layouts of the font collection and their bounds. See LayoutCache.
+    void purgeCollection(uint32_t fontCollectionId) {
+        mLayoutCache->purgeCollection(fontCollectionId);
     }
 
+    // Purges the layouts using the font and their bounds.
+    void purgeFont(const Font* font) { mLayoutCache->purgeFont(font); }
+
+    // Returns the number of cached bounds.
+    uint32_t getCacheSize() { return mLayoutCache->getBoundsCount(); }
+
+    // Returns the memory used by the cached bounds. It is part of the LayoutCache memory usage.
+    size_t getMemoryUsage() { return mLayoutCache->getBoundsCount() * sizeof(MinikinRect); }
+
+    const CacheStats& getStats() const { return mLayoutCache->getBoundsStats(); }
+    void resetStats() { mLayoutCache->resetBoundsStats(); }
+
     // Do not use BoundsCache inside the callback function, otherwise dead-lock may happen.
     template <typename F>
     void getOrCreate(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
                      bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, F& f) {
-        LayoutCacheKey key(text, range, paint, dir, startHyphen, endHyphen);
-        if (paint.skipCache() || range.getLength() >= LENGTH_LIMIT_CACHE) {
-            LayoutPiece piece = LayoutPiece(text, range, dir, paint, startHyphen, endHyphen);
-            f(getBounds(piece, paint), piece.advance());
-            return;
-        }
-        {
-            std::lock_guard<std::mutex> lock(mMutex);
-            BoundsValue* value = mCache.get(key);
-            if (value != nullptr) {
-                f(value->rect, value->advance);
-                return;
-            }
-        }
-        // Doing text layout takes long time, so releases the mutex during doing layout.
-        // Don't care even if we do the same layout in other thread.
-        key.copyText();
-        ValueExtractor ve;
-        LayoutCache::getInstance().getOrCreate(text, range, paint, dir, startHyphen, endHyphen, ve);
-        f(ve.value->rect, ve.value->advance);
-        {
-            std::lock_guard<std::mutex> lock(mMutex);
-            mCache.put(key, ve.value.release());
-        }
+        mLayoutCache->getOrCreateBounds(text, range, paint, dir, startHyphen, endHyphen, f);
+    }
+
+    // Same as above for text in an immutable buffer kept alive by textOwner, which a new entry
+    // refers to instead of copying the text. See LayoutCache::getOrCreate.
+    template <typename F>
+    void getOrCreate(const U16StringPiece& text, const std::shared_ptr<const void>& textOwner,
+                     const Range& range, const MinikinPaint& paint, bool dir,
+                     StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, F& f) {
+        mLayoutCache->getOrCreateBounds(text, range, paint, dir, startHyphen, endHyphen, f,
+                                        textOwner);
     }
 
     static BoundsCache& getInstance() {
-        static BoundsCache cache(kMaxEntries);
+        static BoundsCache cache(&LayoutCache::getInstance());
         return cache;
     }
 
@@ -88,22 +80,14 @@ public:
     static MinikinRect getBounds(const LayoutPiece& layoutPiece, const MinikinPaint& paint);
 
 protected:
-    BoundsCache(uint32_t maxEntries) : mCache(maxEntries) {
-        mCache.setOnEntryRemovedListener(this);
-    }
+    // Stores the bounds in a private LayoutCache holding at most maxEntries layouts.
+    BoundsCache(uint32_t maxEntries);
 
 private:
-    // callback for OnEntryRemoved
-    void operator()(LayoutCacheKey& key, BoundsValue*& value) {
-        key.freeText();
-        delete value;
-    }
+    explicit BoundsCache(LayoutCache* layoutCache) : mLayoutCache(layoutCache) {}
 
-    std::mutex mMutex;
-    android::LruCache<LayoutCacheKey, BoundsValue*> mCache GUARDED_BY(mMutex) GUARDED_BY(mMutex);
-    // LRU cache capacity. Should be fine to be less than LayoutCache#kMaxEntries since bbox
-    // calculation happens less than layout calculation.
-    static const size_t kMaxEntries = 500;
+    std::unique_ptr<LayoutCache> mOwnedCache;
+    LayoutCache* mLayoutCache;
 };
 
 }  // namespace minikin
@@ -17,6 +17,7 @@
 #ifndef MINIKIN_BUFFER_H
 #define MINIKIN_BUFFER_H
 
+#include <cstdint>
 #include <cstring>
 #include <string_view>
 #include <type_traits>
@@ -93,6 +94,77 @@ private:
     size_t mPos;
 };
 
+// This is a helper class to check that a buffer of the given size holds the data a BufferReader
+// is about to read, for buffers which may not have been written by BufferWriter, e.g. files. It
+// follows the same layout as BufferReader, but checks every read against the size. Once a check
+// fails, the reads return zeros and ok() returns false.
+class BufferValidator {
+public:
+    BufferValidator(const void* buffer, size_t size)
+            : mData(reinterpret_cast<const uint8_t*>(buffer)), mSize(size), mPos(0), mError(false) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_pod<T>::value, "T must be a POD");
+        T data = T();
+        const size_t pos = BufferReader::align<T>(mPos);
+        if (advance(pos, sizeof(T))) {
+            memcpy(&data, mData + pos, sizeof(T));
+        }
+        return data;
+    }
+
+    template <typename T>
+    void skip() {
+        read<T>();
+    }
+
+    // Return a pointer to an array and its number of elements, or a null pointer and zero if the
+    // array doesn't fit in the buffer.
+    template <typename T>
+    std::pair<const T*, uint32_t> readArray() {
+        static_assert(std::is_pod<T>::value, "T must be a POD");
+        const uint32_t size = read<uint32_t>();
+        const size_t pos = BufferReader::align<T>(mPos);
+        if (!advance(pos, static_cast<uint64_t>(size) * sizeof(T))) {
+            return std::make_pair(nullptr, 0);
+        }
+        return std::make_pair(reinterpret_cast<const T*>(mData + pos), size);
+    }
+
+    template <typename T>
+    void skipArray() {
+        readArray<T>();
+    }
+
+    void skipString() { skipArray<char>(); }
+
+    // Skips the given number of bytes.
+    void skipBytes(uint64_t size) { advance(mPos, size); }
+
+    // Marks the buffer as invalid, for the checks of the values read.
+    void fail() { mError = true; }
+
+    bool ok() const { return !mError; }
+    size_t pos() const { return mPos; }
+
+private:
+    // Moves to pos + size if it is in the buffer, otherwise fails.
+    bool advance(size_t pos, uint64_t size) {
+        if (mError || pos > mSize || size > mSize - pos) {
+            mError = true;
+            return false;
+        }
+        mPos = pos + size;
+        return true;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos;
+    bool mError;
+};
+
 // This is a helper class to write data to a memory buffer.
 class BufferWriter {
 public:
@@ -134,6 +206,39 @@ public:
 
     void writeString(std::string_view string) { writeArray<char>(string.data(), string.size()); }
 
+    // Leaves room for a single data of type T, to be written later with writeAt(), and returns
+    // its position.
+    template <typename T>
+    size_t reserve() {
+        static_assert(std::is_pod<T>::value, "T must be a POD");
+        mPos = BufferReader::align<T>(mPos);
+        const size_t pos = mPos;
+        mPos += sizeof(T);
+        return pos;
+    }
+
+    // Leaves room for an array of the given number of elements, to be written later with
+    // writeAt(), and returns the position of its first element.
+    template <typename T>
+    size_t reserveArray(uint32_t size) {
+        static_assert(std::is_pod<T>::value, "T must be a POD");
+        write<uint32_t>(size);
+        mPos = BufferReader::align<T>(mPos);
+        const size_t pos = mPos;
+        mPos += size * sizeof(T);
+        return pos;
+    }
+
+    // Write a single data of type T at the position returned by reserve<T>(), or at an element of
+    // the array reserved by reserveArray<T>().
+    template <typename T>
+    void writeAt(size_t pos, const std::common_type_t<T>& data) {
+        static_assert(std::is_pod<T>::value, "T must be a POD");
+        if (mData != nullptr) {
+            memcpy(mData + pos, &data, sizeof(T));
+        }
+    }
+
     // Return the number of bytes written.
     size_t size() const { return mPos; }
 
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_CACHE_PREWARMER_H
+#define MINIKIN_CACHE_PREWARMER_H
+
+#include <memory>
+#include <vector>
+
+#include "minikin/FontCollection.h"
+#include "minikin/Macros.h"
+#include "minikin/MinikinPaint.h"
+
+namespace minikin {
+
+class LayoutCache;
+
+// Shapes the strings an app is known to show, e.g. on its main screens, into LayoutCache and
+// BoundsCache in a background task of getExecutor(), so that the UI thread finds them cached. The
+// task never waits for a lock the foreground layouts hold: it yields to them instead.
+class CachePrewarmer {
+public:
+    // Starts laying out each of the strings with each of the paints, using the collection instead
+    // of the font of the paints. The strings are laid out as with Bidi::DEFAULT_LTR.
+    static std::unique_ptr<CachePrewarmer> prewarm(
+            const std::shared_ptr<FontCollection>& collection,
+            const std::vector<MinikinPaint>& paints,
+            const std::vector<std::vector<uint16_t>>& strings);
+
+    // Cancels the remaining layouts and waits for the layout in progress, if any.
+    virtual ~CachePrewarmer();
+
+    // Stops the task after the layout in progress. The layouts done so far stay cached. If the
+    // task hasn't started yet, it won't lay out anything.
+    void cancel();
+
+    // Blocks until all the strings are laid out or the prewarming is cancelled. Returns true if
+    // all the strings were laid out. Doesn't wait for a task cancelled before it started.
+    bool wait();
+
+protected:
+    // Visible for testing purposes. Prewarms the given cache.
+    CachePrewarmer(LayoutCache* cache, const std::shared_ptr<FontCollection>& collection,
+                   const std::vector<MinikinPaint>& paints,
+                   const std::vector<std::vector<uint16_t>>& strings);
+
+private:
+    // Shared with the task, which may start after the prewarmer is destroyed if it was cancelled.
+    struct State;
+
+    static void run(State* state);
+
+    const std::shared_ptr<State> mState;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(CachePrewarmer);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_CACHE_PREWARMER_H
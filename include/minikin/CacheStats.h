@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_CACHE_STATS_H
+#define MINIKIN_CACHE_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Effectiveness counters of a cache.
+//
+// The counters are relaxed atomics, so recording an event is a single uncontended atomic add and
+// can be done with or without holding the cache lock. The values are only meant for diagnostics
+// and may be slightly inconsistent with each other while the cache is in use.
+class CacheStats {
+public:
+    CacheStats()
+            : mHits(0),
+              mMisses(0),
+              mInserts(0),
+              mEvictions(0),
+              mBypasses(0),
+              mLockWaits(0),
+              mLockWaitNanos(0) {}
+
+    // A lookup found the value in the cache.
+    void hit() { mHits.fetch_add(1, std::memory_order_relaxed); }
+    // A lookup did not find the value and it had to be computed.
+    void miss() { mMisses.fetch_add(1, std::memory_order_relaxed); }
+    // A computed value was stored in the cache.
+    void insert() { mInserts.fetch_add(1, std::memory_order_relaxed); }
+    // A value was removed to make room for others. Explicit purges are not counted.
+    void evict() { mEvictions.fetch_add(1, std::memory_order_relaxed); }
+    // The request was not eligible for caching, e.g. too long text.
+    void bypass() { mBypasses.fetch_add(1, std::memory_order_relaxed); }
+    // A lock of the cache was held by another thread, and the caller waited nanos for it.
+    void lockWait(uint64_t nanos) {
+        mLockWaits.fetch_add(1, std::memory_order_relaxed);
+        mLockWaitNanos.fetch_add(nanos, std::memory_order_relaxed);
+    }
+
+    // Locks the mutex of the cache, recording the wait with lockWait() if another thread holds
+    // it. An uncontended lock only costs a try_lock.
+    std::unique_lock<std::mutex> lock(std::mutex& mutex) {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            waitForLock(&lock);
+        }
+        return lock;
+    }
+
+    uint64_t hits() const { return mHits.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return mMisses.load(std::memory_order_relaxed); }
+    uint64_t inserts() const { return mInserts.load(std::memory_order_relaxed); }
+    uint64_t evictions() const { return mEvictions.load(std::memory_order_relaxed); }
+    uint64_t bypasses() const { return mBypasses.load(std::memory_order_relaxed); }
+    uint64_t lockWaits() const { return mLockWaits.load(std::memory_order_relaxed); }
+    uint64_t lockWaitNanos() const { return mLockWaitNanos.load(std::memory_order_relaxed); }
+
+    void reset() {
+        mHits.store(0, std::memory_order_relaxed);
+        mMisses.store(0, std::memory_order_relaxed);
+        mInserts.store(0, std::memory_order_relaxed);
+        mEvictions.store(0, std::memory_order_relaxed);
+        mBypasses.store(0, std::memory_order_relaxed);
+        mLockWaits.store(0, std::memory_order_relaxed);
+        mLockWaitNanos.store(0, std::memory_order_relaxed);
+    }
+
+    // Returns a human readable single line summary for the dumpsys output.
+    std::string toString(const char* name, size_t entries, size_t bytes) const;
+
+private:
+    void waitForLock(std::unique_lock<std::mutex>* lock);
+
+    std::atomic<uint64_t> mHits;
+    std::atomic<uint64_t> mMisses;
+    std::atomic<uint64_t> mInserts;
+    std::atomic<uint64_t> mEvictions;
+    std::atomic<uint64_t> mBypasses;
+    std::atomic<uint64_t> mLockWaits;
+    std::atomic<uint64_t> mLockWaitNanos;
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(CacheStats);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_CACHE_STATS_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_CALL_RECORDER_H
+#define MINIKIN_CALL_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "minikin/FamilyVariant.h"
+#include "minikin/FontStyle.h"
+#include "minikin/Hyphenator.h"
+#include "minikin/Layout.h"
+#include "minikin/LineBreaker.h"
+#include "minikin/MinikinPaint.h"
+#include "minikin/Range.h"
+
+namespace minikin {
+
+// The fields of a MinikinPaint which change the result of a layout, in a form which is the same
+// in every process.
+struct RecordedPaint {
+    float size = 0;
+    float scaleX = 0;
+    float skewX = 0;
+    float letterSpacing = 0;
+    float wordSpacing = 0;
+    uint32_t fontFlags = 0;
+    std::string locales;
+    FontStyle fontStyle;
+    FamilyVariant familyVariant = FamilyVariant::DEFAULT;
+    std::string fontFeatureSettings;
+    // A hash of the families of the collection and their coverage, see
+    // CallRecorder::getCollectionFingerprint().
+    uint32_t collectionFingerprint = 0;
+
+    static RecordedPaint from(const MinikinPaint& paint);
+
+    // Returns a paint with these fields and the given collection.
+    MinikinPaint toPaint(const std::shared_ptr<FontCollection>& collection) const;
+};
+
+// A call recorded by CallRecorder. The fields which don't apply to the type of the call are left
+// at their default values.
+struct RecordedCall {
+    enum class Type : uint32_t {
+        // Layout::Layout().
+        kLayout = 0,
+        // Layout::measureText().
+        kMeasureText = 1,
+        // MeasuredTextBuilder::build().
+        kMeasuredTextBuild = 2,
+        // breakIntoLines() of a single paragraph.
+        kBreakIntoLines = 3,
+    };
+
+    // A run of a MeasuredTextBuilder. The runs without a paint, e.g. the replacement runs, are
+    // recorded as replacement runs of their measured width.
+    struct Run {
+        Range range;
+        bool isReplacement = false;
+        bool isRtl = false;
+        RecordedPaint paint;
+        float width = 0;
+        std::string locales;
+    };
+
+    Type type = Type::kLayout;
+    // The time the call took in the recording process.
+    uint64_t durationNanos = 0;
+    // The whole text buffer passed to the call.
+    std::vector<uint16_t> text;
+
+    // kLayout and kMeasureText.
+    Range range;
+    Bidi bidiFlags = Bidi::LTR;
+    RecordedPaint paint;
+    StartHyphenEdit startHyphen = StartHyphenEdit::NO_EDIT;
+    EndHyphenEdit endHyphen = EndHyphenEdit::NO_EDIT;
+
+    // kMeasuredTextBuild, with the options of the builder. The hint is not recorded, only whether
+    // there was one.
+    std::vector<Run> runs;
+    bool computeHyphenation = false;
+    bool computeLayout = false;
+    bool lazyHyphenation = false;
+    bool hasHint = false;
+    uint32_t maxThreads = 1;
+    bool compactWidths = false;
+    bool keepWordBreaks = false;
+    uint32_t lineBreakCacheSize = 0;
+    bool approximateHyphenPieces = false;
+
+    // kMeasuredTextBuild and kBreakIntoLines. The id of the built MeasuredText, which the
+    // breakIntoLines calls refer to, or 0 if it was built while not recording.
+    uint32_t measuredTextId = 0;
+
+    // kBreakIntoLines. The widths of the lines up to the last one the line breaker asked for.
+    BreakStrategy strategy = BreakStrategy::Greedy;
+    HyphenationFrequency frequency = HyphenationFrequency::None;
+    bool justified = false;
+    std::vector<float> lineWidths;
+    float minLineWidth = 0;
+    std::vector<float> tabStops;
+    float tabWidth = 0;
+};
+
+// Records the calls of Layout, Layout::measureText, MeasuredTextBuilder::build and breakIntoLines
+// into a compact binary trace, so that a real workload can be replayed offline against another
+// version of the library, e.g. with the replay benchmark of minikin_perftests. Only the outermost
+// call of a thread is recorded, not the calls the library makes internally.
+//
+// Recording is off by default, in which case a call costs one relaxed load. While recording, the
+// calls of all threads are appended to the trace under a lock.
+class CallRecorder {
+public:
+    static constexpr size_t kDefaultMaxBytes = 16 * 1024 * 1024;
+
+    // Starts recording into an empty trace. The calls which don't fit in maxBytes are dropped and
+    // counted.
+    static void start(size_t maxBytes = kDefaultMaxBytes);
+
+    // Stops recording and returns the trace.
+    static std::vector<uint8_t> stop();
+
+    static bool isRecording() { return sRecording.load(std::memory_order_relaxed); }
+
+    // Returns the number of calls dropped since the last start() because the trace was full.
+    static uint32_t getDroppedCallCount();
+
+    // Reads the calls of a trace returned by stop(). Returns false if the data is not a trace of
+    // this version.
+    static bool readTrace(const void* data, size_t size, std::vector<RecordedCall>* out);
+
+    // Returns a hash of the families of the collection, their fonts' styles and their coverage,
+    // which is the same for the same fonts in every process.
+    static uint32_t getCollectionFingerprint(const FontCollection& collection);
+
+    // For internal use. Appends the call to the trace if recording.
+    static void record(const RecordedCall& call);
+
+    // For internal use. Returns a new id for a MeasuredText built while recording.
+    static uint32_t nextMeasuredTextId();
+
+    // For internal use. Copies the tab stops to a kBreakIntoLines call.
+    static void copyTabStops(const TabStops& tabStops, RecordedCall* call);
+
+private:
+    static std::atomic<bool> sRecording;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_CALL_RECORDER_H
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_EXECUTOR_H
+#define MINIKIN_EXECUTOR_H
+
+#include <cstdint>
+#include <functional>
+
+namespace minikin {
+
+// Runs the work minikin does on other threads than the calling one: the workers of the parallel
+// builds and line breaking, and the font preloading, the cache prewarming and the deferred
+// layouts. minikin doesn't create threads besides the ones of the default pool, so a host with its
+// own thread pools can replace it with setExecutor() and keep the cores from being oversubscribed.
+class Executor {
+public:
+    enum class Priority : uint8_t {
+        // The work someone waits for, e.g. the other workers of a parallel build.
+        kForeground,
+        // The work nobody waits for, e.g. preloading a font. It must not slow down the UI thread.
+        kBackground,
+    };
+
+    virtual ~Executor() {}
+
+    // Runs the task once on another thread. The tasks may run in any order and concurrently.
+    virtual void execute(std::function<void()>&& task, Priority priority) = 0;
+
+    // The number of the threads running the foreground tasks. The parallel work is split into at
+    // most one more part than this, since the calling thread takes a part too.
+    virtual uint32_t getConcurrency() const = 0;
+};
+
+// Returns the executor set by setExecutor(), or the default pool. The pool has a foreground worker
+// for each performance core but one, i.e. the little cores of a big.LITTLE CPU are not counted,
+// and a background worker at the priority of the Android background threads. Its threads are
+// started on first use.
+Executor* getExecutor();
+
+// Replaces the executor, or restores the default pool if the executor is null. The executor is
+// not owned, and must outlive the work posted to it. Should be called at the start of the process,
+// before any work is posted.
+void setExecutor(Executor* executor);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_EXECUTOR_H
@@ -17,9 +17,13 @@
 #ifndef MINIKIN_FONT_H
 #define MINIKIN_FONT_H
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_set>
+#include <vector>
 
 #include "minikin/Buffer.h"
 #include "minikin/FontStyle.h"
@@ -27,6 +31,7 @@
 #include "minikin/HbUtils.h"
 #include "minikin/LocaleList.h"
 #include "minikin/Macros.h"
+#include "minikin/MinikinExtent.h"
 #include "minikin/MinikinFont.h"
 
 namespace minikin {
@@ -121,6 +126,7 @@ public:
     template <TypefaceReader typefaceReader>
     static std::shared_ptr<Font> readFrom(BufferReader* reader, uint32_t localeListId) {
         FontStyle style = FontStyle(reader);
+        reader->skip<uint32_t>();  // The size of the typeface metadata.
         BufferReader typefaceMetadataReader = *reader;
         TypefaceLoader* typefaceLoader = typefaceReader(reader);
         return std::shared_ptr<Font>(
@@ -130,46 +136,135 @@ public:
     template <TypefaceWriter typefaceWriter>
     void writeTo(BufferWriter* writer) const {
         mStyle.writeTo(writer);
+        // The size of the typeface metadata lets validate() skip it without knowing its format.
+        const size_t sizePos = writer->reserve<uint32_t>();
+        const size_t metadataStart = writer->size();
         typefaceWriter(writer, typeface().get());
+        writer->writeAt<uint32_t>(sizePos, writer->size() - metadataStart);
+    }
+
+    // Checks that the buffer holds what readFrom() reads, except for the typeface metadata which
+    // is only checked to be in the buffer.
+    static void validate(BufferValidator* validator) {
+        FontStyle::validate(validator);
+        const uint32_t metadataSize = validator->read<uint32_t>();
+        validator->skipBytes(metadataSize);
     }
 
     // This locale list is just for API compatibility. This is not used in font selection or family
     // fallback.
     uint32_t getLocaleListId() const { return mLocaleListId; }
+    // The typeface and the base font of a font created by readFrom() may be released by
+    // releaseUnusedTypefaces(). The returned references stay valid until the second call after
+    // they are taken. Use acquireTypeface() and acquireBaseFont() to keep them for longer.
     const std::shared_ptr<MinikinFont>& typeface() const;
+    std::shared_ptr<MinikinFont> acquireTypeface() const { return typeface(); }
     inline FontStyle style() const { return mStyle; }
     const HbFontUniquePtr& baseFont() const;
+    HbFontUniquePtr acquireBaseFont() const {
+        return HbFontUniquePtr(hb_font_reference(baseFont().get()));
+    }
+    // Returns true if baseFont() would return without loading the typeface. Never waits for a
+    // typeface being loaded.
+    bool isBaseFontLoaded() const;
     BufferReader typefaceMetadataReader() const { return mTypefaceMetadataReader; }
 
+    // Returns a reference to the shape plan of the base font for the segment properties and the
+    // features, which are expected to apply to the whole buffer. The plans are cached per font,
+    // so shaping the same kind of run again skips the plan lookup.
+    HbShapePlanUniquePtr getShapePlan(const hb_segment_properties_t& props,
+                                      const std::vector<hb_feature_t>& features) const;
+
+    // Returns the vertical extent of the typeface for the paint and the fakery. It only depends on
+    // the size, the scale, the skew and the flags of the paint, so the few recent results are
+    // cached per font instead of asking the typeface for each run.
+    MinikinExtent getExtent(const MinikinPaint& paint, FontFakery fakery) const;
+
+    // The glyphs of the Latin-1 characters which shaping maps through the cmap alone: the font has
+    // the glyph, none of its GSUB and GPOS lookups involves it, it is not a mark, and the font has
+    // none of the tables HarfBuzz applies besides those, e.g. kern or morx. A run of such glyphs
+    // is shaped to the glyphs of its characters with their advances, so HarfBuzz can be skipped.
+    struct SimpleGlyphs {
+        static constexpr uint16_t kFirstChar = 0x20;
+        static constexpr uint16_t kLastChar = 0xFF;
+
+        // Returns the glyph of the code unit, or 0 if it is not simple.
+        uint16_t get(uint16_t c) const {
+            return (c < kFirstChar || c > kLastChar) ? 0 : glyphs[c - kFirstChar];
+        }
+
+        std::array<uint16_t, kLastChar - kFirstChar + 1> glyphs;
+    };
+
+    // Analyzed on the first call, which loads the base font.
+    const SimpleGlyphs& getSimpleGlyphs() const;
+
     std::unordered_set<AxisTag> getSupportedAxes() const;
+    // Returns the supported axes in ascending order.
+    const std::vector<AxisTag>& getSortedSupportedAxes() const;
+
+    ~Font();
+
+    // Releases the typefaces and the base fonts of the fonts created by readFrom() that have not
+    // been used since the previous call. They are loaded again on their next use. Calling this
+    // every N minutes releases the fonts unused for N to 2N minutes.
+    // The released objects are destroyed by the next call, so the readers which took them before
+    // the release have a whole period to finish with them.
+    static void releaseUnusedTypefaces();
+
+    // Returns the number of the HarfBuzz faces of the live fonts, which are shared by the fonts of
+    // the same font data, and the total size of their font data. The data is owned by the
+    // typefaces, usually mapped from the font files, and the memory HarfBuzz allocates for a face
+    // is not visible.
+    static void getSharedFaceUsage(size_t* outFaceCount, size_t* outDataSize);
 
 private:
+    // The typeface and the base font. Once published, the typeface is never modified, and the
+    // base font is only set once, before isBaseFontSet.
+    struct LoadedTypeface {
+        std::shared_ptr<MinikinFont> typeface;
+        HbFontUniquePtr baseFont;
+        std::atomic<bool> isBaseFontSet;
+    };
+
     // Use Builder instead.
     Font(std::shared_ptr<MinikinFont>&& typeface, FontStyle style, HbFontUniquePtr&& baseFont,
          uint32_t localeListId)
-            : mTypeface(std::move(typeface)),
-              mStyle(style),
-              mBaseFont(std::move(baseFont)),
+            : mStyle(style),
+              mLoaded(new LoadedTypeface{std::move(typeface), std::move(baseFont), true}),
+              mLastUsedEpoch(0),
               mTypefaceLoader(nullptr),
               mTypefaceMetadataReader(nullptr),
               mLocaleListId(localeListId) {}
     Font(FontStyle style, BufferReader typefaceMetadataReader, TypefaceLoader* typefaceLoader,
          uint32_t localeListId)
             : mStyle(style),
+              mLoaded(nullptr),
+              mLastUsedEpoch(0),
               mTypefaceLoader(typefaceLoader),
               mTypefaceMetadataReader(typefaceMetadataReader),
               mLocaleListId(localeListId) {}
 
-    void initTypefaceLocked() const EXCLUSIVE_LOCKS_REQUIRED(mTypefaceMutex);
+    // The fonts created by readFrom() whose typefaces are loaded. Defined in Font.cpp.
+    class LoadedFontRegistry;
+    static LoadedFontRegistry& getLoadedFontRegistry();
+
+    LoadedTypeface* loadTypefaceLocked() const EXCLUSIVE_LOCKS_REQUIRED(mTypefaceMutex);
+    // Returns the loaded typeface with its base font set, loading them if needed.
+    LoadedTypeface* loadBaseFont() const;
+    // Marks this font as used in the current eviction period.
+    void markUsed() const;
 
     static HbFontUniquePtr prepareFont(const std::shared_ptr<MinikinFont>& typeface);
-    static FontStyle analyzeStyle(const HbFontUniquePtr& font);
+    static std::unique_ptr<SimpleGlyphs> analyzeSimpleGlyphs(const HbFontUniquePtr& font);
 
-    // Lazy-initialized if created by readFrom().
-    mutable std::shared_ptr<MinikinFont> mTypeface GUARDED_BY(mTypefaceMutex);
     FontStyle mStyle;
-    // Lazy-initialized if created by readFrom().
-    mutable HbFontUniquePtr mBaseFont GUARDED_BY(mTypefaceMutex);
+
+    // Owned. Lazy-initialized if created by readFrom(), and then reset to nullptr when released by
+    // releaseUnusedTypefaces(). Only written under mTypefaceMutex, and read without the lock.
+    mutable std::atomic<LoadedTypeface*> mLoaded;
+    // The eviction period in which this font was last used.
+    mutable std::atomic<uint32_t> mLastUsedEpoch;
 
     mutable std::mutex mTypefaceMutex;
     // Non-null if created by readFrom().
@@ -179,6 +274,46 @@ private:
 
     uint32_t mLocaleListId;
 
+    struct ShapePlanEntry {
+        // The typeface whose base font the plan was created for.
+        const LoadedTypeface* loaded;
+        hb_segment_properties_t props;
+        std::vector<hb_feature_t> features;
+        HbShapePlanUniquePtr plan;
+    };
+    // In the order of creation. A font is usually shaped with a few scripts and feature sets.
+    // Lookups share the lock, only creating a plan takes it exclusively.
+    mutable std::vector<ShapePlanEntry> mShapePlans GUARDED_BY(mShapePlanMutex);
+    mutable std::shared_mutex mShapePlanMutex;
+    // Returns a new reference to the plan of mShapePlans for the typeface, props and features, or
+    // null.
+    HbShapePlanUniquePtr findShapePlanLocked(const LoadedTypeface* loaded,
+                                             const hb_segment_properties_t& props,
+                                             const std::vector<hb_feature_t>& features) const
+            SHARED_LOCKS_REQUIRED(mShapePlanMutex);
+    static const size_t kMaxShapePlans = 8;
+
+    struct ExtentEntry {
+        float size;
+        float scaleX;
+        float skewX;
+        uint32_t fontFlags;
+        FontFakery fakery;
+        MinikinExtent extent;
+    };
+    // In the order of creation. Also kept when the typeface is released, since the font file is
+    // the same when it is loaded again.
+    mutable std::vector<ExtentEntry> mExtents GUARDED_BY(mExtentMutex);
+    mutable std::mutex mExtentMutex;
+    static const size_t kMaxExtents = 4;
+
+    // Only depends on the font file, so it is kept when the typeface is released.
+    mutable std::unique_ptr<SimpleGlyphs> mSimpleGlyphs;
+    mutable std::once_flag mSimpleGlyphsOnce;
+    // Same as mSimpleGlyphs. Set by the builder if it parses the font file for the style.
+    mutable std::vector<AxisTag> mSupportedAxes;
+    mutable std::once_flag mSupportedAxesOnce;
+
     // Stop copying and moving
     Font(Font&& o) = delete;
     Font& operator=(Font&& o) = delete;
@@ -17,7 +17,11 @@
 #ifndef MINIKIN_FONT_COLLECTION_H
 #define MINIKIN_FONT_COLLECTION_H
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -25,8 +29,10 @@
 #include <gtest/gtest_prod.h>
 
 #include "minikin/Buffer.h"
+#include "minikin/CacheStats.h"
 #include "minikin/Font.h"
 #include "minikin/FontFamily.h"
+#include "minikin/Macros.h"
 #include "minikin/MinikinFont.h"
 #include "minikin/U16StringPiece.h"
 
@@ -38,17 +44,33 @@ constexpr uint32_t MAX_FAMILY_COUNT = 254;
 class FontCollection {
 public:
     explicit FontCollection(const std::vector<std::shared_ptr<FontFamily>>& typefaces);
+    // Same as above, but builds the per-page family tables with up to threadCount threads,
+    // including the calling thread. The result doesn't depend on the thread count.
+    FontCollection(const std::vector<std::shared_ptr<FontFamily>>& typefaces,
+                   uint32_t threadCount);
     explicit FontCollection(std::shared_ptr<FontFamily>&& typeface);
+    ~FontCollection();
+
+    // Builds the families of the specs with buildFontFamilies() and a collection of them, on up
+    // to maxThreads threads, or on all the threads of getExecutor() if maxThreads is 0.
+    static std::shared_ptr<FontCollection> build(const std::vector<FontFamilySpec>& specs,
+                                                 uint32_t maxThreads = 0);
 
     template <Font::TypefaceReader typefaceReader>
     static std::vector<std::shared_ptr<FontCollection>> readVector(BufferReader* reader) {
-        uint32_t allFontFamiliesCount = reader->read<uint32_t>();
+        if (!readVectorHeader(reader)) {
+            return {};
+        }
+        // The coverage of the families points into the pool, which points into the buffer.
+        SparseBitSet::PagePool pool(reader);
+        // The offsets are only needed for reading the buffer out of order, see VectorReader.
+        uint32_t allFontFamiliesCount = reader->readArray<uint32_t>().second;
+        uint32_t fontCollectionsCount = reader->readArray<uint32_t>().second;
         std::vector<std::shared_ptr<FontFamily>> allFontFamilies;
         allFontFamilies.reserve(allFontFamiliesCount);
         for (uint32_t i = 0; i < allFontFamiliesCount; i++) {
-            allFontFamilies.push_back(FontFamily::readFrom<typefaceReader>(reader));
+            allFontFamilies.push_back(FontFamily::readFrom<typefaceReader>(reader, &pool));
         }
-        uint32_t fontCollectionsCount = reader->read<uint32_t>();
         std::vector<std::shared_ptr<FontCollection>> fontCollections;
         fontCollections.reserve(fontCollectionsCount);
         for (uint32_t i = 0; i < fontCollectionsCount; i++) {
@@ -65,28 +87,123 @@ public:
         std::unordered_map<std::shared_ptr<FontFamily>, uint32_t> fontFamilyToIndexMap;
         collectAllFontFamilies(fontCollections, &allFontFamilies, &fontFamilyToIndexMap);
 
-        writer->write<uint32_t>(allFontFamilies.size());
+        // The families share the identical pages of their coverage.
+        SparseBitSet::PagePool pool;
         for (const auto& fontFamily : allFontFamilies) {
-            fontFamily->writeTo<typefaceWriter>(writer);
+            fontFamily->addCoverageTo(&pool);
+        }
+
+        writeVectorHeader(writer);
+        pool.writeTo(writer);
+        // The offsets of the families and the collections in the buffer, filled in below.
+        const size_t familyOffsetsPos = writer->reserveArray<uint32_t>(allFontFamilies.size());
+        const size_t collectionOffsetsPos = writer->reserveArray<uint32_t>(fontCollections.size());
+        for (size_t i = 0; i < allFontFamilies.size(); i++) {
+            writer->writeAt<uint32_t>(familyOffsetsPos + i * sizeof(uint32_t), writer->size());
+            allFontFamilies[i]->writeTo<typefaceWriter>(writer, &pool);
         }
-        writer->write<uint32_t>(fontCollections.size());
-        for (const auto& fontCollection : fontCollections) {
-            fontCollection->writeTo(writer, fontFamilyToIndexMap);
+        for (size_t i = 0; i < fontCollections.size(); i++) {
+            writer->writeAt<uint32_t>(collectionOffsetsPos + i * sizeof(uint32_t), writer->size());
+            fontCollections[i]->writeTo(writer, fontFamilyToIndexMap);
         }
     }
 
+    // Reads the collections of a buffer written by writeVector() one at a time, using the offsets
+    // written ahead of the families. Only the families of the collections read are read, and they
+    // are shared by the collections. The buffer must outlive the reader and the collections read.
+    // This class is thread-safe.
+    template <Font::TypefaceReader typefaceReader>
+    class VectorReader {
+    public:
+        explicit VectorReader(BufferReader reader) : mData(reader.data()) {
+            if (!readVectorHeader(&reader)) {
+                return;
+            }
+            mPool = std::make_unique<SparseBitSet::PagePool>(&reader);
+            uint32_t familyCount;
+            std::tie(mFamilyOffsets, familyCount) = reader.readArray<uint32_t>();
+            std::tie(mCollectionOffsets, mCollectionCount) = reader.readArray<uint32_t>();
+            mFamilies.resize(familyCount);
+            mCollections.resize(mCollectionCount);
+        }
+
+        // Returns the number of the collections, which is zero if the buffer is not of the
+        // version writeVector() writes.
+        uint32_t size() const { return mCollectionCount; }
+
+        std::shared_ptr<FontCollection> get(uint32_t index) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            std::shared_ptr<FontCollection>& collection = mCollections[index];
+            if (collection == nullptr) {
+                BufferReader reader(mData, mCollectionOffsets[index]);
+                readFamiliesLocked(reader);
+                collection.reset(new FontCollection(&reader, mFamilies));
+            }
+            return collection;
+        }
+
+    private:
+        // Reads the families the collection at the reader refers to, which the FontCollection
+        // constructor expects to be read.
+        void readFamiliesLocked(BufferReader reader) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            reader.skip<uint32_t>();  // mMaxChar
+            uint32_t familiesCount = reader.read<uint32_t>();
+            for (uint32_t i = 0; i < familiesCount; i++) {
+                uint32_t index = reader.read<uint32_t>();
+                if (index < mFamilies.size() && mFamilies[index] == nullptr) {
+                    BufferReader familyReader(mData, mFamilyOffsets[index]);
+                    mFamilies[index] =
+                            FontFamily::readFrom<typefaceReader>(&familyReader, mPool.get());
+                }
+            }
+        }
+
+        const void* mData;
+        std::unique_ptr<SparseBitSet::PagePool> mPool;
+        const uint32_t* mFamilyOffsets = nullptr;
+        const uint32_t* mCollectionOffsets = nullptr;
+        uint32_t mCollectionCount = 0;
+
+        std::mutex mMutex;
+        std::vector<std::shared_ptr<FontFamily>> mFamilies GUARDED_BY(mMutex);
+        std::vector<std::shared_ptr<FontCollection>> mCollections GUARDED_BY(mMutex);
+
+        MINIKIN_PREVENT_COPY_AND_ASSIGN(VectorReader);
+    };
+
+    // Returns true if the buffer of the given size holds font collections readVector() can read.
+    // readVector() doesn't check the buffer, so call this once on buffers which may not have been
+    // written by writeVector() of this version, e.g. files mapped from disk. The typeface
+    // metadata is only checked to be in the buffer.
+    static bool validateVector(const void* buffer, size_t size);
+
     // Helper class for representing font family match result in packed bits.
+    //
+    // Up to kInlineCapacity family indices are packed in the lower 56 bits and the size is in the
+    // highest 8 bits. Larger results keep the index of an interned copy of their family indices in
+    // the lower bits instead, so that equal results still have equal bits.
     struct FamilyMatchResult {
     public:
+        static constexpr uint8_t kInlineCapacity = 7;
+
         struct Builder {
         public:
             Builder() : mSize(0), mBits(0) {}
 
             Builder& add(uint8_t x) {
-                if (mSize >= 7) [[unlikely]] {
+                if (mSize < kInlineCapacity) [[likely]] {
+                    mBits = mBits | (static_cast<uint64_t>(x) << (8 * mSize));
+                } else {
+                    if (mSize >= MAX_FAMILY_COUNT) [[unlikely]] {
                         return *this;
                     }
-                mBits = mBits | (static_cast<uint64_t>(x) << (8 * mSize));
+                    if (mSize == kInlineCapacity) {
+                        for (uint8_t i = 0; i < kInlineCapacity; ++i) {
+                            mOverflow[i] = static_cast<uint8_t>(mBits >> (8 * i));
+                        }
+                    }
+                    mOverflow[mSize] = x;
+                }
                 mSize++;
                 return *this;
             }
@@ -102,12 +219,17 @@ public:
             bool empty() const { return size() == 0; }
 
             FamilyMatchResult build() {
+                if (mSize > kInlineCapacity) [[unlikely]] {
+                    return buildOverflow(mOverflow, mSize);
+                }
                 return FamilyMatchResult(mBits | (static_cast<uint64_t>(mSize) << 56));
             }
 
         private:
             uint8_t mSize;
             uint64_t mBits;
+            // All the family indices, only filled once there are more than kInlineCapacity.
+            uint8_t mOverflow[MAX_FAMILY_COUNT];
         };
 
         // Helper class for iterating FamilyMatchResult
@@ -138,6 +260,9 @@ public:
         inline uint8_t size() const { return static_cast<uint8_t>(mBits >> 56); }
 
         inline uint8_t operator[](uint32_t pos) const {
+            if (size() > kInlineCapacity) [[unlikely]] {
+                return getOverflow(mBits)[pos];
+            }
             return static_cast<uint8_t>(mBits >> (pos * 8));
         }
 
@@ -157,6 +282,14 @@ public:
 
     private:
         explicit FamilyMatchResult(uint64_t bits) : mBits(bits) {}
+
+        // Interns the family indices without taking a lock if they were interned before. If too
+        // many distinct large results were interned already, logs it once and returns the first
+        // kInlineCapacity indices packed inline.
+        static FamilyMatchResult buildOverflow(const uint8_t* indices, uint8_t size);
+        // Returns the interned family indices of a large result.
+        static const uint8_t* getOverflow(uint64_t bits);
+
         uint64_t mBits;
     };
 
@@ -178,6 +311,19 @@ public:
         return itemize(text, style, localeListId, familyVariant, text.size());
     }
 
+    // The runs of many texts in flat arrays. The runs of the i-th text are
+    // runs[offsets[i]..offsets[i + 1]), and their offsets are relative to the text.
+    struct ItemizedTexts {
+        std::vector<uint32_t> offsets;
+        std::vector<Run> runs;
+    };
+
+    // Performs the itemization of each text until its end, with the same locale list and variant.
+    // The contents of out are replaced, while its capacity is kept so that it can be reused.
+    void itemizeBatch(const U16StringPiece* texts, uint32_t textCount, FontStyle style,
+                      uint32_t localeListId, FamilyVariant familyVariant,
+                      ItemizedTexts* out) const;
+
     // Returns true if there is a glyph for the code point and variation selector pair.
     // Returns false if no fonts have a glyph for the code point and variation
     // selector pair, or invalid variation selector is passed.
@@ -186,27 +332,76 @@ public:
     // Get base font with fakery information (fake bold could affect metrics)
     FakedFont baseFontFaked(FontStyle style);
 
+    // Returns true if the closest match of the style in any of the families is a fake bold font,
+    // i.e. if the layouts with the style may use fake bold. The results are memoized per style.
+    bool hasFakeBold(FontStyle style) const;
+
     // Creates new FontCollection based on this collection while applying font variations. Returns
-    // nullptr if none of variations apply to this collection.
+    // nullptr if none of variations apply to this collection. The recently created collections
+    // are kept, so the same variation settings return the same collection instance.
     std::shared_ptr<FontCollection> createCollectionWithVariation(
             const std::vector<FontVariation>& variations);
 
-    const std::unordered_set<AxisTag>& getSupportedTags() const { return mSupportedAxes; }
+    // Creates a new collection of the families of this collection followed by the given ones,
+    // e.g. downloaded or custom fallback families. Unlike the constructors, only the coverage of
+    // the new families is scanned to build the per-page family tables.
+    std::shared_ptr<FontCollection> createCollectionWithFamilies(
+            const std::vector<std::shared_ptr<FontFamily>>& families) const;
+
+    // Returns the axes supported by any of the families. The set is built on the first call,
+    // isAxisSupported() and getSortedSupportedTags() don't need it.
+    const std::unordered_set<AxisTag>& getSupportedTags() const;
+    // Returns the axes supported by any of the families in ascending order.
+    const std::vector<AxisTag>& getSortedSupportedTags() const { return mSupportedAxes; }
+    bool isAxisSupported(AxisTag tag) const {
+        return std::binary_search(mSupportedAxes.begin(), mSupportedAxes.end(), tag);
+    }
 
     uint32_t getId() const;
 
+    // Returns the collection ID the layouts of the text are cached with. This is getId(), unless
+    // the collection was created by createCollectionWithFamilies() and the appended families can't
+    // change the font fallback of the text. Then it is the ID of the oldest collection it was
+    // derived from with the same fallback, so that the text keeps its layouts in the cache.
+    uint32_t getLayoutCacheId(U16StringPiece text) const {
+        return mAncestors.empty() ? mId : getAncestorLayoutCacheId(text);
+    }
+
     const std::vector<std::shared_ptr<FontFamily>>& getFamilies() const { return mFamilies; }
 
+    // The statistics of the cache of the itemize results, for the texts up to
+    // MAX_ITEMIZE_CACHE_TEXT_LENGTH code units.
+    const CacheStats& getItemizeCacheStats() const;
+
+    static constexpr uint32_t MAX_ITEMIZE_CACHE_TEXT_LENGTH = 128;
+
+    // The statistics of the cache of the collections created by createCollectionWithVariation.
+    const CacheStats& getVariationCacheStats() const;
+
+    // The bytes of the collection, its family tables and its caches, including the collections
+    // kept by createCollectionWithVariation. The families are not counted, since they are shared
+    // between the collections.
+    size_t getMemoryUsage() const;
+
 private:
     FRIEND_TEST(FontCollectionTest, bufferTest);
+    FRIEND_TEST(FontCollectionTest, compressedRangesTest);
 
     FontCollection(BufferReader* reader,
                    const std::vector<std::shared_ptr<FontFamily>>& allFontFamilies);
+    // See createCollectionWithFamilies().
+    FontCollection(const FontCollection& parent,
+                   const std::vector<std::shared_ptr<FontFamily>>& families);
     // Write fields of the instance, using fontFamilyToIndexMap for finding
     // indices for FontFamily.
     void writeTo(BufferWriter* writer,
                  const std::unordered_map<std::shared_ptr<FontFamily>, uint32_t>&
                          fontFamilyToIndexMap) const;
+    // The header of the buffer written by writeVector(): a tag and the version of the layout.
+    static void writeVectorHeader(BufferWriter* writer);
+    // Returns false if the header is not the one writeVectorHeader() writes.
+    static bool readVectorHeader(BufferReader* reader);
+
     static void collectAllFontFamilies(
             const std::vector<std::shared_ptr<FontCollection>>& fontCollections,
             std::vector<std::shared_ptr<FontFamily>>* outAllFontFamilies,
@@ -214,6 +409,8 @@ private:
 
     static const int kLogCharsPerPage = 8;
     static const int kPageMask = (1 << kLogCharsPerPage) - 1;
+    // Smaller blocks of pages are not worth a thread in the parallel init.
+    static const uint32_t kMinPagesPerThread = 64;
 
     // mFamilyVec holds the indices of the mFamilies and mRanges holds the range of indices of
     // mFamilyVec. The maximum number of pages is 0x10FF (U+10FFFF >> 8). The maximum number of
@@ -225,16 +422,45 @@ private:
         uint16_t end;
     };
 
+    // The ranges of the pages are stored in blocks of kPagesPerBlock pages, and the blocks with
+    // the same ranges, e.g. of the empty astral pages or the fully covered CJK pages, are stored
+    // once. The pages with the same families share their indices in mFamilyVec, so that the
+    // blocks of such pages are the same.
+    static const int kLogPagesPerBlock = 4;
+    static const uint32_t kPagesPerBlock = 1 << kLogPagesPerBlock;
+
+    // Returns the range of the families of the page, which must be below the page of mMaxChar.
+    const Range& getRange(uint32_t page) const {
+        return mRanges[mBlockIndices[page >> kLogPagesPerBlock] + (page & (kPagesPerBlock - 1))];
+    }
+
+    // Builds the block tables and the shared mFamilyVec from the ranges of each page, which are
+    // ranges of familyVec.
+    void compressRanges(const Range* pageRanges, uint32_t pageCount,
+                        const std::vector<uint8_t>& familyVec);
+
     // Initialize the FontCollection.
-    void init(const std::vector<std::shared_ptr<FontFamily>>& typefaces);
+    void init(const std::vector<std::shared_ptr<FontFamily>>& typefaces, uint32_t threadCount);
+
+    // Builds the ranges of the pages [firstPage, lastPage) into ranges, and appends the family
+    // indices to familyVec. The indices in the ranges start from zero.
+    static void buildRanges(const std::vector<std::shared_ptr<FontFamily>>& families,
+                            uint32_t firstPage, uint32_t lastPage, Range* ranges,
+                            std::vector<uint8_t>* familyVec);
+
+    // Returns true if the first family covers U+0020..U+007E.
+    bool firstFamilyCoversPrintableAscii() const;
 
-    FamilyMatchResult getFamilyForChar(uint32_t ch, uint32_t vs, uint32_t localeListId,
+    // The memo of calcLocaleMatchingScore for one locale list. Defined in FontCollection.cpp.
+    class LocaleScores;
+
+    FamilyMatchResult getFamilyForChar(uint32_t ch, uint32_t vs, LocaleScores* localeScores,
                                        FamilyVariant variant) const;
 
-    uint32_t calcFamilyScore(uint32_t ch, uint32_t vs, FamilyVariant variant, uint32_t localeListId,
-                             const std::shared_ptr<FontFamily>& fontFamily) const;
+    uint32_t calcFamilyScore(uint32_t ch, uint32_t vs, FamilyVariant variant,
+                             LocaleScores* localeScores, uint8_t familyIndex) const;
 
-    uint32_t calcCoverageScore(uint32_t ch, uint32_t vs, uint32_t localeListId,
+    uint32_t calcCoverageScore(uint32_t ch, uint32_t vs, const LocaleScores& localeScores,
                                const std::shared_ptr<FontFamily>& fontFamily) const;
 
     static uint32_t calcLocaleMatchingScore(uint32_t userLocaleListId,
@@ -242,6 +468,32 @@ private:
 
     static uint32_t calcVariantMatchingScore(FamilyVariant variant, const FontFamily& fontFamily);
 
+    // Builds mVSCoverage from mVSFamilyVec.
+    void initVSCoverage();
+
+    // Returns true if any family covers the code point.
+    bool isCovered(uint32_t ch) const;
+
+    // Returns true if any family has a glyph for the variation sequence, from mVSCoverage.
+    bool isVariationSequenceCovered(uint32_t baseCodepoint, uint32_t variationSelector) const;
+
+    // The slow path of getLayoutCacheId() for the collections with ancestors.
+    uint32_t getAncestorLayoutCacheId(U16StringPiece text) const;
+
+    // Appends the runs of the text to out.
+    void itemizeAppend(U16StringPiece text, uint32_t localeListId, FamilyVariant familyVariant,
+                       uint32_t runMax, std::vector<Run>* out) const;
+    void itemizeUncached(U16StringPiece text, uint32_t localeListId, FamilyVariant familyVariant,
+                         uint32_t runMax, std::vector<Run>* out) const;
+
+    // The memo of getFamilyForChar for one locale list and variant. Defined in FontCollection.cpp.
+    class FallbackTable;
+    class FallbackTables;
+
+    // Same as getFamilyForChar but looks up and fills the table first if it is not null.
+    FamilyMatchResult getFamilyForChar(FallbackTable* table, uint32_t ch, uint32_t vs,
+                                       LocaleScores* localeScores, FamilyVariant variant) const;
+
     // unique id for this font collection (suitable for cache key)
     uint32_t mId;
 
@@ -252,12 +504,15 @@ private:
     // This vector can't be empty.
     std::vector<std::shared_ptr<FontFamily>> mFamilies;
 
-    // Following two vectors are pre-calculated tables for resolving coverage faster.
+    // Following vectors are pre-calculated tables for resolving coverage faster.
     // For example, to iterate over all fonts which support Unicode code point U+XXYYZZ,
-    // iterate font families index from mFamilyVec[mRanges[0xXXYY].start] to
-    // mFamilyVec[mRange[0xXXYY].end] instead of whole mFamilies.
-    // This vector contains indices into mFamilies.
-    // This vector can't be empty.
+    // iterate font families index from mFamilyVec[getRange(0xXXYY).start] to
+    // mFamilyVec[getRange(0xXXYY).end] instead of whole mFamilies.
+    // mBlockIndices holds the index in mRanges of the first page of each block of pages.
+    // mFamilyVec contains indices into mFamilies.
+    // These vectors can't be empty.
+    uint32_t mBlockIndicesCount;
+    const uint16_t* mBlockIndices;
     uint32_t mRangesCount;
     const Range* mRanges;
     uint32_t mFamilyVecCount;
@@ -266,13 +521,53 @@ private:
     // This vector has pointers to the font family instances which have cmap 14 subtables.
     std::vector<std::shared_ptr<FontFamily>> mVSFamilyVec;
 
-    // Set of supported axes in this collection.
-    std::unordered_set<AxisTag> mSupportedAxes;
+    // The union of the variation sequence coverage of the families in mVSFamilyVec, indexed by the
+    // variation selector index. Entries are nullptr if no family has sequences for the selector.
+    std::vector<std::unique_ptr<SparseBitSet>> mVSCoverage;
+
+    // The axes supported by any of the families in ascending order. A collection usually supports
+    // a few axes, so a binary search in a vector is faster than a hash set and needs no node
+    // allocations.
+    std::vector<AxisTag> mSupportedAxes;
+    // The supported axes as returned by getSupportedTags(), built on its first call.
+    mutable std::unordered_set<AxisTag> mSupportedAxesSet;
+    mutable std::once_flag mSupportedAxesSetOnce;
+
+    // True if the first family covers the printable ASCII characters, i.e. any text of them is
+    // itemized into a single run of the first family.
+    bool mFirstFamilyCoversPrintableAscii;
+
+    // The collections this one was derived from by createCollectionWithFamilies(), oldest first.
+    // The families of an ancestor are the first familyCount families of this collection.
+    struct Ancestor {
+        uint32_t id;
+        uint32_t familyCount;
+    };
+    std::vector<Ancestor> mAncestors;
 
     // Owns allocated memory if this class is created from font families, otherwise these are
-    // nullptr.
-    std::unique_ptr<Range[]> mOwnedRanges;
+    // empty.
+    std::vector<uint16_t> mOwnedBlockIndices;
+    std::vector<Range> mOwnedRanges;
     std::vector<uint8_t> mOwnedFamilyVec;
+
+    // The recent results of itemize for short texts. Defined in FontCollection.cpp.
+    class ItemizeCache;
+    std::unique_ptr<ItemizeCache> mItemizeCache;
+
+    // The lazily built fallback tables, at most one per locale list and variant, and the locale
+    // scores, at most one per locale list.
+    std::unique_ptr<FallbackTables> mFallbackTables;
+
+    // The collections recently created from this collection with variations. Defined in
+    // FontCollection.cpp.
+    class VariationCache;
+    std::unique_ptr<VariationCache> mVariationCache;
+
+    // A direct-mapped cache of the hasFakeBold() results. An entry is
+    // (FontStyle::identifier() << 32 | kFakeBoldCacheValid | fake bold), or zero if empty.
+    static constexpr size_t kFakeBoldCacheSize = 8;
+    mutable std::atomic<uint64_t> mFakeBoldCache[kFakeBoldCacheSize] = {};
 };
 
 }  // namespace minikin
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FONT_COVERAGE_CACHE_H
+#define MINIKIN_FONT_COVERAGE_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <utils/LruCache.h>
+
+#include "minikin/Hasher.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Holds the precomputed coverage of font files, keyed by the file path and the index in the file,
+// so that FontFamily doesn't need to parse the cmap table of the fonts that were seen before.
+//
+// A blob records the size and the revision of the file it was computed for, and FontFamily
+// re-parses the cmap if they don't match. When a cmap is parsed, the new blob is stored here, so
+// that the caller can save it, e.g. as a sidecar file, and give it back with putBlob() in the
+// next process. Up to kMaxEntries blobs are kept, evicting the least recently used one.
+class FontCoverageCache {
+public:
+    // Enough for the fonts of a system font configuration.
+    static constexpr uint32_t kMaxEntries = 512;
+
+    static void putBlob(const std::string& path, int index, std::vector<uint8_t>&& blob) {
+        getInstance().putBlobInternal(path, index, std::move(blob));
+    }
+
+    // Returns nullptr if no blob is known for the font.
+    static std::shared_ptr<const std::vector<uint8_t>> getBlob(const std::string& path,
+                                                               int index) {
+        return getInstance().getBlobInternal(path, index);
+    }
+
+    static void clear() { getInstance().clearInternal(); }
+
+protected:
+    // Visible for testing purposes.
+    FontCoverageCache() : mBlobs(kMaxEntries) {}
+    virtual ~FontCoverageCache() {}
+
+    void putBlobInternal(const std::string& path, int index, std::vector<uint8_t>&& blob);
+    std::shared_ptr<const std::vector<uint8_t>> getBlobInternal(const std::string& path,
+                                                                int index);
+    void clearInternal();
+
+private:
+    struct Key {
+        std::string path;
+        int index;
+
+        bool operator==(const Key& o) const { return index == o.index && path == o.path; }
+    };
+    friend android::hash_t hash_type(const Key& key) {
+        return Hasher().updateString(key.path).update(static_cast<int32_t>(key.index)).hash();
+    }
+
+    static FontCoverageCache& getInstance();
+
+    android::LruCache<Key, std::shared_ptr<const std::vector<uint8_t>>> mBlobs GUARDED_BY(mMutex);
+    std::mutex mMutex;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(FontCoverageCache);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FONT_COVERAGE_CACHE_H
@@ -17,7 +17,9 @@
 #ifndef MINIKIN_FONT_FAMILY_H
 #define MINIKIN_FONT_FAMILY_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -38,8 +40,10 @@ public:
     FontFamily(uint32_t localeListId, FamilyVariant variant,
                std::vector<std::shared_ptr<Font>>&& fonts, bool isCustomFallback);
 
+    // The coverage is read with the pool if it is not null, see writeTo().
     template <Font::TypefaceReader typefaceReader>
-    static std::shared_ptr<FontFamily> readFrom(BufferReader* reader) {
+    static std::shared_ptr<FontFamily> readFrom(BufferReader* reader,
+                                                const SparseBitSet::PagePool* pool = nullptr) {
         uint32_t localeListId = readLocaleListInternal(reader);
         uint32_t fontsCount = reader->read<uint32_t>();
         std::vector<std::shared_ptr<Font>> fonts;
@@ -47,19 +51,28 @@ public:
         for (uint32_t i = 0; i < fontsCount; i++) {
             fonts.emplace_back(Font::readFrom<typefaceReader>(reader, localeListId));
         }
-        return readFromInternal(reader, std::move(fonts), localeListId);
+        return readFromInternal(reader, std::move(fonts), localeListId, pool);
     }
 
+    // The coverage refers to the pages in the pool if it is not null and the family was added to
+    // it with addCoverageTo().
     template <Font::TypefaceWriter typefaceWriter>
-    void writeTo(BufferWriter* writer) const {
+    void writeTo(BufferWriter* writer, const SparseBitSet::PagePool* pool = nullptr) const {
         writeLocaleListInternal(writer);
         writer->write<uint32_t>(mFonts.size());
         for (const std::shared_ptr<Font>& font : mFonts) {
             font->writeTo<typefaceWriter>(writer);
         }
-        writeToInternal(writer);
+        writeToInternal(writer, pool);
     }
 
+    // Adds the pages of the coverage to the pool.
+    void addCoverageTo(SparseBitSet::PagePool* pool) const;
+
+    // Checks that the buffer holds a family readFrom() can read, with a pool of
+    // poolBitmapsCount elements if the family was written with one.
+    static void validate(BufferValidator* validator, uint32_t poolBitmapsCount = 0);
+
     FakedFont getClosestMatch(FontStyle style) const;
 
     uint32_t localeListId() const { return mLocaleListId; }
@@ -71,18 +84,39 @@ public:
     const std::shared_ptr<Font>& getFontRef(size_t index) const { return mFonts[index]; }
     FontStyle getStyle(size_t index) const { return mFonts[index]->style(); }
     bool isColorEmojiFamily() const { return mIsColorEmoji; }
-    const std::unordered_set<AxisTag>& supportedAxes() const { return mSupportedAxes; }
+    // Returns the supported axes. The set is built on the first call, isAxisSupported() and
+    // getSortedSupportedAxes() don't need it.
+    const std::unordered_set<AxisTag>& supportedAxes() const;
+    // Returns a copy of the supported axes in ascending order.
+    std::vector<AxisTag> getSortedSupportedAxes() const {
+        return std::vector<AxisTag>(mSupportedAxes, mSupportedAxes + mSupportedAxesCount);
+    }
+    bool isAxisSupported(AxisTag tag) const;
     bool isCustomFallback() const { return mIsCustomFallback; }
 
     // Get Unicode coverage.
-    const SparseBitSet& getCoverage() const { return mCoverage; }
+    const SparseBitSet& getCoverage() const { return mCoverage->coverage; }
 
     // Returns true if the font has a glyph for the code point and variation selector pair.
     // Caller should acquire a lock before calling the method.
     bool hasGlyph(uint32_t codepoint, uint32_t variationSelector) const;
 
     // Returns true if this font family has a variaion sequence table (cmap format 14 subtable).
-    bool hasVSTable() const { return !mCmapFmt14Coverage.empty(); }
+    bool hasVSTable() const { return !mCoverage->cmapFmt14Coverage.empty(); }
+
+    // Get the coverage of the variation sequences, indexed by the variation selector index.
+    // Entries are nullptr for the variation selectors without sequences.
+    const std::vector<std::unique_ptr<SparseBitSet>>& getVSCoverage() const {
+        return mCoverage->cmapFmt14Coverage;
+    }
+
+    // The bytes of the family itself, not counting the fonts and the coverage.
+    size_t getMemoryUsage() const;
+
+    // The bytes of the coverage and the variation sequence coverage, which are shared between
+    // the families created by createFamilyWithVariation(), i.e. the families with the same
+    // address of getCoverage().
+    size_t getCoverageMemoryUsage() const;
 
     // Creates new FontFamily based on this family while applying font variations. Returns nullptr
     // if none of variations apply to this family.
@@ -92,32 +126,72 @@ public:
 private:
     FontFamily(uint32_t localeListId, FamilyVariant variant,
                std::vector<std::shared_ptr<Font>>&& fonts,
-               std::unordered_set<AxisTag>&& supportedAxes, bool isColorEmoji,
+               const AxisTag* supportedAxes, uint32_t supportedAxesCount, bool isColorEmoji,
                bool isCustomFallback, SparseBitSet&& coverage,
                std::vector<std::unique_ptr<SparseBitSet>>&& cmapFmt14Coverage);
+    // Creates a family of the given fonts, which are the variation instances of the fonts of the
+    // base family. Font variations don't change cmap, so the coverage is shared with the base.
+    FontFamily(const FontFamily& base, std::vector<std::shared_ptr<Font>>&& fonts);
 
     static uint32_t readLocaleListInternal(BufferReader* reader);
     static std::shared_ptr<FontFamily> readFromInternal(BufferReader* reader,
                                                         std::vector<std::shared_ptr<Font>>&& fonts,
-                                                        uint32_t localeListId);
+                                                        uint32_t localeListId,
+                                                        const SparseBitSet::PagePool* pool);
     void writeLocaleListInternal(BufferWriter* writer) const;
-    void writeToInternal(BufferWriter* writer) const;
+    void writeToInternal(BufferWriter* writer, const SparseBitSet::PagePool* pool) const;
 
     void computeCoverage();
+    static size_t matchCacheSlot(FontStyle style);
+    void setOwnedSupportedAxes(const std::vector<AxisTag>& sortedAxes);
 
     uint32_t mLocaleListId;
     FamilyVariant mVariant;
     std::vector<std::shared_ptr<Font>> mFonts;
-    std::unordered_set<AxisTag> mSupportedAxes;
+    // The supported axes in ascending order. Points into the buffer if created by readFrom(),
+    // otherwise into mOwnedSupportedAxes.
+    const AxisTag* mSupportedAxes;
+    uint32_t mSupportedAxesCount;
+    std::unique_ptr<AxisTag[]> mOwnedSupportedAxes;
+    // The supported axes as returned by supportedAxes(), built on its first call.
+    mutable std::unordered_set<AxisTag> mSupportedAxesSet;
+    mutable std::once_flag mSupportedAxesSetOnce;
     bool mIsColorEmoji;
     bool mIsCustomFallback;
 
-    SparseBitSet mCoverage;
-    std::vector<std::unique_ptr<SparseBitSet>> mCmapFmt14Coverage;
+    struct Coverage {
+        SparseBitSet coverage;
+        std::vector<std::unique_ptr<SparseBitSet>> cmapFmt14Coverage;
+        // The precomputed coverage blob the sets point into, if they were read from one.
+        std::shared_ptr<const std::vector<uint8_t>> blob;
+    };
+    // Never null. Shared between the families created by createFamilyWithVariation.
+    std::shared_ptr<const Coverage> mCoverage;
+
+    // A direct-mapped cache of the getClosestMatch() results. The fonts never change, so an entry
+    // only needs the index of the font and the fakery.
+    static constexpr size_t kMatchCacheSize = 8;
+    mutable std::atomic<uint64_t> mMatchCache[kMatchCacheSize] = {};
 
     MINIKIN_PREVENT_COPY_AND_ASSIGN(FontFamily);
 };
 
+// The fonts and the attributes of a family for buildFontFamilies(). There must be at least one
+// font.
+struct FontFamilySpec {
+    std::vector<Font::Builder> fonts;
+    uint32_t localeListId = kEmptyLocaleListId;
+    FamilyVariant variant = FamilyVariant::DEFAULT;
+    bool isCustomFallback = false;
+};
+
+// Builds the families of the specs on up to maxThreads threads, including the calling one and the
+// foreground tasks of getExecutor(), or on all of its threads if maxThreads is 0. All the fonts are
+// built first, which reads their styles, and then the families, which computes their coverage.
+// Returns the families in the order of the specs, the same as building them one after another.
+std::vector<std::shared_ptr<FontFamily>> buildFontFamilies(const std::vector<FontFamilySpec>& specs,
+                                                           uint32_t maxThreads = 0);
+
 }  // namespace minikin
 
 #endif  // MINIKIN_FONT_FAMILY_H
@@ -17,18 +17,25 @@
 #ifndef MINIKIN_FONT_FILE_PARSER_H
 #define MINIKIN_FONT_FILE_PARSER_H
 
+#include "minikin/FontStyle.h"
+#include "minikin/FontVariation.h"
 #include "minikin/HbUtils.h"
 
 #include <optional>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace minikin {
 
-// FontFileParser provides various parser logic for OpenType font file.
+// FontFileParser provides various parser logic for OpenType font file. The table directory of the
+// font is parsed once on construction, and the table queries are served from it.
 class FontFileParser {
 public:
     // This class does not take an ownership of buffer. Caller must free it.
     FontFileParser(const void* buffer, size_t size, uint32_t index);
+    // The table directory is read from the font file of the face. If the face has no font file,
+    // e.g. it is created for tables, the tables are looked up through the face instead.
     explicit FontFileParser(const HbFaceUniquePtr& face);
     explicit FontFileParser(const HbFontUniquePtr& font);
 
@@ -38,12 +45,50 @@ public:
     std::optional<std::string> getPostScriptName() const;
     std::optional<bool> isPostScriptType1Font() const;
 
+    // Returns the weight and the slant in the OS/2 table.
+    std::optional<FontStyle> getStyle() const;
+    // Returns the axes in the fvar table, or an empty set if the font has no valid fvar table.
+    std::unordered_set<AxisTag> getSupportedAxes() const;
+    // Same as getSupportedAxes(), in ascending order.
+    std::vector<AxisTag> getSortedSupportedAxes() const;
+
 protected:  // protected for testing purposes.
+    // An entry of the table directory. The table is clamped to the file.
+    struct TableRecord {
+        uint32_t tag;
+        uint32_t offset;
+        uint32_t length;
+    };
+
     static bool analyzeFontRevision(const uint8_t* head_data, size_t head_size, uint32_t* out);
     static bool checkPSName(const std::string& psName);
+    // Parses the table directory of the font at the index of the file into the records sorted by
+    // tag. Returns false if the file has no such font.
+    static bool parseTableDirectory(const uint8_t* data, size_t size, uint32_t index,
+                                    std::vector<TableRecord>* out);
 
 private:
+    // A table of the font. Points into the font file, or into the blob of the table if the file
+    // is not available.
+    struct Table {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        HbBlobUniquePtr blob;
+
+        explicit operator bool() const { return size > 0; }
+    };
+
+    void init(const void* buffer, size_t size, uint32_t index);
+    Table getTable(uint32_t tag) const;
+
     HbFaceUniquePtr mFace;
+    // The font file, if available.
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    // Keeps the font file of the face alive.
+    HbBlobUniquePtr mFileBlob;
+    bool mHasTableDirectory = false;
+    std::vector<TableRecord> mTables;
 
     static HbFaceUniquePtr makeHbFace(const void* buffer, size_t size, uint32_t index);
 };
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FONT_PRELOADER_H
+#define MINIKIN_FONT_PRELOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "minikin/Font.h"
+#include "minikin/FontCollection.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Loads the lazily loaded fonts, i.e. the ones created by Font::readFrom(), in a background task of
+// getExecutor() ahead of their first use. A layout that needs a font while it is being loaded
+// waits for that load instead of starting another one.
+class FontPreloader {
+public:
+    static void preload(const std::shared_ptr<Font>& font) { getInstance().preloadInternal(font); }
+
+    // Preloads the default style font of the families in the collection whose locales match the
+    // locale list, e.g. the CJK fonts for the Japanese locale.
+    static void preloadForLocales(const FontCollection& collection, uint32_t localeListId) {
+        getInstance().preloadForLocalesInternal(collection, localeListId);
+    }
+
+protected:
+    // Visible for testing purposes.
+    FontPreloader();
+    virtual ~FontPreloader();
+
+    void preloadInternal(const std::shared_ptr<Font>& font);
+    void preloadForLocalesInternal(const FontCollection& collection, uint32_t localeListId);
+
+    // Blocks until all the requested fonts are loaded.
+    void waitForIdle();
+
+private:
+    static FontPreloader& getInstance();
+
+    void run();
+
+    // Queues the fonts, and posts the task loading the queue unless it is posted or running.
+    void enqueue(std::vector<std::shared_ptr<Font>>&& fonts);
+
+    std::deque<std::shared_ptr<Font>> mQueue GUARDED_BY(mMutex);
+    // True while the task loading the queue is posted or running.
+    bool mIsLoading GUARDED_BY(mMutex);
+    bool mIsStopping GUARDED_BY(mMutex);
+    std::condition_variable mCondition;
+    std::mutex mMutex;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(FontPreloader);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FONT_PRELOADER_H
@@ -58,6 +58,11 @@ public:
         writer->write<uint8_t>(static_cast<uint8_t>(mSlant));
     }
 
+    static void validate(BufferValidator* validator) {
+        validator->skip<uint16_t>();
+        validator->skip<uint8_t>();
+    }
+
     constexpr uint16_t weight() const { return mWeight; }
     constexpr Slant slant() const { return mSlant; }
 
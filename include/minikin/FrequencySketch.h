@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FREQUENCY_SKETCH_H
+#define MINIKIN_FREQUENCY_SKETCH_H
+
+#include <cstdint>
+#include <vector>
+
+namespace minikin {
+
+// An approximate count of the recent accesses to the keys of a cache, used to decide whether a
+// new entry is worth evicting an older one (TinyLFU admission).
+//
+// This is a count-min sketch of 4-bit counters: a key is counted by four counters, one per row,
+// and its frequency is the smallest of them. The counters saturate at 15 and are all halved
+// once the sketch has counted ten times its capacity, so that old popularity fades away.
+//
+// The sketch is not thread safe. The caller guards it with the lock of its cache.
+class FrequencySketch {
+public:
+    // The capacity is the number of entries of the cache. The table uses 8 bytes per entry.
+    explicit FrequencySketch(uint32_t capacity);
+
+    // Counts an access to the key of the hash.
+    void increment(uint32_t hash);
+
+    // Returns the estimated number of recent accesses to the key of the hash, at most 15.
+    uint32_t frequency(uint32_t hash) const;
+
+private:
+    // Halves all the counters.
+    void reset();
+
+    std::vector<uint64_t> mTable;
+    uint32_t mMask;
+    uint32_t mSampleSize;
+    uint32_t mAdditions;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FREQUENCY_SKETCH_H
@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace minikin {
 
@@ -33,6 +34,12 @@ public:
     static bool isGraphemeBreak(const float* advances, const uint16_t* buf, size_t start,
                                 size_t count, size_t offset);
 
+    // Returns isGraphemeBreak(advances, buf, start, count, offset) for each offset in
+    // [start, start + count], indexed by offset - start. The text is decoded in a single pass, so
+    // this is faster than calling isGraphemeBreak for every offset.
+    static std::vector<bool> computeGraphemeBreaks(const float* advances, const uint16_t* buf,
+                                                   size_t start, size_t count);
+
     // Matches Android's Java API. Note, return (size_t)-1 for AT to
     // signal non-break because unsigned return type.
     static size_t getTextRunCursor(const float* advances, const uint16_t* buf, size_t start,
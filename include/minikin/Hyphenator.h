@@ -37,6 +37,11 @@ class Hyphenator;
 void addHyphenator(const std::string& localeStr, const Hyphenator* hyphenator);
 void addHyphenatorAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr);
 
+// Maps the hyb file at path with Hyphenator::loadFromFile and registers it for the locale.
+// Returns false if the file can't be loaded.
+bool addHyphenatorFromFile(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                           size_t minSuffix);
+
 enum class HyphenationType : uint8_t {
     // Note: There are implicit assumptions scattered in the code that DONT_BREAK is 0.
 
@@ -190,6 +195,13 @@ public:
         return hyphenate(word, out->data());
     }
 
+    // Computes the hyphenation of the words of a paragraph, the ranges of the text, storing the
+    // hyphenation of each word at the offset of its range in out, which must have at least the
+    // length of the text. The entries of out outside of the words are left untouched. Unlike
+    // calling hyphenate for each word, the buffer for the alphabet codes is set up once.
+    void hyphenate(const U16StringPiece& text, const std::vector<Range>& words,
+                   HyphenationType* out) const;
+
     // Returns true if the codepoint is like U+2010 HYPHEN in line breaking and usage: a character
     // immediately after which line breaks are allowed, but words containing it should not be
     // automatically hyphenated.
@@ -205,6 +217,31 @@ public:
     static Hyphenator* loadBinary(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                                   const std::string& locale);
 
+    // Maps the hyb file at path read-only and creates a Hyphenator on top of it, so the pattern
+    // pages are demand-paged and shared with other processes mapping the same file. The mapping
+    // is never released. Returns nullptr if the file can't be mapped or is not a valid hyb file.
+    static Hyphenator* loadFromFile(const std::string& path, size_t minPrefix, size_t minSuffix,
+                                    const std::string& locale);
+
+    // Returns true if the size bytes of data start with the hyb magic and contain all the tables
+    // the header points to.
+    static bool isValidBinary(const uint8_t* data, size_t size);
+
+    // The line breakers don't hyphenate words longer than this many UTF-16 code units and break
+    // them at grapheme bounds instead, since the hyphenation cost grows with the word length.
+    // The default is DEFAULT_LONGEST_HYPHENATED_WORD. This is a process-wide setting.
+    static void setLongestHyphenatedWord(size_t length);
+    static size_t getLongestHyphenatedWord();
+
+    static constexpr size_t DEFAULT_LONGEST_HYPHENATED_WORD = 45;
+
+    // The bytes of the hyphenator and of the tables it builds at load time, not counting the
+    // pattern data.
+    size_t getMemoryUsage() const;
+
+    // The size of the pattern data, which the hyphenator doesn't own, or zero if it has none.
+    size_t getPatternDataSize() const;
+
 private:
     enum class HyphenationLocale : uint8_t {
         OTHER = 0,
@@ -217,6 +254,17 @@ private:
     Hyphenator(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                HyphenationLocale hyphenLocale);
 
+    // Returns true if a word of len code units is hyphenated with the patterns, as long as all its
+    // code units are in the alphabet.
+    bool usesPatterns(size_t len) const {
+        return mPatternData != nullptr && len >= mMinPrefix + mMinSuffix;
+    }
+
+    // Same as hyphenate, using codes for the alphabet codes of the word. codes must hold
+    // word.size() + 2 entries if usesPatterns(word.size()), and is not used otherwise.
+    void hyphenateWithCodes(const U16StringPiece& word, uint16_t* codes,
+                            HyphenationType* out) const;
+
     // apply various hyphenation rules including hard and soft hyphens, ignoring patterns
     void hyphenateWithNoPatterns(const U16StringPiece& word, HyphenationType* out) const;
 
@@ -226,19 +274,31 @@ private:
     // Note that this method writes len+2 entries into alpha_codes (including start and stop)
     HyphenationType alphabetLookup(uint16_t* alpha_codes, const U16StringPiece& word) const;
 
+    // Build mAlphabetPageIndex and mAlphabetPages from the general version of the alphabet table.
+    // Entries with the value 0 are treated as unmapped, which matches what mk_hyb_file.py emits.
+    void buildAlphabetPages();
+
     // calculate hyphenation from patterns, assuming alphabet lookup has already been done
     void hyphenateFromCodes(const uint16_t* codes, size_t len, HyphenationType hyphenValue,
                             HyphenationType* out) const;
 
-    // See also LONGEST_HYPHENATED_WORD in LineBreaker.cpp. Here the constant is used so
-    // that temporary buffers can be stack-allocated without waste, which is a slightly
-    // different use case. It measures UTF-16 code units.
+    // See also getLongestHyphenatedWord. Here the constant is used so that temporary buffers for
+    // most words can be stack-allocated without waste. Longer words use a thread-local buffer.
+    // It measures UTF-16 code units.
     static const size_t MAX_HYPHENATED_SIZE = 64;
 
     const uint8_t* mPatternData;
     const size_t mMinPrefix, mMinSuffix;
     const HyphenationLocale mHyphenationLocale;
 
+    // Two-level direct lookup table for the general version of the alphabet table, built at load
+    // time. The alpha code of code unit c is
+    // mAlphabetPages[(mAlphabetPageIndex[c >> 8] << 8) | (c & 0xFF)], 0 meaning unmapped. Page 0
+    // is all zeros and shared by all the pages without any mapped code unit, so the index goes up
+    // to 256 and doesn't fit into uint8_t if every page has a mapped code unit.
+    std::vector<uint16_t> mAlphabetPageIndex;
+    std::vector<uint16_t> mAlphabetPages;
+
     // accessors for binary data
     const Header* getHeader() const { return reinterpret_cast<const Header*>(mPatternData); }
 };
@@ -17,6 +17,7 @@
 #ifndef MINIKIN_LAYOUT_H
 #define MINIKIN_LAYOUT_H
 
+#include <functional>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -33,16 +34,6 @@ namespace minikin {
 class Layout;
 struct LayoutPieces;
 
-struct LayoutGlyph {
-    LayoutGlyph(FakedFont font, uint32_t glyph_id, float x, float y)
-            : font(font), glyph_id(glyph_id), x(x), y(y) {}
-    FakedFont font;
-
-    uint32_t glyph_id;
-    float x;
-    float y;
-};
-
 // Must be the same value with Paint.java
 enum class Bidi : uint8_t {
     LTR = 0b0000,          // Must be same with Paint.BIDI_LTR
@@ -60,36 +51,131 @@ inline bool isOverride(Bidi bidi) {
     return static_cast<uint8_t>(bidi) & 0b0100;
 }
 
+// The results computed by Layout. The callers which only draw or only measure skip the other half.
+enum class LayoutMode : uint8_t {
+    // The glyphs and the advances per code unit.
+    ALL = 0,
+    // Only the glyphs and the total advance. advances() is empty.
+    GLYPHS_ONLY = 1,
+    // Only the advances per code unit and the total advance. nGlyphs() is zero.
+    ADVANCES_ONLY = 2,
+};
+
 // Lifecycle and threading assumptions for Layout:
 // The object is assumed to be owned by a single thread; multiple threads
 // may not mutate it at the same time.
 class Layout {
 public:
     Layout(const U16StringPiece& str, const Range& range, Bidi bidiFlags, const MinikinPaint& paint,
-           StartHyphenEdit startHyphen, EndHyphenEdit endHyphen)
-            : mAdvance(0) {
+           StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, LayoutMode mode = LayoutMode::ALL)
+            : mMode(mode), mAdvance(0) {
         doLayout(str, range, bidiFlags, paint, startHyphen, endHyphen);
     }
 
-    Layout(uint32_t count) : mAdvance(0) {
+    Layout(uint32_t count) : mMode(LayoutMode::ALL), mAdvance(0) {
         mAdvances.resize(count, 0);
-        mGlyphs.reserve(count);
+        reserveGlyphs(count);
+    }
+
+    // Replaces the contents with the layout of the text. The arrays keep their capacity, so
+    // laying out a text no longer than the previous ones doesn't allocate, e.g. for the draw
+    // calls reusing one layout.
+    void relayout(const U16StringPiece& str, const Range& range, Bidi bidiFlags,
+                  const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                  LayoutMode mode = LayoutMode::ALL) {
+        reset(range.getLength(), mode);
+        doLayout(str, range, bidiFlags, paint, startHyphen, endHyphen);
+    }
+
+    // Empties the layout for appending the layout of a text of count code units with
+    // appendLayout(), keeping the capacity of the arrays. The advances are zeros like the ones of
+    // Layout(count) if the mode has advances.
+    void reset(uint32_t count, LayoutMode mode = LayoutMode::ALL) {
+        mMode = mode;
+        mFonts.clear();
+        mFontIndices.clear();
+        mGlyphIds.clear();
+        mPoints.clear();
+        mAdvances.assign(hasAdvances() ? count : 0, 0);
+        mAdvance = 0;
+    }
+
+    // Returns a layout of the calling thread to relayout() the texts drawn one after another, so
+    // that the steady state drawing allocates no layout arrays. Each user replaces the contents
+    // of the previous one, so the layout must not be kept across calls which may lay out text on
+    // the same thread.
+    static Layout& getThreadLocal() {
+        static thread_local Layout layout(0);
+        return layout;
     }
 
     static float measureText(const U16StringPiece& str, const Range& range, Bidi bidiFlags,
                              const MinikinPaint& paint, StartHyphenEdit startHyphen,
                              EndHyphenEdit endHyphen, float* advances);
 
+    // Same as measureText() for the size bytes of UTF-8 text. The range is in bytes, and the
+    // advances, if not null, get one value per byte of the range as with
+    // Utf8Text::toUtf8Advances(). Use a Utf8Text to lay out or break the same text more than
+    // once, since the text is converted to UTF-16 on every call.
+    static float measureTextUtf8(const char* text, uint32_t size, const Range& range,
+                                 Bidi bidiFlags, const MinikinPaint& paint,
+                                 StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                                 float* advances);
+
+    // The result of measureTextBounded().
+    struct BoundedMeasurement {
+        uint32_t length;  // The length of the measured prefix of the range.
+        float advance;    // The advance of the prefix.
+    };
+
+    // Measures the longest prefix of the range, in logical order, whose advance does not exceed
+    // maxAdvance, e.g. to ellipsize a text or to check whether it fits. The pieces are laid out
+    // one at a time and the measurement stops at the first one crossing the limit, so only the
+    // start of a long text is shaped. The prefix is made of whole code units of the advances
+    // measureText() would return, so it can end inside a word, but not inside a cluster. The
+    // whole range is returned if it fits.
+    static BoundedMeasurement measureTextBounded(const U16StringPiece& str, const Range& range,
+                                                 Bidi bidiFlags, const MinikinPaint& paint,
+                                                 StartHyphenEdit startHyphen,
+                                                 EndHyphenEdit endHyphen, float maxAdvance);
+
+    // Receives the exact result of a text measured by measureTextCoarse(): the total advance and
+    // the advances per code unit of the range. Called on a background thread, or on the calling
+    // thread of measureTextCoarse() before it returns if too many measurements are pending.
+    using PreciseMeasurementCallback =
+            std::function<void(float advance, const std::vector<float>& advances)>;
+
+    // Estimates the result of measureText() right away for the first frames of an app, which
+    // would otherwise wait for the fonts to load and the text to be shaped. Each code point gets
+    // the advance of its glyph from the cmap and the hmtx of the first family covering it, if its
+    // font is already loaded, or else a guess from the em size. There is no GSUB or GPOS and no
+    // layout cache lookup, and it never waits for a font to load. The loaded base fonts are read
+    // with atomic shared_ptr loads, which the standard library may implement with a short lock of
+    // its own. If the callback is not empty, the text is copied and measured exactly on a
+    // background thread, which also fills the layout cache for the next measurement, and the
+    // callback gets the result.
+    static float measureTextCoarse(const U16StringPiece& str, const Range& range, Bidi bidiFlags,
+                                   const MinikinPaint& paint, StartHyphenEdit startHyphen,
+                                   EndHyphenEdit endHyphen, float* advances,
+                                   PreciseMeasurementCallback callback);
+
     const std::vector<float>& advances() const { return mAdvances; }
 
     // public accessors
-    size_t nGlyphs() const { return mGlyphs.size(); }
-    const Font* getFont(int i) const { return mGlyphs[i].font.font.get(); }
-    const std::shared_ptr<Font>& getFontRef(int i) const { return mGlyphs[i].font.font; }
-    FontFakery getFakery(int i) const { return mGlyphs[i].font.fakery; }
-    unsigned int getGlyphId(int i) const { return mGlyphs[i].glyph_id; }
-    float getX(int i) const { return mGlyphs[i].x; }
-    float getY(int i) const { return mGlyphs[i].y; }
+    size_t nGlyphs() const { return mGlyphIds.size(); }
+    const Font* getFont(int i) const { return getFakedFont(i).font.get(); }
+    const std::shared_ptr<Font>& getFontRef(int i) const { return getFakedFont(i).font; }
+    FontFakery getFakery(int i) const { return getFakedFont(i).fakery; }
+    unsigned int getGlyphId(int i) const { return mGlyphIds[i]; }
+    float getX(int i) const { return mPoints[i].x; }
+    float getY(int i) const { return mPoints[i].y; }
+
+    // The glyphs in struct-of-arrays form, for the callers which copy them in bulk.
+    // getFontIndex(i) is the index of the font of the i-th glyph in getFonts().
+    const std::vector<FakedFont>& getFonts() const { return mFonts; }
+    uint32_t getFontIndex(int i) const { return mFontIndices[i]; }
+    const std::vector<uint32_t>& getGlyphIds() const { return mGlyphIds; }
+    const std::vector<Point>& getPoints() const { return mPoints; }
     float getAdvance() const { return mAdvance; }
     float getCharAdvance(size_t i) const { return mAdvances[i]; }
     const std::vector<float>& getAdvances() const { return mAdvances; }
@@ -100,6 +186,16 @@ public:
     // Dump minikin internal statistics, cache usage, cache hit ratio, etc.
     static void dumpMinikinStats(int fd);
 
+    // Starts or stops recording the latency histograms of the shaping and line breaking stages,
+    // which are part of dumpMinikinStats(). Off by default.
+    static void setLatencyStatsEnabled(bool enabled);
+
+    // Limits the work spent on adversarial text, such as thousands of combining marks. The text
+    // over a limit gets a degraded layout of bounded cost, which is counted in dumpMinikinStats().
+    // See LayoutBudget for the limits. 0 means no limit, which is the default.
+    static void setLayoutBudget(uint32_t maxClusterLength, uint32_t maxItemizeRuns,
+                                uint32_t maxShapingLength);
+
     // Append another layout (for example, cached value) into this one
     void appendLayout(const LayoutPiece& src, size_t start, float extraAdvance);
 
@@ -112,25 +208,39 @@ private:
     // Lay out a single bidi run
     // When layout is not null, layout info will be stored in the object.
     // When advances is not null, measurement results will be stored in the array.
+    // The paintId is the PaintIdCache ID of the paint.
     static float doLayoutRunCached(const U16StringPiece& textBuf, const Range& range, bool isRtl,
-                                   const MinikinPaint& paint, size_t dstStart,
+                                   const MinikinPaint& paint, uint32_t paintId, size_t dstStart,
                                    StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                                    Layout* layout, float* advances);
 
-    // Lay out a single word
-    static float doLayoutWord(const uint16_t* buf, size_t start, size_t count, size_t bufSize,
-                              bool isRtl, const MinikinPaint& paint, size_t bufStart,
-                              StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, Layout* layout,
-                              float* advances);
-
     // Lay out a single bidi run
     void doLayoutRun(const uint16_t* buf, size_t start, size_t count, size_t bufSize, bool isRtl,
                      const MinikinPaint& paint, StartHyphenEdit startHyphen,
                      EndHyphenEdit endHyphen);
 
-    std::vector<LayoutGlyph> mGlyphs;
+    bool hasGlyphs() const { return mMode != LayoutMode::ADVANCES_ONLY; }
+    bool hasAdvances() const { return mMode != LayoutMode::GLYPHS_ONLY; }
+
+    const FakedFont& getFakedFont(int i) const { return mFonts[mFontIndices[i]]; }
+    void reserveGlyphs(uint32_t count) {
+        mFontIndices.reserve(count);
+        mGlyphIds.reserve(count);
+        mPoints.reserve(count);
+    }
+
+    LayoutMode mMode;
+
+    // The distinct fonts of the glyphs. Only this table refers to the fonts, so appending a piece
+    // doesn't copy a FakedFont per glyph.
+    std::vector<FakedFont> mFonts;
+    // These vectors are defined per glyph.
+    std::vector<uint16_t> mFontIndices;
+    std::vector<uint32_t> mGlyphIds;
+    std::vector<Point> mPoints;
 
     // This vector defined per code unit, so their length is identical to the input text.
+    // Empty for LayoutMode::GLYPHS_ONLY.
     std::vector<float> mAdvances;
 
     float mAdvance;
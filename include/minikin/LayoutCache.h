@@ -19,13 +19,29 @@
 
 #include "minikin/LayoutCore.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <utils/LruCache.h>
 
+#include "minikin/Buffer.h"
+#include "minikin/CacheStats.h"
 #include "minikin/FontCollection.h"
+#include "minikin/FrequencySketch.h"
 #include "minikin/Hasher.h"
 #include "minikin/MinikinPaint.h"
+#include "minikin/MinikinRect.h"
+#include "minikin/PaintIdCache.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -33,42 +49,47 @@
 
 namespace minikin {
 const uint32_t LENGTH_LIMIT_CACHE = 128;
+// Pieces from LENGTH_LIMIT_CACHE to this length, e.g. CJK text or URLs without spaces, go to a
+// separate part of the cache with its own byte budget. Longer pieces are never cached.
+const uint32_t LENGTH_LIMIT_LONG_CACHE = 4096;
 // Layout cache datatypes
 class LayoutCacheKey {
 public:
+    // The paintId is the PaintIdCache ID of the paint, which stands for all its fields. If the
+    // font collection caches the layouts of the text with the ID of an ancestor, the key uses the
+    // ID of the same paint with the ancestor, so that the layouts are shared.
     LayoutCacheKey(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
-                   bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen)
+                   uint32_t paintId, bool dir, StartHyphenEdit startHyphen,
+                   EndHyphenEdit endHyphen)
             : mChars(text.data()),
               mNchars(text.size()),
               mStart(range.getStart()),
               mCount(range.getLength()),
-              mId(paint.font->getId()),
-              mStyle(paint.fontStyle),
-              mSize(paint.size),
-              mScaleX(paint.scaleX),
-              mSkewX(paint.skewX),
-              mLetterSpacing(paint.letterSpacing),
-              mWordSpacing(paint.wordSpacing),
-              mFontFlags(paint.fontFlags),
-              mLocaleListId(paint.localeListId),
-              mFamilyVariant(paint.familyVariant),
+              mId(paint.font->getLayoutCacheId(text)),
+              mPaintId(mId == paint.font->getId() ? paintId
+                                                  : getAncestorPaintId(paint, paintId, mId)),
               mStartHyphen(startHyphen),
               mEndHyphen(endHyphen),
               mIsRtl(dir),
               mHash(computeHash()) {}
 
+    // Reads a key written by writeTo(). The key refers to the chars, which must outlive it.
+    LayoutCacheKey(BufferReader* reader, const uint16_t* chars, uint32_t collectionId);
+
+    // The font collection is part of the paint ID, so it need not be compared.
     bool operator==(const LayoutCacheKey& o) const {
-        return mId == o.mId && mStart == o.mStart && mCount == o.mCount && mStyle == o.mStyle &&
-               mSize == o.mSize && mScaleX == o.mScaleX && mSkewX == o.mSkewX &&
-               mLetterSpacing == o.mLetterSpacing && mWordSpacing == o.mWordSpacing &&
-               mFontFlags == o.mFontFlags && mLocaleListId == o.mLocaleListId &&
-               mFamilyVariant == o.mFamilyVariant && mStartHyphen == o.mStartHyphen &&
-               mEndHyphen == o.mEndHyphen && mIsRtl == o.mIsRtl && mNchars == o.mNchars &&
+        return mPaintId == o.mPaintId && mStart == o.mStart && mCount == o.mCount &&
+               mStartHyphen == o.mStartHyphen && mEndHyphen == o.mEndHyphen &&
+               mIsRtl == o.mIsRtl && mNchars == o.mNchars &&
                !memcmp(mChars, o.mChars, mNchars * sizeof(uint16_t));
     }
 
     android::hash_t hash() const { return mHash; }
 
+    struct Hash {
+        size_t operator()(const LayoutCacheKey& key) const { return key.hash(); }
+    };
+
     void copyText() {
         uint16_t* charsCopy = new uint16_t[mNchars];
         memcpy(charsCopy, mChars, mNchars * sizeof(uint16_t));
@@ -79,6 +100,50 @@ public:
         mChars = NULL;
     }
 
+    // Makes the key refer to a copy of the text owned by someone else, e.g. a LayoutPiece built
+    // with retainText, which must outlive the key.
+    void shareText(const uint16_t* chars) { mChars = chars; }
+
+    uint32_t getFontCollectionId() const { return mId; }
+
+    // Returns the length of the laid out range.
+    uint32_t getLength() const { return mCount; }
+
+    // Writes the key except for the text and the font collection, which are up to the caller. The
+    // paint is the PaintIdCache key of the paint ID of this key.
+    void writeTo(BufferWriter* writer, const PaintIdCache::Key& paint) const;
+
+    // Writes the key with the text, except for the font collection and the paint, for a table
+    // referring to the paints by their index in it.
+    void writeWithoutPaintTo(BufferWriter* writer) const;
+
+    // Returns true if the key written by writeWithoutPaintTo() equals this one except for the
+    // paint and the font collection.
+    bool equalsWithoutPaint(BufferReader* reader) const;
+
+    // Checks that the buffer holds a key written by writeWithoutPaintTo() whose range is in its
+    // text, see BufferValidator, and returns the length of the text and of the range.
+    static void validateWithoutPaint(BufferValidator* validator, uint32_t* outTextLength,
+                                     uint32_t* outLength);
+
+    // Returns the hash of the key with the paint replaced by its index in a table, which is the
+    // same in all the processes.
+    uint32_t hashWithPaintIndex(uint32_t paintIndex) const {
+        return WideHasher()
+                .update(paintIndex)
+                .update(mStart)
+                .update(mCount)
+                .update(packHyphenEdit(mStartHyphen, mEndHyphen))
+                .update(mIsRtl)
+                .updateShorts(mChars, mNchars)
+                .hash();
+    }
+
+    uint32_t getPaintId() const { return mPaintId; }
+
+    uint32_t getTextMemoryUsage() const { return sizeof(uint16_t) * mNchars; }
+
+    // The paint fields are shared by all the keys of the paint in PaintIdCache.
     uint32_t getMemoryUsage() const { return sizeof(LayoutCacheKey) + sizeof(uint16_t) * mNchars; }
 
 private:
@@ -87,110 +152,1043 @@ private:
     uint32_t mStart;
     uint32_t mCount;
     uint32_t mId;  // for the font collection
-    FontStyle mStyle;
-    float mSize;
-    float mScaleX;
-    float mSkewX;
-    float mLetterSpacing;
-    float mWordSpacing;
-    int32_t mFontFlags;
-    uint32_t mLocaleListId;
-    FamilyVariant mFamilyVariant;
+    // Note: any fields added to MinikinPaint must also be reflected in PaintIdCache.
+    uint32_t mPaintId;
     StartHyphenEdit mStartHyphen;
     EndHyphenEdit mEndHyphen;
     bool mIsRtl;
-    // Note: any fields added to MinikinPaint must also be reflected here.
     // TODO: language matching (possibly integrate into style)
     android::hash_t mHash;
 
     android::hash_t computeHash() const {
-        return Hasher()
-                .update(mId)
+        return WideHasher()
+                .update(mPaintId)
                 .update(mStart)
                 .update(mCount)
-                .update(mStyle.identifier())
-                .update(mSize)
-                .update(mScaleX)
-                .update(mSkewX)
-                .update(mLetterSpacing)
-                .update(mWordSpacing)
-                .update(mFontFlags)
-                .update(mLocaleListId)
-                .update(static_cast<uint8_t>(mFamilyVariant))
                 .update(packHyphenEdit(mStartHyphen, mEndHyphen))
                 .update(mIsRtl)
                 .updateShorts(mChars, mNchars)
                 .hash();
     }
+
+    // Returns the ID of the paint with the given ancestor collection. The keys of a run usually
+    // use the same ancestor, so the IDs are kept per thread by paint ID instead of being looked up
+    // in PaintIdCache for every key. A paint ID is never reused, so a kept ID stays valid.
+    static uint32_t getAncestorPaintId(const MinikinPaint& paint, uint32_t paintId,
+                                       uint32_t collectionId) {
+        struct AncestorPaintId {
+            uint32_t paintId;
+            uint32_t collectionId;
+            uint32_t ancestorPaintId;
+        };
+        // The paint IDs start at 1, so the zeroed slots never match.
+        static thread_local std::array<AncestorPaintId, 8> ids = {};
+        AncestorPaintId& slot = ids[(paintId ^ collectionId) % ids.size()];
+        if (slot.paintId != paintId || slot.collectionId != collectionId) {
+            slot = {paintId, collectionId, PaintIdCache::getId(paint, collectionId)};
+        }
+        return slot.ancestorPaintId;
+    }
 };
 
-class LayoutCache : private android::OnEntryRemoved<LayoutCacheKey, LayoutPiece*> {
+// A thread-safe LRU cache of LayoutPieces.
+//
+// The cache is split into shards, each of which has its own lock and LRU list. The shard is
+// chosen from the key hash, so threads working on different words rarely contend on the same
+// lock. Each shard evicts independently, holding at most its share of the total capacity.
+//
+// By default the capacity is a number of entries. With setMaxMemoryUsage(), the capacity becomes
+// a byte budget on the summed key and piece sizes instead, and the entry count is unbounded.
+class LayoutCache {
 public:
+    // The per-thread caches may still hold the entries of a destroyed cache.
+    ~LayoutCache() { invalidateThreadCaches(); }
+
     void clear() {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mCache.clear();
+        forEachShard([](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            shard.mCache.clear();
+        });
+        invalidateThreadCaches();
+    }
+
+    // Removes the layouts of the font collection, e.g. after its fonts were updated, and keeps the
+    // others. The layouts a collection created by FontCollection::createCollectionWithFamilies()
+    // shares with an ancestor are the ancestor's. Only the shards holding layouts of the
+    // collection are scanned.
+    void purgeCollection(uint32_t fontCollectionId) {
+        forEachShard([fontCollectionId](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            auto it = shard.mCollectionEntryCounts.find(fontCollectionId);
+            if (it == shard.mCollectionEntryCounts.end()) {
+                return;
+            }
+            shard.removeIf(it->second, [fontCollectionId](const LayoutCacheKey& key,
+                                                          const Entry&) {
+                return key.getFontCollectionId() == fontCollectionId;
+            });
+        });
+        invalidateThreadCaches();
+    }
+
+    // Removes the layouts using the font, of any collection.
+    void purgeFont(const Font* font) {
+        forEachShard([font](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            shard.removeIf(shard.mCache.size(), [font](const LayoutCacheKey&, const Entry& entry) {
+                for (const FakedFont& fakedFont : entry.piece.fonts()) {
+                    if (fakedFont.font.get() == font) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        });
+        invalidateThreadCaches();
     }
 
     // Do not use LayoutCache inside the callback function, otherwise dead-lock may happen.
     template <typename F>
     void getOrCreate(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
                      bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, F& f) {
-        LayoutCacheKey key(text, range, paint, dir, startHyphen, endHyphen);
-        if (paint.skipCache() || range.getLength() >= LENGTH_LIMIT_CACHE) {
+        // Check the bypass first so that too long text is not hashed for nothing.
+        if (skipCache(paint, range)) {
+            mStats.bypass();
+            f(LayoutPiece(text, range, dir, paint, startHyphen, endHyphen), paint);
+            return;
+        }
+        getOrCreate(text, range, paint, PaintIdCache::getId(paint), dir, startHyphen, endHyphen,
+                    f);
+    }
+
+    // Same as above with the PaintIdCache ID of the paint, for the callers laying out many pieces
+    // with the same paint, which look the ID up once.
+    template <typename F>
+    void getOrCreate(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                     uint32_t paintId, bool dir, StartHyphenEdit startHyphen,
+                     EndHyphenEdit endHyphen, F& f) {
+        if (skipCache(paint, range)) {
+            mStats.bypass();
             f(LayoutPiece(text, range, dir, paint, startHyphen, endHyphen), paint);
             return;
         }
+        if (hasInvariantPaint(paint)) {
+            getOrCreateInvariant(text, nullptr /* textOwner */, range, paint, dir, startHyphen,
+                                 endHyphen, true /* useThreadCache */, f);
+            return;
+        }
+        getOrCreateEntry(text, nullptr /* textOwner */, range, paint, paintId, dir, startHyphen,
+                         endHyphen, false /* needBounds */, true /* useThreadCache */,
+                         [&](const Entry& entry) { f(entry.piece, paint); });
+    }
+
+    // Same as getOrCreate, for text in an immutable buffer kept alive by textOwner, e.g. a pinned
+    // Java string or the text of a PrecomputedText. A new entry keeps a reference to textOwner
+    // and refers to the buffer instead of copying the text. The entry pins the buffer, so the
+    // text it refers to still counts towards the memory budget. The text must not change while
+    // textOwner is alive.
+    //
+    // Do not use LayoutCache inside the callback function, otherwise dead-lock may happen.
+    template <typename F>
+    void getOrCreate(const U16StringPiece& text, const std::shared_ptr<const void>& textOwner,
+                     const Range& range, const MinikinPaint& paint, uint32_t paintId, bool dir,
+                     StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, F& f) {
+        if (skipCache(paint, range)) {
+            mStats.bypass();
+            f(LayoutPiece(text, range, dir, paint, startHyphen, endHyphen), paint);
+            return;
+        }
+        if (hasInvariantPaint(paint)) {
+            getOrCreateInvariant(text, textOwner, range, paint, dir, startHyphen, endHyphen,
+                                 true /* useThreadCache */, f);
+            return;
+        }
+        getOrCreateEntry(text, textOwner, range, paint, paintId, dir, startHyphen, endHyphen,
+                         false /* needBounds */, true /* useThreadCache */,
+                         [&](const Entry& entry) { f(entry.piece, paint); });
+    }
+
+    // A piece of a run for getOrCreateRun(): the range to lay out and its context, both in the
+    // text of the run, and the hyphen edits of the piece.
+    struct RunPiece {
+        Range context;
+        Range piece;
+        StartHyphenEdit startHyphen;
+        EndHyphenEdit endHyphen;
+    };
+
+    // Lays out all the pieces of a run with the paint of the PaintIdCache ID, calling
+    // f(index, layoutPiece, paint) for each piece in order. Instead of a lock round trip per
+    // piece, the pieces are probed with one lock acquisition per shard. The hits are then kept
+    // alive without a lock while f runs, and only the misses are shaped, outside of the lock.
+    // With the thread cache, the pieces found in it are not probed at all, and the shard hits are
+    // added to it once f has been called for all the pieces.
+    //
+    // Do not use LayoutCache inside the callback function, otherwise dead-lock may happen.
+    template <typename F>
+    void getOrCreateRun(const U16StringPiece& text, const std::vector<RunPiece>& pieces,
+                        const MinikinPaint& paint, uint32_t paintId, bool dir, F& f) {
+        if (!hasInvariantPaint(paint)) {
+            getOrCreateRunInternal(text, pieces, paint, paintId, dir, f);
+            return;
+        }
+        const MinikinPaint invariantPaint = getInvariantPaint(paint);
+        auto adapt = [&](uint32_t i, const LayoutPiece& piece, const MinikinPaint&) {
+            f(i, fromInvariantPiece(piece, paint, invariantPaint), paint);
+        };
+        getOrCreateRunInternal(text, pieces, invariantPaint, PaintIdCache::getId(invariantPaint),
+                               dir, adapt);
+    }
+
+    // Lays out the range and its bounds and inserts them unless they are cached, to warm the
+    // cache ahead of its use. Unlike getOrCreate, it never waits for the lock of a shard: while
+    // another thread holds it, it yields and tries again, and it gives up once cancelled is set.
+    // The lookup is not counted in the stats. Returns false if it was cancelled. The bounds of a
+    // paint with letter spacing or a size invariant paint are not prewarmed, since they are
+    // computed on each query.
+    bool prewarm(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                 uint32_t paintId, bool dir, const std::atomic<bool>& cancelled);
+
+    // Same as getOrCreate, but calls f with the bounding box and the advance of the layout.
+    // The bounds are computed on the first request and kept in the same entry as the layout, so
+    // a bounds query costs a single lookup. If textOwner is not null, a new entry refers to the
+    // text it keeps alive as with getOrCreate.
+    //
+    // Do not use LayoutCache inside the callback function, otherwise dead-lock may happen.
+    template <typename F>
+    void getOrCreateBounds(const U16StringPiece& text, const Range& range,
+                           const MinikinPaint& paint, bool dir, StartHyphenEdit startHyphen,
+                           EndHyphenEdit endHyphen, F& f,
+                           const std::shared_ptr<const void>& textOwner = nullptr) {
+        if (skipCache(paint, range)) {
+            mBoundsStats.bypass();
+            LayoutPiece piece(text, range, dir, paint, startHyphen, endHyphen);
+            f(piece.calculateBounds(paint), piece.advance());
+            return;
+        }
+        if (hasInvariantPaint(paint)) {
+            // The bounds of the invariant piece do not apply, so they are computed on each query,
+            // which is counted as a layout lookup.
+            auto bounds = [&](const LayoutPiece& piece, const MinikinPaint&) {
+                f(piece.calculateBounds(paint), piece.advance());
+            };
+            getOrCreateInvariant(text, textOwner, range, paint, dir, startHyphen, endHyphen,
+                                 false /* useThreadCache */, bounds);
+            return;
+        }
+        getOrCreateEntry(text, textOwner, range, paint, PaintIdCache::getId(paint), dir,
+                         startHyphen, endHyphen, true /* needBounds */,
+                         false /* useThreadCache */,
+                         [&](const Entry& entry) { f(entry.bounds, entry.piece.advance()); });
+    }
+
+    // In the single flight mode, a miss for a key that other thread is already shaping waits for
+    // that result instead of shaping the same text again. This saves work when many threads lay
+    // out the same new words at once, e.g. while a new screen is inflated, at the cost of a wait
+    // for the shaping thread.
+    void setSingleFlight(bool enabled) {
+        mSingleFlight.store(enabled, std::memory_order_relaxed);
+    }
+
+    // With the frequency admission, a new entry only replaces the least recently used one if its
+    // key was looked up more often recently, as estimated by a FrequencySketch of each shard.
+    // This keeps a long scroll through text that is seen once, e.g. a chat history, from
+    // flushing the words used over and over by the UI. Once the cache is full, a new word is only
+    // cached after it has been seen a few times. The sketches use 8 bytes per entry. The long
+    // pieces are not affected.
+    void setFrequencyAdmission(bool enabled) {
+        for (const std::unique_ptr<Shard>& shard : mShards) {
+            std::lock_guard<std::mutex> lock(shard->mMutex);
+            if (!enabled) {
+                shard->mSketch.reset();
+            } else if (shard->mSketch == nullptr) {
+                shard->mSketch = std::make_unique<FrequencySketch>(shard->mMaxEntries);
+            }
+        }
+    }
+
+    // Switches eviction to a byte budget shared evenly by the shards. Entries are evicted in LRU
+    // order once the summed LayoutCacheKey and LayoutPiece memory usage exceeds maxBytes. Passing
+    // 0 restores the entry count limit given at construction.
+    void setMaxMemoryUsage(size_t maxBytes) {
+        const size_t bytesPerShard = (maxBytes + mShards.size() - 1) / mShards.size();
+        for (const std::unique_ptr<Shard>& shard : mShards) {
+            std::lock_guard<std::mutex> lock(shard->mMutex);
+            shard->mMaxBytes = bytesPerShard;
+            shard->trim();
+        }
+    }
+
+    // Sets the byte budget of the pieces longer than LENGTH_LIMIT_CACHE. They are evicted in LRU
+    // order among themselves, so that a few long paragraphs cannot flush the short words. Passing
+    // 0 stops caching them.
+    void setMaxLongMemoryUsage(size_t maxBytes) {
+        std::lock_guard<std::mutex> lock(mLongShard->mMutex);
+        mLongShard->mMaxBytes = maxBytes;
+        mLongShard->trim();
+        mLongCacheEnabled.store(maxBytes != 0, std::memory_order_relaxed);
+    }
+
+    // With the thread cache, each thread looks the layouts up in a small direct mapped table of
+    // the pieces it used recently before it goes to the shards. A hit there takes no lock and
+    // writes no shared memory, which suits the UI thread laying out the same words every frame.
+    // The table shares the pieces with the shards and is invalidated by clear() and the purges,
+    // so it may keep an evicted piece alive until it is replaced. Its hits are not counted in
+    // getStats(). The bounds queries do not use it.
+    void setThreadCacheEnabled(bool enabled) {
+        mThreadCacheEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    // With the size invariant layouts, the text of a paint with linear metrics and without
+    // hinting is shaped once at kInvariantSize, and the layouts at the other sizes are scaled
+    // from it, which suits the text size animations and the pinch zoom. The scaled layouts match
+    // the ones shaped at their size, up to rounding and to the device tables of the fonts, which
+    // adjust the positions per size and are rare in the fonts with linear metrics. The paints
+    // whose style is faked bold by any family of their collection are laid out at their own size,
+    // since emboldening doesn't scale linearly.
+    void setSizeInvariantLayouts(bool enabled) {
+        mSizeInvariantLayouts.store(enabled, std::memory_order_relaxed);
+    }
+
+    // The size the size invariant layouts are shaped at.
+    static constexpr float kInvariantSize = 128.0f;
+
+    // Returns the summed memory usage of the cached keys and pieces.
+    size_t getMemoryUsage() {
+        size_t usage = 0;
+        forEachShard([&usage](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            usage += shard.mBytes;
+        });
+        return usage;
+    }
+
+    uint32_t getCacheSize() {
+        uint32_t size = 0;
+        forEachShard([&size](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            size += shard.mCache.size();
+        });
+        return size;
+    }
+
+    const CacheStats& getStats() const { return mStats; }
+
+    // The counters of the pieces longer than LENGTH_LIMIT_CACHE, which are not part of getStats()
+    // unless they are bypassed.
+    const CacheStats& getLongStats() const { return mLongStats; }
+
+    // Clears the counters of getStats() and getLongStats(), e.g. between benchmark runs.
+    void resetStats() {
+        mStats.reset();
+        mLongStats.reset();
+    }
+
+    // Writes the entries laid out with one of the collections, so that another cache can start
+    // warm with readSnapshot(), e.g. in an app process with the snapshot taken in zygote. Entries
+    // of other collections are skipped, and so are the entries referring to a caller's text
+    // buffer, which is not part of the process the snapshot is read in. Use a BufferWriter for
+    // nullptr to get the size needed.
+    void writeSnapshot(BufferWriter* writer,
+                       const std::vector<std::shared_ptr<FontCollection>>& collections);
+
+    // Inserts the entries written by writeSnapshot(). The collections must have the same families
+    // as the collections given to writeSnapshot(), in the same order, but they can be copies read
+    // from a buffer. The entries are copied, so the buffer need not outlive the cache.
+    void readSnapshot(BufferReader* reader,
+                      const std::vector<std::shared_ptr<FontCollection>>& collections);
+
+    // Writes the entries laid out with one of the collections as a hash table which
+    // setSharedTable() can look the layouts up in where it is, e.g. in a buffer written by zygote
+    // before it forks the apps, or in a file mapped by all of them. The table only holds
+    // offsets, so it can be mapped at any address. The same entries as with writeSnapshot() are
+    // written. Use a BufferWriter for nullptr to get the size needed.
+    void writeSharedTable(BufferWriter* writer,
+                          const std::vector<std::shared_ptr<FontCollection>>& collections);
+
+    // Makes the cache the upper level of the table written by writeSharedTable(): a miss looks
+    // the layout up in the table before shaping it, and a layout found there is inserted into the
+    // cache as if it was shaped. The table is only read, so its pages stay shared between the
+    // processes mapping it, and only the layouts a process uses are copied. The collections must
+    // be the same as for readSnapshot(). The buffer must outlive the cache, or the next call.
+    // The whole table is checked against the size of the buffer and the collections first, e.g.
+    // for a truncated file, and false is returned without changing the table if it is invalid.
+    // Passing a null buffer removes the table.
+    bool setSharedTable(const void* buffer, size_t size,
+                        const std::vector<std::shared_ptr<FontCollection>>& collections);
+
+    // The counters of the shared table lookups. A miss in the cache which is found in the table is
+    // a hit here, and still a miss in getStats().
+    const CacheStats& getSharedTableStats() const { return mSharedTableStats; }
+
+    // Returns the number of entries which have their bounds computed.
+    uint32_t getBoundsCount() {
+        uint32_t count = 0;
+        forEachShard([&count](Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            count += shard.mBoundsCount;
+        });
+        return count;
+    }
+
+    // The counters of getOrCreateBounds. A bounds query on an entry which only has the layout is
+    // a miss, although the text is not shaped again.
+    const CacheStats& getBoundsStats() const { return mBoundsStats; }
+    void resetBoundsStats() { mBoundsStats.reset(); }
+
+    static LayoutCache& getInstance() {
+        static LayoutCache cache(kMaxEntries, kShardCount, kMaxLongBytes);
+        return cache;
+    }
+
+protected:
+    // The maxEntries is split evenly across shardCount shards. A single shard behaves as one
+    // global LRU cache. The pieces longer than LENGTH_LIMIT_CACHE are only cached if
+    // maxLongBytes is not 0.
+    LayoutCache(uint32_t maxEntries, uint32_t shardCount = 1, size_t maxLongBytes = 0)
+            : mSingleFlight(false),
+              mLongCacheEnabled(maxLongBytes != 0),
+              mThreadCacheEnabled(false),
+              mSizeInvariantLayouts(false),
+              mHasSharedTable(false) {
+        const uint32_t entriesPerShard = std::max(1u, (maxEntries + shardCount - 1) / shardCount);
+        mShards.reserve(shardCount);
+        for (uint32_t i = 0; i < shardCount; ++i) {
+            mShards.push_back(std::make_unique<Shard>(entriesPerShard, &mStats, &mBoundsStats));
+        }
+        mLongShard = std::make_unique<Shard>(0 /* maxEntries */, &mLongStats, &mBoundsStats,
+                                             maxLongBytes);
+    }
+
+    uint32_t getShardCount() const { return mShards.size(); }
+
+private:
+    friend class BoundsCache;
+
+    // A cached layout, and its bounds once they have been asked for.
+    struct Entry {
+        template <typename... Args>
+        explicit Entry(Args&&... args)
+                : piece(std::forward<Args>(args)...), hasBounds(false), keyHash(0) {}
+
+        void setBounds(const MinikinPaint& paint) {
+            bounds = piece.calculateBounds(paint);
+            hasBounds = true;
+        }
+
+        LayoutPiece piece;
+        MinikinRect bounds;
+        bool hasBounds;
+        // The hash of the key, for the frequency admission to look up the frequency of the
+        // least recently used entry.
+        android::hash_t keyHash;
+        // Keeps the text of the key alive if the piece does not retain a copy of it.
+        std::shared_ptr<const void> textOwner;
+    };
+
+    // The table set by setSharedTable(). Defined in LayoutCache.cpp.
+    struct SharedTable;
+
+    // Returns a new entry for the key read from the shared table, or null if the table doesn't
+    // have it.
+    std::shared_ptr<Entry> findInSharedTable(const LayoutCacheKey& key);
+
+    // Returns true if the layouts for the paint are cached with another paint, see
+    // getInvariantPaint().
+    bool hasInvariantPaint(const MinikinPaint& paint) const {
+        return paint.letterSpacing != 0 || isSizeInvariant(paint);
+    }
+
+    // Returns true if the layouts for the paint are scaled from the ones at kInvariantSize.
+    bool isSizeInvariant(const MinikinPaint& paint) const {
+        return (paint.fontFlags & LinearMetrics_Flag) != 0 &&
+               (paint.fontFlags & (Embolden_Flag | ForceAutoHinting_Flag)) == 0 &&
+               paint.size > 0 && paint.size != kInvariantSize &&
+               mSizeInvariantLayouts.load(std::memory_order_relaxed) &&
+               !paint.font->hasFakeBold(paint.fontStyle);
+    }
+
+    // Returns the paint the layouts for the paint are cached with.
+    //
+    // The letter spacing only changes the shaping through the optional ligatures, so the layouts
+    // of all the spacings disabling the same ligatures share the entries of one invariant spacing:
+    // the entry is laid out without the spacing, recording where it goes, and the spacing of the
+    // paint is added on each use (see LayoutPiece::withLetterSpacing). The frames of a letter
+    // spacing animation then shape the text once. The invariant spacings are only used as keys,
+    // and the paints with letter spacing only reach the shards through this.
+    //
+    // The size of a size invariant paint is replaced with kInvariantSize, see
+    // setSizeInvariantLayouts().
+    MinikinPaint getInvariantPaint(const MinikinPaint& paint) const {
+        MinikinPaint invariantPaint = paint;
+        if (paint.letterSpacing != 0) {
+            invariantPaint.letterSpacing =
+                    LayoutPiece::disablesOptionalLigatures(paint.letterSpacing) ? 1.0f : 0.01f;
+        }
+        if (isSizeInvariant(paint)) {
+            invariantPaint.size = kInvariantSize;
+        }
+        return invariantPaint;
+    }
+
+    // Returns the layout for the paint from the piece laid out with its invariant paint.
+    static LayoutPiece fromInvariantPiece(const LayoutPiece& piece, const MinikinPaint& paint,
+                                          const MinikinPaint& invariantPaint) {
+        if (paint.size != invariantPaint.size) {
+            const LayoutPiece scaled = piece.scaled(paint.size / invariantPaint.size);
+            return scaled.hasLetterSpacingSteps() ? scaled.withLetterSpacing(paint) : scaled;
+        }
+        return piece.hasLetterSpacingSteps() ? piece.withLetterSpacing(paint) : piece;
+    }
+
+    // The prewarm() of a paint without an invariant paint or of an invariant paint. The bounds are
+    // only computed if needBounds is true.
+    bool prewarmEntry(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                      uint32_t paintId, bool dir, bool needBounds,
+                      const std::atomic<bool>& cancelled);
+
+    // Shapes a piece for the paint without the cache. A paint with letter spacing is an invariant
+    // one here, see getInvariantPaint().
+    static LayoutPiece createPiece(const U16StringPiece& text, const Range& range, bool dir,
+                                   const MinikinPaint& paint, StartHyphenEdit startHyphen,
+                                   EndHyphenEdit endHyphen) {
+        return LayoutPiece(text, range, dir, paint, startHyphen, endHyphen, false /* retainText */,
+                           false /* recordSafeBreaks */,
+                           paint.letterSpacing != 0 /* recordLetterSpacing */);
+    }
+
+    // The getOrCreate() of a paint with an invariant paint, which looks up the entry of the
+    // invariant paint and calls f with the layout for the paint made from its piece.
+    template <typename F>
+    void getOrCreateInvariant(const U16StringPiece& text,
+                              const std::shared_ptr<const void>& textOwner, const Range& range,
+                              const MinikinPaint& paint, bool dir, StartHyphenEdit startHyphen,
+                              EndHyphenEdit endHyphen, bool useThreadCache, F& f) {
+        const MinikinPaint invariantPaint = getInvariantPaint(paint);
+        getOrCreateEntry(text, textOwner, range, invariantPaint,
+                         PaintIdCache::getId(invariantPaint), dir, startHyphen, endHyphen,
+                         false /* needBounds */, useThreadCache, [&](const Entry& entry) {
+                             f(fromInvariantPiece(entry.piece, paint, invariantPaint), paint);
+                         });
+    }
+
+    // Looks up the entry for the arguments, creating it on a miss, and calls f with it. If
+    // needBounds is true, the bounds of the entry are computed if they are not yet. A new entry
+    // refers to the text owned by textOwner if it is not null, and copies the text otherwise.
+    // A paint with letter spacing must be an invariant one, see getInvariantPaint().
+    // If useThreadCache is true and the thread cache is enabled, the entry is looked up there
+    // first, and added to it otherwise.
+    template <typename F>
+    void getOrCreateEntry(const U16StringPiece& text, const std::shared_ptr<const void>& textOwner,
+                          const Range& range, const MinikinPaint& paint, uint32_t paintId,
+                          bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                          bool needBounds, bool useThreadCache, const F& f) {
+        LayoutCacheKey key(text, range, paint, paintId, dir, startHyphen, endHyphen);
+        const bool threadCache =
+                useThreadCache && mThreadCacheEnabled.load(std::memory_order_relaxed);
+        const uint64_t epoch = threadCache ? getThreadCacheEpoch() : 0;
+        if (threadCache) {
+            const Entry* entry = findInThreadCache(key, epoch);
+            if (entry != nullptr) {
+                f(*entry);
+                return;
+            }
+        }
+        Shard& shard = getShard(key);
+        CacheStats& stats = *shard.mStats;
+        // The lock waits of the bounds queries are reported with the bounds counters.
+        CacheStats& lockStats = needBounds ? mBoundsStats : stats;
+        const bool singleFlight = mSingleFlight.load(std::memory_order_relaxed);
         {
-            std::lock_guard<std::mutex> lock(mMutex);
-            LayoutPiece* layout = mCache.get(key);
-            if (layout != nullptr) {
-                f(*layout, paint);
+            std::unique_lock<std::mutex> lock = lockStats.lock(shard.mMutex);
+            shard.recordAccess(key);
+            Entry* entry = shard.mCache.get(key).get();
+            if (entry == nullptr && singleFlight) {
+                entry = shard.waitForInFlight(key, &lock);
+            }
+            if (entry != nullptr) {
+                stats.hit();
+                if (needBounds) {
+                    if (entry->hasBounds) {
+                        mBoundsStats.hit();
+                    } else {
+                        // Computing the bounds is much cheaper than shaping, so do it while
+                        // holding the lock to keep the entry from being evicted.
+                        mBoundsStats.miss();
+                        shard.setBounds(entry, paint);
+                    }
+                }
+                f(*entry);
+                if (threadCache) {
+                    insertIntoThreadCache(key, shard.mCache.get(key), epoch);
+                }
                 return;
             }
         }
+        stats.miss();
         // Doing text layout takes long time, so releases the mutex during doing layout.
-        // Don't care even if we do the same layout in other thred.
-        key.copyText();
-        std::unique_ptr<LayoutPiece> layout =
-                std::make_unique<LayoutPiece>(text, range, dir, paint, startHyphen, endHyphen);
-        f(*layout, paint);
+        // Unless in the single flight mode, don't care even if we do the same layout in other
+        // thread.
+        std::shared_ptr<Entry> entry = findInSharedTable(key);
+        // The pieces of the shared table retain their text.
+        const bool retainText = textOwner == nullptr || entry != nullptr;
+        if (entry == nullptr) {
+            entry = std::make_shared<Entry>(text, range, dir, paint, startHyphen, endHyphen,
+                                            retainText, false /* recordSafeBreaks */,
+                                            paint.letterSpacing != 0 /* recordLetterSpacing */);
+            entry->textOwner = textOwner;
+        }
+        if (needBounds) {
+            mBoundsStats.miss();
+            entry->setBounds(paint);
+        }
+        f(*entry);
+        // The piece keeps the only copy of the text for the entry, unless the owner keeps it.
+        key.shareText(retainText ? entry->piece.text() : text.data());
+        if (threadCache) {
+            insertIntoThreadCache(key, entry, epoch);
+        }
         {
-            std::lock_guard<std::mutex> lock(mMutex);
-            mCache.put(key, layout.release());
+            std::unique_lock<std::mutex> lock = lockStats.lock(shard.mMutex);
+            if (singleFlight) {
+                shard.mInFlight.erase(key);
+            }
+            shard.put(key, std::move(entry));
+        }
+        if (singleFlight) {
+            shard.mInFlightDone.notify_all();
         }
     }
 
-    static LayoutCache& getInstance() {
-        static LayoutCache cache(kMaxEntries);
+    // The getOrCreateRun() of the paints without letter spacing and of the invariant paints.
+    template <typename F>
+    void getOrCreateRunInternal(const U16StringPiece& text, const std::vector<RunPiece>& pieces,
+                                const MinikinPaint& paint, uint32_t paintId, bool dir, F& f) {
+        RunScratch& scratch = getRunScratch();
+        scratch.probes.clear();
+        scratch.hits.assign(pieces.size(), nullptr);
+        scratch.firstPieces.resize(pieces.size());
+        const bool threadCache = mThreadCacheEnabled.load(std::memory_order_relaxed);
+        const uint64_t epoch = threadCache ? getThreadCacheEpoch() : 0;
+        for (uint32_t i = 0; i < pieces.size(); ++i) {
+            const RunPiece& p = pieces[i];
+            const Range range = p.piece - p.context.getStart();
+            if (skipCache(paint, range)) {
+                continue;
+            }
+            LayoutCacheKey key(text.substr(p.context), range, paint, paintId, dir, p.startHyphen,
+                               p.endHyphen);
+            if (threadCache) {
+                scratch.hits[i] = findInThreadCache(key, epoch);
+                if (scratch.hits[i] != nullptr) {
+                    continue;
+                }
+            }
+            scratch.firstPieces[i] = i;
+            scratch.probes.push_back({getShardIndex(key), i, key, nullptr});
+        }
+        std::sort(scratch.probes.begin(), scratch.probes.end(),
+                  [](const RunProbe& a, const RunProbe& b) {
+                      return std::make_tuple(a.shardIndex, a.key.hash(), a.pieceIndex) <
+                             std::make_tuple(b.shardIndex, b.key.hash(), b.pieceIndex);
+                  });
+        for (size_t begin = 0; begin < scratch.probes.size();) {
+            Shard& shard = getShardAt(scratch.probes[begin].shardIndex);
+            size_t end = begin;
+            std::unique_lock<std::mutex> lock = shard.mStats->lock(shard.mMutex);
+            for (; end < scratch.probes.size() &&
+                   scratch.probes[end].shardIndex == scratch.probes[begin].shardIndex;
+                 ++end) {
+                RunProbe& probe = scratch.probes[end];
+                shard.recordAccess(probe.key);
+                const std::shared_ptr<Entry>& entry = shard.mCache.get(probe.key);
+                if (entry != nullptr) {
+                    shard.mStats->hit();
+                    probe.hit = entry;
+                    scratch.hits[probe.pieceIndex] = entry.get();
+                    continue;
+                }
+                // Equal keys have equal hashes, so the earlier pieces with the same key are just
+                // before the probe once sorted. The misses of a key share the piece shaped for
+                // the first one.
+                for (size_t k = end; k > begin; --k) {
+                    const RunProbe& earlier = scratch.probes[k - 1];
+                    if (earlier.key.hash() != probe.key.hash()) {
+                        break;
+                    }
+                    if (earlier.key == probe.key) {
+                        scratch.firstPieces[probe.pieceIndex] =
+                                scratch.firstPieces[earlier.pieceIndex];
+                        break;
+                    }
+                }
+            }
+            begin = end;
+        }
+        const bool singleFlight = mSingleFlight.load(std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < pieces.size(); ++i) {
+            const RunPiece& p = pieces[i];
+            const U16StringPiece pieceText = text.substr(p.context);
+            const Range range = p.piece - p.context.getStart();
+            if (scratch.hits[i] != nullptr) {
+                f(i, scratch.hits[i]->piece, paint);
+            } else if (skipCache(paint, range)) {
+                mStats.bypass();
+                f(i, createPiece(pieceText, range, dir, paint, p.startHyphen, p.endHyphen), paint);
+            } else if (singleFlight) {
+                // Waits for the other threads shaping the piece, and looks the key up again
+                // since the piece may have been inserted meanwhile.
+                // The thread cache is not used here, since adding to it could free the thread
+                // cache hits of the next pieces.
+                getOrCreateEntry(pieceText, nullptr /* textOwner */, range, paint, paintId, dir,
+                                 p.startHyphen, p.endHyphen, false /* needBounds */,
+                                 false /* useThreadCache */,
+                                 [&](const Entry& entry) { f(i, entry.piece, paint); });
+            } else {
+                LayoutCacheKey key(pieceText, range, paint, paintId, dir, p.startHyphen,
+                                   p.endHyphen);
+                Shard& shard = getShard(key);
+                if (scratch.firstPieces[i] != i) {
+                    // An earlier piece of the run with the same key was shaped and inserted.
+                    shard.mStats->hit();
+                    scratch.hits[i] = scratch.hits[scratch.firstPieces[i]];
+                    f(i, scratch.hits[i]->piece, paint);
+                    continue;
+                }
+                // The miss was found by the lookup above, so the shard is only locked again for
+                // the insertion. An entry inserted by another thread meanwhile is kept.
+                shard.mStats->miss();
+                std::shared_ptr<Entry> entry = findInSharedTable(key);
+                if (entry == nullptr) {
+                    entry = std::make_shared<Entry>(
+                            pieceText, range, dir, paint, p.startHyphen, p.endHyphen,
+                            true /* retainText */, false /* recordSafeBreaks */,
+                            paint.letterSpacing != 0 /* recordLetterSpacing */);
+                }
+                f(i, entry->piece, paint);
+                key.shareText(entry->piece.text());
+                scratch.hits[i] = entry.get();
+                scratch.created.push_back(entry);
+                std::unique_lock<std::mutex> lock = shard.mStats->lock(shard.mMutex);
+                shard.put(key, std::move(entry));
+            }
+        }
+        scratch.hits.clear();
+        scratch.created.clear();
+        // Unpins the shard hits, which may have been evicted meanwhile, or hands them over to the
+        // thread cache.
+        for (RunProbe& probe : scratch.probes) {
+            if (threadCache && probe.hit != nullptr) {
+                insertIntoThreadCache(probe.key, std::move(probe.hit), epoch);
+            }
+        }
+        scratch.probes.clear();
+    }
+
+    class Shard : private android::OnEntryRemoved<LayoutCacheKey, std::shared_ptr<Entry>> {
+    public:
+        // The LruCache itself is unbounded. The limits are enforced by trim() so that they can be
+        // changed at runtime.
+        Shard(uint32_t maxEntries, CacheStats* stats, CacheStats* boundsStats,
+              size_t maxBytes = 0)
+                : mCache(android::LruCache<LayoutCacheKey,
+                                           std::shared_ptr<Entry>>::kUnlimitedCapacity),
+                  mMaxEntries(maxEntries),
+                  mMaxBytes(maxBytes),
+                  mBytes(0),
+                  mBoundsCount(0),
+                  mStats(stats),
+                  mBoundsStats(boundsStats) {
+            mCache.setOnEntryRemovedListener(this);
+        }
+
+        void put(LayoutCacheKey& key, std::shared_ptr<Entry>&& entry)
+                EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            const size_t bytes = getEntryMemoryUsage(key, *entry);
+            const bool hasBounds = entry->hasBounds;
+            if (mSketch != nullptr && !admit(key, bytes)) {
+                return;
+            }
+            entry->keyHash = key.hash();
+            if (!mCache.put(key, entry)) {
+                // Other thread has already inserted the same layout.
+                return;
+            }
+            mBytes += bytes;
+            mCollectionEntryCounts[key.getFontCollectionId()]++;
+            mStats->insert();
+            if (hasBounds) {
+                mBoundsCount++;
+                mBoundsStats->insert();
+            }
+            trim();
+        }
+
+        // Counts a lookup of the key for the frequency admission.
+        void recordAccess(const LayoutCacheKey& key) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            if (mSketch != nullptr) {
+                mSketch->increment(key.hash());
+            }
+        }
+
+        void setBounds(Entry* entry, const MinikinPaint& paint) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            entry->setBounds(paint);
+            mBoundsCount++;
+            mBoundsStats->insert();
+        }
+
+        // Waits until no other thread is shaping the key, then returns the cached piece. If the
+        // piece is not available, registers the caller as the thread shaping the key and returns
+        // nullptr. The caller must then remove the key from mInFlight when it is done.
+        Entry* waitForInFlight(const LayoutCacheKey& key, std::unique_lock<std::mutex>* lock)
+                EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            bool waited = false;
+            while (mInFlight.find(key) != mInFlight.end()) {
+                mInFlightDone.wait(*lock);
+                waited = true;
+            }
+            if (waited) {
+                Entry* entry = mCache.get(key).get();
+                if (entry != nullptr) {
+                    return entry;
+                }
+            }
+            mInFlight.insert(key);
+            return nullptr;
+        }
+
+        // Removes the entries pred(key, entry) is true for, stopping after maxCount of them.
+        template <typename P>
+        void removeIf(size_t maxCount, const P& pred) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            // The cache can't be modified while it is iterated. The keys refer to the text of
+            // their entries, which is alive until the key is removed.
+            std::vector<LayoutCacheKey> keys;
+            android::LruCache<LayoutCacheKey, std::shared_ptr<Entry>>::Iterator it(mCache);
+            while (keys.size() < maxCount && it.next()) {
+                if (pred(it.key(), *it.value())) {
+                    keys.push_back(it.key());
+                }
+            }
+            for (const LayoutCacheKey& key : keys) {
+                mCache.remove(key);
+            }
+        }
+
+        void trim() EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            while (mMaxBytes == 0 ? mCache.size() > mMaxEntries : mBytes > mMaxBytes) {
+                const uint32_t boundsCount = mBoundsCount;
+                if (!mCache.removeOldest()) {
+                    break;
+                }
+                mStats->evict();
+                if (mBoundsCount != boundsCount) {
+                    mBoundsStats->evict();
+                }
+            }
+        }
+
+        std::mutex mMutex;
+        // The recent lookups of the keys. Null unless the frequency admission is enabled.
+        std::unique_ptr<FrequencySketch> mSketch GUARDED_BY(mMutex);
+        // The entries are shared so that getOrCreateRun() can use them without holding the lock.
+        android::LruCache<LayoutCacheKey, std::shared_ptr<Entry>> mCache GUARDED_BY(mMutex);
+        const uint32_t mMaxEntries;
+        size_t mMaxBytes GUARDED_BY(mMutex);  // 0 means the entry count limit is used.
+        size_t mBytes GUARDED_BY(mMutex);
+        uint32_t mBoundsCount GUARDED_BY(mMutex);  // The number of entries having bounds.
+        // The number of entries of each font collection, for purgeCollection().
+        std::unordered_map<uint32_t, uint32_t> mCollectionEntryCounts GUARDED_BY(mMutex);
+        CacheStats* mStats;
+        CacheStats* mBoundsStats;
+
+        // The keys being shaped in the single flight mode. The keys refer to the text of the
+        // shaping thread, which outlives the entry.
+        std::unordered_set<LayoutCacheKey, LayoutCacheKey::Hash> mInFlight GUARDED_BY(mMutex);
+        std::condition_variable mInFlightDone;
+
+    private:
+        // Returns true if the new entry of bytes may be inserted. It is always admitted if there
+        // is room for it, and otherwise only if its key is more popular than the key of the
+        // entry it would evict.
+        bool admit(const LayoutCacheKey& key, size_t bytes) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            const bool full = mMaxBytes == 0 ? mCache.size() >= mMaxEntries
+                                             : mBytes + bytes > mMaxBytes;
+            if (!full || mCache.size() == 0) {
+                return true;
+            }
+            const std::shared_ptr<Entry>& victim = mCache.peekOldestValue();
+            return mSketch->frequency(key.hash()) > mSketch->frequency(victim->keyHash);
+        }
+
+        // callback for OnEntryRemoved
+        void operator()(LayoutCacheKey& key, std::shared_ptr<Entry>& value)
+                EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+            mBytes -= getEntryMemoryUsage(key, *value);
+            if (value->hasBounds) {
+                mBoundsCount--;
+            }
+            auto it = mCollectionEntryCounts.find(key.getFontCollectionId());
+            if (--it->second == 0) {
+                mCollectionEntryCounts.erase(it);
+            }
+        }
+
+        // The text is shared by the key and the piece, so count it only once. The text of an
+        // entry with a textOwner is in the owner's buffer, which the entry keeps alive, so it is
+        // counted as if the piece retained it. The bounds are stored inline, so an entry uses the
+        // same amount of memory with or without them.
+        static size_t getEntryMemoryUsage(const LayoutCacheKey& key, const Entry& entry) {
+            const size_t ownerTextBytes = entry.textOwner != nullptr ? key.getTextMemoryUsage() : 0;
+            return key.getMemoryUsage() - key.getTextMemoryUsage() + entry.piece.getMemoryUsage() +
+                   ownerTextBytes + sizeof(Entry) - sizeof(LayoutPiece);
+        }
+    };
+
+    bool skipCache(const MinikinPaint& paint, const Range& range) const {
+        if (paint.skipCache()) {
+            return true;
+        }
+        if (range.getLength() < LENGTH_LIMIT_CACHE) {
+            return false;
+        }
+        return range.getLength() >= LENGTH_LIMIT_LONG_CACHE ||
+               !mLongCacheEnabled.load(std::memory_order_relaxed);
+    }
+
+    // Returns the index of the shard of the key, which is the shard count for the long shard.
+    uint32_t getShardIndex(const LayoutCacheKey& key) const {
+        if (key.getLength() >= LENGTH_LIMIT_CACHE) {
+            return mShards.size();
+        }
+        // Multiply-shift maps the hash onto [0, shardCount) using its upper bits.
+        const uint64_t hash = static_cast<uint32_t>(key.hash());
+        return (hash * mShards.size()) >> 32;
+    }
+
+    Shard& getShardAt(uint32_t index) const {
+        return index == mShards.size() ? *mLongShard : *mShards[index];
+    }
+
+    Shard& getShard(const LayoutCacheKey& key) const { return getShardAt(getShardIndex(key)); }
+
+    // The lookups of a getOrCreateRun() call, reused by the calls of the thread.
+    struct RunProbe {
+        uint32_t shardIndex;
+        uint32_t pieceIndex;
+        LayoutCacheKey key;
+        std::shared_ptr<Entry> hit;  // Pins the entry found in the shard.
+    };
+    struct RunScratch {
+        std::vector<RunProbe> probes;
+        // The entry of each piece, kept alive by the thread cache, by its probe or by created.
+        std::vector<const Entry*> hits;
+        // The first piece of the run with the same key as each piece.
+        std::vector<uint32_t> firstPieces;
+        // Pins the entries shaped for the misses, which may be evicted before the run is done.
+        std::vector<std::shared_ptr<Entry>> created;
+    };
+    static RunScratch& getRunScratch() {
+        static thread_local RunScratch scratch;
+        return scratch;
+    }
+
+    // The number of slots of the thread cache of each thread, which takes about 24KB.
+    static const uint32_t kThreadCacheSize = 256;
+
+    // A slot of the thread cache. The key refers to the text retained by the piece of the entry.
+    struct ThreadCacheSlot {
+        const LayoutCache* owner = nullptr;
+        uint64_t epoch = 0;
+        std::optional<LayoutCacheKey> key;
+        std::shared_ptr<Entry> entry;
+    };
+    using ThreadCache = std::array<ThreadCacheSlot, kThreadCacheSize>;
+    static ThreadCache& getThreadCache() {
+        static thread_local ThreadCache cache;
         return cache;
     }
 
-protected:
-    LayoutCache(uint32_t maxEntries) : mCache(maxEntries) {
-        mCache.setOnEntryRemovedListener(this);
+    // Bumped whenever entries are removed other than by eviction, which invalidates the thread
+    // caches of all the threads. Shared by all the instances, so that a slot of a destroyed cache
+    // is not taken for one of a new cache at the same address.
+    static std::atomic<uint64_t>& getThreadCacheEpochCounter() {
+        static std::atomic<uint64_t> epoch(0);
+        return epoch;
+    }
+    // The epoch must be read before the shards are looked up, so that an entry found just before
+    // a purge is not added to the thread cache as if it was found after it.
+    static uint64_t getThreadCacheEpoch() {
+        return getThreadCacheEpochCounter().load(std::memory_order_acquire);
+    }
+    static void invalidateThreadCaches() {
+        getThreadCacheEpochCounter().fetch_add(1, std::memory_order_release);
     }
 
-    uint32_t getCacheSize() {
-        std::lock_guard<std::mutex> lock(mMutex);
-        return mCache.size();
+    // Returns the entry of the key in the thread cache of the calling thread, or nullptr. The
+    // entry stays alive until the next insertIntoThreadCache() of the thread.
+    const Entry* findInThreadCache(const LayoutCacheKey& key, uint64_t epoch) const {
+        const ThreadCacheSlot& slot = getThreadCache()[key.hash() % kThreadCacheSize];
+        if (slot.owner != this || slot.epoch != epoch || slot.key->hash() != key.hash() ||
+            !(*slot.key == key)) {
+            return nullptr;
+        }
+        return slot.entry.get();
     }
 
-private:
-    // callback for OnEntryRemoved
-    void operator()(LayoutCacheKey& key, LayoutPiece*& value) {
-        key.freeText();
-        delete value;
+    // Replaces the slot of the key in the thread cache of the calling thread with the entry.
+    void insertIntoThreadCache(const LayoutCacheKey& key, std::shared_ptr<Entry> entry,
+                               uint64_t epoch) {
+        const uint16_t* text = entry->piece.text();
+        if (text == nullptr) {
+            // The text is only kept alive by the owner of the caller's buffer.
+            return;
+        }
+        ThreadCacheSlot& slot = getThreadCache()[key.hash() % kThreadCacheSize];
+        slot.owner = this;
+        slot.epoch = epoch;
+        slot.key = key;
+        slot.key->shareText(text);
+        slot.entry = std::move(entry);
+    }
+
+    template <typename F>
+    void forEachShard(F f) const {
+        for (const std::unique_ptr<Shard>& shard : mShards) {
+            f(*shard);
+        }
+        f(*mLongShard);
     }
 
-    android::LruCache<LayoutCacheKey, LayoutPiece*> mCache GUARDED_BY(mMutex);
+    CacheStats mStats;
+    CacheStats mLongStats;
+    CacheStats mBoundsStats;
+    std::atomic<bool> mSingleFlight;
+    std::atomic<bool> mLongCacheEnabled;
+    std::atomic<bool> mThreadCacheEnabled;
+    std::atomic<bool> mSizeInvariantLayouts;
+    CacheStats mSharedTableStats;
+    // Set along with mSharedTable, so that the misses without a table don't load it.
+    std::atomic<bool> mHasSharedTable;
+    // Only read and written with the atomic shared_ptr functions, so a miss doesn't take a lock
+    // of the cache, and the table stays alive while a lookup uses it.
+    std::shared_ptr<const SharedTable> mSharedTable;
+    std::vector<std::unique_ptr<Shard>> mShards;
+    // The pieces longer than LENGTH_LIMIT_CACHE. Always evicted by a byte budget.
+    std::unique_ptr<Shard> mLongShard;
 
     // static const size_t kMaxEntries = LruCache<LayoutCacheKey, Layout*>::kUnlimitedCapacity;
 
-    // TODO: eviction based on memory footprint; for now, we just use a constant
-    // number of strings
+    // The entry count limit used until a byte budget is set with setMaxMemoryUsage().
     static const size_t kMaxEntries = 5000;
 
-    std::mutex mMutex;
+    // The number of shards used by the global instance. Enough to keep a dozen of rendering and
+    // measuring threads from waiting on each other.
+    static const uint32_t kShardCount = 16;
+
+    // The byte budget for the long pieces of the global instance. About a hundred lines of CJK
+    // text.
+    static const size_t kMaxLongBytes = 1024 * 1024;
 };
 
 inline android::hash_t hash_type(const LayoutCacheKey& key) {
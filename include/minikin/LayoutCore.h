@@ -17,10 +17,14 @@
 #ifndef MINIKIN_LAYOUT_CORE_H
 #define MINIKIN_LAYOUT_CORE_H
 
+#include <atomic>
+#include <cmath>
+#include <cstddef>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 
+#include "minikin/Buffer.h"
 #include "minikin/FontFamily.h"
 #include "minikin/Hyphenator.h"
 #include "minikin/MinikinExtent.h"
@@ -31,6 +35,7 @@
 
 namespace minikin {
 
+class FontCollection;
 struct MinikinPaint;
 
 struct Point {
@@ -42,45 +47,216 @@ struct Point {
 };
 
 // Immutable, recycle-able layout result.
+//
+// The per glyph and per code unit arrays, and optionally a copy of the input text, are stored in
+// a single heap block. Building a piece costs one allocation, and iterating glyphs touches
+// contiguous memory.
 class LayoutPiece {
 public:
+    // A read-only view of one of the arrays stored in a LayoutPiece.
+    template <typename T>
+    class Span {
+    public:
+        Span(const T* data, uint32_t size) : mData(data), mSize(size) {}
+
+        const T* begin() const { return mData; }
+        const T* end() const { return mData + mSize; }
+        const T* data() const { return mData; }
+        uint32_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+        const T& operator[](uint32_t i) const { return mData[i]; }
+
+    private:
+        const T* mData;
+        uint32_t mSize;
+    };
+
+    // A position in the text where the piece can be split without changing the glyphs, i.e. the
+    // text before and after it can be shaped separately and give the same result. The offset is
+    // in code units from the start of the range, and the glyphs visually before the position are
+    // the glyphs [0, glyphIndex).
+    struct SafeBreak {
+        uint32_t offset;
+        uint32_t glyphIndex;
+    };
+
+    // If retainText is true, the piece keeps a copy of the whole textBuf, which is accessible
+    // with text(). LayoutCache uses it as the text of the cache key to save an allocation.
+    // If recordSafeBreaks is true, the piece keeps the positions HarfBuzz reports as safe to
+    // break, which are needed by relayout().
+    // If recordLetterSpacing is true, the letter spacing of the paint only decides whether the
+    // optional ligatures are disabled. The glyphs are placed without the spacing, and the piece
+    // records where it goes instead, so that withLetterSpacing() can add any spacing which keeps
+    // the ligatures the same.
     LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
-                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen);
+                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                bool retainText = false, bool recordSafeBreaks = false,
+                bool recordLetterSpacing = false);
+
+    // Lays out textBuf[range] after an edit of the text old was laid out from, reshaping only the
+    // span between the closest safe breaks of old around the edit. The edit replaced
+    // old's code units [editStart, oldEditEnd) with the code units [editStart, newEditEnd) of the
+    // new range, and the text outside of it must be the same. The paint and the direction must be
+    // the ones old was laid out with, without hyphen edits, and old must have been built with
+    // recordSafeBreaks. The returned piece records its safe breaks, so it can be relaid out again.
+    //
+    // The extent is the union of the extents of the reshaped span and of the fonts of the reused
+    // glyphs, so it may be larger than the one of a full layout if a font was only used for
+    // characters excluded from the extent.
+    static LayoutPiece relayout(const LayoutPiece& old, const U16StringPiece& textBuf,
+                                const Range& range, uint32_t editStart, uint32_t oldEditEnd,
+                                uint32_t newEditEnd, bool isRtl, const MinikinPaint& paint);
+
+    // Returns a copy of the piece, which must have been built with recordLetterSpacing, with the
+    // letter spacing of the paint added. The paint must only differ from the one the piece was
+    // laid out with in the letter spacing, and must disable the same ligatures, see
+    // disablesOptionalLigatures(). The result is the same as laying out with the paint, up to the
+    // rounding of the positions.
+    LayoutPiece withLetterSpacing(const MinikinPaint& paint) const;
+
+    // Returns a copy of the piece with the positions, the advances and the extent multiplied by
+    // scale, e.g. to get the layout at another size of a font with linear metrics. The letter
+    // spacing steps are kept, since they do not depend on the size.
+    LayoutPiece scaled(float scale) const;
+
+    // Returns true if the letter spacing disables the optional ligatures.
+    static bool disablesOptionalLigatures(float letterSpacing) {
+        return fabs(letterSpacing) > 0.03;
+    }
+
+    // Reads a piece written by writeTo(). The fonts are looked up in the collection, which must
+    // have the same families as the one given to writeTo().
+    LayoutPiece(BufferReader* reader, const FontCollection& collection);
+
+    // Checks that the buffer holds a piece written by writeTo() whose fonts are in the collection,
+    // see BufferValidator. The length of its text and the number of its advances are returned for
+    // the caller to check them against what refers to the piece.
+    static void validate(BufferValidator* validator, const FontCollection& collection,
+                         uint32_t* outTextLength, uint32_t* outAdvanceCount);
+
+    // Copies share the arrays of the original, which are immutable, through a reference count.
+    // Copies do not retain the text.
+    LayoutPiece(const LayoutPiece& o);
+    LayoutPiece& operator=(const LayoutPiece& o);
+    LayoutPiece(LayoutPiece&& o);
+    LayoutPiece& operator=(LayoutPiece&& o);
+    ~LayoutPiece() { releaseBlock(); }
 
     // Low level accessors.
-    const std::vector<uint8_t>& fontIndices() const { return mFontIndices; }
-    const std::vector<uint32_t>& glyphIds() const { return mGlyphIds; }
-    const std::vector<Point>& points() const { return mPoints; }
-    const std::vector<float>& advances() const { return mAdvances; }
+    Span<uint8_t> fontIndices() const { return Span<uint8_t>(fontIndexArray(), mGlyphCount); }
+    Span<uint32_t> glyphIds() const { return Span<uint32_t>(glyphIdArray(), mGlyphCount); }
+    Span<Point> points() const { return Span<Point>(pointArray(), mGlyphCount); }
+    Span<float> advances() const { return Span<float>(advanceArray(), mAdvanceCount); }
     float advance() const { return mAdvance; }
     const MinikinExtent& extent() const { return mExtent; }
-    const std::vector<FakedFont>& fonts() const { return mFonts; }
+    Span<FakedFont> fonts() const { return Span<FakedFont>(fontArray(), mFontCount); }
+    // Sorted by offset. Empty unless the piece was built with recordSafeBreaks. The start and the
+    // end of the range are always safe and are not recorded.
+    Span<SafeBreak> safeBreaks() const {
+        return Span<SafeBreak>(safeBreakArray(), mSafeBreakCount);
+    }
+
+    // Returns true if the piece was built with recordLetterSpacing.
+    bool hasLetterSpacingSteps() const { return mSpacingStepCount != 0; }
+
+    // Returns the retained copy of the text, or nullptr if the piece was built without it.
+    const uint16_t* text() const { return mTextLength == 0 ? nullptr : textArray(); }
 
     // Helper accessors
-    uint32_t glyphCount() const { return mGlyphIds.size(); }
-    const FakedFont& fontAt(int glyphPos) const { return mFonts[mFontIndices[glyphPos]]; }
-    uint32_t glyphIdAt(int glyphPos) const { return mGlyphIds[glyphPos]; }
-    const Point& pointAt(int glyphPos) const { return mPoints[glyphPos]; }
-
-    uint32_t getMemoryUsage() const {
-        return sizeof(uint8_t) * mFontIndices.size() + sizeof(uint32_t) * mGlyphIds.size() +
-               sizeof(Point) * mPoints.size() + sizeof(float) * mAdvances.size() + sizeof(float) +
-               sizeof(MinikinRect) + sizeof(MinikinExtent);
+    uint32_t glyphCount() const { return mGlyphCount; }
+    const FakedFont& fontAt(int glyphPos) const {
+        return fontArray()[fontIndexArray()[glyphPos]];
     }
+    uint32_t glyphIdAt(int glyphPos) const { return glyphIdArray()[glyphPos]; }
+    const Point& pointAt(int glyphPos) const { return pointArray()[glyphPos]; }
+
+    uint32_t getMemoryUsage() const { return sizeof(LayoutPiece) + blockSize(); }
+
+    // Computes the bounding box of the glyphs.
+    MinikinRect calculateBounds(const MinikinPaint& paint) const;
+
+    // Writes the piece, including the retained text. The letter spacing steps are not written, so
+    // the piece must not have them. The fonts are written as the index of their
+    // family in the collection and the index in the family, so that the piece can be read in
+    // other processes having the same fonts. All the fonts must belong to the collection.
+    void writeTo(BufferWriter* writer, const FontCollection& collection) const;
 
 private:
     FRIEND_TEST(LayoutTest, doLayoutWithPrecomputedPiecesTest);
 
-    std::vector<uint8_t> mFontIndices;  // per glyph
-    std::vector<uint32_t> mGlyphIds;    // per glyph
-    std::vector<Point> mPoints;         // per glyph
+    // An empty piece, to be filled by relayout().
+    LayoutPiece()
+            : mBlock(nullptr),
+              mGlyphCount(0),
+              mAdvanceCount(0),
+              mSafeBreakCount(0),
+              mSpacingStepCount(0),
+              mTextLength(0),
+              mBlockTextLength(0),
+              mFontCount(0),
+              mAdvance(0) {}
 
-    std::vector<float> mAdvances;  // per code units
+    // The reference count of the block is stored in front of it, padded so that the arrays keep
+    // the alignment of operator new[].
+    static constexpr size_t BLOCK_HEADER_SIZE = alignof(std::max_align_t);
+    static_assert(sizeof(std::atomic<uint32_t>) <= BLOCK_HEADER_SIZE);
+    std::atomic<uint32_t>* refCount() const {
+        return reinterpret_cast<std::atomic<uint32_t>*>(mBlock - BLOCK_HEADER_SIZE);
+    }
+
+    // The arrays are laid out in the block in decreasing order of alignment, so no padding is
+    // needed between them.
+    const FakedFont* fontArray() const { return reinterpret_cast<const FakedFont*>(mBlock); }
+    const Point* pointArray() const {
+        return reinterpret_cast<const Point*>(mBlock + sizeof(FakedFont) * mFontCount);
+    }
+    const uint32_t* glyphIdArray() const {
+        return reinterpret_cast<const uint32_t*>(pointArray() + mGlyphCount);
+    }
+    const float* advanceArray() const {
+        return reinterpret_cast<const float*>(glyphIdArray() + mGlyphCount);
+    }
+    const SafeBreak* safeBreakArray() const {
+        return reinterpret_cast<const SafeBreak*>(advanceArray() + mAdvanceCount);
+    }
+    const uint16_t* textArray() const {
+        return reinterpret_cast<const uint16_t*>(safeBreakArray() + mSafeBreakCount);
+    }
+    const uint8_t* fontIndexArray() const {
+        return reinterpret_cast<const uint8_t*>(textArray() + mBlockTextLength);
+    }
+    // The number of half letter spacings added before each glyph, then to the advance of each
+    // code unit, then after the last glyph, if the piece was built with recordLetterSpacing.
+    const uint8_t* spacingStepArray() const { return fontIndexArray() + mGlyphCount; }
+    // The text shared from the original of a copy is not counted.
+    size_t blockSize() const {
+        return sizeof(FakedFont) * mFontCount +
+               (sizeof(Point) + sizeof(uint32_t) + sizeof(uint8_t)) * mGlyphCount +
+               sizeof(float) * mAdvanceCount + sizeof(SafeBreak) * mSafeBreakCount +
+               sizeof(uint16_t) * mTextLength + sizeof(uint8_t) * mSpacingStepCount;
+    }
+
+    // Allocates the block for the current array sizes and copies the arrays into it. The text
+    // is only read if mTextLength is not zero.
+    void initBlock(const FakedFont* fonts, const Point* points, const uint32_t* glyphIds,
+                   const float* advances, const SafeBreak* safeBreaks, const uint16_t* text,
+                   const uint8_t* fontIndices, const uint8_t* spacingSteps);
+    // Drops the reference to the block, and frees it if it was the last one.
+    void releaseBlock();
+    void copyFrom(const LayoutPiece& o);
+    void moveFrom(LayoutPiece&& o);
+
+    uint8_t* mBlock;
+    uint32_t mGlyphCount;
+    uint32_t mAdvanceCount;  // The number of code units.
+    uint32_t mSafeBreakCount;
+    uint32_t mSpacingStepCount;  // 0, or mGlyphCount + mAdvanceCount + 1.
+    uint32_t mTextLength;       // 0 if the text is not retained.
+    uint32_t mBlockTextLength;  // The length of the text in the block, which may be shared.
+    uint32_t mFontCount;
 
     float mAdvance;
     MinikinExtent mExtent;
-
-    std::vector<FakedFont> mFonts;
 };
 
 // For gtest output
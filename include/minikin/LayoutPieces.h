@@ -18,16 +18,17 @@
 #define MINIKIN_LAYOUT_PIECES_H
 
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "minikin/LayoutCache.h"
 #include "minikin/LayoutCore.h"
 #include "minikin/MinikinPaint.h"
+#include "minikin/PaintIdCache.h"
 
 namespace minikin {
 
 struct LayoutPieces {
-    const static uint32_t kNoPaintId = static_cast<uint32_t>(-1);
-
     struct Key {
         Key(const Range& range, HyphenEdit hyphenEdit, bool dir, uint32_t paintId)
                 : range(range), hyphenEdit(hyphenEdit), dir(dir), paintId(paintId) {}
@@ -35,10 +36,10 @@ struct LayoutPieces {
         Range range;
         HyphenEdit hyphenEdit;
         bool dir;
-        uint32_t paintId;
+        uint32_t paintId;  // The PaintIdCache ID of the paint.
 
         uint32_t hash() const {
-            return Hasher()
+            return WideHasher()
                     .update(range.getStart())
                     .update(range.getEnd())
                     .update(hyphenEdit)
@@ -61,29 +62,31 @@ struct LayoutPieces {
         std::size_t operator()(const Key& key) const { return key.hash(); }
     };
 
-    struct PaintHasher {
-        std::size_t operator()(const MinikinPaint& paint) const { return paint.hash(); }
-    };
-
-    LayoutPieces() : nextPaintId(0) {}
+    LayoutPieces() {}
     ~LayoutPieces() {}
 
-    uint32_t nextPaintId;
-    std::unordered_map<MinikinPaint, uint32_t, PaintHasher> paintMap;
+    // The paint IDs of the pieces.
+    std::unordered_set<uint32_t> paintIds;
     std::unordered_map<Key, LayoutPiece, KeyHasher> offsetMap;
 
     void insert(const Range& range, HyphenEdit edit, const LayoutPiece& layout, bool dir,
-                const MinikinPaint& paint) {
-        uint32_t paintId = findPaintId(paint);
-        if (paintId == kNoPaintId) {
-            paintId = nextPaintId++;
-            paintMap.insert(std::make_pair(paint, paintId));
-        }
+                uint32_t paintId) {
+        paintIds.insert(paintId);
         offsetMap.emplace(std::piecewise_construct,
                           std::forward_as_tuple(range, edit, dir, paintId),
                           std::forward_as_tuple(layout));
     }
 
+    // Moves all the pieces of the other into this. The paint IDs are global, so the keys are kept.
+    void merge(LayoutPieces&& other) {
+        paintIds.insert(other.paintIds.begin(), other.paintIds.end());
+        for (auto& [key, layout] : other.offsetMap) {
+            offsetMap.emplace(key, std::move(layout));
+        }
+        other.paintIds.clear();
+        other.offsetMap.clear();
+    }
+
     template <typename F>
     void getOrCreate(const U16StringPiece& textBuf, const Range& range, const Range& context,
                      const MinikinPaint& paint, bool dir, StartHyphenEdit startEdit,
@@ -92,24 +95,21 @@ struct LayoutPieces {
         auto it = offsetMap.find(Key(range, edit, dir, paintId));
         if (it == offsetMap.end()) {
             LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
-                                                   range - context.getStart(), paint, dir,
+                                                   range - context.getStart(), paint, paintId, dir,
                                                    startEdit, endEdit, f);
         } else {
             f(it->second, paint);
         }
     }
 
-    uint32_t findPaintId(const MinikinPaint& paint) const {
-        auto paintIt = paintMap.find(paint);
-        return paintIt == paintMap.end() ? kNoPaintId : paintIt->second;
-    }
+    bool hasPaintId(uint32_t paintId) const { return paintIds.count(paintId) != 0; }
 
     uint32_t getMemoryUsage() const {
         uint32_t result = 0;
         for (const auto& i : offsetMap) {
             result += i.first.getMemoryUsage() + i.second.getMemoryUsage();
         }
-        result += (sizeof(MinikinPaint) + sizeof(uint32_t)) * paintMap.size();
+        result += sizeof(uint32_t) * paintIds.size();
         return result;
     }
 };
@@ -23,6 +23,7 @@
 #define MINIKIN_LINE_BREAKER_H
 
 #include <deque>
+#include <memory>
 #include <vector>
 
 #include "minikin/FontCollection.h"
@@ -47,7 +48,10 @@ enum class HyphenationFrequency : uint8_t {
     Full = 2,
 };
 
+class CallRecorder;
 class Hyphenator;
+class LineBreakResultCache;
+class StreamingLineBreaker;
 class WordBreaker;
 
 class TabStops {
@@ -69,6 +73,10 @@ public:
     }
 
 private:
+    friend class CallRecorder;
+    friend class LineBreakResultCache;
+    friend class StreamingLineBreaker;
+
     const float* mStops;
     size_t mStopsSize;
     float mTabWidth;
@@ -88,12 +96,22 @@ public:
     virtual float getMin() const = 0;
 };
 
+// A line of a LineBreakResult, for callers which want one record per line, like the JNI which can
+// then copy all the lines at once.
+struct LineBreakLine {
+    int breakPoint;
+    float width;
+    float ascent;
+    float descent;
+    int flags;
+};
+
 struct LineBreakResult {
 public:
     LineBreakResult() = default;
 
-    // Following five vectors have the same length.
-    // TODO: Introduce individual line info struct if copy cost in JNI is negligible.
+    // Following five vectors have the same length, except that ascents and descents are empty if
+    // the extents were not computed.
     std::vector<int> breakPoints;
     std::vector<float> widths;
     std::vector<float> ascents;
@@ -111,6 +129,28 @@ public:
         std::reverse(flags.begin(), flags.end());
     }
 
+    bool hasExtents() const { return ascents.size() == breakPoints.size(); }
+
+    // Replaces the contents of out with the lines of this result. The ascents and descents are 0
+    // if the extents were not computed.
+    void getLines(std::vector<LineBreakLine>* out) const {
+        const bool extents = hasExtents();
+        out->resize(breakPoints.size());
+        for (size_t i = 0; i < breakPoints.size(); ++i) {
+            (*out)[i] = {breakPoints[i], widths[i], extents ? ascents[i] : 0.0f,
+                         extents ? descents[i] : 0.0f, flags[i]};
+        }
+    }
+
+    // Removes all the lines, keeping the capacity of the vectors.
+    void clear() {
+        breakPoints.clear();
+        widths.clear();
+        ascents.clear();
+        descents.clear();
+        flags.clear();
+    }
+
 private:
     MINIKIN_PREVENT_COPY_AND_ASSIGN(LineBreakResult);
 };
@@ -120,6 +160,97 @@ LineBreakResult breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy s
                                const MeasuredText& measuredText, const LineWidth& lineWidth,
                                const TabStops& tabStops);
 
+// Breaks the text into lines for each of the line widths, every line of a result having the same
+// width, and returns the results in the order of the widths. The number of lines of a result is
+// the size of its breakPoints. The work which doesn't depend on the width, like finding the break
+// candidates of the optimal line breaker, is done once for all the widths.
+std::vector<LineBreakResult> breakIntoLinesForWidths(const U16StringPiece& textBuffer,
+                                                     BreakStrategy strategy,
+                                                     HyphenationFrequency frequency, bool justified,
+                                                     const MeasuredText& measuredText,
+                                                     const std::vector<float>& lineWidths,
+                                                     const TabStops& tabStops);
+
+// A paragraph for the batch version of breakIntoLines. The pointers are not owned and must stay
+// valid during the call.
+struct LineBreakJob {
+    U16StringPiece text;
+    const MeasuredText* measuredText;
+    const LineWidth* lineWidth;
+    const TabStops* tabStops;
+};
+
+// Breaks the paragraphs of the jobs in parallel on up to maxThreads threads, including the calling
+// one and the foreground tasks of getExecutor(), or on all of its threads if maxThreads is 0.
+// Returns the results in the order of the jobs. The line widths must be safe to use from any
+// thread, and jobs that run in parallel must not share a MeasuredText measured with lazy
+// hyphenation.
+std::vector<LineBreakResult> breakIntoLines(const std::vector<LineBreakJob>& jobs,
+                                            BreakStrategy strategy, HyphenationFrequency frequency,
+                                            bool justified, uint32_t maxThreads = 0);
+
+struct OptimalLineBreakState;
+
+// Keeps the intermediate results of breakIntoLines across calls, so that a paragraph can be broken
+// again after an edit without redoing the work for the text before the edit.
+class LineBreakerState {
+public:
+    LineBreakerState();
+    ~LineBreakerState();
+
+    // Forgets the previous computation. The next breakIntoLines call computes everything.
+    void clear();
+
+    // For internal use.
+    std::unique_ptr<OptimalLineBreakState>& optimalState() { return mOptimalState; }
+
+private:
+    std::unique_ptr<OptimalLineBreakState> mOptimalState;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(LineBreakerState);
+};
+
+struct GreedyLineBreakScratch;
+struct OptimalLineBreakScratch;
+
+// Memory the line breakers reuse across paragraphs, so that breaking a paragraph no larger than the
+// previous ones doesn't allocate. Not thread safe: use one per thread.
+class LineBreakScratch {
+public:
+    LineBreakScratch();
+    ~LineBreakScratch();
+
+    // For internal use.
+    std::unique_ptr<GreedyLineBreakScratch>& greedyScratch() { return mGreedyScratch; }
+    std::unique_ptr<OptimalLineBreakScratch>& optimalScratch() { return mOptimalScratch; }
+
+private:
+    std::unique_ptr<GreedyLineBreakScratch> mGreedyScratch;
+    std::unique_ptr<OptimalLineBreakScratch> mOptimalScratch;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(LineBreakScratch);
+};
+
+// Same as the first breakIntoLines, but uses the memory of scratch for the intermediate results
+// and writes the result to out, reusing the capacity of its vectors. If computeExtents is false,
+// the ascents and descents of the lines are not computed and may be left empty, which saves
+// measuring the extent of every line.
+void breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                    HyphenationFrequency frequency, bool justified,
+                    const MeasuredText& measuredText, const LineWidth& lineWidth,
+                    const TabStops& tabStops, bool computeExtents, LineBreakScratch* scratch,
+                    LineBreakResult* out);
+
+// Same as the first breakIntoLines, but reuses the results that the previous call with the same
+// state computed for the text before editOffset, the first code unit that may differ from the text
+// of that call. The other arguments must be the same as in that call, except for the measured text
+// which must be measured for the new text. Pass 0 as editOffset to recompute everything.
+LineBreakResult breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                               HyphenationFrequency frequency, bool justified,
+                               const MeasuredText& measuredText, const LineWidth& lineWidth,
+                               const TabStops& tabStops, uint32_t editOffset,
+                               LineBreakerState* state);
+
 }  // namespace minikin
 
 #endif  // MINIKIN_LINE_BREAKER_H
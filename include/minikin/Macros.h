@@ -69,4 +69,19 @@
 #define EXCLUSIVE_LOCKS_REQUIRED(...) \
     THREAD_ANNOTATION_ATTRIBUTE__(exclusive_locks_required(__VA_ARGS__))
 
+// SHARED_LOCKS_REQUIRED()
+//
+// Same as EXCLUSIVE_LOCKS_REQUIRED, but the mutex may also be held in shared mode, e.g. by a
+// std::shared_lock.
+#define SHARED_LOCKS_REQUIRED(...) \
+    THREAD_ANNOTATION_ATTRIBUTE__(shared_locks_required(__VA_ARGS__))
+
+// NO_THREAD_SAFETY_ANALYSIS
+//
+// Turns off thread safety checking within the body of a particular function.
+// This is used as an escape hatch for cases where either (a) the function is
+// correct, but the locking is more complicated than the analyzer can handle,
+// or (b) the function contains race conditions that are known to be benign.
+#define NO_THREAD_SAFETY_ANALYSIS THREAD_ANNOTATION_ATTRIBUTE__(no_thread_safety_analysis)
+
 #endif  // MINIKIN_MACROS_H
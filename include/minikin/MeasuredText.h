@@ -17,19 +17,35 @@
 #ifndef MINIKIN_MEASURED_TEXT_H
 #define MINIKIN_MEASURED_TEXT_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include "minikin/Executor.h"
 #include "minikin/FontCollection.h"
 #include "minikin/Layout.h"
 #include "minikin/LayoutPieces.h"
 #include "minikin/Macros.h"
 #include "minikin/MinikinFont.h"
+#include "minikin/PaintIdCache.h"
 #include "minikin/Range.h"
 #include "minikin/U16StringPiece.h"
 
 namespace minikin {
 
+class LineBreakResultCache;
+class PieceExtentTable;
+class PieceLayoutTable;
+
+class Hyphenator;
+
 class Run {
 public:
     Run(const Range& range) : mRange(range) {}
@@ -53,6 +69,20 @@ public:
     virtual MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
                                     const LayoutPieces& pieces) const = 0;
 
+    // Appends the layout pieces getExtent joins the extents of over the whole run, with their
+    // extents, to out. The runs which don't compute their extents from layout pieces append
+    // nothing.
+    virtual void getPieceExtents(const U16StringPiece& /* text */,
+                                 const LayoutPieces& /* pieces */,
+                                 std::vector<std::pair<Range, MinikinExtent>>* /* out */) const {}
+
+    // Appends the layout pieces of the whole run which appendLayout with the paint of the run
+    // reads from pieces, with their ranges, to out. The runs which don't lay out from layout
+    // pieces, or whose pieces are not all in pieces, append nothing.
+    virtual void getPieceLayouts(
+            const U16StringPiece& /* text */, const LayoutPieces& /* pieces */,
+            std::vector<std::pair<Range, const LayoutPiece*>>* /* out */) const {}
+
     virtual void appendLayout(const U16StringPiece& text, const Range& range,
                               const Range& contextRange, const LayoutPieces& pieces,
                               const MinikinPaint& paint, uint32_t outOrigin,
@@ -75,6 +105,20 @@ public:
         return 0.0;
     }
 
+    // Returns true if the hyphenation pieces of the word in range can be measured from the
+    // character widths plus getHyphenEditAdvance instead of measureHyphenPiece, i.e. splitting the
+    // word changes the shaping of nothing but the inserted hyphens.
+    virtual bool canApproximateHyphenPieces(const U16StringPiece& /* text */,
+                                            const Range& /* range */) const {
+        return false;
+    }
+
+    // Returns the advance of the characters the hyphen edits insert.
+    virtual float getHyphenEditAdvance(StartHyphenEdit /* startHyphen */,
+                                       EndHyphenEdit /* endHyphen */) const {
+        return 0.0;
+    }
+
     inline const Range& getRange() const { return mRange; }
 
 protected:
@@ -84,7 +128,14 @@ protected:
 class StyleRun : public Run {
 public:
     StyleRun(const Range& range, MinikinPaint&& paint, bool isRtl)
-            : Run(range), mPaint(std::move(paint)), mIsRtl(isRtl) {}
+            : Run(range),
+              mPaint(std::move(paint)),
+              mPaintId(PaintIdCache::getId(mPaint)),
+              mIsRtl(isRtl) {
+        for (std::atomic<float>& advance : mHyphenEditAdvances) {
+            advance.store(std::numeric_limits<float>::quiet_NaN(), std::memory_order_relaxed);
+        }
+    }
 
     bool canBreak() const override { return true; }
     uint32_t getLocaleListId() const override { return mPaint.localeListId; }
@@ -99,6 +150,12 @@ public:
     MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
                             const LayoutPieces& pieces) const override;
 
+    void getPieceExtents(const U16StringPiece& text, const LayoutPieces& pieces,
+                         std::vector<std::pair<Range, MinikinExtent>>* out) const override;
+
+    void getPieceLayouts(const U16StringPiece& text, const LayoutPieces& pieces,
+                         std::vector<std::pair<Range, const LayoutPiece*>>* out) const override;
+
     void appendLayout(const U16StringPiece& text, const Range& range, const Range& contextRange,
                       const LayoutPieces& pieces, const MinikinPaint& paint, uint32_t outOrigin,
                       StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
@@ -110,9 +167,24 @@ public:
                              StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                              LayoutPieces* pieces) const override;
 
+    bool canApproximateHyphenPieces(const U16StringPiece& text,
+                                    const Range& range) const override;
+
+    float getHyphenEditAdvance(StartHyphenEdit startHyphen,
+                               EndHyphenEdit endHyphen) const override;
+
 private:
+    // Measures the advance of the characters inserted by the hyphen edit, not memoized.
+    float measureHyphenEditAdvance(HyphenEdit edit) const;
+
     MinikinPaint mPaint;
+    // Looked up once, as the paint never changes.
+    const uint32_t mPaintId;
     const bool mIsRtl;
+    // The advances of the inserted characters indexed by the packed start or end hyphen edit,
+    // measured on the first use, or NaN. The line breakers of different threads may measure the
+    // same edit at once, and store the same advance.
+    mutable std::array<std::atomic<float>, MASK_START_OF_LINE + 1> mHyphenEditAdvances;
 };
 
 class ReplacementRun : public Run {
@@ -153,6 +225,14 @@ private:
     const uint32_t mLocaleListId;
 };
 
+// An edit of the text a hint was measured from: the code units [start, start + removedLength) of
+// the old text were replaced with insertedLength code units.
+struct TextEdit {
+    uint32_t start;
+    uint32_t removedLength;
+    uint32_t insertedLength;
+};
+
 // Represents a hyphenation break point.
 struct HyphenBreak {
     // The break offset.
@@ -171,9 +251,43 @@ struct HyphenBreak {
             : offset(offset), type(type), first(first), second(second) {}
 };
 
+// A word break offset found by WordBreaker, with its badness and the word before it as returned by
+// WordBreaker right after it returned the offset.
+struct WordBreakPoint {
+    // The offset returned by WordBreaker, or NO_MORE_WORD_BREAKS at the end of text.
+    uint32_t offset;
+
+    // The value of WordBreaker::breakBadness.
+    int badness;
+
+    // The value of WordBreaker::wordRange.
+    Range wordRange;
+
+    WordBreakPoint(uint32_t offset, int badness, const Range& wordRange)
+            : offset(offset), badness(badness), wordRange(wordRange) {}
+};
+
+// The offset of the WordBreakPoint after the last word break.
+constexpr uint32_t NO_MORE_WORD_BREAKS = static_cast<uint32_t>(-1);
+
+// The word breaks of each group of consecutive runs with the same locale, keyed by the start of the
+// group and sorted by the start. See MeasuredText::getWordBreaks.
+using WordBreaks = std::vector<std::pair<uint32_t, std::vector<WordBreakPoint>>>;
+
+// Returns the word breaks of the group starting at runStart, or nullptr if there is none.
+inline const std::vector<WordBreakPoint>* findWordBreaks(const WordBreaks& wordBreaks,
+                                                         uint32_t runStart) {
+    auto it = std::lower_bound(
+            wordBreaks.begin(), wordBreaks.end(), runStart,
+            [](const std::pair<uint32_t, std::vector<WordBreakPoint>>& entry, uint32_t o) {
+                return entry.first < o;
+            });
+    return it != wordBreaks.end() && it->first == runStart ? &it->second : nullptr;
+}
+
 class MeasuredText {
 public:
-    // Character widths.
+    // Character widths. Empty if the widths are compact, use widthAt() instead.
     std::vector<float> widths;
 
     // Hyphenation points.
@@ -186,38 +300,182 @@ public:
     // TODO: Stop assigning width/extents if layout pieces are available for reducing memory impact.
     LayoutPieces layoutPieces;
 
+    // The compact widths are in units of 1/COMPACT_WIDTH_SCALE px, positive widths are at least
+    // one unit. The widths which don't fit are stored exactly in a side table and marked with
+    // COMPACT_WIDTH_EXACT.
+    static constexpr float COMPACT_WIDTH_SCALE = 64.0f;
+    static constexpr uint16_t COMPACT_WIDTH_EXACT = 0xFFFF;
+
+    // Returns the width of the code unit at the offset, from widths or from the compact widths.
+    float widthAt(uint32_t offset) const {
+        if (mCompactWidths.empty()) {
+            return widths[offset];
+        }
+        const uint16_t compactWidth = mCompactWidths[offset];
+        if (compactWidth != COMPACT_WIDTH_EXACT) {
+            return compactWidth / COMPACT_WIDTH_SCALE;
+        }
+        return exactWidthAt(offset);
+    }
+
+    // Returns true if the widths are stored in the compact encoding, in which case widths is empty.
+    bool hasCompactWidths() const { return !mCompactWidths.empty(); }
+
     uint32_t getMemoryUsage() const {
-        return sizeof(float) * widths.size() + sizeof(HyphenBreak) * hyphenBreaks.size() +
-               layoutPieces.getMemoryUsage();
+        uint32_t result = sizeof(float) * widths.size() + sizeof(uint16_t) * mCompactWidths.size() +
+                          sizeof(std::pair<uint32_t, float>) * mExactWidths.size() +
+                          sizeof(HyphenBreak) * hyphenBreaks.size() +
+                          layoutPieces.getMemoryUsage() + getPieceExtentsMemoryUsage() +
+                          getPieceLayoutsMemoryUsage();
+        if (mLazyHyphenBreaks) {
+            std::lock_guard lock(mLazyHyphenBreaks->mutex);
+            for (const auto& entry : mLazyHyphenBreaks->breaks) {
+                result += sizeof(uint32_t) + sizeof(HyphenBreak) * entry.second.size();
+            }
+        }
+        for (const auto& entry : mWordBreaks) {
+            result += sizeof(uint32_t) + sizeof(WordBreakPoint) * entry.second.size();
+        }
+        return result;
+    }
+
+    // Returns true if the word breaks were kept while measuring, see
+    // MeasuredTextBuilder::setKeepWordBreaks.
+    bool hasWordBreaks() const { return !mWordBreaks.empty(); }
+
+    // Returns the word breaks WordBreaker returns when it is moved to the start of a run with a new
+    // locale and then advanced over the following runs with the same locale, or nullptr if there
+    // is no such run starting at the offset. The first one is the result of
+    // WordBreaker::followingWithLocale, and the last one is after the end of the runs.
+    const std::vector<WordBreakPoint>* getWordBreaks(uint32_t runStart) const {
+        return findWordBreaks(mWordBreaks, runStart);
     }
 
+    // Returns all the kept word breaks, which are empty unless hasWordBreaks() is true.
+    const WordBreaks& getWordBreaks() const { return mWordBreaks; }
+
+    // Returns true if the hyphenation points are not stored in hyphenBreaks but computed on demand
+    // with getHyphenBreaks.
+    bool isHyphenationLazy() const { return mLazyHyphenation; }
+
+    // Returns true if the hyphenation pieces of the runs which allow it are measured from the
+    // character widths, see MeasuredTextBuilder::setApproximateHyphenPieces.
+    bool hasApproximateHyphenPieces() const { return mApproximateHyphenPieces; }
+
+    // Returns the hyphenation points of the word in hyphenationTargetRange, measured in
+    // contextRange. The result is computed on the first request for the context range and
+    // memoized in this object. Only available if isHyphenationLazy() returns true.
+    // This method is thread safe, and the returned reference is valid as long as this object.
+    const std::vector<HyphenBreak>& getHyphenBreaks(const U16StringPiece& textBuf, const Run& run,
+                                                    const Hyphenator& hyphenator,
+                                                    const Range& contextRange,
+                                                    const Range& hyphenationTargetRange) const;
+
     Layout buildLayout(const U16StringPiece& textBuf, const Range& range, const Range& contextRange,
                        const MinikinPaint& paint, StartHyphenEdit startHyphen,
                        EndHyphenEdit endHyphen);
     MinikinRect getBounds(const U16StringPiece& textBuf, const Range& range) const;
     MinikinExtent getExtent(const U16StringPiece& textBuf, const Range& range) const;
 
-    MeasuredText(MeasuredText&&) = default;
-    MeasuredText& operator=(MeasuredText&&) = default;
+    // For internal use. Returns nullptr if the results of breakIntoLines are not cached, see
+    // MeasuredTextBuilder::setLineBreakCacheSize.
+    LineBreakResultCache* getLineBreakCache() const { return mLineBreakCache.get(); }
+
+    // For internal use. Returns the id CallRecorder gave to this text, or 0 if it was built while
+    // not recording.
+    uint32_t getRecordedId() const { return mRecordedId; }
+
+    ~MeasuredText();
+    MeasuredText(MeasuredText&&);
+    MeasuredText& operator=(MeasuredText&&);
 
     MINIKIN_PREVENT_COPY_AND_ASSIGN(MeasuredText);
 
 private:
     friend class MeasuredTextBuilder;
 
-    void measure(const U16StringPiece& textBuf, bool computeHyphenation, bool computeLayout,
-                 MeasuredText* hint);
-
-    // Use MeasuredTextBuilder instead.
+    // Returns false if the measurement was cancelled before all the runs were measured.
+    bool measure(const U16StringPiece& textBuf, bool computeHyphenation, bool computeLayout,
+                 MeasuredText* hint, const TextEdit* hintEdit, uint32_t maxThreads,
+                 const std::atomic<bool>* cancelled);
+    // Moves the widths to the compact encoding.
+    void compactWidths();
+    float exactWidthAt(uint32_t offset) const;
+    uint32_t getPieceExtentsMemoryUsage() const;
+    uint32_t getPieceLayoutsMemoryUsage() const;
+    // Runs WordBreaker over the runs the same way the line breakers do and keeps its results, or
+    // copies them from WordBreakCache if the same text was broken with the same locales before.
+    void computeWordBreaks(const U16StringPiece& textBuf);
+    // Returns false if the measurement was cancelled before all the runs were measured.
+    bool measureRunsInParallel(const U16StringPiece& textBuf, bool computeLayout,
+                               LayoutPieces* hintPieces, uint32_t maxThreads,
+                               const std::atomic<bool>* cancelled);
+
+    // Use MeasuredTextBuilder instead. If cancelled is not null, the runs are measured until it is
+    // set, and the text is left partially measured.
     MeasuredText(const U16StringPiece& textBuf, std::vector<std::unique_ptr<Run>>&& runs,
-                 bool computeHyphenation, bool computeLayout, MeasuredText* hint)
-            : widths(textBuf.size()), runs(std::move(runs)) {
-        measure(textBuf, computeHyphenation, computeLayout, hint);
-    }
+                 bool computeHyphenation, bool computeLayout, bool lazyHyphenation,
+                 MeasuredText* hint, const TextEdit* hintEdit, uint32_t maxThreads,
+                 bool compact, bool keepWordBreaks, uint32_t lineBreakCacheSize,
+                 bool approximateHyphenPieces, const std::atomic<bool>* cancelled = nullptr);
+
+    bool mLazyHyphenation;
+    bool mApproximateHyphenPieces;
+
+    // The widths in units of 1/COMPACT_WIDTH_SCALE px, or empty if they are in widths.
+    std::vector<uint16_t> mCompactWidths;
+
+    // The offsets and the widths marked with COMPACT_WIDTH_EXACT, sorted by offset.
+    std::vector<std::pair<uint32_t, float>> mExactWidths;
+
+    // The memoized hyphenation points keyed by the start offset of the context range. The
+    // entries are never removed, so the references to them stay valid.
+    struct LazyHyphenBreaks {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, std::vector<HyphenBreak>> breaks GUARDED_BY(mutex);
+    };
+    // Non-null if mLazyHyphenation is true. Held by pointer to keep this object movable.
+    std::unique_ptr<LazyHyphenBreaks> mLazyHyphenBreaks;
+
+    // The kept word breaks keyed by the start of the run they begin at, sorted by the start.
+    WordBreaks mWordBreaks;
+
+    std::unique_ptr<LineBreakResultCache> mLineBreakCache;
+
+    // The extents of the layout pieces for getExtent, or null if the layout was not computed.
+    std::unique_ptr<PieceExtentTable> mPieceExtents;
+
+    // The layout pieces in offset order for buildLayout, or null if the layout was not computed.
+    std::unique_ptr<PieceLayoutTable> mPieceLayouts;
+
+    uint32_t mRecordedId = 0;
+};
+
+// The handle of a MeasuredText being built by MeasuredTextBuilder::buildAsync.
+class MeasuredTextBuild {
+public:
+    MeasuredTextBuild() : mCancelled(false) {}
+
+    // Stops the build before the task starts or at the next run, e.g. when the view the text was
+    // measured for is recycled. The callback then receives null, unless it already received the
+    // MeasuredText.
+    void cancel() { mCancelled.store(true, std::memory_order_relaxed); }
+
+    bool isCancelled() const { return mCancelled.load(std::memory_order_relaxed); }
+
+private:
+    friend class MeasuredTextBuilder;
+
+    std::atomic<bool> mCancelled;
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(MeasuredTextBuild);
 };
 
 class MeasuredTextBuilder {
 public:
+    // Receives the MeasuredText built by buildAsync, or null if the build was cancelled.
+    using Callback = std::function<void(std::unique_ptr<MeasuredText>&&)>;
+
     MeasuredTextBuilder() {}
 
     void addStyleRun(int32_t start, int32_t end, MinikinPaint&& paint, bool isRtl) {
@@ -234,17 +492,90 @@ public:
         mRuns.emplace_back(std::make_unique<T>(std::forward<Args>(args)...));
     }
 
+    // If true, the built MeasuredText stores the widths in 16 bits each, rounded to 1/64 px, and
+    // they must be read with MeasuredText::widthAt. The layout pieces are not affected.
+    void setCompactWidths(bool compact) { mCompactWidths = compact; }
+
+    // If true, the built MeasuredText keeps the word breaks found while measuring, and the line
+    // breakers use them instead of running WordBreaker over the text again.
+    void setKeepWordBreaks(bool keep) { mKeepWordBreaks = keep; }
+
+    // If not zero, the built MeasuredText remembers the results of the last size breakIntoLines
+    // calls with different arguments, and a call repeating one of them copies its result.
+    void setLineBreakCacheSize(uint32_t size) { mLineBreakCacheSize = size; }
+
+    // If true, the widths of the hyphenated pieces are the sums of the character widths plus the
+    // advance of the hyphen, measured once per run, for the runs whose script is not shaped
+    // contextually, e.g. Latin or Cyrillic. Kerning against the hyphen is ignored. The other runs
+    // lay out every piece with the hyphen edits.
+    void setApproximateHyphenPieces(bool approximate) { mApproximateHyphenPieces = approximate; }
+
     std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
                                         bool computeLayout, MeasuredText* hint) {
-        // Unable to use make_unique here since make_unique is not a friend of MeasuredText.
-        return std::unique_ptr<MeasuredText>(new MeasuredText(
-                textBuf, std::move(mRuns), computeHyphenation, computeLayout, hint));
+        return build(textBuf, computeHyphenation, computeLayout, false /* lazy hyphenation */,
+                     hint);
     }
 
+    // If lazyHyphenation is true, the hyphenation points are not computed up front. Instead, the
+    // line breakers ask for them on demand with MeasuredText::getHyphenBreaks.
+    std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
+                                        bool computeLayout, bool lazyHyphenation,
+                                        MeasuredText* hint) {
+        return build(textBuf, computeHyphenation, computeLayout, lazyHyphenation, hint,
+                     1 /* max threads */);
+    }
+
+    // If maxThreads is not 1, the runs are measured in parallel on up to maxThreads threads,
+    // including the calling one and the foreground tasks of getExecutor(), or on all of its threads
+    // if maxThreads is 0. The hyphenation points
+    // are still computed on the calling thread. The custom runs must be safe to measure from any
+    // thread.
+    std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
+                                        bool computeLayout, bool lazyHyphenation,
+                                        MeasuredText* hint, uint32_t maxThreads) {
+        return build(textBuf, computeHyphenation, computeLayout, lazyHyphenation, hint, nullptr,
+                     maxThreads);
+    }
+
+    // The hint was measured from the text before the edit. Its layout pieces which are not
+    // affected by the edit are moved to their offsets in textBuf and reused, so only the words
+    // around the edit are laid out again.
+    std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
+                                        bool computeLayout, bool lazyHyphenation,
+                                        MeasuredText* hint, const TextEdit& hintEdit,
+                                        uint32_t maxThreads = 1) {
+        return build(textBuf, computeHyphenation, computeLayout, lazyHyphenation, hint, &hintEdit,
+                     maxThreads);
+    }
+
+    // Same as build() with maxThreads, but measures a copy of the text in a foreground task of the
+    // executor, or of getExecutor() if it is null, and calls the callback on the thread of the
+    // task. The runs and the settings are moved to the task, so the builder is empty afterwards.
+    // The custom runs must be safe to measure from the thread of the task.
+    std::shared_ptr<MeasuredTextBuild> buildAsync(const U16StringPiece& textBuf,
+                                                  bool computeHyphenation, bool computeLayout,
+                                                  bool lazyHyphenation, uint32_t maxThreads,
+                                                  Executor* executor, Callback&& callback);
+
     MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(MeasuredTextBuilder);
 
 private:
+    std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
+                                        bool computeLayout, bool lazyHyphenation,
+                                        MeasuredText* hint, const TextEdit* hintEdit,
+                                        uint32_t maxThreads) {
+        // Unable to use make_unique here since make_unique is not a friend of MeasuredText.
+        return std::unique_ptr<MeasuredText>(
+                new MeasuredText(textBuf, std::move(mRuns), computeHyphenation, computeLayout,
+                                 lazyHyphenation, hint, hintEdit, maxThreads, mCompactWidths,
+                                 mKeepWordBreaks, mLineBreakCacheSize, mApproximateHyphenPieces));
+    }
+
     std::vector<std::unique_ptr<Run>> mRuns;
+    bool mCompactWidths = false;
+    bool mKeepWordBreaks = false;
+    uint32_t mLineBreakCacheSize = 0;
+    bool mApproximateHyphenPieces = false;
 };
 
 }  // namespace minikin
@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include <minikin/Layout.h>
 
@@ -30,9 +31,42 @@ float getRunAdvance(const float* advances, const uint16_t* buf, size_t start, si
 size_t getOffsetForAdvance(const float* advances, const uint16_t* buf, size_t start, size_t count,
                            float advance);
 
+// The caret positions of a run, computed once so that repeated caret queries on the same run, such
+// as hit testing while the user drags a cursor, don't walk the advances again. getRunAdvance gives
+// the same results as the free function for the same arguments, and getOffsetForAdvance returns the
+// grapheme cluster boundary whose run advance is the closest to the advance, preferring the first
+// one on ties.
+class CaretIndex {
+public:
+    CaretIndex(const float* advances, const uint16_t* buf, size_t start, size_t count);
+
+    // Returns the advance up to the offset, which must be in [start, start + count]. O(1).
+    float getRunAdvance(size_t offset) const { return mCaretAdvances[offset - mStart]; }
+
+    // Returns the grapheme cluster boundary closest to the advance. O(log count).
+    size_t getOffsetForAdvance(float advance) const;
+
+private:
+    size_t mStart;
+    // The result of getRunAdvance for each offset.
+    std::vector<float> mCaretAdvances;
+    // The grapheme cluster boundaries and their advances, in increasing order of offset.
+    std::vector<uint32_t> mBreakOffsets;
+    std::vector<float> mBreakAdvances;
+};
+
+// How tight the bounds computed by getBounds are.
+enum class BoundsPrecision : uint8_t {
+    // The union of the glyph bounds, which are looked up per glyph on BoundsCache misses.
+    EXACT = 0,
+    // The advance times the vertical extent of the fonts, i.e. the ascent to the descent, which
+    // only needs the layout. Enough for ellipsizing and fitting, but glyphs may overhang it.
+    FONT_EXTENT = 1,
+};
+
 void getBounds(const U16StringPiece& str, const Range& range, Bidi bidiFlags,
                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
-               MinikinRect* out);
+               MinikinRect* out, BoundsPrecision precision = BoundsPrecision::EXACT);
 
 }  // namespace minikin
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_MEMORY_REPORT_H
+#define MINIKIN_MEMORY_REPORT_H
+
+#include <cstddef>
+#include <string>
+
+namespace minikin {
+
+// The memory used by the process-wide state of minikin, in bytes per subsystem, for sizing and
+// purging the caches. The sizes are computed from the element counts and sizeof, so they don't
+// include the allocator overhead.
+struct MemoryReport {
+    size_t layoutCache = 0;
+    size_t boundsCache = 0;
+    size_t localeListCache = 0;
+    size_t paintIdCache = 0;
+    size_t hyphenationCache = 0;
+    size_t wordBreakCache = 0;
+    // The collections of the system font map with their tables and caches. See
+    // FontCollection::getMemoryUsage().
+    size_t fontCollections = 0;
+    // The families of those collections, including their coverage.
+    size_t fontFamilies = 0;
+    // The hyphenators registered for the locales and their alphabet tables.
+    size_t hyphenators = 0;
+
+    // The following are not counted by getTotal(), since the data is owned by the typefaces or
+    // mapped from the files, and may be shared with other processes.
+    // The HarfBuzz faces of the live fonts and the size of their font data.
+    size_t harfBuzzFaceCount = 0;
+    size_t harfBuzzFontData = 0;
+    // The size of the pattern data of the hyphenators.
+    size_t hyphenationPatterns = 0;
+
+    // Walks the caches, the system font map and the hyphenators. Takes the locks of the caches
+    // one at a time, so the numbers may be slightly inconsistent with each other while they are
+    // in use.
+    static MemoryReport collect();
+
+    // The sum of the bytes allocated by minikin.
+    size_t getTotal() const;
+
+    std::string toString() const;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_MEMORY_REPORT_H
@@ -22,13 +22,13 @@
 #include <vector>
 
 #include "minikin/FontVariation.h"
+#include "minikin/MinikinRect.h"
 
 namespace minikin {
 
 class FontFakery;
 struct MinikinExtent;
 struct MinikinPaint;
-struct MinikinRect;
 
 // An abstraction for platform fonts, allowing Minikin to be used with
 // multiple actual implementations of fonts.
@@ -47,9 +47,28 @@ public:
             outAdvances[i] = GetHorizontalAdvance(glyph_ids[i], paint, fakery);
         }
     }
+    // Same as GetHorizontalAdvances, but writes the advances in the 24.8 fixed point of HarfBuzz,
+    // rounded toward zero, the i-th one at i * outStride bytes from outAdvances. Override to skip
+    // the float conversion, and return true. The default returns false, and the caller converts
+    // the results of GetHorizontalAdvances instead.
+    virtual bool GetHorizontalAdvancesFixed(uint16_t* /* glyph_ids */, uint32_t /* count */,
+                                            const MinikinPaint& /* paint */,
+                                            const FontFakery& /* fakery */,
+                                            int32_t* /* outAdvances */,
+                                            uint32_t /* outStride */) const {
+        return false;
+    }
 
     virtual void GetBounds(MinikinRect* bounds, uint32_t glyph_id, const MinikinPaint& paint,
                            const FontFakery& fakery) const = 0;
+    // Batched version of GetBounds. Override to look up the glyphs of a run in one pass.
+    virtual void GetGlyphBounds(const uint32_t* glyph_ids, uint32_t count,
+                                const MinikinPaint& paint, const FontFakery& fakery,
+                                MinikinRect* outBounds) const {
+        for (uint32_t i = 0; i < count; ++i) {
+            GetBounds(&outBounds[i], glyph_ids[i], paint, fakery);
+        }
+    }
 
     virtual void GetFontExtent(MinikinExtent* extent, const MinikinPaint& paint,
                                const FontFakery& fakery) const = 0;
@@ -45,7 +45,7 @@ enum MinikinFontFlags {
 };
 
 // Possibly move into own .h file?
-// Note: if you add a field here, either add it to LayoutCacheKey or to skipCache()
+// Note: if you add a field here, either add it to PaintIdCache or to skipCache()
 struct MinikinPaint {
     MinikinPaint(const std::shared_ptr<FontCollection>& font)
             : size(0),
@@ -59,7 +59,8 @@ struct MinikinPaint {
               fontFeatureSettings(),
               font(font) {}
 
-    bool skipCache() const { return !fontFeatureSettings.empty(); }
+    // The font feature settings are part of the PaintIdCache key, so all the fields are cacheable.
+    bool skipCache() const { return false; }
 
     float size;
     float scaleX;
@@ -90,7 +91,7 @@ struct MinikinPaint {
     }
 
     uint32_t hash() const {
-        return Hasher()
+        return WideHasher()
                 .update(size)
                 .update(scaleX)
                 .update(skewX)
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PAINT_ID_CACHE_H
+#define MINIKIN_PAINT_ID_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "minikin/Buffer.h"
+#include "minikin/CacheStats.h"
+#include "minikin/FamilyVariant.h"
+#include "minikin/FontStyle.h"
+#include "minikin/Macros.h"
+#include "minikin/MinikinPaint.h"
+
+namespace minikin {
+
+// Interns the MinikinPaint fields which affect the layout, so that the cache keys hold and compare
+// a single ID instead of a copy of the paint. Two paints get the same ID if and only if they have
+// the same font collection and the same fields, the floats being compared bit by bit, unless the
+// paint was evicted in between.
+//
+// The IDs are only valid in the process, like the locale list IDs. The registered paints are kept
+// in a bounded LRU, so that animating the text size or the letter spacing doesn't grow it without
+// bound. An evicted paint gets a new ID when it is used again, and its old ID is never given to
+// another paint, so the cache entries keyed by the old ID are simply not found anymore.
+class PaintIdCache {
+public:
+    // The fields of MinikinPaint which are part of the layout cache key, with the ID of the font
+    // collection instead of the collection, which the cache must not keep alive. The copies of a
+    // registered key share its copy of the font feature settings.
+    struct Key {
+        uint32_t fontCollectionId;
+        FontStyle style;
+        float size;
+        float scaleX;
+        float skewX;
+        float letterSpacing;
+        float wordSpacing;
+        uint32_t fontFlags;
+        uint32_t localeListId;
+        FamilyVariant familyVariant;
+        // Points into the paint for the lookup keys, and into ownedFontFeatureSettings for the
+        // registered keys.
+        std::string_view fontFeatureSettings;
+        std::shared_ptr<const std::string> ownedFontFeatureSettings;
+        // The hash of the fields above, set by computeHash().
+        size_t hash = 0;
+
+        void computeHash();
+        bool operator==(const Key& o) const;
+    };
+
+    // Returns the ID of the layout-relevant fields of the paint, registering them on first use.
+    static inline uint32_t getId(const MinikinPaint& paint) {
+        return getInstance().getIdInternal(paint);
+    }
+
+    // Same as getId(), but with the given font collection ID instead of the one of the paint.
+    static inline uint32_t getId(const MinikinPaint& paint, uint32_t fontCollectionId) {
+        return getInstance().getIdInternal(paint, fontCollectionId);
+    }
+
+    // Copies the fields of the paint of the ID to out and returns true, or returns false if the
+    // paint was evicted.
+    static inline bool getKey(uint32_t id, Key* out) {
+        return getInstance().getKeyInternal(id, out);
+    }
+
+    // Writes the fields of the paint, except for the font collection.
+    static void writeTo(BufferWriter* writer, const Key& key);
+
+    // Checks that the buffer holds the fields written by writeTo(), see BufferValidator.
+    static void validate(BufferValidator* validator);
+
+    // Returns the ID of the fields written by writeTo() used with the given font collection. A
+    // pinned paint is never evicted, e.g. the ones of a table which is looked up by paint ID for
+    // the lifetime of the process.
+    static inline uint32_t readFrom(BufferReader* reader, uint32_t fontCollectionId,
+                                    bool pin = false) {
+        return getInstance().readFromInternal(reader, fontCollectionId, pin);
+    }
+
+    // Returns the statistics of the paint to ID lookups.
+    static inline const CacheStats& getStats() { return getInstance().mStats; }
+
+    // Returns the number of registered paints.
+    static inline size_t getCacheSize() { return getInstance().getCacheSizeInternal(); }
+
+    // Returns the approximate memory used by the registered paints.
+    static inline size_t getMemoryUsage() { return getInstance().getMemoryUsageInternal(); }
+
+protected:
+    // protected for testing purposes.
+    // The lookups only lock the shard of the paint, so that the threads laying out text with
+    // different paints don't contend.
+    static constexpr size_t kShardCount = 16;
+    static constexpr size_t kMaxEntriesPerShard = 64;
+
+private:
+    class Shard;
+
+    PaintIdCache();  // Singleton
+    ~PaintIdCache();
+
+    uint32_t getIdInternal(const MinikinPaint& paint);
+    uint32_t getIdInternal(const MinikinPaint& paint, uint32_t fontCollectionId);
+    uint32_t getIdInternal(Key& key, bool pin);
+    bool getKeyInternal(uint32_t id, Key* out);
+    uint32_t readFromInternal(BufferReader* reader, uint32_t fontCollectionId, bool pin);
+    size_t getCacheSizeInternal();
+    size_t getMemoryUsageInternal();
+
+    static PaintIdCache& getInstance() {
+        static PaintIdCache instance;
+        return instance;
+    }
+
+    std::array<std::unique_ptr<Shard>, kShardCount> mShards;
+    // The next ID to give out, shared by the shards so that an ID is never given out twice.
+    std::atomic<uint32_t> mNextId;
+    CacheStats mStats;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PAINT_ID_CACHE_H
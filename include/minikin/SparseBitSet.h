@@ -19,8 +19,11 @@
 
 #include <minikin/Buffer.h>
 #include <sys/types.h>
+#include <array>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <vector>
 
 // ---------------------------------------------------------------------------
 
@@ -45,11 +48,31 @@ public:
 
     explicit SparseBitSet(BufferReader* reader) : SparseBitSet() { initFromBuffer(reader); }
 
+    // The page bitmaps shared by the sets written with writeTo(BufferWriter*, const PagePool&).
+    // Defined below.
+    class PagePool;
+
+    // Reads a set written by writeTo(BufferWriter*, const PagePool&). The set points into the
+    // bitmaps of the pool, so they must outlive it.
+    SparseBitSet(BufferReader* reader, const PagePool& pool);
+
     SparseBitSet(SparseBitSet&&) = default;
     SparseBitSet& operator=(SparseBitSet&&) = default;
 
+    // Builds a set from ranges given in ascending order. Defined below.
+    class Builder;
+
     void writeTo(BufferWriter* writer) const;
 
+    // Same as above, but refers to the pages in the pool instead of writing them, if the set was
+    // added to the pool.
+    void writeTo(BufferWriter* writer, const PagePool& pool) const;
+
+    // Checks that the buffer holds a set the constructor from a BufferReader can read, and that
+    // its pages are in its bitmap, or in a pool of poolBitmapsCount elements if the set was
+    // written with one.
+    static void validate(BufferValidator* validator, uint32_t poolBitmapsCount = 0);
+
     // Determine whether the value is included in the set
     bool get(uint32_t ch) const {
         if (ch >= mMaxVal) return false;
@@ -61,15 +84,93 @@ public:
     // One more than the maximum value in the set, or zero if empty
     uint32_t length() const { return mMaxVal; }
 
+    // The bytes of the set and of the arrays it owns. The arrays pointing into a buffer or a page
+    // pool are not counted.
+    size_t getMemoryUsage() const {
+        return sizeof(SparseBitSet) + (mOwnedIndices ? sizeof(uint16_t) * mIndicesCount : 0) +
+               (mOwnedBitmaps ? sizeof(element) * mBitmapsCount : 0);
+    }
+
     // The next set bit starting at fromIndex, inclusive, or kNotFound
     // if none exists.
     uint32_t nextSetBit(uint32_t fromIndex) const;
 
     static const uint32_t kNotFound = ~0u;
 
+    // Adds all values of the other set to this set.
+    void unionWith(const SparseBitSet& other) { combineWith(other, true /* isUnion */); }
+
+    // Removes the values that are not in the other set from this set.
+    void intersect(const SparseBitSet& other) { combineWith(other, false /* isUnion */); }
+
+    // Returns true if this set and the other set have any value in common.
+    bool intersects(const SparseBitSet& other) const;
+
+    // Returns the number of values in the set.
+    uint32_t popcount() const;
+
+    // Returns true if the set has any value in [page << 8, (page + 1) << 8).
+    bool intersectsPage(uint32_t page) const;
+
+    // Calls func(start, end) for each maximal range [start, end) of the values in the set, in
+    // ascending order. The pages without values are skipped without looking at their bits.
+    template <typename Func>
+    void forEachSetRange(Func func) const {
+        const uint32_t pageCount = (mMaxVal + kPageMask) >> kLogValuesPerPage;
+        bool inRange = false;
+        uint32_t rangeStart = 0;
+        for (uint32_t page = 0; page < pageCount; page++) {
+            const uint16_t index = mIndices[page];
+            if (index == mZeroPageIndex) {
+                if (inRange) {
+                    func(rangeStart, page << kLogValuesPerPage);
+                    inRange = false;
+                }
+                continue;
+            }
+            const element* bitmap = &mBitmaps[index];
+            for (uint32_t j = 0; j < (1 << (kLogValuesPerPage - kLogBitsPerEl)); j++) {
+                const uint32_t base = (page << kLogValuesPerPage) + (j << kLogBitsPerEl);
+                element e = bitmap[j];
+                if (e == (inRange ? kElAllOnes : 0)) {
+                    continue;
+                }
+                // Find the boundaries within the element, flipping it at each boundary so that
+                // the next boundary is the next leading one.
+                uint32_t bit = 0;
+                if (inRange) {
+                    e = ~e;
+                }
+                while (bit < (1 << kLogBitsPerEl)) {
+                    const element masked = e & (kElAllOnes >> bit);
+                    if (masked == 0) {
+                        break;
+                    }
+                    bit = CountLeadingZeros(masked);
+                    if (inRange) {
+                        func(rangeStart, base + bit);
+                    } else {
+                        rangeStart = base + bit;
+                    }
+                    inRange = !inRange;
+                    e = ~e;
+                }
+            }
+        }
+        if (inRange) {
+            func(rangeStart, mMaxVal);
+        }
+    }
+
 private:
     void initFromRanges(const uint32_t* ranges, size_t nRanges);
-    void initFromBuffer(BufferReader* reader);
+    void initFromBuffer(BufferReader* reader, const PagePool* pool = nullptr);
+    // Replaces the set with the union or the intersection with the other set. The bitmap of the
+    // result is always owned, and the all-zero and the all-one pages are stored only once.
+    void combineWith(const SparseBitSet& other, bool isUnion);
+    // Stores each distinct page of the owned bitmap once, e.g. the full pages of the CJK and the
+    // Hangul coverage, and points the indices of the repeated pages to the first one.
+    void deduplicatePages();
 
     static const uint32_t kMaximumCapacity = 0xFFFFFF;
     static const int kLogValuesPerPage = 8;
@@ -82,9 +183,18 @@ private:
     static const element kElAllOnes = ~((element)0);
     static const element kElFirst = ((element)1) << kElMask;
     static const uint16_t noZeroPage = 0xFFFF;
+    static constexpr uint32_t kElementsPerPage = 1 << (kLogValuesPerPage - kLogBitsPerEl);
 
     static uint32_t calcNumPages(const uint32_t* ranges, size_t nRanges);
     static int CountLeadingZeros(element x);
+    // Returns the offset of the first value in the page from the given element, or kNotFound.
+    static uint32_t findFirstSetBitInPage(const element* bitmap, uint32_t fromElement);
+    // Returns the bitmap of the page, or nullptr if the page has no values.
+    const element* pageBitmap(uint32_t page) const {
+        if (page >= ((mMaxVal + kPageMask) >> kLogValuesPerPage)) return nullptr;
+        const uint16_t index = mIndices[page];
+        return index == mZeroPageIndex ? nullptr : &mBitmaps[index];
+    }
 
     uint32_t mMaxVal;
     uint32_t mIndicesCount;
@@ -102,6 +212,67 @@ private:
     void operator=(const SparseBitSet&) = delete;
 };
 
+// Builds a set from ranges given in ascending order, writing the page and bitmap arrays
+// directly instead of collecting the ranges first. The layout of the built set is the same as
+// the one constructed from the same ranges.
+class SparseBitSet::Builder {
+public:
+    // Adds [start, end) to the set. The values below end() are already decided, so the part of
+    // the range below it is ignored. The end must not be smaller than end().
+    void addRange(uint32_t start, uint32_t end);
+
+    // Returns the end of the ranges added so far.
+    uint32_t end() const { return mEnd; }
+
+    SparseBitSet build();
+
+private:
+    uint32_t mEnd = 0;
+    uint16_t mZeroPageIndex = noZeroPage;
+    std::vector<uint16_t> mIndices;
+    std::vector<element> mBitmaps;
+};
+
+// Stores each distinct page bitmap of the sets added to it once, so that the sets written with the
+// pool only write their page indices. Many fonts share pages, e.g. the weights of a family or the
+// fully covered pages of a script.
+class SparseBitSet::PagePool {
+public:
+    // Creates an empty pool to add sets to before writing it.
+    PagePool() : mBitmaps(nullptr), mBitmapsCount(0) {}
+
+    // Reads a pool written by writeTo(). The bitmaps point into the buffer.
+    explicit PagePool(BufferReader* reader);
+
+    // Adds the pages of the set. The sets which don't fit in the 16-bit page indices are not
+    // added, and are written with their own bitmaps.
+    void add(const SparseBitSet& set);
+
+    void writeTo(BufferWriter* writer) const;
+
+    // Checks that the buffer holds a pool and returns the number of its elements.
+    static uint32_t validate(BufferValidator* validator);
+
+private:
+    friend class SparseBitSet;
+
+    using Page = std::array<element, kElementsPerPage>;
+
+    // Returns the index of the page in the pool, or noZeroPage if it is not in the pool.
+    uint16_t find(const element* bitmap) const;
+
+    const element* mBitmaps;
+    uint32_t mBitmapsCount;
+
+    // Only used while adding sets.
+    std::vector<element> mOwnedBitmaps;
+    std::map<Page, uint16_t> mPageIndices;
+
+    // Forbid copy and assign.
+    PagePool(const PagePool&) = delete;
+    void operator=(const PagePool&) = delete;
+};
+
 }  // namespace minikin
 
 #endif  // MINIKIN_SPARSE_BIT_SET_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_STREAMING_LINE_BREAKER_H
+#define MINIKIN_STREAMING_LINE_BREAKER_H
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "minikin/LineBreaker.h"
+#include "minikin/Macros.h"
+#include "minikin/MeasuredText.h"
+#include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+// Breaks a long document into lines one window of paragraphs at a time. Only the paragraphs of the
+// current window are measured, so the memory used for the widths does not grow with the length of
+// the document. The layout pieces are not kept. A paragraph ends after a line feed, and a paragraph
+// longer than the window is still measured as a whole.
+class StreamingLineBreaker {
+public:
+    // Adds the runs of the paragraph to the builder. The paragraph range is in the document, while
+    // the runs are relative to the start of the paragraph.
+    using AddRunsFunc = std::function<void(const Range& paragraph, MeasuredTextBuilder* builder)>;
+
+    // Receives the line breaks of a paragraph, relative to the start of the paragraph. The
+    // paragraphs are reported in order.
+    using LineBreakFunc = std::function<void(const Range& paragraph, LineBreakResult&& result)>;
+
+    static constexpr uint32_t DEFAULT_WINDOW_SIZE = 64 * 1024;
+
+    // The paragraphs of a window are broken on up to maxThreads threads, see the batch version of
+    // breakIntoLines. The breaker shares the line width and copies the tab stops, so neither has
+    // to outlive the constructor call on the caller side.
+    StreamingLineBreaker(BreakStrategy strategy, HyphenationFrequency frequency, bool justified,
+                         std::shared_ptr<const LineWidth> lineWidth, const TabStops& tabStops,
+                         uint32_t windowSize = DEFAULT_WINDOW_SIZE, uint32_t maxThreads = 1)
+            : mStrategy(strategy),
+              mFrequency(frequency),
+              mJustified(justified),
+              mLineWidth(std::move(lineWidth)),
+              mTabStopValues(tabStops.mStops, tabStops.mStops + tabStops.mStopsSize),
+              mTabStops(mTabStopValues.data(), mTabStopValues.size(), tabStops.mTabWidth),
+              mWindowSize(windowSize),
+              mMaxThreads(maxThreads) {}
+
+    void breakText(const U16StringPiece& text, const AddRunsFunc& addRuns,
+                   const LineBreakFunc& onLineBreaks) const;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(StreamingLineBreaker);
+
+private:
+    void breakWindow(const U16StringPiece& text, const std::vector<Range>& paragraphs,
+                     const AddRunsFunc& addRuns, const LineBreakFunc& onLineBreaks) const;
+
+    const BreakStrategy mStrategy;
+    const HyphenationFrequency mFrequency;
+    const bool mJustified;
+    const std::shared_ptr<const LineWidth> mLineWidth;
+    // The copy of the stops mTabStops points to.
+    const std::vector<float> mTabStopValues;
+    const TabStops mTabStops;
+    const uint32_t mWindowSize;
+    const uint32_t mMaxThreads;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_STREAMING_LINE_BREAKER_H
@@ -17,10 +17,13 @@
 #ifndef MINIKIN_SYSTEM_FONTS_H
 #define MINIKIN_SYSTEM_FONTS_H
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "minikin/FontCollection.h"
 #include "minikin/U16StringPiece.h"
@@ -49,7 +52,8 @@ public:
         return getInstance().addFontMapInternal(std::move(collections));
     }
 
-    // This obtains a mutex inside, so do not call this method inside callback.
+    // The callback is given the font map at the time of the call. It may call SystemFonts
+    // methods, but a font map added meanwhile is not visible to it.
     static void getFontMap(
             std::function<void(const std::vector<std::shared_ptr<FontCollection>>&)> func) {
         return getInstance().getFontMapInternal(func);
@@ -61,50 +65,46 @@ public:
 
 protected:
     // Visible for testing purposes.
-    SystemFonts() {}
+    SystemFonts() : mSnapshot(std::make_shared<Snapshot>()) {}
     virtual ~SystemFonts() {}
 
     std::shared_ptr<FontCollection> findFontCollectionInternal(const std::string& familyName);
     void registerFallbackInternal(const std::string& familyName,
-                                  const std::shared_ptr<FontCollection>& fc) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mSystemFallbacks[familyName] = fc;
-    }
+                                  const std::shared_ptr<FontCollection>& fc);
+    void registerDefaultInternal(const std::shared_ptr<FontCollection>& fc);
+    void addFontMapInternal(std::shared_ptr<FontCollection>&& collections);
+    void getFontMapInternal(
+            std::function<void(const std::vector<std::shared_ptr<FontCollection>>&)> func);
+    void getFontSetInternal(std::function<void(const std::vector<std::shared_ptr<Font>>&)> func);
 
-    void registerDefaultInternal(const std::shared_ptr<FontCollection>& fc) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mDefaultFallback = fc;
-    }
+private:
+    static SystemFonts& getInstance();
 
-    void addFontMapInternal(std::shared_ptr<FontCollection>&& collections) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mCollections.emplace_back(std::move(collections));
-    }
+    // An immutable state of the system fonts. The readers load the current snapshot without
+    // taking a lock, and the writers publish a modified copy.
+    struct Snapshot {
+        std::map<std::string, std::shared_ptr<FontCollection>> systemFallbacks;
+        std::shared_ptr<FontCollection> defaultFallback;
+        std::vector<std::shared_ptr<FontCollection>> collections;
 
-    void getFontMapInternal(
-            std::function<void(const std::vector<std::shared_ptr<FontCollection>>&)> func) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        func(mCollections);
-    }
+        // The fonts of the collections, built by the first getFontSet call on this snapshot.
+        mutable std::once_flag fontsOnce;
+        mutable std::vector<std::shared_ptr<Font>> fonts;
+    };
 
-    void getFontSetInternal(std::function<void(const std::vector<std::shared_ptr<Font>>&)> func) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        if (!mFonts) {
-            buildFontSetLocked();
-        }
-        func(mFonts.value());
+    std::shared_ptr<const Snapshot> loadSnapshot() const {
+        return std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
     }
 
-private:
-    static SystemFonts& getInstance();
+    // Publishes a copy of the current snapshot modified by the function.
+    void updateSnapshot(const std::function<void(Snapshot*)>& update);
 
-    void buildFontSetLocked() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    static void buildFontSet(const Snapshot& snapshot);
 
-    std::map<std::string, std::shared_ptr<FontCollection>> mSystemFallbacks GUARDED_BY(mMutex);
-    std::shared_ptr<FontCollection> mDefaultFallback GUARDED_BY(mMutex);
-    std::vector<std::shared_ptr<FontCollection>> mCollections GUARDED_BY(mMutex);
-    std::optional<std::vector<std::shared_ptr<Font>>> mFonts GUARDED_BY(mMutex);
+    // Only accessed with the atomic shared_ptr functions.
+    std::shared_ptr<const Snapshot> mSnapshot;
 
+    // Serializes the writers.
     std::mutex mMutex;
 };
 
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_TRACING_H
+#define MINIKIN_TRACING_H
+
+#include <cstdint>
+
+namespace minikin {
+
+// Receives the tracing spans of the layout, itemization, shaping and line breaking stages, e.g. to
+// forward them to Perfetto or a profiler on the hosts without atrace. On Android, the spans go to
+// atrace whether or not callbacks are set.
+//
+// The spans are only emitted if minikin is built with ENABLE_TRACING, which is the case on eng
+// and userdebug builds.
+struct TraceCallbacks {
+    // Called when a span starts. The name is a string literal. The textLength is the length of the
+    // text the stage works on, and the runCount is the number of the runs it is split into, or 0
+    // if it does not apply to the stage.
+    void (*beginSpan)(const char* name, uint32_t textLength, uint32_t runCount);
+    // Called when the last span started on the calling thread ends.
+    void (*endSpan)();
+};
+
+// Sets the callbacks receiving the spans of all threads, which must be thread-safe. The callbacks
+// must outlive minikin, or be unset by passing nullptr before they are destroyed. The spans
+// started before the change still end with the callbacks they started with.
+void setTraceCallbacks(const TraceCallbacks* callbacks);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_TRACING_H
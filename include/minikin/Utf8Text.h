@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_UTF8_TEXT_H
+#define MINIKIN_UTF8_TEXT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+// The UTF-16 form of UTF-8 text, with the mapping between the offsets of both, for the callers
+// holding UTF-8 strings. Layout, MeasuredTextBuilder and the line breakers work on the UTF-16
+// code units of utf16(). The offsets and advances they return are mapped back with toUtf8() and
+// toUtf8Advances().
+//
+// Invalid UTF-8 sequences are converted to U+FFFD.
+class Utf8Text {
+public:
+    Utf8Text(const char* text, uint32_t size);
+
+    U16StringPiece utf16() const { return mUtf16; }
+    uint32_t utf8Size() const { return mUtf8Size; }
+
+    // Returns the UTF-16 offset of the character starting at the byte offset. A byte offset in
+    // the middle of a character is moved to the next character.
+    uint32_t toUtf16(uint32_t byteOffset) const;
+    // Returns the byte offset of the character the UTF-16 code unit at the offset belongs to.
+    uint32_t toUtf8(uint32_t utf16Offset) const {
+        return utf16Offset < mUtf16.size() ? mUtf8Offsets[utf16Offset] : mUtf8Size;
+    }
+
+    Range toUtf16(const Range& bytes) const {
+        return Range(toUtf16(bytes.getStart()), toUtf16(bytes.getEnd()));
+    }
+    Range toUtf8(const Range& utf16Range) const {
+        return Range(toUtf8(utf16Range.getStart()), toUtf8(utf16Range.getEnd()));
+    }
+
+    // Converts the advances of the UTF-16 code units in utf16Range, e.g. ones returned by
+    // Layout::measureText, into advances per byte of byteRange. The advance of a character goes
+    // to its first byte and its other bytes get 0. byteRange must contain toUtf8(utf16Range).
+    void toUtf8Advances(const float* utf16Advances, const Range& utf16Range,
+                        const Range& byteRange, float* out) const;
+
+private:
+    std::vector<uint16_t> mUtf16;
+    // The byte offset of the character of each UTF-16 code unit.
+    std::vector<uint32_t> mUtf8Offsets;
+    uint32_t mUtf8Size;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_UTF8_TEXT_H
@@ -20,11 +20,13 @@
 
 #include <algorithm>
 
+#include <unicode/uchar.h>
 #include <unicode/ubidi.h>
 #include <unicode/utf16.h>
 
 #include "minikin/Emoji.h"
 
+#include "CodeUnitScan.h"
 #include "MinikinInternal.h"
 
 namespace minikin {
@@ -49,6 +51,84 @@ static inline UBiDiLevel bidiToUBidiLevel(Bidi bidi) {
     }
 }
 
+// The code units below the Hebrew block are never RTL, Arabic numbers or explicit directional
+// formatting characters.
+constexpr uint16_t kFirstMaybeRtlChar = 0x0590;
+
+// Returns true if the text has a character which can make a run at a non-zero level in a LTR
+// paragraph, i.e. a strong RTL character, an Arabic number or an explicit directional formatting
+// character. Otherwise ICU would resolve the whole text to a single LTR run.
+static bool hasRtlOrBidiControl(const U16StringPiece& textBuf) {
+    const uint16_t* chars = textBuf.data();
+    const uint32_t size = textBuf.size();
+    uint32_t i = 0;
+    while ((i = findCodeUnitOutOfRange(chars, i, size, 0, kFirstMaybeRtlChar - 1)) < size) {
+        UChar32 c;
+        U16_NEXT(chars, i, size, c);
+        // Same as the bidi class callback, emojiBidiOverride.
+        switch (u_charDirection(c)) {
+            case U_RIGHT_TO_LEFT:
+            case U_RIGHT_TO_LEFT_ARABIC:
+            case U_ARABIC_NUMBER:
+            case U_LEFT_TO_RIGHT_EMBEDDING:
+            case U_LEFT_TO_RIGHT_OVERRIDE:
+            case U_RIGHT_TO_LEFT_EMBEDDING:
+            case U_RIGHT_TO_LEFT_OVERRIDE:
+            case U_POP_DIRECTIONAL_FORMAT:
+            case U_LEFT_TO_RIGHT_ISOLATE:
+            case U_RIGHT_TO_LEFT_ISOLATE:
+            case U_FIRST_STRONG_ISOLATE:
+            case U_POP_DIRECTIONAL_ISOLATE:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+UBiDiUniquePtr UBiDiPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mPool.empty()) {
+            UBiDiUniquePtr bidi = std::move(mPool.back());
+            mPool.pop_back();
+            mStats.hit();
+            return bidi;
+        }
+    }
+
+    mStats.miss();
+    UBiDiUniquePtr bidi(ubidi_open());
+    if (!bidi) {
+        ALOGE("error creating bidi object");
+        return nullptr;
+    }
+    UErrorCode status = U_ZERO_ERROR;
+    // Set callbacks to override bidi classes of new emoji
+    ubidi_setClassCallback(bidi.get(), emojiBidiOverride, nullptr, nullptr, nullptr, &status);
+    if (!U_SUCCESS(status)) {
+        ALOGE("error setting bidi callback function, status = %d", status);
+        return nullptr;
+    }
+    return bidi;
+}
+
+void UBiDiPool::release(UBiDiUniquePtr&& bidi, size_t textLength) {
+    if (!bidi) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPool.size() >= MAX_POOL_SIZE || textLength > MAX_POOLED_TEXT_LENGTH) {
+        // Pool is full. The given object is closed when the local variable leaves the scope.
+        UBiDiUniquePtr localBidi = std::move(bidi);
+        mStats.evict();
+        return;
+    }
+    mPool.push_back(std::move(bidi));
+    mStats.insert();
+}
+
 BidiText::RunInfo BidiText::getRunInfoAt(uint32_t runOffset) const {
     MINIKIN_ASSERT(runOffset < mRunCount, "Out of range access. %d/%d", runOffset, mRunCount);
     if (mRunCount == 1) {
@@ -73,25 +153,27 @@ BidiText::RunInfo BidiText::getRunInfoAt(uint32_t runOffset) const {
 }
 
 BidiText::BidiText(const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags)
-        : mRange(range), mIsRtl(isRtl(bidiFlags)), mRunCount(1 /* by default, single run */) {
+        : mTextLength(textBuf.size()),
+          mRange(range),
+          mIsRtl(isRtl(bidiFlags)),
+          mRunCount(1 /* by default, single run */) {
     if (isOverride(bidiFlags)) {
         // force single run.
         return;
     }
-
-    mBidi.reset(ubidi_open());
-    if (!mBidi) {
-        ALOGE("error creating bidi object");
+    if ((bidiFlags == Bidi::LTR || bidiFlags == Bidi::DEFAULT_LTR) &&
+        !hasRtlOrBidiControl(textBuf)) {
+        // ICU would give a single LTR run. This is not done for the RTL paragraphs since their
+        // leading and trailing neutral characters become RTL runs.
         return;
     }
-    UErrorCode status = U_ZERO_ERROR;
-    // Set callbacks to override bidi classes of new emoji
-    ubidi_setClassCallback(mBidi.get(), emojiBidiOverride, nullptr, nullptr, nullptr, &status);
-    if (!U_SUCCESS(status)) {
-        ALOGE("error setting bidi callback function, status = %d", status);
+
+    mBidi = UBiDiPool::getInstance().acquire();
+    if (!mBidi) {
         return;
     }
 
+    UErrorCode status = U_ZERO_ERROR;
     const UBiDiLevel bidiReq = bidiToUBidiLevel(bidiFlags);
     ubidi_setPara(mBidi.get(), reinterpret_cast<const UChar*>(textBuf.data()), textBuf.size(),
                   bidiReq, nullptr, &status);
@@ -120,4 +202,8 @@ BidiText::BidiText(const U16StringPiece& textBuf, const Range& range, Bidi bidiF
     mRunCount = rc;
 }
 
+BidiText::~BidiText() {
+    UBiDiPool::getInstance().release(std::move(mBidi), mTextLength);
+}
+
 }  // namespace minikin
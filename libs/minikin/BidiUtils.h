@@ -22,9 +22,12 @@
 #include "minikin/Layout.h"
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <unicode/ubidi.h>
 
+#include "minikin/CacheStats.h"
 #include "minikin/Macros.h"
 #include "minikin/U16StringPiece.h"
 
@@ -36,6 +39,42 @@ struct UBiDiDeleter {
 
 using UBiDiUniquePtr = std::unique_ptr<UBiDi, UBiDiDeleter>;
 
+// A singleton pool of the ICU bidi objects with the emoji class callback set.
+// A UBiDi keeps the memory ubidi_setPara allocated for the longest text seen so far, so reusing
+// them avoids both the ubidi_open and the allocations for most of the paragraphs.
+class UBiDiPool {
+public:
+    static UBiDiPool& getInstance() {
+        static UBiDiPool pool;
+        return pool;
+    }
+
+    // Returns a pooled or a new UBiDi. Returns nullptr if ICU fails to create it.
+    UBiDiUniquePtr acquire();
+    // Returns the UBiDi to the pool. It is closed instead if the pool is full, or if it was used for
+    // a text longer than MAX_POOLED_TEXT_LENGTH so that the pool doesn't keep large buffers.
+    void release(UBiDiUniquePtr&& bidi, size_t textLength);
+
+    size_t getPoolSize() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPool.size();
+    }
+
+    // A hit is an acquire() served from the pool, an eviction is a release() to the full pool.
+    const CacheStats& getStats() const { return mStats; }
+
+protected:
+    // protected for testing purposes.
+    static constexpr size_t MAX_POOL_SIZE = 4;
+    static constexpr size_t MAX_POOLED_TEXT_LENGTH = 4096;
+    UBiDiPool() {}  // singleton.
+
+private:
+    std::vector<UBiDiUniquePtr> mPool GUARDED_BY(mMutex);
+    CacheStats mStats;
+    mutable std::mutex mMutex;
+};
+
 // A helper class for iterating the bidi run transitions.
 class BidiText {
 public:
@@ -45,9 +84,12 @@ public:
     };
 
     BidiText(const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags);
+    ~BidiText();
 
     RunInfo getRunInfoAt(uint32_t runOffset) const;
 
+    uint32_t getRunCount() const { return mRunCount; }
+
     class iterator {
     public:
         inline bool operator==(const iterator& o) const {
@@ -77,10 +119,11 @@ public:
     inline iterator end() const { return iterator(this, mRunCount); }
 
 private:
-    UBiDiUniquePtr mBidi;  // Maybe null for single run.
-    const Range mRange;    // The range in the original buffer. Used for range check.
-    bool mIsRtl;           // The paragraph direction.
-    uint32_t mRunCount;    // The number of the bidi run in this text.
+    UBiDiUniquePtr mBidi;        // Maybe null for single run.
+    const uint32_t mTextLength;  // The length of the text given to mBidi.
+    const Range mRange;          // The range in the original buffer. Used for range check.
+    bool mIsRtl;                 // The paragraph direction.
+    uint32_t mRunCount;          // The number of the bidi run in this text.
 
     MINIKIN_PREVENT_COPY_AND_ASSIGN(BidiText);
 };
@@ -18,26 +18,12 @@
 
 namespace minikin {
 
-void ValueExtractor::operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-    value.reset(new BoundsValue);
-    value->rect = BoundsCache::getBounds(layoutPiece, paint);
-    value->advance = layoutPiece.advance();
-}
+BoundsCache::BoundsCache(uint32_t maxEntries)
+        : mOwnedCache(new LayoutCache(maxEntries)), mLayoutCache(mOwnedCache.get()) {}
 
 // static
 MinikinRect BoundsCache::getBounds(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-    MinikinRect pieceBounds;
-    MinikinRect tmpRect;
-    for (uint32_t i = 0; i < layoutPiece.glyphCount(); ++i) {
-        const FakedFont& font = layoutPiece.fontAt(i);
-        const Point& point = layoutPiece.pointAt(i);
-
-        MinikinFont* minikinFont = font.font->typeface().get();
-        minikinFont->GetBounds(&tmpRect, layoutPiece.glyphIdAt(i), paint, font.fakery);
-        tmpRect.offset(point.x, point.y);
-        pieceBounds.join(tmpRect);
-    }
-    return pieceBounds;
+    return layoutPiece.calculateBounds(paint);
 }
 
 }  // namespace minikin
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CachePrewarmer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "minikin/Executor.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/PaintIdCache.h"
+
+#include "BidiUtils.h"
+#include "LayoutSplitter.h"
+
+namespace minikin {
+
+// static
+std::unique_ptr<CachePrewarmer> CachePrewarmer::prewarm(
+        const std::shared_ptr<FontCollection>& collection, const std::vector<MinikinPaint>& paints,
+        const std::vector<std::vector<uint16_t>>& strings) {
+    return std::unique_ptr<CachePrewarmer>(
+            new CachePrewarmer(&LayoutCache::getInstance(), collection, paints, strings));
+}
+
+struct CachePrewarmer::State {
+    enum class Status : uint8_t {
+        kPending,
+        kRunning,
+        kDone,
+    };
+
+    State(LayoutCache* cache, const std::vector<MinikinPaint>& paints,
+          const std::vector<std::vector<uint16_t>>& strings)
+            : cache(cache),
+              paints(paints),
+              strings(strings),
+              cancelled(false),
+              completed(false),
+              status(Status::kPending) {}
+
+    LayoutCache* const cache;
+    std::vector<MinikinPaint> paints;
+    const std::vector<std::vector<uint16_t>> strings;
+    std::atomic<bool> cancelled;
+    bool completed;  // Written by the task, and read after it finished.
+    Status status GUARDED_BY(mutex);
+    std::condition_variable condition;
+    std::mutex mutex;
+};
+
+CachePrewarmer::CachePrewarmer(LayoutCache* cache,
+                               const std::shared_ptr<FontCollection>& collection,
+                               const std::vector<MinikinPaint>& paints,
+                               const std::vector<std::vector<uint16_t>>& strings)
+        : mState(std::make_shared<State>(cache, paints, strings)) {
+    for (MinikinPaint& paint : mState->paints) {
+        paint.font = collection;
+    }
+    getExecutor()->execute(
+            [state = mState]() {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->status != State::Status::kPending) {
+                        return;  // Cancelled before it started.
+                    }
+                    state->status = State::Status::kRunning;
+                }
+                run(state.get());
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->status = State::Status::kDone;
+                state->condition.notify_all();
+            },
+            Executor::Priority::kBackground);
+}
+
+CachePrewarmer::~CachePrewarmer() {
+    cancel();
+    wait();
+}
+
+void CachePrewarmer::cancel() {
+    mState->cancelled.store(true, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    if (mState->status == State::Status::kPending) {
+        // The task returns as soon as it starts, so nobody has to wait for it.
+        mState->status = State::Status::kDone;
+        mState->condition.notify_all();
+    }
+}
+
+bool CachePrewarmer::wait() {
+    std::unique_lock<std::mutex> lock(mState->mutex);
+    mState->condition.wait(lock, [this]() { return mState->status == State::Status::kDone; });
+    return mState->completed;
+}
+
+// static
+void CachePrewarmer::run(State* state) {
+    for (const MinikinPaint& paint : state->paints) {
+        const uint32_t paintId = PaintIdCache::getId(paint);
+        for (const std::vector<uint16_t>& string : state->strings) {
+            const U16StringPiece text(string);
+            // The same pieces as Layout::measureText() and Layout::doLayout() look up.
+            for (const BidiText::RunInfo& runInfo :
+                 BidiText(text, Range(0, text.size()), Bidi::DEFAULT_LTR)) {
+                for (const auto [context, piece] :
+                     LayoutSplitter(text, runInfo.range, runInfo.isRtl)) {
+                    if (state->cancelled.load(std::memory_order_relaxed) ||
+                        !state->cache->prewarm(text.substr(context), piece - context.getStart(),
+                                               paint, paintId, runInfo.isRtl, state->cancelled)) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    state->completed = true;
+}
+
+}  // namespace minikin
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CacheStats.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+namespace minikin {
+
+std::string CacheStats::toString(const char* name, size_t entries, size_t bytes) const {
+    const uint64_t hitCount = hits();
+    const uint64_t missCount = misses();
+    const uint64_t lookups = hitCount + missCount;
+    const double hitRatio = lookups == 0 ? 0.0 : 100.0 * hitCount / lookups;
+
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "  %s: hits=%" PRIu64 " misses=%" PRIu64 " hitRatio=%.2f%% inserts=%" PRIu64
+             " evictions=%" PRIu64 " bypasses=%" PRIu64 " lockWaits=%" PRIu64
+             " lockWaitUs=%" PRIu64 " entries=%zu bytes=%zu\n",
+             name, hitCount, missCount, hitRatio, inserts(), evictions(), bypasses(), lockWaits(),
+             lockWaitNanos() / 1000, entries, bytes);
+    return buf;
+}
+
+void CacheStats::waitForLock(std::unique_lock<std::mutex>* lock) {
+    const auto start = std::chrono::steady_clock::now();
+    lock->lock();
+    const auto waited = std::chrono::steady_clock::now() - start;
+    lockWait(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+}
+
+}  // namespace minikin
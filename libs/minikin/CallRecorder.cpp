@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CallRecorder.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "minikin/Buffer.h"
+#include "minikin/FontCollection.h"
+#include "minikin/Hasher.h"
+#include "minikin/LocaleList.h"
+
+#include "ScopedCallRecord.h"
+
+namespace minikin {
+
+std::atomic<bool> CallRecorder::sRecording(false);
+thread_local bool ScopedCallRecord::sActive = false;
+
+namespace {
+
+constexpr uint32_t kTraceMagic = 0x4D4B5452;  // "MKTR"
+constexpr uint32_t kTraceVersion = 1;
+// The header and the records are padded to multiples of the largest alignment of the fields, the
+// one of uint64_t, so that each record can be written and read as a buffer of its own.
+
+struct Recorder {
+    std::mutex mutex;
+    std::vector<uint8_t> trace GUARDED_BY(mutex);
+    size_t maxBytes GUARDED_BY(mutex) = 0;
+    uint32_t droppedCount GUARDED_BY(mutex) = 0;
+    std::atomic<uint32_t> nextMeasuredTextId = 1;
+    // The fingerprints by collection id. The collections never change, so a fingerprint is
+    // computed once per collection.
+    std::unordered_map<uint32_t, uint32_t> fingerprints GUARDED_BY(mutex);
+
+    static Recorder& getInstance() {
+        static Recorder recorder;
+        return recorder;
+    }
+};
+
+void writePaint(BufferWriter* writer, const RecordedPaint& paint) {
+    writer->write<float>(paint.size);
+    writer->write<float>(paint.scaleX);
+    writer->write<float>(paint.skewX);
+    writer->write<float>(paint.letterSpacing);
+    writer->write<float>(paint.wordSpacing);
+    writer->write<uint32_t>(paint.fontFlags);
+    writer->writeString(paint.locales);
+    paint.fontStyle.writeTo(writer);
+    writer->write<uint8_t>(static_cast<uint8_t>(paint.familyVariant));
+    writer->writeString(paint.fontFeatureSettings);
+    writer->write<uint32_t>(paint.collectionFingerprint);
+}
+
+void writeCall(BufferWriter* writer, const RecordedCall& call) {
+    writer->write<uint32_t>(static_cast<uint32_t>(call.type));
+    writer->write<uint64_t>(call.durationNanos);
+    writer->writeArray<uint16_t>(call.text.data(), call.text.size());
+    switch (call.type) {
+        case RecordedCall::Type::kLayout:
+        case RecordedCall::Type::kMeasureText:
+            writer->write<uint32_t>(call.range.getStart());
+            writer->write<uint32_t>(call.range.getEnd());
+            writer->write<uint8_t>(static_cast<uint8_t>(call.bidiFlags));
+            writer->write<uint8_t>(static_cast<uint8_t>(call.startHyphen));
+            writer->write<uint8_t>(static_cast<uint8_t>(call.endHyphen));
+            writePaint(writer, call.paint);
+            break;
+        case RecordedCall::Type::kMeasuredTextBuild:
+            writer->write<uint32_t>(call.runs.size());
+            for (const RecordedCall::Run& run : call.runs) {
+                writer->write<uint32_t>(run.range.getStart());
+                writer->write<uint32_t>(run.range.getEnd());
+                writer->write<uint8_t>(run.isReplacement);
+                writer->write<uint8_t>(run.isRtl);
+                if (run.isReplacement) {
+                    writer->write<float>(run.width);
+                    writer->writeString(run.locales);
+                } else {
+                    writePaint(writer, run.paint);
+                }
+            }
+            writer->write<uint8_t>(call.computeHyphenation);
+            writer->write<uint8_t>(call.computeLayout);
+            writer->write<uint8_t>(call.lazyHyphenation);
+            writer->write<uint8_t>(call.hasHint);
+            writer->write<uint32_t>(call.maxThreads);
+            writer->write<uint8_t>(call.compactWidths);
+            writer->write<uint8_t>(call.keepWordBreaks);
+            writer->write<uint32_t>(call.lineBreakCacheSize);
+            writer->write<uint8_t>(call.approximateHyphenPieces);
+            writer->write<uint32_t>(call.measuredTextId);
+            break;
+        case RecordedCall::Type::kBreakIntoLines:
+            writer->write<uint32_t>(call.measuredTextId);
+            writer->write<uint8_t>(static_cast<uint8_t>(call.strategy));
+            writer->write<uint8_t>(static_cast<uint8_t>(call.frequency));
+            writer->write<uint8_t>(call.justified);
+            writer->writeArray<float>(call.lineWidths.data(), call.lineWidths.size());
+            writer->write<float>(call.minLineWidth);
+            writer->writeArray<float>(call.tabStops.data(), call.tabStops.size());
+            writer->write<float>(call.tabWidth);
+            break;
+    }
+}
+
+std::string readString(BufferValidator* validator) {
+    const auto [data, size] = validator->readArray<char>();
+    return data == nullptr ? std::string() : std::string(data, size);
+}
+
+template <typename T>
+std::vector<T> readVector(BufferValidator* validator) {
+    const auto [data, size] = validator->readArray<T>();
+    return data == nullptr ? std::vector<T>() : std::vector<T>(data, data + size);
+}
+
+// Reads a range of the text, failing if it is not in the text.
+Range readRange(BufferValidator* validator, size_t textSize) {
+    const uint32_t start = validator->read<uint32_t>();
+    const uint32_t end = validator->read<uint32_t>();
+    if (start > end || end > textSize) {
+        validator->fail();
+        return Range();
+    }
+    return Range(start, end);
+}
+
+RecordedPaint readPaint(BufferValidator* validator) {
+    RecordedPaint paint;
+    paint.size = validator->read<float>();
+    paint.scaleX = validator->read<float>();
+    paint.skewX = validator->read<float>();
+    paint.letterSpacing = validator->read<float>();
+    paint.wordSpacing = validator->read<float>();
+    paint.fontFlags = validator->read<uint32_t>();
+    paint.locales = readString(validator);
+    const uint16_t weight = validator->read<uint16_t>();
+    const uint8_t slant = validator->read<uint8_t>();
+    paint.fontStyle = FontStyle(weight, static_cast<FontStyle::Slant>(slant != 0));
+    paint.familyVariant = static_cast<FamilyVariant>(validator->read<uint8_t>());
+    paint.fontFeatureSettings = readString(validator);
+    paint.collectionFingerprint = validator->read<uint32_t>();
+    return paint;
+}
+
+// Reads a value of an enum whose values are from 0 to maxValue, failing on the other values.
+template <typename Enum>
+Enum readEnum(BufferValidator* validator, uint8_t maxValue) {
+    const uint8_t value = validator->read<uint8_t>();
+    if (value > maxValue) {
+        validator->fail();
+    }
+    return static_cast<Enum>(value);
+}
+
+bool readCall(BufferValidator* validator, RecordedCall* call) {
+    const uint32_t type = validator->read<uint32_t>();
+    if (type > static_cast<uint32_t>(RecordedCall::Type::kBreakIntoLines)) {
+        return false;
+    }
+    call->type = static_cast<RecordedCall::Type>(type);
+    call->durationNanos = validator->read<uint64_t>();
+    call->text = readVector<uint16_t>(validator);
+    switch (call->type) {
+        case RecordedCall::Type::kLayout:
+        case RecordedCall::Type::kMeasureText:
+            call->range = readRange(validator, call->text.size());
+            call->bidiFlags = readEnum<Bidi>(validator, static_cast<uint8_t>(Bidi::FORCE_RTL));
+            call->startHyphen = static_cast<StartHyphenEdit>(validator->read<uint8_t>());
+            call->endHyphen = static_cast<EndHyphenEdit>(validator->read<uint8_t>());
+            call->paint = readPaint(validator);
+            break;
+        case RecordedCall::Type::kMeasuredTextBuild: {
+            const uint32_t runCount = validator->read<uint32_t>();
+            for (uint32_t i = 0; i < runCount && validator->ok(); i++) {
+                RecordedCall::Run run;
+                run.range = readRange(validator, call->text.size());
+                run.isReplacement = validator->read<uint8_t>() != 0;
+                run.isRtl = validator->read<uint8_t>() != 0;
+                if (run.isReplacement) {
+                    run.width = validator->read<float>();
+                    run.locales = readString(validator);
+                } else {
+                    run.paint = readPaint(validator);
+                }
+                call->runs.push_back(std::move(run));
+            }
+            call->computeHyphenation = validator->read<uint8_t>() != 0;
+            call->computeLayout = validator->read<uint8_t>() != 0;
+            call->lazyHyphenation = validator->read<uint8_t>() != 0;
+            call->hasHint = validator->read<uint8_t>() != 0;
+            call->maxThreads = validator->read<uint32_t>();
+            call->compactWidths = validator->read<uint8_t>() != 0;
+            call->keepWordBreaks = validator->read<uint8_t>() != 0;
+            call->lineBreakCacheSize = validator->read<uint32_t>();
+            call->approximateHyphenPieces = validator->read<uint8_t>() != 0;
+            call->measuredTextId = validator->read<uint32_t>();
+            break;
+        }
+        case RecordedCall::Type::kBreakIntoLines:
+            call->measuredTextId = validator->read<uint32_t>();
+            call->strategy = readEnum<BreakStrategy>(
+                    validator, static_cast<uint8_t>(BreakStrategy::Balanced));
+            call->frequency = readEnum<HyphenationFrequency>(
+                    validator, static_cast<uint8_t>(HyphenationFrequency::Full));
+            call->justified = validator->read<uint8_t>() != 0;
+            call->lineWidths = readVector<float>(validator);
+            call->minLineWidth = validator->read<float>();
+            call->tabStops = readVector<float>(validator);
+            call->tabWidth = validator->read<float>();
+            break;
+    }
+    return validator->ok();
+}
+
+}  // namespace
+
+RecordedPaint RecordedPaint::from(const MinikinPaint& paint) {
+    RecordedPaint recorded;
+    recorded.size = paint.size;
+    recorded.scaleX = paint.scaleX;
+    recorded.skewX = paint.skewX;
+    recorded.letterSpacing = paint.letterSpacing;
+    recorded.wordSpacing = paint.wordSpacing;
+    recorded.fontFlags = paint.fontFlags;
+    recorded.locales = getLocaleString(paint.localeListId);
+    recorded.fontStyle = paint.fontStyle;
+    recorded.familyVariant = paint.familyVariant;
+    recorded.fontFeatureSettings = paint.fontFeatureSettings;
+    recorded.collectionFingerprint =
+            paint.font ? CallRecorder::getCollectionFingerprint(*paint.font) : 0;
+    return recorded;
+}
+
+MinikinPaint RecordedPaint::toPaint(const std::shared_ptr<FontCollection>& collection) const {
+    MinikinPaint paint(collection);
+    paint.size = size;
+    paint.scaleX = scaleX;
+    paint.skewX = skewX;
+    paint.letterSpacing = letterSpacing;
+    paint.wordSpacing = wordSpacing;
+    paint.fontFlags = fontFlags;
+    paint.localeListId = registerLocaleList(locales);
+    paint.fontStyle = fontStyle;
+    paint.familyVariant = familyVariant;
+    paint.fontFeatureSettings = fontFeatureSettings;
+    return paint;
+}
+
+void CallRecorder::start(size_t maxBytes) {
+    Recorder& recorder = Recorder::getInstance();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    recorder.trace.assign(BufferReader::align<uint64_t>(sizeof(uint32_t) * 2), 0);
+    BufferWriter header(recorder.trace.data());
+    header.write<uint32_t>(kTraceMagic);
+    header.write<uint32_t>(kTraceVersion);
+    recorder.maxBytes = maxBytes;
+    recorder.droppedCount = 0;
+    sRecording.store(true, std::memory_order_relaxed);
+}
+
+std::vector<uint8_t> CallRecorder::stop() {
+    Recorder& recorder = Recorder::getInstance();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    sRecording.store(false, std::memory_order_relaxed);
+    return std::move(recorder.trace);
+}
+
+uint32_t CallRecorder::getDroppedCallCount() {
+    Recorder& recorder = Recorder::getInstance();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    return recorder.droppedCount;
+}
+
+void CallRecorder::record(const RecordedCall& call) {
+    BufferWriter measurer(nullptr);
+    writeCall(&measurer, call);
+    const size_t size = BufferReader::align<uint64_t>(measurer.size());
+
+    Recorder& recorder = Recorder::getInstance();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    // The recording may have stopped while the call ran.
+    if (!isRecording()) {
+        return;
+    }
+    const size_t offset = recorder.trace.size();
+    if (offset + size > recorder.maxBytes) {
+        recorder.droppedCount++;
+        return;
+    }
+    recorder.trace.resize(offset + size);
+    BufferWriter writer(recorder.trace.data() + offset);
+    writeCall(&writer, call);
+}
+
+uint32_t CallRecorder::nextMeasuredTextId() {
+    return Recorder::getInstance().nextMeasuredTextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CallRecorder::copyTabStops(const TabStops& tabStops, RecordedCall* call) {
+    call->tabStops.assign(tabStops.mStops, tabStops.mStops + tabStops.mStopsSize);
+    call->tabWidth = tabStops.mTabWidth;
+}
+
+bool CallRecorder::readTrace(const void* data, size_t size, std::vector<RecordedCall>* out) {
+    out->clear();
+    BufferValidator validator(data, size);
+    if (validator.read<uint32_t>() != kTraceMagic || validator.read<uint32_t>() != kTraceVersion) {
+        return false;
+    }
+    size_t pos = BufferReader::align<uint64_t>(validator.pos());
+    while (pos < size) {
+        // Each record is read as a buffer of its own, where its fields were aligned.
+        BufferValidator recordValidator(static_cast<const uint8_t*>(data) + pos, size - pos);
+        RecordedCall call;
+        // The record must be whole, including its padding.
+        if (!readCall(&recordValidator, &call) ||
+            BufferReader::align<uint64_t>(recordValidator.pos()) > size - pos) {
+            out->clear();
+            return false;
+        }
+        out->push_back(std::move(call));
+        pos += BufferReader::align<uint64_t>(recordValidator.pos());
+    }
+    return true;
+}
+
+uint32_t CallRecorder::getCollectionFingerprint(const FontCollection& collection) {
+    Recorder& recorder = Recorder::getInstance();
+    {
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+        auto it = recorder.fingerprints.find(collection.getId());
+        if (it != recorder.fingerprints.end()) {
+            return it->second;
+        }
+    }
+    Hasher hasher;
+    for (const std::shared_ptr<FontFamily>& family : collection.getFamilies()) {
+        hasher.updateString(getLocaleString(family->localeListId()));
+        hasher.update(static_cast<uint32_t>(family->variant()));
+        hasher.update(static_cast<uint32_t>(family->getNumFonts()));
+        for (size_t i = 0; i < family->getNumFonts(); i++) {
+            hasher.update(family->getStyle(i).identifier());
+        }
+        hasher.update(family->getCoverage().length());
+        hasher.update(family->getCoverage().popcount());
+    }
+    const uint32_t fingerprint = hasher.hash();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    recorder.fingerprints.emplace(collection.getId(), fingerprint);
+    return fingerprint;
+}
+
+}  // namespace minikin
@@ -21,7 +21,6 @@
 #include <algorithm>
 #include <vector>
 
-#include "minikin/Range.h"
 #include "minikin/SparseBitSet.h"
 
 #include "MinikinInternal.h"
@@ -43,15 +42,11 @@ static uint32_t readU32(const uint8_t* data, size_t offset) {
            ((uint32_t)data[offset + 2]) << 8 | ((uint32_t)data[offset + 3]);
 }
 
-// The start must be larger than or equal to coverage.back() if coverage is not empty.
+// The start must be larger than or equal to coverage.end().
 // Returns true if the range is appended. Otherwise returns false as an error.
-static bool addRange(std::vector<uint32_t>& coverage, uint32_t start, uint32_t end) {
-    if (coverage.empty() || coverage.back() < start) {
-        coverage.push_back(start);
-        coverage.push_back(end);
-        return true;
-    } else if (coverage.back() == start) {
-        coverage.back() = end;
+static bool addRange(SparseBitSet::Builder& coverage, uint32_t start, uint32_t end) {
+    if (coverage.end() <= start) {
+        coverage.addRange(start, end);
         return true;
     } else {
         // Reject unordered range input since SparseBitSet assumes that the given range vector is
@@ -63,94 +58,18 @@ static bool addRange(std::vector<uint32_t>& coverage, uint32_t start, uint32_t e
 }
 
 // Returns true if the range is appended. Otherwise returns false as an error.
-static bool addRangeCmap4(std::vector<uint32_t>& coverage, uint32_t start, uint32_t end) {
-    if (!coverage.empty() && coverage.back() > end) {
+static bool addRangeCmap4(SparseBitSet::Builder& coverage, uint32_t start, uint32_t end) {
+    if (coverage.end() > end) {
         // Reject unordered end code points.
         return false;
     }
-    if (coverage.empty() || coverage.back() < start) {
-        coverage.push_back(start);
-        coverage.push_back(end);
-        return true;
-    } else {
-        coverage.back() = end;
-        return true;
-    }
-}
-
-// Returns Range from given ranges vector. Returns invalidRange if i is out of range.
-static inline Range getRange(const std::vector<uint32_t>& r, size_t i) {
-    return i + 1 < r.size() ? Range({r[i], r[i + 1]}) : Range::invalidRange();
-}
-
-// Merge two sorted lists of ranges into one sorted list.
-static std::vector<uint32_t> mergeRanges(const std::vector<uint32_t>& lRanges,
-                                         const std::vector<uint32_t>& rRanges) {
-    std::vector<uint32_t> out;
-
-    const size_t lsize = lRanges.size();
-    const size_t rsize = rRanges.size();
-    out.reserve(lsize + rsize);
-    size_t ri = 0;
-    size_t li = 0;
-    while (li < lsize || ri < rsize) {
-        Range left = getRange(lRanges, li);
-        Range right = getRange(rRanges, ri);
-
-        if (!right.isValid()) {
-            // No ranges left in rRanges. Just put all remaining ranges in lRanges.
-            do {
-                Range r = getRange(lRanges, li);
-                addRange(out, r.getStart(), r.getEnd());  // Input is sorted. Never returns false.
-                li += 2;
-            } while (li < lsize);
-            break;
-        } else if (!left.isValid()) {
-            // No ranges left in lRanges. Just put all remaining ranges in rRanges.
-            do {
-                Range r = getRange(rRanges, ri);
-                addRange(out, r.getStart(), r.getEnd());  // Input is sorted. Never returns false.
-                ri += 2;
-            } while (ri < rsize);
-            break;
-        } else if (!Range::intersects(left, right)) {
-            // No intersection. Add smaller range.
-            if (left.getStart() < right.getStart()) {
-                // Input is sorted. Never returns false.
-                addRange(out, left.getStart(), left.getEnd());
-                li += 2;
-            } else {
-                // Input is sorted. Never returns false.
-                addRange(out, right.getStart(), right.getEnd());
-                ri += 2;
-            }
-        } else {
-            Range merged = Range::merge(left, right);
-            li += 2;
-            ri += 2;
-            left = getRange(lRanges, li);
-            right = getRange(rRanges, ri);
-            while (Range::intersects(merged, left) || Range::intersects(merged, right)) {
-                if (Range::intersects(merged, left)) {
-                    merged = Range::merge(merged, left);
-                    li += 2;
-                    left = getRange(lRanges, li);
-                } else {
-                    merged = Range::merge(merged, right);
-                    ri += 2;
-                    right = getRange(rRanges, ri);
-                }
-            }
-            // Input is sorted. Never returns false.
-            addRange(out, merged.getStart(), merged.getEnd());
-        }
-    }
-
-    return out;
+    // The part overlapping with the previous range is already covered.
+    coverage.addRange(start, end);
+    return true;
 }
 
 // Get the coverage information out of a Format 4 subtable, storing it in the coverage vector
-static bool getCoverageFormat4(std::vector<uint32_t>& coverage, const uint8_t* data, size_t size) {
+static bool getCoverageFormat4(SparseBitSet::Builder& coverage, const uint8_t* data, size_t size) {
     const size_t kSegCountOffset = 6;
     const size_t kEndCountOffset = 14;
     const size_t kHeaderSize = 16;
@@ -207,7 +126,7 @@ static bool getCoverageFormat4(std::vector<uint32_t>& coverage, const uint8_t* d
 }
 
 // Get the coverage information out of a Format 12 subtable, storing it in the coverage vector
-static bool getCoverageFormat12(std::vector<uint32_t>& coverage, const uint8_t* data, size_t size) {
+static bool getCoverageFormat12(SparseBitSet::Builder& coverage, const uint8_t* data, size_t size) {
     const size_t kNGroupsOffset = 12;
     const size_t kFirstGroupOffset = 16;
     const size_t kGroupSize = 12;
@@ -287,12 +206,12 @@ uint8_t getTablePriority(uint16_t platformId, uint16_t encodingId) {
 // Get merged coverage information from default UVS Table and non-default UVS Table. Note that this
 // function assumes code points in both default UVS Table and non-default UVS table are stored in
 // ascending order. This is required by the standard.
-static bool getVSCoverage(std::vector<uint32_t>* out_ranges, const uint8_t* data, size_t size,
+static bool getVSCoverage(SparseBitSet* out, const uint8_t* data, size_t size,
                           uint32_t defaultUVSTableOffset, uint32_t nonDefaultUVSTableOffset,
                           const SparseBitSet& baseCoverage) {
     // Need to merge supported ranges from default UVS Table and non-default UVS Table.
     // First, collect all supported code points from non default UVS table.
-    std::vector<uint32_t> rangesFromNonDefaultUVSTable;
+    SparseBitSet::Builder rangesFromNonDefaultUVSTable;
     if (nonDefaultUVSTableOffset != 0) {
         constexpr size_t kHeaderSize = 4;
         constexpr size_t kUVSMappingRecordSize = 5;
@@ -323,7 +242,7 @@ static bool getVSCoverage(std::vector<uint32_t>* out_ranges, const uint8_t* data
 
     // Then, construct range from default UVS Table with merging code points from non default UVS
     // table.
-    std::vector<uint32_t> rangesFromDefaultUVSTable;
+    SparseBitSet::Builder rangesFromDefaultUVSTable;
     if (defaultUVSTableOffset != 0) {
         constexpr size_t kHeaderSize = 4;
         constexpr size_t kUnicodeRangeRecordSize = 4;
@@ -364,7 +283,8 @@ static bool getVSCoverage(std::vector<uint32_t>* out_ranges, const uint8_t* data
             }
         }
     }
-    *out_ranges = mergeRanges(rangesFromDefaultUVSTable, rangesFromNonDefaultUVSTable);
+    *out = rangesFromDefaultUVSTable.build();
+    out->unionWith(rangesFromNonDefaultUVSTable.build());
     return true;
 }
 
@@ -409,15 +329,15 @@ static void getCoverageFormat14(std::vector<std::unique_ptr<SparseBitSet>>* out,
         if (vsIndex == INVALID_VS_INDEX) {
             continue;
         }
-        std::vector<uint32_t> ranges;
-        if (!getVSCoverage(&ranges, data, length, defaultUVSOffset, nonDefaultUVSOffset,
+        SparseBitSet vsCoverage;
+        if (!getVSCoverage(&vsCoverage, data, length, defaultUVSOffset, nonDefaultUVSOffset,
                            baseCoverage)) {
             continue;
         }
         if (out->size() < vsIndex + 1) {
             out->resize(vsIndex + 1);
         }
-        (*out)[vsIndex].reset(new SparseBitSet(ranges.data(), ranges.size() >> 1));
+        (*out)[vsIndex].reset(new SparseBitSet(std::move(vsCoverage)));
     }
 
     out->shrink_to_fit();
@@ -519,15 +439,15 @@ SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_siz
         const uint8_t* tableData = cmap_data + bestTableOffset;
         const size_t tableSize = cmap_size - bestTableOffset;
         bool success;
-        std::vector<uint32_t> coverageVec;
+        SparseBitSet::Builder builder;
         if (bestTableFormat == 4) {
-            success = getCoverageFormat4(coverageVec, tableData, tableSize);
+            success = getCoverageFormat4(builder, tableData, tableSize);
         } else {
-            success = getCoverageFormat12(coverageVec, tableData, tableSize);
+            success = getCoverageFormat12(builder, tableData, tableSize);
         }
 
         if (success) {
-            coverage = SparseBitSet(&coverageVec.front(), coverageVec.size() >> 1);
+            coverage = builder.build();
         }
     }
 
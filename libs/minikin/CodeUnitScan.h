@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_CODE_UNIT_SCAN_H
+#define MINIKIN_CODE_UNIT_SCAN_H
+
+#include <cstdint>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace minikin {
+
+/*
+ * Returns the index of the first code unit in [start, end) which is not in [lo, hi], or end if
+ * all of them are in the range. Checks eight code units at a time with NEON or SSE2.
+ */
+inline uint32_t findCodeUnitOutOfRange(const uint16_t* chars, uint32_t start, uint32_t end,
+                                       uint16_t lo, uint16_t hi) {
+    const uint16_t width = hi - lo;
+    uint32_t i = start;
+#if defined(__ARM_NEON)
+    const uint16x8_t vLo = vdupq_n_u16(lo);
+    const uint16x8_t vWidth = vdupq_n_u16(width);
+    for (; i + 8 <= end; i += 8) {
+        // The code units below lo wrap around to large values.
+        const uint16x8_t out = vcgtq_u16(vsubq_u16(vld1q_u16(chars + i), vLo), vWidth);
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(out, 4)), 0) != 0) {
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i vLo = _mm_set1_epi16(static_cast<int16_t>(lo));
+    const __m128i vWidth = _mm_set1_epi16(static_cast<int16_t>(width));
+    for (; i + 8 <= end; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        // The code units below lo wrap around to large values. The saturated subtraction is zero
+        // exactly for the code units in the range.
+        const __m128i in = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(v, vLo), vWidth),
+                                           _mm_setzero_si128());
+        if (_mm_movemask_epi8(in) != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+    for (; i < end; ++i) {
+        if (static_cast<uint16_t>(chars[i] - lo) > width) {
+            return i;
+        }
+    }
+    return end;
+}
+
+/*
+ * Returns the index of the first code unit in [start, end) which is equal to one of the values, or
+ * end if there is none. Checks eight code units at a time with NEON or SSE2.
+ */
+template <typename... Values>
+inline uint32_t findAnyCodeUnit(const uint16_t* chars, uint32_t start, uint32_t end,
+                                Values... values) {
+    uint32_t i = start;
+#if defined(__ARM_NEON)
+    const uint16x8_t vValues[] = {vdupq_n_u16(values)...};
+    for (; i + 8 <= end; i += 8) {
+        const uint16x8_t v = vld1q_u16(chars + i);
+        uint16x8_t eq = vdupq_n_u16(0);
+        for (const uint16x8_t& vValue : vValues) {
+            eq = vorrq_u16(eq, vceqq_u16(v, vValue));
+        }
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(eq, 4)), 0) != 0) {
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i vValues[] = {_mm_set1_epi16(static_cast<int16_t>(values))...};
+    for (; i + 8 <= end; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        __m128i eq = _mm_setzero_si128();
+        for (const __m128i& vValue : vValues) {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi16(v, vValue));
+        }
+        if (_mm_movemask_epi8(eq) != 0) {
+            break;
+        }
+    }
+#endif
+    for (; i < end; ++i) {
+        if (((chars[i] == values) || ...)) {
+            return i;
+        }
+    }
+    return end;
+}
+
+/*
+ * Returns the index of the first code unit in [start, end) which is not equal to any of the
+ * values, or end if there is none. Checks eight code units at a time with NEON or SSE2.
+ */
+template <typename... Values>
+inline uint32_t findCodeUnitNotAnyOf(const uint16_t* chars, uint32_t start, uint32_t end,
+                                     Values... values) {
+    uint32_t i = start;
+#if defined(__ARM_NEON)
+    const uint16x8_t vValues[] = {vdupq_n_u16(values)...};
+    for (; i + 8 <= end; i += 8) {
+        const uint16x8_t v = vld1q_u16(chars + i);
+        uint16x8_t eq = vdupq_n_u16(0);
+        for (const uint16x8_t& vValue : vValues) {
+            eq = vorrq_u16(eq, vceqq_u16(v, vValue));
+        }
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vmvnq_u16(eq), 4)), 0) != 0) {
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i vValues[] = {_mm_set1_epi16(static_cast<int16_t>(values))...};
+    for (; i + 8 <= end; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        __m128i eq = _mm_setzero_si128();
+        for (const __m128i& vValue : vValues) {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi16(v, vValue));
+        }
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+    for (; i < end; ++i) {
+        if (!((chars[i] == values) || ...)) {
+            return i;
+        }
+    }
+    return end;
+}
+
+/*
+ * Returns the index of the first code unit in [start, end) which is equal to value, or end if
+ * there is none.
+ */
+inline uint32_t findCodeUnit(const uint16_t* chars, uint32_t start, uint32_t end, uint16_t value) {
+    return findAnyCodeUnit(chars, start, end, value);
+}
+
+}  // namespace minikin
+
+#endif  // MINIKIN_CODE_UNIT_SCAN_H
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeferredLayoutQueue.h"
+
+#include "minikin/Executor.h"
+
+namespace minikin {
+
+// static
+DeferredLayoutQueue& DeferredLayoutQueue::getInstance() {
+    // Never destroyed, so that the running layout isn't waited for while the process exits.
+    static DeferredLayoutQueue* queue = new DeferredLayoutQueue();
+    return *queue;
+}
+
+DeferredLayoutQueue::DeferredLayoutQueue() : mIsRunning(false) {}
+
+DeferredLayoutQueue::~DeferredLayoutQueue() {
+    // The callbacks of the pending tasks are still called, since their callers wait for them.
+    waitForIdle();
+}
+
+bool DeferredLayoutQueue::postInternal(std::function<void()>&& task) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mQueue.size() >= kMaxPendingTasks) {
+            return false;
+        }
+        mQueue.push_back(std::move(task));
+        if (mIsRunning) {
+            return true;
+        }
+        mIsRunning = true;
+    }
+    getExecutor()->execute([this]() { run(); }, Executor::Priority::kBackground);
+    return true;
+}
+
+void DeferredLayoutQueue::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mQueue.empty() && !mIsRunning; });
+}
+
+void DeferredLayoutQueue::run() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mQueue.empty()) {
+            mIsRunning = false;
+            // Notified under the lock, since the queue may be destroyed right after.
+            mCondition.notify_all();
+            return;
+        }
+        task = std::move(mQueue.front());
+        mQueue.pop_front();
+    }
+    task();
+    // The captures of the task, e.g. the font collection of its paint, are released before
+    // waitForIdle() returns.
+    task = nullptr;
+    // Each layout runs in a task of its own, so that a long queue doesn't hold up the other
+    // background work, e.g. the font preloading, until it is drained. The last task finds the queue
+    // empty and marks it idle.
+    getExecutor()->execute([this]() { run(); }, Executor::Priority::kBackground);
+}
+
+}  // namespace minikin
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_DEFERRED_LAYOUT_QUEUE_H
+#define MINIKIN_DEFERRED_LAYOUT_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Runs the exact layouts deferred by Layout::measureTextCoarse() in the background tasks of
+// getExecutor(), one layout per task, in the order they were posted.
+class DeferredLayoutQueue {
+public:
+    // The number of the tasks waiting to run, above which post() refuses new ones.
+    static constexpr size_t kMaxPendingTasks = 256;
+
+    // Returns false without posting the task, which is then left as is, if kMaxPendingTasks tasks
+    // are already waiting, so that the queue doesn't grow without bound while the background
+    // worker falls behind.
+    static bool post(std::function<void()>&& task) {
+        return getInstance().postInternal(std::move(task));
+    }
+
+protected:
+    // Visible for testing purposes. The destructor waits for the pending tasks to run.
+    DeferredLayoutQueue();
+    virtual ~DeferredLayoutQueue();
+
+    bool postInternal(std::function<void()>&& task);
+
+    // Blocks until all the posted tasks have run.
+    void waitForIdle();
+
+private:
+    static DeferredLayoutQueue& getInstance();
+
+    void run();
+
+    std::deque<std::function<void()>> mQueue GUARDED_BY(mMutex);
+    // True while a task running the next layout of the queue is posted or running.
+    bool mIsRunning GUARDED_BY(mMutex);
+    std::condition_variable mCondition;
+    std::mutex mMutex;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(DeferredLayoutQueue);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_DEFERRED_LAYOUT_QUEUE_H
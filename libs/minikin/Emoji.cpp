@@ -16,16 +16,18 @@
 
 #include "minikin/Emoji.h"
 
+#include "UnicodeProperties.h"
+
 namespace minikin {
 
 bool isEmoji(uint32_t c) {
-    return u_hasBinaryProperty(c, UCHAR_EMOJI);
+    return getUnicodeProperties(c) & unicode_tables::EMOJI_BIT;
 }
 
 bool isEmojiModifier(uint32_t c) {
     // Emoji modifier are not expected to change, so there's a small change we need to customize
     // this.
-    return u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER);
+    return getUnicodeProperties(c) & unicode_tables::EMOJI_MODIFIER_BIT;
 }
 
 bool isEmojiBase(uint32_t c) {
@@ -36,7 +38,7 @@ bool isEmojiBase(uint32_t c) {
         return true;
     }
 
-    return u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER_BASE);
+    return getUnicodeProperties(c) & unicode_tables::EMOJI_MODIFIER_BASE_BIT;
 }
 
 UCharDirection emojiBidiOverride(const void* /* context */, UChar32 c) {
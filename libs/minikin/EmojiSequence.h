@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_EMOJI_SEQUENCE_H
+#define MINIKIN_EMOJI_SEQUENCE_H
+
+#include <cstdint>
+
+#include "minikin/Characters.h"
+
+#include "MinikinInternal.h"
+#include "UnicodeProperties.h"
+
+namespace minikin {
+
+// Recognizes emoji ZWJ, modifier, tag, keycap and flag sequences one code point at a time, with a
+// precomputed transition table over a few classes of code points. For each code point, it tells
+// if the code point continues the emoji sequence of the previous ones, so that the sequence can
+// be kept in the font of its first code point without a fallback lookup for each component.
+class EmojiSequenceRecognizer {
+public:
+    EmojiSequenceRecognizer() : mState(NONE) {}
+
+    // Returns true if c continues the emoji sequence ending at the previous code point.
+    bool next(uint32_t c) {
+        const uint8_t transition = kTransitions[mState][getClass(c)];
+        mState = transition & ~CONTINUES;
+        return (transition & CONTINUES) != 0;
+    }
+
+    void reset() { mState = NONE; }
+
+private:
+    enum Class : uint8_t {
+        OTHER,
+        PICTOGRAPHIC,
+        REGIONAL_INDICATOR,
+        MODIFIER,
+        ZWJ,
+        EMOJI_VS,
+        KEYCAP_BASE,
+        KEYCAP,
+        TAG,
+        CANCEL_TAG,
+        CLASS_COUNT,
+    };
+
+    enum State : uint8_t {
+        NONE,               // Not in a sequence.
+        EMOJI,              // After an emoji, maybe followed by a modifier, VS16, ZWJ or tags.
+        FLAG_HALF,          // After the first regional indicator of a flag.
+        AFTER_ZWJ,          // After an emoji and a ZWJ, waiting for the next emoji.
+        IN_TAG,             // After an emoji and tag characters, waiting for the cancel tag.
+        AFTER_KEYCAP_BASE,  // After a digit, '#' or '*'.
+        AFTER_KEYCAP_VS,    // After a digit, '#' or '*' and a VS16.
+        STATE_COUNT,
+    };
+
+    // Set in a transition if the code point continues the sequence.
+    static constexpr uint8_t CONTINUES = 0x80;
+    static constexpr uint8_t C = CONTINUES;
+
+    static constexpr uint32_t REGIONAL_INDICATOR_A = 0x1F1E6;
+    static constexpr uint32_t REGIONAL_INDICATOR_Z = 0x1F1FF;
+    static constexpr uint32_t COMBINING_ENCLOSING_KEYCAP = 0x20E3;
+    static constexpr uint32_t TAG_SPACE = 0xE0020;
+    static constexpr uint32_t CANCEL_TAG_CHAR = 0xE007F;
+
+    static Class getClass(uint32_t c) {
+        if (c < 0x80) {
+            return (('0' <= c && c <= '9') || c == '#' || c == '*') ? KEYCAP_BASE : OTHER;
+        }
+        if (c == CHAR_ZWJ) return ZWJ;
+        if (c == VS16) return EMOJI_VS;
+        if (c == COMBINING_ENCLOSING_KEYCAP) return KEYCAP;
+        if (REGIONAL_INDICATOR_A <= c && c <= REGIONAL_INDICATOR_Z) return REGIONAL_INDICATOR;
+        if (TAG_SPACE <= c && c < CANCEL_TAG_CHAR) return TAG;
+        if (c == CANCEL_TAG_CHAR) return CANCEL_TAG;
+        const uint16_t props = getUnicodeProperties(c);
+        if (props & unicode_tables::EMOJI_MODIFIER_BIT) return MODIFIER;
+        if (props & unicode_tables::EXTENDED_PICTOGRAPHIC_BIT) return PICTOGRAPHIC;
+        return OTHER;
+    }
+
+    // kTransitions[state][class] is the next state, with CONTINUES set if the code point is a
+    // component of the sequence rather than its start. A lone modifier starts a sequence of its
+    // own, since it is an emoji too.
+    static constexpr uint8_t kTransitions[STATE_COUNT][CLASS_COUNT] = {
+            // OTHER, PICTOGRAPHIC, REGIONAL_INDICATOR, MODIFIER, ZWJ, EMOJI_VS, KEYCAP_BASE,
+            // KEYCAP, TAG, CANCEL_TAG
+            // NONE
+            {NONE, EMOJI, FLAG_HALF, EMOJI, NONE, NONE, AFTER_KEYCAP_BASE, NONE, NONE, NONE},
+            // EMOJI
+            {NONE, EMOJI, FLAG_HALF, EMOJI | C, AFTER_ZWJ | C, EMOJI | C, AFTER_KEYCAP_BASE, NONE,
+             IN_TAG | C, NONE},
+            // FLAG_HALF
+            {NONE, EMOJI, NONE | C, EMOJI, NONE, NONE, AFTER_KEYCAP_BASE, NONE, NONE, NONE},
+            // AFTER_ZWJ
+            {NONE, EMOJI | C, FLAG_HALF, EMOJI, NONE, NONE, AFTER_KEYCAP_BASE, NONE, NONE, NONE},
+            // IN_TAG
+            {NONE, EMOJI, FLAG_HALF, EMOJI, NONE, NONE, AFTER_KEYCAP_BASE, NONE, IN_TAG | C,
+             NONE | C},
+            // AFTER_KEYCAP_BASE
+            {NONE, EMOJI, FLAG_HALF, EMOJI, NONE, AFTER_KEYCAP_VS | C, AFTER_KEYCAP_BASE, NONE | C,
+             NONE, NONE},
+            // AFTER_KEYCAP_VS
+            {NONE, EMOJI, FLAG_HALF, EMOJI, NONE, NONE, AFTER_KEYCAP_BASE, NONE | C, NONE, NONE},
+    };
+
+    uint8_t mState;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_EMOJI_SEQUENCE_H
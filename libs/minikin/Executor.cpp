@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Executor.h"
+
+#include <atomic>
+
+#include "ThreadPool.h"
+
+namespace minikin {
+
+namespace {
+
+std::atomic<Executor*> gExecutor(nullptr);
+
+Executor* getDefaultExecutor() {
+    // Never destroyed, so that the workers aren't joined while the process exits. The calling
+    // thread of the parallel work takes a performance core too.
+    static ThreadPool* pool = new ThreadPool(ThreadPool::getPerformanceCoreCount() - 1);
+    return pool;
+}
+
+}  // namespace
+
+Executor* getExecutor() {
+    Executor* executor = gExecutor.load(std::memory_order_acquire);
+    return executor != nullptr ? executor : getDefaultExecutor();
+}
+
+void setExecutor(Executor* executor) {
+    gExecutor.store(executor, std::memory_order_release);
+}
+
+}  // namespace minikin
@@ -18,16 +18,21 @@
 
 #include "minikin/Font.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <hb-ot.h>
 #include <hb.h>
 #include <log/log.h>
 
+#include "minikin/FontFileParser.h"
 #include "minikin/HbUtils.h"
+#include "minikin/Hasher.h"
 #include "minikin/MinikinFont.h"
+#include "minikin/MinikinPaint.h"
 
-#include "FontUtils.h"
 #include "MinikinInternal.h"
 
 namespace minikin {
@@ -40,36 +45,318 @@ std::shared_ptr<Font> Font::Builder::build() {
     }
 
     HbFontUniquePtr font = prepareFont(mTypeface);
-    FontStyle styleFromFont = analyzeStyle(font);
+    // The table directory is parsed once for both the style and the axes.
+    const FontFileParser parser(font);
+    // TODO: Update weight/italic based on fvar value.
+    FontStyle styleFromFont = parser.getStyle().value_or(FontStyle());
     if (!mIsWeightSet) {
         mWeight = styleFromFont.weight();
     }
     if (!mIsSlantSet) {
         mSlant = styleFromFont.slant();
     }
-    return std::shared_ptr<Font>(new Font(std::move(mTypeface), FontStyle(mWeight, mSlant),
+    std::shared_ptr<Font> result(new Font(std::move(mTypeface), FontStyle(mWeight, mSlant),
                                           std::move(font), mLocaleListId));
+    std::call_once(result->mSupportedAxesOnce,
+                   [&]() { result->mSupportedAxes = parser.getSortedSupportedAxes(); });
+    return result;
+}
+
+namespace {
+
+// Incremented by each releaseUnusedTypefaces() call.
+std::atomic<uint32_t> gTypefaceEpoch(0);
+
+// The HarfBuzz faces shared by the fonts backed by the same font data, e.g. the variation
+// instances created by FontFamily::createFamilyWithVariation() or a font file registered in
+// several families. The tables and the accelerators HarfBuzz builds for a face, e.g. of cmap,
+// GSUB and GPOS, are then built only once. The data is identified by its address, since the same
+// file may be mapped more than once and the typefaces keep their mapping alive.
+class SharedFaceRegistry {
+public:
+    static SharedFaceRegistry& getInstance() {
+        // Never destroyed, since fonts may be destroyed while the process exits.
+        static SharedFaceRegistry* registry = new SharedFaceRegistry();
+        return *registry;
+    }
+
+    // Returns a new sub-font of the font shared by the fonts of the same data and index, which
+    // has the OpenType functions and a scale of one font unit.
+    HbFontUniquePtr createSubFont(const char* data, size_t size, uint32_t index) {
+        const Key key = {data, size, index};
+        std::shared_ptr<SharedFace> face;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mFaces.find(key);
+            if (it != mFaces.end()) {
+                face = it->second.lock();
+            }
+        }
+        if (face == nullptr) {
+            face = std::make_shared<SharedFace>(createParentFont(data, size, index));
+            std::lock_guard<std::mutex> lock(mMutex);
+            std::weak_ptr<SharedFace>& slot = mFaces[key];
+            // Another thread may have created the same face meanwhile.
+            if (std::shared_ptr<SharedFace> existing = slot.lock()) {
+                face = std::move(existing);
+            } else {
+                slot = face;
+            }
+            pruneLocked();
+        }
+        HbFontUniquePtr font(hb_font_create_sub_font(face->parent.get()));
+        // The sub-font keeps its parent alive by itself. The reference only tells the registry
+        // when the last sub-font of the face is destroyed.
+        hb_font_set_user_data(
+                font.get(), &sUserDataKey, new std::shared_ptr<SharedFace>(std::move(face)),
+                [](void* p) { delete static_cast<std::shared_ptr<SharedFace>*>(p); },
+                false /* replace */);
+        return font;
+    }
+
+    // Counts the faces of the live fonts and the size of their font data.
+    void getUsage(size_t* outFaceCount, size_t* outDataSize) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        *outFaceCount = 0;
+        *outDataSize = 0;
+        for (const auto& [key, face] : mFaces) {
+            if (!face.expired()) {
+                (*outFaceCount)++;
+                *outDataSize += key.size;
+            }
+        }
+    }
+
+private:
+    struct Key {
+        const char* data;
+        size_t size;
+        uint32_t index;
+
+        bool operator==(const Key& o) const {
+            return data == o.data && size == o.size && index == o.index;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return Hasher()
+                    .update(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key.data)))
+                    .update(static_cast<uint64_t>(key.size))
+                    .update(key.index)
+                    .hash();
+        }
+    };
+    struct SharedFace {
+        explicit SharedFace(HbFontUniquePtr&& parent) : parent(std::move(parent)) {}
+        HbFontUniquePtr parent;
+    };
+
+    static HbFontUniquePtr createParentFont(const char* data, size_t size, uint32_t index) {
+        HbBlobUniquePtr blob(
+                hb_blob_create(data, size, HB_MEMORY_MODE_READONLY, nullptr, nullptr));
+        HbFaceUniquePtr face(hb_face_create(blob.get(), index));
+        HbFontUniquePtr parent(hb_font_create(face.get()));
+        hb_ot_font_set_funcs(parent.get());
+        const uint32_t upem = hb_face_get_upem(face.get());
+        hb_font_set_scale(parent.get(), upem, upem);
+        return parent;
+    }
+
+    // Removes the faces of the destroyed fonts once the map has doubled since the last pruning,
+    // which keeps the cost of the pruning constant per face.
+    void pruneLocked() EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        if (mFaces.size() < mPruneSize) {
+            return;
+        }
+        for (auto it = mFaces.begin(); it != mFaces.end();) {
+            it = it->second.expired() ? mFaces.erase(it) : std::next(it);
+        }
+        mPruneSize = std::max(kMinPruneSize, mFaces.size() * 2);
+    }
+
+    static const size_t kMinPruneSize = 64;
+    static hb_user_data_key_t sUserDataKey;
+
+    std::mutex mMutex;
+    std::unordered_map<Key, std::weak_ptr<SharedFace>, KeyHash> mFaces GUARDED_BY(mMutex);
+    size_t mPruneSize GUARDED_BY(mMutex) = kMinPruneSize;
+};
+
+hb_user_data_key_t SharedFaceRegistry::sUserDataKey;
+
+}  // namespace
+
+class Font::LoadedFontRegistry {
+public:
+    std::mutex mutex;
+    std::unordered_set<const Font*> fonts GUARDED_BY(mutex);
+    // Released by the previous releaseUnusedTypefaces() call. Readers may still be using them.
+    std::vector<std::unique_ptr<LoadedTypeface>> retired GUARDED_BY(mutex);
+};
+
+// static
+Font::LoadedFontRegistry& Font::getLoadedFontRegistry() {
+    // Never destroyed, since fonts may be destroyed while the process exits.
+    static LoadedFontRegistry* registry = new LoadedFontRegistry();
+    return *registry;
+}
+
+Font::~Font() {
+    if (mTypefaceLoader != nullptr) {
+        LoadedFontRegistry& registry = getLoadedFontRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.fonts.erase(this);
+    }
+    delete mLoaded.load(std::memory_order_relaxed);
+}
+
+void Font::markUsed() const {
+    if (mTypefaceLoader == nullptr) {
+        return;
+    }
+    const uint32_t epoch = gTypefaceEpoch.load(std::memory_order_relaxed);
+    // Avoid writing to the shared cache line when it is already marked.
+    if (mLastUsedEpoch.load(std::memory_order_relaxed) != epoch) {
+        mLastUsedEpoch.store(epoch, std::memory_order_relaxed);
+    }
 }
 
 const std::shared_ptr<MinikinFont>& Font::typeface() const {
+    markUsed();
+    if (LoadedTypeface* loaded = mLoaded.load(std::memory_order_acquire)) {
+        return loaded->typeface;
+    }
     std::lock_guard lock(mTypefaceMutex);
-    if (mTypeface) return mTypeface;
-    initTypefaceLocked();
-    return mTypeface;
+    return loadTypefaceLocked()->typeface;
 }
 
 const HbFontUniquePtr& Font::baseFont() const {
+    return loadBaseFont()->baseFont;
+}
+
+Font::LoadedTypeface* Font::loadBaseFont() const {
+    markUsed();
+    LoadedTypeface* loaded = mLoaded.load(std::memory_order_acquire);
+    if (loaded != nullptr && loaded->isBaseFontSet.load(std::memory_order_acquire)) {
+        return loaded;
+    }
     std::lock_guard lock(mTypefaceMutex);
-    if (mBaseFont) return mBaseFont;
-    initTypefaceLocked();
-    mBaseFont = prepareFont(mTypeface);
-    return mBaseFont;
+    loaded = loadTypefaceLocked();
+    if (!loaded->isBaseFontSet.load(std::memory_order_relaxed)) {
+        loaded->baseFont = prepareFont(loaded->typeface);
+        loaded->isBaseFontSet.store(true, std::memory_order_release);
+    }
+    return loaded;
 }
 
-void Font::initTypefaceLocked() const {
-    if (mTypeface) return;
-    MINIKIN_ASSERT(mTypefaceLoader, "mTypefaceLoader should not be empty when mTypeface is null");
-    mTypeface = mTypefaceLoader(mTypefaceMetadataReader);
+bool Font::isBaseFontLoaded() const {
+    const LoadedTypeface* loaded = mLoaded.load(std::memory_order_acquire);
+    return loaded != nullptr && loaded->isBaseFontSet.load(std::memory_order_acquire);
+}
+
+// static
+void Font::releaseUnusedTypefaces() {
+    std::vector<std::unique_ptr<LoadedTypeface>> destroyed;
+    LoadedFontRegistry& registry = getLoadedFontRegistry();
+    {
+        std::lock_guard lock(registry.mutex);
+        // A reader which took one of them before the previous call has had a whole period since.
+        destroyed = std::move(registry.retired);
+        registry.retired.clear();
+        const uint32_t epoch = gTypefaceEpoch.load(std::memory_order_relaxed);
+        for (auto it = registry.fonts.begin(); it != registry.fonts.end();) {
+            const Font* font = *it;
+            // A font being loaded is in use, so don't wait for its lock.
+            if (font->mLastUsedEpoch.load(std::memory_order_relaxed) == epoch ||
+                !font->mTypefaceMutex.try_lock()) {
+                ++it;
+                continue;
+            }
+            registry.retired.emplace_back(
+                    font->mLoaded.exchange(nullptr, std::memory_order_acq_rel));
+            {
+                // The plans refer to the face of the released base font.
+                std::lock_guard planLock(font->mShapePlanMutex);
+                font->mShapePlans.clear();
+            }
+            font->mTypefaceMutex.unlock();
+            it = registry.fonts.erase(it);
+        }
+        gTypefaceEpoch.store(epoch + 1, std::memory_order_relaxed);
+    }
+    // The sub-fonts the threads reuse keep their typefaces alive.
+    invalidateSubFontCaches();
+    // Destroy the typefaces released by the previous call outside of the lock.
+    destroyed.clear();
+}
+
+// static
+void Font::getSharedFaceUsage(size_t* outFaceCount, size_t* outDataSize) {
+    SharedFaceRegistry::getInstance().getUsage(outFaceCount, outDataSize);
+}
+
+HbShapePlanUniquePtr Font::findShapePlanLocked(const LoadedTypeface* loaded,
+                                               const hb_segment_properties_t& props,
+                                               const std::vector<hb_feature_t>& features) const {
+    const auto sameFeature = [](const hb_feature_t& a, const hb_feature_t& b) {
+        return a.tag == b.tag && a.value == b.value && a.start == b.start && a.end == b.end;
+    };
+    for (const ShapePlanEntry& entry : mShapePlans) {
+        if (entry.loaded == loaded && hb_segment_properties_equal(&entry.props, &props) &&
+            std::equal(entry.features.begin(), entry.features.end(), features.begin(),
+                       features.end(), sameFeature)) {
+            return HbShapePlanUniquePtr(hb_shape_plan_reference(entry.plan.get()));
+        }
+    }
+    return nullptr;
+}
+
+HbShapePlanUniquePtr Font::getShapePlan(const hb_segment_properties_t& props,
+                                        const std::vector<hb_feature_t>& features) const {
+    const LoadedTypeface* loaded = loadBaseFont();
+    {
+        std::shared_lock lock(mShapePlanMutex);
+        if (HbShapePlanUniquePtr plan = findShapePlanLocked(loaded, props, features)) {
+            return plan;
+        }
+    }
+
+    const HbFontUniquePtr& font = loaded->baseFont;
+    unsigned int coordsCount = 0;
+    const int* coords = hb_font_get_var_coords_normalized(font.get(), &coordsCount);
+    HbShapePlanUniquePtr plan(hb_shape_plan_create_cached2(
+            hb_font_get_face(font.get()), &props, features.empty() ? nullptr : features.data(),
+            features.size(), coords, coordsCount, nullptr /* shaper_list */));
+    std::lock_guard lock(mShapePlanMutex);
+    // Another thread may have created the same plan in the meantime.
+    if (HbShapePlanUniquePtr existing = findShapePlanLocked(loaded, props, features)) {
+        return existing;
+    }
+    // releaseUnusedTypefaces() may have released the typeface and dropped its plans meanwhile.
+    if (mLoaded.load(std::memory_order_acquire) != loaded) {
+        return plan;
+    }
+    if (mShapePlans.size() == kMaxShapePlans) {
+        // Callers may still be using the evicted plan, which is kept alive by their reference.
+        mShapePlans.erase(mShapePlans.begin());
+    }
+    mShapePlans.push_back({loaded, props, features,
+                           HbShapePlanUniquePtr(hb_shape_plan_reference(plan.get()))});
+    return plan;
+}
+
+Font::LoadedTypeface* Font::loadTypefaceLocked() const {
+    LoadedTypeface* loaded = mLoaded.load(std::memory_order_relaxed);
+    if (loaded != nullptr) return loaded;
+    MINIKIN_ASSERT(mTypefaceLoader, "mTypefaceLoader should not be empty when mLoaded is null");
+    loaded = new LoadedTypeface{mTypefaceLoader(mTypefaceMetadataReader), nullptr, false};
+    mLoaded.store(loaded, std::memory_order_release);
+    mLastUsedEpoch.store(gTypefaceEpoch.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+    LoadedFontRegistry& registry = getLoadedFontRegistry();
+    std::lock_guard lock(registry.mutex);
+    registry.fonts.insert(this);
+    return loaded;
 }
 
 // static
@@ -78,15 +365,9 @@ HbFontUniquePtr Font::prepareFont(const std::shared_ptr<MinikinFont>& typeface)
     size_t size = typeface->GetFontSize();
     uint32_t ttcIndex = typeface->GetFontIndex();
 
-    HbBlobUniquePtr blob(hb_blob_create(buf, size, HB_MEMORY_MODE_READONLY, nullptr, nullptr));
-    HbFaceUniquePtr face(hb_face_create(blob.get(), ttcIndex));
-    HbFontUniquePtr parent(hb_font_create(face.get()));
-    hb_ot_font_set_funcs(parent.get());
-
-    uint32_t upem = hb_face_get_upem(face.get());
-    hb_font_set_scale(parent.get(), upem, upem);
-
-    HbFontUniquePtr font(hb_font_create_sub_font(parent.get()));
+    // The variations are set on the sub-font, so that the instances of a variable font share
+    // the face.
+    HbFontUniquePtr font = SharedFaceRegistry::getInstance().createSubFont(buf, size, ttcIndex);
     std::vector<hb_variation_t> variations;
     variations.reserve(typeface->GetAxes().size());
     for (const FontVariation& variation : typeface->GetAxes()) {
@@ -96,30 +377,85 @@ HbFontUniquePtr Font::prepareFont(const std::shared_ptr<MinikinFont>& typeface)
     return font;
 }
 
+MinikinExtent Font::getExtent(const MinikinPaint& paint, FontFakery fakery) const {
+    {
+        std::lock_guard lock(mExtentMutex);
+        for (const ExtentEntry& entry : mExtents) {
+            if (entry.size == paint.size && entry.scaleX == paint.scaleX &&
+                entry.skewX == paint.skewX && entry.fontFlags == paint.fontFlags &&
+                entry.fakery == fakery) {
+                return entry.extent;
+            }
+        }
+    }
+
+    // Not computed under the lock, which would serialize the typefaces of all the threads.
+    MinikinExtent extent;
+    typeface()->GetFontExtent(&extent, paint, fakery);
+    std::lock_guard lock(mExtentMutex);
+    if (mExtents.size() == kMaxExtents) {
+        mExtents.erase(mExtents.begin());
+    }
+    mExtents.push_back({paint.size, paint.scaleX, paint.skewX, paint.fontFlags, fakery, extent});
+    return extent;
+}
+
+const Font::SimpleGlyphs& Font::getSimpleGlyphs() const {
+    std::call_once(mSimpleGlyphsOnce, [this] { mSimpleGlyphs = analyzeSimpleGlyphs(baseFont()); });
+    return *mSimpleGlyphs;
+}
+
 // static
-FontStyle Font::analyzeStyle(const HbFontUniquePtr& font) {
-    HbBlob os2Table(font, MinikinFont::MakeTag('O', 'S', '/', '2'));
-    if (!os2Table) {
-        return FontStyle();
+std::unique_ptr<Font::SimpleGlyphs> Font::analyzeSimpleGlyphs(const HbFontUniquePtr& font) {
+    std::unique_ptr<SimpleGlyphs> result = std::make_unique<SimpleGlyphs>();
+    result->glyphs.fill(0);
+
+    // HarfBuzz applies these tables on top of, or instead of, GSUB and GPOS.
+    for (uint32_t tag : {HB_TAG('k', 'e', 'r', 'n'), HB_TAG('k', 'e', 'r', 'x'),
+                         HB_TAG('m', 'o', 'r', 't'), HB_TAG('m', 'o', 'r', 'x'),
+                         HB_TAG('t', 'r', 'a', 'k')}) {
+        if (HbBlob(font, tag)) {
+            return result;
+        }
     }
 
-    int weight;
-    bool italic;
-    if (!::minikin::analyzeStyle(os2Table.get(), os2Table.size(), &weight, &italic)) {
-        return FontStyle();
+    // The glyphs that any lookup matches, as input or as context, whichever the features are.
+    hb_face_t* face = hb_font_get_face(font.get());
+    HbSetUniquePtr involved(hb_set_create());
+    for (hb_tag_t table : {HB_OT_TAG_GSUB, HB_OT_TAG_GPOS}) {
+        const unsigned int lookupCount = hb_ot_layout_table_get_lookup_count(face, table);
+        for (unsigned int i = 0; i < lookupCount; ++i) {
+            hb_ot_layout_lookup_collect_glyphs(face, table, i, involved.get(), involved.get(),
+                                               involved.get(), nullptr /* glyphs_output */);
+        }
     }
-    // TODO: Update weight/italic based on fvar value.
-    return FontStyle(static_cast<uint16_t>(weight), static_cast<FontStyle::Slant>(italic));
+
+    for (uint32_t c = SimpleGlyphs::kFirstChar; c <= SimpleGlyphs::kLastChar; ++c) {
+        // The C1 controls and U+00AD SOFT HYPHEN are handled specially by HarfBuzz.
+        if ((c >= 0x7F && c <= 0x9F) || c == 0xAD) {
+            continue;
+        }
+        hb_codepoint_t glyph = 0;
+        if (!hb_font_get_nominal_glyph(font.get(), c, &glyph) || glyph == 0 ||
+            glyph > UINT16_MAX || hb_set_has(involved.get(), glyph) ||
+            hb_ot_layout_get_glyph_class(face, glyph) == HB_OT_LAYOUT_GLYPH_CLASS_MARK) {
+            continue;
+        }
+        result->glyphs[c - SimpleGlyphs::kFirstChar] = glyph;
+    }
+    return result;
 }
 
 std::unordered_set<AxisTag> Font::getSupportedAxes() const {
-    HbBlob fvarTable(baseFont(), MinikinFont::MakeTag('f', 'v', 'a', 'r'));
-    if (!fvarTable) {
-        return std::unordered_set<AxisTag>();
-    }
-    std::unordered_set<AxisTag> supportedAxes;
-    analyzeAxes(fvarTable.get(), fvarTable.size(), &supportedAxes);
-    return supportedAxes;
+    const std::vector<AxisTag>& axes = getSortedSupportedAxes();
+    return std::unordered_set<AxisTag>(axes.begin(), axes.end());
+}
+
+const std::vector<AxisTag>& Font::getSortedSupportedAxes() const {
+    std::call_once(mSupportedAxesOnce, [this]() {
+        mSupportedAxes = FontFileParser(baseFont()).getSortedSupportedAxes();
+    });
+    return mSupportedAxes;
 }
 
 }  // namespace minikin
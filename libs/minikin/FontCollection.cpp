@@ -19,16 +19,25 @@
 #include "minikin/FontCollection.h"
 
 #include <algorithm>
+#include <mutex>
 
 #include <log/log.h>
 #include <unicode/unorm2.h>
+#include <utils/LruCache.h>
 
 #include "minikin/Emoji.h"
+#include "minikin/Executor.h"
 #include "minikin/FontFileParser.h"
+#include "minikin/Hasher.h"
 
+#include "CodeUnitScan.h"
+#include "EmojiSequence.h"
+#include "LatencyStats.h"
 #include "Locale.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "ParallelFor.h"
+#include "TraceSpan.h"
 
 using std::vector;
 
@@ -44,6 +53,9 @@ const uint32_t TEXT_STYLE_VS = 0xFE0E;
 
 static std::atomic<uint32_t> gNextCollectionId = {0};
 
+constexpr uint16_t kFirstPrintableAscii = 0x0020;
+constexpr uint16_t kLastPrintableAscii = 0x007E;
+
 namespace {
 
 uint32_t getGlyphCount(U16StringPiece text, uint32_t start, uint32_t end,
@@ -61,19 +73,412 @@ uint32_t getGlyphCount(U16StringPiece text, uint32_t start, uint32_t end,
 
 }  // namespace
 
+namespace {
+
+// The key of the itemize cache. The text is shared between the copies of the key, and is only
+// owned once it is stored in the cache.
+class ItemizeKey {
+public:
+    ItemizeKey(U16StringPiece text, uint32_t localeListId, FamilyVariant variant, uint32_t runMax)
+            : mChars(text.data()),
+              mLength(text.size()),
+              mLocaleListId(localeListId),
+              mVariant(variant),
+              mRunMax(runMax),
+              mHash(Hasher()
+                            .updateShorts(text.data(), text.size())
+                            .update(localeListId)
+                            .update(static_cast<uint32_t>(variant))
+                            .update(runMax)
+                            .hash()) {}
+
+    void copyText() {
+        mOwnedText = std::make_shared<std::vector<uint16_t>>(mChars, mChars + mLength);
+        mChars = mOwnedText->data();
+    }
+
+    size_t getMemoryUsage() const {
+        return sizeof(ItemizeKey) + (mOwnedText ? sizeof(uint16_t) * mOwnedText->capacity() : 0);
+    }
+
+    bool operator==(const ItemizeKey& o) const {
+        return mHash == o.mHash && mLength == o.mLength && mLocaleListId == o.mLocaleListId &&
+               mVariant == o.mVariant && mRunMax == o.mRunMax &&
+               (mChars == o.mChars || memcmp(mChars, o.mChars, mLength * sizeof(uint16_t)) == 0);
+    }
+
+    android::hash_t hash() const { return mHash; }
+
+private:
+    const uint16_t* mChars;
+    std::shared_ptr<std::vector<uint16_t>> mOwnedText;  // null for the lookup keys.
+    uint32_t mLength;
+    uint32_t mLocaleListId;
+    FamilyVariant mVariant;
+    uint32_t mRunMax;
+    android::hash_t mHash;
+};
+
+inline android::hash_t hash_type(const ItemizeKey& key) {
+    return key.hash();
+}
+
+// The key of the variation cache, i.e. the variations of the supported axes sorted by the axis.
+class VariationKey {
+public:
+    VariationKey() : mHash(0) {}
+
+    VariationKey(const std::vector<FontVariation>& variations,
+                 const std::vector<AxisTag>& supportedAxes) {
+        for (const FontVariation& variation : variations) {
+            if (std::binary_search(supportedAxes.begin(), supportedAxes.end(),
+                                   variation.axisTag)) {
+                mVariations.push_back(variation);
+            }
+        }
+        // Keep the order of the same axis, so that the same one wins when they are applied.
+        std::stable_sort(mVariations.begin(), mVariations.end(),
+                         [](const FontVariation& l, const FontVariation& r) {
+                             return l.axisTag < r.axisTag;
+                         });
+        Hasher hasher;
+        for (const FontVariation& variation : mVariations) {
+            hasher.update(variation.axisTag).update(variation.value);
+        }
+        mHash = hasher.hash();
+    }
+
+    const std::vector<FontVariation>& variations() const { return mVariations; }
+
+    bool operator==(const VariationKey& o) const {
+        return mHash == o.mHash &&
+               std::equal(mVariations.begin(), mVariations.end(), o.mVariations.begin(),
+                          o.mVariations.end(), [](const FontVariation& l, const FontVariation& r) {
+                              return l.axisTag == r.axisTag && l.value == r.value;
+                          });
+    }
+
+    android::hash_t hash() const { return mHash; }
+
+private:
+    std::vector<FontVariation> mVariations;
+    android::hash_t mHash;
+};
+
+inline android::hash_t hash_type(const VariationKey& key) {
+    return key.hash();
+}
+
+// Sorts the axes in ascending order and removes the duplicates.
+void sortAxes(std::vector<AxisTag>* axes) {
+    std::sort(axes->begin(), axes->end());
+    axes->erase(std::unique(axes->begin(), axes->end()), axes->end());
+    axes->shrink_to_fit();
+}
+
+}  // namespace
+
+class FontCollection::ItemizeCache {
+public:
+    ItemizeCache() : mCache(kMaxEntries) {}
+
+    // Returns true and appends the cached runs to out if found.
+    bool get(const ItemizeKey& key, std::vector<Run>* out) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const std::vector<Run>& runs = mCache.get(key);
+        if (runs.empty()) {
+            // Empty results are not stored, so this is the null value of the cache.
+            mStats.miss();
+            return false;
+        }
+        mStats.hit();
+        out->insert(out->end(), runs.begin(), runs.end());
+        return true;
+    }
+
+    void put(ItemizeKey&& key, const std::vector<Run>& runs) {
+        key.copyText();
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mCache.size() >= kMaxEntries) {
+            mStats.evict();
+        }
+        mCache.put(key, runs);
+        mStats.insert();
+    }
+
+    const CacheStats& getStats() const { return mStats; }
+
+    size_t getMemoryUsage() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t result = sizeof(ItemizeCache);
+        android::LruCache<ItemizeKey, std::vector<Run>>::Iterator it(mCache);
+        while (it.next()) {
+            result += it.key().getMemoryUsage() + sizeof(std::vector<Run>) +
+                      sizeof(Run) * it.value().capacity();
+        }
+        return result;
+    }
+
+private:
+    // The number of the entries per collection. Most layouts only use a few collections.
+    static constexpr uint32_t kMaxEntries = 32;
+
+    android::LruCache<ItemizeKey, std::vector<Run>> mCache GUARDED_BY(mMutex);
+    CacheStats mStats;
+    std::mutex mMutex;
+};
+
+class FontCollection::VariationCache {
+public:
+    VariationCache() : mCache(kMaxEntries) {}
+
+    // Returns nullptr if not found.
+    std::shared_ptr<FontCollection> get(const VariationKey& key) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::shared_ptr<FontCollection> collection = mCache.get(key);
+        if (collection == nullptr) {
+            mStats.miss();
+        } else {
+            mStats.hit();
+        }
+        return collection;
+    }
+
+    void put(const VariationKey& key, const std::shared_ptr<FontCollection>& collection) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mCache.size() >= kMaxEntries) {
+            mStats.evict();
+        }
+        mCache.put(key, collection);
+        mStats.insert();
+    }
+
+    const CacheStats& getStats() const { return mStats; }
+
+    size_t getMemoryUsage() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t result = sizeof(VariationCache);
+        android::LruCache<VariationKey, std::shared_ptr<FontCollection>>::Iterator it(mCache);
+        while (it.next()) {
+            result += sizeof(VariationKey) +
+                      sizeof(FontVariation) * it.key().variations().capacity() +
+                      sizeof(std::shared_ptr<FontCollection>) + it.value()->getMemoryUsage();
+        }
+        return result;
+    }
+
+private:
+    // An animation of the axes creates a new setting every frame, thus only a few of the recent
+    // ones are worth keeping.
+    static constexpr uint32_t kMaxEntries = 8;
+
+    android::LruCache<VariationKey, std::shared_ptr<FontCollection>> mCache GUARDED_BY(mMutex);
+    CacheStats mStats;
+    std::mutex mMutex;
+};
+
+// The results of getFamilyForChar without variation selector, for the BMP code points. A page of
+// 256 code points is allocated when one of them is first looked up, and each entry is computed
+// on its first lookup. The readers don't take a lock. The entries and the pages are never
+// removed, since the collection is immutable.
+class FontCollection::FallbackTable {
+public:
+    FallbackTable(std::atomic<uint32_t>* pageBudget) : mPageBudget(pageBudget) {
+        for (std::atomic<Page*>& page : mPages) {
+            page.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~FallbackTable() {
+        for (std::atomic<Page*>& page : mPages) {
+            delete page.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the entry of the code point, or nullptr if it is not in the BMP or the collection
+    // ran out of its page budget. An empty result means it is not computed yet, since
+    // getFamilyForChar never returns an empty result.
+    std::atomic<FamilyMatchResult>* getEntry(uint32_t ch) {
+        if (ch >= kPageCount * kCharsPerPage) {
+            return nullptr;
+        }
+        std::atomic<Page*>& slot = mPages[ch >> kLogCharsPerPage];
+        Page* page = slot.load(std::memory_order_acquire);
+        if (page == nullptr) {
+            page = allocatePage(&slot);
+            if (page == nullptr) {
+                return nullptr;
+            }
+        }
+        return &page->entries[ch & kPageMask];
+    }
+
+    size_t getMemoryUsage() const {
+        size_t result = sizeof(FallbackTable);
+        for (const std::atomic<Page*>& page : mPages) {
+            if (page.load(std::memory_order_relaxed) != nullptr) {
+                result += sizeof(Page);
+            }
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint32_t kCharsPerPage = 1 << kLogCharsPerPage;
+    static constexpr uint32_t kPageCount = 0x10000 / kCharsPerPage;
+
+    struct Page {
+        Page() {
+            for (std::atomic<FamilyMatchResult>& entry : entries) {
+                entry.store(FamilyMatchResult(), std::memory_order_relaxed);
+            }
+        }
+        std::atomic<FamilyMatchResult> entries[kCharsPerPage];
+    };
+
+    Page* allocatePage(std::atomic<Page*>* slot) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Page* page = slot->load(std::memory_order_relaxed);
+        if (page != nullptr) {
+            return page;  // Allocated by another thread.
+        }
+        uint32_t budget = mPageBudget->load(std::memory_order_relaxed);
+        do {
+            if (budget == 0) {
+                return nullptr;
+            }
+        } while (!mPageBudget->compare_exchange_weak(budget, budget - 1,
+                                                     std::memory_order_relaxed));
+        page = new Page();
+        slot->store(page, std::memory_order_release);
+        return page;
+    }
+
+    std::atomic<uint32_t>* mPageBudget;  // Shared by the tables of the collection.
+    std::atomic<Page*> mPages[kPageCount];
+    std::mutex mMutex;
+};
+
+// The locale matching scores of the families for one locale list, which only depend on the list
+// and the family. Each score is computed on its first lookup and the readers don't take a lock.
+class FontCollection::LocaleScores {
+public:
+    explicit LocaleScores(uint32_t localeListId)
+            : mLocaleListId(localeListId),
+              mEmojiStyle(LocaleListCache::getById(localeListId).getEmojiStyle()) {
+        for (std::atomic<uint32_t>& score : mScores) {
+            score.store(kUnknownScore, std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t localeListId() const { return mLocaleListId; }
+    EmojiStyle emojiStyle() const { return mEmojiStyle; }
+
+    uint32_t get(uint8_t familyIndex, const FontFamily& family) {
+        std::atomic<uint32_t>& entry = mScores[familyIndex];
+        uint32_t score = entry.load(std::memory_order_relaxed);
+        if (score == kUnknownScore) {
+            // Racing threads compute the same value.
+            score = calcLocaleMatchingScore(mLocaleListId, family);
+            entry.store(score, std::memory_order_relaxed);
+        }
+        return score;
+    }
+
+private:
+    // The scores are less than 5^FONT_LOCALE_LIMIT, which fits in the 28 bits of the family score.
+    static constexpr uint32_t kUnknownScore = 0xFFFFFFFF;
+
+    const uint32_t mLocaleListId;
+    const EmojiStyle mEmojiStyle;
+    std::atomic<uint32_t> mScores[MAX_FAMILY_COUNT];
+};
+
+class FontCollection::FallbackTables {
+public:
+    FallbackTables() : mPageBudget(kMaxPages) {}
+
+    // Returns the table for the locale list and the variant, or nullptr if there are already
+    // too many tables.
+    FallbackTable* get(uint32_t localeListId, FamilyVariant variant) {
+        const uint64_t key = (static_cast<uint64_t>(localeListId) << 8) |
+                             static_cast<uint64_t>(static_cast<uint8_t>(variant));
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& [tableKey, table] : mTables) {
+            if (tableKey == key) {
+                return table.get();
+            }
+        }
+        if (mTables.size() >= kMaxTables) {
+            return nullptr;
+        }
+        mTables.emplace_back(key, std::make_unique<FallbackTable>(&mPageBudget));
+        return mTables.back().second.get();
+    }
+
+    // Returns the locale scores of the locale list, or nullptr if there are already too many.
+    LocaleScores* getLocaleScores(uint32_t localeListId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const std::unique_ptr<LocaleScores>& scores : mLocaleScores) {
+            if (scores->localeListId() == localeListId) {
+                return scores.get();
+            }
+        }
+        if (mLocaleScores.size() >= kMaxTables) {
+            return nullptr;
+        }
+        mLocaleScores.push_back(std::make_unique<LocaleScores>(localeListId));
+        return mLocaleScores.back().get();
+    }
+
+    size_t getMemoryUsage() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t result = sizeof(FallbackTables) +
+                        sizeof(std::pair<uint64_t, std::unique_ptr<FallbackTable>>) *
+                                mTables.capacity() +
+                        sizeof(std::unique_ptr<LocaleScores>) * mLocaleScores.capacity() +
+                        sizeof(LocaleScores) * mLocaleScores.size();
+        for (const auto& [key, table] : mTables) {
+            result += table->getMemoryUsage();
+        }
+        return result;
+    }
+
+private:
+    // A page is 2KB on 64-bit, so a collection uses at most 128KB for its tables.
+    static constexpr uint32_t kMaxPages = 64;
+    static constexpr size_t kMaxTables = 8;
+
+    std::atomic<uint32_t> mPageBudget;
+    std::vector<std::pair<uint64_t, std::unique_ptr<FallbackTable>>> mTables GUARDED_BY(mMutex);
+    std::vector<std::unique_ptr<LocaleScores>> mLocaleScores GUARDED_BY(mMutex);
+    std::mutex mMutex;
+};
+
 FontCollection::FontCollection(std::shared_ptr<FontFamily>&& typeface) : mMaxChar(0) {
     std::vector<std::shared_ptr<FontFamily>> typefaces;
     typefaces.push_back(typeface);
-    init(typefaces);
+    init(typefaces, 1);
 }
 
 FontCollection::FontCollection(const vector<std::shared_ptr<FontFamily>>& typefaces) : mMaxChar(0) {
-    init(typefaces);
+    init(typefaces, 1);
+}
+
+FontCollection::FontCollection(const vector<std::shared_ptr<FontFamily>>& typefaces,
+                               uint32_t threadCount)
+        : mMaxChar(0) {
+    init(typefaces, threadCount);
 }
 
-void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces) {
+FontCollection::~FontCollection() {}
+
+void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces,
+                          uint32_t threadCount) {
     mId = gNextCollectionId++;
-    vector<uint32_t> lastChar;
+    mItemizeCache = std::make_unique<ItemizeCache>();
+    mFallbackTables = std::make_unique<FallbackTables>();
+    mVariationCache = std::make_unique<VariationCache>();
     size_t nTypefaces = typefaces.size();
     const FontStyle defaultStyle;
     for (size_t i = 0; i < nTypefaces; i++) {
@@ -87,11 +492,11 @@ void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces)
             mVSFamilyVec.push_back(family);
         }
         mMaxChar = max(mMaxChar, coverage.length());
-        lastChar.push_back(coverage.nextSetBit(0));
 
-        const std::unordered_set<AxisTag>& supportedAxes = family->supportedAxes();
-        mSupportedAxes.insert(supportedAxes.begin(), supportedAxes.end());
+        const std::vector<AxisTag> supportedAxes = family->getSortedSupportedAxes();
+        mSupportedAxes.insert(mSupportedAxes.end(), supportedAxes.begin(), supportedAxes.end());
     }
+    sortAxes(&mSupportedAxes);
     nTypefaces = mFamilies.size();
     MINIKIN_ASSERT(nTypefaces > 0, "Font collection must have at least one valid typeface");
     MINIKIN_ASSERT(nTypefaces <= MAX_FAMILY_COUNT,
@@ -101,31 +506,170 @@ void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces)
     // A font can have a glyph for a base code point and variation selector pair but no glyph for
     // the base code point without variation selector. The family won't be listed in the range in
     // this case.
-    mOwnedRanges = std::make_unique<Range[]>(nPages);
-    mRanges = mOwnedRanges.get();
-    mRangesCount = nPages;
-    for (size_t i = 0; i < nPages; i++) {
-        Range* range = &mOwnedRanges[i];
-        range->start = mOwnedFamilyVec.size();
-        for (size_t j = 0; j < nTypefaces; j++) {
+    std::unique_ptr<Range[]> pageRanges = std::make_unique<Range[]>(nPages);
+    std::vector<uint8_t> familyVec;
+    const uint32_t workerCount =
+            std::max(1u, std::min<uint32_t>(threadCount, nPages / kMinPagesPerThread));
+    if (workerCount == 1) {
+        buildRanges(mFamilies, 0, nPages, pageRanges.get(), &familyVec);
+    } else {
+        // Each worker builds a consecutive block of pages, and the blocks are concatenated in the
+        // page order so that the tables are the same as the serially built ones.
+        const uint32_t pagesPerWorker = (nPages + workerCount - 1) / workerCount;
+        std::vector<std::vector<uint8_t>> familyVecs(workerCount);
+        parallelFor(workerCount, workerCount, [&](size_t i) {
+            const uint32_t firstPage = std::min<uint32_t>(i * pagesPerWorker, nPages);
+            const uint32_t lastPage = std::min<uint32_t>(firstPage + pagesPerWorker, nPages);
+            buildRanges(mFamilies, firstPage, lastPage, &pageRanges[firstPage], &familyVecs[i]);
+        });
+        for (uint32_t i = 0; i < workerCount; ++i) {
+            const uint32_t firstPage = std::min<uint32_t>(i * pagesPerWorker, nPages);
+            const uint32_t lastPage = std::min<uint32_t>(firstPage + pagesPerWorker, nPages);
+            const size_t offset = familyVec.size();
+            for (uint32_t page = firstPage; page < lastPage; ++page) {
+                pageRanges[page].start += offset;
+                pageRanges[page].end += offset;
+            }
+            familyVec.insert(familyVec.end(), familyVecs[i].begin(), familyVecs[i].end());
+        }
+    }
+    // See the comment in Range for more details.
+    LOG_ALWAYS_FATAL_IF(familyVec.size() >= 0xFFFF,
+                        "Exceeded the maximum indexable cmap coverage.");
+    compressRanges(pageRanges.get(), nPages, familyVec);
+    mFirstFamilyCoversPrintableAscii = firstFamilyCoversPrintableAscii();
+    initVSCoverage();
+}
+
+// The coverage of each variation selector is the union of the coverages of the families.
+void FontCollection::initVSCoverage() {
+    size_t vsCount = 0;
+    for (const std::shared_ptr<FontFamily>& family : mVSFamilyVec) {
+        vsCount = std::max(vsCount, family->getVSCoverage().size());
+    }
+    mVSCoverage.resize(vsCount);
+    for (const std::shared_ptr<FontFamily>& family : mVSFamilyVec) {
+        const std::vector<std::unique_ptr<SparseBitSet>>& coverage = family->getVSCoverage();
+        for (size_t vsIndex = 0; vsIndex < coverage.size(); ++vsIndex) {
+            if (coverage[vsIndex] == nullptr) {
+                continue;
+            }
+            if (mVSCoverage[vsIndex] == nullptr) {
+                mVSCoverage[vsIndex] = std::make_unique<SparseBitSet>();
+            }
+            mVSCoverage[vsIndex]->unionWith(*coverage[vsIndex]);
+        }
+    }
+}
+
+// static
+void FontCollection::buildRanges(const std::vector<std::shared_ptr<FontFamily>>& families,
+                                 uint32_t firstPage, uint32_t lastPage, Range* ranges,
+                                 std::vector<uint8_t>* familyVec) {
+    std::vector<uint32_t> lastChar;
+    lastChar.reserve(families.size());
+    for (const std::shared_ptr<FontFamily>& family : families) {
+        lastChar.push_back(family->getCoverage().nextSetBit(firstPage << kLogCharsPerPage));
+    }
+    for (uint32_t i = firstPage; i < lastPage; i++) {
+        Range* range = &ranges[i - firstPage];
+        range->start = familyVec->size();
+        for (size_t j = 0; j < families.size(); j++) {
             if (lastChar[j] < (i + 1) << kLogCharsPerPage) {
-                const std::shared_ptr<FontFamily>& family = mFamilies[j];
-                mOwnedFamilyVec.push_back(static_cast<uint8_t>(j));
+                const std::shared_ptr<FontFamily>& family = families[j];
+                familyVec->push_back(static_cast<uint8_t>(j));
                 uint32_t nextChar = family->getCoverage().nextSetBit((i + 1) << kLogCharsPerPage);
                 lastChar[j] = nextChar;
             }
         }
-        range->end = mOwnedFamilyVec.size();
+        range->end = familyVec->size();
     }
-    // See the comment in Range for more details.
-    LOG_ALWAYS_FATAL_IF(mOwnedFamilyVec.size() >= 0xFFFF,
-                        "Exceeded the maximum indexable cmap coverage.");
+}
+
+void FontCollection::compressRanges(const Range* pageRanges, uint32_t pageCount,
+                                    const std::vector<uint8_t>& familyVec) {
+    const auto sameRanges = [](const Range* a, const Range* b, uint32_t count) {
+        return std::equal(a, a + count, b, [](const Range& x, const Range& y) {
+            return x.start == y.start && x.end == y.end;
+        });
+    };
+    // The family lists and the blocks by their hash. An entry colliding with a different one of
+    // the same hash is stored again, which is rare and only costs memory.
+    std::unordered_map<uint32_t, Range> lists;
+    std::unordered_map<uint32_t, uint16_t> blocks;
+    const uint32_t blockCount = (pageCount + kPagesPerBlock - 1) >> kLogPagesPerBlock;
+    mOwnedBlockIndices.resize(blockCount);
+    mOwnedRanges.clear();
+    mOwnedFamilyVec.clear();
+    for (uint32_t block = 0; block < blockCount; ++block) {
+        // The pages past the last one are empty.
+        Range rows[kPagesPerBlock] = {};
+        Hasher blockHasher;
+        for (uint32_t i = 0; i < kPagesPerBlock; ++i) {
+            const uint32_t page = (block << kLogPagesPerBlock) + i;
+            if (page < pageCount && pageRanges[page].start < pageRanges[page].end) {
+                const uint8_t* families = familyVec.data() + pageRanges[page].start;
+                const uint16_t length = pageRanges[page].end - pageRanges[page].start;
+                const uint32_t hash = Hasher()
+                                              .updateBytes(reinterpret_cast<const char*>(families),
+                                                           length)
+                                              .hash();
+                auto [it, inserted] = lists.emplace(hash, Range());
+                if (!inserted && it->second.end - it->second.start == length &&
+                    std::equal(families, families + length,
+                               mOwnedFamilyVec.begin() + it->second.start)) {
+                    rows[i] = it->second;
+                } else {
+                    rows[i] = {static_cast<uint16_t>(mOwnedFamilyVec.size()),
+                               static_cast<uint16_t>(mOwnedFamilyVec.size() + length)};
+                    mOwnedFamilyVec.insert(mOwnedFamilyVec.end(), families, families + length);
+                    if (inserted) {
+                        it->second = rows[i];
+                    }
+                }
+            }
+            blockHasher.update(rows[i].start).update(rows[i].end);
+        }
+        auto [it, inserted] = blocks.emplace(blockHasher.hash(), 0);
+        if (!inserted && sameRanges(rows, &mOwnedRanges[it->second], kPagesPerBlock)) {
+            mOwnedBlockIndices[block] = it->second;
+            continue;
+        }
+        mOwnedBlockIndices[block] = mOwnedRanges.size();
+        if (inserted) {
+            it->second = mOwnedBlockIndices[block];
+        }
+        mOwnedRanges.insert(mOwnedRanges.end(), rows, rows + kPagesPerBlock);
+    }
+    mOwnedBlockIndices.shrink_to_fit();
+    mOwnedRanges.shrink_to_fit();
+    mOwnedFamilyVec.shrink_to_fit();
+    mBlockIndices = mOwnedBlockIndices.data();
+    mBlockIndicesCount = mOwnedBlockIndices.size();
+    mRanges = mOwnedRanges.data();
+    mRangesCount = mOwnedRanges.size();
     mFamilyVec = mOwnedFamilyVec.data();
     mFamilyVecCount = mOwnedFamilyVec.size();
 }
 
+bool FontCollection::firstFamilyCoversPrintableAscii() const {
+    if (mFamilies.empty()) {
+        return false;
+    }
+    const SparseBitSet& coverage = mFamilies[0]->getCoverage();
+    for (uint32_t c = kFirstPrintableAscii; c <= kLastPrintableAscii; ++c) {
+        if (!coverage.get(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 FontCollection::FontCollection(BufferReader* reader,
-                               const std::vector<std::shared_ptr<FontFamily>>& families) {
+                               const std::vector<std::shared_ptr<FontFamily>>& families)
+        : mItemizeCache(std::make_unique<ItemizeCache>()),
+          mFallbackTables(std::make_unique<FallbackTables>()),
+          mVariationCache(std::make_unique<VariationCache>()) {
     mId = gNextCollectionId++;
     mMaxChar = reader->read<uint32_t>();
     uint32_t familiesCount = reader->read<uint32_t>();
@@ -143,10 +687,77 @@ FontCollection::FontCollection(BufferReader* reader,
     }
     // Range is two packed uint16_t
     static_assert(sizeof(Range) == 4);
+    std::tie(mBlockIndices, mBlockIndicesCount) = reader->readArray<uint16_t>();
     std::tie(mRanges, mRangesCount) = reader->readArray<Range>();
     std::tie(mFamilyVec, mFamilyVecCount) = reader->readArray<uint8_t>();
     const auto& [axesPtr, axesCount] = reader->readArray<AxisTag>();
-    mSupportedAxes.insert(axesPtr, axesPtr + axesCount);
+    // Written in ascending order by writeTo().
+    mSupportedAxes.assign(axesPtr, axesPtr + axesCount);
+    mFirstFamilyCoversPrintableAscii = firstFamilyCoversPrintableAscii();
+    initVSCoverage();
+}
+
+FontCollection::FontCollection(const FontCollection& parent,
+                               const std::vector<std::shared_ptr<FontFamily>>& families)
+        : mMaxChar(parent.mMaxChar),
+          mFamilies(parent.mFamilies),
+          mVSFamilyVec(parent.mVSFamilyVec),
+          mSupportedAxes(parent.mSupportedAxes),
+          mFirstFamilyCoversPrintableAscii(parent.mFirstFamilyCoversPrintableAscii),
+          mAncestors(parent.mAncestors),
+          mItemizeCache(std::make_unique<ItemizeCache>()),
+          mFallbackTables(std::make_unique<FallbackTables>()),
+          mVariationCache(std::make_unique<VariationCache>()) {
+    mId = gNextCollectionId++;
+    const uint32_t parentFamilyCount = parent.mFamilies.size();
+    mAncestors.push_back({parent.mId, parentFamilyCount});
+    const FontStyle defaultStyle;
+    for (const std::shared_ptr<FontFamily>& family : families) {
+        if (family->getClosestMatch(defaultStyle).font == nullptr) {
+            continue;
+        }
+        mFamilies.push_back(family);
+        if (family->hasVSTable()) {
+            mVSFamilyVec.push_back(family);
+        }
+        mMaxChar = max(mMaxChar, family->getCoverage().length());
+
+        const std::vector<AxisTag> supportedAxes = family->getSortedSupportedAxes();
+        mSupportedAxes.insert(mSupportedAxes.end(), supportedAxes.begin(), supportedAxes.end());
+    }
+    sortAxes(&mSupportedAxes);
+    MINIKIN_ASSERT(mFamilies.size() <= MAX_FAMILY_COUNT,
+                   "Font collection may only have up to %d font families.", MAX_FAMILY_COUNT);
+
+    // The families of a page are the ones of the parent followed by the new ones covering the
+    // page, which is what init() builds, so only the coverage of the new families is scanned.
+    const uint32_t nPages = (mMaxChar + kPageMask) >> kLogCharsPerPage;
+    const std::vector<std::shared_ptr<FontFamily>> newFamilies(
+            mFamilies.begin() + parentFamilyCount, mFamilies.end());
+    std::unique_ptr<Range[]> newRanges = std::make_unique<Range[]>(nPages);
+    std::vector<uint8_t> newFamilyVec;
+    buildRanges(newFamilies, 0, nPages, newRanges.get(), &newFamilyVec);
+
+    const uint32_t parentPageCount = (parent.mMaxChar + kPageMask) >> kLogCharsPerPage;
+    std::unique_ptr<Range[]> pageRanges = std::make_unique<Range[]>(nPages);
+    std::vector<uint8_t> familyVec;
+    familyVec.reserve(parent.mFamilyVecCount + newFamilyVec.size());
+    for (uint32_t page = 0; page < nPages; ++page) {
+        const size_t start = familyVec.size();
+        if (page < parentPageCount) {
+            const Range& range = parent.getRange(page);
+            familyVec.insert(familyVec.end(), parent.mFamilyVec + range.start,
+                             parent.mFamilyVec + range.end);
+        }
+        for (uint16_t i = newRanges[page].start; i < newRanges[page].end; ++i) {
+            familyVec.push_back(newFamilyVec[i] + parentFamilyCount);
+        }
+        LOG_ALWAYS_FATAL_IF(familyVec.size() >= 0xFFFF,
+                            "Exceeded the maximum indexable cmap coverage.");
+        pageRanges[page] = {static_cast<uint16_t>(start), static_cast<uint16_t>(familyVec.size())};
+    }
+    compressRanges(pageRanges.get(), nPages, familyVec);
+    initVSCoverage();
 }
 
 void FontCollection::writeTo(BufferWriter* writer,
@@ -163,13 +774,109 @@ void FontCollection::writeTo(BufferWriter* writer,
             writer->write<uint32_t>(it->second);
         }
     }
+    writer->writeArray<uint16_t>(mBlockIndices, mBlockIndicesCount);
     writer->writeArray<Range>(mRanges, mRangesCount);
     writer->writeArray<uint8_t>(mFamilyVec, mFamilyVecCount);
     // No need to serialize mVSFamilyVec as it can be reconstructed easily from mFamilies.
-    std::vector<AxisTag> axes(mSupportedAxes.begin(), mSupportedAxes.end());
-    // Sort axes to be deterministic.
-    std::sort(axes.begin(), axes.end());
-    writer->writeArray<AxisTag>(axes.data(), axes.size());
+    writer->writeArray<AxisTag>(mSupportedAxes.data(), mSupportedAxes.size());
+}
+
+namespace {
+
+// The tag and the version of the buffer written by writeVector. Bump the version whenever the
+// layout of the buffer changes.
+constexpr uint32_t kVectorTag = 0x4D4B4643;  // "MKFC"
+constexpr uint32_t kVectorVersion = 4;
+
+}  // namespace
+
+// static
+std::shared_ptr<FontCollection> FontCollection::build(const std::vector<FontFamilySpec>& specs,
+                                                      uint32_t maxThreads) {
+    if (maxThreads == 0) {
+        maxThreads = getExecutor()->getConcurrency() + 1;
+    }
+    return std::make_shared<FontCollection>(buildFontFamilies(specs, maxThreads), maxThreads);
+}
+
+// static
+void FontCollection::writeVectorHeader(BufferWriter* writer) {
+    writer->write<uint32_t>(kVectorTag);
+    writer->write<uint32_t>(kVectorVersion);
+}
+
+// static
+bool FontCollection::readVectorHeader(BufferReader* reader) {
+    uint32_t tag = reader->read<uint32_t>();
+    uint32_t version = reader->read<uint32_t>();
+    if (tag != kVectorTag || version != kVectorVersion) {
+        ALOGE("Unsupported FontCollection buffer: tag=%08x, version=%u", tag, version);
+        return false;
+    }
+    return true;
+}
+
+// static
+bool FontCollection::validateVector(const void* buffer, size_t size) {
+    BufferValidator validator(buffer, size);
+    if (validator.read<uint32_t>() != kVectorTag ||
+        validator.read<uint32_t>() != kVectorVersion) {
+        return false;
+    }
+    const uint32_t poolBitmapsCount = SparseBitSet::PagePool::validate(&validator);
+    // The offsets must be the ones of the sequential reads, so that VectorReader reads the same.
+    const auto [familyOffsets, allFontFamiliesCount] = validator.readArray<uint32_t>();
+    const auto [collectionOffsets, fontCollectionsCount] = validator.readArray<uint32_t>();
+    for (uint32_t i = 0; i < allFontFamiliesCount && validator.ok(); i++) {
+        if (familyOffsets[i] != validator.pos()) {
+            return false;
+        }
+        FontFamily::validate(&validator, poolBitmapsCount);
+    }
+    for (uint32_t i = 0; i < fontCollectionsCount && validator.ok(); i++) {
+        if (collectionOffsets[i] != validator.pos()) {
+            return false;
+        }
+        // The fields the constructor from a BufferReader reads.
+        uint32_t maxChar = validator.read<uint32_t>();
+        uint32_t familiesCount = validator.read<uint32_t>();
+        if (familiesCount == 0) {
+            return false;
+        }
+        for (uint32_t j = 0; j < familiesCount && validator.ok(); j++) {
+            if (validator.read<uint32_t>() >= allFontFamiliesCount) {
+                return false;
+            }
+        }
+        const auto [blockIndices, blockIndicesCount] = validator.readArray<uint16_t>();
+        const auto [ranges, rangesCount] = validator.readArray<Range>();
+        const auto [familyVec, familyVecCount] = validator.readArray<uint8_t>();
+        validator.skipArray<AxisTag>();
+        if (!validator.ok()) {
+            return false;
+        }
+        const uint64_t pageCount = (static_cast<uint64_t>(maxChar) + kPageMask) >> kLogCharsPerPage;
+        const uint64_t blockCount = (pageCount + kPagesPerBlock - 1) >> kLogPagesPerBlock;
+        if (blockIndicesCount < blockCount) {
+            return false;
+        }
+        for (uint32_t j = 0; j < blockCount; j++) {
+            if (static_cast<uint32_t>(blockIndices[j]) + kPagesPerBlock > rangesCount) {
+                return false;
+            }
+        }
+        for (uint32_t j = 0; j < rangesCount; j++) {
+            if (ranges[j].start > ranges[j].end || ranges[j].end > familyVecCount) {
+                return false;
+            }
+        }
+        for (uint32_t j = 0; j < familyVecCount; j++) {
+            if (familyVec[j] >= familiesCount) {
+                return false;
+            }
+        }
+    }
+    return validator.ok();
 }
 
 // static
@@ -209,15 +916,15 @@ const uint32_t kFirstFontScore = UINT32_MAX;
 //  - kFirstFontScore: When the font is the first font family in the collection and it supports the
 //    given character or variation sequence.
 uint32_t FontCollection::calcFamilyScore(uint32_t ch, uint32_t vs, FamilyVariant variant,
-                                         uint32_t localeListId,
-                                         const std::shared_ptr<FontFamily>& fontFamily) const {
-    const uint32_t coverageScore = calcCoverageScore(ch, vs, localeListId, fontFamily);
+                                         LocaleScores* localeScores, uint8_t familyIndex) const {
+    const std::shared_ptr<FontFamily>& fontFamily = mFamilies[familyIndex];
+    const uint32_t coverageScore = calcCoverageScore(ch, vs, *localeScores, fontFamily);
     if (coverageScore == kFirstFontScore || coverageScore == kUnsupportedFontScore) {
         // No need to calculate other scores.
         return coverageScore;
     }
 
-    const uint32_t localeScore = calcLocaleMatchingScore(localeListId, *fontFamily);
+    const uint32_t localeScore = localeScores->get(familyIndex, *fontFamily);
     const uint32_t variantScore = calcVariantMatchingScore(variant, *fontFamily);
 
     // Subscores are encoded into 31 bits representation to meet the subscore priority.
@@ -236,7 +943,8 @@ uint32_t FontCollection::calcFamilyScore(uint32_t ch, uint32_t vs, FamilyVariant
 // - Returns 2 if the vs is a text variation selector (U+FE0E) and if the font is not an emoji font.
 // - Returns 1 if the variation selector is not specified or if the font family only supports the
 //   variation sequence's base character.
-uint32_t FontCollection::calcCoverageScore(uint32_t ch, uint32_t vs, uint32_t localeListId,
+uint32_t FontCollection::calcCoverageScore(uint32_t ch, uint32_t vs,
+                                           const LocaleScores& localeScores,
                                            const std::shared_ptr<FontFamily>& fontFamily) const {
     const bool hasVSGlyph = (vs != 0) && fontFamily->hasGlyph(ch, vs);
     if (!hasVSGlyph && !fontFamily->getCoverage().get(ch)) {
@@ -260,7 +968,7 @@ uint32_t FontCollection::calcCoverageScore(uint32_t ch, uint32_t vs, uint32_t lo
     } else if (vs == TEXT_STYLE_VS) {
         colorEmojiRequest = false;
     } else {
-        switch (LocaleListCache::getById(localeListId).getEmojiStyle()) {
+        switch (localeScores.emojiStyle()) {
             case EmojiStyle::EMOJI:
                 colorEmojiRequest = true;
                 break;
@@ -335,15 +1043,18 @@ uint32_t FontCollection::calcVariantMatchingScore(FamilyVariant variant,
 // 3. Highest score wins, with ties resolved to the first font.
 // This method never returns nullptr.
 FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(uint32_t ch, uint32_t vs,
-                                                                   uint32_t localeListId,
+                                                                   LocaleScores* localeScores,
                                                                    FamilyVariant variant) const {
     if (ch >= mMaxChar) {
         return FamilyMatchResult::Builder().add(0).build();
     }
 
-    Range range = mRanges[ch >> kLogCharsPerPage];
-
-    if (vs != 0) {
+    // A family may have a glyph for a variation sequence without covering its base code point, so
+    // all the families are scanned if one of them has a glyph for it. Otherwise only the families
+    // covering the base code point can get a score, and they are all listed in its page.
+    const bool hasSequence = vs != 0 && isVariationSequenceCovered(ch, vs);
+    Range range = getRange(ch >> kLogCharsPerPage);
+    if (hasSequence) {
         range = {0, static_cast<uint16_t>(mFamilies.size())};
     }
 
@@ -351,9 +1062,8 @@ FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(uint32_t ch,
     FamilyMatchResult::Builder builder;
 
     for (size_t i = range.start; i < range.end; i++) {
-        const uint8_t familyIndex = vs == 0 ? mFamilyVec[i] : i;
-        const std::shared_ptr<FontFamily>& family = mFamilies[familyIndex];
-        const uint32_t score = calcFamilyScore(ch, vs, variant, localeListId, family);
+        const uint8_t familyIndex = hasSequence ? i : mFamilyVec[i];
+        const uint32_t score = calcFamilyScore(ch, vs, variant, localeScores, familyIndex);
         if (score == kFirstFontScore) {
             // If the first font family supports the given character or variation sequence, always
             // use it.
@@ -376,7 +1086,7 @@ FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(uint32_t ch,
             if (U_SUCCESS(errorCode) && len > 0) {
                 int off = 0;
                 U16_NEXT_UNSAFE(decomposed, off, ch);
-                return getFamilyForChar(ch, vs, localeListId, variant);
+                return getFamilyForChar(ch, vs, localeScores, variant);
             }
         }
         return FamilyMatchResult::Builder().add(0).build();
@@ -384,6 +1094,24 @@ FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(uint32_t ch,
     return builder.build();
 }
 
+FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(FallbackTable* table,
+                                                                   uint32_t ch, uint32_t vs,
+                                                                   LocaleScores* localeScores,
+                                                                   FamilyVariant variant) const {
+    std::atomic<FamilyMatchResult>* entry =
+            (table != nullptr && vs == 0 && ch < mMaxChar) ? table->getEntry(ch) : nullptr;
+    if (entry == nullptr) {
+        return getFamilyForChar(ch, vs, localeScores, variant);
+    }
+    FamilyMatchResult result = entry->load(std::memory_order_relaxed);
+    if (result.empty()) {
+        // Racing threads compute the same value.
+        result = getFamilyForChar(ch, vs, localeScores, variant);
+        entry->store(result, std::memory_order_relaxed);
+    }
+    return result;
+}
+
 // Characters where we want to continue using existing font run for (or stick to the next run if
 // they start a string), even if the font does not support them explicitly. These are handled
 // properly by Minikin or HarfBuzz even if the font does not explicitly support them and it's
@@ -423,6 +1151,13 @@ static inline bool isCombining(uint32_t c) {
     return (U_GET_GC_MASK(c) & U_GC_M_MASK) != 0;
 }
 
+bool FontCollection::isVariationSequenceCovered(uint32_t baseCodepoint,
+                                                uint32_t variationSelector) const {
+    const uint16_t vsIndex = getVsIndex(variationSelector);
+    return vsIndex < mVSCoverage.size() && mVSCoverage[vsIndex] != nullptr &&
+           mVSCoverage[vsIndex]->get(baseCodepoint);
+}
+
 bool FontCollection::hasVariationSelector(uint32_t baseCodepoint,
                                           uint32_t variationSelector) const {
     if (!isVariationSelector(variationSelector)) {
@@ -432,11 +1167,9 @@ bool FontCollection::hasVariationSelector(uint32_t baseCodepoint,
         return false;
     }
 
-    // Currently mRanges can not be used here since it isn't aware of the variation sequence.
-    for (size_t i = 0; i < mVSFamilyVec.size(); i++) {
-        if (mVSFamilyVec[i]->hasGlyph(baseCodepoint, variationSelector)) {
-            return true;
-        }
+    // mRanges can not be used here since it isn't aware of the variation sequence.
+    if (isVariationSequenceCovered(baseCodepoint, variationSelector)) {
+        return true;
     }
 
     // Even if there is no cmap format 14 subtable entry for the given sequence, should return true
@@ -445,8 +1178,11 @@ bool FontCollection::hasVariationSelector(uint32_t baseCodepoint,
     // sequences, since Unicode is adding variation sequences more frequently now and may even move
     // towards allowing text and emoji variation selectors on any character.
     if (variationSelector == TEXT_STYLE_VS) {
-        for (size_t i = 0; i < mFamilies.size(); ++i) {
-            if (!mFamilies[i]->isColorEmojiFamily() && mFamilies[i]->hasGlyph(baseCodepoint, 0)) {
+        // Only the families listed in the page of the base code point may have a glyph for it.
+        const Range range = getRange(baseCodepoint >> kLogCharsPerPage);
+        for (size_t i = range.start; i < range.end; ++i) {
+            const std::shared_ptr<FontFamily>& family = mFamilies[mFamilyVec[i]];
+            if (!family->isColorEmojiFamily() && family->hasGlyph(baseCodepoint, 0)) {
                 return true;
             }
         }
@@ -457,6 +1193,104 @@ bool FontCollection::hasVariationSelector(uint32_t baseCodepoint,
 
 constexpr uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
 
+namespace {
+
+// The interned family indices of the match results larger than the inline capacity. They are kept
+// in an open addressing hash table whose slots are set once and never cleared, so interning a
+// known result and reading one take no lock and allocate nothing. The index of a result is its
+// slot, which is published before the index is returned.
+class FamilyMatchOverflowTable {
+public:
+    static FamilyMatchOverflowTable& getInstance() {
+        // Never destroyed, since the results may be used while the process exits.
+        static FamilyMatchOverflowTable* table = new FamilyMatchOverflowTable();
+        return *table;
+    }
+
+    // Returns the index of the interned indices, or kNotInterned if the table is full.
+    uint32_t intern(const uint8_t* indices, uint8_t size) {
+        const uint32_t hash =
+                Hasher().updateBytes(reinterpret_cast<const char*>(indices), size).hash();
+        // The size followed by the indices, allocated when a free slot is found.
+        std::unique_ptr<uint8_t[]> created;
+        // The table is never more than half full, so the probe ends at a free slot.
+        for (uint32_t slot = hash & kSlotMask;; slot = (slot + 1) & kSlotMask) {
+            const uint8_t* entry = mSlots[slot].load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                if (mCount.load(std::memory_order_relaxed) >= kMaxEntries) {
+                    return kNotInterned;
+                }
+                if (created == nullptr) {
+                    created = std::make_unique<uint8_t[]>(size + 1);
+                    created[0] = size;
+                    std::copy(indices, indices + size, created.get() + 1);
+                }
+                if (mSlots[slot].compare_exchange_strong(entry, created.get(),
+                                                         std::memory_order_acq_rel,
+                                                         std::memory_order_acquire)) {
+                    mCount.fetch_add(1, std::memory_order_relaxed);
+                    created.release();  // Owned by the table.
+                    return slot;
+                }
+                // Another thread took the slot first, and entry is now its result.
+            }
+            if (entry[0] == size && std::equal(indices, indices + size, entry + 1)) {
+                return slot;
+            }
+        }
+    }
+
+    const uint8_t* get(uint32_t index) const {
+        return mSlots[index].load(std::memory_order_acquire) + 1;
+    }
+
+    static constexpr uint32_t kNotInterned = 0xFFFFFFFF;
+
+private:
+    // A few distinct large results are expected per process, one per combination of the fallback
+    // families covering a character.
+    static constexpr uint32_t kMaxEntries = 1024;
+    static constexpr uint32_t kSlotMask = kMaxEntries * 2 - 1;
+
+    FamilyMatchOverflowTable() : mCount(0) {
+        for (std::atomic<const uint8_t*>& slot : mSlots) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<const uint8_t*> mSlots[kSlotMask + 1];
+    // The number of set slots. A race may exceed kMaxEntries by the number of interning threads.
+    std::atomic<uint32_t> mCount;
+};
+
+}  // namespace
+
+// static
+FontCollection::FamilyMatchResult FontCollection::FamilyMatchResult::buildOverflow(
+        const uint8_t* indices, uint8_t size) {
+    const uint32_t index = FamilyMatchOverflowTable::getInstance().intern(indices, size);
+    if (index == FamilyMatchOverflowTable::kNotInterned) [[unlikely]] {
+        // The result is still usable, but the fonts of the dropped families are not candidates
+        // for the run anymore.
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true, std::memory_order_relaxed)) {
+            ALOGW("Too many distinct font family matches, keeping the first %u families of the "
+                  "new ones", static_cast<unsigned>(kInlineCapacity));
+        }
+        Builder b;
+        for (uint8_t i = 0; i < kInlineCapacity; ++i) {
+            b.add(indices[i]);
+        }
+        return b.build();
+    }
+    return FamilyMatchResult(index | (static_cast<uint64_t>(size) << 56));
+}
+
+// static
+const uint8_t* FontCollection::FamilyMatchResult::getOverflow(uint64_t bits) {
+    return FamilyMatchOverflowTable::getInstance().get(static_cast<uint32_t>(bits));
+}
+
 FontCollection::FamilyMatchResult FontCollection::FamilyMatchResult::intersect(
         FontCollection::FamilyMatchResult l, FontCollection::FamilyMatchResult r) {
     if (l == r) {
@@ -484,21 +1318,88 @@ std::vector<FontCollection::Run> FontCollection::itemize(U16StringPiece text, Fo
                                                          uint32_t localeListId,
                                                          FamilyVariant familyVariant,
                                                          uint32_t runMax) const {
+    std::vector<Run> result;
+    itemizeAppend(text, localeListId, familyVariant, runMax, &result);
+    return result;
+}
+
+void FontCollection::itemizeBatch(const U16StringPiece* texts, uint32_t textCount, FontStyle,
+                                  uint32_t localeListId, FamilyVariant familyVariant,
+                                  ItemizedTexts* out) const {
+    out->offsets.clear();
+    out->runs.clear();
+    out->offsets.reserve(textCount + 1);
+    for (uint32_t i = 0; i < textCount; ++i) {
+        out->offsets.push_back(out->runs.size());
+        itemizeAppend(texts[i], localeListId, familyVariant, texts[i].size(), &out->runs);
+    }
+    out->offsets.push_back(out->runs.size());
+}
+
+void FontCollection::itemizeAppend(U16StringPiece text, uint32_t localeListId,
+                                   FamilyVariant familyVariant, uint32_t runMax,
+                                   std::vector<Run>* out) const {
+    MINIKIN_TRACE("FontCollection::itemize", text.size(), 0 /* runCount */);
+    ScopedLatency latency(LatencyStats::kItemize);
+    if (mFirstFamilyCoversPrintableAscii && runMax > 0 && text.size() > 0 &&
+        findCodeUnitOutOfRange(text.data(), 0, text.size(), kFirstPrintableAscii,
+                               kLastPrintableAscii) == text.size()) {
+        // The first family wins for each of the characters, thus the slow path would give the
+        // same single run regardless of the locales and the variant.
+        out->push_back(
+                {FamilyMatchResult::Builder().add(0).build(), 0, static_cast<int>(text.size())});
+        return;
+    }
+    if (text.size() == 0 || text.size() > MAX_ITEMIZE_CACHE_TEXT_LENGTH) {
+        itemizeUncached(text, localeListId, familyVariant, runMax, out);
+        return;
+    }
+    // The result only depends on the collection, which is immutable, and the arguments.
+    ItemizeKey key(text, localeListId, familyVariant, runMax);
+    if (mItemizeCache->get(key, out)) {
+        return;
+    }
+    const size_t start = out->size();
+    itemizeUncached(text, localeListId, familyVariant, runMax, out);
+    if (out->size() > start) {
+        mItemizeCache->put(std::move(key), std::vector<Run>(out->begin() + start, out->end()));
+    }
+}
+
+const CacheStats& FontCollection::getItemizeCacheStats() const {
+    return mItemizeCache->getStats();
+}
+
+void FontCollection::itemizeUncached(U16StringPiece text, uint32_t localeListId,
+                                     FamilyVariant familyVariant, uint32_t runMax,
+                                     std::vector<Run>* out) const {
     const uint16_t* string = text.data();
     const uint32_t string_size = text.size();
 
     FamilyMatchResult lastFamilyIndices = FamilyMatchResult();
 
     if (string_size == 0) {
-        return std::vector<Run>();
+        return;
+    }
+
+    FallbackTable* fallbackTable = mFallbackTables->get(localeListId, familyVariant);
+    LocaleScores* localeScores = mFallbackTables->getLocaleScores(localeListId);
+    std::unique_ptr<LocaleScores> ownedLocaleScores;
+    if (localeScores == nullptr) {
+        // Too many locale lists were used with this collection. Keep the scores for this text.
+        ownedLocaleScores = std::make_unique<LocaleScores>(localeListId);
+        localeScores = ownedLocaleScores.get();
     }
 
     const uint32_t kEndOfString = 0xFFFFFFFF;
-    std::vector<Run> result;
+    // The runs of this text are appended after the existing ones.
+    std::vector<Run>& result = *out;
+    const size_t resultStart = result.size();
     Run* run = nullptr;
 
     uint32_t nextCh = 0;
     uint32_t prevCh = 0;
+    EmojiSequenceRecognizer emojiSequence;
     size_t nextUtf16Pos = 0;
     size_t readLength = 0;
     U16_NEXT(string, readLength, string_size, nextCh);
@@ -519,6 +1420,7 @@ std::vector<FontCollection::Run> FontCollection::itemize(U16StringPiece text, Fo
             nextCh = kEndOfString;
         }
 
+        const bool continuesEmojiSequence = emojiSequence.next(ch);
         bool shouldContinueRun = false;
         if (doesNotNeedFontSupport(ch)) {
             // Always continue if the character is a format character not needed to be in the font.
@@ -536,11 +1438,29 @@ std::vector<FontCollection::Run> FontCollection::itemize(U16StringPiece text, Fo
             } else {
                 shouldContinueRun = lastFamily->getCoverage().get(ch);
             }
+        } else if (continuesEmojiSequence && !isVariationSelector(nextCh) &&
+                   !lastFamilyIndices.empty() &&
+                   mFamilies[lastFamilyIndices[0]]->isColorEmojiFamily()) {
+            // A component of an emoji ZWJ, modifier, tag, keycap or flag sequence stays in the
+            // color emoji family of the sequence if it is the only one of them covering it. A
+            // component followed by a variation selector, or covered by several of the families,
+            // is scored like any other character so that the best of them is kept.
+            FamilyMatchResult::Builder builder;
+            for (uint8_t ix : lastFamilyIndices) {
+                if (mFamilies[ix]->getCoverage().get(ch)) {
+                    builder.add(ix);
+                }
+            }
+            if (builder.size() == 1) {
+                lastFamilyIndices = builder.build();
+                shouldContinueRun = true;
+            }
         }
 
         if (!shouldContinueRun) {
-            FamilyMatchResult familyIndices = getFamilyForChar(
-                    ch, isVariationSelector(nextCh) ? nextCh : 0, localeListId, familyVariant);
+            FamilyMatchResult familyIndices =
+                    getFamilyForChar(fallbackTable, ch, isVariationSelector(nextCh) ? nextCh : 0,
+                                     localeScores, familyVariant);
             bool breakRun;
             if (utf16Pos == 0 || lastFamilyIndices.empty()) {
                 breakRun = true;
@@ -605,7 +1525,8 @@ std::vector<FontCollection::Run> FontCollection::itemize(U16StringPiece text, Fo
         // If the result.size() equals to runMax, the run may be still expanding.
         // if the result.size() equals to runMax + 2, the last run may be removed and the last run
         // may be exntended the previous run with above workaround.
-        if (result.size() >= 2 && runMax == result.size() - 2) {
+        const size_t runCount = result.size() - resultStart;
+        if (runCount >= 2 && runMax == runCount - 2) {
             break;
         }
     } while (nextCh != kEndOfString);
@@ -617,12 +1538,10 @@ std::vector<FontCollection::Run> FontCollection::itemize(U16StringPiece text, Fo
                 {FamilyMatchResult::Builder().add(0).build(), 0, static_cast<int>(string_size)});
     }
 
-    if (result.size() > runMax) {
+    if (result.size() - resultStart > runMax) {
         // The itemization has terminated since it reaches the runMax. Remove last unfinalized runs.
-        return std::vector<Run>(result.begin(), result.begin() + runMax);
+        result.erase(result.begin() + resultStart + runMax, result.end());
     }
-
-    return result;
 }
 
 FakedFont FontCollection::getBestFont(U16StringPiece text, const Run& run, FontStyle style) {
@@ -650,6 +1569,28 @@ FakedFont FontCollection::baseFontFaked(FontStyle style) {
     return mFamilies[0]->getClosestMatch(style);
 }
 
+constexpr uint64_t kFakeBoldCacheValid = 1u << 31;
+
+bool FontCollection::hasFakeBold(FontStyle style) const {
+    if (style.weight() < 600) {
+        return false;  // Only a semibold or darker style is ever faked.
+    }
+    std::atomic<uint64_t>& slot =
+            mFakeBoldCache[(style.weight() / 100 * 2 + static_cast<size_t>(style.slant())) %
+                           kFakeBoldCacheSize];
+    const uint64_t entry = slot.load(std::memory_order_relaxed);
+    if ((entry & kFakeBoldCacheValid) != 0 && (entry >> 32) == style.identifier()) {
+        return (entry & 1) != 0;
+    }
+    const bool fakeBold = std::any_of(mFamilies.begin(), mFamilies.end(),
+                                      [style](const std::shared_ptr<FontFamily>& family) {
+                                          return family->getClosestMatch(style).fakery.isFakeBold();
+                                      });
+    slot.store(static_cast<uint64_t>(style.identifier()) << 32 | kFakeBoldCacheValid | fakeBold,
+               std::memory_order_relaxed);
+    return fakeBold;
+}
+
 std::shared_ptr<FontCollection> FontCollection::createCollectionWithVariation(
         const std::vector<FontVariation>& variations) {
     if (variations.empty() || mSupportedAxes.empty()) {
@@ -658,7 +1599,7 @@ std::shared_ptr<FontCollection> FontCollection::createCollectionWithVariation(
 
     bool hasSupportedAxis = false;
     for (const FontVariation& variation : variations) {
-        if (mSupportedAxes.find(variation.axisTag) != mSupportedAxes.end()) {
+        if (isAxisSupported(variation.axisTag)) {
             hasSupportedAxis = true;
             break;
         }
@@ -668,9 +1609,17 @@ std::shared_ptr<FontCollection> FontCollection::createCollectionWithVariation(
         return nullptr;
     }
 
+    // The unsupported axes don't affect any of the fonts, so they are not a part of the key.
+    const VariationKey key(variations, mSupportedAxes);
+    std::shared_ptr<FontCollection> collection = mVariationCache->get(key);
+    if (collection != nullptr) {
+        return collection;
+    }
+
     std::vector<std::shared_ptr<FontFamily>> families;
     for (const std::shared_ptr<FontFamily>& family : mFamilies) {
-        std::shared_ptr<FontFamily> newFamily = family->createFamilyWithVariation(variations);
+        std::shared_ptr<FontFamily> newFamily =
+                family->createFamilyWithVariation(key.variations());
         if (newFamily) {
             families.push_back(newFamily);
         } else {
@@ -678,11 +1627,108 @@ std::shared_ptr<FontCollection> FontCollection::createCollectionWithVariation(
         }
     }
 
-    return std::shared_ptr<FontCollection>(new FontCollection(families));
+    collection = std::shared_ptr<FontCollection>(new FontCollection(families));
+    mVariationCache->put(key, collection);
+    return collection;
+}
+
+std::shared_ptr<FontCollection> FontCollection::createCollectionWithFamilies(
+        const std::vector<std::shared_ptr<FontFamily>>& families) const {
+    return std::shared_ptr<FontCollection>(new FontCollection(*this, families));
+}
+
+const CacheStats& FontCollection::getVariationCacheStats() const {
+    return mVariationCache->getStats();
+}
+
+size_t FontCollection::getMemoryUsage() const {
+    size_t result = sizeof(FontCollection);
+    result += sizeof(std::shared_ptr<FontFamily>) *
+              (mFamilies.capacity() + mVSFamilyVec.capacity());
+    // The tables of a collection read from a buffer point into the buffer.
+    result += sizeof(uint16_t) * mOwnedBlockIndices.capacity();
+    result += sizeof(Range) * mOwnedRanges.capacity();
+    result += sizeof(uint8_t) * mOwnedFamilyVec.capacity();
+    result += sizeof(std::unique_ptr<SparseBitSet>) * mVSCoverage.capacity();
+    for (const std::unique_ptr<SparseBitSet>& bitset : mVSCoverage) {
+        if (bitset != nullptr) {
+            result += bitset->getMemoryUsage();
+        }
+    }
+    result += sizeof(AxisTag) * mSupportedAxes.capacity();
+    result += sizeof(Ancestor) * mAncestors.capacity();
+    result += mItemizeCache->getMemoryUsage();
+    result += mFallbackTables->getMemoryUsage();
+    result += mVariationCache->getMemoryUsage();
+    return result;
+}
+
+const std::unordered_set<AxisTag>& FontCollection::getSupportedTags() const {
+    std::call_once(mSupportedAxesSetOnce, [this] {
+        mSupportedAxesSet.insert(mSupportedAxes.begin(), mSupportedAxes.end());
+    });
+    return mSupportedAxesSet;
 }
 
 uint32_t FontCollection::getId() const {
     return mId;
 }
 
+bool FontCollection::isCovered(uint32_t ch) const {
+    if (ch >= mMaxChar) {
+        return false;
+    }
+    const Range range = getRange(ch >> kLogCharsPerPage);
+    for (uint16_t i = range.start; i < range.end; ++i) {
+        if (mFamilies[mFamilyVec[i]]->getCoverage().get(ch)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The appended families can only change the fallback of the characters they cover, since they
+// come after the first family and a family which doesn't cover a character doesn't score for it.
+// The exceptions are the variation sequences, which a family may support without covering the
+// base character, and the characters no family covers, which fall back to their decomposition.
+uint32_t FontCollection::getAncestorLayoutCacheId(U16StringPiece text) const {
+    const uint32_t familyCount = mFamilies.size();
+    // The families from this index on can't change the fallback of the text.
+    uint32_t affectingEnd = mAncestors[0].familyCount;
+    size_t i = 0;
+    while (i < text.size() && affectingEnd < familyCount) {
+        uint32_t ch;
+        U16_NEXT(text.data(), i, text.size(), ch);
+        if (U_IS_SURROGATE(ch)) {
+            ch = REPLACEMENT_CHARACTER;
+        }
+        if (isVariationSelector(ch)) {
+            for (uint32_t j = familyCount; j > affectingEnd; --j) {
+                if (mFamilies[j - 1]->hasVSTable()) {
+                    affectingEnd = j;
+                    break;
+                }
+            }
+            continue;
+        }
+        bool covered = false;
+        for (uint32_t j = familyCount; j > affectingEnd; --j) {
+            if (mFamilies[j - 1]->getCoverage().get(ch)) {
+                affectingEnd = j;
+                covered = true;
+                break;
+            }
+        }
+        if (!covered && !isCovered(ch)) {
+            affectingEnd = familyCount;
+        }
+    }
+    for (const Ancestor& ancestor : mAncestors) {
+        if (ancestor.familyCount >= affectingEnd) {
+            return ancestor.id;
+        }
+    }
+    return mId;
+}
+
 }  // namespace minikin
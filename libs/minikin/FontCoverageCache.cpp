@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FontCoverageCache.h"
+
+namespace minikin {
+
+// static
+FontCoverageCache& FontCoverageCache::getInstance() {
+    static FontCoverageCache cache;
+    return cache;
+}
+
+void FontCoverageCache::putBlobInternal(const std::string& path, int index,
+                                        std::vector<uint8_t>&& blob) {
+    auto shared = std::make_shared<const std::vector<uint8_t>>(std::move(blob));
+    std::lock_guard<std::mutex> lock(mMutex);
+    const Key key{path, index};
+    // The cache does not replace the value of a known key.
+    mBlobs.remove(key);
+    mBlobs.put(key, std::move(shared));
+}
+
+std::shared_ptr<const std::vector<uint8_t>> FontCoverageCache::getBlobInternal(
+        const std::string& path, int index) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBlobs.get(Key{path, index});
+}
+
+void FontCoverageCache::clearInternal() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBlobs.clear();
+}
+
+}  // namespace minikin
@@ -19,12 +19,17 @@
 #include "minikin/FontFamily.h"
 
 #include <algorithm>
+#include <atomic>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include <log/log.h>
 
 #include "minikin/CmapCoverage.h"
 #include "minikin/FamilyVariant.h"
+#include "minikin/FontCoverageCache.h"
+#include "minikin/FontFileParser.h"
 #include "minikin/HbUtils.h"
 #include "minikin/MinikinFont.h"
 
@@ -32,6 +37,7 @@
 #include "Locale.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "ParallelFor.h"
 
 namespace minikin {
 
@@ -46,6 +52,8 @@ FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
         : mLocaleListId(localeListId),
           mVariant(variant),
           mFonts(std::move(fonts)),
+          mSupportedAxes(nullptr),
+          mSupportedAxesCount(0),
           mIsColorEmoji(LocaleListCache::getById(localeListId).getEmojiStyle() ==
                         EmojiStyle::EMOJI),
           mIsCustomFallback(isCustomFallback) {
@@ -55,74 +63,230 @@ FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
 
 FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
                        std::vector<std::shared_ptr<Font>>&& fonts,
-                       std::unordered_set<AxisTag>&& supportedAxes, bool isColorEmoji,
+                       const AxisTag* supportedAxes, uint32_t supportedAxesCount,
+                       bool isColorEmoji,
                        bool isCustomFallback, SparseBitSet&& coverage,
                        std::vector<std::unique_ptr<SparseBitSet>>&& cmapFmt14Coverage)
         : mLocaleListId(localeListId),
           mVariant(variant),
           mFonts(std::move(fonts)),
-          mSupportedAxes(std::move(supportedAxes)),
+          mSupportedAxes(supportedAxes),
+          mSupportedAxesCount(supportedAxesCount),
           mIsColorEmoji(isColorEmoji),
           mIsCustomFallback(isCustomFallback),
-          mCoverage(std::move(coverage)),
-          mCmapFmt14Coverage(std::move(cmapFmt14Coverage)) {}
+          mCoverage(std::make_shared<Coverage>(
+                  Coverage{std::move(coverage), std::move(cmapFmt14Coverage), nullptr})) {}
+
+FontFamily::FontFamily(const FontFamily& base, std::vector<std::shared_ptr<Font>>&& fonts)
+        : mLocaleListId(base.mLocaleListId),
+          mVariant(base.mVariant),
+          mFonts(std::move(fonts)),
+          mIsColorEmoji(base.mIsColorEmoji),
+          mIsCustomFallback(base.mIsCustomFallback),
+          mCoverage(base.mCoverage) {
+    setOwnedSupportedAxes(base.getSortedSupportedAxes());
+}
+
+void FontFamily::setOwnedSupportedAxes(const std::vector<AxisTag>& sortedAxes) {
+    mOwnedSupportedAxes = std::make_unique<AxisTag[]>(sortedAxes.size());
+    std::copy(sortedAxes.begin(), sortedAxes.end(), mOwnedSupportedAxes.get());
+    mSupportedAxes = mOwnedSupportedAxes.get();
+    mSupportedAxesCount = sortedAxes.size();
+}
+
+const std::unordered_set<AxisTag>& FontFamily::supportedAxes() const {
+    std::call_once(mSupportedAxesSetOnce, [this] {
+        mSupportedAxesSet.insert(mSupportedAxes, mSupportedAxes + mSupportedAxesCount);
+    });
+    return mSupportedAxesSet;
+}
+
+bool FontFamily::isAxisSupported(AxisTag tag) const {
+    return std::binary_search(mSupportedAxes, mSupportedAxes + mSupportedAxesCount, tag);
+}
+
+size_t FontFamily::getMemoryUsage() const {
+    return sizeof(FontFamily) + sizeof(std::shared_ptr<Font>) * mFonts.capacity() +
+           (mOwnedSupportedAxes ? sizeof(AxisTag) * mSupportedAxesCount : 0);
+}
+
+size_t FontFamily::getCoverageMemoryUsage() const {
+    // The coverage is a member of the struct, so its size is counted by the struct.
+    size_t result = sizeof(Coverage) + mCoverage->coverage.getMemoryUsage() - sizeof(SparseBitSet);
+    result += sizeof(std::unique_ptr<SparseBitSet>) * mCoverage->cmapFmt14Coverage.capacity();
+    for (const std::unique_ptr<SparseBitSet>& bitset : mCoverage->cmapFmt14Coverage) {
+        if (bitset != nullptr) {
+            result += bitset->getMemoryUsage();
+        }
+    }
+    if (mCoverage->blob != nullptr) {
+        result += mCoverage->blob->capacity();
+    }
+    return result;
+}
+
+// Read mCmapFmt14Coverage. As it can have null entries, it is stored in the buffer as a sparse
+// array (size, non-null entry count, array of (index, entry)).
+static std::vector<std::unique_ptr<SparseBitSet>> readVSCoverage(
+        BufferReader* reader, const SparseBitSet::PagePool* pool) {
+    uint32_t cmapFmt14CoverageSize = reader->read<uint32_t>();
+    std::vector<std::unique_ptr<SparseBitSet>> cmapFmt14Coverage(cmapFmt14CoverageSize);
+    uint32_t cmapFmt14CoverageEntryCount = reader->read<uint32_t>();
+    for (uint32_t i = 0; i < cmapFmt14CoverageEntryCount; i++) {
+        uint32_t index = reader->read<uint32_t>();
+        cmapFmt14Coverage[index] = pool == nullptr ? std::make_unique<SparseBitSet>(reader)
+                                                   : std::make_unique<SparseBitSet>(reader, *pool);
+    }
+    return cmapFmt14Coverage;
+}
+
+// Write mCmapFmt14Coverage as a sparse array (size, non-null entry count,
+// array of (index, entry))
+static void writeVSCoverage(BufferWriter* writer,
+                            const std::vector<std::unique_ptr<SparseBitSet>>& cmapFmt14Coverage,
+                            const SparseBitSet::PagePool* pool) {
+    writer->write<uint32_t>(cmapFmt14Coverage.size());
+    uint32_t cmapFmt14CoverageEntryCount = 0;
+    for (const std::unique_ptr<SparseBitSet>& coverage : cmapFmt14Coverage) {
+        if (coverage != nullptr) cmapFmt14CoverageEntryCount++;
+    }
+    writer->write<uint32_t>(cmapFmt14CoverageEntryCount);
+    for (size_t i = 0; i < cmapFmt14Coverage.size(); i++) {
+        if (cmapFmt14Coverage[i] != nullptr) {
+            writer->write<uint32_t>(i);
+            if (pool == nullptr) {
+                cmapFmt14Coverage[i]->writeTo(writer);
+            } else {
+                cmapFmt14Coverage[i]->writeTo(writer, *pool);
+            }
+        }
+    }
+}
+
+// Checks the buffer for readVSCoverage.
+static void validateVSCoverage(BufferValidator* validator, uint32_t poolBitmapsCount) {
+    // There are 256 variation selectors, see getVsIndex.
+    constexpr uint32_t kMaxVSCoverageSize = 256;
+    uint32_t cmapFmt14CoverageSize = validator->read<uint32_t>();
+    if (cmapFmt14CoverageSize > kMaxVSCoverageSize) {
+        validator->fail();
+        return;
+    }
+    uint32_t cmapFmt14CoverageEntryCount = validator->read<uint32_t>();
+    for (uint32_t i = 0; i < cmapFmt14CoverageEntryCount && validator->ok(); i++) {
+        if (validator->read<uint32_t>() >= cmapFmt14CoverageSize) {
+            validator->fail();
+            return;
+        }
+        SparseBitSet::validate(validator, poolBitmapsCount);
+    }
+}
+
+// The coverage blob stored in FontCoverageCache is (version, file size, font revision, coverage,
+// variation sequence coverage). Bump the version when the layout changes.
+constexpr uint32_t kCoverageBlobVersion = 1;
+
+static void writeCoverageBlob(BufferWriter* writer, uint32_t fileSize, uint32_t revision,
+                              const SparseBitSet& coverage,
+                              const std::vector<std::unique_ptr<SparseBitSet>>& cmapFmt14Coverage) {
+    writer->write<uint32_t>(kCoverageBlobVersion);
+    writer->write<uint32_t>(fileSize);
+    writer->write<uint32_t>(revision);
+    coverage.writeTo(writer);
+    writeVSCoverage(writer, cmapFmt14Coverage, nullptr);
+}
+
+// Returns false if the blob was computed for another version of the font file, or is not a valid
+// blob, e.g. a truncated file given to FontCoverageCache::putBlob(). The coverage points into the
+// blob, so the blob must outlive it.
+static bool readCoverageBlob(const std::vector<uint8_t>& blob, uint32_t fileSize,
+                             uint32_t revision, SparseBitSet* coverage,
+                             std::vector<std::unique_ptr<SparseBitSet>>* cmapFmt14Coverage) {
+    BufferValidator validator(blob.data(), blob.size());
+    validator.skip<uint32_t>();  // The version.
+    validator.skip<uint32_t>();  // The file size.
+    validator.skip<uint32_t>();  // The font revision.
+    SparseBitSet::validate(&validator);
+    validateVSCoverage(&validator, 0 /* poolBitmapsCount */);
+    if (!validator.ok()) {
+        return false;
+    }
+    BufferReader reader(blob.data());
+    if (reader.read<uint32_t>() != kCoverageBlobVersion || reader.read<uint32_t>() != fileSize ||
+        reader.read<uint32_t>() != revision) {
+        return false;
+    }
+    *coverage = SparseBitSet(&reader);
+    *cmapFmt14Coverage = readVSCoverage(&reader, nullptr);
+    return true;
+}
 
 // Read fields other than mFonts, mLocaleList.
 // static
 std::shared_ptr<FontFamily> FontFamily::readFromInternal(BufferReader* reader,
                                                          std::vector<std::shared_ptr<Font>>&& fonts,
-                                                         uint32_t localeListId) {
+                                                         uint32_t localeListId,
+                                                         const SparseBitSet::PagePool* pool) {
     // FamilyVariant is uint8_t
     static_assert(sizeof(FamilyVariant) == 1);
     FamilyVariant variant = reader->read<FamilyVariant>();
     // AxisTag is uint32_t
     static_assert(sizeof(AxisTag) == 4);
     const auto& [axesPtr, axesCount] = reader->readArray<AxisTag>();
-    std::unordered_set<AxisTag> supportedAxes(axesPtr, axesPtr + axesCount);
     bool isColorEmoji = static_cast<bool>(reader->read<uint8_t>());
     bool isCustomFallback = static_cast<bool>(reader->read<uint8_t>());
-    SparseBitSet coverage(reader);
-    // Read mCmapFmt14Coverage. As it can have null entries, it is stored in the buffer as a sparse
-    // array (size, non-null entry count, array of (index, entry)).
-    uint32_t cmapFmt14CoverageSize = reader->read<uint32_t>();
-    std::vector<std::unique_ptr<SparseBitSet>> cmapFmt14Coverage(cmapFmt14CoverageSize);
-    uint32_t cmapFmt14CoverageEntryCount = reader->read<uint32_t>();
-    for (uint32_t i = 0; i < cmapFmt14CoverageEntryCount; i++) {
-        uint32_t index = reader->read<uint32_t>();
-        cmapFmt14Coverage[index] = std::make_unique<SparseBitSet>(reader);
-    }
+    SparseBitSet coverage = pool == nullptr ? SparseBitSet(reader) : SparseBitSet(reader, *pool);
+    std::vector<std::unique_ptr<SparseBitSet>> cmapFmt14Coverage = readVSCoverage(reader, pool);
     return std::shared_ptr<FontFamily>(new FontFamily(
-            localeListId, variant, std::move(fonts), std::move(supportedAxes), isColorEmoji,
+            localeListId, variant, std::move(fonts), axesPtr, axesCount, isColorEmoji,
             isCustomFallback, std::move(coverage), std::move(cmapFmt14Coverage)));
 }
 
+// static
+void FontFamily::validate(BufferValidator* validator, uint32_t poolBitmapsCount) {
+    // The locale list, see LocaleListCache::readFrom.
+    uint32_t localeCount = validator->read<uint32_t>();
+    for (uint32_t i = 0; i < localeCount && validator->ok(); i++) {
+        validator->skip<uint64_t>();
+    }
+    uint32_t fontsCount = validator->read<uint32_t>();
+    for (uint32_t i = 0; i < fontsCount && validator->ok(); i++) {
+        Font::validate(validator);
+    }
+    // The fields readFromInternal reads.
+    validator->skip<FamilyVariant>();
+    validator->skipArray<AxisTag>();
+    validator->skip<uint8_t>();  // isColorEmoji
+    validator->skip<uint8_t>();  // isCustomFallback
+    SparseBitSet::validate(validator, poolBitmapsCount);
+    validateVSCoverage(validator, poolBitmapsCount);
+}
+
 // static
 uint32_t FontFamily::readLocaleListInternal(BufferReader* reader) {
     return LocaleListCache::readFrom(reader);
 }
 
 // Write fields other than mFonts.
-void FontFamily::writeToInternal(BufferWriter* writer) const {
+void FontFamily::writeToInternal(BufferWriter* writer, const SparseBitSet::PagePool* pool) const {
     writer->write<FamilyVariant>(mVariant);
-    std::vector<AxisTag> axes(mSupportedAxes.begin(), mSupportedAxes.end());
-    // Sort axes to be deterministic.
-    std::sort(axes.begin(), axes.end());
-    writer->writeArray<AxisTag>(axes.data(), axes.size());
+    // The axes are sorted, so that the buffer is deterministic and readFrom() can point into it.
+    writer->writeArray<AxisTag>(mSupportedAxes, mSupportedAxesCount);
     writer->write<uint8_t>(mIsColorEmoji);
     writer->write<uint8_t>(mIsCustomFallback);
-    mCoverage.writeTo(writer);
-    // Write mCmapFmt14Coverage as a sparse array (size, non-null entry count,
-    // array of (index, entry))
-    writer->write<uint32_t>(mCmapFmt14Coverage.size());
-    uint32_t cmapFmt14CoverageEntryCount = 0;
-    for (const std::unique_ptr<SparseBitSet>& coverage : mCmapFmt14Coverage) {
-        if (coverage != nullptr) cmapFmt14CoverageEntryCount++;
+    if (pool == nullptr) {
+        mCoverage->coverage.writeTo(writer);
+    } else {
+        mCoverage->coverage.writeTo(writer, *pool);
     }
-    writer->write<uint32_t>(cmapFmt14CoverageEntryCount);
-    for (size_t i = 0; i < mCmapFmt14Coverage.size(); i++) {
-        if (mCmapFmt14Coverage[i] != nullptr) {
-            writer->write<uint32_t>(i);
-            mCmapFmt14Coverage[i]->writeTo(writer);
+    writeVSCoverage(writer, mCoverage->cmapFmt14Coverage, pool);
+}
+
+void FontFamily::addCoverageTo(SparseBitSet::PagePool* pool) const {
+    pool->add(mCoverage->coverage);
+    for (const std::unique_ptr<SparseBitSet>& coverage : mCoverage->cmapFmt14Coverage) {
+        if (coverage != nullptr) {
+            pool->add(*coverage);
         }
     }
 }
@@ -150,7 +314,25 @@ static FontFakery computeFakery(FontStyle wanted, FontStyle actual) {
     return FontFakery(isFakeBold, isFakeItalic);
 }
 
+// A match cache entry is (FontStyle::identifier() << 32 | kMatchCacheValid | font index << 2 |
+// fake bold << 1 | fake italic), or zero if empty.
+constexpr uint64_t kMatchCacheValid = 1u << 31;
+constexpr uint32_t kMatchCacheMaxIndex = (kMatchCacheValid >> 2) - 1;
+
+// static
+size_t FontFamily::matchCacheSlot(FontStyle style) {
+    // Each of the standard weights and slant pairs of a weight group gets its own slot.
+    return (style.weight() / 100 * 2 + static_cast<size_t>(style.slant())) % kMatchCacheSize;
+}
+
 FakedFont FontFamily::getClosestMatch(FontStyle style) const {
+    std::atomic<uint64_t>& slot = mMatchCache[matchCacheSlot(style)];
+    const uint64_t entry = slot.load(std::memory_order_relaxed);
+    if ((entry & kMatchCacheValid) != 0 && (entry >> 32) == style.identifier()) {
+        const uint32_t index = (entry & (kMatchCacheValid - 1)) >> 2;
+        return FakedFont{mFonts[index], FontFakery((entry & 2) != 0, (entry & 1) != 0)};
+    }
+
     int bestIndex = 0;
     Font* bestFont = mFonts[bestIndex].get();
     int bestMatch = computeMatch(bestFont->style(), style);
@@ -163,43 +345,90 @@ FakedFont FontFamily::getClosestMatch(FontStyle style) const {
             bestMatch = match;
         }
     }
-    return FakedFont{mFonts[bestIndex], computeFakery(style, bestFont->style())};
+    FontFakery fakery = computeFakery(style, bestFont->style());
+    if (static_cast<uint32_t>(bestIndex) <= kMatchCacheMaxIndex) {
+        slot.store(static_cast<uint64_t>(style.identifier()) << 32 | kMatchCacheValid |
+                           static_cast<uint64_t>(bestIndex) << 2 |
+                           (fakery.isFakeBold() ? 2 : 0) | (fakery.isFakeItalic() ? 1 : 0),
+                   std::memory_order_relaxed);
+    }
+    return FakedFont{mFonts[bestIndex], fakery};
 }
 
 void FontFamily::computeCoverage() {
+    auto coverage = std::make_shared<Coverage>();
+    mCoverage = coverage;
     const std::shared_ptr<Font>& font = getClosestMatch(FontStyle()).font;
-    HbBlob cmapTable(font->baseFont(), MinikinFont::MakeTag('c', 'm', 'a', 'p'));
-    if (cmapTable.get() == nullptr) {
-        ALOGE("Could not get cmap table size!\n");
-        return;
+
+    // The precomputed coverage can only be validated against the font file if its data is known.
+    const std::shared_ptr<MinikinFont> typeface = font->typeface();
+    const std::string& path = typeface->GetFontPath();
+    const uint32_t fileSize = typeface->GetFontSize();
+    std::optional<uint32_t> revision;
+    if (!path.empty() && typeface->GetFontData() != nullptr) {
+        revision = FontFileParser(typeface->GetFontData(), fileSize, typeface->GetFontIndex())
+                           .getFontRevision();
+    }
+    std::shared_ptr<const std::vector<uint8_t>> blob;
+    if (revision.has_value()) {
+        blob = FontCoverageCache::getBlob(path, typeface->GetFontIndex());
     }
 
-    mCoverage = CmapCoverage::getCoverage(cmapTable.get(), cmapTable.size(), &mCmapFmt14Coverage);
+    if (blob != nullptr && readCoverageBlob(*blob, fileSize, revision.value(),
+                                            &coverage->coverage, &coverage->cmapFmt14Coverage)) {
+        coverage->blob = std::move(blob);
+    } else {
+        HbBlob cmapTable(font->baseFont(), MinikinFont::MakeTag('c', 'm', 'a', 'p'));
+        if (cmapTable.get() == nullptr) {
+            ALOGE("Could not get cmap table size!\n");
+            return;
+        }
+
+        coverage->coverage = CmapCoverage::getCoverage(cmapTable.get(), cmapTable.size(),
+                                                       &coverage->cmapFmt14Coverage);
+
+        if (revision.has_value()) {
+            BufferWriter fakeWriter(nullptr);
+            writeCoverageBlob(&fakeWriter, fileSize, revision.value(), coverage->coverage,
+                              coverage->cmapFmt14Coverage);
+            std::vector<uint8_t> newBlob(fakeWriter.size());
+            BufferWriter writer(newBlob.data());
+            writeCoverageBlob(&writer, fileSize, revision.value(), coverage->coverage,
+                              coverage->cmapFmt14Coverage);
+            FontCoverageCache::putBlob(path, typeface->GetFontIndex(), std::move(newBlob));
+        }
+    }
 
+    std::vector<AxisTag> sortedAxes;
     for (size_t i = 0; i < mFonts.size(); ++i) {
-        std::unordered_set<AxisTag> supportedAxes = mFonts[i]->getSupportedAxes();
-        mSupportedAxes.insert(supportedAxes.begin(), supportedAxes.end());
+        const std::vector<AxisTag>& fontAxes = mFonts[i]->getSortedSupportedAxes();
+        sortedAxes.insert(sortedAxes.end(), fontAxes.begin(), fontAxes.end());
     }
+    std::sort(sortedAxes.begin(), sortedAxes.end());
+    sortedAxes.erase(std::unique(sortedAxes.begin(), sortedAxes.end()), sortedAxes.end());
+    setOwnedSupportedAxes(sortedAxes);
 }
 
 bool FontFamily::hasGlyph(uint32_t codepoint, uint32_t variationSelector) const {
     if (variationSelector == 0) {
-        return mCoverage.get(codepoint);
+        return mCoverage->coverage.get(codepoint);
     }
 
-    if (mCmapFmt14Coverage.empty()) {
+    const std::vector<std::unique_ptr<SparseBitSet>>& cmapFmt14Coverage =
+            mCoverage->cmapFmt14Coverage;
+    if (cmapFmt14Coverage.empty()) {
         return false;
     }
 
     const uint16_t vsIndex = getVsIndex(variationSelector);
 
-    if (vsIndex >= mCmapFmt14Coverage.size()) {
+    if (vsIndex >= cmapFmt14Coverage.size()) {
         // Even if vsIndex is INVALID_VS_INDEX, we reach here since INVALID_VS_INDEX is defined to
         // be at the maximum end of the range.
         return false;
     }
 
-    const std::unique_ptr<SparseBitSet>& bitset = mCmapFmt14Coverage[vsIndex];
+    const std::unique_ptr<SparseBitSet>& bitset = cmapFmt14Coverage[vsIndex];
     if (bitset.get() == nullptr) {
         return false;
     }
@@ -209,13 +438,13 @@ bool FontFamily::hasGlyph(uint32_t codepoint, uint32_t variationSelector) const
 
 std::shared_ptr<FontFamily> FontFamily::createFamilyWithVariation(
         const std::vector<FontVariation>& variations) const {
-    if (variations.empty() || mSupportedAxes.empty()) {
+    if (variations.empty() || mSupportedAxesCount == 0) {
         return nullptr;
     }
 
     bool hasSupportedAxis = false;
     for (const FontVariation& variation : variations) {
-        if (mSupportedAxes.find(variation.axisTag) != mSupportedAxes.end()) {
+        if (isAxisSupported(variation.axisTag)) {
             hasSupportedAxis = true;
             break;
         }
@@ -228,10 +457,11 @@ std::shared_ptr<FontFamily> FontFamily::createFamilyWithVariation(
     std::vector<std::shared_ptr<Font>> fonts;
     for (const auto& font : mFonts) {
         bool supportedVariations = false;
-        std::unordered_set<AxisTag> supportedAxes = font->getSupportedAxes();
+        const std::vector<AxisTag>& supportedAxes = font->getSortedSupportedAxes();
         if (!supportedAxes.empty()) {
             for (const FontVariation& variation : variations) {
-                if (supportedAxes.find(variation.axisTag) != supportedAxes.end()) {
+                if (std::binary_search(supportedAxes.begin(), supportedAxes.end(),
+                                       variation.axisTag)) {
                     supportedVariations = true;
                     break;
                 }
@@ -248,8 +478,35 @@ std::shared_ptr<FontFamily> FontFamily::createFamilyWithVariation(
         }
     }
 
-    return std::shared_ptr<FontFamily>(
-            new FontFamily(mLocaleListId, mVariant, std::move(fonts), mIsCustomFallback));
+    return std::shared_ptr<FontFamily>(new FontFamily(*this, std::move(fonts)));
+}
+
+std::vector<std::shared_ptr<FontFamily>> buildFontFamilies(const std::vector<FontFamilySpec>& specs,
+                                                           uint32_t maxThreads) {
+    // The fonts of all the families are built together, so that a family of many fonts doesn't
+    // keep a single thread busy.
+    std::vector<std::pair<size_t, size_t>> fontIndices;  // (spec index, font index)
+    std::vector<std::vector<std::shared_ptr<Font>>> fonts(specs.size());
+    for (size_t i = 0; i < specs.size(); i++) {
+        fonts[i].resize(specs[i].fonts.size());
+        for (size_t j = 0; j < specs[i].fonts.size(); j++) {
+            fontIndices.emplace_back(i, j);
+        }
+    }
+    parallelFor(fontIndices.size(), maxThreads, [&](size_t i) {
+        const auto [specIndex, fontIndex] = fontIndices[i];
+        // Builder::build() updates the builder, so build a copy.
+        Font::Builder builder = specs[specIndex].fonts[fontIndex];
+        fonts[specIndex][fontIndex] = builder.build();
+    });
+
+    std::vector<std::shared_ptr<FontFamily>> families(specs.size());
+    parallelFor(specs.size(), maxThreads, [&](size_t i) {
+        const FontFamilySpec& spec = specs[i];
+        families[i] = std::make_shared<FontFamily>(spec.localeListId, spec.variant,
+                                                   std::move(fonts[i]), spec.isCustomFallback);
+    });
+    return families;
 }
 
 }  // namespace minikin
@@ -18,6 +18,7 @@
 
 #define LOG_TAG "Minikin"
 
+#include <algorithm>
 #include <cstdint>
 #include <optional>
 #include <string>
@@ -26,6 +27,7 @@
 #include <hb-ot.h>
 #include <hb.h>
 
+#include "FontUtils.h"
 #include "MinikinInternal.h"
 #include "minikin/MinikinFont.h"
 
@@ -154,17 +156,97 @@ bool FontFileParser::checkPSName(const std::string& psName) {
     return true;
 }
 
+// static
+bool FontFileParser::parseTableDirectory(const uint8_t* data, size_t size, uint32_t index,
+                                         std::vector<TableRecord>* out) {
+    out->clear();
+    SafeFontBufferReader reader(data, size);
+
+    uint32_t sfntVersion = reader.readU32();
+    if (sfntVersion == MinikinFont::MakeTag('t', 't', 'c', 'f')) {
+        reader.readU16();  // majorVersion
+        reader.readU16();  // minorVersion
+        uint32_t numFonts = reader.readU32();
+        if (reader.error() || index >= numFonts) return false;
+        const uint64_t offsetPos = 12 + static_cast<uint64_t>(index) * 4;
+        if (offsetPos > size) return false;
+        reader.seek(offsetPos);
+        reader.seek(reader.readU32());
+        sfntVersion = reader.readU32();
+    }
+    // The same font file types as HarfBuzz, from which the other ctors look up the tables.
+    if (sfntVersion != 0x00010000 && sfntVersion != MinikinFont::MakeTag('O', 'T', 'T', 'O') &&
+        sfntVersion != MinikinFont::MakeTag('t', 'r', 'u', 'e') &&
+        sfntVersion != MinikinFont::MakeTag('t', 'y', 'p', '1')) {
+        return false;
+    }
+    uint16_t numTables = reader.readU16();
+    reader.readU16();  // searchRange
+    reader.readU16();  // entrySelector
+    reader.readU16();  // rangeShift
+    if (reader.error() || reader.remaining() / 16 < numTables) return false;
+
+    out->reserve(numTables);
+    for (uint16_t i = 0; i < numTables; i++) {
+        uint32_t tag = reader.readU32();
+        reader.readU32();  // checksum
+        uint32_t offset = reader.readU32();
+        uint32_t length = reader.readU32();
+        if (offset >= size) {
+            continue;  // The table is not in the file.
+        }
+        length = std::min<size_t>(length, size - offset);
+        out->push_back({tag, offset, length});
+    }
+    std::stable_sort(out->begin(), out->end(),
+                     [](const TableRecord& a, const TableRecord& b) { return a.tag < b.tag; });
+    return true;
+}
+
 FontFileParser::FontFileParser(const void* buffer, size_t size, uint32_t index)
-        : mFace(makeHbFace(buffer, size, index)) {}
+        : mFace(makeHbFace(buffer, size, index)) {
+    init(buffer, size, index);
+}
 
 FontFileParser::FontFileParser(const HbFaceUniquePtr& face)
-        : mFace(hb_face_reference(face.get())) {}
+        : mFace(hb_face_reference(face.get())), mFileBlob(hb_face_reference_blob(face.get())) {
+    unsigned int size = 0;
+    const char* data = hb_blob_get_data(mFileBlob.get(), &size);
+    init(data, size, hb_face_get_index(face.get()));
+}
 
 FontFileParser::FontFileParser(const HbFontUniquePtr& font)
-        : mFace(hb_face_reference(hb_font_get_face(font.get()))) {}
+        : FontFileParser(HbFaceUniquePtr(hb_face_reference(hb_font_get_face(font.get())))) {}
 
 FontFileParser::~FontFileParser() {}
 
+void FontFileParser::init(const void* buffer, size_t size, uint32_t index) {
+    mData = reinterpret_cast<const uint8_t*>(buffer);
+    mSize = size;
+    if (mData != nullptr && mSize > 0) {
+        mHasTableDirectory = parseTableDirectory(mData, mSize, index, &mTables);
+    }
+}
+
+FontFileParser::Table FontFileParser::getTable(uint32_t tag) const {
+    Table table;
+    if (mHasTableDirectory) {
+        auto it = std::lower_bound(
+                mTables.begin(), mTables.end(), tag,
+                [](const TableRecord& record, uint32_t tag) { return record.tag < tag; });
+        if (it != mTables.end() && it->tag == tag) {
+            table.data = mData + it->offset;
+            table.size = it->length;
+        }
+    } else if (mFace) {
+        table.blob.reset(hb_face_reference_table(mFace.get(), tag));
+        unsigned int size = 0;
+        table.data = reinterpret_cast<const uint8_t*>(hb_blob_get_data(table.blob.get(), &size));
+        table.size = size;
+    }
+    return table;
+}
+
 // static
 HbFaceUniquePtr FontFileParser::makeHbFace(const void* buffer, size_t size, uint32_t index) {
     HbBlobUniquePtr blob(hb_blob_create(reinterpret_cast<const char*>(buffer), size,
@@ -175,11 +257,11 @@ HbFaceUniquePtr FontFileParser::makeHbFace(const void* buffer, size_t size, uint
 std::optional<uint32_t> FontFileParser::getFontRevision() const {
     if (!mFace) return std::optional<uint32_t>();
 
-    HbBlob headTable(mFace, MinikinFont::MakeTag('h', 'e', 'a', 'd'));
+    Table headTable = getTable(MinikinFont::MakeTag('h', 'e', 'a', 'd'));
     if (!headTable) return std::optional<uint32_t>();
 
     uint32_t out = 0;
-    if (!analyzeFontRevision(headTable.get(), headTable.size(), &out)) {
+    if (!analyzeFontRevision(headTable.data, headTable.size, &out)) {
         return std::optional<uint32_t>();
     }
 
@@ -211,9 +293,38 @@ std::optional<std::string> FontFileParser::getPostScriptName() const {
 std::optional<bool> FontFileParser::isPostScriptType1Font() const {
     if (!mFace) return std::optional<bool>();
 
-    HbBlob cffTable(mFace, MinikinFont::MakeTag('C', 'F', 'F', ' '));
-    HbBlob cff2Table(mFace, MinikinFont::MakeTag('C', 'F', 'F', '2'));
-    return cffTable || cff2Table;
+    return getTable(MinikinFont::MakeTag('C', 'F', 'F', ' ')) ||
+           getTable(MinikinFont::MakeTag('C', 'F', 'F', '2'));
+}
+
+std::optional<FontStyle> FontFileParser::getStyle() const {
+    if (!mFace) return std::optional<FontStyle>();
+
+    Table os2Table = getTable(MinikinFont::MakeTag('O', 'S', '/', '2'));
+    if (!os2Table) return std::optional<FontStyle>();
+
+    int weight;
+    bool italic;
+    if (!analyzeStyle(os2Table.data, os2Table.size, &weight, &italic)) {
+        return std::optional<FontStyle>();
+    }
+    return FontStyle(static_cast<uint16_t>(weight), static_cast<FontStyle::Slant>(italic));
+}
+
+std::unordered_set<AxisTag> FontFileParser::getSupportedAxes() const {
+    const std::vector<AxisTag> axes = getSortedSupportedAxes();
+    return std::unordered_set<AxisTag>(axes.begin(), axes.end());
+}
+
+std::vector<AxisTag> FontFileParser::getSortedSupportedAxes() const {
+    std::vector<AxisTag> supportedAxes;
+    if (!mFace) return supportedAxes;
+
+    Table fvarTable = getTable(MinikinFont::MakeTag('f', 'v', 'a', 'r'));
+    if (fvarTable) {
+        analyzeAxes(fvarTable.data, fvarTable.size, &supportedAxes);
+    }
+    return supportedAxes;
 }
 
 }  // namespace minikin
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/FontPreloader.h"
+
+#include "minikin/Executor.h"
+#include "minikin/FontFamily.h"
+
+#include "Locale.h"
+#include "LocaleListCache.h"
+
+namespace minikin {
+
+// static
+FontPreloader& FontPreloader::getInstance() {
+    // Never destroyed, so that the running load isn't waited for while the process exits.
+    static FontPreloader* preloader = new FontPreloader();
+    return *preloader;
+}
+
+FontPreloader::FontPreloader() : mIsLoading(false), mIsStopping(false) {}
+
+FontPreloader::~FontPreloader() {
+    // The queued fonts are dropped, but the font being loaded is waited for.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIsStopping = true;
+    mCondition.wait(lock, [this]() { return !mIsLoading; });
+}
+
+void FontPreloader::preloadInternal(const std::shared_ptr<Font>& font) {
+    enqueue({font});
+}
+
+void FontPreloader::preloadForLocalesInternal(const FontCollection& collection,
+                                              uint32_t localeListId) {
+    const LocaleList& requested = LocaleListCache::getById(localeListId);
+    if (requested.empty()) {
+        return;
+    }
+    std::vector<std::shared_ptr<Font>> fonts;
+    for (const std::shared_ptr<FontFamily>& family : collection.getFamilies()) {
+        const LocaleList& familyLocales = LocaleListCache::getById(family->localeListId());
+        for (size_t i = 0; i < familyLocales.size(); ++i) {
+            if (familyLocales[i].calcScoreFor(requested) > 0) {
+                fonts.push_back(family->getClosestMatch(FontStyle()).font);
+                break;
+            }
+        }
+    }
+    if (fonts.empty()) {
+        return;
+    }
+    enqueue(std::move(fonts));
+}
+
+void FontPreloader::enqueue(std::vector<std::shared_ptr<Font>>&& fonts) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.insert(mQueue.end(), std::make_move_iterator(fonts.begin()),
+                      std::make_move_iterator(fonts.end()));
+        if (mIsLoading) {
+            return;
+        }
+        mIsLoading = true;
+    }
+    getExecutor()->execute([this]() { run(); }, Executor::Priority::kBackground);
+}
+
+void FontPreloader::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mQueue.empty() && !mIsLoading; });
+}
+
+void FontPreloader::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mIsStopping && !mQueue.empty()) {
+        std::shared_ptr<Font> font = std::move(mQueue.front());
+        mQueue.pop_front();
+        lock.unlock();
+        // This loads the typeface and creates the HarfBuzz font under the font's own lock, which
+        // the layouts needing the font wait for.
+        font->baseFont();
+        font.reset();
+        lock.lock();
+    }
+    mIsLoading = false;
+    // Notified under the lock, since the preloader may be destroyed right after.
+    mCondition.notify_all();
+}
+
+}  // namespace minikin
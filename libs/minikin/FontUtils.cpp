@@ -16,6 +16,7 @@
 
 #include "FontUtils.h"
 
+#include <algorithm>
 #include <cstdint>
 
 #include <log/log.h>
@@ -45,7 +46,7 @@ bool analyzeStyle(const uint8_t* os2_data, size_t os2_size, int* weight, bool* i
     return true;
 }
 
-bool analyzeAxes(const uint8_t* fvar_data, size_t fvar_size, std::unordered_set<uint32_t>* axes) {
+bool analyzeAxes(const uint8_t* fvar_data, size_t fvar_size, std::vector<uint32_t>* axes) {
     const size_t kMajorVersionOffset = 0;
     const size_t kMinorVersionOffset = 2;
     const size_t kOffsetToAxesArrayOffset = 4;
@@ -75,8 +76,10 @@ bool analyzeAxes(const uint8_t* fvar_data, size_t fvar_size, std::unordered_set<
     for (uint32_t i = 0; i < axisCount; ++i) {
         size_t axisRecordOffset = axisOffset + i * axisSize;
         uint32_t tag = readU32(fvar_data, axisRecordOffset);
-        axes->insert(tag);
+        axes->push_back(tag);
     }
+    std::sort(axes->begin(), axes->end());
+    axes->erase(std::unique(axes->begin(), axes->end()), axes->end());
     return true;
 }
 }  // namespace minikin
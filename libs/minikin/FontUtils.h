@@ -18,12 +18,13 @@
 #define MINIKIN_FONT_UTILS_H
 
 #include <cstdint>
-#include <unordered_set>
+#include <vector>
 
 namespace minikin {
 
 bool analyzeStyle(const uint8_t* os2_data, size_t os2_size, int* weight, bool* italic);
-bool analyzeAxes(const uint8_t* fvar_data, size_t fvar_size, std::unordered_set<uint32_t>* axes);
+// Reads the axis tags of the fvar table into axes, in ascending order without duplicates.
+bool analyzeAxes(const uint8_t* fvar_data, size_t fvar_size, std::vector<uint32_t>* axes);
 
 }  // namespace minikin
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FrequencySketch.h"
+
+#include <algorithm>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+namespace {
+
+constexpr uint32_t kRowCount = 4;
+constexpr uint64_t kMaxCount = 15;
+constexpr uint64_t kResetMask = 0x7777777777777777ull;
+constexpr uint64_t kSeeds[kRowCount] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull,
+                                        0x9ae16a3b2f90404full, 0xcbf29ce484222325ull};
+
+// Returns the bits locating the counter of the hash in the row. The low bits select the word and
+// bits 40 and 41 the counter among the four of the row in the word.
+IGNORE_INTEGER_OVERFLOW inline uint64_t spread(uint32_t hash, uint32_t row) {
+    uint64_t h = (hash + kSeeds[row]) * kSeeds[row];
+    return h ^ (h >> 32);
+}
+
+inline uint32_t counterShift(uint64_t bits, uint32_t row) {
+    return (row * 4 + ((bits >> 40) & 3)) * 4;
+}
+
+uint32_t ceilPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(uint32_t capacity)
+        : mTable(ceilPowerOfTwo(std::max(capacity, 16u))),
+          mMask(mTable.size() - 1),
+          mSampleSize(10 * std::max(capacity, 16u)),
+          mAdditions(0) {}
+
+void FrequencySketch::increment(uint32_t hash) {
+    bool added = false;
+    for (uint32_t row = 0; row < kRowCount; ++row) {
+        const uint64_t bits = spread(hash, row);
+        uint64_t& word = mTable[bits & mMask];
+        const uint32_t shift = counterShift(bits, row);
+        if (((word >> shift) & kMaxCount) != kMaxCount) {
+            word += 1ull << shift;
+            added = true;
+        }
+    }
+    if (added && ++mAdditions >= mSampleSize) {
+        reset();
+    }
+}
+
+uint32_t FrequencySketch::frequency(uint32_t hash) const {
+    uint64_t result = kMaxCount;
+    for (uint32_t row = 0; row < kRowCount; ++row) {
+        const uint64_t bits = spread(hash, row);
+        result = std::min(result, (mTable[bits & mMask] >> counterShift(bits, row)) & kMaxCount);
+    }
+    return result;
+}
+
+void FrequencySketch::reset() {
+    for (uint64_t& word : mTable) {
+        word = (word >> 1) & kResetMask;
+    }
+    mAdditions /= 2;
+}
+
+}  // namespace minikin
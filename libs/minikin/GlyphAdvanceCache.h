@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_GLYPH_ADVANCE_CACHE_H
+#define MINIKIN_GLYPH_ADVANCE_CACHE_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+namespace minikin {
+
+/*
+ * The advances of the glyphs of a font for one size, scale, skew, flags and fakery, so that the
+ * glyphs of new words are not measured by the typeface again. The first glyph IDs, which cover the
+ * Latin letters of most fonts, are in a flat array, and the others in a bounded hash map.
+ *
+ * Not thread safe. Each thread has its own, see SubFontCache in LayoutCore.cpp.
+ */
+class GlyphAdvanceCache {
+public:
+    static constexpr uint32_t kDenseGlyphCount = 512;
+    // The sparse advances are dropped all at once when there are this many.
+    static constexpr size_t kMaxSparseGlyphCount = 1024;
+
+    GlyphAdvanceCache() { mDense.fill(kMissing); }
+
+    // Returns true and sets the advance if the glyph is cached.
+    bool get(uint32_t glyph, float* advance) const {
+        if (glyph < kDenseGlyphCount) {
+            *advance = mDense[glyph];
+            return !std::isnan(*advance);
+        }
+        auto it = mSparse.find(glyph);
+        if (it == mSparse.end()) {
+            return false;
+        }
+        *advance = it->second;
+        return true;
+    }
+
+    void put(uint32_t glyph, float advance) {
+        if (glyph < kDenseGlyphCount) {
+            mDense[glyph] = advance;
+            return;
+        }
+        if (mSparse.size() == kMaxSparseGlyphCount) {
+            mSparse.clear();
+        }
+        mSparse[glyph] = advance;
+    }
+
+private:
+    static constexpr float kMissing = std::numeric_limits<float>::quiet_NaN();
+
+    std::array<float, kDenseGlyphCount> mDense;
+    std::unordered_map<uint32_t, float> mSparse;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_GLYPH_ADVANCE_CACHE_H
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GlyphPositions.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "minikin/HbUtils.h"
+
+namespace minikin {
+
+namespace {
+
+// hb_position_t is a 24.8 fixed point number. Multiplying by a power of two is exact, so this
+// gives the same result as scalbnf(v, -8).
+constexpr float kFixedScale = 1.0f / 256.0f;
+
+// A minimal abstraction over the 4 lane float vector of the target. Each lane holds one glyph.
+#if defined(__ARM_NEON)
+using Float4 = float32x4_t;
+
+// Returns {x_advance, y_advance, x_offset, y_offset} of the glyph as floats.
+inline Float4 loadPosition(const hb_glyph_position_t& position) {
+    return vcvtq_f32_s32(vld1q_s32(&position.x_advance));
+}
+inline Float4 load(const float* in) {
+    return vld1q_f32(in);
+}
+inline Float4 splat(float v) {
+    return vdupq_n_f32(v);
+}
+inline Float4 mul(Float4 a, Float4 b) {
+    return vmulq_f32(a, b);
+}
+inline Float4 add(Float4 a, Float4 b) {
+    return vaddq_f32(a, b);
+}
+inline void store(float* out, Float4 v) {
+    vst1q_f32(out, v);
+}
+// Stores the lanes truncated toward zero to ints.
+inline void storeTruncated(int32_t* out, Float4 v) {
+    vst1q_s32(out, vcvtq_s32_f32(v));
+}
+// Transposes the rows of four glyphs into the columns of four fields.
+inline void transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) {
+    const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+#define MINIKIN_HAS_FLOAT4 1
+#elif defined(__SSE2__)
+using Float4 = __m128;
+
+inline Float4 loadPosition(const hb_glyph_position_t& position) {
+    return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&position.x_advance)));
+}
+inline Float4 load(const float* in) {
+    return _mm_loadu_ps(in);
+}
+inline Float4 splat(float v) {
+    return _mm_set1_ps(v);
+}
+inline Float4 mul(Float4 a, Float4 b) {
+    return _mm_mul_ps(a, b);
+}
+inline Float4 add(Float4 a, Float4 b) {
+    return _mm_add_ps(a, b);
+}
+inline void store(float* out, Float4 v) {
+    _mm_storeu_ps(out, v);
+}
+inline void storeTruncated(int32_t* out, Float4 v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvttps_epi32(v));
+}
+inline void transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+#define MINIKIN_HAS_FLOAT4 1
+#endif
+
+}  // namespace
+
+void convertGlyphPositionsScalar(const hb_glyph_position_t* positions, uint32_t count, float skewX,
+                                 float* outXAdvances, float* outXOffsets, float* outYOffsets) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const float yOffset = -HBFixedToFloat(positions[i].y_offset);
+        // Kept as a separate multiplication so that it is not contracted into a fused
+        // multiply-add, which the SIMD path doesn't do either.
+        const float skew = yOffset * skewX;
+        outXAdvances[i] = HBFixedToFloat(positions[i].x_advance);
+        outXOffsets[i] = HBFixedToFloat(positions[i].x_offset) + skew;
+        outYOffsets[i] = yOffset;
+    }
+}
+
+void convertGlyphPositions(const hb_glyph_position_t* positions, uint32_t count, float skewX,
+                           float* outXAdvances, float* outXOffsets, float* outYOffsets) {
+    uint32_t i = 0;
+#ifdef MINIKIN_HAS_FLOAT4
+    // hb_glyph_position_t has five 32-bit fields and the first four are x_advance, y_advance,
+    // x_offset and y_offset. One load per glyph followed by a transpose gives a vector per field.
+    static_assert(sizeof(hb_glyph_position_t) == 5 * sizeof(int32_t),
+                  "Unexpected layout of hb_glyph_position_t");
+    const Float4 scale = splat(kFixedScale);
+    const Float4 negScale = splat(-kFixedScale);
+    const Float4 skew = splat(skewX);
+    for (; i + 4 <= count; i += 4) {
+        Float4 r0 = loadPosition(positions[i]);
+        Float4 r1 = loadPosition(positions[i + 1]);
+        Float4 r2 = loadPosition(positions[i + 2]);
+        Float4 r3 = loadPosition(positions[i + 3]);
+        // Now r0 is the x advances, r1 the y advances, r2 the x offsets and r3 the y offsets.
+        transpose(r0, r1, r2, r3);
+
+        const Float4 y = mul(r3, negScale);
+        store(outXAdvances + i, mul(r0, scale));
+        store(outXOffsets + i, add(mul(r2, scale), mul(y, skew)));
+        store(outYOffsets + i, y);
+    }
+#endif  // MINIKIN_HAS_FLOAT4
+    convertGlyphPositionsScalar(positions + i, count - i, skewX, outXAdvances + i, outXOffsets + i,
+                                outYOffsets + i);
+}
+
+void convertAdvancesToFixedScalar(const float* advances, uint32_t count, hb_position_t* out,
+                                  uint32_t outStride) {
+    uint8_t* outBytes = reinterpret_cast<uint8_t*>(out);
+    for (uint32_t i = 0; i < count; ++i) {
+        *reinterpret_cast<hb_position_t*>(outBytes + i * outStride) = HBFloatToFixed(advances[i]);
+    }
+}
+
+void convertAdvancesToFixed(const float* advances, uint32_t count, hb_position_t* out,
+                            uint32_t outStride) {
+    uint32_t i = 0;
+#ifdef MINIKIN_HAS_FLOAT4
+    // Multiplying by a power of two is exact, so this gives the same result as scalbnf(v, 8).
+    const Float4 scale = splat(256.0f);
+    uint8_t* outBytes = reinterpret_cast<uint8_t*>(out);
+    if (outStride == sizeof(hb_position_t)) {
+        for (; i + 4 <= count; i += 4) {
+            storeTruncated(out + i, mul(load(advances + i), scale));
+        }
+    } else {
+        // HarfBuzz passes the x_advance fields of its positions, so the stores are scattered.
+        int32_t fixed[4];
+        for (; i + 4 <= count; i += 4) {
+            storeTruncated(fixed, mul(load(advances + i), scale));
+            for (uint32_t j = 0; j < 4; ++j) {
+                *reinterpret_cast<hb_position_t*>(outBytes + (i + j) * outStride) = fixed[j];
+            }
+        }
+    }
+#endif  // MINIKIN_HAS_FLOAT4
+    convertAdvancesToFixedScalar(advances + i, count - i,
+                                 reinterpret_cast<hb_position_t*>(
+                                         reinterpret_cast<uint8_t*>(out) + i * outStride),
+                                 outStride);
+}
+
+}  // namespace minikin
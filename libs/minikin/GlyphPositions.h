@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_GLYPH_POSITIONS_H
+#define MINIKIN_GLYPH_POSITIONS_H
+
+#include <cstdint>
+
+#include <hb.h>
+
+namespace minikin {
+
+/*
+ * Converts the HarfBuzz glyph positions into pixels, the same as HBFixedToFloat does.
+ *
+ * The y offsets are negated since the y axis of minikin is pointing down, and the x offsets are
+ * skewed by skewX * yOffset. Each output array must have room for count values. The results are
+ * bit identical to convertGlyphPositionsScalar.
+ */
+void convertGlyphPositions(const hb_glyph_position_t* positions, uint32_t count, float skewX,
+                           float* outXAdvances, float* outXOffsets, float* outYOffsets);
+
+/*
+ * The portable implementation of convertGlyphPositions. Used for the tail of the SIMD loop and on
+ * the CPUs without NEON or SSE2. Exposed for testing.
+ */
+void convertGlyphPositionsScalar(const hb_glyph_position_t* positions, uint32_t count, float skewX,
+                                 float* outXAdvances, float* outXOffsets, float* outYOffsets);
+
+/*
+ * Converts the advances in pixels into HarfBuzz positions, the same as HBFloatToFixed does, i.e.
+ * truncating toward zero. The i-th result is written at i * outStride bytes from out. The results
+ * are bit identical to convertAdvancesToFixedScalar.
+ */
+void convertAdvancesToFixed(const float* advances, uint32_t count, hb_position_t* out,
+                            uint32_t outStride);
+
+/*
+ * The portable implementation of convertAdvancesToFixed. Exposed for testing.
+ */
+void convertAdvancesToFixedScalar(const float* advances, uint32_t count, hb_position_t* out,
+                                  uint32_t outStride);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_GLYPH_POSITIONS_H
@@ -25,9 +25,18 @@
 
 #include "minikin/Emoji.h"
 
+#include "LayoutBudget.h"
+#include "UnicodeProperties.h"
+
 namespace minikin {
 
-int32_t tailoredGraphemeClusterBreak(uint32_t c) {
+using unicode_tables::EXTENDED_PICTOGRAPHIC_BIT;
+using unicode_tables::GCB_MASK;
+using unicode_tables::OTHER_LETTER_BIT;
+using unicode_tables::VIRAMA_BIT;
+
+// Applies the tailoring to gcb, the grapheme cluster break of c.
+static int32_t tailorGraphemeClusterBreak(uint32_t c, int32_t gcb) {
     // Characters defined as Control that we want to treat them as Extend.
     // These are curated manually.
     if (c == 0x00AD                      // SHY
@@ -47,7 +56,11 @@ int32_t tailoredGraphemeClusterBreak(uint32_t c) {
     else if (c == 0x0E33)
         return U_GCB_OTHER;
     else
-        return u_getIntPropertyValue(c, UCHAR_GRAPHEME_CLUSTER_BREAK);
+        return gcb;
+}
+
+int32_t tailoredGraphemeClusterBreak(uint32_t c) {
+    return tailorGraphemeClusterBreak(c, getUnicodeProperties(c) & GCB_MASK);
 }
 
 // Returns true for all characters whose IndicSyllabicCategory is Pure_Killer.
@@ -126,7 +139,7 @@ bool GraphemeBreak::isGraphemeBreak(const float* advances, const uint16_t* buf,
     // Tailored version of Rule GB11
     // \p{Extended_Pictographic} Extend* ZWJ x \p{Extended_Pictographic}
     if (offset_back > start && p1 == U_GCB_ZWJ &&
-        u_hasBinaryProperty(c2, UCHAR_EXTENDED_PICTOGRAPHIC)) {
+        (getUnicodeProperties(c2) & EXTENDED_PICTOGRAPHIC_BIT)) {
         uint32_t c0 = 0;
         size_t offset_backback = offset_back;
         int32_t p0 = 0;
@@ -139,7 +152,7 @@ bool GraphemeBreak::isGraphemeBreak(const float* advances, const uint16_t* buf,
             p0 = tailoredGraphemeClusterBreak(c0);
         }
 
-        if (u_hasBinaryProperty(c0, UCHAR_EXTENDED_PICTOGRAPHIC)) {
+        if (getUnicodeProperties(c0) & EXTENDED_PICTOGRAPHIC_BIT) {
             return false;
         }
     }
@@ -176,15 +189,95 @@ bool GraphemeBreak::isGraphemeBreak(const float* advances, const uint16_t* buf,
     // Immediately after each virama (that is not just a pure killer) followed by a letter, we
     // disallow grapheme breaks (if we are here, we don't know about advances, or we already know
     // that c2 has no advance).
-    if (u_getIntPropertyValue(c1, UCHAR_CANONICAL_COMBINING_CLASS) == 9  // virama
-        && !isPureKiller(c1) &&
-        u_getIntPropertyValue(c2, UCHAR_GENERAL_CATEGORY) == U_OTHER_LETTER) {
+    if ((getUnicodeProperties(c1) & VIRAMA_BIT) && !isPureKiller(c1) &&
+        (getUnicodeProperties(c2) & OTHER_LETTER_BIT)) {
         return false;
     }
     // Rule GB999, Any ÷ Any
     return true;
 }
 
+// static
+std::vector<bool> GraphemeBreak::computeGraphemeBreaks(const float* advances, const uint16_t* buf,
+                                                       size_t start, size_t count) {
+    // Rule GB1, sot ÷; Rule GB2, ÷ eot
+    std::vector<bool> breaks(count + 1, true);
+    const size_t end = start + count;
+    if (count == 0) {
+        return breaks;
+    }
+
+    // Follows isGraphemeBreak for each code point boundary, with the code point before it kept
+    // from the previous iteration. The rules looking further back are rare enough to be left to
+    // isGraphemeBreak.
+    size_t offset = start;
+    uint32_t c1 = 0;
+    U16_NEXT(buf, offset, end, c1);
+    uint16_t props1 = getUnicodeProperties(c1);
+    int32_t p1 = tailorGraphemeClusterBreak(c1, props1 & GCB_MASK);
+    while (offset < end) {
+        if (U16_IS_TRAIL(buf[offset - 1]) && offset - start >= 2 && U16_IS_LEAD(buf[offset - 2])) {
+            // Don't break a surrogate pair.
+            breaks[offset - 1 - start] = false;
+        }
+        size_t next = offset;
+        uint32_t c2 = 0;
+        U16_NEXT(buf, next, end, c2);
+        const uint16_t props2 = getUnicodeProperties(c2);
+        const int32_t p2 = tailorGraphemeClusterBreak(c2, props2 & GCB_MASK);
+
+        bool isBreak = true;
+        if (U16_IS_TRAIL(buf[offset])) {
+            // A lonely trailing surrogate.
+            isBreak = true;
+        } else if (p1 == U_GCB_CR && p2 == U_GCB_LF) {
+            isBreak = false;  // Rule GB3
+        } else if (p1 == U_GCB_CONTROL || p1 == U_GCB_CR || p1 == U_GCB_LF ||
+                   p2 == U_GCB_CONTROL || p2 == U_GCB_CR || p2 == U_GCB_LF) {
+            isBreak = true;  // Rule GB4, GB5
+        } else if ((p1 == U_GCB_L &&
+                    (p2 == U_GCB_L || p2 == U_GCB_V || p2 == U_GCB_LV || p2 == U_GCB_LVT)) ||
+                   ((p1 == U_GCB_LV || p1 == U_GCB_V) && (p2 == U_GCB_V || p2 == U_GCB_T)) ||
+                   ((p1 == U_GCB_LVT || p1 == U_GCB_T) && p2 == U_GCB_T)) {
+            isBreak = false;  // Rule GB6, GB7, GB8
+        } else if (advances != nullptr && advances[offset - start] != 0.0) {
+            isBreak = true;
+        } else if (p2 == U_GCB_EXTEND || p2 == U_GCB_ZWJ || p2 == U_GCB_SPACING_MARK ||
+                   p1 == U_GCB_PREPEND) {
+            isBreak = false;  // Rule GB9, GB9a, GB9b
+        } else if ((p1 == U_GCB_ZWJ && (props2 & EXTENDED_PICTOGRAPHIC_BIT)) ||
+                   (p1 == U_GCB_REGIONAL_INDICATOR && p2 == U_GCB_REGIONAL_INDICATOR)) {
+            // Rule GB11, GB12 and GB13 look back further.
+            isBreak = isGraphemeBreak(advances, buf, start, count, offset);
+        } else if ((props1 & VIRAMA_BIT) && !isPureKiller(c1) && (props2 & OTHER_LETTER_BIT)) {
+            isBreak = false;  // Indic syllables
+        }
+        breaks[offset - start] = isBreak;
+
+        c1 = c2;
+        props1 = props2;
+        p1 = p2;
+        offset = next;
+    }
+    if (U16_IS_TRAIL(buf[end - 1]) && count >= 2 && U16_IS_LEAD(buf[end - 2])) {
+        breaks[end - 1 - start] = false;
+    }
+    return breaks;
+}
+
+// Returns true if the cursor moved the budget of code units inside a cluster, in which case it
+// stops at the offset unless it splits a surrogate pair. The ends of the text are always breaks.
+static bool isOverClusterBudget(const uint16_t* buf, size_t start, size_t count, size_t moved,
+                                size_t offset) {
+    const uint32_t maxClusterLength = LayoutBudget::getLimit(LayoutBudget::kClusterLength);
+    if (maxClusterLength == 0 || moved < maxClusterLength || offset <= start ||
+        offset >= start + count || (U16_IS_TRAIL(buf[offset]) && U16_IS_LEAD(buf[offset - 1]))) {
+        return false;
+    }
+    LayoutBudget::recordTrigger(LayoutBudget::kClusterLength);
+    return true;
+}
+
 size_t GraphemeBreak::getTextRunCursor(const float* advances, const uint16_t* buf, size_t start,
                                        size_t count, size_t offset, MoveOpt opt) {
     switch (opt) {
@@ -194,8 +287,11 @@ size_t GraphemeBreak::getTextRunCursor(const float* advances, const uint16_t* bu
             }
             FALLTHROUGH_INTENDED;
         case AT_OR_AFTER:
-            while (!isGraphemeBreak(advances, buf, start, count, offset)) {
+            for (size_t moved = 0; !isGraphemeBreak(advances, buf, start, count, offset);) {
                 offset++;
+                if (isOverClusterBudget(buf, start, count, ++moved, offset)) {
+                    break;
+                }
             }
             break;
         case BEFORE:
@@ -204,8 +300,11 @@ size_t GraphemeBreak::getTextRunCursor(const float* advances, const uint16_t* bu
             }
             FALLTHROUGH_INTENDED;
         case AT_OR_BEFORE:
-            while (!isGraphemeBreak(advances, buf, start, count, offset)) {
+            for (size_t moved = 0; !isGraphemeBreak(advances, buf, start, count, offset);) {
                 offset--;
+                if (isOverClusterBudget(buf, start, count, ++moved, offset)) {
+                    break;
+                }
             }
             break;
         case AT:
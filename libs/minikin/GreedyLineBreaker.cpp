@@ -16,12 +16,17 @@
 
 #define LOG_TAG "GreedyLineBreak"
 
+#include "GreedyLineBreaker.h"
+
+#include <algorithm>
+
 #include "minikin/Characters.h"
 #include "minikin/LineBreaker.h"
 #include "minikin/MeasuredText.h"
 #include "minikin/Range.h"
 #include "minikin/U16StringPiece.h"
 
+#include "CodeUnitScan.h"
 #include "HyphenatorMap.h"
 #include "LineBreakerUtil.h"
 #include "Locale.h"
@@ -34,36 +39,34 @@ namespace {
 
 constexpr uint32_t NOWHERE = 0xFFFFFFFF;
 
+// Sums of up to this many copies of a float are exact in double, since a float has a 24 bit
+// significand and a double a 53 bit one.
+constexpr uint32_t MAX_UNIFORM_WIDTH_TEXT_LENGTH = 1u << 29;
+
 class GreedyLineBreaker {
 public:
-    // User of this class must keep measured, lineWidthLimit, tabStop alive until the instance is
-    // destructed.
+    // User of this class must keep measured, lineWidthLimit, tabStop, scratch alive until the
+    // instance is destructed.
     GreedyLineBreaker(const U16StringPiece& textBuf, const MeasuredText& measured,
                       const LineWidth& lineWidthLimits, const TabStops& tabStops,
-                      bool enableHyphenation)
+                      bool enableHyphenation, GreedyLineBreakScratch* scratch)
             : mLineWidthLimit(lineWidthLimits.getAt(0)),
               mTextBuf(textBuf),
               mMeasuredText(measured),
               mLineWidthLimits(lineWidthLimits),
               mTabStops(tabStops),
-              mEnableHyphenation(enableHyphenation) {}
+              mEnableHyphenation(enableHyphenation),
+              mWordBreaker(scratch->wordBreaker),
+              mBreakPoints(scratch->breakPoints) {
+        mBreakPoints.clear();
+    }
 
     void process();
 
-    LineBreakResult getResult() const;
+    void getResult(bool computeExtents, LineBreakResult* out) const;
 
 private:
-    struct BreakPoint {
-        BreakPoint(uint32_t offset, float lineWidth, StartHyphenEdit startHyphen,
-                   EndHyphenEdit endHyphen)
-                : offset(offset),
-                  lineWidth(lineWidth),
-                  hyphenEdit(packHyphenEdit(startHyphen, endHyphen)) {}
-
-        uint32_t offset;
-        float lineWidth;
-        HyphenEdit hyphenEdit;
-    };
+    using BreakPoint = GreedyBreakPoint;
 
     inline uint32_t getPrevLineBreakOffset() {
         return mBreakPoints.empty() ? 0 : mBreakPoints.back().offset;
@@ -78,7 +81,7 @@ private:
     void updateLineWidth(uint16_t c, float width);
 
     // Break line if current line exceeds the line limit.
-    void processLineBreak(uint32_t offset, WordBreaker* breaker, bool doHyphenation);
+    void processLineBreak(uint32_t offset, WordBreakIterator* breaker, bool doHyphenation);
 
     // Try to break with previous word boundary.
     // Returns false if unable to break by word boundary.
@@ -89,7 +92,7 @@ private:
     //
     // This method keeps hyphenation until the line width after line break meets the line width
     // limit.
-    bool tryLineBreakWithHyphenation(const Range& range, WordBreaker* breaker);
+    bool tryLineBreakWithHyphenation(const Range& range, WordBreakIterator* breaker);
 
     // Do line break with each characters.
     //
@@ -99,6 +102,18 @@ private:
     // This method return true if there is no characters to be processed.
     bool doLineBreakWithGraphemeBounds(const Range& range);
 
+    // Returns true if the line widths can be computed per word instead of per character, and sets
+    // the width of the characters to outWidth. This is the case if the text is a single run
+    // without tabs whose characters all have the same width, and no hyphenation can change the
+    // widths. Sums of such widths are exact, so this gives the same result as the per character
+    // computation.
+    bool hasUniformWidth(const Run& run, float* outWidth) const;
+
+    // Does the same as the per character loop of process for the run, with the line widths
+    // computed from the number of characters of each word.
+    void processUniformWidthRun(const Run& run, float width, WordBreakIterator* breaker,
+                                uint32_t nextWordBoundaryOffset);
+
     // Info about the line currently processing.
     uint32_t mLineNum = 0;
     double mLineWidth = 0;
@@ -121,9 +136,10 @@ private:
     const LineWidth& mLineWidthLimits;
     const TabStops& mTabStops;
     bool mEnableHyphenation;
+    WordBreaker& mWordBreaker;
 
     // The result of line breaking.
-    std::vector<BreakPoint> mBreakPoints;
+    std::vector<BreakPoint>& mBreakPoints;
 
     MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(GreedyLineBreaker);
 };
@@ -160,7 +176,8 @@ bool GreedyLineBreaker::tryLineBreakWithWordBreak() {
     return true;
 }
 
-bool GreedyLineBreaker::tryLineBreakWithHyphenation(const Range& range, WordBreaker* breaker) {
+bool GreedyLineBreaker::tryLineBreakWithHyphenation(const Range& range,
+                                                    WordBreakIterator* breaker) {
     if (!mEnableHyphenation || mHyphenator == nullptr) {
         return false;
     }
@@ -255,11 +272,11 @@ bool GreedyLineBreaker::tryLineBreakWithHyphenation(const Range& range, WordBrea
 
 // TODO: Respect trailing line end spaces.
 bool GreedyLineBreaker::doLineBreakWithGraphemeBounds(const Range& range) {
-    float width = mMeasuredText.widths[range.getStart()];
+    float width = mMeasuredText.widthAt(range.getStart());
 
     // Starting from + 1 since at least one character needs to be assigned to a line.
     for (uint32_t i = range.getStart() + 1; i < range.getEnd(); ++i) {
-        const float w = mMeasuredText.widths[i];
+        const float w = mMeasuredText.widthAt(i);
         if (w == 0) {
             continue;  // w == 0 means here is not a grapheme bounds. Don't break here.
         }
@@ -294,7 +311,7 @@ void GreedyLineBreaker::updateLineWidth(uint16_t c, float width) {
     }
 }
 
-void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreaker* breaker,
+void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreakIterator* breaker,
                                          bool doHyphenation) {
     while (mLineWidth > mLineWidthLimit) {
         const Range lineRange(getPrevLineBreakOffset(), offset);  // The range we need to address.
@@ -319,9 +336,58 @@ void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreaker* breaker,
     }
 }
 
+bool GreedyLineBreaker::hasUniformWidth(const Run& run, float* outWidth) const {
+    const Range range = run.getRange();
+    if (mMeasuredText.runs.size() != 1 || (mEnableHyphenation && mHyphenator != nullptr) ||
+        range.isEmpty() || range.getEnd() >= MAX_UNIFORM_WIDTH_TEXT_LENGTH) {
+        return false;
+    }
+    if (findCodeUnit(mTextBuf.data(), range.getStart(), range.getEnd(), CHAR_TAB) !=
+        range.getEnd()) {
+        return false;
+    }
+    const float width = mMeasuredText.widthAt(range.getStart());
+    for (uint32_t i = range.getStart(); i < range.getEnd(); ++i) {
+        if (mMeasuredText.widthAt(i) != width) {
+            return false;
+        }
+    }
+    *outWidth = width;
+    return true;
+}
+
+void GreedyLineBreaker::processUniformWidthRun(const Run& run, float width,
+                                               WordBreakIterator* breaker,
+                                               uint32_t nextWordBoundaryOffset) {
+    const Range range = run.getRange();
+    uint32_t offset = range.getStart();
+    while (offset < range.getEnd()) {
+        const uint32_t end = nextWordBoundaryOffset > offset
+                                     ? std::min(nextWordBoundaryOffset, range.getEnd())
+                                     : range.getEnd();
+
+        // The line width ends at the last character which is not a line end space.
+        uint32_t lineEnd = end;
+        while (lineEnd > offset && isLineEndSpace(mTextBuf[lineEnd - 1])) {
+            --lineEnd;
+        }
+        if (lineEnd > offset) {
+            mLineWidth = mSumOfCharWidths + static_cast<double>(lineEnd - offset) * width;
+        }
+        mSumOfCharWidths += static_cast<double>(end - offset) * width;
+
+        if (end == nextWordBoundaryOffset) {
+            if (run.canBreak() || nextWordBoundaryOffset == range.getEnd()) {
+                processLineBreak(end, breaker, run.canBreak());
+            }
+            nextWordBoundaryOffset = breaker->next();
+        }
+        offset = end;
+    }
+}
+
 void GreedyLineBreaker::process() {
-    WordBreaker wordBreaker;
-    wordBreaker.setText(mTextBuf.data(), mTextBuf.size());
+    WordBreakIterator wordBreaker(mTextBuf, mMeasuredText, &mWordBreaker);
 
     // Following two will be initialized after the first iteration.
     uint32_t localeListId = LocaleListCache::kInvalidListId;
@@ -338,8 +404,14 @@ void GreedyLineBreaker::process() {
             localeListId = newLocaleListId;
         }
 
+        float uniformWidth = 0;
+        if (hasUniformWidth(*run, &uniformWidth)) {
+            processUniformWidthRun(*run, uniformWidth, &wordBreaker, nextWordBoundaryOffset);
+            continue;
+        }
+
         for (uint32_t i = range.getStart(); i < range.getEnd(); ++i) {
-            updateLineWidth(mTextBuf[i], mMeasuredText.widths[i]);
+            updateLineWidth(mTextBuf[i], mMeasuredText.widthAt(i));
 
             if ((i + 1) == nextWordBoundaryOffset) {
                 // Only process line break at word boundary and the run can break into some pieces.
@@ -358,29 +430,29 @@ void GreedyLineBreaker::process() {
     }
 }
 
-LineBreakResult GreedyLineBreaker::getResult() const {
+void GreedyLineBreaker::getResult(bool computeExtents, LineBreakResult* out) const {
     constexpr int TAB_BIT = 1 << 29;  // Must be the same in StaticLayout.java
 
-    LineBreakResult out;
+    out->clear();
     uint32_t prevBreakOffset = 0;
     for (const auto& breakPoint : mBreakPoints) {
         // TODO: compute these during line breaking if these takes longer time.
-        bool hasTabChar = false;
-        for (uint32_t i = prevBreakOffset; i < breakPoint.offset; ++i) {
-            hasTabChar |= mTextBuf[i] == CHAR_TAB;
+        const bool hasTabChar =
+                findCodeUnit(mTextBuf.data(), prevBreakOffset, breakPoint.offset, CHAR_TAB) !=
+                breakPoint.offset;
+
+        out->breakPoints.push_back(breakPoint.offset);
+        out->widths.push_back(breakPoint.lineWidth);
+        if (computeExtents) {
+            MinikinExtent extent =
+                    mMeasuredText.getExtent(mTextBuf, Range(prevBreakOffset, breakPoint.offset));
+            out->ascents.push_back(extent.ascent);
+            out->descents.push_back(extent.descent);
         }
-
-        MinikinExtent extent =
-                mMeasuredText.getExtent(mTextBuf, Range(prevBreakOffset, breakPoint.offset));
-        out.breakPoints.push_back(breakPoint.offset);
-        out.widths.push_back(breakPoint.lineWidth);
-        out.ascents.push_back(extent.ascent);
-        out.descents.push_back(extent.descent);
-        out.flags.push_back((hasTabChar ? TAB_BIT : 0) | static_cast<int>(breakPoint.hyphenEdit));
+        out->flags.push_back((hasTabChar ? TAB_BIT : 0) | static_cast<int>(breakPoint.hyphenEdit));
 
         prevBreakOffset = breakPoint.offset;
     }
-    return out;
 }
 
 }  // namespace
@@ -391,9 +463,31 @@ LineBreakResult breakLineGreedy(const U16StringPiece& textBuf, const MeasuredTex
     if (textBuf.size() == 0) {
         return LineBreakResult();
     }
-    GreedyLineBreaker lineBreaker(textBuf, measured, lineWidthLimits, tabStops, enableHyphenation);
+    GreedyLineBreakScratch scratch;
+    GreedyLineBreaker lineBreaker(textBuf, measured, lineWidthLimits, tabStops, enableHyphenation,
+                                  &scratch);
+    lineBreaker.process();
+    LineBreakResult result;
+    lineBreaker.getResult(true /* compute extents */, &result);
+    return result;
+}
+
+void breakLineGreedy(const U16StringPiece& textBuf, const MeasuredText& measured,
+                     const LineWidth& lineWidthLimits, const TabStops& tabStops,
+                     bool enableHyphenation, bool computeExtents,
+                     LineBreakScratch* lineBreakScratch, LineBreakResult* out) {
+    if (textBuf.size() == 0) {
+        out->clear();
+        return;
+    }
+    std::unique_ptr<GreedyLineBreakScratch>& scratch = lineBreakScratch->greedyScratch();
+    if (!scratch) {
+        scratch = std::make_unique<GreedyLineBreakScratch>();
+    }
+    GreedyLineBreaker lineBreaker(textBuf, measured, lineWidthLimits, tabStops, enableHyphenation,
+                                  scratch.get());
     lineBreaker.process();
-    return lineBreaker.getResult();
+    lineBreaker.getResult(computeExtents, out);
 }
 
 }  // namespace minikin
@@ -17,6 +17,9 @@
 #ifndef MINIKIN_GREEDY_LINE_BREAKER_H
 #define MINIKIN_GREEDY_LINE_BREAKER_H
 
+#include <vector>
+
+#include "minikin/Hyphenator.h"
 #include "minikin/LineBreaker.h"
 #include "minikin/MeasuredText.h"
 #include "minikin/U16StringPiece.h"
@@ -25,10 +28,36 @@
 
 namespace minikin {
 
+// A line break found by the greedy line breaker.
+struct GreedyBreakPoint {
+    GreedyBreakPoint(uint32_t offset, float lineWidth, StartHyphenEdit startHyphen,
+                     EndHyphenEdit endHyphen)
+            : offset(offset),
+              lineWidth(lineWidth),
+              hyphenEdit(packHyphenEdit(startHyphen, endHyphen)) {}
+
+    uint32_t offset;
+    float lineWidth;
+    HyphenEdit hyphenEdit;
+};
+
+// The memory the greedy line breaker reuses across paragraphs.
+struct GreedyLineBreakScratch {
+    std::vector<GreedyBreakPoint> breakPoints;
+    WordBreaker wordBreaker;
+};
+
 LineBreakResult breakLineGreedy(const U16StringPiece& textBuf, const MeasuredText& measured,
                                 const LineWidth& lineWidthLimits, const TabStops& tabStops,
                                 bool enableHyphenation);
 
+// Same as above, but uses the memory of scratch and writes the result to out. The extents of the
+// lines are only computed if computeExtents is true.
+void breakLineGreedy(const U16StringPiece& textBuf, const MeasuredText& measured,
+                     const LineWidth& lineWidthLimits, const TabStops& tabStops,
+                     bool enableHyphenation, bool computeExtents,
+                     LineBreakScratch* lineBreakScratch, LineBreakResult* out);
+
 }  // namespace minikin
 
 #endif  // MINIKIN_GREEDY_LINE_BREAKER_H
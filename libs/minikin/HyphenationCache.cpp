@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HyphenationCache.h"
+
+#include <cstring>
+
+#include "minikin/Hasher.h"
+
+namespace minikin {
+
+HyphenationKey::HyphenationKey(const Hyphenator* hyphenator, const U16StringPiece& word)
+        : mHyphenator(hyphenator),
+          mChars(word.data()),
+          mLength(word.size()),
+          mHash(Hasher()
+                        .update(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(hyphenator)))
+                        .updateShorts(word.data(), word.size())
+                        .hash()) {}
+
+bool HyphenationKey::operator==(const HyphenationKey& o) const {
+    return mHash == o.mHash && mHyphenator == o.mHyphenator && mLength == o.mLength &&
+           (mChars == o.mChars || memcmp(mChars, o.mChars, mLength * sizeof(uint16_t)) == 0);
+}
+
+void HyphenationCache::hyphenate(const Hyphenator& hyphenator, const U16StringPiece& word,
+                                 HyphenationType* out) {
+    if (word.size() == 0 || word.size() > MAX_WORD_LENGTH) {
+        mStats.bypass();
+        hyphenator.hyphenate(word, out);
+        return;
+    }
+    HyphenationKey key(&hyphenator, word);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Results of non-empty words are never empty, so an empty result is a miss.
+        const std::vector<HyphenationType>& cached = mCache.get(key);
+        if (!cached.empty()) {
+            mStats.hit();
+            std::copy(cached.begin(), cached.end(), out);
+            return;
+        }
+    }
+    mStats.miss();
+    // Hyphenate without holding the lock, so that other threads can use the cache meanwhile.
+    hyphenator.hyphenate(word, out);
+    key.copyWord();
+    std::vector<HyphenationType> result(out, out + word.size());
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCache.size() >= MAX_ENTRIES) {
+        mStats.evict();
+    }
+    mCache.put(key, result);
+    mStats.insert();
+}
+
+}  // namespace minikin
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_HYPHENATION_CACHE_H
+#define MINIKIN_HYPHENATION_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <utils/LruCache.h>
+
+#include "minikin/CacheStats.h"
+#include "minikin/Hyphenator.h"
+#include "minikin/Macros.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+// The key of the hyphenation cache. The word is only copied when the key is stored in the cache.
+class HyphenationKey {
+public:
+    HyphenationKey(const Hyphenator* hyphenator, const U16StringPiece& word);
+
+    void copyWord() {
+        mOwnedWord = std::make_shared<std::vector<uint16_t>>(mChars, mChars + mLength);
+        mChars = mOwnedWord->data();
+    }
+
+    bool operator==(const HyphenationKey& o) const;
+
+    android::hash_t hash() const { return mHash; }
+    uint32_t length() const { return mLength; }
+
+private:
+    const Hyphenator* mHyphenator;
+    const uint16_t* mChars;
+    std::shared_ptr<std::vector<uint16_t>> mOwnedWord;  // null for the lookup keys.
+    uint32_t mLength;
+    android::hash_t mHash;
+};
+
+inline android::hash_t hash_type(const HyphenationKey& key) {
+    return key.hash();
+}
+
+// A process-wide cache of the hyphenation results of words, so that the same words in different
+// paragraphs, or in the rebuilds of the same paragraph, are hyphenated only once.
+class HyphenationCache {
+public:
+    static HyphenationCache& getInstance() {
+        static HyphenationCache cache;
+        return cache;
+    }
+
+    // Same as hyphenator.hyphenate(word, out), i.e. out must have word.size() entries.
+    void hyphenate(const Hyphenator& hyphenator, const U16StringPiece& word, HyphenationType* out);
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCache.clear();
+    }
+
+    size_t getCacheSize() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCache.size();
+    }
+
+    // An upper bound, assuming every cached word is MAX_WORD_LENGTH long.
+    size_t getMemoryUsage() {
+        return getCacheSize() * (sizeof(HyphenationKey) + sizeof(std::vector<HyphenationType>) +
+                                 MAX_WORD_LENGTH * (sizeof(uint16_t) + sizeof(HyphenationType)));
+    }
+
+    const CacheStats& getStats() const { return mStats; }
+
+protected:
+    // protected for testing purposes.
+    static constexpr size_t MAX_ENTRIES = 2048;
+    // Longer words are rare enough that caching them isn't worth the memory.
+    static constexpr size_t MAX_WORD_LENGTH = 32;
+    HyphenationCache() : mCache(MAX_ENTRIES) {}  // singleton.
+
+private:
+    android::LruCache<HyphenationKey, std::vector<HyphenationType>> mCache GUARDED_BY(mMutex);
+    CacheStats mStats;
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_HYPHENATION_CACHE_H
@@ -17,10 +17,21 @@
 #include "minikin/Hyphenator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+#include <log/log.h>
 #include <unicode/uchar.h>
 #include <unicode/uscript.h>
 
@@ -46,7 +57,20 @@ struct AlphabetTable1 {
     static uint32_t value(uint32_t entry) { return entry & 0x7ff; }
 };
 
-struct Trie {
+struct Trie0 {
+    uint32_t version;
+    uint32_t char_mask;
+    uint32_t link_shift;
+    uint32_t link_mask;
+    uint32_t pattern_shift;
+    uint32_t n_entries;
+    uint32_t data[1];  // actually flexible array, size is known at runtime
+};
+
+// Same layout as Trie0, but each entry holds the pattern of the node its edge leads to instead of
+// the pattern of the node at the entry, so following an edge takes a single load. The data array
+// starts at a cache line boundary of the file.
+struct Trie1 {
     uint32_t version;
     uint32_t char_mask;
     uint32_t link_shift;
@@ -71,6 +95,8 @@ struct Pattern {
     }
 };
 
+constexpr uint32_t HYB_MAGIC = 0x62ad7968;
+
 struct Header {
     uint32_t magic;
     uint32_t version;
@@ -90,7 +116,15 @@ struct Header {
     const AlphabetTable1* alphabetTable1() const {
         return reinterpret_cast<const AlphabetTable1*>(bytes() + alphabet_offset);
     }
-    const Trie* trieTable() const { return reinterpret_cast<const Trie*>(bytes() + trie_offset); }
+    uint32_t trieVersion() const {
+        return *reinterpret_cast<const uint32_t*>(bytes() + trie_offset);
+    }
+    const Trie0* trieTable0() const {
+        return reinterpret_cast<const Trie0*>(bytes() + trie_offset);
+    }
+    const Trie1* trieTable1() const {
+        return reinterpret_cast<const Trie1*>(bytes() + trie_offset);
+    }
     const Pattern* patternTable() const {
         return reinterpret_cast<const Pattern*>(bytes() + pattern_offset);
     }
@@ -99,6 +133,11 @@ struct Header {
 // static
 Hyphenator* Hyphenator::loadBinary(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                                    const std::string& locale) {
+    if (patternData != nullptr &&
+        reinterpret_cast<const Header*>(patternData)->magic != HYB_MAGIC) {
+        ALOGE("Invalid hyb magic for locale %s. Using soft hyphens only.", locale.c_str());
+        patternData = nullptr;
+    }
     HyphenationLocale hyphenLocale = HyphenationLocale::OTHER;
     if (locale == "pl") {
         hyphenLocale = HyphenationLocale::POLISH;
@@ -110,22 +149,167 @@ Hyphenator* Hyphenator::loadBinary(const uint8_t* patternData, size_t minPrefix,
     return new Hyphenator(patternData, minPrefix, minSuffix, hyphenLocale);
 }
 
+// static
+bool Hyphenator::isValidBinary(const uint8_t* data, size_t size) {
+    if (data == nullptr || size < sizeof(Header)) {
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    return header->magic == HYB_MAGIC && header->file_size <= size &&
+           sizeof(Header) <= header->alphabet_offset &&
+           header->alphabet_offset < header->trie_offset &&
+           header->trie_offset < header->pattern_offset &&
+           header->pattern_offset < header->file_size;
+}
+
+// static
+Hyphenator* Hyphenator::loadFromFile(const std::string& path, size_t minPrefix, size_t minSuffix,
+                                     const std::string& locale) {
+#if !defined(_WIN32)
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("Failed to open %s", path.c_str());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ALOGE("Failed to stat %s", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping stays valid after closing the file.
+    if (addr == MAP_FAILED) {
+        ALOGE("Failed to map %s", path.c_str());
+        return nullptr;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(addr);
+    if (!isValidBinary(data, size)) {
+        ALOGE("%s is not a valid hyb file", path.c_str());
+        munmap(addr, size);
+        return nullptr;
+    }
+#else
+    // No mmap on Windows host builds. Read the file into a buffer that is never released instead.
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        ALOGE("Failed to open %s", path.c_str());
+        return nullptr;
+    }
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[4096];
+    size_t readSize;
+    while ((readSize = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + readSize);
+    }
+    fclose(fp);
+    if (!isValidBinary(buffer.data(), buffer.size())) {
+        ALOGE("%s is not a valid hyb file", path.c_str());
+        return nullptr;
+    }
+    const uint8_t* data = (new std::vector<uint8_t>(std::move(buffer)))->data();
+#endif
+    return loadBinary(data, minPrefix, minSuffix, locale);
+}
+
 Hyphenator::Hyphenator(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                        HyphenationLocale hyphenLocale)
         : mPatternData(patternData),
           mMinPrefix(minPrefix),
           mMinSuffix(minSuffix),
-          mHyphenationLocale(hyphenLocale) {}
+          mHyphenationLocale(hyphenLocale) {
+    if (mPatternData != nullptr && getHeader()->alphabetVersion() == 1) {
+        buildAlphabetPages();
+    }
+}
 
-void Hyphenator::hyphenate(const U16StringPiece& word, HyphenationType* out) const {
-    const size_t len = word.size();
+size_t Hyphenator::getMemoryUsage() const {
+    return sizeof(Hyphenator) + sizeof(uint16_t) * mAlphabetPageIndex.capacity() +
+           sizeof(uint16_t) * mAlphabetPages.capacity();
+}
+
+size_t Hyphenator::getPatternDataSize() const {
+    return mPatternData == nullptr ? 0 : getHeader()->file_size;
+}
+
+void Hyphenator::buildAlphabetPages() {
+    const AlphabetTable1* alphabet = getHeader()->alphabetTable1();
+    mAlphabetPageIndex.assign(256, 0);
+    mAlphabetPages.assign(256, 0);  // The empty page.
+    for (uint32_t i = 0; i < alphabet->n_entries; ++i) {
+        const uint32_t entry = alphabet->data[i];
+        const uint32_t codepoint = AlphabetTable1::codepoint(entry);
+        if (codepoint > 0xFFFF) {
+            continue;  // Never matches a code unit.
+        }
+        const uint32_t page = codepoint >> 8;
+        if (mAlphabetPageIndex[page] == 0) {
+            // Page 0 is the empty page, so the pages of the code units are 1 to 256.
+            mAlphabetPageIndex[page] = mAlphabetPages.size() >> 8;
+            mAlphabetPages.resize(mAlphabetPages.size() + 256, 0);
+        }
+        mAlphabetPages[(mAlphabetPageIndex[page] << 8) | (codepoint & 0xFF)] =
+                AlphabetTable1::value(entry);
+    }
+}
+
+static std::atomic<size_t> gLongestHyphenatedWord = {Hyphenator::DEFAULT_LONGEST_HYPHENATED_WORD};
+
+// static
+void Hyphenator::setLongestHyphenatedWord(size_t length) {
+    gLongestHyphenatedWord.store(length, std::memory_order_relaxed);
+}
+
+// static
+size_t Hyphenator::getLongestHyphenatedWord() {
+    return gLongestHyphenatedWord.load(std::memory_order_relaxed);
+}
+
+// Returns a buffer for the codes of a word of len code units: stackCodes if it is large enough, or
+// a thread-local buffer otherwise.
+template <size_t N>
+static uint16_t* getCodesBuffer(size_t len, uint16_t (&stackCodes)[N]) {
     const size_t paddedLen = len + 2;  // start and stop code each count for 1
-    if (mPatternData != nullptr && len >= mMinPrefix + mMinSuffix &&
-        paddedLen <= MAX_HYPHENATED_SIZE) {
-        uint16_t alpha_codes[MAX_HYPHENATED_SIZE];
-        const HyphenationType hyphenValue = alphabetLookup(alpha_codes, word);
+    if (paddedLen <= N) {
+        return stackCodes;
+    }
+    // The buffer only grows, so long words don't allocate once it has grown enough.
+    static thread_local std::vector<uint16_t> longWordCodes;
+    if (longWordCodes.size() < paddedLen) {
+        longWordCodes.resize(paddedLen);
+    }
+    return longWordCodes.data();
+}
+
+void Hyphenator::hyphenate(const U16StringPiece& word, HyphenationType* out) const {
+    uint16_t stackCodes[MAX_HYPHENATED_SIZE];
+    uint16_t* codes = usesPatterns(word.size()) ? getCodesBuffer(word.size(), stackCodes) : nullptr;
+    hyphenateWithCodes(word, codes, out);
+}
+
+void Hyphenator::hyphenate(const U16StringPiece& text, const std::vector<Range>& words,
+                           HyphenationType* out) const {
+    // The codes buffer of the longest word serves all the words.
+    size_t maxLength = 0;
+    for (const Range& range : words) {
+        maxLength = std::max<size_t>(maxLength, range.getLength());
+    }
+    uint16_t stackCodes[MAX_HYPHENATED_SIZE];
+    uint16_t* codes = usesPatterns(maxLength) ? getCodesBuffer(maxLength, stackCodes) : nullptr;
+    for (const Range& range : words) {
+        HyphenationType* wordOut = out + range.getStart();
+        std::fill(wordOut, wordOut + range.getLength(), HyphenationType::DONT_BREAK);
+        hyphenateWithCodes(text.substr(range), codes, wordOut);
+    }
+}
+
+void Hyphenator::hyphenateWithCodes(const U16StringPiece& word, uint16_t* codes,
+                                    HyphenationType* out) const {
+    if (usesPatterns(word.size())) {
+        const HyphenationType hyphenValue = alphabetLookup(codes, word);
         if (hyphenValue != HyphenationType::DONT_BREAK) {
-            hyphenateFromCodes(alpha_codes, paddedLen, hyphenValue, out);
+            hyphenateFromCodes(codes, word.size() + 2, hyphenValue, out);
             return;
         }
         // TODO: try NFC normalization
@@ -292,7 +476,7 @@ HyphenationType Hyphenator::alphabetLookup(uint16_t* alpha_codes,
                                            const U16StringPiece& word) const {
     const Header* header = getHeader();
     HyphenationType result = HyphenationType::BREAK_AND_INSERT_HYPHEN;
-    // TODO: check header magic
+    // The header magic is checked in loadBinary.
     uint32_t alphabetVersion = header->alphabetVersion();
     if (alphabetVersion == 0) {
         const AlphabetTable0* alphabet = header->alphabetTable0();
@@ -316,25 +500,17 @@ HyphenationType Hyphenator::alphabetLookup(uint16_t* alpha_codes,
         alpha_codes[word.size() + 1] = 0;  // word termination
         return result;
     } else if (alphabetVersion == 1) {
-        const AlphabetTable1* alphabet = header->alphabetTable1();
-        size_t n_entries = alphabet->n_entries;
-        const uint32_t* begin = alphabet->data;
-        const uint32_t* end = begin + n_entries;
         alpha_codes[0] = 0;
         for (size_t i = 0; i < word.size(); i++) {
             uint16_t c = word[i];
-            auto p = std::lower_bound(begin, end, c << 11);
-            if (p == end) {
-                return HyphenationType::DONT_BREAK;
-            }
-            uint32_t entry = *p;
-            if (AlphabetTable1::codepoint(entry) != c) {
+            uint16_t code = mAlphabetPages[(mAlphabetPageIndex[c >> 8] << 8) | (c & 0xFF)];
+            if (code == 0) {
                 return HyphenationType::DONT_BREAK;
             }
             if (result == HyphenationType::BREAK_AND_INSERT_HYPHEN) {
                 result = hyphenationTypeBasedOnScript(c);
             }
-            alpha_codes[i + 1] = AlphabetTable1::value(entry);
+            alpha_codes[i + 1] = code;
         }
         alpha_codes[word.size() + 1] = 0;
         return result;
@@ -342,6 +518,57 @@ HyphenationType Hyphenator::alphabetLookup(uint16_t* alpha_codes,
     return HyphenationType::DONT_BREAK;
 }
 
+// Combines the pattern for the substring ending at j into the buffer via point-wise max.
+static inline void applyPattern(const Pattern* pattern, uint32_t pat_ix, size_t j, size_t minPrefix,
+                                size_t maxOffset, uint8_t* buffer) {
+    // pat_ix contains a 3-tuple of length, shift (number of trailing zeros), and an offset into
+    // the buf pool.
+    uint32_t pat_entry = pattern->data[pat_ix];
+    int pat_len = Pattern::len(pat_entry);
+    int pat_shift = Pattern::shift(pat_entry);
+    const uint8_t* pat_buf = pattern->buf(pat_entry);
+    int offset = j + 1 - (pat_len + pat_shift);
+    // offset is the index within buffer that lines up with the start of pat_buf
+    int start = std::max((int)minPrefix - offset, 0);
+    int end = std::min(pat_len, (int)maxOffset - offset);
+    for (int k = start; k < end; k++) {
+        buffer[offset + k] = std::max(buffer[offset + k], pat_buf[k]);
+    }
+}
+
+// The number of trie walks walkTrie advances in turn.
+constexpr size_t INTERLEAVED_WALK_COUNT = 4;
+
+// Runs the walks of Liang's algorithm, one from each position of the padded codes but the last.
+// step(&node, j) follows the edge for codes[j] from node, applies the pattern of the new node and
+// returns true, or returns false if there is no such edge. The walks are independent and only
+// combine patterns with max, so they are interleaved: the loads of a walk, each depending on the
+// previous one, overlap with the loads of the other walks instead of waiting for each other.
+template <typename Step>
+static inline void walkTrie(size_t len, const Step& step) {
+    for (size_t i = 0; i < len - 1; i += INTERLEAVED_WALK_COUNT) {
+        const size_t count = std::min(INTERLEAVED_WALK_COUNT, len - 1 - i);
+        uint32_t nodes[INTERLEAVED_WALK_COUNT] = {};  // index into Trie table
+        size_t positions[INTERLEAVED_WALK_COUNT];     // len once the walk is over
+        for (size_t w = 0; w < count; w++) {
+            positions[w] = i + w;
+        }
+        size_t active = count;
+        while (active > 0) {
+            for (size_t w = 0; w < count; w++) {
+                size_t& j = positions[w];
+                if (j == len) {
+                    continue;
+                }
+                if (!step(&nodes[w], j) || ++j == len) {
+                    j = len;
+                    active--;
+                }
+            }
+        }
+    }
+}
+
 /**
  * Internal implementation, after conversion to codes. All case folding and normalization
  * has been done by now, and all characters have been found in the alphabet.
@@ -354,41 +581,50 @@ void Hyphenator::hyphenateFromCodes(const uint16_t* codes, size_t len, Hyphenati
     uint8_t* buffer = reinterpret_cast<uint8_t*>(out);
 
     const Header* header = getHeader();
-    const Trie* trie = header->trieTable();
     const Pattern* pattern = header->patternTable();
-    uint32_t char_mask = trie->char_mask;
-    uint32_t link_shift = trie->link_shift;
-    uint32_t link_mask = trie->link_mask;
-    uint32_t pattern_shift = trie->pattern_shift;
     size_t maxOffset = len - mMinSuffix - 1;
-    for (size_t i = 0; i < len - 1; i++) {
-        uint32_t node = 0;  // index into Trie table
-        for (size_t j = i; j < len; j++) {
+    if (header->trieVersion() == 1) {
+        const Trie1* trie = header->trieTable1();
+        uint32_t char_mask = trie->char_mask;
+        uint32_t link_shift = trie->link_shift;
+        uint32_t link_mask = trie->link_mask;
+        uint32_t pattern_shift = trie->pattern_shift;
+        walkTrie(len, [&](uint32_t* node, size_t j) {
             uint16_t c = codes[j];
-            uint32_t entry = trie->data[node + c];
-            if ((entry & char_mask) == c) {
-                node = (entry & link_mask) >> link_shift;
-            } else {
-                break;
+            uint32_t entry = trie->data[*node + c];
+            if ((entry & char_mask) != c) {
+                return false;
             }
-            uint32_t pat_ix = trie->data[node] >> pattern_shift;
-            // pat_ix contains a 3-tuple of length, shift (number of trailing zeros), and an offset
-            // into the buf pool. This is the pattern for the substring (i..j) we just matched,
-            // which we combine (via point-wise max) into the buffer vector.
+            *node = (entry & link_mask) >> link_shift;
+            // This is the pattern of the node we just moved to, i.e. the pattern for the
+            // substring (i..j).
+            uint32_t pat_ix = entry >> pattern_shift;
             if (pat_ix != 0) {
-                uint32_t pat_entry = pattern->data[pat_ix];
-                int pat_len = Pattern::len(pat_entry);
-                int pat_shift = Pattern::shift(pat_entry);
-                const uint8_t* pat_buf = pattern->buf(pat_entry);
-                int offset = j + 1 - (pat_len + pat_shift);
-                // offset is the index within buffer that lines up with the start of pat_buf
-                int start = std::max((int)mMinPrefix - offset, 0);
-                int end = std::min(pat_len, (int)maxOffset - offset);
-                for (int k = start; k < end; k++) {
-                    buffer[offset + k] = std::max(buffer[offset + k], pat_buf[k]);
-                }
+                applyPattern(pattern, pat_ix, j, mMinPrefix, maxOffset, buffer);
             }
-        }
+            return true;
+        });
+    } else {
+        const Trie0* trie = header->trieTable0();
+        uint32_t char_mask = trie->char_mask;
+        uint32_t link_shift = trie->link_shift;
+        uint32_t link_mask = trie->link_mask;
+        uint32_t pattern_shift = trie->pattern_shift;
+        walkTrie(len, [&](uint32_t* node, size_t j) {
+            uint16_t c = codes[j];
+            uint32_t entry = trie->data[*node + c];
+            if ((entry & char_mask) != c) {
+                return false;
+            }
+            *node = (entry & link_mask) >> link_shift;
+            uint32_t pat_ix = trie->data[*node] >> pattern_shift;
+            // This is the pattern for the substring (i..j) we just matched, which we combine
+            // into the buffer vector.
+            if (pat_ix != 0) {
+                applyPattern(pattern, pat_ix, j, mMinPrefix, maxOffset, buffer);
+            }
+            return true;
+        });
     }
     // Since the above calculation does not modify values outside
     // [mMinPrefix, len - mMinSuffix], they are left as 0 = DONT_BREAK.
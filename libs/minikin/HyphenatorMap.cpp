@@ -16,6 +16,8 @@
 
 #include "HyphenatorMap.h"
 
+#include <unordered_set>
+
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
 
@@ -31,7 +33,7 @@ constexpr int DEFAULT_MIN_PREFIX = 2;
 constexpr int DEFAULT_MAX_PREFIX = 2;
 }  // namespace
 
-// Following two function's implementations are here since Hyphenator.cpp can't include
+// Following three function's implementations are here since Hyphenator.cpp can't include
 // HyphenatorMap.h due to harfbuzz dependency on the host binary.
 void addHyphenator(const std::string& localeStr, const Hyphenator* hyphenator) {
     HyphenatorMap::add(localeStr, hyphenator);
@@ -41,6 +43,16 @@ void addHyphenatorAlias(const std::string& fromLocaleStr, const std::string& toL
     HyphenatorMap::addAlias(fromLocaleStr, toLocaleStr);
 }
 
+bool addHyphenatorFromFile(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                           size_t minSuffix) {
+    const Hyphenator* hyphenator = Hyphenator::loadFromFile(path, minPrefix, minSuffix, localeStr);
+    if (hyphenator == nullptr) {
+        return false;
+    }
+    HyphenatorMap::add(localeStr, hyphenator);
+    return true;
+}
+
 HyphenatorMap::HyphenatorMap()
         : mSoftHyphenOnlyHyphenator(
                   Hyphenator::loadBinary(nullptr, DEFAULT_MIN_PREFIX, DEFAULT_MAX_PREFIX, "")) {}
@@ -48,14 +60,50 @@ HyphenatorMap::HyphenatorMap()
 void HyphenatorMap::addInternal(const std::string& localeStr, const Hyphenator* hyphenator) {
     const Locale locale(localeStr);
     std::lock_guard<std::mutex> lock(mMutex);
-    // Overwrite even if there is already a fallback entry.
     mMap[locale.getIdentifier()] = hyphenator;
+    invalidateMemo();
 }
 
 void HyphenatorMap::clearInternal() {
     std::lock_guard<std::mutex> lock(mMutex);
     mMap.clear();
+    invalidateMemo();
+    // This is test only method, so nobody is reading the memo entries here.
+    mMemoEntryIndex.clear();
+    mMemoEntries.clear();
+}
+
+void HyphenatorMap::getMemoryUsageInternal(size_t* outBytes, size_t* outPatternDataSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unordered_set<const Hyphenator*> hyphenators = {mSoftHyphenOnlyHyphenator};
+    for (const auto& [id, hyphenator] : mMap) {
+        hyphenators.insert(hyphenator);
+    }
+    *outBytes = sizeof(HyphenatorMap) +
+                (sizeof(uint64_t) + sizeof(const Hyphenator*)) * mMap.size() +
+                sizeof(MemoEntry) * mMemoEntries.size() +
+                (sizeof(uint64_t) + sizeof(MemoEntry*)) * mMemoEntryIndex.size();
+    *outPatternDataSize = 0;
+    for (const Hyphenator* hyphenator : hyphenators) {
+        if (hyphenator != nullptr) {
+            *outBytes += hyphenator->getMemoryUsage();
+            *outPatternDataSize += hyphenator->getPatternDataSize();
+        }
+    }
+}
+
+size_t HyphenatorMap::getMemoEntryCountInternal() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMemoEntries.size();
+}
+
+void HyphenatorMap::invalidateMemo() {
+    for (auto& slot : mMemo) {
+        slot.store(nullptr, std::memory_order_release);
+    }
+    mMemoGeneration++;
 }
+
 void HyphenatorMap::addAliasInternal(const std::string& fromLocaleStr,
                                      const std::string& toLocaleStr) {
     const Locale fromLocale(fromLocaleStr);
@@ -66,13 +114,32 @@ void HyphenatorMap::addAliasInternal(const std::string& fromLocaleStr,
         ALOGE("Target Hyphenator not found.");
         return;
     }
-    // Overwrite even if there is already a fallback entry.
     mMap[fromLocale.getIdentifier()] = it->second;
+    invalidateMemo();
 }
 
 const Hyphenator* HyphenatorMap::lookupInternal(const Locale& locale) {
     const uint64_t id = locale.getIdentifier();
+    std::atomic<const MemoEntry*>& slot = mMemo[memoSlot(id)];
+    const MemoEntry* entry = slot.load(std::memory_order_acquire);
+    if (entry != nullptr && entry->id == id) {
+        return entry->hyphenator.load(std::memory_order_acquire);
+    }
+
     std::lock_guard<std::mutex> lock(mMutex);
+    MemoEntry*& current = mMemoEntryIndex[id];
+    if (current == nullptr) {
+        current = &mMemoEntries.emplace_back(id, lookupInternalLocked(locale), mMemoGeneration);
+    } else if (current->generation != mMemoGeneration) {
+        current->hyphenator.store(lookupInternalLocked(locale), std::memory_order_release);
+        current->generation = mMemoGeneration;
+    }
+    slot.store(current, std::memory_order_release);
+    return current->hyphenator.load(std::memory_order_relaxed);
+}
+
+const Hyphenator* HyphenatorMap::lookupInternalLocked(const Locale& locale) {
+    const uint64_t id = locale.getIdentifier();
     const Hyphenator* result = lookupByIdentifier(id);
     if (result != nullptr) {
         return result;  // Found with exact match.
@@ -81,35 +148,31 @@ const Hyphenator* HyphenatorMap::lookupInternal(const Locale& locale) {
     // First, try with dropping emoji extensions.
     result = lookupBySubtag(locale, LANGUAGE | REGION | SCRIPT | VARIANT);
     if (result != nullptr) {
-        goto insert_result_and_return;
+        return result;
     }
     // If not found, try with dropping script.
     result = lookupBySubtag(locale, LANGUAGE | REGION | VARIANT);
     if (result != nullptr) {
-        goto insert_result_and_return;
+        return result;
     }
     // If not found, try with dropping script and region code.
     result = lookupBySubtag(locale, LANGUAGE | VARIANT);
     if (result != nullptr) {
-        goto insert_result_and_return;
+        return result;
     }
     // If not found, try only with language code.
     result = lookupBySubtag(locale, LANGUAGE);
     if (result != nullptr) {
-        goto insert_result_and_return;
+        return result;
     }
     // Still not found, try only with script.
     result = lookupBySubtag(locale, SCRIPT);
     if (result != nullptr) {
-        goto insert_result_and_return;
+        return result;
     }
 
     // If not found, use soft hyphen only hyphenator.
-    result = mSoftHyphenOnlyHyphenator;
-
-insert_result_and_return:
-    mMap.insert(std::make_pair(id, result));
-    return result;
+    return mSoftHyphenOnlyHyphenator;
 }
 
 const Hyphenator* HyphenatorMap::lookupByIdentifier(uint64_t id) const {
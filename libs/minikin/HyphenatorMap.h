@@ -17,8 +17,10 @@
 #ifndef MINIKIN_HYPHENATOR_MAP_H
 #define MINIKIN_HYPHENATOR_MAP_H
 
-#include <map>
+#include <atomic>
+#include <deque>
 #include <mutex>
+#include <unordered_map>
 
 #include "minikin/Hyphenator.h"
 #include "minikin/Macros.h"
@@ -56,12 +58,19 @@ public:
         return getInstance().lookupInternal(locale);
     }
 
+    // Returns the bytes of the map and its hyphenators, and the size of the pattern data of the
+    // hyphenators. A hyphenator added for several locales is counted once.
+    static void getMemoryUsage(size_t* outBytes, size_t* outPatternDataSize) {
+        getInstance().getMemoryUsageInternal(outBytes, outPatternDataSize);
+    }
+
 protected:
-    // The following five methods are protected for testing purposes.
+    // The following six methods are protected for testing purposes.
     HyphenatorMap();  // Use getInstance() instead.
     void addInternal(const std::string& localeStr, const Hyphenator* hyphenator);
     void addAliasInternal(const std::string& fromLocaleStr, const std::string& toLocaleStr);
     const Hyphenator* lookupInternal(const Locale& locale);
+    size_t getMemoEntryCountInternal();
 
 private:
     static HyphenatorMap& getInstance() {  // Singleton.
@@ -70,13 +79,40 @@ private:
     }
 
     void clearInternal();
+    void getMemoryUsageInternal(size_t* outBytes, size_t* outPatternDataSize);
 
+    const Hyphenator* lookupInternalLocked(const Locale& locale) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
     const Hyphenator* lookupByIdentifier(uint64_t id) const EXCLUSIVE_LOCKS_REQUIRED(mMutex);
     const Hyphenator* lookupBySubtag(const Locale& locale, SubtagBits bits) const
             EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void invalidateMemo() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    static size_t memoSlot(uint64_t id) {
+        return (id * 0x9E3779B97F4A7C15ull) >> (64 - kLogMemoSize);
+    }
 
     const Hyphenator* mSoftHyphenOnlyHyphenator;
-    std::map<uint64_t, const Hyphenator*> mMap GUARDED_BY(mMutex);
+    std::unordered_map<uint64_t, const Hyphenator*> mMap GUARDED_BY(mMutex);
+
+    // A lock-free, direct-mapped memo of the resolved lookups in front of mMap. The slots point
+    // to the entries of mMemoEntries, which are never freed until clear(), so a reader racing with
+    // add or addAlias sees either a valid stale hyphenator or nullptr. There is one entry per
+    // locale ever looked up: an invalidation only bumps mMemoGeneration, and the next lookup of
+    // the locale resolves its entry again in place.
+    struct MemoEntry {
+        MemoEntry(uint64_t id, const Hyphenator* hyphenator, uint32_t generation)
+                : id(id), hyphenator(hyphenator), generation(generation) {}
+
+        const uint64_t id;
+        std::atomic<const Hyphenator*> hyphenator;
+        uint32_t generation;  // Guarded by mMutex.
+    };
+    static constexpr size_t kLogMemoSize = 6;
+    std::atomic<const MemoEntry*> mMemo[1 << kLogMemoSize] = {};
+    std::deque<MemoEntry> mMemoEntries GUARDED_BY(mMutex);
+    // The entries of mMemoEntries by locale identifier.
+    std::unordered_map<uint64_t, MemoEntry*> mMemoEntryIndex GUARDED_BY(mMutex);
+    uint32_t mMemoGeneration GUARDED_BY(mMutex) = 0;
 
     std::mutex mMutex;
 };
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyStats.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace minikin {
+
+std::atomic<bool> LatencyStats::sEnabled(false);
+
+namespace {
+
+using Counts = std::atomic<uint64_t>[LatencyStats::kStageCount][LatencyStats::kBucketCount];
+
+// The buckets of the live threads, and the sums of the exited ones.
+struct Registry {
+    std::mutex mutex;
+    std::vector<Counts*> threads GUARDED_BY(mutex);
+    Counts exited = {};
+
+    static Registry& getInstance() {
+        static Registry registry;
+        return registry;
+    }
+};
+
+// The buckets of a thread, registered on its first record. The registry is created before them,
+// hence destroyed after them, also for the main thread at exit.
+struct ThreadCounts {
+    Counts counts = {};
+
+    ThreadCounts() {
+        Registry& registry = Registry::getInstance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(&counts);
+    }
+
+    ~ThreadCounts() {
+        Registry& registry = Registry::getInstance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (uint32_t stage = 0; stage < LatencyStats::kStageCount; ++stage) {
+            for (uint32_t i = 0; i < LatencyStats::kBucketCount; ++i) {
+                registry.exited[stage][i].fetch_add(
+                        counts[stage][i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+            }
+        }
+        for (auto it = registry.threads.begin(); it != registry.threads.end(); ++it) {
+            if (*it == &counts) {
+                registry.threads.erase(it);
+                break;
+            }
+        }
+    }
+};
+
+// Returns the upper bound in nanoseconds of the bucket holding the given fraction of the values.
+uint64_t getPercentile(const LatencyStats::Buckets& buckets, uint64_t count, double fraction) {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t target = static_cast<uint64_t>(count * fraction);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < LatencyStats::kBucketCount; ++i) {
+        sum += buckets[i];
+        if (sum > target) {
+            return static_cast<uint64_t>(2) << i;
+        }
+    }
+    return static_cast<uint64_t>(2) << (LatencyStats::kBucketCount - 1);
+}
+
+}  // namespace
+
+void LatencyStats::record(Stage stage, uint64_t nanos) {
+    static thread_local ThreadCounts threadCounts;
+    // Only this thread writes to its counts, so a load and a store are enough.
+    std::atomic<uint64_t>& bucket = threadCounts.counts[stage][getBucketIndex(nanos)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+LatencyStats::Buckets LatencyStats::getBuckets(Stage stage) {
+    Registry& registry = Registry::getInstance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    Buckets buckets;
+    for (uint32_t i = 0; i < kBucketCount; ++i) {
+        buckets[i] = registry.exited[stage][i].load(std::memory_order_relaxed);
+        for (const Counts* counts : registry.threads) {
+            buckets[i] += (*counts)[stage][i].load(std::memory_order_relaxed);
+        }
+    }
+    return buckets;
+}
+
+void LatencyStats::reset() {
+    Registry& registry = Registry::getInstance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (uint32_t stage = 0; stage < kStageCount; ++stage) {
+        for (uint32_t i = 0; i < kBucketCount; ++i) {
+            // A record racing with the reset may be lost, which is fine for diagnostics.
+            registry.exited[stage][i].store(0, std::memory_order_relaxed);
+            for (Counts* counts : registry.threads) {
+                (*counts)[stage][i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+std::string LatencyStats::toString() {
+    static const char* const kStageNames[kStageCount] = {
+            "LayoutPiece", "itemize", "measure per 1000 code units", "breakLineOptimal"};
+    std::string out = isEnabled() ? "Minikin latency stats (ns):\n"
+                                  : "Minikin latency stats (ns, disabled):\n";
+    for (uint32_t stage = 0; stage < kStageCount; ++stage) {
+        const Buckets buckets = getBuckets(static_cast<Stage>(stage));
+        uint64_t count = 0;
+        for (uint64_t bucketCount : buckets) {
+            count += bucketCount;
+        }
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "  %s: count=%" PRIu64 " p50<%" PRIu64 " p90<%" PRIu64 " p99<%" PRIu64
+                 " buckets=",
+                 kStageNames[stage], count, getPercentile(buckets, count, 0.5),
+                 getPercentile(buckets, count, 0.9), getPercentile(buckets, count, 0.99));
+        out += buf;
+        // Only the non-empty buckets, as log2:count pairs.
+        bool first = true;
+        for (uint32_t i = 0; i < kBucketCount; ++i) {
+            if (buckets[i] != 0) {
+                snprintf(buf, sizeof(buf), "%s%u:%" PRIu64, first ? "" : ",", i, buckets[i]);
+                out += buf;
+                first = false;
+            }
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+}  // namespace minikin
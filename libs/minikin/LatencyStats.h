@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LATENCY_STATS_H
+#define MINIKIN_LATENCY_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Log2 histograms of the time spent in the expensive stages, for the dumpsys output.
+//
+// Each thread records into its own buckets, which only that thread writes, so recording a value is
+// an uncontended relaxed add. The buckets of all the threads, including the exited ones, are merged
+// when they are read. Recording is off by default, in which case a ScopedLatency costs one relaxed
+// load and no clock read.
+class LatencyStats {
+public:
+    enum Stage : uint32_t {
+        kLayoutPiece = 0,
+        kItemize = 1,
+        kMeasurePerKiloCodeUnit = 2,  // MeasuredText::measure time per 1000 code units.
+        kBreakLineOptimal = 3,
+        kStageCount = 4,
+    };
+
+    // The bucket i > 0 counts the values in [2^i, 2^(i+1)) nanoseconds, and the bucket 0 the
+    // values below 2. The last bucket also counts all the larger values, i.e. from 9 minutes on.
+    static constexpr uint32_t kBucketCount = 40;
+    using Buckets = std::array<uint64_t, kBucketCount>;
+
+    static void setEnabled(bool enabled) { sEnabled.store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+    // Records a value of the stage on the calling thread, whether or not recording is enabled.
+    static void record(Stage stage, uint64_t nanos);
+
+    // Returns the merged buckets of the stage.
+    static Buckets getBuckets(Stage stage);
+
+    static void reset();
+
+    // Returns a human readable summary of the stages for the dumpsys output, one line each.
+    static std::string toString();
+
+    static uint32_t getBucketIndex(uint64_t nanos) {
+        if (nanos < 2) {
+            return 0;
+        }
+        const uint32_t log2 = 63 - __builtin_clzll(nanos);
+        return log2 < kBucketCount ? log2 : kBucketCount - 1;
+    }
+
+private:
+    static std::atomic<bool> sEnabled;
+};
+
+// Records the time of the enclosing scope to a stage if LatencyStats is enabled on construction.
+class ScopedLatency {
+public:
+    // The time is scaled to 1000 code units of the given count, if it is not zero.
+    explicit ScopedLatency(LatencyStats::Stage stage, uint32_t codeUnitCount = 0)
+            : mStage(stage), mCodeUnitCount(codeUnitCount), mEnabled(LatencyStats::isEnabled()) {
+        if (mEnabled) {
+            mStart = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedLatency() {
+        if (!mEnabled) {
+            return;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - mStart;
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (mCodeUnitCount != 0) {
+            nanos = nanos * 1000 / mCodeUnitCount;
+        }
+        LatencyStats::record(mStage, nanos);
+    }
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(ScopedLatency);
+
+private:
+    const LatencyStats::Stage mStage;
+    const uint32_t mCodeUnitCount;
+    const bool mEnabled;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LATENCY_STATS_H
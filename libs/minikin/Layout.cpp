@@ -18,8 +18,12 @@
 
 #include "minikin/Layout.h"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -28,134 +32,392 @@
 #include <hb-ot.h>
 #include <log/log.h>
 #include <unicode/ubidi.h>
+#include <unicode/uchar.h>
 #include <unicode/utf16.h>
 #include <utils/LruCache.h>
 
+#include "minikin/BoundsCache.h"
+#include "minikin/CallRecorder.h"
 #include "minikin/Emoji.h"
 #include "minikin/HbUtils.h"
 #include "minikin/LayoutCache.h"
 #include "minikin/LayoutPieces.h"
 #include "minikin/Macros.h"
+#include "minikin/MemoryReport.h"
+#include "minikin/PaintIdCache.h"
+#include "minikin/Utf8Text.h"
 
 #include "BidiUtils.h"
+#include "DeferredLayoutQueue.h"
+#include "HyphenationCache.h"
+#include "LatencyStats.h"
+#include "LayoutBudget.h"
 #include "LayoutSplitter.h"
 #include "LayoutUtils.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "ScopedCallRecord.h"
+#include "TraceSpan.h"
+#include "WordBreakCache.h"
+#include "WordBreaker.h"
 
 namespace minikin {
 
+namespace {
+
+// The advances of measureTextCoarse(), from the cmap and the hmtx of the first family covering
+// each code point if its font is loaded, or else a guess from the em size: nothing for marks and
+// format characters, one em for East Asian wide characters, and half an em for the others.
+class CoarseAdvanceEstimator {
+public:
+    explicit CoarseAdvanceEstimator(const MinikinPaint& paint)
+            : mPaint(paint),
+              mEm(paint.size * paint.scaleX),
+              mLetterSpacing(paint.letterSpacing * mEm),
+              mFamily(nullptr),
+              mScale(0) {}
+
+    float get(uint32_t c) {
+        if (U_MASK(u_charType(c)) & (U_GC_MN_MASK | U_GC_ME_MASK | U_GC_CF_MASK)) {
+            return 0;
+        }
+        float advance;
+        if (!getFontAdvance(c, &advance)) {
+            const int32_t width = u_getIntPropertyValue(c, UCHAR_EAST_ASIAN_WIDTH);
+            advance = (width == U_EA_WIDE || width == U_EA_FULLWIDTH) ? mEm : mEm * 0.5f;
+        }
+        return advance + mLetterSpacing;
+    }
+
+private:
+    bool getFontAdvance(uint32_t c, float* advance) {
+        // Most code points are covered by the family of the previous one.
+        if (mFamily == nullptr || !mFamily->getCoverage().get(c)) {
+            mFamily = nullptr;
+            mFont.reset();
+            for (const std::shared_ptr<FontFamily>& family : mPaint.font->getFamilies()) {
+                if (family->getCoverage().get(c)) {
+                    mFamily = family.get();
+                    break;
+                }
+            }
+            if (mFamily == nullptr) {
+                return false;
+            }
+            // The family keeps the font alive.
+            const Font* font = mFamily->getClosestMatch(mPaint.fontStyle).font.get();
+            if (font->isBaseFontLoaded()) {
+                mFont = font->acquireBaseFont();
+                // The base font is scaled to the units per em.
+                mScale = mEm / hb_face_get_upem(hb_font_get_face(mFont.get()));
+            }
+        }
+        hb_codepoint_t glyph;
+        if (mFont == nullptr || !hb_font_get_nominal_glyph(mFont.get(), c, &glyph)) {
+            return false;
+        }
+        *advance = hb_font_get_glyph_h_advance(mFont.get(), glyph) * mScale;
+        return true;
+    }
+
+    const MinikinPaint& mPaint;
+    const float mEm;
+    const float mLetterSpacing;
+    const FontFamily* mFamily;  // The family of the previous code point.
+    HbFontUniquePtr mFont;      // The base font of mFamily, or nullptr if it is not loaded.
+    float mScale;               // From the units of mFont to pixels.
+};
+
+float estimateHyphenAdvance(std::pair<const uint32_t*, size_t> hyphenString,
+                            CoarseAdvanceEstimator* estimator) {
+    float advance = 0;
+    for (size_t i = 0; i < hyphenString.second; ++i) {
+        advance += estimator->get(hyphenString.first[i]);
+    }
+    return advance;
+}
+
+// Appends a Layout or a measureText call to the trace of CallRecorder.
+void recordLayoutCall(RecordedCall::Type type, uint64_t durationNanos,
+                      const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags,
+                      const MinikinPaint& paint, StartHyphenEdit startHyphen,
+                      EndHyphenEdit endHyphen) {
+    RecordedCall call;
+    call.type = type;
+    call.durationNanos = durationNanos;
+    call.text.assign(textBuf.data(), textBuf.data() + textBuf.size());
+    call.range = range;
+    call.bidiFlags = bidiFlags;
+    call.paint = RecordedPaint::from(paint);
+    call.startHyphen = startHyphen;
+    call.endHyphen = endHyphen;
+    CallRecorder::record(call);
+}
+
+}  // namespace
+
 void Layout::doLayout(const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags,
                       const MinikinPaint& paint, StartHyphenEdit startHyphen,
                       EndHyphenEdit endHyphen) {
+    const ScopedCallRecord callRecord;
     const uint32_t count = range.getLength();
-    mAdvances.resize(count, 0);
-    mGlyphs.reserve(count);
-    for (const BidiText::RunInfo& runInfo : BidiText(textBuf, range, bidiFlags)) {
-        doLayoutRunCached(textBuf, runInfo.range, runInfo.isRtl, paint, range.getStart(),
+    const BidiText bidiText(textBuf, range, bidiFlags);
+    MINIKIN_TRACE("Layout::doLayout", count, bidiText.getRunCount());
+    if (hasAdvances()) {
+        mAdvances.resize(count, 0);
+    }
+    if (hasGlyphs()) {
+        reserveGlyphs(count);
+    }
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    for (const BidiText::RunInfo& runInfo : bidiText) {
+        doLayoutRunCached(textBuf, runInfo.range, runInfo.isRtl, paint, paintId, range.getStart(),
                           startHyphen, endHyphen, this, nullptr);
     }
+    if (callRecord.isEnabled()) {
+        recordLayoutCall(RecordedCall::Type::kLayout, callRecord.getElapsedNanos(), textBuf, range,
+                         bidiFlags, paint, startHyphen, endHyphen);
+    }
 }
 
 float Layout::measureText(const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags,
                           const MinikinPaint& paint, StartHyphenEdit startHyphen,
                           EndHyphenEdit endHyphen, float* advances) {
+    const ScopedCallRecord callRecord;
+    const BidiText bidiText(textBuf, range, bidiFlags);
+    MINIKIN_TRACE("Layout::measureText", range.getLength(), bidiText.getRunCount());
     float advance = 0;
-    for (const BidiText::RunInfo& runInfo : BidiText(textBuf, range, bidiFlags)) {
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    for (const BidiText::RunInfo& runInfo : bidiText) {
         const size_t offset = range.toRangeOffset(runInfo.range.getStart());
         float* advancesForRun = advances ? advances + offset : nullptr;
-        advance += doLayoutRunCached(textBuf, runInfo.range, runInfo.isRtl, paint, 0, startHyphen,
-                                     endHyphen, nullptr, advancesForRun);
+        advance += doLayoutRunCached(textBuf, runInfo.range, runInfo.isRtl, paint, paintId, 0,
+                                     startHyphen, endHyphen, nullptr, advancesForRun);
+    }
+    if (callRecord.isEnabled()) {
+        recordLayoutCall(RecordedCall::Type::kMeasureText, callRecord.getElapsedNanos(), textBuf,
+                         range, bidiFlags, paint, startHyphen, endHyphen);
+    }
+    return advance;
+}
+
+Layout::BoundedMeasurement Layout::measureTextBounded(const U16StringPiece& textBuf,
+                                                      const Range& range, Bidi bidiFlags,
+                                                      const MinikinPaint& paint,
+                                                      StartHyphenEdit startHyphen,
+                                                      EndHyphenEdit endHyphen, float maxAdvance) {
+    const BidiText bidiText(textBuf, range, bidiFlags);
+    MINIKIN_TRACE("Layout::measureTextBounded", range.getLength(), bidiText.getRunCount());
+    // The runs and the pieces are visited in logical order, so that the measured part is a
+    // prefix of the range. ICU gives the runs in visual order, and LayoutSplitter gives the
+    // pieces of an RTL run from its end.
+    std::vector<BidiText::RunInfo> runs;
+    for (const BidiText::RunInfo& runInfo : bidiText) {
+        runs.push_back(runInfo);
+    }
+    std::sort(runs.begin(), runs.end(), [](const BidiText::RunInfo& a, const BidiText::RunInfo& b) {
+        return a.range.getStart() < b.range.getStart();
+    });
+
+    BoundedMeasurement result = {0, 0.0f};
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    std::vector<std::pair<Range, Range>> pieces;
+    for (const BidiText::RunInfo& runInfo : runs) {
+        if (!runInfo.range.isValid()) {
+            break;  // The rest of the text can't be measured as a prefix.
+        }
+        pieces.clear();
+        for (const auto[context, piece] : LayoutSplitter(textBuf, runInfo.range, runInfo.isRtl)) {
+            pieces.emplace_back(context, piece);
+        }
+        if (runInfo.isRtl) {
+            std::reverse(pieces.begin(), pieces.end());
+        }
+        for (const std::pair<Range, Range>& contextAndPiece : pieces) {
+            const Range& context = contextAndPiece.first;
+            const Range& piece = contextAndPiece.second;
+            const StartHyphenEdit pieceStartHyphen = piece.getStart() == runInfo.range.getStart()
+                                                             ? startHyphen
+                                                             : StartHyphenEdit::NO_EDIT;
+            const EndHyphenEdit pieceEndHyphen =
+                    piece.getEnd() == runInfo.range.getEnd() ? endHyphen : EndHyphenEdit::NO_EDIT;
+            const float wordSpacing =
+                    piece.getLength() == 1 && isWordSpace(textBuf[piece.getStart()])
+                            ? paint.wordSpacing
+                            : 0;
+            bool exceeded = false;
+            auto addPiece = [&](const LayoutPiece& layoutPiece, const MinikinPaint&) {
+                if (result.advance + layoutPiece.advance() + wordSpacing <= maxAdvance) {
+                    result.length += piece.getLength();
+                    result.advance += layoutPiece.advance() + wordSpacing;
+                    return;
+                }
+                const LayoutPiece::Span<float> advances = layoutPiece.advances();
+                for (uint32_t i = 0; i < advances.size(); ++i) {
+                    const float advance = advances[i] + (i == 0 ? wordSpacing : 0);
+                    if (result.advance + advance > maxAdvance) {
+                        exceeded = true;
+                        return;
+                    }
+                    result.length++;
+                    result.advance += advance;
+                }
+            };
+            LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
+                                                   piece - context.getStart(), paint, paintId,
+                                                   runInfo.isRtl, pieceStartHyphen, pieceEndHyphen,
+                                                   addPiece);
+            if (exceeded) {
+                return result;
+            }
+        }
+    }
+    return result;
+}
+
+float Layout::measureTextCoarse(const U16StringPiece& textBuf, const Range& range, Bidi bidiFlags,
+                                const MinikinPaint& paint, StartHyphenEdit startHyphen,
+                                EndHyphenEdit endHyphen, float* advances,
+                                PreciseMeasurementCallback callback) {
+    MINIKIN_TRACE("Layout::measureTextCoarse", range.getLength(), 0 /* runCount */);
+    CoarseAdvanceEstimator estimator(paint);
+    float advance = 0;
+    for (uint32_t i = range.getStart(); i < range.getEnd();) {
+        const uint32_t offset = i - range.getStart();
+        uint32_t c;
+        U16_NEXT(textBuf.data(), i, range.getEnd(), c);
+        float charAdvance = estimator.get(c);
+        if (U16_LENGTH(c) == 1 && isWordSpace(c)) {
+            charAdvance += paint.wordSpacing;
+        }
+        if (advances) {
+            // As with measureText(), the trailing surrogate gets no advance.
+            advances[offset] = charAdvance;
+            if (i - range.getStart() == offset + 2) {
+                advances[offset + 1] = 0;
+            }
+        }
+        advance += charAdvance;
+    }
+    // The inserted hyphens count for the first and the last code units.
+    if (!range.isEmpty()) {
+        const float startHyphenAdvance =
+                estimateHyphenAdvance(getHyphenString(startHyphen), &estimator);
+        const float endHyphenAdvance =
+                estimateHyphenAdvance(getHyphenString(endHyphen), &estimator);
+        if (advances) {
+            advances[0] += startHyphenAdvance;
+            advances[range.getLength() - 1] += endHyphenAdvance;
+        }
+        advance += startHyphenAdvance + endHyphenAdvance;
+    }
+
+    if (callback) {
+        std::vector<uint16_t> text(textBuf.data(), textBuf.data() + textBuf.size());
+        std::function<void()> task = [text = std::move(text), range, bidiFlags, paint, startHyphen,
+                                      endHyphen, callback = std::move(callback)]() {
+            std::vector<float> preciseAdvances(range.getLength());
+            const float preciseAdvance = measureText(text, range, bidiFlags, paint, startHyphen,
+                                                     endHyphen, preciseAdvances.data());
+            callback(preciseAdvance, preciseAdvances);
+        };
+        // Measured right away while the queue is full, so that the callback isn't lost.
+        if (!DeferredLayoutQueue::post(std::move(task))) {
+            task();
+        }
+    }
+    return advance;
+}
+
+float Layout::measureTextUtf8(const char* text, uint32_t size, const Range& range,
+                              Bidi bidiFlags, const MinikinPaint& paint,
+                              StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                              float* advances) {
+    const Utf8Text utf8Text(text, size);
+    const Range utf16Range = utf8Text.toUtf16(range);
+    std::vector<float> utf16Advances(advances ? utf16Range.getLength() : 0);
+    const float advance = measureText(utf8Text.utf16(), utf16Range, bidiFlags, paint, startHyphen,
+                                      endHyphen, advances ? utf16Advances.data() : nullptr);
+    if (advances) {
+        utf8Text.toUtf8Advances(utf16Advances.data(), utf16Range, range, advances);
     }
     return advance;
 }
 
 float Layout::doLayoutRunCached(const U16StringPiece& textBuf, const Range& range, bool isRtl,
-                                const MinikinPaint& paint, size_t dstStart,
+                                const MinikinPaint& paint, uint32_t paintId, size_t dstStart,
                                 StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                                 Layout* layout, float* advances) {
     if (!range.isValid()) {
         return 0.0f;  // ICU failed to retrieve the bidi run?
     }
-    float advance = 0;
+    // The pieces of the run, reused by the calls of the thread.
+    static thread_local std::vector<LayoutCache::RunPiece> pieces;
+    pieces.clear();
     for (const auto[context, piece] : LayoutSplitter(textBuf, range, isRtl)) {
         // Hyphenation only applies to the start/end of run.
         const StartHyphenEdit pieceStartHyphen =
                 (piece.getStart() == range.getStart()) ? startHyphen : StartHyphenEdit::NO_EDIT;
         const EndHyphenEdit pieceEndHyphen =
                 (piece.getEnd() == range.getEnd()) ? endHyphen : EndHyphenEdit::NO_EDIT;
-        float* advancesForRun =
-                advances ? advances + (piece.getStart() - range.getStart()) : nullptr;
-        advance += doLayoutWord(textBuf.data() + context.getStart(),
-                                piece.getStart() - context.getStart(), piece.getLength(),
-                                context.getLength(), isRtl, paint, piece.getStart() - dstStart,
-                                pieceStartHyphen, pieceEndHyphen, layout, advancesForRun);
+        pieces.push_back({context, piece, pieceStartHyphen, pieceEndHyphen});
     }
-    return advance;
-}
 
-class LayoutAppendFunctor {
-public:
-    LayoutAppendFunctor(Layout* layout, float* advances, float* totalAdvance, uint32_t outOffset,
-                        float wordSpacing)
-            : mLayout(layout),
-              mAdvances(advances),
-              mTotalAdvance(totalAdvance),
-              mOutOffset(outOffset),
-              mWordSpacing(wordSpacing) {}
-
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
-        if (mLayout) {
-            mLayout->appendLayout(layoutPiece, mOutOffset, mWordSpacing);
-        }
-        if (mAdvances) {
-            const std::vector<float>& advances = layoutPiece.advances();
-            std::copy(advances.begin(), advances.end(), mAdvances);
-        }
-        if (mTotalAdvance) {
-            *mTotalAdvance = layoutPiece.advance();
+    float advance = 0;
+    auto appendPiece = [&](uint32_t index, const LayoutPiece& layoutPiece,
+                           const MinikinPaint& /* paint */) {
+        const Range& piece = pieces[index].piece;
+        const float wordSpacing = piece.getLength() == 1 && isWordSpace(textBuf[piece.getStart()])
+                                          ? paint.wordSpacing
+                                          : 0;
+        if (layout) {
+            layout->appendLayout(layoutPiece, piece.getStart() - dstStart, wordSpacing);
         }
-    }
-
-private:
-    Layout* mLayout;
-    float* mAdvances;
-    float* mTotalAdvance;
-    const uint32_t mOutOffset;
-    const float mWordSpacing;
-};
-
-float Layout::doLayoutWord(const uint16_t* buf, size_t start, size_t count, size_t bufSize,
-                           bool isRtl, const MinikinPaint& paint, size_t bufStart,
-                           StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, Layout* layout,
-                           float* advances) {
-    float wordSpacing = count == 1 && isWordSpace(buf[start]) ? paint.wordSpacing : 0;
-    float totalAdvance = 0;
-
-    const U16StringPiece textBuf(buf, bufSize);
-    const Range range(start, start + count);
-    LayoutAppendFunctor f(layout, advances, &totalAdvance, bufStart, wordSpacing);
-    LayoutCache::getInstance().getOrCreate(textBuf, range, paint, isRtl, startHyphen, endHyphen, f);
-
-    if (wordSpacing != 0) {
-        totalAdvance += wordSpacing;
         if (advances) {
-            advances[0] += wordSpacing;
+            float* advancesForPiece = advances + (piece.getStart() - range.getStart());
+            const LayoutPiece::Span<float> pieceAdvances = layoutPiece.advances();
+            std::copy(pieceAdvances.begin(), pieceAdvances.end(), advancesForPiece);
+            if (wordSpacing != 0) {
+                advancesForPiece[0] += wordSpacing;
+            }
         }
-    }
-    return totalAdvance;
+        advance += layoutPiece.advance() + wordSpacing;
+    };
+    LayoutCache::getInstance().getOrCreateRun(textBuf, pieces, paint, paintId, isRtl, appendPiece);
+    return advance;
 }
 
 void Layout::appendLayout(const LayoutPiece& src, size_t start, float extraAdvance) {
-    for (size_t i = 0; i < src.glyphCount(); i++) {
-        mGlyphs.emplace_back(src.fontAt(i), src.glyphIdAt(i), mAdvance + src.pointAt(i).x,
-                             src.pointAt(i).y);
+    if (hasGlyphs()) {
+        // Map the font table of the piece into the one of this layout first, then each glyph only
+        // needs an index lookup.
+        const LayoutPiece::Span<FakedFont> srcFonts = src.fonts();
+        uint16_t fontMap[std::numeric_limits<uint8_t>::max() + 1];
+        for (size_t i = 0; i < srcFonts.size(); i++) {
+            const auto it = std::find(mFonts.begin(), mFonts.end(), srcFonts[i]);
+            fontMap[i] = it - mFonts.begin();
+            if (it == mFonts.end()) {
+                mFonts.push_back(srcFonts[i]);
+            }
+        }
+        const LayoutPiece::Span<uint8_t> fontIndices = src.fontIndices();
+        const LayoutPiece::Span<uint32_t> glyphIds = src.glyphIds();
+        const LayoutPiece::Span<Point> points = src.points();
+        for (size_t i = 0; i < src.glyphCount(); i++) {
+            mFontIndices.push_back(fontMap[fontIndices[i]]);
+            mGlyphIds.push_back(glyphIds[i]);
+            mPoints.emplace_back(mAdvance + points[i].x, points[i].y);
+        }
     }
-    const std::vector<float>& advances = src.advances();
-    for (size_t i = 0; i < advances.size(); i++) {
-        mAdvances[i + start] = advances[i];
-        if (i == 0) {
-            mAdvances[start] += extraAdvance;
+    if (hasAdvances()) {
+        const LayoutPiece::Span<float> advances = src.advances();
+        MINIKIN_ASSERT(start + advances.size() <= mAdvances.size(),
+                       "The layout must have the advances of the appended piece.");
+        for (size_t i = 0; i < advances.size(); i++) {
+            mAdvances[i + start] = advances[i];
+            if (i == 0) {
+                mAdvances[start] += extraAdvance;
+            }
         }
     }
     mAdvance += src.advance() + extraAdvance;
@@ -163,6 +425,60 @@ void Layout::appendLayout(const LayoutPiece& src, size_t start, float extraAdvan
 
 void Layout::purgeCaches() {
     LayoutCache::getInstance().clear();
+    HyphenationCache::getInstance().clear();
+    WordBreakCache::getInstance().clear();
+    invalidateSubFontCaches();
+}
+
+void Layout::setLatencyStatsEnabled(bool enabled) {
+    LatencyStats::setEnabled(enabled);
+}
+
+void Layout::setLayoutBudget(uint32_t maxClusterLength, uint32_t maxItemizeRuns,
+                             uint32_t maxShapingLength) {
+    LayoutBudget::setLimit(LayoutBudget::kClusterLength, maxClusterLength);
+    LayoutBudget::setLimit(LayoutBudget::kItemizeRuns, maxItemizeRuns);
+    LayoutBudget::setLimit(LayoutBudget::kShapingLength, maxShapingLength);
+}
+
+void Layout::dumpMinikinStats(int fd) {
+    LayoutCache& layoutCache = LayoutCache::getInstance();
+    BoundsCache& boundsCache = BoundsCache::getInstance();
+    const ICULineBreakerPoolImpl& breakerPool = ICULineBreakerPoolImpl::getInstance();
+    HyphenationCache& hyphenationCache = HyphenationCache::getInstance();
+    WordBreakCache& wordBreakCache = WordBreakCache::getInstance();
+
+    std::string out = "Minikin cache stats:\n";
+    out += layoutCache.getStats().toString("LayoutCache", layoutCache.getCacheSize(),
+                                           layoutCache.getMemoryUsage());
+    out += boundsCache.getStats().toString("BoundsCache", boundsCache.getCacheSize(),
+                                           boundsCache.getMemoryUsage());
+    out += LocaleListCache::getStats().toString("LocaleListCache", LocaleListCache::getCacheSize(),
+                                                LocaleListCache::getMemoryUsage());
+    out += PaintIdCache::getStats().toString("PaintIdCache", PaintIdCache::getCacheSize(),
+                                             PaintIdCache::getMemoryUsage());
+    out += hyphenationCache.getStats().toString("HyphenationCache",
+                                                hyphenationCache.getCacheSize(),
+                                                hyphenationCache.getMemoryUsage());
+    out += wordBreakCache.getStats().toString("WordBreakCache", wordBreakCache.getCacheSize(),
+                                              wordBreakCache.getMemoryUsage());
+    // The size of ICU break iterators is opaque, so no bytes are reported for the pool.
+    out += breakerPool.getStats().toString("ICULineBreakerPool",
+                                           ICULineBreakerPoolImpl::getTotalPoolSize(), 0);
+    out += LatencyStats::toString();
+    out += LayoutBudget::toString();
+    out += MemoryReport::collect().toString();
+
+    const char* data = out.data();
+    size_t remaining = out.size();
+    while (remaining > 0) {
+        const ssize_t written = write(fd, data, remaining);
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        remaining -= written;
+    }
 }
 
 }  // namespace minikin
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LayoutBudget.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace minikin {
+
+std::atomic<uint32_t> LayoutBudget::sLimits[kLimitCount] = {};
+std::atomic<uint64_t> LayoutBudget::sTriggerCounts[kLimitCount] = {};
+
+void LayoutBudget::resetTriggerCounts() {
+    for (uint32_t i = 0; i < kLimitCount; ++i) {
+        sTriggerCounts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string LayoutBudget::toString() {
+    static const char* const kNames[kLimitCount] = {"ClusterLength", "ItemizeRuns",
+                                                    "ShapingLength"};
+    std::string out = "LayoutBudget:";
+    for (uint32_t i = 0; i < kLimitCount; ++i) {
+        const Limit limit = static_cast<Limit>(i);
+        char buf[96];
+        snprintf(buf, sizeof(buf), " %s: limit %" PRIu32 ", triggered %" PRIu64 ";", kNames[i],
+                 getLimit(limit), getTriggerCount(limit));
+        out += buf;
+    }
+    out += "\n";
+    return out;
+}
+
+}  // namespace minikin
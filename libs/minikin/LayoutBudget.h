@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LAYOUT_BUDGET_H
+#define MINIKIN_LAYOUT_BUDGET_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace minikin {
+
+// The limits of the work spent on adversarial text, e.g. thousands of combining marks, long ZWJ
+// chains or runs of variation selectors. The text over a limit gets a degraded layout whose cost is
+// bounded instead. A limit of 0, the default, means no limit.
+//
+// The layouts already cached are not affected when the limits change.
+class LayoutBudget {
+public:
+    enum Limit : uint32_t {
+        // The code units GraphemeBreak::getTextRunCursor moves over looking for a grapheme break.
+        // The cursor stops in the middle of a longer cluster.
+        kClusterLength = 0,
+        // The font runs a layout piece is itemized into. The text after the last one is laid out
+        // with its font.
+        kItemizeRuns = 1,
+        // The code units shaped at once. The longer script runs are shaped in chunks, so nothing
+        // is shaped across the chunks.
+        kShapingLength = 2,
+        kLimitCount = 3,
+    };
+
+    static void setLimit(Limit limit, uint32_t value) {
+        sLimits[limit].store(value, std::memory_order_relaxed);
+    }
+    static uint32_t getLimit(Limit limit) { return sLimits[limit].load(std::memory_order_relaxed); }
+
+    // Counts a layout degraded by the limit.
+    static void recordTrigger(Limit limit) {
+        sTriggerCounts[limit].fetch_add(1, std::memory_order_relaxed);
+    }
+    static uint64_t getTriggerCount(Limit limit) {
+        return sTriggerCounts[limit].load(std::memory_order_relaxed);
+    }
+
+    static void resetTriggerCounts();
+
+    // Returns a human readable summary of the limits and their trigger counts for the dumpsys
+    // output.
+    static std::string toString();
+
+private:
+    static std::atomic<uint32_t> sLimits[kLimitCount];
+    static std::atomic<uint64_t> sTriggerCounts[kLimitCount];
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LAYOUT_BUDGET_H
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCache.h"
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+LayoutCacheKey::LayoutCacheKey(BufferReader* reader, const uint16_t* chars, uint32_t collectionId)
+        : mChars(chars), mId(collectionId) {
+    mNchars = reader->read<uint32_t>();
+    mStart = reader->read<uint32_t>();
+    mCount = reader->read<uint32_t>();
+    // Paint IDs are only valid in the process, so the paint fields are written instead.
+    mPaintId = PaintIdCache::readFrom(reader, collectionId);
+    mStartHyphen = static_cast<StartHyphenEdit>(reader->read<uint8_t>());
+    mEndHyphen = static_cast<EndHyphenEdit>(reader->read<uint8_t>());
+    mIsRtl = reader->read<uint8_t>();
+    mHash = computeHash();
+}
+
+void LayoutCacheKey::writeTo(BufferWriter* writer, const PaintIdCache::Key& paint) const {
+    writer->write<uint32_t>(mNchars);
+    writer->write<uint32_t>(mStart);
+    writer->write<uint32_t>(mCount);
+    PaintIdCache::writeTo(writer, paint);
+    writer->write<uint8_t>(static_cast<uint8_t>(mStartHyphen));
+    writer->write<uint8_t>(static_cast<uint8_t>(mEndHyphen));
+    writer->write<uint8_t>(mIsRtl);
+}
+
+void LayoutCacheKey::writeWithoutPaintTo(BufferWriter* writer) const {
+    writer->write<uint32_t>(mStart);
+    writer->write<uint32_t>(mCount);
+    writer->write<uint8_t>(static_cast<uint8_t>(mStartHyphen));
+    writer->write<uint8_t>(static_cast<uint8_t>(mEndHyphen));
+    writer->write<uint8_t>(mIsRtl);
+    writer->writeArray<uint16_t>(mChars, mNchars);
+}
+
+bool LayoutCacheKey::equalsWithoutPaint(BufferReader* reader) const {
+    if (reader->read<uint32_t>() != mStart || reader->read<uint32_t>() != mCount ||
+        reader->read<uint8_t>() != static_cast<uint8_t>(mStartHyphen) ||
+        reader->read<uint8_t>() != static_cast<uint8_t>(mEndHyphen) ||
+        reader->read<uint8_t>() != mIsRtl) {
+        return false;
+    }
+    const auto [chars, nchars] = reader->readArray<uint16_t>();
+    return nchars == mNchars && !memcmp(chars, mChars, mNchars * sizeof(uint16_t));
+}
+
+// static
+void LayoutCacheKey::validateWithoutPaint(BufferValidator* validator, uint32_t* outTextLength,
+                                          uint32_t* outLength) {
+    const uint32_t start = validator->read<uint32_t>();
+    *outLength = validator->read<uint32_t>();
+    validator->skip<uint8_t>();
+    validator->skip<uint8_t>();
+    validator->skip<uint8_t>();
+    *outTextLength = validator->readArray<uint16_t>().second;
+    if (start > *outTextLength || *outLength > *outTextLength - start) {
+        validator->fail();
+    }
+}
+
+// Takes the lock without waiting for another thread holding it, yielding to that thread instead,
+// unless cancelled is set. The returned lock doesn't own the mutex if it was cancelled.
+static std::unique_lock<std::mutex> lockYielding(std::mutex& mutex,
+                                                 const std::atomic<bool>& cancelled) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    while (!lock.owns_lock() && !cancelled.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+        lock.try_lock();
+    }
+    return lock;
+}
+
+bool LayoutCache::prewarm(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                          uint32_t paintId, bool dir, const std::atomic<bool>& cancelled) {
+    if (skipCache(paint, range)) {
+        return true;
+    }
+    if (hasInvariantPaint(paint)) {
+        // The bounds of an invariant piece are not used, see getOrCreateBounds().
+        const MinikinPaint invariantPaint = getInvariantPaint(paint);
+        return prewarmEntry(text, range, invariantPaint, PaintIdCache::getId(invariantPaint), dir,
+                            false /* needBounds */, cancelled);
+    }
+    return prewarmEntry(text, range, paint, paintId, dir, true /* needBounds */, cancelled);
+}
+
+bool LayoutCache::prewarmEntry(const U16StringPiece& text, const Range& range,
+                               const MinikinPaint& paint, uint32_t paintId, bool dir,
+                               bool needBounds, const std::atomic<bool>& cancelled) {
+    LayoutCacheKey key(text, range, paint, paintId, dir, StartHyphenEdit::NO_EDIT,
+                       EndHyphenEdit::NO_EDIT);
+    Shard& shard = getShard(key);
+    {
+        std::unique_lock<std::mutex> lock = lockYielding(shard.mMutex, cancelled);
+        if (!lock.owns_lock()) {
+            return false;
+        }
+        Entry* entry = shard.mCache.get(key).get();
+        if (entry != nullptr) {
+            if (needBounds && !entry->hasBounds) {
+                shard.setBounds(entry, paint);
+            }
+            return true;
+        }
+    }
+    std::shared_ptr<Entry> entry = findInSharedTable(key);
+    if (entry == nullptr) {
+        entry = std::make_shared<Entry>(text, range, dir, paint, StartHyphenEdit::NO_EDIT,
+                                        EndHyphenEdit::NO_EDIT, true /* retainText */,
+                                        false /* recordSafeBreaks */,
+                                        paint.letterSpacing != 0 /* recordLetterSpacing */);
+    }
+    if (needBounds) {
+        entry->setBounds(paint);
+    }
+    key.shareText(entry->piece.text());
+    std::unique_lock<std::mutex> lock = lockYielding(shard.mMutex, cancelled);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    shard.put(key, std::move(entry));
+    return true;
+}
+
+// The snapshot is a list of blocks, one per shard of the written cache including the one for the
+// long pieces. Each block is the number of entries followed by the entries. An entry is the index
+// of its font collection, the LayoutPiece with the text, and the rest of the LayoutCacheKey.
+void LayoutCache::writeSnapshot(BufferWriter* writer,
+                                const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    std::unordered_map<uint32_t, uint32_t> collectionIndices;
+    for (uint32_t i = 0; i < collections.size(); ++i) {
+        collectionIndices.emplace(collections[i]->getId(), i);
+    }
+
+    // The piece of an entry with a text owner does not have the text to write, and the letter
+    // spacing steps of an invariant piece are not written.
+    auto isWritten = [&collectionIndices](const LayoutCacheKey& key, const Entry& entry) {
+        return entry.textOwner == nullptr && !entry.piece.hasLetterSpacingSteps() &&
+               collectionIndices.count(key.getFontCollectionId()) != 0;
+    };
+
+    writer->write<uint32_t>(mShards.size() + 1);
+    // The paints are looked up once per snapshot. The entries of the evicted paints are not
+    // written, since no layout looks them up anymore.
+    std::unordered_map<uint32_t, std::optional<PaintIdCache::Key>> paints;
+    auto getPaint = [&paints](uint32_t paintId) -> const std::optional<PaintIdCache::Key>& {
+        auto [it, inserted] = paints.try_emplace(paintId);
+        if (inserted) {
+            PaintIdCache::Key paint;
+            if (PaintIdCache::getKey(paintId, &paint)) {
+                it->second = std::move(paint);
+            }
+        }
+        return it->second;
+    };
+    forEachShard([&](Shard& shard) {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        std::vector<std::pair<const LayoutCacheKey*, const Entry*>> written;
+        android::LruCache<LayoutCacheKey, std::shared_ptr<Entry>>::Iterator it(shard.mCache);
+        while (it.next()) {
+            if (isWritten(it.key(), *it.value()) && getPaint(it.key().getPaintId())) {
+                written.emplace_back(&it.key(), it.value().get());
+            }
+        }
+        writer->write<uint32_t>(written.size());
+        for (const auto& [key, entry] : written) {
+            auto collectionIndex = collectionIndices.find(key->getFontCollectionId());
+            writer->write<uint32_t>(collectionIndex->second);
+            entry->piece.writeTo(writer, *collections[collectionIndex->second]);
+            key->writeTo(writer, *getPaint(key->getPaintId()));
+        }
+    });
+}
+
+void LayoutCache::readSnapshot(BufferReader* reader,
+                               const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    const uint32_t blockCount = reader->read<uint32_t>();
+    for (uint32_t block = 0; block < blockCount; ++block) {
+        const uint32_t count = reader->read<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t collectionIndex = reader->read<uint32_t>();
+            MINIKIN_ASSERT(collectionIndex < collections.size(),
+                           "The snapshot refers to an unknown font collection");
+            const FontCollection& collection = *collections[collectionIndex];
+            std::shared_ptr<Entry> entry = std::make_shared<Entry>(reader, collection);
+            LayoutCacheKey key(reader, entry->piece.text(), collection.getId());
+            // The piece keeps the only copy of the text for the entry.
+            key.shareText(entry->piece.text());
+
+            Shard& shard = getShard(key);
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            shard.put(key, std::move(entry));
+        }
+    }
+}
+
+struct LayoutCache::SharedTable {
+    const void* buffer;
+    uint32_t bucketMask;
+    // The positions of the buckets in the buffer, and the end of the last one.
+    const uint32_t* bucketPositions;
+    std::vector<std::shared_ptr<FontCollection>> collections;
+    // The indices of the paints in the table by their PaintIdCache IDs in this process.
+    std::unordered_map<uint32_t, uint32_t> paintIndices;
+};
+
+// The shared table is the list of its paints, each the index of its font collection and the paint
+// fields, followed by the number of buckets, a power of two, and the positions of the buckets.
+// A bucket is the list of its entries, each the position of the next entry, the hash of the key
+// with the paint index, the paint index, the key without the paint, the index of the font
+// collection and the LayoutPiece.
+void LayoutCache::writeSharedTable(
+        BufferWriter* writer, const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    std::unordered_map<uint32_t, uint32_t> collectionIndices;
+    for (uint32_t i = 0; i < collections.size(); ++i) {
+        collectionIndices.emplace(collections[i]->getId(), i);
+    }
+
+    // The entries are kept alive, so that the keys can refer to the text of their pieces.
+    std::vector<std::pair<LayoutCacheKey, std::shared_ptr<Entry>>> entries;
+    forEachShard([&](Shard& shard) {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        android::LruCache<LayoutCacheKey, std::shared_ptr<Entry>>::Iterator it(shard.mCache);
+        while (it.next()) {
+            const Entry& entry = *it.value();
+            // The same entries as writeSnapshot() writes.
+            if (entry.textOwner == nullptr && !entry.piece.hasLetterSpacingSteps() &&
+                collectionIndices.count(it.key().getFontCollectionId()) != 0) {
+                entries.emplace_back(it.key(), it.value());
+            }
+        }
+    });
+
+    // The entries of the evicted paints are dropped, since no layout looks them up anymore.
+    std::unordered_map<uint32_t, uint32_t> paintIndices;
+    std::vector<std::pair<uint32_t, PaintIdCache::Key>> paints;  // (collection index, paint)
+    std::unordered_set<uint32_t> evictedPaintIds;
+    for (const auto& [key, entry] : entries) {
+        const uint32_t paintId = key.getPaintId();
+        if (paintIndices.count(paintId) != 0 || evictedPaintIds.count(paintId) != 0) {
+            continue;
+        }
+        PaintIdCache::Key paint;
+        if (PaintIdCache::getKey(paintId, &paint)) {
+            paintIndices.emplace(paintId, paints.size());
+            paints.emplace_back(collectionIndices[key.getFontCollectionId()], std::move(paint));
+        } else {
+            evictedPaintIds.insert(paintId);
+        }
+    }
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&evictedPaintIds](const auto& entry) {
+                                     return evictedPaintIds.count(entry.first.getPaintId()) != 0;
+                                 }),
+                  entries.end());
+    writer->write<uint32_t>(paints.size());
+    for (const auto& [collectionIndex, paint] : paints) {
+        writer->write<uint32_t>(collectionIndex);
+        PaintIdCache::writeTo(writer, paint);
+    }
+
+    uint32_t bucketCount = 1;
+    while (bucketCount < entries.size()) {
+        bucketCount *= 2;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> order;  // (bucket, entry index)
+    order.reserve(entries.size());
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+        const LayoutCacheKey& key = entries[i].first;
+        const uint32_t hash = key.hashWithPaintIndex(paintIndices[key.getPaintId()]);
+        order.emplace_back(hash & (bucketCount - 1), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    writer->write<uint32_t>(bucketCount);
+    const size_t positions = writer->reserveArray<uint32_t>(bucketCount + 1);
+    size_t next = 0;
+    for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+        writer->writeAt<uint32_t>(positions + bucket * sizeof(uint32_t), writer->size());
+        for (; next < order.size() && order[next].first == bucket; ++next) {
+            const auto& [key, entry] = entries[order[next].second];
+            const uint32_t paintIndex = paintIndices[key.getPaintId()];
+            const uint32_t collectionIndex = collectionIndices[key.getFontCollectionId()];
+            const size_t nextPosition = writer->reserve<uint32_t>();
+            writer->write<uint32_t>(key.hashWithPaintIndex(paintIndex));
+            writer->write<uint32_t>(paintIndex);
+            key.writeWithoutPaintTo(writer);
+            writer->write<uint32_t>(collectionIndex);
+            entry->piece.writeTo(writer, *collections[collectionIndex]);
+            writer->writeAt<uint32_t>(nextPosition, writer->size());
+        }
+    }
+    writer->writeAt<uint32_t>(positions + bucketCount * sizeof(uint32_t), writer->size());
+}
+
+// Returns true if the buffer holds a table written by writeSharedTable() for the collections. The
+// entries must be laid out one after the other in the order of their buckets, as writeSharedTable()
+// writes them, so that every position the lookups read is checked.
+static bool validateSharedTable(const void* buffer, size_t size,
+                                const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    BufferValidator validator(buffer, size);
+    const uint32_t paintCount = validator.read<uint32_t>();
+    for (uint32_t i = 0; i < paintCount && validator.ok(); ++i) {
+        if (validator.read<uint32_t>() >= collections.size()) {
+            return false;
+        }
+        PaintIdCache::validate(&validator);
+    }
+    const uint32_t bucketCount = validator.read<uint32_t>();
+    const auto [positions, positionCount] = validator.readArray<uint32_t>();
+    if (!validator.ok() || bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0 ||
+        positionCount != static_cast<uint64_t>(bucketCount) + 1) {
+        return false;
+    }
+    for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+        if (positions[bucket] != validator.pos()) {
+            return false;
+        }
+        while (validator.pos() < positions[bucket + 1]) {
+            const uint32_t next = validator.read<uint32_t>();
+            validator.skip<uint32_t>();  // The hash.
+            const uint32_t paintIndex = validator.read<uint32_t>();
+            uint32_t textLength;
+            uint32_t length;
+            LayoutCacheKey::validateWithoutPaint(&validator, &textLength, &length);
+            const uint32_t collectionIndex = validator.read<uint32_t>();
+            if (!validator.ok() || paintIndex >= paintCount ||
+                collectionIndex >= collections.size()) {
+                return false;
+            }
+            uint32_t pieceTextLength;
+            uint32_t advanceCount;
+            LayoutPiece::validate(&validator, *collections[collectionIndex], &pieceTextLength,
+                                  &advanceCount);
+            // The piece is the only copy of the text of the key once it is cached.
+            if (!validator.ok() || next != validator.pos() || pieceTextLength != textLength ||
+                advanceCount != length) {
+                return false;
+            }
+        }
+        if (validator.pos() != positions[bucket + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LayoutCache::setSharedTable(const void* buffer, size_t size,
+                                 const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    std::shared_ptr<SharedTable> table;
+    if (buffer != nullptr) {
+        if (!validateSharedTable(buffer, size, collections)) {
+            return false;
+        }
+        BufferReader reader(buffer);
+        table = std::make_shared<SharedTable>();
+        table->buffer = buffer;
+        table->collections = collections;
+        const uint32_t paintCount = reader.read<uint32_t>();
+        for (uint32_t i = 0; i < paintCount; ++i) {
+            const uint32_t collectionIndex = reader.read<uint32_t>();
+            const uint32_t paintId =
+                    PaintIdCache::readFrom(&reader, collections[collectionIndex]->getId(),
+                                           true /* pin */);
+            table->paintIndices.emplace(paintId, i);
+        }
+        table->bucketMask = reader.read<uint32_t>() - 1;
+        table->bucketPositions = reader.readArray<uint32_t>().first;
+    }
+    mHasSharedTable.store(table != nullptr, std::memory_order_relaxed);
+    std::atomic_store_explicit(&mSharedTable, std::shared_ptr<const SharedTable>(std::move(table)),
+                               std::memory_order_release);
+    return true;
+}
+
+std::shared_ptr<LayoutCache::Entry> LayoutCache::findInSharedTable(const LayoutCacheKey& key) {
+    if (!mHasSharedTable.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    const std::shared_ptr<const SharedTable> table =
+            std::atomic_load_explicit(&mSharedTable, std::memory_order_acquire);
+    if (table == nullptr) {
+        return nullptr;
+    }
+    auto paintIndex = table->paintIndices.find(key.getPaintId());
+    if (paintIndex == table->paintIndices.end()) {
+        mSharedTableStats.miss();
+        return nullptr;
+    }
+    const uint32_t hash = key.hashWithPaintIndex(paintIndex->second);
+    const uint32_t bucket = hash & table->bucketMask;
+    const uint32_t end = table->bucketPositions[bucket + 1];
+    for (uint32_t position = table->bucketPositions[bucket]; position < end;) {
+        BufferReader reader(table->buffer, position);
+        position = reader.read<uint32_t>();
+        if (reader.read<uint32_t>() != hash || reader.read<uint32_t>() != paintIndex->second ||
+            !key.equalsWithoutPaint(&reader)) {
+            continue;
+        }
+        const uint32_t collectionIndex = reader.read<uint32_t>();
+        mSharedTableStats.hit();
+        return std::make_shared<Entry>(&reader, *table->collections[collectionIndex]);
+    }
+    mSharedTableStats.miss();
+    return nullptr;
+}
+
+}  // namespace minikin
@@ -18,10 +18,15 @@
 
 #include "minikin/LayoutCore.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <mutex>
+#include <numeric>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <hb-icu.h>
@@ -32,15 +37,22 @@
 #include <utils/LruCache.h>
 
 #include "minikin/Emoji.h"
+#include "minikin/FontCollection.h"
 #include "minikin/HbUtils.h"
 #include "minikin/LayoutCache.h"
 #include "minikin/LayoutPieces.h"
 #include "minikin/Macros.h"
 
 #include "BidiUtils.h"
+#include "CodeUnitScan.h"
+#include "GlyphAdvanceCache.h"
+#include "GlyphPositions.h"
+#include "LatencyStats.h"
+#include "LayoutBudget.h"
 #include "LayoutUtils.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "TraceSpan.h"
 
 namespace minikin {
 
@@ -50,17 +62,18 @@ struct SkiaArguments {
     const MinikinFont* font;
     const MinikinPaint* paint;
     FontFakery fakery;
+    // Valid for the paint, since SubFontCache keys the arguments by what the advances depend on.
+    GlyphAdvanceCache advances;
 };
 
-// Returns true if the character needs to be excluded for the line spacing.
-inline bool isLineSpaceExcludeChar(uint16_t c) {
-    return c == CHAR_LINE_FEED || c == CHAR_CARRIAGE_RETURN;
-}
-
 static hb_position_t harfbuzzGetGlyphHorizontalAdvance(hb_font_t* /* hbFont */, void* fontData,
                                                        hb_codepoint_t glyph, void* /* userData */) {
     SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
-    float advance = args->font->GetHorizontalAdvance(glyph, *args->paint, args->fakery);
+    float advance;
+    if (!args->advances.get(glyph, &advance)) {
+        advance = args->font->GetHorizontalAdvance(glyph, *args->paint, args->fakery);
+        args->advances.put(glyph, advance);
+    }
     return 256 * advance + 0.5;
 }
 
@@ -70,25 +83,50 @@ static void harfbuzzGetGlyphHorizontalAdvances(hb_font_t* /* hbFont */, void* fo
                                                unsigned glyph_stride, hb_position_t* first_advance,
                                                unsigned advance_stride, void* /* userData */) {
     SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
-    std::vector<uint16_t> glyphVec(count);
-    std::vector<float> advVec(count);
+    // Kept per thread so that a shaping call doesn't allocate.
+    static thread_local std::vector<float> advVec;
+    // The glyphs not in the advance cache, where they are in the call, and their advances.
+    static thread_local std::vector<uint16_t> missGlyphs;
+    static thread_local std::vector<uint32_t> missIndices;
+    static thread_local std::vector<int32_t> missFixedAdvances;
+    static thread_local std::vector<float> missAdvances;
+    if (advVec.size() < count) {
+        advVec.resize(count);
+    }
+    missGlyphs.clear();
+    missIndices.clear();
 
     const hb_codepoint_t* glyph = first_glyph;
     for (uint32_t i = 0; i < count; ++i) {
-        glyphVec[i] = *glyph;
+        if (!args->advances.get(*glyph, &advVec[i])) {
+            missGlyphs.push_back(*glyph);
+            missIndices.push_back(i);
+        }
         glyph = reinterpret_cast<const hb_codepoint_t*>(reinterpret_cast<const uint8_t*>(glyph) +
                                                         glyph_stride);
     }
 
-    args->font->GetHorizontalAdvances(glyphVec.data(), count, *args->paint, args->fakery,
-                                      advVec.data());
-
-    hb_position_t* advances = first_advance;
-    for (uint32_t i = 0; i < count; ++i) {
-        *advances = HBFloatToFixed(advVec[i]);
-        advances = reinterpret_cast<hb_position_t*>(reinterpret_cast<uint8_t*>(advances) +
-                                                    advance_stride);
+    const uint32_t missCount = missGlyphs.size();
+    if (missCount != 0) {
+        missAdvances.resize(missCount);
+        missFixedAdvances.resize(missCount);
+        if (args->font->GetHorizontalAdvancesFixed(missGlyphs.data(), missCount, *args->paint,
+                                                    args->fakery, missFixedAdvances.data(),
+                                                    sizeof(int32_t))) {
+            // Exact, so they are converted back to the same fixed point values below.
+            for (uint32_t i = 0; i < missCount; ++i) {
+                missAdvances[i] = HBFixedToFloat(missFixedAdvances[i]);
+            }
+        } else {
+            args->font->GetHorizontalAdvances(missGlyphs.data(), missCount, *args->paint,
+                                              args->fakery, missAdvances.data());
+        }
+        for (uint32_t i = 0; i < missCount; ++i) {
+            advVec[missIndices[i]] = missAdvances[i];
+            args->advances.put(missGlyphs[i], missAdvances[i]);
+        }
     }
+    convertAdvancesToFixed(advVec.data(), count, first_advance, advance_stride);
 }
 
 static hb_bool_t harfbuzzGetGlyphHorizontalOrigin(hb_font_t* /* hbFont */, void* /* fontData */,
@@ -145,34 +183,93 @@ static hb_codepoint_t decodeUtf16(const uint16_t* chars, size_t len, ssize_t* it
     return (hb_codepoint_t)result;
 }
 
-static hb_script_t getScriptRun(const uint16_t* chars, size_t len, ssize_t* iter) {
-    if (size_t(*iter) == len) {
-        return HB_SCRIPT_UNKNOWN;
-    }
-    uint32_t cp = decodeUtf16(chars, len, iter);
-    hb_unicode_funcs_t* unicode_func = hb_unicode_funcs_get_default();
-    hb_script_t current_script = hb_unicode_script(unicode_func, cp);
-    for (;;) {
-        if (size_t(*iter) == len) break;
-        const ssize_t prev_iter = *iter;
-        cp = decodeUtf16(chars, len, iter);
-        const hb_script_t script = hb_unicode_script(unicode_func, cp);
-        if (script != current_script) {
-            if (current_script == HB_SCRIPT_INHERITED || current_script == HB_SCRIPT_COMMON) {
-                current_script = script;
-            } else if (script == HB_SCRIPT_INHERITED || script == HB_SCRIPT_COMMON) {
+static hb_script_t getScript(hb_unicode_funcs_t* unicodeFuncs, hb_codepoint_t cp) {
+    // The scripts of ASCII are looked up much more often than the others, so they are memoized.
+    static const auto kAsciiScripts = [] {
+        std::array<hb_script_t, 0x80> scripts;
+        hb_unicode_funcs_t* funcs = hb_unicode_funcs_get_default();
+        for (hb_codepoint_t c = 0; c < scripts.size(); ++c) {
+            scripts[c] = hb_unicode_script(funcs, c);
+        }
+        return scripts;
+    }();
+    return cp < kAsciiScripts.size() ? kAsciiScripts[cp] : hb_unicode_script(unicodeFuncs, cp);
+}
+
+static inline bool isCommonOrInherited(hb_script_t script) {
+    return script == HB_SCRIPT_INHERITED || script == HB_SCRIPT_COMMON;
+}
+
+struct ScriptRun {
+    ssize_t start;
+    ssize_t end;
+    hb_script_t script;
+};
+
+// Appends the script run [start, end), split into chunks of at most maxLength code units if
+// maxLength is not 0. The chunks don't split surrogate pairs. Returns true if the run is split.
+static bool pushScriptRun(const uint16_t* chars, ssize_t start, ssize_t end, hb_script_t script,
+                          uint32_t maxLength, std::vector<ScriptRun>* scriptRuns) {
+    if (maxLength == 0 || end - start <= static_cast<ssize_t>(maxLength)) {
+        scriptRuns->push_back({start, end, script});
+        return false;
+    }
+    while (start < end) {
+        ssize_t chunkEnd = std::min<ssize_t>(start + maxLength, end);
+        if (chunkEnd < end && U16_IS_LEAD(chars[chunkEnd - 1]) && U16_IS_TRAIL(chars[chunkEnd])) {
+            // Move the pair to the next chunk, or include it if it is alone in this one.
+            chunkEnd += chunkEnd - 1 > start ? -1 : 1;
+        }
+        scriptRuns->push_back({start, chunkEnd, script});
+        start = chunkEnd;
+    }
+    return true;
+}
+
+// Splits each of the font runs into the script runs to be shaped, in a single pass over the text
+// that decodes each code point and looks up its script once. Common and inherited characters join
+// the script run they are in, and a script run never crosses a font run. The script runs of
+// items[i] are scriptRuns[offsets[i]..offsets[i + 1]), in logical order.
+// Returns true if a script run longer than maxShapingLength is split into chunks.
+static bool segmentScriptRuns(const uint16_t* chars, const std::vector<FontCollection::Run>& items,
+                              uint32_t maxShapingLength, std::vector<ScriptRun>* scriptRuns,
+                              std::vector<uint32_t>* offsets) {
+    bool split = false;
+    hb_unicode_funcs_t* unicodeFuncs = hb_unicode_funcs_get_default();
+    scriptRuns->clear();
+    offsets->clear();
+    offsets->reserve(items.size() + 1);
+    for (const FontCollection::Run& run : items) {
+        offsets->push_back(scriptRuns->size());
+        if (run.start >= run.end) {
+            continue;
+        }
+        ssize_t iter = run.start;
+        ssize_t scriptRunStart = run.start;
+        hb_script_t currentScript = getScript(unicodeFuncs, decodeUtf16(chars, run.end, &iter));
+        while (iter < run.end) {
+            const ssize_t prevIter = iter;
+            const hb_script_t script = getScript(unicodeFuncs, decodeUtf16(chars, run.end, &iter));
+            if (script == currentScript || isCommonOrInherited(script)) {
                 continue;
+            }
+            if (isCommonOrInherited(currentScript)) {
+                currentScript = script;
             } else {
-                *iter = prev_iter;
-                break;
+                split |= pushScriptRun(chars, scriptRunStart, prevIter, currentScript,
+                                       maxShapingLength, scriptRuns);
+                scriptRunStart = prevIter;
+                currentScript = script;
             }
         }
+        if (currentScript == HB_SCRIPT_INHERITED) {
+            currentScript = HB_SCRIPT_COMMON;
+        }
+        split |= pushScriptRun(chars, scriptRunStart, run.end, currentScript, maxShapingLength,
+                               scriptRuns);
     }
-    if (current_script == HB_SCRIPT_INHERITED) {
-        current_script = HB_SCRIPT_COMMON;
-    }
-
-    return current_script;
+    offsets->push_back(scriptRuns->size());
+    return split;
 }
 
 /**
@@ -337,35 +434,222 @@ static inline uint32_t addToHbBuffer(const HbBufferUniquePtr& buffer, const uint
     return cpInfo[0].cluster;
 }
 
+// Fills the glyph infos and positions HarfBuzz would give for the code units in [runStart, runEnd)
+// if all of them have simple glyphs in the font, see Font::SimpleGlyphs, with the code unit
+// indices as clusters. Returns false, leaving the outputs unspecified, otherwise.
+static bool shapeSimpleGlyphs(const uint16_t* chars, ssize_t runStart, ssize_t runEnd,
+                              const Font& font, const HbFontUniquePtr& hbFont,
+                              std::vector<hb_glyph_info_t>* infos,
+                              std::vector<hb_glyph_position_t>* positions) {
+    if (chars[runStart] > Font::SimpleGlyphs::kLastChar) {
+        return false;  // Avoid analyzing the fonts of the other scripts.
+    }
+    const Font::SimpleGlyphs& simpleGlyphs = font.getSimpleGlyphs();
+    const size_t length = runEnd - runStart;
+    infos->resize(length);
+    for (size_t i = 0; i < length; ++i) {
+        const uint16_t glyph = simpleGlyphs.get(chars[runStart + i]);
+        if (glyph == 0) {
+            return false;
+        }
+        (*infos)[i] = {};
+        (*infos)[i].codepoint = glyph;
+        (*infos)[i].cluster = runStart + i;
+    }
+    positions->assign(length, hb_glyph_position_t{});
+    hb_font_get_glyph_h_advances(hbFont.get(), length, &(*infos)[0].codepoint,
+                                 sizeof(hb_glyph_info_t), &(*positions)[0].x_advance,
+                                 sizeof(hb_glyph_position_t));
+    return true;
+}
+
+// The HarfBuzz sub-fonts of the fonts, with the Skia callbacks and the scale of a paint, reused by
+// the layouts of a thread instead of being created and destroyed for each. They are keyed by what
+// the glyph advances depend on, since the arguments cache the advances. The callbacks read the
+// other properties of the paint through the arguments, which are pointed at the paint of each
+// layout before it is shaped. invalidateSubFontCaches() makes the caches of all the threads drop
+// their entries, so that they don't keep the released typefaces alive.
+class SubFontCache {
+public:
+    HbFontUniquePtr get(const FakedFont& fakedFont, const MinikinPaint& paint) {
+        const uint64_t epoch = getEpochCounter().load(std::memory_order_acquire);
+        if (mEpoch != epoch) {
+            mEntries.clear();
+            mEpoch = epoch;
+        }
+        // The entries keep their base fonts and typefaces alive, even when Font released them, so
+        // a matching parent is the current base font of the font, never a released one whose
+        // address was reused.
+        const HbFontUniquePtr& baseFont = fakedFont.font->baseFont();
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            Entry& entry = mEntries[i];
+            if (entry.parent == baseFont.get() && entry.size == paint.size &&
+                entry.scaleX == paint.scaleX && entry.skewX == paint.skewX &&
+                entry.fontFlags == paint.fontFlags && entry.fakery == fakedFont.fakery) {
+                entry.args->paint = &paint;
+                // Keep the most recently used first.
+                std::rotate(mEntries.begin(), mEntries.begin() + i, mEntries.begin() + i + 1);
+                return HbFontUniquePtr(hb_font_reference(mEntries.front().font.get()));
+            }
+        }
+
+        // We override some functions which are not thread safe.
+        const std::shared_ptr<MinikinFont>& typeface = fakedFont.font->typeface();
+        HbFontUniquePtr font(hb_font_create_sub_font(baseFont.get()));
+        SkiaArguments* args = new SkiaArguments{typeface.get(), &paint, fakedFont.fakery, {}};
+        hb_font_set_funcs(
+                font.get(), isColorBitmapFont(font) ? getFontFuncsForEmoji() : getFontFuncs(),
+                args, [](void* data) { delete reinterpret_cast<SkiaArguments*>(data); });
+        const double size = paint.size;
+        const double scaleX = paint.scaleX;
+        hb_font_set_ppem(font.get(), size * scaleX, size);
+        hb_font_set_scale(font.get(), HBFloatToFixed(size * scaleX), HBFloatToFixed(size));
+
+        if (mEntries.size() == kMaxEntries) {
+            mEntries.pop_back();
+        }
+        mEntries.insert(mEntries.begin(),
+                        Entry{baseFont.get(), paint.size, paint.scaleX, paint.skewX,
+                              paint.fontFlags, fakedFont.fakery, typeface,
+                              HbFontUniquePtr(hb_font_reference(font.get())), args});
+        return font;
+    }
+
+    static void invalidate() { getEpochCounter().fetch_add(1, std::memory_order_release); }
+
+private:
+    struct Entry {
+        const hb_font_t* parent;
+        float size;
+        float scaleX;
+        float skewX;
+        uint32_t fontFlags;
+        FontFakery fakery;
+        std::shared_ptr<MinikinFont> typeface;  // Keeps the font data of the parent alive.
+        HbFontUniquePtr font;
+        SkiaArguments* args;  // Owned by the font.
+    };
+
+    // A screen usually uses a few fonts at a few sizes.
+    static const size_t kMaxEntries = 16;
+    std::vector<Entry> mEntries;  // In the order of the last use.
+    uint64_t mEpoch = 0;
+
+    // Bumped to invalidate the caches of all the threads.
+    static std::atomic<uint64_t>& getEpochCounter() {
+        static std::atomic<uint64_t> epoch(0);
+        return epoch;
+    }
+};
+
+// The arrays filled while shaping. They are copied into the block of the LayoutPiece once the
+// sizes are known, so they are kept per thread to be reused by the next piece. The HarfBuzz buffer
+// and the feature list are kept for the same reason.
+struct ShapingScratch {
+    ShapingScratch() : buffer(hb_buffer_create()) {}
+
+    HbBufferUniquePtr buffer;  // Cleared before each script run.
+    std::vector<hb_feature_t> features;
+    std::vector<uint8_t> fontIndices;  // per glyph
+    std::vector<uint32_t> glyphIds;    // per glyph
+    std::vector<Point> points;         // per glyph
+    std::vector<float> advances;       // per code units
+    std::vector<FakedFont> fonts;
+    std::vector<bool> fontHasExtent;  // per font
+    std::vector<LayoutPiece::SafeBreak> safeBreaks;
+    // The letter spacing steps before each glyph, and of each code unit, if they are recorded.
+    std::vector<uint8_t> glyphSpacingSteps;
+    std::vector<uint8_t> advanceSpacingSteps;
+    // The positions of the glyphs of the current script run, converted in bulk.
+    std::vector<float> xAdvances;
+    std::vector<float> xOffsets;
+    std::vector<float> yOffsets;
+    // The script runs of all the font runs, and where those of each font run start.
+    std::vector<ScriptRun> scriptRuns;
+    std::vector<uint32_t> scriptRunOffsets;
+    // The shaping results of the current script run when HarfBuzz is skipped.
+    std::vector<hb_glyph_info_t> simpleInfos;
+    std::vector<hb_glyph_position_t> simplePositions;
+
+    void reset(size_t count, bool recordLetterSpacing) {
+        features.clear();
+        safeBreaks.clear();
+        glyphSpacingSteps.clear();
+        advanceSpacingSteps.assign(recordLetterSpacing ? count : 0, 0);
+        fontIndices.clear();
+        glyphIds.clear();
+        points.clear();
+        advances.assign(count, 0);  // Need zero filling.
+        fonts.clear();
+        fontHasExtent.clear();
+
+        // Usually the number of glyphs are less than number of code units.
+        fontIndices.reserve(count);
+        glyphIds.reserve(count);
+        points.reserve(count);
+    }
+};
+
+// Returns the family index and the font index in the family of the font. The family index is
+// families.size() if not found.
+std::pair<uint32_t, uint32_t> findFont(const std::vector<std::shared_ptr<FontFamily>>& families,
+                                       const std::shared_ptr<Font>& font) {
+    for (uint32_t familyIndex = 0; familyIndex < families.size(); ++familyIndex) {
+        const FontFamily& family = *families[familyIndex];
+        for (uint32_t fontIndex = 0; fontIndex < family.getNumFonts(); ++fontIndex) {
+            if (family.getFontRef(fontIndex) == font) {
+                return std::make_pair(familyIndex, fontIndex);
+            }
+        }
+    }
+    return std::make_pair(static_cast<uint32_t>(families.size()), 0u);
+}
+
 }  // namespace
 
+void invalidateSubFontCaches() {
+    SubFontCache::invalidate();
+}
+
 LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
                          const MinikinPaint& paint, StartHyphenEdit startHyphen,
-                         EndHyphenEdit endHyphen) {
+                         EndHyphenEdit endHyphen, bool retainText, bool recordSafeBreaks,
+                         bool recordLetterSpacing)
+        : mBlock(nullptr) {
+    ScopedLatency latency(LatencyStats::kLayoutPiece);
     const uint16_t* buf = textBuf.data();
     const size_t start = range.getStart();
     const size_t count = range.getLength();
     const size_t bufSize = textBuf.size();
 
-    mAdvances.resize(count, 0);  // Need zero filling.
-
-    // Usually the number of glyphs are less than number of code units.
-    mFontIndices.reserve(count);
-    mGlyphIds.reserve(count);
-    mPoints.reserve(count);
+    static thread_local ShapingScratch scratch;
+    scratch.reset(count, recordLetterSpacing);
+    std::vector<float>& advances = scratch.advances;
 
-    HbBufferUniquePtr buffer(hb_buffer_create());
+    const HbBufferUniquePtr& buffer = scratch.buffer;
     U16StringPiece substr = textBuf.substr(range);
+    const uint32_t maxItemizeRuns = LayoutBudget::getLimit(LayoutBudget::kItemizeRuns);
     std::vector<FontCollection::Run> items =
-            paint.font->itemize(substr, paint.fontStyle, paint.localeListId, paint.familyVariant);
+            paint.font->itemize(substr, paint.fontStyle, paint.localeListId, paint.familyVariant,
+                                maxItemizeRuns != 0 ? maxItemizeRuns : substr.size());
+    if (!items.empty() && static_cast<size_t>(items.back().end) < count) {
+        // The itemization stopped at the budget. The rest is laid out with the last font.
+        items.back().end = count;
+        LayoutBudget::recordTrigger(LayoutBudget::kItemizeRuns);
+    }
+    MINIKIN_TRACE("LayoutPiece::shape", count, items.size());
+    if (segmentScriptRuns(buf + start, items, LayoutBudget::getLimit(LayoutBudget::kShapingLength),
+                          &scratch.scriptRuns, &scratch.scriptRunOffsets)) {
+        LayoutBudget::recordTrigger(LayoutBudget::kShapingLength);
+    }
 
-    std::vector<hb_feature_t> features;
+    std::vector<hb_feature_t>& features = scratch.features;
     // Disable default-on non-required ligature features if letter-spacing
     // See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
     // "When the effective spacing between two characters is not zero (due to
     // either justification or a non-zero value of letter-spacing), user agents
     // should not apply optional ligatures."
-    if (fabs(paint.letterSpacing) > 0.03) {
+    if (disablesOptionalLigatures(paint.letterSpacing)) {
         static const hb_feature_t no_liga = {HB_TAG('l', 'i', 'g', 'a'), 0, 0, ~0u};
         static const hb_feature_t no_clig = {HB_TAG('c', 'l', 'i', 'g'), 0, 0, ~0u};
         features.push_back(no_liga);
@@ -373,6 +657,7 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
     }
     addFeatures(paint.fontFeatureSettings, &features);
 
+    static thread_local SubFontCache subFontCache;
     std::vector<HbFontUniquePtr> hbFonts;
     double size = paint.size;
     double scaleX = paint.scaleX;
@@ -381,6 +666,8 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
 
     float x = 0;
     float y = 0;
+    // The half spacings recorded since the last glyph.
+    uint8_t pendingSpacingSteps = 0;
     for (int run_ix = isRtl ? items.size() - 1 : 0;
          isRtl ? run_ix >= 0 : run_ix < static_cast<int>(items.size());
          isRtl ? --run_ix : ++run_ix) {
@@ -390,37 +677,26 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
         uint8_t font_ix;
         if (it == fontMap.end()) {
             // First time to see this font.
-            font_ix = mFonts.size();
-            mFonts.push_back(fakedFont);
+            font_ix = scratch.fonts.size();
+            scratch.fonts.push_back(fakedFont);
+            scratch.fontHasExtent.push_back(false);
             fontMap.insert(std::make_pair(fakedFont.font.get(), font_ix));
 
-            // We override some functions which are not thread safe.
-            HbFontUniquePtr font(hb_font_create_sub_font(fakedFont.font->baseFont().get()));
-            hb_font_set_funcs(
-                    font.get(), isColorBitmapFont(font) ? getFontFuncsForEmoji() : getFontFuncs(),
-                    new SkiaArguments({fakedFont.font->typeface().get(), &paint, fakedFont.fakery}),
-                    [](void* data) { delete reinterpret_cast<SkiaArguments*>(data); });
-            hbFonts.push_back(std::move(font));
+            hbFonts.push_back(subFontCache.get(fakedFont, paint));
         } else {
             font_ix = it->second;
         }
         const HbFontUniquePtr& hbFont = hbFonts[font_ix];
 
-        bool needExtent = false;
-        for (int i = run.start; i < run.end; ++i) {
-            if (!isLineSpaceExcludeChar(buf[i])) {
-                needExtent = true;
-                break;
+        // The extent of a font only needs to be added once.
+        if (!scratch.fontHasExtent[font_ix]) {
+            // The line feeds and carriage returns are excluded from the line spacing.
+            if (findCodeUnitNotAnyOf(buf, run.start, run.end, CHAR_LINE_FEED,
+                                     CHAR_CARRIAGE_RETURN) != static_cast<uint32_t>(run.end)) {
+                mExtent.extendBy(fakedFont.font->getExtent(paint, fakedFont.fakery));
+                scratch.fontHasExtent[font_ix] = true;
             }
         }
-        if (needExtent) {
-            MinikinExtent verticalExtent;
-            fakedFont.font->typeface()->GetFontExtent(&verticalExtent, paint, fakedFont.fakery);
-            mExtent.extendBy(verticalExtent);
-        }
-
-        hb_font_set_ppem(hbFont.get(), size * scaleX, size);
-        hb_font_set_scale(hbFont.get(), HBFloatToFixed(size * scaleX), HBFloatToFixed(size));
 
         // TODO: if there are multiple scripts within a font in an RTL run,
         // we need to reorder those runs. This is unlikely with our current
@@ -428,82 +704,137 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
 
         // Note: scriptRunStart and scriptRunEnd, as well as run.start and run.end, run between 0
         // and count.
-        ssize_t scriptRunEnd;
-        for (ssize_t scriptRunStart = run.start; scriptRunStart < run.end;
-             scriptRunStart = scriptRunEnd) {
-            scriptRunEnd = scriptRunStart;
-            hb_script_t script = getScriptRun(buf + start, run.end, &scriptRunEnd /* iterator */);
-            // After the last line, scriptRunEnd is guaranteed to have increased, since the only
-            // time getScriptRun does not increase its iterator is when it has already reached the
-            // end of the buffer. But that can't happen, since if we have already reached the end
-            // of the buffer, we should have had (scriptRunEnd == run.end), which means
-            // (scriptRunStart == run.end) which is impossible due to the exit condition of the for
-            // loop. So we can be sure that scriptRunEnd > scriptRunStart.
+        for (uint32_t script_ix = scratch.scriptRunOffsets[run_ix];
+             script_ix < scratch.scriptRunOffsets[run_ix + 1]; ++script_ix) {
+            const ScriptRun& scriptRun = scratch.scriptRuns[script_ix];
+            const ssize_t scriptRunStart = scriptRun.start;
+            const ssize_t scriptRunEnd = scriptRun.end;
+            const hb_script_t script = scriptRun.script;
 
             double letterSpace = 0.0;
             double letterSpaceHalf = 0.0;
+            // 1 if the half spacings of the run are recorded instead of applied.
+            uint8_t spacingStep = 0;
 
             if (paint.letterSpacing != 0.0 && isScriptOkForLetterspacing(script)) {
-                letterSpace = paint.letterSpacing * size * scaleX;
-                letterSpaceHalf = letterSpace * 0.5;
+                if (recordLetterSpacing) {
+                    spacingStep = 1;
+                } else {
+                    letterSpace = paint.letterSpacing * size * scaleX;
+                    letterSpaceHalf = letterSpace * 0.5;
+                }
             }
 
-            hb_buffer_clear_contents(buffer.get());
-            hb_buffer_set_script(buffer.get(), script);
-            hb_buffer_set_direction(buffer.get(), isRtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
-            const LocaleList& localeList = LocaleListCache::getById(paint.localeListId);
-            if (localeList.size() != 0) {
-                hb_language_t hbLanguage = localeList.getHbLanguage(0);
-                for (size_t i = 0; i < localeList.size(); ++i) {
-                    if (localeList[i].supportsHbScript(script)) {
-                        hbLanguage = localeList.getHbLanguage(i);
-                        break;
+            unsigned int numGlyphs;
+            hb_glyph_info_t* info;
+            hb_glyph_position_t* positions;
+            uint32_t clusterStart;
+            // Hyphen edits and RTL runs are left to HarfBuzz, which inserts the hyphens and
+            // reverses the glyphs.
+            const bool hasHyphenEdit =
+                    (scriptRunStart == 0 && startHyphen != StartHyphenEdit::NO_EDIT) ||
+                    (static_cast<size_t>(scriptRunEnd) == count &&
+                     endHyphen != EndHyphenEdit::NO_EDIT);
+            if (!isRtl && !hasHyphenEdit &&
+                shapeSimpleGlyphs(buf + start, scriptRunStart, scriptRunEnd, *fakedFont.font,
+                                  hbFont, &scratch.simpleInfos, &scratch.simplePositions)) {
+                numGlyphs = scratch.simpleInfos.size();
+                info = scratch.simpleInfos.data();
+                positions = scratch.simplePositions.data();
+                clusterStart = scriptRunStart;
+            } else {
+                hb_buffer_clear_contents(buffer.get());
+                hb_buffer_set_script(buffer.get(), script);
+                hb_buffer_set_direction(buffer.get(), isRtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
+                const LocaleList& localeList = LocaleListCache::getById(paint.localeListId);
+                if (localeList.size() != 0) {
+                    hb_language_t hbLanguage = localeList.getHbLanguage(0);
+                    for (size_t i = 0; i < localeList.size(); ++i) {
+                        if (localeList[i].supportsHbScript(script)) {
+                            hbLanguage = localeList.getHbLanguage(i);
+                            break;
+                        }
                     }
+                    hb_buffer_set_language(buffer.get(), hbLanguage);
                 }
-                hb_buffer_set_language(buffer.get(), hbLanguage);
-            }
 
-            const uint32_t clusterStart =
-                    addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart, scriptRunEnd,
-                                  startHyphen, endHyphen, hbFont);
+                clusterStart = addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart,
+                                             scriptRunEnd, startHyphen, endHyphen, hbFont);
 
-            hb_shape(hbFont.get(), buffer.get(), features.empty() ? NULL : &features[0],
-                     features.size());
-            unsigned int numGlyphs;
-            hb_glyph_info_t* info = hb_buffer_get_glyph_infos(buffer.get(), &numGlyphs);
-            hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(buffer.get(), NULL);
+                // Same as hb_shape, but with the shape plan cached by the font.
+                hb_segment_properties_t props;
+                hb_buffer_get_segment_properties(buffer.get(), &props);
+                HbShapePlanUniquePtr plan = fakedFont.font->getShapePlan(props, features);
+                hb_shape_plan_execute(plan.get(), hbFont.get(), buffer.get(),
+                                      features.empty() ? NULL : &features[0], features.size());
+                info = hb_buffer_get_glyph_infos(buffer.get(), &numGlyphs);
+                positions = hb_buffer_get_glyph_positions(buffer.get(), NULL);
+            }
 
             // At this point in the code, the cluster values in the info buffer correspond to the
             // input characters with some shift. The cluster value clusterStart corresponds to the
             // first character passed to HarfBuzz, which is at buf[start + scriptRunStart] whose
-            // advance needs to be saved into mAdvances[scriptRunStart]. So cluster values need to
+            // advance needs to be saved into advances[scriptRunStart]. So cluster values need to
             // be reduced by (clusterStart - scriptRunStart) to get converted to indices of
-            // mAdvances.
+            // advances.
             const ssize_t clusterOffset = clusterStart - scriptRunStart;
 
+            if (scratch.xAdvances.size() < numGlyphs) {
+                scratch.xAdvances.resize(numGlyphs);
+                scratch.xOffsets.resize(numGlyphs);
+                scratch.yOffsets.resize(numGlyphs);
+            }
+            convertGlyphPositions(positions, numGlyphs, paint.skewX, scratch.xAdvances.data(),
+                                  scratch.xOffsets.data(), scratch.yOffsets.data());
+
             if (numGlyphs) {
-                mAdvances[info[0].cluster - clusterOffset] += letterSpaceHalf;
+                advances[info[0].cluster - clusterOffset] += letterSpaceHalf;
                 x += letterSpaceHalf;
+                if (spacingStep != 0) {
+                    scratch.advanceSpacingSteps[info[0].cluster - clusterOffset] += 1;
+                    pendingSpacingSteps += 1;
+                }
             }
             for (unsigned int i = 0; i < numGlyphs; i++) {
                 const size_t clusterBaseIndex = info[i].cluster - clusterOffset;
                 if (i > 0 && info[i - 1].cluster != info[i].cluster) {
-                    mAdvances[info[i - 1].cluster - clusterOffset] += letterSpaceHalf;
-                    mAdvances[clusterBaseIndex] += letterSpaceHalf;
+                    advances[info[i - 1].cluster - clusterOffset] += letterSpaceHalf;
+                    advances[clusterBaseIndex] += letterSpaceHalf;
                     x += letterSpace;
+                    if (spacingStep != 0) {
+                        scratch.advanceSpacingSteps[info[i - 1].cluster - clusterOffset] += 1;
+                        scratch.advanceSpacingSteps[clusterBaseIndex] += 1;
+                        pendingSpacingSteps += 2;
+                    }
+                }
+
+                if (recordSafeBreaks && clusterBaseIndex != 0 && clusterBaseIndex < count) {
+                    // A break before the cluster is after the first glyph of the cluster in LTR,
+                    // and after the last one in RTL since HarfBuzz returns the glyphs in visual
+                    // order.
+                    const bool isBreakGlyph =
+                            isRtl ? (i + 1 == numGlyphs || info[i + 1].cluster != info[i].cluster)
+                                  : (i == 0 || info[i - 1].cluster != info[i].cluster);
+                    if (isBreakGlyph && !(hb_glyph_info_get_glyph_flags(&info[i]) &
+                                          HB_GLYPH_FLAG_UNSAFE_TO_BREAK)) {
+                        const uint32_t glyphIndex = scratch.glyphIds.size() + (isRtl ? 1 : 0);
+                        scratch.safeBreaks.push_back(
+                                {static_cast<uint32_t>(clusterBaseIndex), glyphIndex});
+                    }
                 }
 
                 hb_codepoint_t glyph_ix = info[i].codepoint;
-                float xoff = HBFixedToFloat(positions[i].x_offset);
-                float yoff = -HBFixedToFloat(positions[i].y_offset);
-                xoff += yoff * paint.skewX;
-                mFontIndices.push_back(font_ix);
-                mGlyphIds.push_back(glyph_ix);
-                mPoints.emplace_back(x + xoff, y + yoff);
-                float xAdvance = HBFixedToFloat(positions[i].x_advance);
+                scratch.fontIndices.push_back(font_ix);
+                scratch.glyphIds.push_back(glyph_ix);
+                scratch.points.emplace_back(x + scratch.xOffsets[i], y + scratch.yOffsets[i]);
+                if (recordLetterSpacing) {
+                    scratch.glyphSpacingSteps.push_back(pendingSpacingSteps);
+                    pendingSpacingSteps = 0;
+                }
+                const float xAdvance = scratch.xAdvances[i];
 
                 if (clusterBaseIndex < count) {
-                    mAdvances[clusterBaseIndex] += xAdvance;
+                    advances[clusterBaseIndex] += xAdvance;
                 } else {
                     ALOGE("cluster %zu (start %zu) out of bounds of count %zu", clusterBaseIndex,
                           start, count);
@@ -511,15 +842,446 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
                 x += xAdvance;
             }
             if (numGlyphs) {
-                mAdvances[info[numGlyphs - 1].cluster - clusterOffset] += letterSpaceHalf;
+                advances[info[numGlyphs - 1].cluster - clusterOffset] += letterSpaceHalf;
                 x += letterSpaceHalf;
+                if (spacingStep != 0) {
+                    scratch.advanceSpacingSteps[info[numGlyphs - 1].cluster - clusterOffset] += 1;
+                    pendingSpacingSteps += 1;
+                }
             }
         }
     }
-    mFontIndices.shrink_to_fit();
-    mGlyphIds.shrink_to_fit();
-    mPoints.shrink_to_fit();
+    mGlyphCount = scratch.glyphIds.size();
+    mAdvanceCount = count;
+    mTextLength = retainText ? bufSize : 0;
+    mFontCount = scratch.fonts.size();
     mAdvance = x;
+    if (isRtl) {
+        // The runs and the glyphs in them are visited in decreasing order of offsets.
+        std::reverse(scratch.safeBreaks.begin(), scratch.safeBreaks.end());
+    }
+    mSafeBreakCount = scratch.safeBreaks.size();
+    std::vector<uint8_t>& spacingSteps = scratch.glyphSpacingSteps;
+    if (recordLetterSpacing) {
+        spacingSteps.insert(spacingSteps.end(), scratch.advanceSpacingSteps.begin(),
+                            scratch.advanceSpacingSteps.end());
+        spacingSteps.push_back(pendingSpacingSteps);
+    }
+    mSpacingStepCount = spacingSteps.size();
+    initBlock(scratch.fonts.data(), scratch.points.data(), scratch.glyphIds.data(),
+              advances.data(), scratch.safeBreaks.data(), buf, scratch.fontIndices.data(),
+              spacingSteps.data());
+}
+
+LayoutPiece::LayoutPiece(BufferReader* reader, const FontCollection& collection)
+        : mBlock(nullptr) {
+    const std::vector<std::shared_ptr<FontFamily>>& families = collection.getFamilies();
+    mFontCount = reader->read<uint32_t>();
+    std::vector<FakedFont> fonts;
+    fonts.reserve(mFontCount);
+    for (uint32_t i = 0; i < mFontCount; ++i) {
+        const uint32_t familyIndex = reader->read<uint32_t>();
+        const uint32_t fontIndex = reader->read<uint32_t>();
+        const bool fakeBold = reader->read<uint8_t>();
+        const bool fakeItalic = reader->read<uint8_t>();
+        MINIKIN_ASSERT(familyIndex < families.size() &&
+                               fontIndex < families[familyIndex]->getNumFonts(),
+                       "The font collection does not match the serialized layout");
+        fonts.push_back(FakedFont{families[familyIndex]->getFontRef(fontIndex),
+                                  FontFakery(fakeBold, fakeItalic)});
+    }
+    const auto [points, pointFloatCount] = reader->readArray<float>();
+    const auto [glyphIds, glyphCount] = reader->readArray<uint32_t>();
+    const auto [advances, advanceCount] = reader->readArray<float>();
+    const auto [safeBreaks, safeBreakValueCount] = reader->readArray<uint32_t>();
+    const auto [text, textLength] = reader->readArray<uint16_t>();
+    const auto [fontIndices, fontIndexCount] = reader->readArray<uint8_t>();
+    MINIKIN_ASSERT(pointFloatCount == glyphCount * 2 && fontIndexCount == glyphCount,
+                   "Inconsistent glyph counts in the serialized layout");
+    mGlyphCount = glyphCount;
+    mAdvanceCount = advanceCount;
+    mSafeBreakCount = safeBreakValueCount / 2;
+    mSpacingStepCount = 0;
+    mTextLength = textLength;
+    mAdvance = reader->read<float>();
+    mExtent.ascent = reader->read<float>();
+    mExtent.descent = reader->read<float>();
+    initBlock(fonts.data(), reinterpret_cast<const Point*>(points), glyphIds, advances,
+              reinterpret_cast<const SafeBreak*>(safeBreaks), text, fontIndices,
+              nullptr /* spacingSteps */);
+}
+
+// static
+void LayoutPiece::validate(BufferValidator* validator, const FontCollection& collection,
+                           uint32_t* outTextLength, uint32_t* outAdvanceCount) {
+    const std::vector<std::shared_ptr<FontFamily>>& families = collection.getFamilies();
+    const uint32_t fontCount = validator->read<uint32_t>();
+    for (uint32_t i = 0; i < fontCount && validator->ok(); ++i) {
+        const uint32_t familyIndex = validator->read<uint32_t>();
+        const uint32_t fontIndex = validator->read<uint32_t>();
+        validator->skip<uint8_t>();
+        validator->skip<uint8_t>();
+        if (familyIndex >= families.size() ||
+            fontIndex >= families[familyIndex]->getNumFonts()) {
+            validator->fail();
+        }
+    }
+    const uint32_t pointFloatCount = validator->readArray<float>().second;
+    const uint32_t glyphCount = validator->readArray<uint32_t>().second;
+    *outAdvanceCount = validator->readArray<float>().second;
+    const auto [safeBreaks, safeBreakValueCount] = validator->readArray<uint32_t>();
+    *outTextLength = validator->readArray<uint16_t>().second;
+    const auto [fontIndices, fontIndexCount] = validator->readArray<uint8_t>();
+    validator->skip<float>();
+    validator->skip<float>();
+    validator->skip<float>();
+    if (!validator->ok() || pointFloatCount != static_cast<uint64_t>(glyphCount) * 2 ||
+        fontIndexCount != glyphCount || safeBreakValueCount % 2 != 0) {
+        validator->fail();
+        return;
+    }
+    for (uint32_t i = 0; i < fontIndexCount; ++i) {
+        if (fontIndices[i] >= fontCount) {
+            validator->fail();
+            return;
+        }
+    }
+    // The offsets and the glyph indices of the safe breaks.
+    for (uint32_t i = 0; i < safeBreakValueCount; i += 2) {
+        if (safeBreaks[i] > *outAdvanceCount || safeBreaks[i + 1] > glyphCount) {
+            validator->fail();
+            return;
+        }
+    }
+}
+
+void LayoutPiece::writeTo(BufferWriter* writer, const FontCollection& collection) const {
+    MINIKIN_ASSERT(!hasLetterSpacingSteps(), "The letter spacing steps cannot be serialized");
+    const std::vector<std::shared_ptr<FontFamily>>& families = collection.getFamilies();
+    writer->write<uint32_t>(mFontCount);
+    for (const FakedFont& font : fonts()) {
+        const auto [familyIndex, fontIndex] = findFont(families, font.font);
+        MINIKIN_ASSERT(familyIndex < families.size(), "The font is not in the font collection");
+        FontFakery fakery = font.fakery;
+        writer->write<uint32_t>(familyIndex);
+        writer->write<uint32_t>(fontIndex);
+        writer->write<uint8_t>(fakery.isFakeBold());
+        writer->write<uint8_t>(fakery.isFakeItalic());
+    }
+    static_assert(sizeof(Point) == sizeof(float) * 2, "Point must be a pair of floats");
+    writer->writeArray<float>(reinterpret_cast<const float*>(pointArray()), mGlyphCount * 2);
+    writer->writeArray<uint32_t>(glyphIdArray(), mGlyphCount);
+    writer->writeArray<float>(advanceArray(), mAdvanceCount);
+    static_assert(sizeof(SafeBreak) == sizeof(uint32_t) * 2, "SafeBreak must be a pair of uint32");
+    writer->writeArray<uint32_t>(reinterpret_cast<const uint32_t*>(safeBreakArray()),
+                                 mSafeBreakCount * 2);
+    writer->writeArray<uint16_t>(textArray(), mTextLength);
+    writer->writeArray<uint8_t>(fontIndexArray(), mGlyphCount);
+    writer->write<float>(mAdvance);
+    writer->write<float>(mExtent.ascent);
+    writer->write<float>(mExtent.descent);
+}
+
+LayoutPiece::LayoutPiece(const LayoutPiece& o) : mBlock(nullptr) {
+    copyFrom(o);
+}
+
+LayoutPiece& LayoutPiece::operator=(const LayoutPiece& o) {
+    if (this != &o) {
+        releaseBlock();
+        copyFrom(o);
+    }
+    return *this;
+}
+
+LayoutPiece::LayoutPiece(LayoutPiece&& o) : mBlock(nullptr) {
+    moveFrom(std::move(o));
+}
+
+LayoutPiece& LayoutPiece::operator=(LayoutPiece&& o) {
+    if (this != &o) {
+        releaseBlock();
+        moveFrom(std::move(o));
+    }
+    return *this;
+}
+
+// static
+LayoutPiece LayoutPiece::relayout(const LayoutPiece& old, const U16StringPiece& textBuf,
+                                  const Range& range, uint32_t editStart, uint32_t oldEditEnd,
+                                  uint32_t newEditEnd, bool isRtl, const MinikinPaint& paint) {
+    const uint32_t oldCount = old.mAdvanceCount;
+    const uint32_t newCount = range.getLength();
+    MINIKIN_ASSERT(editStart <= oldEditEnd && oldEditEnd <= oldCount && editStart <= newEditEnd &&
+                           newCount - newEditEnd == oldCount - oldEditEnd,
+                   "The edit does not match the old and the new ranges");
+
+    // The last safe break before the edit start and the first one after its end. They are at
+    // least a cluster away from the edit, since a break next to the edit may not be safe anymore
+    // with the new text, e.g. if an inserted character forms a ligature with the previous one.
+    const Span<SafeBreak> breaks = old.safeBreaks();
+    const SafeBreak* startBreak = std::lower_bound(
+            breaks.begin(), breaks.end(), editStart,
+            [](const SafeBreak& b, uint32_t offset) { return b.offset < offset; });
+    const bool hasPrefix = startBreak != breaks.begin();
+    if (hasPrefix) {
+        --startBreak;
+    }
+    const SafeBreak* endBreak = std::upper_bound(
+            breaks.begin(), breaks.end(), oldEditEnd,
+            [](uint32_t offset, const SafeBreak& b) { return offset < b.offset; });
+    const bool hasSuffix = endBreak != breaks.end();
+    if (!hasPrefix && !hasSuffix) {
+        return LayoutPiece(textBuf, range, isRtl, paint, StartHyphenEdit::NO_EDIT,
+                           EndHyphenEdit::NO_EDIT, false /* retainText */,
+                           true /* recordSafeBreaks */);
+    }
+
+    // The reused text is old's [0, prefixEnd) and [suffixStart, oldCount), which are the new
+    // range's [0, prefixEnd) and [newSuffixStart, newCount).
+    const uint32_t prefixEnd = hasPrefix ? startBreak->offset : 0;
+    const uint32_t suffixStart = hasSuffix ? endBreak->offset : oldCount;
+    const uint32_t newSuffixStart = suffixStart - oldEditEnd + newEditEnd;
+
+    LayoutPiece middle;
+    if (prefixEnd < newSuffixStart) {
+        middle = LayoutPiece(textBuf,
+                             Range(range.getStart() + prefixEnd, range.getStart() + newSuffixStart),
+                             isRtl, paint, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                             false /* retainText */, true /* recordSafeBreaks */);
+    }
+
+    // The glyphs of the prefix are old's [0, prefixGlyphEnd) in LTR, and
+    // [prefixGlyphStart, glyphCount) in RTL. Similarly for the suffix.
+    const uint32_t oldGlyphCount = old.mGlyphCount;
+    const uint32_t startGlyph = hasPrefix ? startBreak->glyphIndex : (isRtl ? oldGlyphCount : 0);
+    const uint32_t endGlyph = hasSuffix ? endBreak->glyphIndex : (isRtl ? 0 : oldGlyphCount);
+    const Span<float> oldAdvances = old.advances();
+    const float prefixWidth = std::accumulate(oldAdvances.begin(), oldAdvances.begin() + prefixEnd,
+                                              0.0f);
+    const float suffixWidth =
+            std::accumulate(oldAdvances.begin() + suffixStart, oldAdvances.end(), 0.0f);
+
+    LayoutPiece result;
+    std::vector<FakedFont> fonts;
+    std::vector<uint8_t> fontIndices;
+    std::vector<uint32_t> glyphIds;
+    std::vector<Point> points;
+    auto appendGlyphs = [&](const LayoutPiece& piece, uint32_t start, uint32_t end, float dx) {
+        for (uint32_t i = start; i < end; ++i) {
+            const FakedFont& font = piece.fontAt(i);
+            uint8_t fontIndex = std::find(fonts.begin(), fonts.end(), font) - fonts.begin();
+            if (fontIndex == fonts.size()) {
+                if (&piece == &old) {
+                    // The reused glyphs do not have their extent in the middle piece.
+                    result.mExtent.extendBy(font.font->getExtent(paint, font.fakery));
+                }
+                fonts.push_back(font);
+            }
+            fontIndices.push_back(fontIndex);
+            glyphIds.push_back(piece.glyphIdAt(i));
+            points.emplace_back(piece.pointAt(i).x + dx, piece.pointAt(i).y);
+        }
+    };
+
+    // The breaks around the reshaped span are between unchanged clusters, so they stay safe.
+    std::vector<SafeBreak> safeBreaks;
+    const uint32_t middleGlyphCount = middle.mGlyphCount;
+    const SafeBreak* prefixBreaksEnd = hasPrefix ? startBreak + 1 : breaks.begin();
+    for (const SafeBreak* b = breaks.begin(); b < prefixBreaksEnd; ++b) {
+        const uint32_t glyphIndex =
+                isRtl ? b->glyphIndex - startGlyph + endGlyph + middleGlyphCount : b->glyphIndex;
+        safeBreaks.push_back({b->offset, glyphIndex});
+    }
+    for (const SafeBreak& b : middle.safeBreaks()) {
+        const uint32_t glyphIndex = b.glyphIndex + (isRtl ? endGlyph : startGlyph);
+        safeBreaks.push_back({b.offset + prefixEnd, glyphIndex});
+    }
+    for (const SafeBreak* b = endBreak; b < breaks.end(); ++b) {
+        const uint32_t glyphIndex =
+                isRtl ? b->glyphIndex : b->glyphIndex - endGlyph + startGlyph + middleGlyphCount;
+        safeBreaks.push_back({b->offset - suffixStart + newSuffixStart, glyphIndex});
+    }
+
+    result.mExtent = middle.mExtent;
+    if (isRtl) {
+        // The suffix comes first visually.
+        const float prefixX = old.mAdvance - prefixWidth;
+        appendGlyphs(old, 0, endGlyph, 0);
+        appendGlyphs(middle, 0, middleGlyphCount, suffixWidth);
+        appendGlyphs(old, startGlyph, oldGlyphCount, suffixWidth + middle.mAdvance - prefixX);
+    } else {
+        const float suffixX = old.mAdvance - suffixWidth;
+        appendGlyphs(old, 0, startGlyph, 0);
+        appendGlyphs(middle, 0, middleGlyphCount, prefixWidth);
+        appendGlyphs(old, endGlyph, oldGlyphCount, prefixWidth + middle.mAdvance - suffixX);
+    }
+
+    std::vector<float> advances(oldAdvances.begin(), oldAdvances.begin() + prefixEnd);
+    advances.insert(advances.end(), middle.advances().begin(), middle.advances().end());
+    advances.insert(advances.end(), oldAdvances.begin() + suffixStart, oldAdvances.end());
+
+    result.mGlyphCount = glyphIds.size();
+    result.mAdvanceCount = newCount;
+    result.mSafeBreakCount = safeBreaks.size();
+    result.mFontCount = fonts.size();
+    result.mAdvance = prefixWidth + middle.mAdvance + suffixWidth;
+    result.initBlock(fonts.data(), points.data(), glyphIds.data(), advances.data(),
+                     safeBreaks.data(), nullptr, fontIndices.data(), nullptr /* spacingSteps */);
+    return result;
+}
+
+LayoutPiece LayoutPiece::scaled(float scale) const {
+    LayoutPiece result;
+    result.mGlyphCount = mGlyphCount;
+    result.mAdvanceCount = mAdvanceCount;
+    result.mSafeBreakCount = mSafeBreakCount;
+    result.mSpacingStepCount = mSpacingStepCount;
+    result.mFontCount = mFontCount;
+    result.mAdvance = mAdvance * scale;
+    result.mExtent = MinikinExtent(mExtent.ascent * scale, mExtent.descent * scale);
+    result.initBlock(fontArray(), pointArray(), glyphIdArray(), advanceArray(), safeBreakArray(),
+                     nullptr, fontIndexArray(), spacingStepArray());
+
+    Point* points = const_cast<Point*>(result.pointArray());
+    for (uint32_t i = 0; i < mGlyphCount; ++i) {
+        points[i] = Point(points[i].x * scale, points[i].y * scale);
+    }
+    float* advances = const_cast<float*>(result.advanceArray());
+    for (uint32_t i = 0; i < mAdvanceCount; ++i) {
+        advances[i] *= scale;
+    }
+    return result;
+}
+
+LayoutPiece LayoutPiece::withLetterSpacing(const MinikinPaint& paint) const {
+    MINIKIN_ASSERT(hasLetterSpacingSteps(), "The piece was laid out without the spacing steps");
+    const double letterSpaceHalf = paint.letterSpacing * static_cast<double>(paint.size) *
+                                   static_cast<double>(paint.scaleX) * 0.5;
+    LayoutPiece result;
+    result.mGlyphCount = mGlyphCount;
+    result.mAdvanceCount = mAdvanceCount;
+    result.mSafeBreakCount = mSafeBreakCount;
+    result.mFontCount = mFontCount;
+    result.mExtent = mExtent;
+    result.initBlock(fontArray(), pointArray(), glyphIdArray(), advanceArray(), safeBreakArray(),
+                     nullptr, fontIndexArray(), nullptr /* spacingSteps */);
+
+    // The glyphs are shifted by the spacings added before them, and the code units get theirs.
+    const uint8_t* glyphSteps = spacingStepArray();
+    const uint8_t* advanceSteps = glyphSteps + mGlyphCount;
+    Point* points = const_cast<Point*>(result.pointArray());
+    uint32_t steps = 0;
+    for (uint32_t i = 0; i < mGlyphCount; ++i) {
+        steps += glyphSteps[i];
+        points[i].x += steps * letterSpaceHalf;
+    }
+    float* advances = const_cast<float*>(result.advanceArray());
+    for (uint32_t i = 0; i < mAdvanceCount; ++i) {
+        advances[i] += advanceSteps[i] * letterSpaceHalf;
+    }
+    steps += advanceSteps[mAdvanceCount];
+    result.mAdvance = mAdvance + steps * letterSpaceHalf;
+    return result;
+}
+
+MinikinRect LayoutPiece::calculateBounds(const MinikinPaint& paint) const {
+    static thread_local std::vector<MinikinRect> glyphBounds;
+    glyphBounds.resize(mGlyphCount);
+
+    // Query the bounds for each run of glyphs using the same font at once.
+    const uint8_t* fontIndices = fontIndexArray();
+    for (uint32_t start = 0; start < mGlyphCount;) {
+        uint32_t end = start + 1;
+        while (end < mGlyphCount && fontIndices[end] == fontIndices[start]) {
+            end++;
+        }
+        const FakedFont& font = fontArray()[fontIndices[start]];
+        font.font->typeface()->GetGlyphBounds(glyphIdArray() + start, end - start, paint,
+                                              font.fakery, glyphBounds.data() + start);
+        start = end;
+    }
+
+    MinikinRect pieceBounds;
+    for (uint32_t i = 0; i < mGlyphCount; ++i) {
+        MinikinRect& rect = glyphBounds[i];
+        const Point& point = pointAt(i);
+        rect.offset(point.x, point.y);
+        pieceBounds.join(rect);
+    }
+    return pieceBounds;
+}
+
+void LayoutPiece::initBlock(const FakedFont* fonts, const Point* points, const uint32_t* glyphIds,
+                            const float* advances, const SafeBreak* safeBreaks,
+                            const uint16_t* text, const uint8_t* fontIndices,
+                            const uint8_t* spacingSteps) {
+    // operator new[] returns memory aligned for any fundamental type, which is enough for
+    // FakedFont at the head of the block.
+    mBlockTextLength = mTextLength;
+    uint8_t* allocation = new uint8_t[BLOCK_HEADER_SIZE + blockSize()];
+    new (allocation) std::atomic<uint32_t>(1);
+    mBlock = allocation + BLOCK_HEADER_SIZE;
+    FakedFont* outFonts = reinterpret_cast<FakedFont*>(mBlock);
+    for (uint32_t i = 0; i < mFontCount; ++i) {
+        new (outFonts + i) FakedFont(fonts[i]);
+    }
+    std::copy(points, points + mGlyphCount, const_cast<Point*>(pointArray()));
+    std::copy(glyphIds, glyphIds + mGlyphCount, const_cast<uint32_t*>(glyphIdArray()));
+    std::copy(advances, advances + mAdvanceCount, const_cast<float*>(advanceArray()));
+    std::copy(safeBreaks, safeBreaks + mSafeBreakCount, const_cast<SafeBreak*>(safeBreakArray()));
+    std::copy(text, text + mTextLength, const_cast<uint16_t*>(textArray()));
+    std::copy(fontIndices, fontIndices + mGlyphCount, const_cast<uint8_t*>(fontIndexArray()));
+    std::copy(spacingSteps, spacingSteps + mSpacingStepCount,
+              const_cast<uint8_t*>(spacingStepArray()));
+}
+
+void LayoutPiece::releaseBlock() {
+    if (mBlock == nullptr) {
+        return;
+    }
+    if (refCount()->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        FakedFont* fonts = reinterpret_cast<FakedFont*>(mBlock);
+        for (uint32_t i = 0; i < mFontCount; ++i) {
+            fonts[i].~FakedFont();
+        }
+        using Count = std::atomic<uint32_t>;
+        refCount()->~Count();
+        delete[](mBlock - BLOCK_HEADER_SIZE);
+    }
+    mBlock = nullptr;
+}
+
+void LayoutPiece::copyFrom(const LayoutPiece& o) {
+    mGlyphCount = o.mGlyphCount;
+    mAdvanceCount = o.mAdvanceCount;
+    mSafeBreakCount = o.mSafeBreakCount;
+    mSpacingStepCount = o.mSpacingStepCount;
+    mTextLength = 0;  // The retained text only serves the cache key of the original.
+    mBlockTextLength = o.mBlockTextLength;
+    mFontCount = o.mFontCount;
+    mAdvance = o.mAdvance;
+    mExtent = o.mExtent;
+    mBlock = o.mBlock;
+    if (mBlock != nullptr) {
+        refCount()->fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LayoutPiece::moveFrom(LayoutPiece&& o) {
+    mBlock = o.mBlock;
+    mGlyphCount = o.mGlyphCount;
+    mAdvanceCount = o.mAdvanceCount;
+    mSafeBreakCount = o.mSafeBreakCount;
+    mSpacingStepCount = o.mSpacingStepCount;
+    mTextLength = o.mTextLength;
+    mBlockTextLength = o.mBlockTextLength;
+    mFontCount = o.mFontCount;
+    mAdvance = o.mAdvance;
+    mExtent = o.mExtent;
+    o.mBlock = nullptr;
+    o.mGlyphCount = o.mAdvanceCount = o.mSafeBreakCount = o.mSpacingStepCount = o.mTextLength =
+            o.mBlockTextLength = o.mFontCount = 0;
 }
 
 }  // namespace minikin
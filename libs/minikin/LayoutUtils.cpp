@@ -16,6 +16,12 @@
 
 #include "LayoutUtils.h"
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace minikin {
 
 /*
@@ -50,6 +56,96 @@ static bool isWordBreakBefore(uint16_t c) {
     return isWordBreakAfter(c) || (0x3400 <= c && c <= 0x9FFF);
 }
 
+/**
+ * Returns true if the code unit may be a word break character, i.e. it is a space or not less than
+ * U+2000. Every character accepted by isWordBreakAfter or isWordBreakBefore is a candidate, so the
+ * scanners below only need to run the full checks on candidates.
+ */
+static inline bool isWordBreakCandidate(uint16_t c) {
+    return c == ' ' || (c & 0xE000) != 0;
+}
+
+#if defined(__ARM_NEON)
+constexpr uint32_t kScanWidth = 8;
+
+// Returns a mask with 8 bits per code unit which are set for the candidates of chars[0..7].
+static inline uint64_t candidateMask(const uint16_t* chars) {
+    const uint16x8_t v = vld1q_u16(chars);
+    const uint16x8_t mask =
+            vorrq_u16(vceqq_u16(v, vdupq_n_u16(' ')), vtstq_u16(v, vdupq_n_u16(0xE000)));
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(mask, 4)), 0);
+}
+static inline uint32_t firstCandidate(uint64_t mask) {
+    return __builtin_ctzll(mask) / 8;
+}
+static inline uint32_t lastCandidate(uint64_t mask) {
+    return (63 - __builtin_clzll(mask)) / 8;
+}
+#define MINIKIN_HAS_WORD_BREAK_SCAN 1
+#elif defined(__SSE2__)
+constexpr uint32_t kScanWidth = 8;
+
+// Returns a mask with 2 bits per code unit which are set for the candidates of chars[0..7].
+static inline uint32_t candidateMask(const uint16_t* chars) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars));
+    const __m128i isSpace = _mm_cmpeq_epi16(v, _mm_set1_epi16(' '));
+    const __m128i isBelow2000 =
+            _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<int16_t>(0xE000))),
+                            _mm_setzero_si128());
+    return _mm_movemask_epi8(_mm_or_si128(isSpace, _mm_xor_si128(isBelow2000, _mm_set1_epi16(-1))));
+}
+static inline uint32_t firstCandidate(uint32_t mask) {
+    return __builtin_ctz(mask) / 2;
+}
+static inline uint32_t lastCandidate(uint32_t mask) {
+    return (31 - __builtin_clz(mask)) / 2;
+}
+#define MINIKIN_HAS_WORD_BREAK_SCAN 1
+#endif
+
+/**
+ * Returns the first index in [start, end) whose code unit is a candidate, or end if none of them
+ * is.
+ */
+static uint32_t findNextCandidate(const uint16_t* chars, uint32_t start, uint32_t end) {
+    uint32_t i = start;
+#ifdef MINIKIN_HAS_WORD_BREAK_SCAN
+    for (; i + kScanWidth <= end; i += kScanWidth) {
+        const auto mask = candidateMask(chars + i);
+        if (mask != 0) {
+            return i + firstCandidate(mask);
+        }
+    }
+#endif
+    for (; i < end; ++i) {
+        if (isWordBreakCandidate(chars[i])) {
+            return i;
+        }
+    }
+    return end;
+}
+
+/**
+ * Returns the last index in [0, end] whose code unit is a candidate, or -1 if none of them is.
+ */
+static int64_t findPrevCandidate(const uint16_t* chars, uint32_t end) {
+    int64_t i = end;
+#ifdef MINIKIN_HAS_WORD_BREAK_SCAN
+    for (; i + 1 >= kScanWidth; i -= kScanWidth) {
+        const auto mask = candidateMask(chars + i + 1 - kScanWidth);
+        if (mask != 0) {
+            return i + 1 - kScanWidth + lastCandidate(mask);
+        }
+    }
+#endif
+    for (; i >= 0; --i) {
+        if (isWordBreakCandidate(chars[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 /**
  * Return offset of previous word break. It is either < offset or == 0.
  */
@@ -59,10 +155,28 @@ uint32_t getPrevWordBreakForCache(const U16StringPiece& textBuf, uint32_t offset
     if (isWordBreakBefore(textBuf[offset - 1])) {
         return offset - 1;
     }
-    for (uint32_t i = offset - 1; i > 0; i--) {
-        if (isWordBreakBefore(textBuf[i]) || isWordBreakAfter(textBuf[i - 1])) {
-            return i;
+    // Looks for the largest i in (0, offset - 1] where isWordBreakBefore(textBuf[i]) or
+    // isWordBreakAfter(textBuf[i - 1]) holds. Either of textBuf[i] or textBuf[i - 1] has to be a
+    // candidate, so the non-candidates are skipped in bulk.
+    const uint16_t* chars = textBuf.data();
+    uint32_t i = offset - 1;
+    while (i > 0) {
+        const int64_t candidate = findPrevCandidate(chars, i);
+        if (candidate < 0) {
+            return 0;
         }
+        const uint32_t j = static_cast<uint32_t>(candidate);
+        // Everything in (j + 1, i] is preceded by a non-candidate and is not a candidate itself.
+        if (j < i && isWordBreakAfter(chars[j])) {
+            return j + 1;
+        }
+        if (j == 0) {
+            return 0;
+        }
+        if (isWordBreakBefore(chars[j]) || isWordBreakAfter(chars[j - 1])) {
+            return j;
+        }
+        i = j - 1;
     }
     return 0;
 }
@@ -75,11 +189,17 @@ uint32_t getNextWordBreakForCache(const U16StringPiece& textBuf, uint32_t offset
     if (isWordBreakAfter(textBuf[offset])) {
         return offset + 1;
     }
-    for (uint32_t i = offset + 1; i < textBuf.size(); i++) {
+    const uint16_t* chars = textBuf.data();
+    const uint32_t size = textBuf.size();
+    for (uint32_t i = offset + 1; i < size; i++) {
         // No need to check isWordBreakAfter(chars[i - 1]) since it is checked
         // in previous iteration.  Note that isWordBreakBefore returns true
         // whenever isWordBreakAfter returns true.
-        if (isWordBreakBefore(textBuf[i])) {
+        i = findNextCandidate(chars, i, size);
+        if (i == size) {
+            break;
+        }
+        if (isWordBreakBefore(chars[i])) {
             return i;
         }
     }
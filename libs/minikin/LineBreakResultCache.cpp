@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LineBreakResultCache.h"
+
+namespace minikin {
+
+bool LineBreakResultCache::Entry::matches(BreakStrategy strategy, HyphenationFrequency frequency,
+                                          bool justified, const LineWidth& lineWidth,
+                                          const TabStops& tabStops) const {
+    if (this->strategy != strategy || this->frequency != frequency ||
+        this->justified != justified || tabWidth != tabStops.mTabWidth ||
+        !std::equal(this->tabStops.begin(), this->tabStops.end(), tabStops.mStops,
+                    tabStops.mStops + tabStops.mStopsSize)) {
+        return false;
+    }
+    for (size_t lineNo = 0; lineNo < lineWidths.size(); ++lineNo) {
+        if (lineWidth.getAt(lineNo) != lineWidths[lineNo]) {
+            return false;
+        }
+    }
+    return lineWidth.getMin() == minLineWidth;
+}
+
+// static
+void LineBreakResultCache::copyResult(const LineBreakResult& from, LineBreakResult* to) {
+    to->breakPoints = from.breakPoints;
+    to->widths = from.widths;
+    to->ascents = from.ascents;
+    to->descents = from.descents;
+    to->flags = from.flags;
+}
+
+bool LineBreakResultCache::get(BreakStrategy strategy, HyphenationFrequency frequency,
+                               bool justified, const LineWidth& lineWidth,
+                               const TabStops& tabStops, LineBreakResult* out) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->matches(strategy, frequency, justified, lineWidth, tabStops)) {
+            copyResult(it->result, out);
+            if (it != mEntries.begin()) {
+                Entry entry = std::move(*it);
+                mEntries.erase(it);
+                mEntries.push_front(std::move(entry));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void LineBreakResultCache::put(BreakStrategy strategy, HyphenationFrequency frequency,
+                               bool justified, const RecordingLineWidth& lineWidth,
+                               const TabStops& tabStops, const LineBreakResult& result) {
+    if (mMaxEntries == 0) {
+        return;
+    }
+    Entry entry;
+    entry.strategy = strategy;
+    entry.frequency = frequency;
+    entry.justified = justified;
+    for (size_t lineNo = 0; lineNo <= lineWidth.getMaxLineNo(); ++lineNo) {
+        entry.lineWidths.push_back(lineWidth.getAt(lineNo));
+    }
+    entry.minLineWidth = lineWidth.getMin();
+    entry.tabStops.assign(tabStops.mStops, tabStops.mStops + tabStops.mStopsSize);
+    entry.tabWidth = tabStops.mTabWidth;
+    copyResult(result, &entry.result);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mEntries.size() == mMaxEntries) {
+        mEntries.pop_back();
+    }
+    mEntries.push_front(std::move(entry));
+}
+
+}  // namespace minikin
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LINE_BREAK_RESULT_CACHE_H
+#define MINIKIN_LINE_BREAK_RESULT_CACHE_H
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "minikin/LineBreaker.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Remembers the results of the last few breakIntoLines calls for a MeasuredText, so that a
+// repeated call with the same arguments copies the result instead of breaking the text again.
+class LineBreakResultCache {
+public:
+    explicit LineBreakResultCache(uint32_t maxEntries) : mMaxEntries(maxEntries) {}
+
+    // Passes the queries of a line breaker to the line width and remembers the last line number
+    // queried, so that the cache can tell which part of the width profile the result depends on.
+    class RecordingLineWidth : public LineWidth {
+    public:
+        explicit RecordingLineWidth(const LineWidth& lineWidth) : mLineWidth(lineWidth) {}
+
+        float getAt(size_t lineNo) const override {
+            mMaxLineNo = std::max(mMaxLineNo, lineNo);
+            return mLineWidth.getAt(lineNo);
+        }
+
+        float getMin() const override { return mLineWidth.getMin(); }
+
+        size_t getMaxLineNo() const { return mMaxLineNo; }
+
+    private:
+        const LineWidth& mLineWidth;
+        mutable size_t mMaxLineNo = 0;
+    };
+
+    // Copies the result of an earlier call with the same arguments to out and returns true, or
+    // returns false if there is none.
+    bool get(BreakStrategy strategy, HyphenationFrequency frequency, bool justified,
+             const LineWidth& lineWidth, const TabStops& tabStops, LineBreakResult* out);
+
+    // Remembers the result of a call whose line breaker queried lineWidth, dropping the least
+    // recently used result if the cache is full.
+    void put(BreakStrategy strategy, HyphenationFrequency frequency, bool justified,
+             const RecordingLineWidth& lineWidth, const TabStops& tabStops,
+             const LineBreakResult& result);
+
+private:
+    struct Entry {
+        BreakStrategy strategy;
+        HyphenationFrequency frequency;
+        bool justified;
+
+        // The widths of the lines up to the last one the line breaker queried, and the minimum.
+        std::vector<float> lineWidths;
+        float minLineWidth;
+
+        std::vector<float> tabStops;
+        float tabWidth;
+
+        LineBreakResult result;
+
+        bool matches(BreakStrategy strategy, HyphenationFrequency frequency, bool justified,
+                     const LineWidth& lineWidth, const TabStops& tabStops) const;
+    };
+
+    static void copyResult(const LineBreakResult& from, LineBreakResult* to);
+
+    const uint32_t mMaxEntries;
+
+    std::mutex mMutex;
+    // The most recently used entry first.
+    std::deque<Entry> mEntries GUARDED_BY(mMutex);
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(LineBreakResultCache);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LINE_BREAK_RESULT_CACHE_H
@@ -16,22 +16,207 @@
 
 #include "minikin/LineBreaker.h"
 
+#include "minikin/CallRecorder.h"
+
+#include "CodeUnitScan.h"
 #include "GreedyLineBreaker.h"
+#include "LineBreakResultCache.h"
+#include "LineBreakerUtil.h"
 #include "OptimalLineBreaker.h"
+#include "ParallelFor.h"
+#include "ScopedCallRecord.h"
+#include "TraceSpan.h"
 
 namespace minikin {
 
+namespace {
+
+// The optimal line breaker doesn't support tabs.
+bool hasTab(const U16StringPiece& text) {
+    return findCodeUnit(text.data(), 0, text.size(), CHAR_TAB) != text.size();
+}
+
+LineBreakResult breakIntoLinesUncached(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                                       HyphenationFrequency frequency, bool justified,
+                                       const MeasuredText& measuredText,
+                                       const LineWidth& lineWidth, const TabStops& tabStops) {
+    MINIKIN_TRACE("breakIntoLines", textBuffer.size(), measuredText.runs.size());
+    if (strategy == BreakStrategy::Greedy || hasTab(textBuffer)) {
+        return breakLineGreedy(textBuffer, measuredText, lineWidth, tabStops,
+                               frequency != HyphenationFrequency::None);
+    } else {
+        return breakLineOptimal(textBuffer, measuredText, lineWidth, strategy, frequency,
+                                justified);
+    }
+}
+
+void breakIntoLinesUncached(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                            HyphenationFrequency frequency, bool justified,
+                            const MeasuredText& measuredText, const LineWidth& lineWidth,
+                            const TabStops& tabStops, bool computeExtents,
+                            LineBreakScratch* scratch, LineBreakResult* out) {
+    MINIKIN_TRACE("breakIntoLines", textBuffer.size(), measuredText.runs.size());
+    if (strategy == BreakStrategy::Greedy || hasTab(textBuffer)) {
+        breakLineGreedy(textBuffer, measuredText, lineWidth, tabStops,
+                        frequency != HyphenationFrequency::None, computeExtents, scratch, out);
+    } else {
+        breakLineOptimal(textBuffer, measuredText, lineWidth, strategy, frequency, justified,
+                         computeExtents, scratch, out);
+    }
+}
+
+// Appends a breakIntoLines call to the trace of CallRecorder, with the widths of the lines up to
+// the last one the call asked for.
+void recordBreakIntoLines(uint64_t durationNanos, const U16StringPiece& textBuffer,
+                          BreakStrategy strategy, HyphenationFrequency frequency, bool justified,
+                          const MeasuredText& measuredText,
+                          const LineBreakResultCache::RecordingLineWidth& lineWidth,
+                          const TabStops& tabStops) {
+    RecordedCall call;
+    call.type = RecordedCall::Type::kBreakIntoLines;
+    call.durationNanos = durationNanos;
+    call.text.assign(textBuffer.data(), textBuffer.data() + textBuffer.size());
+    call.measuredTextId = measuredText.getRecordedId();
+    call.strategy = strategy;
+    call.frequency = frequency;
+    call.justified = justified;
+    for (size_t i = 0; i <= lineWidth.getMaxLineNo(); i++) {
+        call.lineWidths.push_back(lineWidth.getAt(i));
+    }
+    call.minLineWidth = lineWidth.getMin();
+    CallRecorder::copyTabStops(tabStops, &call);
+    CallRecorder::record(call);
+}
+
+LineBreakResult breakIntoLinesCached(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                                     HyphenationFrequency frequency, bool justified,
+                                     const MeasuredText& measuredText, const LineWidth& lineWidth,
+                                     const TabStops& tabStops) {
+    LineBreakResultCache* cache = measuredText.getLineBreakCache();
+    if (cache == nullptr) {
+        return breakIntoLinesUncached(textBuffer, strategy, frequency, justified, measuredText,
+                                      lineWidth, tabStops);
+    }
+
+    LineBreakResult result;
+    if (cache->get(strategy, frequency, justified, lineWidth, tabStops, &result)) {
+        return result;
+    }
+    const LineBreakResultCache::RecordingLineWidth recordingLineWidth(lineWidth);
+    result = breakIntoLinesUncached(textBuffer, strategy, frequency, justified, measuredText,
+                                    recordingLineWidth, tabStops);
+    cache->put(strategy, frequency, justified, recordingLineWidth, tabStops, result);
+    return result;
+}
+
+void breakIntoLinesCached(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                          HyphenationFrequency frequency, bool justified,
+                          const MeasuredText& measuredText, const LineWidth& lineWidth,
+                          const TabStops& tabStops, bool computeExtents,
+                          LineBreakScratch* scratch, LineBreakResult* out) {
+    LineBreakResultCache* cache = measuredText.getLineBreakCache();
+    if (cache == nullptr) {
+        breakIntoLinesUncached(textBuffer, strategy, frequency, justified, measuredText, lineWidth,
+                               tabStops, computeExtents, scratch, out);
+        return;
+    }
+
+    if (cache->get(strategy, frequency, justified, lineWidth, tabStops, out)) {
+        return;
+    }
+    const LineBreakResultCache::RecordingLineWidth recordingLineWidth(lineWidth);
+    breakIntoLinesUncached(textBuffer, strategy, frequency, justified, measuredText,
+                           recordingLineWidth, tabStops, computeExtents, scratch, out);
+    if (computeExtents) {
+        // A result without extents can't answer the calls which need them.
+        cache->put(strategy, frequency, justified, recordingLineWidth, tabStops, *out);
+    }
+}
+
+}  // namespace
+
 LineBreakResult breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy strategy,
                                HyphenationFrequency frequency, bool justified,
                                const MeasuredText& measuredText, const LineWidth& lineWidth,
                                const TabStops& tabStops) {
-    if (strategy == BreakStrategy::Greedy || textBuffer.hasChar(CHAR_TAB)) {
+    const ScopedCallRecord callRecord;
+    if (!callRecord.isEnabled()) {
+        return breakIntoLinesCached(textBuffer, strategy, frequency, justified, measuredText,
+                                    lineWidth, tabStops);
+    }
+    const LineBreakResultCache::RecordingLineWidth recordingLineWidth(lineWidth);
+    LineBreakResult result = breakIntoLinesCached(textBuffer, strategy, frequency, justified,
+                                                  measuredText, recordingLineWidth, tabStops);
+    recordBreakIntoLines(callRecord.getElapsedNanos(), textBuffer, strategy, frequency, justified,
+                         measuredText, recordingLineWidth, tabStops);
+    return result;
+}
+
+void breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                    HyphenationFrequency frequency, bool justified,
+                    const MeasuredText& measuredText, const LineWidth& lineWidth,
+                    const TabStops& tabStops, bool computeExtents, LineBreakScratch* scratch,
+                    LineBreakResult* out) {
+    const ScopedCallRecord callRecord;
+    if (!callRecord.isEnabled()) {
+        breakIntoLinesCached(textBuffer, strategy, frequency, justified, measuredText, lineWidth,
+                             tabStops, computeExtents, scratch, out);
+        return;
+    }
+    const LineBreakResultCache::RecordingLineWidth recordingLineWidth(lineWidth);
+    breakIntoLinesCached(textBuffer, strategy, frequency, justified, measuredText,
+                         recordingLineWidth, tabStops, computeExtents, scratch, out);
+    recordBreakIntoLines(callRecord.getElapsedNanos(), textBuffer, strategy, frequency, justified,
+                         measuredText, recordingLineWidth, tabStops);
+}
+
+LineBreakResult breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy strategy,
+                               HyphenationFrequency frequency, bool justified,
+                               const MeasuredText& measuredText, const LineWidth& lineWidth,
+                               const TabStops& tabStops, uint32_t editOffset,
+                               LineBreakerState* state) {
+    if (strategy == BreakStrategy::Greedy || hasTab(textBuffer)) {
+        // The greedy line breaker is linear and keeps no state.
+        state->clear();
         return breakLineGreedy(textBuffer, measuredText, lineWidth, tabStops,
                                frequency != HyphenationFrequency::None);
     } else {
         return breakLineOptimal(textBuffer, measuredText, lineWidth, strategy, frequency,
+                                justified, editOffset, state);
+    }
+}
+
+std::vector<LineBreakResult> breakIntoLinesForWidths(const U16StringPiece& textBuffer,
+                                                     BreakStrategy strategy,
+                                                     HyphenationFrequency frequency, bool justified,
+                                                     const MeasuredText& measuredText,
+                                                     const std::vector<float>& lineWidths,
+                                                     const TabStops& tabStops) {
+    if (strategy == BreakStrategy::Greedy || hasTab(textBuffer)) {
+        // The greedy line breaker is linear, and a line of one width tells nothing about the lines
+        // of another.
+        std::vector<LineBreakResult> results(lineWidths.size());
+        for (size_t i = 0; i < lineWidths.size(); i++) {
+            results[i] = breakLineGreedy(textBuffer, measuredText, ConstantLineWidth(lineWidths[i]),
+                                         tabStops, frequency != HyphenationFrequency::None);
+        }
+        return results;
+    } else {
+        return breakLineOptimal(textBuffer, measuredText, lineWidths, strategy, frequency,
                                 justified);
     }
 }
 
+std::vector<LineBreakResult> breakIntoLines(const std::vector<LineBreakJob>& jobs,
+                                            BreakStrategy strategy, HyphenationFrequency frequency,
+                                            bool justified, uint32_t maxThreads) {
+    std::vector<LineBreakResult> results(jobs.size());
+    parallelFor(jobs.size(), maxThreads, [&](size_t i) {
+        const LineBreakJob& job = jobs[i];
+        results[i] = breakIntoLines(job.text, strategy, frequency, justified, *job.measuredText,
+                                    *job.lineWidth, *job.tabStops);
+    });
+    return results;
+}
+
 }  // namespace minikin
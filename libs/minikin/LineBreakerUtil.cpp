@@ -16,45 +16,45 @@
 
 #include "LineBreakerUtil.h"
 
-namespace minikin {
+#include <algorithm>
+
+#include "CodeUnitScan.h"
+#include "HyphenationCache.h"
 
-// Very long words trigger O(n^2) behavior in hyphenation, so we disable hyphenation for
-// unreasonably long words. This is somewhat of a heuristic because extremely long words are
-// possible in some languages. This does mean that very long real words can get broken by
-// desperate breaks, with no hyphens.
-constexpr size_t LONGEST_HYPHENATED_WORD = 45;
+namespace minikin {
 
 // Hyphenates a string potentially containing non-breaking spaces.
 std::vector<HyphenationType> hyphenate(const U16StringPiece& str, const Hyphenator& hyphenator) {
-    std::vector<HyphenationType> out;
-    const size_t len = str.size();
-    out.resize(len);
+    std::vector<HyphenationType> out(str.size());
+    hyphenate(str, hyphenator, out.data());
+    return out;
+}
+
+void hyphenate(const U16StringPiece& str, const Hyphenator& hyphenator, HyphenationType* out) {
+    const uint32_t len = str.size();
+    // Very long words trigger O(n^2) behavior in hyphenation, so we disable hyphenation for
+    // unreasonably long words. This is somewhat of a heuristic because extremely long words are
+    // possible in some languages, hence it is configurable. This does mean that very long real
+    // words can get broken by desperate breaks, with no hyphens.
+    const size_t longestHyphenatedWord = Hyphenator::getLongestHyphenatedWord();
 
     // A word here is any consecutive string of non-NBSP characters.
-    bool inWord = false;
-    size_t wordStart = 0;  // The initial value will never be accessed, but just in case.
-    for (size_t i = 0; i <= len; i++) {
-        if (i == len || str[i] == CHAR_NBSP) {
-            if (inWord) {
-                // A word just ended. Hyphenate it.
-                const U16StringPiece word = str.substr(Range(wordStart, i));
-                if (word.size() <= LONGEST_HYPHENATED_WORD) {
-                    hyphenator.hyphenate(word, out.data() + wordStart);
-                } else {  // Word is too long. Inefficient to hyphenate.
-                    out.insert(out.end(), word.size(), HyphenationType::DONT_BREAK);
-                }
-                inWord = false;
-            }
-            if (i < len) {
-                // Insert one DONT_BREAK for the NBSP.
-                out.push_back(HyphenationType::DONT_BREAK);
-            }
-        } else if (!inWord) {
-            inWord = true;
-            wordStart = i;
+    uint32_t wordStart = 0;
+    while (wordStart <= len) {
+        const uint32_t wordEnd = findCodeUnit(str.data(), wordStart, len, CHAR_NBSP);
+        const U16StringPiece word = str.substr(Range(wordStart, wordEnd));
+        if (word.size() == 0) {
+            // Nothing to hyphenate.
+        } else if (word.size() <= longestHyphenatedWord) {
+            HyphenationCache::getInstance().hyphenate(hyphenator, word, out + wordStart);
+        } else {  // Word is too long. Inefficient to hyphenate.
+            std::fill(out + wordStart, out + wordEnd, HyphenationType::DONT_BREAK);
         }
+        if (wordEnd < len) {
+            out[wordEnd] = HyphenationType::DONT_BREAK;  // The NBSP.
+        }
+        wordStart = wordEnd + 1;
     }
-    return out;
 }
 
 }  // namespace minikin
@@ -17,9 +17,11 @@
 #ifndef MINIKIN_LINE_BREAKER_UTIL_H
 #define MINIKIN_LINE_BREAKER_UTIL_H
 
+#include <memory>
 #include <vector>
 
 #include "minikin/Hyphenator.h"
+#include "minikin/LineBreaker.h"
 #include "minikin/MeasuredText.h"
 #include "minikin/U16StringPiece.h"
 
@@ -28,6 +30,7 @@
 #include "Locale.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "WordBreakCache.h"
 #include "WordBreaker.h"
 
 namespace minikin {
@@ -38,9 +41,24 @@ namespace minikin {
 // on performance/accuracy tradeoff.
 typedef float ParaWidth;
 
+// A line width which is the same for all lines.
+class ConstantLineWidth : public LineWidth {
+public:
+    explicit ConstantLineWidth(float width) : mWidth(width) {}
+
+    float getAt(size_t /* lineNo */) const override { return mWidth; }
+    float getMin() const override { return mWidth; }
+
+private:
+    const float mWidth;
+};
+
 // Hyphenates a string potentially containing non-breaking spaces.
 std::vector<HyphenationType> hyphenate(const U16StringPiece& string, const Hyphenator& hypenator);
 
+// Same as above but writes the result into out, which must have at least string.size() entries.
+void hyphenate(const U16StringPiece& string, const Hyphenator& hyphenator, HyphenationType* out);
+
 // This function determines whether a character is a space that disappears at end of line.
 // It is the Unicode set: [[:General_Category=Space_Separator:]-[:Line_Break=Glue:]], plus '\n'.
 // Note: all such characters are in the BMP, so it's ok to use code units for this.
@@ -68,26 +86,57 @@ inline void populateHyphenationPoints(
         const Range& contextRange,            // A context range for measuring hyphenated piece.
         const Range& hyphenationTargetRange,  // An actual range for the hyphenation target.
         std::vector<HyphenBreak>* out,        // An output to be appended.
-        LayoutPieces* pieces) {               // An output of layout pieces. Maybe null.
+        LayoutPieces* pieces,                 // An output of layout pieces. Maybe null.
+        const MeasuredText* measured) {       // The widths to approximate pieces from. Maybe null.
     if (!run.getRange().contains(contextRange) || !contextRange.contains(hyphenationTargetRange)) {
         return;
     }
 
     const std::vector<HyphenationType> hyphenResult =
             hyphenate(textBuf.substr(hyphenationTargetRange), hyphenator);
+    const bool approximate =
+            measured != nullptr && run.canApproximateHyphenPieces(textBuf, contextRange);
+    // The sums of the character widths before and from the current offset in the context.
+    float firstChars = 0;
+    float secondChars = 0;
+    if (approximate) {
+        for (uint32_t i = contextRange.getStart(); i < contextRange.getEnd(); ++i) {
+            secondChars += measured->widthAt(i);
+        }
+    }
+    uint32_t charsEnd = contextRange.getStart();
     for (uint32_t i = hyphenationTargetRange.getStart(); i < hyphenationTargetRange.getEnd(); ++i) {
         const HyphenationType hyph = hyphenResult[hyphenationTargetRange.toRangeOffset(i)];
         if (hyph == HyphenationType::DONT_BREAK) {
             continue;  // Not a hyphenation point.
         }
 
+        const EndHyphenEdit endEdit = editForThisLine(hyph);
+        // A cluster, e.g. a ligature, has its advance on its first code unit and none on the
+        // others, so the pieces of a break inside it must be laid out.
+        if (approximate && !isReplacement(endEdit) && measured->widthAt(i) != 0) {
+            for (; charsEnd < i; ++charsEnd) {
+                const float w = measured->widthAt(charsEnd);
+                firstChars += w;
+                secondChars -= w;
+            }
+            const StartHyphenEdit startEdit = editForNextLine(hyph);
+            const float endHyphenAdvance =
+                    run.getHyphenEditAdvance(StartHyphenEdit::NO_EDIT, endEdit);
+            const float startHyphenAdvance =
+                    run.getHyphenEditAdvance(startEdit, EndHyphenEdit::NO_EDIT);
+            out->emplace_back(i, hyph, firstChars + endHyphenAdvance,
+                              secondChars + startHyphenAdvance);
+            continue;
+        }
+
         auto hyphenPart = contextRange.split(i);
         U16StringPiece firstText = textBuf.substr(hyphenPart.first);
         U16StringPiece secondText = textBuf.substr(hyphenPart.second);
         const float first =
                 run.measureHyphenPiece(firstText, Range(0, firstText.size()),
                                        StartHyphenEdit::NO_EDIT /* start hyphen edit */,
-                                       editForThisLine(hyph) /* end hyphen edit */, pieces);
+                                       endEdit /* end hyphen edit */, pieces);
         const float second =
                 run.measureHyphenPiece(secondText, Range(0, secondText.size()),
                                        editForNextLine(hyph) /* start hyphen edit */,
@@ -97,6 +146,75 @@ inline void populateHyphenationPoints(
     }
 }
 
+// Iterates the word breaks of the text like WordBreaker. If the MeasuredText kept its word breaks,
+// they are replayed instead of running WordBreaker again, and otherwise the ones in WordBreakCache
+// are, computing them first if the text was not broken with the same locales before. WordBreaker
+// only runs along the iteration if the text is too long to be cached. The caller must move the
+// iterator to the start of each run with a new locale, in order, as
+// MeasuredText::computeWordBreaks does. If breaker is not null, it is used instead of a
+// WordBreaker of the iterator, so that the memory it holds is reused.
+class WordBreakIterator {
+public:
+    WordBreakIterator(const U16StringPiece& text, const MeasuredText& measured,
+                      WordBreaker* breaker = nullptr)
+            : mBreaker(breaker != nullptr ? *breaker : mOwnBreaker) {
+        if (measured.hasWordBreaks()) {
+            mWordBreaks = &measured.getWordBreaks();
+            return;
+        }
+        mCachedWordBreaks = WordBreakCache::getInstance().get(text, measured.runs, &mBreaker);
+        mWordBreaks = mCachedWordBreaks.get();
+        if (mWordBreaks == nullptr) {
+            mBreaker.setText(text.data(), text.size());
+        }
+    }
+
+    ~WordBreakIterator() {
+        if (&mBreaker != &mOwnBreaker) {
+            mBreaker.finish();
+        }
+    }
+
+    ssize_t followingWithLocale(const Locale& locale, size_t from) {
+        if (mWordBreaks == nullptr) {
+            return mBreaker.followingWithLocale(locale, from);
+        }
+        mBreaks = findWordBreaks(*mWordBreaks, from);
+        MINIKIN_ASSERT(mBreaks != nullptr, "The word breaks must be computed from the run start.");
+        mIndex = 0;
+        return current().offset;
+    }
+
+    ssize_t next() {
+        if (mWordBreaks == nullptr) {
+            return mBreaker.next();
+        }
+        if (mIndex + 1 < mBreaks->size()) {
+            mIndex++;
+        }
+        return current().offset;
+    }
+
+    Range wordRange() const {
+        return mWordBreaks != nullptr ? current().wordRange : mBreaker.wordRange();
+    }
+
+    int breakBadness() const {
+        return mWordBreaks != nullptr ? current().badness : mBreaker.breakBadness();
+    }
+
+private:
+    const WordBreakPoint& current() const { return (*mBreaks)[mIndex]; }
+
+    WordBreaker mOwnBreaker;
+    WordBreaker& mBreaker;
+    // The kept or the cached word breaks, or null if WordBreaker runs along the iteration.
+    const WordBreaks* mWordBreaks = nullptr;
+    std::shared_ptr<const WordBreaks> mCachedWordBreaks;
+    const std::vector<WordBreakPoint>* mBreaks = nullptr;
+    size_t mIndex = 0;
+};
+
 // Processes and retrieve informations from characters in the paragraph.
 struct CharProcessor {
     // The number of spaces.
@@ -143,7 +261,9 @@ struct CharProcessor {
     // Returns the break penalty for the current word break point.
     inline int wordBreakPenalty() const { return breaker.breakBadness(); }
 
-    CharProcessor(const U16StringPiece& text) { breaker.setText(text.data(), text.size()); }
+    CharProcessor(const U16StringPiece& text, const MeasuredText& measured,
+                  WordBreaker* wordBreaker = nullptr)
+            : breaker(text, measured, wordBreaker) {}
 
     // The user of CharProcessor must call updateLocaleIfNecessary with valid locale at least one
     // time before feeding characters.
@@ -185,7 +305,7 @@ private:
     // The current locale list id.
     uint32_t localeListId = LocaleListCache::kInvalidListId;
 
-    WordBreaker breaker;
+    WordBreakIterator breaker;
 };
 }  // namespace minikin
 
@@ -16,8 +16,6 @@
 
 #include "Locale.h"
 
-#include <algorithm>
-
 #include <hb.h>
 
 #include "minikin/LocaleList.h"
@@ -46,19 +44,6 @@ std::string getLocaleString(uint32_t localeId) {
     return out;
 }
 
-// Check if a language code supports extension such as emoji and line break etc. according to its
-// subtag
-static bool isSubtag(const char* buf, size_t bufLen, const char* subtag, size_t subtagLen) {
-    if (bufLen < subtagLen) {
-        return false;
-    }
-    if (strncmp(buf, subtag, subtagLen) != 0) {
-        return false;  // no match between two strings
-    }
-    return (bufLen == subtagLen || buf[subtagLen] == '\0' || buf[subtagLen] == '-' ||
-            buf[subtagLen] == '_');
-}
-
 // Pack the three letter code into 15 bits and stored to 16 bit integer. The highest bit is 0.
 // For the region code, the letters must be all digits in three letter case, so the number of
 // possible values are 10. For the language code, the letters must be all small alphabets, so the
@@ -219,7 +204,7 @@ Locale::Locale(const StringPiece& input) : Locale() {
         }
     }
 
-    resolveUnicodeExtension(input.data(), input.length());
+    resolveUnicodeExtension(token, &it);
 
 finalize:
     if (mEmojiStyle == EmojiStyle::EMPTY) {
@@ -227,61 +212,59 @@ finalize:
     }
 }
 
-void Locale::resolveUnicodeExtension(const char* buf, size_t length) {
-    static const char kPrefix[] = "-u-";
-    const char* pos = std::search(buf, buf + length, kPrefix, kPrefix + strlen(kPrefix));
-    if (pos != buf + length) {
-        pos += strlen(kPrefix);
-        const size_t remainingLength = length - (pos - buf);
-        mLBStyle = resolveLineBreakStyle(pos, remainingLength);
-        mEmojiStyle = resolveEmojiStyle(pos, remainingLength);
+// Continues the scan of the subtags from the given token and resolves the keywords of the first
+// Unicode extension ("-u-"). Only the first occurrence of the "lb" and "em" keys is used, even if
+// its type is unknown. Keys of a later "-u-" are also seen since they are in the same scan.
+void Locale::resolveUnicodeExtension(StringPiece token, SplitIterator* it) {
+    bool inExtension = false;
+    bool hasLBKey = false;
+    bool hasEmojiKey = false;
+    StringPiece key;
+    while (true) {
+        if (!inExtension) {
+            inExtension = token == "u";
+        } else {
+            if (!hasLBKey && key == "lb") {
+                mLBStyle = resolveLineBreakStyle(token);
+                hasLBKey = true;
+            } else if (!hasEmojiKey && key == "em") {
+                mEmojiStyle = resolveEmojiStyle(token);
+                hasEmojiKey = true;
+            }
+            if (hasLBKey && hasEmojiKey) {
+                return;
+            }
+            key = token;
+        }
+        if (!it->hasNext()) {
+            return;
+        }
+        token = it->next();
     }
 }
 
 // static
-// Lookup line break subtag and determine the line break style.
-LineBreakStyle Locale::resolveLineBreakStyle(const char* buf, size_t length) {
-    // 8 is the length of "-u-lb-loose", which is the shortest line break subtag,
-    // unnecessary comparison can be avoided if total length is smaller than 11.
-    const size_t kMinSubtagLength = 8;
-    if (length >= kMinSubtagLength) {
-        static const char kPrefix[] = "lb-";
-        const char* pos = std::search(buf, buf + length, kPrefix, kPrefix + strlen(kPrefix));
-        if (pos != buf + length) {  // found
-            pos += strlen(kPrefix);
-            const size_t remainingLength = length - (pos - buf);
-            if (isSubtag(pos, remainingLength, "loose", 5)) {
-                return LineBreakStyle::LOOSE;
-            } else if (isSubtag(pos, remainingLength, "normal", 6)) {
-                return LineBreakStyle::NORMAL;
-            } else if (isSubtag(pos, remainingLength, "strict", 6)) {
-                return LineBreakStyle::STRICT;
-            }
-        }
+// Determine the line break style from the type of the "lb" key.
+LineBreakStyle Locale::resolveLineBreakStyle(const StringPiece& type) {
+    if (type == "loose") {
+        return LineBreakStyle::LOOSE;
+    } else if (type == "normal") {
+        return LineBreakStyle::NORMAL;
+    } else if (type == "strict") {
+        return LineBreakStyle::STRICT;
     }
     return LineBreakStyle::EMPTY;
 }
 
 // static
-// Lookup emoji subtag and determine the emoji style.
-EmojiStyle Locale::resolveEmojiStyle(const char* buf, size_t length) {
-    // 7 is the length of "-u-em-text", which is the shortest emoji subtag,
-    // unnecessary comparison can be avoided if total length is smaller than 10.
-    const size_t kMinSubtagLength = 7;
-    if (length >= kMinSubtagLength) {
-        static const char kPrefix[] = "em-";
-        const char* pos = std::search(buf, buf + length, kPrefix, kPrefix + strlen(kPrefix));
-        if (pos != buf + length) {  // found
-            pos += strlen(kPrefix);
-            const size_t remainingLength = length - (pos - buf);
-            if (isSubtag(pos, remainingLength, "emoji", 5)) {
-                return EmojiStyle::EMOJI;
-            } else if (isSubtag(pos, remainingLength, "text", 4)) {
-                return EmojiStyle::TEXT;
-            } else if (isSubtag(pos, remainingLength, "default", 7)) {
-                return EmojiStyle::DEFAULT;
-            }
-        }
+// Determine the emoji style from the type of the "em" key.
+EmojiStyle Locale::resolveEmojiStyle(const StringPiece& type) {
+    if (type == "emoji") {
+        return EmojiStyle::EMOJI;
+    } else if (type == "text") {
+        return EmojiStyle::TEXT;
+    } else if (type == "default") {
+        return EmojiStyle::DEFAULT;
     }
     return EmojiStyle::EMPTY;
 }
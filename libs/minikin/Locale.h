@@ -189,7 +189,7 @@ private:
     EmojiStyle mEmojiStyle;
     LineBreakStyle mLBStyle;
 
-    void resolveUnicodeExtension(const char* buf, size_t length);
+    void resolveUnicodeExtension(StringPiece token, SplitIterator* it);
 
     inline static uint64_t extractBits(uint64_t value, uint8_t shift, uint8_t nBits) {
         return (value >> shift) & ((1 << nBits) - 1);
@@ -197,8 +197,8 @@ private:
 
     static uint8_t scriptToSubScriptBits(uint32_t rawScript);
 
-    static LineBreakStyle resolveLineBreakStyle(const char* buf, size_t length);
-    static EmojiStyle resolveEmojiStyle(const char* buf, size_t length);
+    static LineBreakStyle resolveLineBreakStyle(const StringPiece& type);
+    static EmojiStyle resolveEmojiStyle(const StringPiece& type);
     static EmojiStyle scriptToEmojiStyle(uint32_t script);
 
     // Returns true if the provide subscript bits has the requested subscript bits.
@@ -215,6 +215,7 @@ public:
               mIsAllTheSameLocale(false),
               mEmojiStyle(EmojiStyle::EMPTY) {}
     LocaleList(LocaleList&&) = default;
+    LocaleList& operator=(LocaleList&&) = default;
 
     size_t size() const { return mLocales.size(); }
     bool empty() const { return mLocales.empty(); }
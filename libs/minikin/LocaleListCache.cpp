@@ -117,23 +117,66 @@ size_t LocaleListCache::LocaleVectorHash::operator()(const std::vector<Locale>&
     return hasher.hash();
 }
 
-LocaleListCache::LocaleListCache() {
+LocaleListCache::LocaleListCache() : mLocaleListCount(0) {
     // Insert an empty locale list for mapping default locale list to kEmptyLocaleListId.
     // The default locale list has only one Locale and it is the unsupported locale.
-    mLocaleLists.emplace_back();
+    std::lock_guard<std::mutex> lock(mMutex);
+    appendLocaleList(LocaleList());
     mLocaleListLookupTable.emplace(std::vector<Locale>(), kEmptyLocaleListId);
     mLocaleListStringCache.emplace("", kEmptyLocaleListId);
 }
 
+LocaleListCache::~LocaleListCache() {
+    for (std::atomic<LocaleList*>& segment : mSegments) {
+        delete[] segment.load(std::memory_order_relaxed);
+    }
+}
+
+// Returns the slot of the ID. The segment of the ID must be allocated.
+LocaleList* LocaleListCache::getSlot(uint32_t id) const {
+    // Segment k starts at ((1 << k) - 1) << kLogFirstSegmentSize, so offsetting the ID by the
+    // first segment size makes the segment index the position of the highest bit.
+    const uint32_t pos = id + (1u << kLogFirstSegmentSize);
+    const uint32_t highestBit = 31 - __builtin_clz(pos);
+    const uint32_t segment = highestBit - kLogFirstSegmentSize;
+    return mSegments[segment].load(std::memory_order_acquire) + (pos - (1u << highestBit));
+}
+
+uint32_t LocaleListCache::appendLocaleList(LocaleList&& localeList) {
+    const uint32_t id = mLocaleListCount.load(std::memory_order_relaxed);
+    const uint32_t pos = id + (1u << kLogFirstSegmentSize);
+    if ((pos & (pos - 1)) == 0) {
+        // The ID is the first one of a segment.
+        const uint32_t segment = (31 - __builtin_clz(pos)) - kLogFirstSegmentSize;
+        MINIKIN_ASSERT(segment < kMaxSegmentCount, "Too many locale lists.");
+        mSegments[segment].store(new LocaleList[pos], std::memory_order_release);
+    }
+    *getSlot(id) = std::move(localeList);
+    // Publishes the list. getByIdInternal() only reads the IDs below the count.
+    mLocaleListCount.store(id + 1, std::memory_order_release);
+    return id;
+}
+
 uint32_t LocaleListCache::getIdInternal(const std::string& locales) {
-    std::lock_guard<std::mutex> lock(mMutex);
-    const auto& it = mLocaleListStringCache.find(locales);
+    std::atomic<const StringCacheEntry*>& slot =
+            mStringFrontCache[std::hash<std::string>()(locales) % kStringFrontCacheSize];
+    const StringCacheEntry* entry = slot.load(std::memory_order_acquire);
+    if (entry != nullptr && entry->first == locales) {
+        mStats.hit();
+        return entry->second;
+    }
+
+    std::unique_lock<std::mutex> lock = mStats.lock(mMutex);
+    auto it = mLocaleListStringCache.find(locales);
     if (it != mLocaleListStringCache.end()) {
-        return it->second;
+        mStats.hit();
+    } else {
+        mStats.miss();
+        uint32_t id = getIdInternal(parseLocaleList(locales));
+        it = mLocaleListStringCache.emplace(locales, id).first;
     }
-    uint32_t id = getIdInternal(parseLocaleList(locales));
-    mLocaleListStringCache.emplace(locales, id);
-    return id;
+    slot.store(&*it, std::memory_order_release);
+    return it->second;
 }
 
 uint32_t LocaleListCache::getIdInternal(std::vector<Locale>&& locales) {
@@ -146,10 +189,11 @@ uint32_t LocaleListCache::getIdInternal(std::vector<Locale>&& locales) {
     }
 
     // Given locale list is not in cache. Insert it and return newly assigned ID.
-    const uint32_t nextId = mLocaleLists.size();
+    const uint32_t nextId = mLocaleListCount.load(std::memory_order_relaxed);
     mLocaleListLookupTable.emplace(locales, nextId);
     LocaleList fontLocales(std::move(locales));
-    mLocaleLists.push_back(std::move(fontLocales));
+    appendLocaleList(std::move(fontLocales));
+    mStats.insert();
     return nextId;
 }
 
@@ -173,9 +217,28 @@ void LocaleListCache::writeToInternal(BufferWriter* writer, uint32_t id) {
 }
 
 const LocaleList& LocaleListCache::getByIdInternal(uint32_t id) {
+    MINIKIN_ASSERT(id < mLocaleListCount.load(std::memory_order_acquire),
+                   "Lookup by unknown locale list ID.");
+    return *getSlot(id);
+}
+
+size_t LocaleListCache::getCacheSizeInternal() {
+    return mLocaleListCount.load(std::memory_order_acquire);
+}
+
+size_t LocaleListCache::getMemoryUsageInternal() {
     std::lock_guard<std::mutex> lock(mMutex);
-    MINIKIN_ASSERT(id < mLocaleLists.size(), "Lookup by unknown locale list ID.");
-    return mLocaleLists[id];
+    size_t usage = 0;
+    const uint32_t count = mLocaleListCount.load(std::memory_order_relaxed);
+    for (uint32_t id = 0; id < count; id++) {
+        const LocaleList& localeList = *getSlot(id);
+        usage += sizeof(LocaleList) + localeList.size() * (sizeof(Locale) + sizeof(hb_language_t));
+    }
+    usage += mLocaleListLookupTable.size() * (sizeof(std::vector<Locale>) + sizeof(uint32_t));
+    for (const auto& it : mLocaleListStringCache) {
+        usage += sizeof(std::string) + it.first.size() + sizeof(uint32_t);
+    }
+    return usage;
 }
 
 }  // namespace minikin
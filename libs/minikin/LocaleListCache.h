@@ -17,10 +17,13 @@
 #ifndef MINIKIN_LOCALE_LIST_CACHE_H
 #define MINIKIN_LOCALE_LIST_CACHE_H
 
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
+#include <utility>
 
 #include "minikin/Buffer.h"
+#include "minikin/CacheStats.h"
 #include "minikin/Macros.h"
 
 #include "Locale.h"
@@ -46,23 +49,46 @@ public:
         return getInstance().writeToInternal(writer, id);
     }
 
+    // Checks that the buffer holds a LocaleList written by writeTo(), see BufferValidator.
+    static void validate(BufferValidator* validator) {
+        const uint32_t size = validator->read<uint32_t>();
+        for (uint32_t i = 0; i < size && validator->ok(); i++) {
+            validator->skip<uint64_t>();
+        }
+    }
+
     static inline const LocaleList& getById(uint32_t id) {
         return getInstance().getByIdInternal(id);
     }
 
+    // Returns the statistics of the string to ID lookups done by getId().
+    static inline const CacheStats& getStats() { return getInstance().mStats; }
+    static inline void resetStats() { getInstance().mStats.reset(); }
+
+    // Returns the number of registered locale lists.
+    static inline size_t getCacheSize() { return getInstance().getCacheSizeInternal(); }
+
+    // Returns the approximate memory used by the registered locale lists and the string cache.
+    static inline size_t getMemoryUsage() { return getInstance().getMemoryUsageInternal(); }
+
 private:
     struct LocaleVectorHash {
         size_t operator()(const std::vector<Locale>& locales) const;
     };
 
     LocaleListCache();  // Singleton
-    ~LocaleListCache() {}
+    ~LocaleListCache();
 
     uint32_t getIdInternal(const std::string& locales);
     uint32_t getIdInternal(std::vector<Locale>&& locales) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
     uint32_t readFromInternal(BufferReader* reader);
     void writeToInternal(BufferWriter* writer, uint32_t id);
     const LocaleList& getByIdInternal(uint32_t id);
+    size_t getCacheSizeInternal();
+    size_t getMemoryUsageInternal();
+    // Appends the list and publishes it to getByIdInternal(). Returns the new ID.
+    uint32_t appendLocaleList(LocaleList&& localeList) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    LocaleList* getSlot(uint32_t id) const;
 
     // Caller should acquire a lock before calling the method.
     static LocaleListCache& getInstance() {
@@ -70,7 +96,14 @@ private:
         return instance;
     }
 
-    std::vector<LocaleList> mLocaleLists GUARDED_BY(mMutex);
+    // The locale lists indexed by ID. The lists are stored in segments that never move once
+    // allocated, the k-th one having (kFirstSegmentSize << k) entries, so that getById() can read
+    // the published lists without locking. Only the appends are serialized by mMutex.
+    static constexpr uint32_t kLogFirstSegmentSize = 4;
+    static constexpr uint32_t kMaxSegmentCount = 24;
+    std::atomic<LocaleList*> mSegments[kMaxSegmentCount] = {};
+    // The number of the published lists.
+    std::atomic<uint32_t> mLocaleListCount;
 
     // A map from the list of locale identifier to the ID.
     //
@@ -85,6 +118,15 @@ private:
     // mLocaleListLookupTable even if they are not in mLocaleListStringCache.
     std::unordered_map<std::string, uint32_t> mLocaleListStringCache GUARDED_BY(mMutex);
 
+    // A lock-free, direct-mapped cache in front of mLocaleListStringCache for the repeated lookups
+    // of the same strings. The slots point to the entries of mLocaleListStringCache, which are
+    // never erased and don't move on rehash.
+    using StringCacheEntry = std::pair<const std::string, uint32_t>;
+    static constexpr size_t kStringFrontCacheSize = 64;
+    std::atomic<const StringCacheEntry*> mStringFrontCache[kStringFrontCacheSize] = {};
+
+    CacheStats mStats;
+
     std::mutex mMutex;
 };
 
@@ -17,32 +17,50 @@
 #define LOG_TAG "Minikin"
 #include "minikin/MeasuredText.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <unicode/uscript.h>
+#include <unicode/utf16.h>
+
+#include "minikin/CallRecorder.h"
+#include "minikin/Executor.h"
 #include "minikin/Layout.h"
+#include "minikin/LocaleList.h"
 
 #include "BidiUtils.h"
+#include "LatencyStats.h"
 #include "LayoutSplitter.h"
 #include "LayoutUtils.h"
+#include "LineBreakResultCache.h"
 #include "LineBreakerUtil.h"
+#include "ParallelFor.h"
+#include "PieceExtentTable.h"
+#include "PieceLayoutTable.h"
+#include "ScopedCallRecord.h"
+#include "TraceSpan.h"
+#include "WordBreakCache.h"
 
 namespace minikin {
 
 // Helper class for composing character advances.
 class AdvancesCompositor {
 public:
-    AdvancesCompositor(std::vector<float>* outAdvances, LayoutPieces* outPieces)
-            : mOutAdvances(outAdvances), mOutPieces(outPieces) {}
+    AdvancesCompositor(std::vector<float>* outAdvances, LayoutPieces* outPieces, uint32_t paintId)
+            : mOutAdvances(outAdvances), mOutPieces(outPieces), mPaintId(paintId) {}
 
     void setNextRange(const Range& range, bool dir) {
         mRange = range;
         mDir = dir;
     }
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-        const std::vector<float>& advances = layoutPiece.advances();
+    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+        const LayoutPiece::Span<float> advances = layoutPiece.advances();
         std::copy(advances.begin(), advances.end(), mOutAdvances->begin() + mRange.getStart());
 
         if (mOutPieces != nullptr) {
-            mOutPieces->insert(mRange, 0 /* no edit */, layoutPiece, mDir, paint);
+            mOutPieces->insert(mRange, 0 /* no edit */, layoutPiece, mDir, mPaintId);
         }
     }
 
@@ -51,24 +69,24 @@ private:
     bool mDir;
     std::vector<float>* mOutAdvances;
     LayoutPieces* mOutPieces;
+    const uint32_t mPaintId;
 };
 
 void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* advances,
                           LayoutPieces* precomputed, LayoutPieces* outPieces) const {
-    AdvancesCompositor compositor(advances, outPieces);
+    AdvancesCompositor compositor(advances, outPieces, mPaintId);
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
-    const uint32_t paintId =
-            (precomputed == nullptr) ? LayoutPieces::kNoPaintId : precomputed->findPaintId(mPaint);
+    const bool hasPrecomputed = precomputed != nullptr && precomputed->hasPaintId(mPaintId);
     for (const BidiText::RunInfo info : BidiText(textBuf, mRange, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
             compositor.setNextRange(piece, info.isRtl);
-            if (paintId == LayoutPieces::kNoPaintId) {
+            if (!hasPrecomputed) {
                 LayoutCache::getInstance().getOrCreate(
-                        textBuf.substr(context), piece - context.getStart(), mPaint, info.isRtl,
-                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, compositor);
+                        textBuf.substr(context), piece - context.getStart(), mPaint, mPaintId,
+                        info.isRtl, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, compositor);
             } else {
                 precomputed->getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
-                                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, paintId,
+                                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, mPaintId,
                                          compositor);
             }
         }
@@ -78,7 +96,8 @@ void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* adv
 // Helper class for composing total amount of advance
 class TotalAdvanceCompositor {
 public:
-    TotalAdvanceCompositor(LayoutPieces* outPieces) : mTotalAdvance(0), mOutPieces(outPieces) {}
+    TotalAdvanceCompositor(LayoutPieces* outPieces, uint32_t paintId)
+            : mTotalAdvance(0), mOutPieces(outPieces), mPaintId(paintId) {}
 
     void setNextContext(const Range& range, HyphenEdit edit, bool dir) {
         mRange = range;
@@ -86,10 +105,10 @@ public:
         mDir = dir;
     }
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
+    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
         mTotalAdvance += layoutPiece.advance();
         if (mOutPieces != nullptr) {
-            mOutPieces->insert(mRange, mEdit, layoutPiece, mDir, paint);
+            mOutPieces->insert(mRange, mEdit, layoutPiece, mDir, mPaintId);
         }
     }
 
@@ -101,12 +120,13 @@ private:
     HyphenEdit mEdit;
     bool mDir;
     LayoutPieces* mOutPieces;
+    const uint32_t mPaintId;
 };
 
 float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& range,
                                    StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                                    LayoutPieces* pieces) const {
-    TotalAdvanceCompositor compositor(pieces);
+    TotalAdvanceCompositor compositor(pieces, mPaintId);
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
     for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
@@ -117,25 +137,232 @@ float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& r
 
             compositor.setNextContext(piece, packHyphenEdit(startEdit, endEdit), info.isRtl);
             LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
-                                                   piece - context.getStart(), mPaint, info.isRtl,
-                                                   startEdit, endEdit, compositor);
+                                                   piece - context.getStart(), mPaint, mPaintId,
+                                                   info.isRtl, startEdit, endEdit, compositor);
         }
     }
     return compositor.advance();
 }
 
-void MeasuredText::measure(const U16StringPiece& textBuf, bool computeHyphenation,
-                           bool computeLayout, MeasuredText* hint) {
-    if (textBuf.size() == 0) {
+bool StyleRun::canApproximateHyphenPieces(const U16StringPiece& textBuf,
+                                          const Range& range) const {
+    // The font features may be contextual, e.g. contextual alternates or swashes at the end.
+    if (!mPaint.fontFeatureSettings.empty()) {
+        return false;
+    }
+    for (uint32_t i = range.getStart(); i < range.getEnd();) {
+        uint32_t c;
+        U16_NEXT(textBuf.data(), i, range.getEnd(), c);
+        UErrorCode errorCode = U_ZERO_ERROR;
+        const UScriptCode script = uscript_getScript(static_cast<UChar32>(c), &errorCode);
+        if (U_FAILURE(errorCode)) {
+            return false;
+        }
+        // Combining marks are inherited and may be positioned against the base differently.
+        if (script != USCRIPT_LATIN && script != USCRIPT_GREEK && script != USCRIPT_CYRILLIC &&
+            script != USCRIPT_COMMON) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float StyleRun::getHyphenEditAdvance(StartHyphenEdit startHyphen, EndHyphenEdit endHyphen) const {
+    float advance = 0;
+    for (const HyphenEdit edit : {packHyphenEdit(startHyphen, EndHyphenEdit::NO_EDIT),
+                                  packHyphenEdit(StartHyphenEdit::NO_EDIT, endHyphen)}) {
+        if (edit == 0) {
+            continue;
+        }
+        float editAdvance = mHyphenEditAdvances[edit].load(std::memory_order_relaxed);
+        if (std::isnan(editAdvance)) {
+            editAdvance = measureHyphenEditAdvance(edit);
+            mHyphenEditAdvances[edit].store(editAdvance, std::memory_order_relaxed);
+        }
+        advance += editAdvance;
+    }
+    return advance;
+}
+
+float StyleRun::measureHyphenEditAdvance(HyphenEdit edit) const {
+    // The hyphens are laid out with the font of the character next to them, so they are measured
+    // next to a space, which every font has, and the advance of the space is taken off.
+    const uint16_t space[] = {' '};
+    const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
+    const float spaceAdvance =
+            Layout::measureText(space, Range(0, 1), bidiFlag, mPaint, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, nullptr);
+    return Layout::measureText(space, Range(0, 1), bidiFlag, mPaint, startHyphenEdit(edit),
+                               endHyphenEdit(edit), nullptr) -
+           spaceAdvance;
+}
+
+namespace {
+
+// Copies the pieces of the hint which are not affected by the edit, moved to their offsets in the
+// edited text. A piece is only laid out within its context, which never crosses a word break for
+// the cache, so the pieces before the last such break before the edit and after the first one
+// after it were laid out from the same text as they would be now.
+void remapHintPieces(const U16StringPiece& textBuf, const TextEdit& edit, const LayoutPieces& hint,
+                     LayoutPieces* out) {
+    const uint32_t newEditEnd = edit.start + edit.insertedLength;
+    MINIKIN_ASSERT(newEditEnd <= textBuf.size(), "The edit must be in the text.");
+    // The breaks depend on the code units just before and after them, which are outside the edit.
+    const uint32_t safeEnd = getPrevWordBreakForCache(textBuf, edit.start);
+    const uint32_t safeStart = getNextWordBreakForCache(textBuf, newEditEnd);
+    const uint32_t oldSafeStart = safeStart - edit.insertedLength + edit.removedLength;
+
+    out->paintIds = hint.paintIds;
+    for (const auto& [key, piece] : hint.offsetMap) {
+        if (key.range.getEnd() <= safeEnd) {
+            out->offsetMap.emplace(key, piece);
+        } else if (key.range.getStart() >= oldSafeStart) {
+            const Range range(key.range.getStart() - edit.removedLength + edit.insertedLength,
+                              key.range.getEnd() - edit.removedLength + edit.insertedLength);
+            out->offsetMap.emplace(std::piecewise_construct,
+                                   std::forward_as_tuple(range, key.hyphenEdit, key.dir,
+                                                         key.paintId),
+                                   std::forward_as_tuple(piece));
+        }
+    }
+}
+
+bool isCancelled(const std::atomic<bool>* cancelled) {
+    return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+bool MeasuredText::measureRunsInParallel(const U16StringPiece& textBuf, bool computeLayout,
+                                         LayoutPieces* hintPieces, uint32_t maxThreads,
+                                         const std::atomic<bool>* cancelled) {
+    if (maxThreads == 0) {
+        maxThreads = getExecutor()->getConcurrency() + 1;
+    }
+    const size_t threadCount = std::min<size_t>(maxThreads, runs.size());
+
+    // The runs write disjoint ranges of the widths. The layout pieces are collected per thread and
+    // merged afterwards since LayoutPieces is not thread safe.
+    std::vector<LayoutPieces> threadPieces(computeLayout ? threadCount : 0);
+    std::atomic<size_t> nextRun(0);
+    parallelFor(threadCount, threadCount, [&](size_t threadIndex) {
+        LayoutPieces* piecesOut = computeLayout ? &threadPieces[threadIndex] : nullptr;
+        for (size_t i = nextRun++; i < runs.size(); i = nextRun++) {
+            if (isCancelled(cancelled)) {
+                return;
+            }
+            runs[i]->getMetrics(textBuf, &widths, hintPieces, piecesOut);
+        }
+    });
+    for (LayoutPieces& pieces : threadPieces) {
+        layoutPieces.merge(std::move(pieces));
+    }
+    return !isCancelled(cancelled);
+}
+
+MeasuredText::MeasuredText(const U16StringPiece& textBuf, std::vector<std::unique_ptr<Run>>&& runs,
+                           bool computeHyphenation, bool computeLayout, bool lazyHyphenation,
+                           MeasuredText* hint, const TextEdit* hintEdit, uint32_t maxThreads,
+                           bool compact, bool keepWordBreaks, uint32_t lineBreakCacheSize,
+                           bool approximateHyphenPieces, const std::atomic<bool>* cancelled)
+        : widths(textBuf.size()),
+          runs(std::move(runs)),
+          mLazyHyphenation(computeHyphenation && lazyHyphenation),
+          mApproximateHyphenPieces(approximateHyphenPieces) {
+    const ScopedCallRecord callRecord;
+    if (mLazyHyphenation) {
+        mLazyHyphenBreaks = std::make_unique<LazyHyphenBreaks>();
+    }
+    if (keepWordBreaks) {
+        computeWordBreaks(textBuf);
+    }
+    if (!measure(textBuf, computeHyphenation && !mLazyHyphenation, computeLayout, hint, hintEdit,
+                 maxThreads, cancelled)) {
         return;
     }
+    if (compact) {
+        compactWidths();
+    }
+    if (lineBreakCacheSize > 0) {
+        mLineBreakCache = std::make_unique<LineBreakResultCache>(lineBreakCacheSize);
+    }
+    if (callRecord.isEnabled()) {
+        RecordedCall call;
+        call.type = RecordedCall::Type::kMeasuredTextBuild;
+        call.durationNanos = callRecord.getElapsedNanos();
+        call.text.assign(textBuf.data(), textBuf.data() + textBuf.size());
+        for (const auto& run : this->runs) {
+            RecordedCall::Run recordedRun;
+            recordedRun.range = run->getRange();
+            recordedRun.isRtl = run->isRtl();
+            if (const MinikinPaint* paint = run->getPaint()) {
+                recordedRun.paint = RecordedPaint::from(*paint);
+            } else {
+                recordedRun.isReplacement = true;
+                recordedRun.width =
+                        run->getRange().isEmpty() ? 0 : widthAt(run->getRange().getStart());
+                recordedRun.locales = getLocaleString(run->getLocaleListId());
+            }
+            call.runs.push_back(std::move(recordedRun));
+        }
+        call.computeHyphenation = computeHyphenation;
+        call.computeLayout = computeLayout;
+        call.lazyHyphenation = lazyHyphenation;
+        call.hasHint = hint != nullptr;
+        call.maxThreads = maxThreads;
+        call.compactWidths = compact;
+        call.keepWordBreaks = keepWordBreaks;
+        call.lineBreakCacheSize = lineBreakCacheSize;
+        call.approximateHyphenPieces = approximateHyphenPieces;
+        mRecordedId = CallRecorder::nextMeasuredTextId();
+        call.measuredTextId = mRecordedId;
+        CallRecorder::record(call);
+    }
+}
+
+MeasuredText::~MeasuredText() {}
+
+MeasuredText::MeasuredText(MeasuredText&&) = default;
+
+MeasuredText& MeasuredText::operator=(MeasuredText&&) = default;
+
+bool MeasuredText::measure(const U16StringPiece& textBuf, bool computeHyphenation,
+                           bool computeLayout, MeasuredText* hint, const TextEdit* hintEdit,
+                           uint32_t maxThreads, const std::atomic<bool>* cancelled) {
+    if (textBuf.size() == 0) {
+        return true;
+    }
+    MINIKIN_TRACE("MeasuredText::measure", textBuf.size(), runs.size());
+    ScopedLatency latency(LatencyStats::kMeasurePerKiloCodeUnit, textBuf.size());
+
+    LayoutPieces* hintPieces = hint ? &hint->layoutPieces : nullptr;
+    LayoutPieces remappedHintPieces;
+    if (hint != nullptr && hintEdit != nullptr) {
+        remapHintPieces(textBuf, *hintEdit, hint->layoutPieces, &remappedHintPieces);
+        hintPieces = &remappedHintPieces;
+    }
+
+    const bool measuredInParallel = maxThreads != 1 && runs.size() > 1;
+    if (measuredInParallel &&
+        !measureRunsInParallel(textBuf, computeLayout, hintPieces, maxThreads, cancelled)) {
+        return false;
+    }
 
     LayoutPieces* piecesOut = computeLayout ? &layoutPieces : nullptr;
-    CharProcessor proc(textBuf);
+    CharProcessor proc(textBuf, *this);
     for (const auto& run : runs) {
+        if (isCancelled(cancelled)) {
+            return false;
+        }
         const Range& range = run->getRange();
-        run->getMetrics(textBuf, &widths, hint ? &hint->layoutPieces : nullptr, piecesOut);
+        if (!measuredInParallel) {
+            run->getMetrics(textBuf, &widths, hintPieces, piecesOut);
+        }
 
+        if (computeHyphenation && hasWordBreaks()) {
+            // The kept word breaks are replayed from the start of every run with a new locale.
+            proc.updateLocaleIfNecessary(*run);
+        }
         if (!computeHyphenation || !run->canBreak()) {
             continue;
         }
@@ -153,9 +380,81 @@ void MeasuredText::measure(const U16StringPiece& textBuf, bool computeHyphenatio
             }
 
             populateHyphenationPoints(textBuf, *run, *proc.hyphenator, proc.contextRange(),
-                                      proc.wordRange(), &hyphenBreaks, piecesOut);
+                                      proc.wordRange(), &hyphenBreaks, piecesOut,
+                                      mApproximateHyphenPieces ? this : nullptr);
         }
     }
+
+    if (computeLayout) {
+        // All the pieces are in layoutPieces, so collecting their extents is cheap.
+        mPieceExtents = std::make_unique<PieceExtentTable>(textBuf, runs, layoutPieces);
+        mPieceLayouts = std::make_unique<PieceLayoutTable>(textBuf, runs, layoutPieces);
+    }
+    return true;
+}
+
+void MeasuredText::computeWordBreaks(const U16StringPiece& textBuf) {
+    if (textBuf.size() == 0) {
+        return;
+    }
+    WordBreaker breaker;
+    std::shared_ptr<const WordBreaks> cached =
+            WordBreakCache::getInstance().get(textBuf, runs, &breaker);
+    if (cached != nullptr) {
+        mWordBreaks = *cached;
+    } else {
+        WordBreakCache::compute(textBuf, runs, &breaker, &mWordBreaks);
+    }
+}
+
+void MeasuredText::compactWidths() {
+    mCompactWidths.resize(widths.size());
+    for (uint32_t i = 0; i < widths.size(); ++i) {
+        float scaled = std::round(widths[i] * COMPACT_WIDTH_SCALE);
+        if (scaled == 0 && widths[i] > 0) {
+            // Keep the widths below the smallest unit non-zero, the line breakers treat the zero
+            // widths as the continuation of a cluster.
+            scaled = 1;
+        }
+        if (scaled >= 0 && scaled < COMPACT_WIDTH_EXACT) {
+            mCompactWidths[i] = static_cast<uint16_t>(scaled);
+        } else {
+            mCompactWidths[i] = COMPACT_WIDTH_EXACT;
+            mExactWidths.emplace_back(i, widths[i]);
+        }
+    }
+    std::vector<float>().swap(widths);
+}
+
+float MeasuredText::exactWidthAt(uint32_t offset) const {
+    auto it = std::lower_bound(
+            mExactWidths.begin(), mExactWidths.end(), offset,
+            [](const std::pair<uint32_t, float>& entry, uint32_t o) { return entry.first < o; });
+    MINIKIN_ASSERT(it != mExactWidths.end() && it->first == offset,
+                   "The exact width must be stored for the offset.");
+    return it->second;
+}
+
+const std::vector<HyphenBreak>& MeasuredText::getHyphenBreaks(
+        const U16StringPiece& textBuf, const Run& run, const Hyphenator& hyphenator,
+        const Range& contextRange, const Range& hyphenationTargetRange) const {
+    MINIKIN_ASSERT(mLazyHyphenation, "Hyphenation points are already computed in hyphenBreaks.");
+    {
+        std::lock_guard lock(mLazyHyphenBreaks->mutex);
+        auto it = mLazyHyphenBreaks->breaks.find(contextRange.getStart());
+        if (it != mLazyHyphenBreaks->breaks.end()) {
+            return it->second;
+        }
+    }
+    // Not computed under the lock, which would serialize the line breakers of the text. If
+    // another thread computed the same word meanwhile, its result is kept.
+    std::vector<HyphenBreak> out;
+    populateHyphenationPoints(textBuf, run, hyphenator, contextRange, hyphenationTargetRange, &out,
+                              nullptr /* layout pieces */,
+                              mApproximateHyphenPieces ? this : nullptr);
+    std::lock_guard lock(mLazyHyphenBreaks->mutex);
+    return mLazyHyphenBreaks->breaks.try_emplace(contextRange.getStart(), std::move(out))
+            .first->second;
 }
 
 // Helper class for composing Layout object.
@@ -184,10 +483,10 @@ void StyleRun::appendLayout(const U16StringPiece& textBuf, const Range& range,
                                 ? mPaint.wordSpacing
                                 : 0;
     bool canUsePrecomputedResult = mPaint == paint;
+    const uint32_t paintId = canUsePrecomputedResult ? mPaintId : PaintIdCache::getId(paint);
 
     LayoutCompositor compositor(outLayout, wordSpacing);
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
-    const uint32_t paintId = pieces.findPaintId(mPaint);
     for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
             compositor.setOutOffset(piece.getStart() - outOrigin);
@@ -201,7 +500,7 @@ void StyleRun::appendLayout(const U16StringPiece& textBuf, const Range& range,
                                    paintId, compositor);
             } else {
                 LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
-                                                       piece - context.getStart(), paint,
+                                                       piece - context.getStart(), paint, paintId,
                                                        info.isRtl, startEdit, endEdit, compositor);
             }
         }
@@ -214,17 +513,7 @@ public:
     BoundsCompositor() : mAdvance(0) {}
 
     void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-        MinikinRect pieceBounds;
-        MinikinRect tmpRect;
-        for (uint32_t i = 0; i < layoutPiece.glyphCount(); ++i) {
-            const FakedFont& font = layoutPiece.fontAt(i);
-            const Point& point = layoutPiece.pointAt(i);
-
-            MinikinFont* minikinFont = font.font->typeface().get();
-            minikinFont->GetBounds(&tmpRect, layoutPiece.glyphIdAt(i), paint, font.fakery);
-            tmpRect.offset(point.x, point.y);
-            pieceBounds.join(tmpRect);
-        }
+        MinikinRect pieceBounds = layoutPiece.calculateBounds(paint);
         pieceBounds.offset(mAdvance, 0);
         mBounds.join(pieceBounds);
         mAdvance += layoutPiece.advance();
@@ -242,11 +531,10 @@ std::pair<float, MinikinRect> StyleRun::getBounds(const U16StringPiece& textBuf,
                                                   const LayoutPieces& pieces) const {
     BoundsCompositor compositor;
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
-    const uint32_t paintId = pieces.findPaintId(mPaint);
     for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
             pieces.getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
-                               StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, paintId,
+                               StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, mPaintId,
                                compositor);
         }
     }
@@ -268,15 +556,63 @@ private:
     MinikinExtent mExtent;
 };
 
+// Helper class for collecting the extent of each piece.
+class PieceExtentCompositor {
+public:
+    explicit PieceExtentCompositor(std::vector<std::pair<Range, MinikinExtent>>* out)
+            : mOut(out) {}
+
+    void setNextRange(const Range& range) { mRange = range; }
+
+    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+        mOut->emplace_back(mRange, layoutPiece.extent());
+    }
+
+private:
+    std::vector<std::pair<Range, MinikinExtent>>* mOut;
+    Range mRange;
+};
+
+void StyleRun::getPieceExtents(const U16StringPiece& textBuf, const LayoutPieces& pieces,
+                               std::vector<std::pair<Range, MinikinExtent>>* out) const {
+    PieceExtentCompositor compositor(out);
+    const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
+    for (const BidiText::RunInfo info : BidiText(textBuf, mRange, bidiFlag)) {
+        for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
+            compositor.setNextRange(piece);
+            pieces.getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
+                               StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, mPaintId,
+                               compositor);
+        }
+    }
+}
+
+void StyleRun::getPieceLayouts(const U16StringPiece& textBuf, const LayoutPieces& pieces,
+                               std::vector<std::pair<Range, const LayoutPiece*>>* out) const {
+    const size_t first = out->size();
+    const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
+    for (const BidiText::RunInfo info : BidiText(textBuf, mRange, bidiFlag)) {
+        for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
+            auto it = pieces.offsetMap.find(
+                    LayoutPieces::Key(piece, 0 /* no edit */, info.isRtl, mPaintId));
+            if (it == pieces.offsetMap.end()) {
+                // This piece would be laid out again, so the run lays out its ranges itself.
+                out->resize(first);
+                return;
+            }
+            out->emplace_back(piece, &it->second);
+        }
+    }
+}
+
 MinikinExtent StyleRun::getExtent(const U16StringPiece& textBuf, const Range& range,
                                   const LayoutPieces& pieces) const {
     ExtentCompositor compositor;
     Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
-    const uint32_t paintId = pieces.findPaintId(mPaint);
     for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
             pieces.getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
-                               StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, paintId,
+                               StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, mPaintId,
                                compositor);
         }
     }
@@ -287,9 +623,19 @@ Layout MeasuredText::buildLayout(const U16StringPiece& textBuf, const Range& ran
                                  const Range& contextRange, const MinikinPaint& paint,
                                  StartHyphenEdit startHyphen, EndHyphenEdit endHyphen) {
     Layout outLayout(range.getLength());
-    for (const auto& run : runs) {
-        const Range& runRange = run->getRange();
+    // The runs are in offset order, so the runs before the first one ending after the start of the
+    // range are skipped.
+    auto it = std::upper_bound(runs.begin(), runs.end(), range.getStart(),
+                               [](uint32_t o, const std::unique_ptr<Run>& run) {
+                                   return o < run->getRange().getEnd();
+                               });
+    for (; it != runs.end(); ++it) {
+        const Run& run = **it;
+        const Range& runRange = run.getRange();
         if (!Range::intersects(range, runRange)) {
+            if (runRange.getStart() >= range.getEnd()) {
+                break;
+            }
             continue;
         }
         const Range targetRange = Range::intersection(runRange, range);
@@ -297,8 +643,14 @@ Layout MeasuredText::buildLayout(const U16StringPiece& textBuf, const Range& ran
                 targetRange.getStart() == range.getStart() ? startHyphen : StartHyphenEdit::NO_EDIT;
         EndHyphenEdit endEdit =
                 targetRange.getEnd() == range.getEnd() ? endHyphen : EndHyphenEdit::NO_EDIT;
-        run->appendLayout(textBuf, targetRange, contextRange, layoutPieces, paint, range.getStart(),
-                          startEdit, endEdit, &outLayout);
+        if (mPieceLayouts) {
+            mPieceLayouts->appendLayout(textBuf, it - runs.begin(), run, targetRange, contextRange,
+                                        layoutPieces, paint, range.getStart(), startEdit, endEdit,
+                                        &outLayout);
+        } else {
+            run.appendLayout(textBuf, targetRange, contextRange, layoutPieces, paint,
+                             range.getStart(), startEdit, endEdit, &outLayout);
+        }
     }
     return outLayout;
 }
@@ -323,16 +675,72 @@ MinikinRect MeasuredText::getBounds(const U16StringPiece& textBuf, const Range&
 
 MinikinExtent MeasuredText::getExtent(const U16StringPiece& textBuf, const Range& range) const {
     MinikinExtent extent;
-    for (const auto& run : runs) {
-        const Range& runRange = run->getRange();
+    for (uint32_t i = 0; i < runs.size(); ++i) {
+        const Run& run = *runs[i];
+        const Range& runRange = run.getRange();
         if (!Range::intersects(range, runRange)) {
             continue;
         }
+        const Range targetRange = Range::intersection(runRange, range);
         MinikinExtent runExtent =
-                run->getExtent(textBuf, Range::intersection(runRange, range), layoutPieces);
+                mPieceExtents
+                        ? mPieceExtents->getExtent(textBuf, i, run, targetRange, layoutPieces)
+                        : run.getExtent(textBuf, targetRange, layoutPieces);
         extent.extendBy(runExtent);
     }
     return extent;
 }
 
+uint32_t MeasuredText::getPieceExtentsMemoryUsage() const {
+    return mPieceExtents ? mPieceExtents->getMemoryUsage() : 0;
+}
+
+uint32_t MeasuredText::getPieceLayoutsMemoryUsage() const {
+    return mPieceLayouts ? mPieceLayouts->getMemoryUsage() : 0;
+}
+
+std::shared_ptr<MeasuredTextBuild> MeasuredTextBuilder::buildAsync(
+        const U16StringPiece& textBuf, bool computeHyphenation, bool computeLayout,
+        bool lazyHyphenation, uint32_t maxThreads, Executor* executor, Callback&& callback) {
+    // std::function must be copyable, so the task shares its arguments instead of owning them.
+    struct Job {
+        std::vector<uint16_t> text;
+        std::vector<std::unique_ptr<Run>> runs;
+        std::shared_ptr<MeasuredTextBuild> build;
+        Callback callback;
+    };
+    auto job = std::make_shared<Job>();
+    job->text.assign(textBuf.data(), textBuf.data() + textBuf.size());
+    job->runs = std::move(mRuns);
+    job->build = std::make_shared<MeasuredTextBuild>();
+    job->callback = std::move(callback);
+    std::shared_ptr<MeasuredTextBuild> build = job->build;
+
+    auto task = [job, computeHyphenation, computeLayout, lazyHyphenation, maxThreads,
+                 compact = mCompactWidths, keepWordBreaks = mKeepWordBreaks,
+                 lineBreakCacheSize = mLineBreakCacheSize,
+                 approximateHyphenPieces = mApproximateHyphenPieces]() {
+        const std::atomic<bool>* cancelled = &job->build->mCancelled;
+        std::unique_ptr<MeasuredText> measured;
+        if (!isCancelled(cancelled)) {
+            measured.reset(new MeasuredText(
+                    job->text, std::move(job->runs), computeHyphenation, computeLayout,
+                    lazyHyphenation, nullptr /* hint */, nullptr /* hint edit */, maxThreads,
+                    compact, keepWordBreaks, lineBreakCacheSize, approximateHyphenPieces,
+                    cancelled));
+        }
+        if (isCancelled(cancelled)) {
+            // The text may be partially measured.
+            measured.reset();
+        }
+        job->runs.clear();
+        job->callback(std::move(measured));
+    };
+    if (executor == nullptr) {
+        executor = getExecutor();
+    }
+    executor->execute(std::move(task), Executor::Priority::kForeground);
+    return build;
+}
+
 }  // namespace minikin
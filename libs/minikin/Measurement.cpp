@@ -16,6 +16,7 @@
 
 #include "minikin/Measurement.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 
@@ -23,6 +24,7 @@
 #include "LayoutSplitter.h"
 #include "minikin/BoundsCache.h"
 #include "minikin/GraphemeBreak.h"
+#include "minikin/LayoutCache.h"
 
 namespace minikin {
 
@@ -84,10 +86,12 @@ float getRunAdvance(const float* advances, const uint16_t* buf, size_t start, si
  */
 size_t getOffsetForAdvance(const float* advances, const uint16_t* buf, size_t start, size_t count,
                            float advance) {
+    const std::vector<bool> isBreak =
+            GraphemeBreak::computeGraphemeBreaks(advances, buf, start, count);
     float x = 0.0f, xLastClusterStart = 0.0f, xSearchStart = 0.0f;
     size_t lastClusterStart = start, searchStart = start;
     for (size_t i = start; i < start + count; i++) {
-        if (GraphemeBreak::isGraphemeBreak(advances, buf, start, count, i)) {
+        if (isBreak[i - start]) {
             searchStart = lastClusterStart;
             xSearchStart = xLastClusterStart;
         }
@@ -104,7 +108,7 @@ size_t getOffsetForAdvance(const float* advances, const uint16_t* buf, size_t st
     size_t best = searchStart;
     float bestDist = FLT_MAX;
     for (size_t i = searchStart; i <= start + count; i++) {
-        if (GraphemeBreak::isGraphemeBreak(advances, buf, start, count, i)) {
+        if (isBreak[i - start]) {
             // "getRunAdvance(layout, buf, start, count, i) - advance" but more efficient
             float delta = getRunAdvance(advances, buf, start, searchStart, count - searchStart, i)
 
@@ -121,6 +125,81 @@ size_t getOffsetForAdvance(const float* advances, const uint16_t* buf, size_t st
     return best;
 }
 
+CaretIndex::CaretIndex(const float* advances, const uint16_t* buf, size_t start, size_t count)
+        : mStart(start), mCaretAdvances(count + 1) {
+    const size_t end = start + count;
+    const std::vector<bool> isBreak =
+            GraphemeBreak::computeGraphemeBreaks(advances, buf, start, count);
+
+    // Follows getRunAdvance, but walks the advances only once for all the offsets.
+    float advance = 0.0f;
+    size_t lastCluster = start;
+    float clusterWidth = 0.0f;
+    for (size_t offset = start; offset <= end;) {
+        if (offset == end || advances[offset - start] != 0.0f) {
+            mCaretAdvances[offset - start] = advance;
+            if (offset < end) {
+                advance += advances[offset - start];
+                lastCluster = offset;
+                clusterWidth = advances[offset - start];
+            }
+            offset++;
+            continue;
+        }
+        // The offsets in [offset, nextCluster) are in the middle of the cluster starting at
+        // lastCluster, and share its width between its grapheme clusters.
+        size_t nextCluster;
+        for (nextCluster = offset + 1; nextCluster < end; nextCluster++) {
+            if (advances[nextCluster - start] != 0.0f) break;
+        }
+        int numGraphemeClusters = 0;
+        int numGraphemeClustersAfter = 0;
+        for (size_t i = lastCluster; i < nextCluster; i++) {
+            if (isBreak[i - start]) {
+                numGraphemeClusters++;
+                if (i >= offset) {
+                    numGraphemeClustersAfter++;
+                }
+            }
+        }
+        for (; offset < nextCluster; offset++) {
+            float caret = advance;
+            if (numGraphemeClusters > 0) {
+                caret -= clusterWidth * numGraphemeClustersAfter / numGraphemeClusters;
+            }
+            mCaretAdvances[offset - start] = caret;
+            if (isBreak[offset - start]) {
+                numGraphemeClustersAfter--;
+            }
+        }
+    }
+
+    for (size_t i = start; i <= end; i++) {
+        if (isBreak[i - start]) {
+            mBreakOffsets.push_back(i);
+            mBreakAdvances.push_back(mCaretAdvances[i - start]);
+        }
+    }
+}
+
+size_t CaretIndex::getOffsetForAdvance(float advance) const {
+    if (mBreakOffsets.empty()) {
+        return mStart;
+    }
+    // Like getOffsetForAdvance, picks the closer of the last boundary before the advance and the
+    // first one at or after it, preferring the former.
+    const size_t next = std::lower_bound(mBreakAdvances.begin(), mBreakAdvances.end(), advance) -
+                        mBreakAdvances.begin();
+    if (next == mBreakAdvances.size()) {
+        return mBreakOffsets.back();
+    }
+    if (next > 0 && std::abs(mBreakAdvances[next - 1] - advance) <=
+                            std::abs(mBreakAdvances[next] - advance)) {
+        return mBreakOffsets[next - 1];
+    }
+    return mBreakOffsets[next];
+}
+
 struct BoundsComposer {
     BoundsComposer() : mAdvance(0) {}
 
@@ -131,13 +210,20 @@ struct BoundsComposer {
         mAdvance += advance;
     }
 
+    // For BoundsPrecision::FONT_EXTENT, the box spanning the advance and the extent of the piece.
+    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+        const MinikinExtent& extent = layoutPiece.extent();
+        (*this)(MinikinRect(0, extent.ascent, layoutPiece.advance(), extent.descent),
+                layoutPiece.advance());
+    }
+
     float mAdvance;
     MinikinRect mBounds;
 };
 
 void getBounds(const U16StringPiece& str, const Range& range, Bidi bidiFlag,
                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
-               MinikinRect* out) {
+               MinikinRect* out, BoundsPrecision precision) {
     BoundsComposer bc;
     for (const BidiText::RunInfo info : BidiText(str, range, bidiFlag)) {
         for (const auto [context, piece] : LayoutSplitter(str, info.range, info.isRtl)) {
@@ -145,9 +231,17 @@ void getBounds(const U16StringPiece& str, const Range& range, Bidi bidiFlag,
                     (piece.getStart() == range.getStart()) ? startHyphen : StartHyphenEdit::NO_EDIT;
             const EndHyphenEdit pieceEndHyphen =
                     (piece.getEnd() == range.getEnd()) ? endHyphen : EndHyphenEdit::NO_EDIT;
-            BoundsCache::getInstance().getOrCreate(str.substr(context), piece - context.getStart(),
-                                                   paint, info.isRtl, pieceStartHyphen,
-                                                   pieceEndHyphen, bc);
+            if (precision == BoundsPrecision::FONT_EXTENT) {
+                LayoutCache::getInstance().getOrCreate(str.substr(context),
+                                                       piece - context.getStart(), paint,
+                                                       info.isRtl, pieceStartHyphen, pieceEndHyphen,
+                                                       bc);
+            } else {
+                BoundsCache::getInstance().getOrCreate(str.substr(context),
+                                                       piece - context.getStart(), paint,
+                                                       info.isRtl, pieceStartHyphen,
+                                                       pieceEndHyphen, bc);
+            }
             // Increment word spacing for spacer
             if (piece.getLength() == 1 && isWordSpace(str[piece.getStart()])) {
                 bc.mAdvance += paint.wordSpacing;
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/MemoryReport.h"
+
+#include <cstdio>
+#include <unordered_set>
+
+#include "minikin/BoundsCache.h"
+#include "minikin/Font.h"
+#include "minikin/FontCollection.h"
+#include "minikin/FontFamily.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/PaintIdCache.h"
+#include "minikin/SparseBitSet.h"
+#include "minikin/SystemFonts.h"
+
+#include "HyphenationCache.h"
+#include "HyphenatorMap.h"
+#include "LocaleListCache.h"
+#include "WordBreakCache.h"
+
+namespace minikin {
+
+// static
+MemoryReport MemoryReport::collect() {
+    MemoryReport report;
+    report.layoutCache = LayoutCache::getInstance().getMemoryUsage();
+    report.boundsCache = BoundsCache::getInstance().getMemoryUsage();
+    report.localeListCache = LocaleListCache::getMemoryUsage();
+    report.paintIdCache = PaintIdCache::getMemoryUsage();
+    report.hyphenationCache = HyphenationCache::getInstance().getMemoryUsage();
+    report.wordBreakCache = WordBreakCache::getInstance().getMemoryUsage();
+
+    SystemFonts::getFontMap([&report](const std::vector<std::shared_ptr<FontCollection>>& map) {
+        // The families are usually shared between the collections, and the coverage between the
+        // variation instances of a family.
+        std::unordered_set<const FontFamily*> families;
+        std::unordered_set<const SparseBitSet*> coverages;
+        for (const std::shared_ptr<FontCollection>& collection : map) {
+            report.fontCollections += collection->getMemoryUsage();
+            for (const std::shared_ptr<FontFamily>& family : collection->getFamilies()) {
+                if (!families.insert(family.get()).second) {
+                    continue;
+                }
+                report.fontFamilies += family->getMemoryUsage();
+                if (coverages.insert(&family->getCoverage()).second) {
+                    report.fontFamilies += family->getCoverageMemoryUsage();
+                }
+            }
+        }
+    });
+
+    Font::getSharedFaceUsage(&report.harfBuzzFaceCount, &report.harfBuzzFontData);
+    HyphenatorMap::getMemoryUsage(&report.hyphenators, &report.hyphenationPatterns);
+    return report;
+}
+
+size_t MemoryReport::getTotal() const {
+    return layoutCache + boundsCache + localeListCache + paintIdCache + hyphenationCache +
+           wordBreakCache + fontCollections + fontFamilies + hyphenators;
+}
+
+std::string MemoryReport::toString() const {
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "Minikin memory: total=%zu layoutCache=%zu boundsCache=%zu localeListCache=%zu"
+             " paintIdCache=%zu hyphenationCache=%zu wordBreakCache=%zu fontCollections=%zu"
+             " fontFamilies=%zu hyphenators=%zu\n"
+             "  Not owned: harfBuzzFaces=%zu harfBuzzFontData=%zu hyphenationPatterns=%zu\n",
+             getTotal(), layoutCache, boundsCache, localeListCache, paintIdCache,
+             hyphenationCache, wordBreakCache, fontCollections, fontFamilies, hyphenators,
+             harfBuzzFaceCount, harfBuzzFontData, hyphenationPatterns);
+    return buf;
+}
+
+}  // namespace minikin
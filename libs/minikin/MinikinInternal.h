@@ -55,6 +55,10 @@ uint16_t getVsIndex(uint32_t codePoint);
 // Note that this function returns false for Mongolian free variation selectors.
 bool isVariationSelector(uint32_t codePoint);
 
+// Makes each thread drop the HarfBuzz sub-fonts it reuses across layouts, and the typefaces they
+// keep alive, before its next layout.
+void invalidateSubFontCaches();
+
 // An RAII accessor for hb_blob_t
 class HbBlob {
 public:
@@ -17,14 +17,26 @@
 #include "OptimalLineBreaker.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "minikin/Characters.h"
 #include "minikin/Layout.h"
 #include "minikin/Range.h"
 #include "minikin/U16StringPiece.h"
 
+#include "GreedyLineBreaker.h"
 #include "HyphenatorMap.h"
+#include "LatencyStats.h"
 #include "LayoutUtils.h"
 #include "LineBreakerUtil.h"
 #include "Locale.h"
@@ -81,6 +93,13 @@ struct Candidate {
               postSpaceCount(postSpaceCount),
               hyphenType(hyphenType),
               isRtl(isRtl) {}
+
+    bool operator==(const Candidate& other) const {
+        return offset == other.offset && preBreak == other.preBreak &&
+               postBreak == other.postBreak && penalty == other.penalty &&
+               preSpaceCount == other.preSpaceCount && postSpaceCount == other.postSpaceCount &&
+               hyphenType == other.hyphenType && isRtl == other.isRtl;
+    }
 };
 
 // A context of line break optimization.
@@ -120,11 +139,41 @@ struct OptimizeContext {
                                 HyphenationType::DONT_BREAK, isRtl);
     }
 
-    OptimizeContext() {
+    OptimizeContext() { reset(); }
+
+    // Makes this a context without any break candidates but the first one, keeping the capacity.
+    void reset() {
+        candidates.clear();
         candidates.emplace_back(0, 0.0f, 0.0f, 0.0f, 0, 0, HyphenationType::DONT_BREAK, false);
+        linePenalty = 0.0f;
+        spaceWidth = 0.0f;
     }
 };
 
+// Where a candidate of populateCandidates comes from, kept to derive the candidates for another
+// line width from them.
+struct CandidateSource {
+    enum class Kind : uint8_t { Start, WordBreak, Hyphenation, Desperate };
+
+    Kind kind;
+
+    // The index of the run whose hyphen penalty the penalty of the candidate is computed from.
+    uint32_t runIndex;
+
+    // The word break penalty the hyphen penalty is multiplied with, for word breaks.
+    int wordBreakPenalty;
+
+    // The width of the word containing the candidate, for desperate breaks. They are only
+    // candidates if the word is wider than the narrowest line.
+    ParaWidth wordWidth;
+
+    CandidateSource(Kind kind, uint32_t runIndex, int wordBreakPenalty, ParaWidth wordWidth)
+            : kind(kind),
+              runIndex(runIndex),
+              wordBreakPenalty(wordBreakPenalty),
+              wordWidth(wordWidth) {}
+};
+
 // Compute the penalty for the run and returns penalty for hyphenation and number of lines.
 std::pair<float, float> computePenalties(const Run& run, const LineWidth& lineWidth,
                                          HyphenationFrequency frequency, bool justified) {
@@ -148,33 +197,46 @@ std::pair<float, float> computePenalties(const Run& run, const LineWidth& lineWi
     return std::make_pair(hyphenPenalty, linePenalty);
 }
 
-// Represents a desperate break point.
-struct DesperateBreak {
+// Iterates over the desperate break points of a word, the grapheme bounds inside it. They are
+// computed while the candidates are appended instead of being stored first, since a long word,
+// e.g. a URL, has one per character.
+class DesperateBreakIterator {
+public:
+    // Iterates over the desperate break points of the range, or over none if enabled is false.
+    DesperateBreakIterator(const MeasuredText& measured, const Range& range, bool enabled)
+            : mMeasured(measured),
+              mOffset(range.getStart()),
+              mEnd(enabled ? range.getEnd() : range.getStart()),
+              mSumOfChars(enabled ? measured.widthAt(range.getStart()) : 0) {
+        advance();
+    }
+
+    bool atEnd() const { return mOffset >= mEnd; }
+
     // The break offset.
-    uint32_t offset;
+    uint32_t offset() const { return mOffset; }
 
     // The sum of the character width from the beginning of the word.
-    ParaWidth sumOfChars;
+    ParaWidth sumOfChars() const { return mSumOfChars; }
 
-    DesperateBreak(uint32_t offset, ParaWidth sumOfChars)
-            : offset(offset), sumOfChars(sumOfChars){};
-};
+    void next() {
+        mSumOfChars += mMeasured.widthAt(mOffset);
+        advance();
+    }
 
-// Retrieves desperate break points from a word.
-std::vector<DesperateBreak> populateDesperatePoints(const MeasuredText& measured,
-                                                    const Range& range) {
-    std::vector<DesperateBreak> out;
-    ParaWidth width = measured.widths[range.getStart()];
-    for (uint32_t i = range.getStart() + 1; i < range.getEnd(); ++i) {
-        const float w = measured.widths[i];
-        if (w == 0) {
-            continue;  // w == 0 means here is not a grapheme bounds. Don't break here.
-        }
-        out.emplace_back(i, width);
-        width += w;
+private:
+    void advance() {
+        // w == 0 means here is not a grapheme bounds. Don't break here.
+        do {
+            mOffset++;
+        } while (mOffset < mEnd && mMeasured.widthAt(mOffset) == 0);
     }
-    return out;
-}
+
+    const MeasuredText& mMeasured;
+    uint32_t mOffset;
+    const uint32_t mEnd;
+    ParaWidth mSumOfChars;
+};
 
 // Append hyphenation break points and desperate break points.
 // If an offset is a both candidate for hyphenation and desperate break points, place desperate
@@ -182,40 +244,56 @@ std::vector<DesperateBreak> populateDesperatePoints(const MeasuredText& measured
 // break is shorter than hyphenation break.
 // This is important since DP in computeBreaksOptimal assumes that the result line width is
 // increased by break offset.
+// If sources is not null, the sources of the appended candidates are appended to it.
 void appendWithMerging(std::vector<HyphenBreak>::const_iterator hyIter,
                        std::vector<HyphenBreak>::const_iterator endHyIter,
-                       const std::vector<DesperateBreak>& desperates, const CharProcessor& proc,
-                       float hyphenPenalty, bool isRtl, OptimizeContext* out) {
-    auto d = desperates.begin();
-    while (hyIter != endHyIter || d != desperates.end()) {
+                       DesperateBreakIterator d, const CharProcessor& proc, float hyphenPenalty,
+                       bool isRtl, OptimizeContext* out, uint32_t runIndex,
+                       std::vector<CandidateSource>* sources) {
+    while (hyIter != endHyIter || !d.atEnd()) {
         // If both hyphen breaks and desperate breaks point to the same offset, push desperate
         // breaks first.
-        if (d != desperates.end() && (hyIter == endHyIter || d->offset <= hyIter->offset)) {
-            out->pushDesperate(d->offset, proc.sumOfCharWidthsAtPrevWordBreak + d->sumOfChars,
+        if (!d.atEnd() && (hyIter == endHyIter || d.offset() <= hyIter->offset)) {
+            out->pushDesperate(d.offset(), proc.sumOfCharWidthsAtPrevWordBreak + d.sumOfChars(),
                                proc.effectiveSpaceCount, isRtl);
-            d++;
+            if (sources != nullptr) {
+                sources->emplace_back(CandidateSource::Kind::Desperate, runIndex, 0,
+                                      proc.widthFromLastWordBreak());
+            }
+            d.next();
         } else {
             out->pushHyphenation(hyIter->offset, proc.sumOfCharWidths - hyIter->second,
                                  proc.sumOfCharWidthsAtPrevWordBreak + hyIter->first, hyphenPenalty,
                                  proc.effectiveSpaceCount, hyIter->type, isRtl);
+            if (sources != nullptr) {
+                sources->emplace_back(CandidateSource::Kind::Hyphenation, runIndex, 0, 0);
+            }
             hyIter++;
         }
     }
 }
 
 // Enumerate all line break candidates.
-OptimizeContext populateCandidates(const U16StringPiece& textBuf, const MeasuredText& measured,
-                                   const LineWidth& lineWidth, HyphenationFrequency frequency,
-                                   bool isJustified) {
+// If sources is not null, the source of each candidate is stored in it, see deriveCandidates.
+// The candidates are stored in result, and wordBreaker is the memory used while enumerating them.
+// wordBreaker may be null.
+void populateCandidates(const U16StringPiece& textBuf, const MeasuredText& measured,
+                        const LineWidth& lineWidth, HyphenationFrequency frequency,
+                        bool isJustified, OptimizeContext* result, WordBreaker* wordBreaker,
+                        std::vector<CandidateSource>* sources) {
     const ParaWidth minLineWidth = lineWidth.getMin();
-    CharProcessor proc(textBuf);
+    CharProcessor proc(textBuf, measured, wordBreaker);
 
-    OptimizeContext result;
+    result->reset();
+    if (sources != nullptr) {
+        sources->emplace_back(CandidateSource::Kind::Start, 0, 0, 0);
+    }
 
     const bool doHyphenation = frequency != HyphenationFrequency::None;
     auto hyIter = std::begin(measured.hyphenBreaks);
 
-    for (const auto& run : measured.runs) {
+    for (uint32_t runIndex = 0; runIndex < measured.runs.size(); ++runIndex) {
+        const auto& run = measured.runs[runIndex];
         const bool isRtl = run->isRtl();
         const Range& range = run->getRange();
 
@@ -224,7 +302,7 @@ OptimizeContext populateCandidates(const U16StringPiece& textBuf, const Measured
         if (run->canBreak()) {
             auto penalties = computePenalties(*run, lineWidth, frequency, isJustified);
             hyphenPenalty = penalties.first;
-            result.linePenalty = std::max(penalties.second, result.linePenalty);
+            result->linePenalty = std::max(penalties.second, result->linePenalty);
         }
 
         proc.updateLocaleIfNecessary(*run);
@@ -234,7 +312,7 @@ OptimizeContext populateCandidates(const U16StringPiece& textBuf, const Measured
             // Even if the run is not a candidate of line break, treat the end of run as the line
             // break candidate.
             const bool canBreak = run->canBreak() || (i + 1) == range.getEnd();
-            proc.feedChar(i, textBuf[i], measured.widths[i], canBreak);
+            proc.feedChar(i, textBuf[i], measured.widthAt(i), canBreak);
 
             const uint32_t nextCharOffset = i + 1;
             if (nextCharOffset != proc.nextWordBreak) {
@@ -242,102 +320,315 @@ OptimizeContext populateCandidates(const U16StringPiece& textBuf, const Measured
             }
 
             // Add hyphenation and desperate break points.
-            std::vector<HyphenBreak> hyphenedBreaks;
-            std::vector<DesperateBreak> desperateBreaks;
             const Range contextRange = proc.contextRange();
 
-            auto beginHyIter = hyIter;
-            while (hyIter != std::end(measured.hyphenBreaks) &&
-                   hyIter->offset < contextRange.getEnd()) {
-                hyIter++;
-            }
-            if (proc.widthFromLastWordBreak() > minLineWidth) {
-                desperateBreaks = populateDesperatePoints(measured, contextRange);
+            const DesperateBreakIterator desperateBreaks(
+                    measured, contextRange, proc.widthFromLastWordBreak() > minLineWidth);
+            if (measured.isHyphenationLazy()) {
+                if (doHyphenation && run->canBreak() && proc.hyphenator != nullptr) {
+                    const std::vector<HyphenBreak>& lazyBreaks = measured.getHyphenBreaks(
+                            textBuf, *run, *proc.hyphenator, contextRange, proc.wordRange());
+                    appendWithMerging(lazyBreaks.begin(), lazyBreaks.end(), desperateBreaks, proc,
+                                      hyphenPenalty, isRtl, result, runIndex, sources);
+                } else {
+                    appendWithMerging(hyIter, hyIter, desperateBreaks, proc, hyphenPenalty, isRtl,
+                                      result, runIndex, sources);
+                }
+            } else {
+                auto beginHyIter = hyIter;
+                while (hyIter != std::end(measured.hyphenBreaks) &&
+                       hyIter->offset < contextRange.getEnd()) {
+                    hyIter++;
+                }
+                appendWithMerging(beginHyIter, doHyphenation ? hyIter : beginHyIter,
+                                  desperateBreaks, proc, hyphenPenalty, isRtl, result, runIndex,
+                                  sources);
             }
-            appendWithMerging(beginHyIter, doHyphenation ? hyIter : beginHyIter, desperateBreaks,
-                              proc, hyphenPenalty, isRtl, &result);
 
             // We skip breaks for zero-width characters inside replacement spans.
             if (run->getPaint() != nullptr || nextCharOffset == range.getEnd() ||
-                measured.widths[nextCharOffset] > 0) {
+                measured.widthAt(nextCharOffset) > 0) {
                 const float penalty = hyphenPenalty * proc.wordBreakPenalty();
-                result.pushWordBreak(nextCharOffset, proc.sumOfCharWidths, proc.effectiveWidth,
+                result->pushWordBreak(nextCharOffset, proc.sumOfCharWidths, proc.effectiveWidth,
                                      penalty, proc.rawSpaceCount, proc.effectiveSpaceCount, isRtl);
+                if (sources != nullptr) {
+                    sources->emplace_back(CandidateSource::Kind::WordBreak, runIndex,
+                                          proc.wordBreakPenalty(), 0);
+                }
             }
         }
     }
-    result.spaceWidth = proc.spaceWidth;
+    result->spaceWidth = proc.spaceWidth;
+}
+
+OptimizeContext populateCandidates(const U16StringPiece& textBuf, const MeasuredText& measured,
+                                   const LineWidth& lineWidth, HyphenationFrequency frequency,
+                                   bool isJustified,
+                                   std::vector<CandidateSource>* sources = nullptr) {
+    OptimizeContext result;
+    populateCandidates(textBuf, measured, lineWidth, frequency, isJustified, &result, nullptr,
+                       sources);
+    return result;
+}
+
+// Returns the candidates populateCandidates returns for lineWidth, from the candidates it returned
+// with sources for a line width whose minimum is not larger. Only the penalties and the desperate
+// breaks depend on the line width, so they are the only ones computed again.
+OptimizeContext deriveCandidates(const OptimizeContext& context,
+                                 const std::vector<CandidateSource>& sources,
+                                 const MeasuredText& measured, const LineWidth& lineWidth,
+                                 HyphenationFrequency frequency, bool isJustified) {
+    OptimizeContext result;
+    result.spaceWidth = context.spaceWidth;
+
+    std::vector<float> hyphenPenalties(measured.runs.size(), 0.0f);
+    for (uint32_t runIndex = 0; runIndex < measured.runs.size(); ++runIndex) {
+        const Run& run = *measured.runs[runIndex];
+        if (run.canBreak()) {
+            auto penalties = computePenalties(run, lineWidth, frequency, isJustified);
+            hyphenPenalties[runIndex] = penalties.first;
+            result.linePenalty = std::max(penalties.second, result.linePenalty);
+        }
+    }
+
+    const ParaWidth minLineWidth = lineWidth.getMin();
+    result.candidates.reserve(context.candidates.size());
+    // The first candidate is added by the constructor of OptimizeContext.
+    for (uint32_t i = 1; i < context.candidates.size(); ++i) {
+        const CandidateSource& source = sources[i];
+        Candidate candidate = context.candidates[i];
+        switch (source.kind) {
+            case CandidateSource::Kind::WordBreak:
+                candidate.penalty = hyphenPenalties[source.runIndex] * source.wordBreakPenalty;
+                break;
+            case CandidateSource::Kind::Hyphenation:
+                candidate.penalty = hyphenPenalties[source.runIndex];
+                break;
+            case CandidateSource::Kind::Desperate:
+                if (!(source.wordWidth > minLineWidth)) {
+                    continue;
+                }
+                break;
+            case CandidateSource::Kind::Start:
+                break;
+        }
+        result.candidates.push_back(candidate);
+    }
     return result;
 }
 
+// The number of candidates computeBreaks() scores at once.
+constexpr uint32_t SCORE_BATCH_SIZE = 4;
+static_assert(std::is_same<ParaWidth, float>::value, "The batch scoring loads widths as floats.");
+
+// Computes the slack and the width score of SCORE_BATCH_SIZE consecutive candidates on a
+// ragged-right line that isn't the last one, with the same float operations as the scalar code in
+// computeBreaks(): the squared slack, or SCORE_OVERFULL if the line doesn't fit.
+inline void computeRaggedWidthScores(const ParaWidth* preBreaks, ParaWidth leftEdge, float* deltas,
+                                     float* widthScores) {
+#if defined(__ARM_NEON)
+    const float32x4_t delta = vsubq_f32(vld1q_f32(preBreaks), vdupq_n_f32(leftEdge));
+    const uint32x4_t overfull = vcltq_f32(delta, vdupq_n_f32(0.0f));
+    vst1q_f32(deltas, delta);
+    vst1q_f32(widthScores,
+              vbslq_f32(overfull, vdupq_n_f32(SCORE_OVERFULL), vmulq_f32(delta, delta)));
+#elif defined(__SSE2__)
+    const __m128 delta = _mm_sub_ps(_mm_loadu_ps(preBreaks), _mm_set1_ps(leftEdge));
+    const __m128 overfull = _mm_cmplt_ps(delta, _mm_setzero_ps());
+    _mm_storeu_ps(deltas, delta);
+    _mm_storeu_ps(widthScores, _mm_or_ps(_mm_and_ps(overfull, _mm_set1_ps(SCORE_OVERFULL)),
+                                         _mm_andnot_ps(overfull, _mm_mul_ps(delta, delta))));
+#else
+    for (uint32_t k = 0; k < SCORE_BATCH_SIZE; k++) {
+        deltas[k] = preBreaks[k] - leftEdge;
+        widthScores[k] = deltas[k] < 0 ? SCORE_OVERFULL : deltas[k] * deltas[k];
+    }
+#endif
+}
+
+// A min segment tree over the scores of the candidates computed so far. computeBreaks() uses it to
+// jump over the runs of candidates that the "bestHope" pruning would skip one by one, which keeps
+// the optimization close to linear when a line can hold many candidates.
+class CandidateScoreTree {
+public:
+    // The nodes are stored in nodes, which must outlive the tree.
+    CandidateScoreTree(uint32_t size, std::vector<float>* nodes) : mLeafCount(1), mNodes(*nodes) {
+        while (mLeafCount < size) {
+            mLeafCount <<= 1;
+        }
+        mNodes.assign(mLeafCount * 2, std::numeric_limits<float>::infinity());
+    }
+
+    void set(uint32_t index, float value) {
+        uint32_t node = index + mLeafCount;
+        mNodes[node] = value;
+        for (node >>= 1; node > 0; node >>= 1) {
+            mNodes[node] = std::min(mNodes[node * 2], mNodes[node * 2 + 1]);
+        }
+    }
+
+    // Returns the first index in [from, to) whose value is below the threshold, or to if none is.
+    // Indices that were never set hold infinity.
+    uint32_t findFirstBelow(uint32_t from, uint32_t to, double threshold) const {
+        if (from >= to) {
+            return to;
+        }
+        uint32_t node = from + mLeafCount;
+        // Climb until a subtree starting at or after "from" contains a value below the threshold.
+        while (mNodes[node] >= threshold) {
+            while (node & 1) {
+                node >>= 1;
+            }
+            if (node == 0) {
+                return to;  // Passed the rightmost subtree.
+            }
+            node++;
+        }
+        // Descend to its leftmost leaf below the threshold.
+        while (node < mLeafCount) {
+            node *= 2;
+            if (mNodes[node] >= threshold) {
+                node++;
+            }
+        }
+        return std::min(node - mLeafCount, to);
+    }
+
+private:
+    uint32_t mLeafCount;
+    std::vector<float>& mNodes;
+};
+
+// Data used to compute optimal line breaks. Laid out as a struct of arrays so that the scoring
+// loop reads consecutive candidates from contiguous memory.
+struct OptimalBreaksData {
+    std::vector<float> scores;          // best score found for each break
+    std::vector<uint32_t> prevs;        // index to previous break
+    std::vector<uint32_t> lineNumbers;  // the computed line number of the candidate
+    std::vector<uint32_t> actives;      // the first possible line start after the candidate
+
+    size_t size() const { return scores.size(); }
+
+    void reserve(size_t size) {
+        scores.reserve(size);
+        prevs.reserve(size);
+        lineNumbers.reserve(size);
+        actives.reserve(size);
+    }
+
+    void push_back(float score, uint32_t prev, uint32_t lineNumber, uint32_t active) {
+        scores.push_back(score);
+        prevs.push_back(prev);
+        lineNumbers.push_back(lineNumber);
+        actives.push_back(active);
+    }
+
+    // Keeps the data of the first size candidates.
+    void truncate(size_t size) {
+        scores.resize(size);
+        prevs.resize(size);
+        lineNumbers.resize(size);
+        actives.resize(size);
+    }
+};
+
 class LineBreakOptimizer {
 public:
     LineBreakOptimizer() {}
 
-    LineBreakResult computeBreaks(const OptimizeContext& context, const U16StringPiece& textBuf,
-                                  const MeasuredText& measuredText, const LineWidth& lineWidth,
-                                  BreakStrategy strategy, bool justified);
+    // Computes the data of the candidates breaksData doesn't have yet and writes the resulting
+    // line breaks to out. breaksData must hold at least the data of the first candidate. The
+    // extents of the lines are only computed if computeExtents is true.
+    void computeBreaks(const OptimizeContext& context, const U16StringPiece& textBuf,
+                       const MeasuredText& measuredText, const LineWidth& lineWidth,
+                       BreakStrategy strategy, bool justified, OptimalBreaksData* breaksData,
+                       bool computeExtents, LineBreakResult* out);
 
 private:
-    // Data used to compute optimal line breaks
-    struct OptimalBreaksData {
-        float score;          // best score found for this break
-        uint32_t prev;        // index to previous break
-        uint32_t lineNumber;  // the computed line number of the candidate
-    };
-    LineBreakResult finishBreaksOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
-                                        const std::vector<OptimalBreaksData>& breaksData,
-                                        const std::vector<Candidate>& candidates);
+    void finishBreaksOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
+                             const OptimalBreaksData& breaksData,
+                             const std::vector<Candidate>& candidates, bool computeExtents,
+                             LineBreakResult* out);
+
+    // The memory computeBreaks reuses across calls.
+    std::vector<ParaWidth> mPreBreaks;
+    std::vector<float> mScoreTreeNodes;
 };
 
 // Follow "prev" links in candidates array, and copy to result arrays.
-LineBreakResult LineBreakOptimizer::finishBreaksOptimal(
-        const U16StringPiece& textBuf, const MeasuredText& measured,
-        const std::vector<OptimalBreaksData>& breaksData,
-        const std::vector<Candidate>& candidates) {
-    LineBreakResult result;
+void LineBreakOptimizer::finishBreaksOptimal(const U16StringPiece& textBuf,
+                                             const MeasuredText& measured,
+                                             const OptimalBreaksData& breaksData,
+                                             const std::vector<Candidate>& candidates,
+                                             bool computeExtents, LineBreakResult* out) {
+    LineBreakResult& result = *out;
+    result.clear();
     const uint32_t nCand = candidates.size();
     uint32_t prevIndex;
     for (uint32_t i = nCand - 1; i > 0; i = prevIndex) {
-        prevIndex = breaksData[i].prev;
+        prevIndex = breaksData.prevs[i];
         const Candidate& cand = candidates[i];
         const Candidate& prev = candidates[prevIndex];
 
         result.breakPoints.push_back(cand.offset);
         result.widths.push_back(cand.postBreak - prev.preBreak);
-        MinikinExtent extent = measured.getExtent(textBuf, Range(prev.offset, cand.offset));
-        result.ascents.push_back(extent.ascent);
-        result.descents.push_back(extent.descent);
+        if (computeExtents) {
+            MinikinExtent extent = measured.getExtent(textBuf, Range(prev.offset, cand.offset));
+            result.ascents.push_back(extent.ascent);
+            result.descents.push_back(extent.descent);
+        }
 
         const HyphenEdit edit =
                 packHyphenEdit(editForNextLine(prev.hyphenType), editForThisLine(cand.hyphenType));
         result.flags.push_back(static_cast<int>(edit));
     }
     result.reverse();
-    return result;
 }
 
-LineBreakResult LineBreakOptimizer::computeBreaks(const OptimizeContext& context,
-                                                  const U16StringPiece& textBuf,
-                                                  const MeasuredText& measured,
-                                                  const LineWidth& lineWidth,
-                                                  BreakStrategy strategy, bool justified) {
+void LineBreakOptimizer::computeBreaks(const OptimizeContext& context,
+                                       const U16StringPiece& textBuf, const MeasuredText& measured,
+                                       const LineWidth& lineWidth, BreakStrategy strategy,
+                                       bool justified, OptimalBreaksData* breaksData,
+                                       bool computeExtents, LineBreakResult* out) {
     const std::vector<Candidate>& candidates = context.candidates;
-    uint32_t active = 0;
     const uint32_t nCand = candidates.size();
+    const uint32_t nComputed = breaksData->size();
+    uint32_t active = breaksData->actives[nComputed - 1];
     const float maxShrink = justified ? SHRINKABILITY * context.spaceWidth : 0.0f;
 
-    std::vector<OptimalBreaksData> breaksData;
-    breaksData.reserve(nCand);
-    breaksData.push_back({0.0, 0, 0});  // The first candidate is always at the first line.
+    std::vector<ParaWidth>& preBreaks = mPreBreaks;
+    preBreaks.clear();
+    preBreaks.reserve(nCand);
+    for (const Candidate& candidate : candidates) {
+        preBreaks.push_back(candidate.preBreak);
+    }
+
+    breaksData->reserve(nCand);
+    const std::vector<float>& scores = breaksData->scores;
+    const std::vector<uint32_t>& lineNumbers = breaksData->lineNumbers;
+
+    // Holds the score of each computed candidate, or -infinity if the candidate is on a line of a
+    // different width than the candidate before it. Such candidates must not be jumped over since
+    // the loop below resets its pruning state there.
+    CandidateScoreTree scoreTree(nCand, &mScoreTreeNodes);
+    const auto setTreeScore = [&](uint32_t i) {
+        const bool widthChanges =
+                i > 0 && lineNumbers[i] != lineNumbers[i - 1] &&
+                lineWidth.getAt(lineNumbers[i]) != lineWidth.getAt(lineNumbers[i - 1]);
+        scoreTree.set(i, widthChanges ? -std::numeric_limits<float>::infinity() : scores[i]);
+    };
+    for (uint32_t i = 0; i < nComputed; i++) {
+        setTreeScore(i);
+    }
 
     // "i" iterates through candidates for the end of the line.
-    for (uint32_t i = 1; i < nCand; i++) {
+    for (uint32_t i = nComputed; i < nCand; i++) {
         const bool atEnd = i == nCand - 1;
+        const bool ragged = !justified && !atEnd;
         float best = SCORE_INFTY;
         uint32_t bestPrev = 0;
 
-        uint32_t lineNumberLast = breaksData[active].lineNumber;
+        uint32_t lineNumberLast = lineNumbers[active];
         float width = lineWidth.getAt(lineNumberLast);
 
         ParaWidth leftEdge = candidates[i].postBreak - width;
@@ -345,7 +636,40 @@ LineBreakResult LineBreakOptimizer::computeBreaks(const OptimizeContext& context
 
         // "j" iterates through candidates for the beginning of the line.
         for (uint32_t j = active; j < i; j++) {
-            const uint32_t lineNumber = breaksData[j].lineNumber;
+            if (ragged && j + SCORE_BATCH_SIZE <= i &&
+                std::all_of(&lineNumbers[j], &lineNumbers[j] + SCORE_BATCH_SIZE,
+                            [=](uint32_t n) { return n == lineNumberLast; })) {
+                // The candidates are on the same line, so only the pruning and the best score
+                // carry over from one to the next. Score them together and apply the results in
+                // order, as the scalar code below does.
+                float deltas[SCORE_BATCH_SIZE];
+                float widthScores[SCORE_BATCH_SIZE];
+                computeRaggedWidthScores(&preBreaks[j], leftEdge, deltas, widthScores);
+                uint32_t k = 0;
+                for (; k < SCORE_BATCH_SIZE; k++) {
+                    const float jScore = scores[j + k];
+                    if (jScore + bestHope >= best) {
+                        break;
+                    }
+                    if (deltas[k] < 0) {
+                        active = j + k + 1;
+                    } else {
+                        bestHope = widthScores[k];
+                    }
+                    const float score = jScore + widthScores[k];
+                    if (score <= best) {
+                        best = score;
+                        bestPrev = j + k;
+                    }
+                }
+                if (k == SCORE_BATCH_SIZE) {
+                    j += SCORE_BATCH_SIZE - 1;
+                    continue;
+                }
+                j += k;  // The pruned candidate goes through the code below to skip ahead.
+            }
+
+            const uint32_t lineNumber = lineNumbers[j];
             if (lineNumber != lineNumberLast) {
                 const float widthNew = lineWidth.getAt(lineNumber);
                 if (widthNew != width) {
@@ -355,9 +679,21 @@ LineBreakResult LineBreakOptimizer::computeBreaks(const OptimizeContext& context
                 }
                 lineNumberLast = lineNumber;
             }
-            const float jScore = breaksData[j].score;
-            if (jScore + bestHope >= best) continue;
-            const float delta = candidates[j].preBreak - leftEdge;
+            const float jScore = scores[j];
+            if (jScore + bestHope >= best) {
+                // Every candidate with a score at or above the threshold is skipped, and the
+                // skipped candidates don't change any state but lineNumberLast.
+                const double threshold =
+                        std::nextafter(static_cast<double>(best) - bestHope,
+                                       std::numeric_limits<double>::infinity());
+                const uint32_t next = scoreTree.findFirstBelow(j + 1, i, threshold);
+                if (next > j + 1) {
+                    j = next - 1;
+                    lineNumberLast = lineNumbers[j];
+                }
+                continue;
+            }
+            const float delta = preBreaks[j] - leftEdge;
 
             // compute width score for line
 
@@ -395,25 +731,163 @@ LineBreakResult LineBreakOptimizer::computeBreaks(const OptimizeContext& context
                 bestPrev = j;
             }
         }
-        breaksData.push_back({best + candidates[i].penalty + context.linePenalty,  // score
+        breaksData->push_back(best + candidates[i].penalty + context.linePenalty,  // score
                               bestPrev,                                            // prev
-                              breaksData[bestPrev].lineNumber + 1});               // lineNumber
+                              lineNumbers[bestPrev] + 1,                           // lineNumber
+                              active);                                             // active
+        setTreeScore(i);
     }
-    return finishBreaksOptimal(textBuf, measured, breaksData, candidates);
+    finishBreaksOptimal(textBuf, measured, *breaksData, candidates, computeExtents, out);
 }
 
 }  // namespace
 
+// The intermediate results of breakLineOptimal kept in a LineBreakerState.
+struct OptimalLineBreakState {
+    BreakStrategy strategy;
+    HyphenationFrequency frequency;
+    bool justified;
+    OptimizeContext context;
+    OptimalBreaksData breaksData;
+};
+
+// The memory breakLineOptimal reuses across paragraphs with a LineBreakScratch.
+struct OptimalLineBreakScratch {
+    OptimizeContext context;
+    OptimalBreaksData breaksData;
+    LineBreakOptimizer optimizer;
+    WordBreaker wordBreaker;
+};
+
+LineBreakScratch::LineBreakScratch() {}
+
+LineBreakScratch::~LineBreakScratch() {}
+
+LineBreakerState::LineBreakerState() {}
+
+LineBreakerState::~LineBreakerState() {}
+
+void LineBreakerState::clear() {
+    mOptimalState.reset();
+}
+
 LineBreakResult breakLineOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
                                  const LineWidth& lineWidth, BreakStrategy strategy,
                                  HyphenationFrequency frequency, bool justified) {
     if (textBuf.size() == 0) {
         return LineBreakResult();
     }
+    ScopedLatency latency(LatencyStats::kBreakLineOptimal);
     const OptimizeContext context =
             populateCandidates(textBuf, measured, lineWidth, frequency, justified);
+    OptimalBreaksData breaksData;
+    breaksData.push_back(0.0, 0, 0, 0);  // The first candidate is always at the first line.
+    LineBreakOptimizer optimizer;
+    LineBreakResult result;
+    optimizer.computeBreaks(context, textBuf, measured, lineWidth, strategy, justified, &breaksData,
+                            true /* compute extents */, &result);
+    return result;
+}
+
+void breakLineOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
+                      const LineWidth& lineWidth, BreakStrategy strategy,
+                      HyphenationFrequency frequency, bool justified, bool computeExtents,
+                      LineBreakScratch* lineBreakScratch, LineBreakResult* out) {
+    if (textBuf.size() == 0) {
+        out->clear();
+        return;
+    }
+    ScopedLatency latency(LatencyStats::kBreakLineOptimal);
+    std::unique_ptr<OptimalLineBreakScratch>& scratch = lineBreakScratch->optimalScratch();
+    if (!scratch) {
+        scratch = std::make_unique<OptimalLineBreakScratch>();
+    }
+    populateCandidates(textBuf, measured, lineWidth, frequency, justified, &scratch->context,
+                       &scratch->wordBreaker, nullptr);
+    scratch->breaksData.truncate(0);
+    // The first candidate is always at the first line.
+    scratch->breaksData.push_back(0.0, 0, 0, 0);
+    scratch->optimizer.computeBreaks(scratch->context, textBuf, measured, lineWidth, strategy,
+                                     justified, &scratch->breaksData, computeExtents, out);
+}
+
+std::vector<LineBreakResult> breakLineOptimal(const U16StringPiece& textBuf,
+                                              const MeasuredText& measured,
+                                              const std::vector<float>& lineWidths,
+                                              BreakStrategy strategy,
+                                              HyphenationFrequency frequency, bool justified) {
+    std::vector<LineBreakResult> results(lineWidths.size());
+    if (textBuf.size() == 0 || lineWidths.empty()) {
+        return results;
+    }
+    ScopedLatency latency(LatencyStats::kBreakLineOptimal);
+
+    // The candidates of the narrowest width include the desperate breaks of all the others.
+    const ConstantLineWidth minLineWidth(*std::min_element(lineWidths.begin(), lineWidths.end()));
+    std::vector<CandidateSource> sources;
+    const OptimizeContext sharedContext =
+            populateCandidates(textBuf, measured, minLineWidth, frequency, justified, &sources);
+
+    LineBreakOptimizer optimizer;
+    for (size_t i = 0; i < lineWidths.size(); ++i) {
+        const ConstantLineWidth lineWidth(lineWidths[i]);
+        const OptimizeContext context =
+                deriveCandidates(sharedContext, sources, measured, lineWidth, frequency, justified);
+        OptimalBreaksData breaksData;
+        breaksData.push_back(0.0, 0, 0, 0);  // The first candidate is always at the first line.
+        optimizer.computeBreaks(context, textBuf, measured, lineWidth, strategy, justified,
+                                &breaksData, true /* compute extents */, &results[i]);
+    }
+    return results;
+}
+
+LineBreakResult breakLineOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
+                                 const LineWidth& lineWidth, BreakStrategy strategy,
+                                 HyphenationFrequency frequency, bool justified,
+                                 uint32_t editOffset, LineBreakerState* state) {
+    if (textBuf.size() == 0) {
+        state->clear();
+        return LineBreakResult();
+    }
+    ScopedLatency latency(LatencyStats::kBreakLineOptimal);
+    OptimizeContext context =
+            populateCandidates(textBuf, measured, lineWidth, frequency, justified);
+
+    std::unique_ptr<OptimalLineBreakState>& previous = state->optimalState();
+    OptimalBreaksData breaksData;
+    if (previous && previous->strategy == strategy && previous->frequency == frequency &&
+        previous->justified == justified &&
+        previous->context.linePenalty == context.linePenalty &&
+        previous->context.spaceWidth == context.spaceWidth) {
+        // The data of a candidate only depends on the candidates up to it, so it can be reused as
+        // long as they are all unchanged. The last candidate was scored as the end of the
+        // paragraph and has to be computed again.
+        const std::vector<Candidate>& oldCandidates = previous->context.candidates;
+        const size_t limit = std::min(oldCandidates.size(), context.candidates.size()) - 1;
+        size_t reusable = 1;
+        while (reusable < limit && context.candidates[reusable].offset < editOffset &&
+               context.candidates[reusable] == oldCandidates[reusable]) {
+            reusable++;
+        }
+        breaksData = std::move(previous->breaksData);
+        breaksData.truncate(reusable);
+    } else {
+        breaksData.push_back(0.0, 0, 0, 0);  // The first candidate is always at the first line.
+    }
+
     LineBreakOptimizer optimizer;
-    return optimizer.computeBreaks(context, textBuf, measured, lineWidth, strategy, justified);
+    LineBreakResult result;
+    optimizer.computeBreaks(context, textBuf, measured, lineWidth, strategy, justified, &breaksData,
+                            true /* compute extents */, &result);
+    if (!previous) {
+        previous = std::make_unique<OptimalLineBreakState>();
+    }
+    previous->strategy = strategy;
+    previous->frequency = frequency;
+    previous->justified = justified;
+    previous->context = std::move(context);
+    previous->breaksData = std::move(breaksData);
+    return result;
 }
 
 }  // namespace minikin
@@ -17,6 +17,8 @@
 #ifndef MINIKIN_OPTIMAL_LINE_BREAKER_H
 #define MINIKIN_OPTIMAL_LINE_BREAKER_H
 
+#include <vector>
+
 #include "minikin/LineBreaker.h"
 #include "minikin/MeasuredText.h"
 #include "minikin/U16StringPiece.h"
@@ -27,6 +29,28 @@ LineBreakResult breakLineOptimal(const U16StringPiece& textBuf, const MeasuredTe
                                  const LineWidth& lineWidthLimits, BreakStrategy strategy,
                                  HyphenationFrequency frequency, bool justified);
 
+// Same as above, but for each of the line widths, every line of a result having the same width.
+// The candidates are populated once for all the widths.
+std::vector<LineBreakResult> breakLineOptimal(const U16StringPiece& textBuf,
+                                              const MeasuredText& measured,
+                                              const std::vector<float>& lineWidths,
+                                              BreakStrategy strategy,
+                                              HyphenationFrequency frequency, bool justified);
+
+// Same as the first one, but reuses the results state holds for the candidates before editOffset if they
+// are unchanged, and stores the results of this call in state.
+LineBreakResult breakLineOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
+                                 const LineWidth& lineWidthLimits, BreakStrategy strategy,
+                                 HyphenationFrequency frequency, bool justified,
+                                 uint32_t editOffset, LineBreakerState* state);
+
+// Same as the first one, but uses the memory of scratch and writes the result to out. The extents
+// of the lines are only computed if computeExtents is true.
+void breakLineOptimal(const U16StringPiece& textBuf, const MeasuredText& measured,
+                      const LineWidth& lineWidthLimits, BreakStrategy strategy,
+                      HyphenationFrequency frequency, bool justified, bool computeExtents,
+                      LineBreakScratch* lineBreakScratch, LineBreakResult* out);
+
 }  // namespace minikin
 
 #endif  // MINIKIN_OPTIMAL_LINE_BREAKER_H
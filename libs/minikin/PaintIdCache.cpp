@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/PaintIdCache.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include <utils/LruCache.h>
+
+#include "minikin/Hasher.h"
+
+#include "LocaleListCache.h"
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+namespace {
+
+// Compares the bits so that the comparison agrees with the hash, and a NaN matches itself.
+inline bool sameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+struct KeyHash {
+    size_t operator()(const PaintIdCache::Key& key) const { return key.hash; }
+};
+
+}  // namespace
+
+inline android::hash_t hash_type(const PaintIdCache::Key& key) {
+    return key.hash;
+}
+
+void PaintIdCache::Key::computeHash() {
+    hash = WideHasher()
+                   .update(fontCollectionId)
+                   .update(style.identifier())
+                   .update(size)
+                   .update(scaleX)
+                   .update(skewX)
+                   .update(letterSpacing)
+                   .update(wordSpacing)
+                   .update(fontFlags)
+                   .update(localeListId)
+                   .update(static_cast<uint8_t>(familyVariant))
+                   .updateBytes(fontFeatureSettings.data(), fontFeatureSettings.size())
+                   .hash();
+}
+
+bool PaintIdCache::Key::operator==(const Key& o) const {
+    return hash == o.hash && fontCollectionId == o.fontCollectionId && style == o.style &&
+           sameBits(size, o.size) && sameBits(scaleX, o.scaleX) && sameBits(skewX, o.skewX) &&
+           sameBits(letterSpacing, o.letterSpacing) && sameBits(wordSpacing, o.wordSpacing) &&
+           fontFlags == o.fontFlags && localeListId == o.localeListId &&
+           familyVariant == o.familyVariant && fontFeatureSettings == o.fontFeatureSettings;
+}
+
+// The paints of the keys with the same hash bits. The IDs of the evicted paints are removed from
+// the ID to key map with them.
+class PaintIdCache::Shard : private android::OnEntryRemoved<Key, uint32_t> {
+public:
+    Shard() : mIds(kMaxEntriesPerShard) { mIds.setOnEntryRemovedListener(this); }
+
+    // Returns the ID of the key, or 0 if it is not registered.
+    uint32_t find(const Key& key) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        const uint32_t id = mIds.get(key);
+        if (id != 0) {
+            return id;
+        }
+        auto it = mPinnedIds.find(key);
+        return it != mPinnedIds.end() ? it->second : 0;
+    }
+
+    void put(const Key& key, uint32_t id, bool pin, CacheStats* stats)
+            EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        if (pin) {
+            mPinnedIds.emplace(key, id);
+        } else {
+            if (mIds.size() >= kMaxEntriesPerShard) {
+                stats->evict();
+            }
+            mIds.put(key, id);
+        }
+        mKeys.emplace(id, key);
+    }
+
+    bool getKey(uint32_t id, Key* out) EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        auto it = mKeys.find(id);
+        if (it == mKeys.end()) {
+            return false;
+        }
+        *out = it->second;
+        return true;
+    }
+
+    size_t size() EXCLUSIVE_LOCKS_REQUIRED(mMutex) { return mKeys.size(); }
+
+    size_t getMemoryUsage() EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        size_t usage = 0;
+        for (const auto& [id, key] : mKeys) {
+            // The key is stored twice, in mKeys and in mIds or mPinnedIds, sharing the string.
+            usage += 2 * sizeof(std::pair<uint32_t, Key>) + key.fontFeatureSettings.size();
+        }
+        return usage;
+    }
+
+    std::mutex mMutex;
+
+private:
+    void operator()(Key& /* key */, uint32_t& id) override { mKeys.erase(id); }
+
+    android::LruCache<Key, uint32_t> mIds GUARDED_BY(mMutex);
+    std::unordered_map<Key, uint32_t, KeyHash> mPinnedIds GUARDED_BY(mMutex);
+    std::unordered_map<uint32_t, Key> mKeys GUARDED_BY(mMutex);
+};
+
+// ID 0 is the missing value of the LruCache, so the IDs start at 1.
+PaintIdCache::PaintIdCache() : mNextId(1) {
+    for (std::unique_ptr<Shard>& shard : mShards) {
+        shard = std::make_unique<Shard>();
+    }
+}
+
+PaintIdCache::~PaintIdCache() {}
+
+uint32_t PaintIdCache::getIdInternal(const MinikinPaint& paint) {
+    return getIdInternal(paint, paint.font->getId());
+}
+
+uint32_t PaintIdCache::getIdInternal(const MinikinPaint& paint, uint32_t fontCollectionId) {
+    // The feature settings are only copied if the paint is registered.
+    Key key;
+    key.fontCollectionId = fontCollectionId;
+    key.style = paint.fontStyle;
+    key.size = paint.size;
+    key.scaleX = paint.scaleX;
+    key.skewX = paint.skewX;
+    key.letterSpacing = paint.letterSpacing;
+    key.wordSpacing = paint.wordSpacing;
+    key.fontFlags = paint.fontFlags;
+    key.localeListId = paint.localeListId;
+    key.familyVariant = paint.familyVariant;
+    key.fontFeatureSettings = paint.fontFeatureSettings;
+    return getIdInternal(key, false /* pin */);
+}
+
+uint32_t PaintIdCache::getIdInternal(Key& key, bool pin) {
+    key.computeHash();
+    Shard& shard = *mShards[key.hash % kShardCount];
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    const uint32_t id = shard.find(key);
+    if (id != 0) {
+        mStats.hit();
+        return id;
+    }
+    mStats.miss();
+    // 2^32 registrations would take years of animating a paint at the frame rate before an ID
+    // wraps around.
+    const uint32_t newId = mNextId.fetch_add(1, std::memory_order_relaxed);
+    key.ownedFontFeatureSettings = std::make_shared<const std::string>(key.fontFeatureSettings);
+    key.fontFeatureSettings = *key.ownedFontFeatureSettings;
+    shard.put(key, newId, pin, &mStats);
+    mStats.insert();
+    return newId;
+}
+
+bool PaintIdCache::getKeyInternal(uint32_t id, Key* out) {
+    // Only the snapshot writers look the keys up by ID, so all the shards are searched instead of
+    // spending bits of the ID on the shard.
+    for (std::unique_ptr<Shard>& shard : mShards) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        if (shard->getKey(id, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// static
+void PaintIdCache::writeTo(BufferWriter* writer, const Key& key) {
+    key.style.writeTo(writer);
+    writer->write<float>(key.size);
+    writer->write<float>(key.scaleX);
+    writer->write<float>(key.skewX);
+    writer->write<float>(key.letterSpacing);
+    writer->write<float>(key.wordSpacing);
+    writer->write<int32_t>(key.fontFlags);
+    // Locale list IDs are only valid in the process, so the locales are written instead.
+    LocaleListCache::writeTo(writer, key.localeListId);
+    writer->write<uint8_t>(static_cast<uint8_t>(key.familyVariant));
+    writer->writeString(key.fontFeatureSettings);
+}
+
+// static
+void PaintIdCache::validate(BufferValidator* validator) {
+    FontStyle::validate(validator);
+    validator->skip<float>();  // size
+    validator->skip<float>();  // scaleX
+    validator->skip<float>();  // skewX
+    validator->skip<float>();  // letterSpacing
+    validator->skip<float>();  // wordSpacing
+    validator->skip<int32_t>();  // fontFlags
+    LocaleListCache::validate(validator);
+    if (validator->read<uint8_t>() > static_cast<uint8_t>(FamilyVariant::ELEGANT)) {
+        validator->fail();
+    }
+    validator->skipString();
+}
+
+uint32_t PaintIdCache::readFromInternal(BufferReader* reader, uint32_t fontCollectionId,
+                                        bool pin) {
+    Key key;
+    key.fontCollectionId = fontCollectionId;
+    key.style = FontStyle(reader);
+    key.size = reader->read<float>();
+    key.scaleX = reader->read<float>();
+    key.skewX = reader->read<float>();
+    key.letterSpacing = reader->read<float>();
+    key.wordSpacing = reader->read<float>();
+    key.fontFlags = reader->read<int32_t>();
+    key.localeListId = LocaleListCache::readFrom(reader);
+    key.familyVariant = static_cast<FamilyVariant>(reader->read<uint8_t>());
+    key.fontFeatureSettings = reader->readString();
+    return getIdInternal(key, pin);
+}
+
+size_t PaintIdCache::getCacheSizeInternal() {
+    size_t size = 0;
+    for (std::unique_ptr<Shard>& shard : mShards) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        size += shard->size();
+    }
+    return size;
+}
+
+size_t PaintIdCache::getMemoryUsageInternal() {
+    size_t usage = sizeof(PaintIdCache);
+    for (std::unique_ptr<Shard>& shard : mShards) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        usage += sizeof(Shard) + shard->getMemoryUsage();
+    }
+    return usage;
+}
+
+}  // namespace minikin
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "minikin/Executor.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+namespace {
+
+// Shared with the tasks, which may start after parallelFor returned.
+struct ParallelForState {
+    ParallelForState(size_t count, const std::function<void(size_t)>& func)
+            : count(count), func(func), next(0), doneCount(0) {}
+
+    // Calls func for the indices left, until there are none. The func is only used while an index
+    // is left, and parallelFor doesn't return before that.
+    void work() {
+        size_t done = 0;
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+            done++;
+        }
+        if (done == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        doneCount += done;
+        if (doneCount == count) {
+            condition.notify_all();
+        }
+    }
+
+    const size_t count;
+    const std::function<void(size_t)>& func;
+    std::atomic<size_t> next;
+    size_t doneCount GUARDED_BY(mutex);
+    std::condition_variable condition;
+    std::mutex mutex;
+};
+
+}  // namespace
+
+void parallelFor(size_t count, uint32_t maxThreads, const std::function<void(size_t)>& func) {
+    Executor* executor = getExecutor();
+    if (maxThreads == 0) {
+        maxThreads = executor->getConcurrency() + 1;
+    }
+    const size_t threadCount = std::min<size_t>(maxThreads, count);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(count, func);
+    for (size_t i = 1; i < threadCount; i++) {
+        executor->execute([state]() { state->work(); }, Executor::Priority::kForeground);
+    }
+    state->work();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state]() { return state->doneCount == state->count; });
+}
+
+}  // namespace minikin
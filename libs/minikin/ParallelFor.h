@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PARALLEL_FOR_H
+#define MINIKIN_PARALLEL_FOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace minikin {
+
+// Calls func(i) for each i in [0, count) on up to maxThreads threads, including the calling one,
+// or on all the foreground threads of the executor and the calling one if maxThreads is 0. The
+// other threads are foreground tasks of the executor. Every thread takes the next index as soon
+// as it finishes one, so that a few long calls don't leave the others idle, and the calling thread
+// never waits for a task which hasn't started, e.g. while the executor is busy. Returns when all
+// the calls are done.
+void parallelFor(size_t count, uint32_t maxThreads, const std::function<void(size_t)>& func);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PARALLEL_FOR_H
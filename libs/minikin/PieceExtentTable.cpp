@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PieceExtentTable.h"
+
+#include <algorithm>
+
+#include "minikin/MeasuredText.h"
+
+namespace minikin {
+
+PieceExtentTable::PieceExtentTable(const U16StringPiece& textBuf,
+                                   const std::vector<std::unique_ptr<Run>>& runs,
+                                   const LayoutPieces& pieces) {
+    std::vector<std::pair<Range, MinikinExtent>> pieceExtents;
+    mRunPieces.reserve(runs.size());
+    for (const auto& run : runs) {
+        const uint32_t first = pieceExtents.size();
+        run->getPieceExtents(textBuf, pieces, &pieceExtents);
+        // The RTL runs give their pieces from the end.
+        std::sort(pieceExtents.begin() + first, pieceExtents.end(),
+                  [](const std::pair<Range, MinikinExtent>& a,
+                     const std::pair<Range, MinikinExtent>& b) {
+                      return a.first.getStart() < b.first.getStart();
+                  });
+        mRunPieces.emplace_back(first, pieceExtents.size());
+    }
+
+    const uint32_t size = pieceExtents.size();
+    mPieces.reserve(size);
+    mTree.resize(size * 2);
+    for (uint32_t i = 0; i < size; ++i) {
+        mPieces.push_back(pieceExtents[i].first);
+        mTree[size + i] = pieceExtents[i].second;
+    }
+    for (uint32_t i = size; i > 1; --i) {
+        const uint32_t node = i - 1;
+        mTree[node] = mTree[node * 2];
+        mTree[node].extendBy(mTree[node * 2 + 1]);
+    }
+}
+
+MinikinExtent PieceExtentTable::queryPieces(uint32_t from, uint32_t to) const {
+    MinikinExtent extent;
+    const uint32_t size = mPieces.size();
+    for (from += size, to += size; from < to; from /= 2, to /= 2) {
+        if (from & 1) {
+            extent.extendBy(mTree[from++]);
+        }
+        if (to & 1) {
+            extent.extendBy(mTree[--to]);
+        }
+    }
+    return extent;
+}
+
+MinikinExtent PieceExtentTable::getExtent(const U16StringPiece& textBuf, uint32_t runIndex,
+                                          const Run& run, const Range& range,
+                                          const LayoutPieces& pieces) const {
+    const auto [runFirst, runEnd] = mRunPieces[runIndex];
+    if (runFirst == runEnd) {
+        return run.getExtent(textBuf, range, pieces);
+    }
+    const auto begin = mPieces.begin() + runFirst;
+    const auto end = mPieces.begin() + runEnd;
+    // The pieces fully covered by the range are [first, last).
+    const uint32_t first =
+            std::lower_bound(begin, end, range.getStart(),
+                             [](const Range& piece, uint32_t o) { return piece.getStart() < o; }) -
+            mPieces.begin();
+    const uint32_t last =
+            std::upper_bound(begin, end, range.getEnd(),
+                             [](uint32_t o, const Range& piece) { return o < piece.getEnd(); }) -
+            mPieces.begin();
+
+    if (first >= last) {
+        // The range is in at most two pieces, none of which it covers.
+        return run.getExtent(textBuf, range, pieces);
+    }
+    MinikinExtent extent = queryPieces(first, last);
+    const uint32_t coveredStart = mPieces[first].getStart();
+    const uint32_t coveredEnd = mPieces[last - 1].getEnd();
+    if (range.getStart() < coveredStart) {
+        extent.extendBy(run.getExtent(textBuf, Range(range.getStart(), coveredStart), pieces));
+    }
+    if (coveredEnd < range.getEnd()) {
+        extent.extendBy(run.getExtent(textBuf, Range(coveredEnd, range.getEnd()), pieces));
+    }
+    return extent;
+}
+
+}  // namespace minikin
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PIECE_EXTENT_TABLE_H
+#define MINIKIN_PIECE_EXTENT_TABLE_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "minikin/LayoutPieces.h"
+#include "minikin/MinikinExtent.h"
+#include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+class Run;
+
+// The extents of the layout pieces of a measured text, in a min/max segment tree, so that the
+// extent of a line is given by a few queries instead of looking up every piece of the line.
+//
+// The pieces of a range are the pieces of the whole run clipped to the range, since LayoutSplitter
+// splits at the same offsets regardless of the range. So the extent of a range is the extent of
+// the pieces it fully covers, read from the tree, joined with the extent of the parts of the
+// pieces at its edges, computed by the run.
+class PieceExtentTable {
+public:
+    // Collects the piece extents of the runs from pieces, which must hold the layouts of all the
+    // pieces of the runs.
+    PieceExtentTable(const U16StringPiece& textBuf,
+                     const std::vector<std::unique_ptr<Run>>& runs, const LayoutPieces& pieces);
+
+    // Returns the same as runs[runIndex]->getExtent(textBuf, range, pieces). The range must be in
+    // the run.
+    MinikinExtent getExtent(const U16StringPiece& textBuf, uint32_t runIndex, const Run& run,
+                            const Range& range, const LayoutPieces& pieces) const;
+
+    uint32_t getMemoryUsage() const {
+        return sizeof(Range) * mPieces.size() + sizeof(MinikinExtent) * mTree.size() +
+               sizeof(std::pair<uint32_t, uint32_t>) * mRunPieces.size();
+    }
+
+private:
+    // Returns the extent of the pieces [from, to).
+    MinikinExtent queryPieces(uint32_t from, uint32_t to) const;
+
+    // The pieces of all the runs in offset order.
+    std::vector<Range> mPieces;
+
+    // The segment tree over the extents of mPieces: the leaves are at [size, 2 * size), the parent
+    // of the node i is at i / 2.
+    std::vector<MinikinExtent> mTree;
+
+    // The pieces of each run, as the range [first, second) of mPieces. Empty if the run has none,
+    // in which case the run computes its extents.
+    std::vector<std::pair<uint32_t, uint32_t>> mRunPieces;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PIECE_EXTENT_TABLE_H
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PieceLayoutTable.h"
+
+#include <algorithm>
+
+#include "minikin/Layout.h"
+#include "minikin/MeasuredText.h"
+
+#include "LayoutUtils.h"
+
+namespace minikin {
+
+PieceLayoutTable::PieceLayoutTable(const U16StringPiece& textBuf,
+                                   const std::vector<std::unique_ptr<Run>>& runs,
+                                   const LayoutPieces& pieces) {
+    std::vector<std::pair<Range, const LayoutPiece*>> pieceLayouts;
+    mRunPieces.reserve(runs.size());
+    for (const auto& run : runs) {
+        const uint32_t first = pieceLayouts.size();
+        run->getPieceLayouts(textBuf, pieces, &pieceLayouts);
+        // The RTL runs give their pieces from the end.
+        if (run->isRtl()) {
+            std::reverse(pieceLayouts.begin() + first, pieceLayouts.end());
+        }
+        mRunPieces.emplace_back(first, pieceLayouts.size());
+    }
+
+    mPieces.reserve(pieceLayouts.size());
+    mLayouts.reserve(pieceLayouts.size());
+    for (const auto& [piece, layout] : pieceLayouts) {
+        mPieces.push_back(piece);
+        mLayouts.push_back(layout);
+    }
+}
+
+void PieceLayoutTable::appendLayout(const U16StringPiece& textBuf, uint32_t runIndex,
+                                    const Run& run, const Range& range, const Range& contextRange,
+                                    const LayoutPieces& pieces, const MinikinPaint& paint,
+                                    uint32_t outOrigin, StartHyphenEdit startHyphen,
+                                    EndHyphenEdit endHyphen, Layout* outLayout) const {
+    const auto [runFirst, runEnd] = mRunPieces[runIndex];
+    // A single character range may get the word spacing, which the pieces don't have.
+    if (runFirst == runEnd || range.getLength() <= 1 || !(*run.getPaint() == paint)) {
+        run.appendLayout(textBuf, range, contextRange, pieces, paint, outOrigin, startHyphen,
+                         endHyphen, outLayout);
+        return;
+    }
+    const auto begin = mPieces.begin() + runFirst;
+    const auto end = mPieces.begin() + runEnd;
+    // The pieces fully covered by the range are [first, last).
+    uint32_t first =
+            std::lower_bound(begin, end, range.getStart(),
+                             [](const Range& piece, uint32_t o) { return piece.getStart() < o; }) -
+            mPieces.begin();
+    uint32_t last =
+            std::upper_bound(begin, end, range.getEnd(),
+                             [](uint32_t o, const Range& piece) { return o < piece.getEnd(); }) -
+            mPieces.begin();
+    // The pieces with hyphen edits are laid out by the run.
+    if (first < last && startHyphen != StartHyphenEdit::NO_EDIT &&
+        mPieces[first].getStart() == range.getStart()) {
+        first++;
+    }
+    if (first < last && endHyphen != EndHyphenEdit::NO_EDIT &&
+        mPieces[last - 1].getEnd() == range.getEnd()) {
+        last--;
+    }
+    if (first >= last) {
+        run.appendLayout(textBuf, range, contextRange, pieces, paint, outOrigin, startHyphen,
+                         endHyphen, outLayout);
+        return;
+    }
+
+    const Range head(range.getStart(), mPieces[first].getStart());
+    const Range tail(mPieces[last - 1].getEnd(), range.getEnd());
+    // The run would give these edges the word spacing.
+    for (const Range& edge : {head, tail}) {
+        if (edge.getLength() == 1 && isWordSpace(textBuf[edge.getStart()])) {
+            run.appendLayout(textBuf, range, contextRange, pieces, paint, outOrigin, startHyphen,
+                             endHyphen, outLayout);
+            return;
+        }
+    }
+
+    // The pieces are appended in the order the run lays them out, from the end for RTL.
+    const auto appendEdge = [&](const Range& edge, StartHyphenEdit startEdit,
+                                EndHyphenEdit endEdit) {
+        if (!edge.isEmpty()) {
+            run.appendLayout(textBuf, edge, contextRange, pieces, paint, outOrigin, startEdit,
+                             endEdit, outLayout);
+        }
+    };
+    if (run.isRtl()) {
+        appendEdge(tail, StartHyphenEdit::NO_EDIT, endHyphen);
+        for (uint32_t i = last; i > first; --i) {
+            outLayout->appendLayout(*mLayouts[i - 1], mPieces[i - 1].getStart() - outOrigin, 0);
+        }
+        appendEdge(head, startHyphen, EndHyphenEdit::NO_EDIT);
+    } else {
+        appendEdge(head, startHyphen, EndHyphenEdit::NO_EDIT);
+        for (uint32_t i = first; i < last; ++i) {
+            outLayout->appendLayout(*mLayouts[i], mPieces[i].getStart() - outOrigin, 0);
+        }
+        appendEdge(tail, StartHyphenEdit::NO_EDIT, endHyphen);
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PIECE_LAYOUT_TABLE_H
+#define MINIKIN_PIECE_LAYOUT_TABLE_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "minikin/Hyphenator.h"
+#include "minikin/LayoutPieces.h"
+#include "minikin/MinikinPaint.h"
+#include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+class Layout;
+class Run;
+
+// The layout pieces of a measured text in offset order, so that the layout of a line appends the
+// pieces it fully covers directly instead of splitting the line and looking up every piece.
+//
+// As for PieceExtentTable, the pieces of a range are the pieces of the whole run clipped to the
+// range, so only the parts of the pieces at the edges of the range, and the pieces with hyphen
+// edits, are laid out by the run.
+class PieceLayoutTable {
+public:
+    // Collects the piece layouts of the runs from pieces, which must not be modified while this
+    // table is used.
+    PieceLayoutTable(const U16StringPiece& textBuf,
+                     const std::vector<std::unique_ptr<Run>>& runs, const LayoutPieces& pieces);
+
+    // Does the same as runs[runIndex]->appendLayout with the same arguments. The range must be in
+    // the run.
+    void appendLayout(const U16StringPiece& textBuf, uint32_t runIndex, const Run& run,
+                      const Range& range, const Range& contextRange, const LayoutPieces& pieces,
+                      const MinikinPaint& paint, uint32_t outOrigin, StartHyphenEdit startHyphen,
+                      EndHyphenEdit endHyphen, Layout* outLayout) const;
+
+    uint32_t getMemoryUsage() const {
+        return (sizeof(Range) + sizeof(const LayoutPiece*)) * mPieces.size() +
+               sizeof(std::pair<uint32_t, uint32_t>) * mRunPieces.size();
+    }
+
+private:
+    // The pieces of all the runs in offset order, with their layouts.
+    std::vector<Range> mPieces;
+    std::vector<const LayoutPiece*> mLayouts;
+
+    // The pieces of each run, as the range [first, second) of mPieces. Empty if the run has none,
+    // in which case the run lays out its ranges.
+    std::vector<std::pair<uint32_t, uint32_t>> mRunPieces;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PIECE_LAYOUT_TABLE_H
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_SCOPED_CALL_RECORD_H
+#define MINIKIN_SCOPED_CALL_RECORD_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "minikin/CallRecorder.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Decides on construction whether the enclosing call is recorded by CallRecorder, which is the
+// case if it is recording and no other call of the thread is being recorded, and measures the
+// time of the call. The calls the recorded call makes internally are not recorded, since the
+// replay of the outer call makes them again.
+class ScopedCallRecord {
+public:
+    ScopedCallRecord() : mEnabled(CallRecorder::isRecording() && !sActive) {
+        if (mEnabled) {
+            sActive = true;
+            mStart = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedCallRecord() {
+        if (mEnabled) {
+            sActive = false;
+        }
+    }
+
+    bool isEnabled() const { return mEnabled; }
+
+    uint64_t getElapsedNanos() const {
+        const auto elapsed = std::chrono::steady_clock::now() - mStart;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(ScopedCallRecord);
+
+private:
+    // Whether a call of this thread is being recorded.
+    static thread_local bool sActive;
+
+    const bool mEnabled;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_SCOPED_CALL_RECORD_H
@@ -16,6 +16,13 @@
 
 #include "minikin/SparseBitSet.h"
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "minikin/Hasher.h"
+
 #include "MinikinInternal.h"
 
 namespace minikin {
@@ -102,9 +109,118 @@ void SparseBitSet::initFromRanges(const uint32_t* ranges, size_t nRanges) {
         }
         nonzeroPageEnd = endPage + 1;
     }
+    deduplicatePages();
+}
+
+void SparseBitSet::deduplicatePages() {
+    const uint32_t pageCount = mBitmapsCount / kElementsPerPage;
+    if (pageCount <= 1) {
+        return;
+    }
+    // The new index of each page, in the order of the bitmap. A page colliding with a different
+    // page of the same hash is kept as is, which is rare and only costs memory.
+    std::vector<uint16_t> newIndices(pageCount);
+    std::unordered_map<uint32_t, uint16_t> pagesByHash;
+    pagesByHash.reserve(pageCount);
+    uint32_t newBitmapsCount = 0;
+    for (uint32_t page = 0; page < pageCount; page++) {
+        const element* bitmap = &mOwnedBitmaps[page * kElementsPerPage];
+        Hasher hasher;
+        for (uint32_t j = 0; j < kElementsPerPage; j++) {
+            hasher.update(bitmap[j]);
+        }
+        const uint16_t newIndex = static_cast<uint16_t>(newBitmapsCount);
+        auto [it, inserted] = pagesByHash.emplace(hasher.hash(), newIndex);
+        if (!inserted && memcmp(&mOwnedBitmaps[it->second], bitmap,
+                                sizeof(element) * kElementsPerPage) == 0) {
+            newIndices[page] = it->second;
+            continue;
+        }
+        // The pages only move to lower offsets, and the earlier pages are already in place.
+        std::copy(bitmap, bitmap + kElementsPerPage, &mOwnedBitmaps[newBitmapsCount]);
+        newIndices[page] = newIndex;
+        newBitmapsCount += kElementsPerPage;
+    }
+    if (newBitmapsCount == mBitmapsCount) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < mIndicesCount; i++) {
+        mOwnedIndices[i] = newIndices[mOwnedIndices[i] / kElementsPerPage];
+    }
+    if (mZeroPageIndex != noZeroPage) {
+        mZeroPageIndex = newIndices[mZeroPageIndex / kElementsPerPage];
+    }
+    std::unique_ptr<element[]> bitmaps(new element[newBitmapsCount]);
+    std::copy(mOwnedBitmaps.get(), mOwnedBitmaps.get() + newBitmapsCount, bitmaps.get());
+    mOwnedBitmaps = std::move(bitmaps);
+    mBitmaps = mOwnedBitmaps.get();
+    mBitmapsCount = newBitmapsCount;
+}
+
+void SparseBitSet::Builder::addRange(uint32_t start, uint32_t end) {
+    MINIKIN_ASSERT(mEnd <= end, "Ranges must be added in ascending order");
+    start = std::max(start, mEnd);
+    if (start >= end) {
+        return;
+    }
+    const uint32_t startPage = start >> kLogValuesPerPage;
+    const uint32_t endPage = (end - 1) >> kLogValuesPerPage;
+    for (uint32_t page = mIndices.size(); page <= endPage; page++) {
+        if (page < startPage) {
+            if (mZeroPageIndex == noZeroPage) {
+                mZeroPageIndex = mBitmaps.size();
+                mBitmaps.resize(mBitmaps.size() + kElementsPerPage);
+            }
+            mIndices.push_back(mZeroPageIndex);
+        } else {
+            MINIKIN_ASSERT(mBitmaps.size() + kElementsPerPage < noZeroPage,
+                           "Exceeded the maximum number of pages.");
+            mIndices.push_back(static_cast<uint16_t>(mBitmaps.size()));
+            mBitmaps.resize(mBitmaps.size() + kElementsPerPage);
+        }
+    }
+
+    const uint32_t firstEl = start >> kLogBitsPerEl;
+    const uint32_t lastEl = (end - 1) >> kLogBitsPerEl;
+    for (uint32_t el = firstEl; el <= lastEl; el++) {
+        element mask = kElAllOnes;
+        if (el == firstEl) {
+            mask &= kElAllOnes >> (start & kElMask);
+        }
+        if (el == lastEl) {
+            mask &= kElAllOnes << ((~end + 1) & kElMask);
+        }
+        const uint32_t page = el >> (kLogValuesPerPage - kLogBitsPerEl);
+        mBitmaps[mIndices[page] + (el & (kElementsPerPage - 1))] |= mask;
+    }
+    mEnd = end;
+}
+
+SparseBitSet SparseBitSet::Builder::build() {
+    SparseBitSet result;
+    if (mEnd == 0 || mEnd >= kMaximumCapacity) {
+        return result;
+    }
+    result.mMaxVal = mEnd;
+    result.mIndicesCount = mIndices.size();
+    result.mOwnedIndices.reset(new uint16_t[result.mIndicesCount]);
+    std::copy(mIndices.begin(), mIndices.end(), result.mOwnedIndices.get());
+    result.mIndices = result.mOwnedIndices.get();
+    result.mBitmapsCount = mBitmaps.size();
+    result.mOwnedBitmaps.reset(new element[result.mBitmapsCount]);
+    std::copy(mBitmaps.begin(), mBitmaps.end(), result.mOwnedBitmaps.get());
+    result.mBitmaps = result.mOwnedBitmaps.get();
+    result.mZeroPageIndex = mZeroPageIndex;
+    result.deduplicatePages();
+    return result;
 }
 
-void SparseBitSet::initFromBuffer(BufferReader* reader) {
+SparseBitSet::SparseBitSet(BufferReader* reader, const PagePool& pool) : SparseBitSet() {
+    initFromBuffer(reader, &pool);
+}
+
+void SparseBitSet::initFromBuffer(BufferReader* reader, const PagePool* pool) {
     mMaxVal = reader->read<uint32_t>();
     // mIndices and mBitmaps are not initialized when mMaxVal == 0
     if (mMaxVal == 0) return;
@@ -113,6 +229,36 @@ void SparseBitSet::initFromBuffer(BufferReader* reader) {
     static_assert(sizeof(element) == 4);
     std::tie(mBitmaps, mBitmapsCount) = reader->readArray<element>();
     mZeroPageIndex = reader->read<uint16_t>();
+    // A non-empty set without bitmaps refers to the pages in the pool.
+    if (mBitmapsCount == 0 && pool != nullptr) {
+        mBitmaps = pool->mBitmaps;
+        mBitmapsCount = pool->mBitmapsCount;
+    }
+}
+
+// static
+void SparseBitSet::validate(BufferValidator* validator, uint32_t poolBitmapsCount) {
+    const uint32_t maxVal = validator->read<uint32_t>();
+    if (maxVal == 0) return;
+    const auto [indices, indicesCount] = validator->readArray<uint16_t>();
+    uint32_t bitmapsCount = validator->readArray<element>().second;
+    validator->skip<uint16_t>();  // mZeroPageIndex
+    if (!validator->ok()) return;
+    if (bitmapsCount == 0) {
+        bitmapsCount = poolBitmapsCount;
+    }
+
+    const uint64_t pageCount = (static_cast<uint64_t>(maxVal) + kPageMask) >> kLogValuesPerPage;
+    if (indicesCount < pageCount) {
+        validator->fail();
+        return;
+    }
+    for (uint32_t i = 0; i < pageCount; i++) {
+        if (static_cast<uint32_t>(indices[i]) + kElementsPerPage > bitmapsCount) {
+            validator->fail();
+            return;
+        }
+    }
 }
 
 void SparseBitSet::writeTo(BufferWriter* writer) const {
@@ -124,11 +270,198 @@ void SparseBitSet::writeTo(BufferWriter* writer) const {
     writer->write<uint16_t>(mZeroPageIndex);
 }
 
+void SparseBitSet::writeTo(BufferWriter* writer, const PagePool& pool) const {
+    if (mMaxVal == 0) {
+        writeTo(writer);
+        return;
+    }
+    std::vector<uint16_t> indices(mIndicesCount);
+    for (uint32_t i = 0; i < mIndicesCount; i++) {
+        indices[i] = pool.find(&mBitmaps[mIndices[i]]);
+        if (indices[i] == noZeroPage) {
+            // The set was not added to the pool.
+            writeTo(writer);
+            return;
+        }
+    }
+    uint16_t zeroPageIndex = noZeroPage;
+    if (mZeroPageIndex != noZeroPage) {
+        zeroPageIndex = pool.find(&mBitmaps[mZeroPageIndex]);
+    }
+    writer->write<uint32_t>(mMaxVal);
+    writer->writeArray<uint16_t>(indices.data(), indices.size());
+    writer->write<uint32_t>(0);  // The size of the bitmaps, see initFromBuffer().
+    writer->write<uint16_t>(zeroPageIndex);
+}
+
+SparseBitSet::PagePool::PagePool(BufferReader* reader) {
+    std::tie(mBitmaps, mBitmapsCount) = reader->readArray<element>();
+}
+
+void SparseBitSet::PagePool::add(const SparseBitSet& set) {
+    if (set.mMaxVal == 0) {
+        return;
+    }
+    const size_t oldBitmapsCount = mOwnedBitmaps.size();
+    std::vector<std::map<Page, uint16_t>::iterator> newPages;
+    for (uint32_t i = 0; i < set.mIndicesCount; i++) {
+        const element* bitmap = &set.mBitmaps[set.mIndices[i]];
+        Page page;
+        std::copy(bitmap, bitmap + kElementsPerPage, page.begin());
+        auto [it, inserted] = mPageIndices.emplace(page, mOwnedBitmaps.size());
+        if (!inserted) {
+            continue;
+        }
+        // The page indices must stay below noZeroPage. Don't add the set partially.
+        if (mOwnedBitmaps.size() + kElementsPerPage > noZeroPage) {
+            mPageIndices.erase(it);
+            for (auto newPage : newPages) {
+                mPageIndices.erase(newPage);
+            }
+            mOwnedBitmaps.resize(oldBitmapsCount);
+            return;
+        }
+        newPages.push_back(it);
+        mOwnedBitmaps.insert(mOwnedBitmaps.end(), page.begin(), page.end());
+    }
+    mBitmaps = mOwnedBitmaps.data();
+    mBitmapsCount = mOwnedBitmaps.size();
+}
+
+uint16_t SparseBitSet::PagePool::find(const element* bitmap) const {
+    Page page;
+    std::copy(bitmap, bitmap + kElementsPerPage, page.begin());
+    auto it = mPageIndices.find(page);
+    return it == mPageIndices.end() ? noZeroPage : it->second;
+}
+
+void SparseBitSet::PagePool::writeTo(BufferWriter* writer) const {
+    writer->writeArray<element>(mBitmaps, mBitmapsCount);
+}
+
+// static
+uint32_t SparseBitSet::PagePool::validate(BufferValidator* validator) {
+    return validator->readArray<element>().second;
+}
+
+void SparseBitSet::combineWith(const SparseBitSet& other, bool isUnion) {
+    const uint32_t maxVal =
+            isUnion ? std::max(mMaxVal, other.mMaxVal) : std::min(mMaxVal, other.mMaxVal);
+    const uint32_t indicesCount = (maxVal + kPageMask) >> kLogValuesPerPage;
+    std::unique_ptr<uint16_t[]> indices(new uint16_t[indicesCount]);
+    std::vector<element> bitmaps;
+    uint16_t zeroPageIndex = noZeroPage;
+    uint16_t fullPageIndex = noZeroPage;
+    bool isEmpty = true;
+    element page[kElementsPerPage];
+    for (uint32_t i = 0; i < indicesCount; i++) {
+        const element* a = pageBitmap(i);
+        const element* b = other.pageBitmap(i);
+        element anyBits = 0;
+        element allBits = kElAllOnes;
+        for (uint32_t j = 0; j < kElementsPerPage; j++) {
+            const element x = a == nullptr ? 0 : a[j];
+            const element y = b == nullptr ? 0 : b[j];
+            page[j] = isUnion ? (x | y) : (x & y);
+            anyBits |= page[j];
+            allBits &= page[j];
+        }
+        isEmpty &= anyBits == 0;
+        uint16_t* sharedIndex = nullptr;
+        if (anyBits == 0) {
+            sharedIndex = &zeroPageIndex;
+        } else if (allBits == kElAllOnes) {
+            sharedIndex = &fullPageIndex;
+        }
+        if (sharedIndex != nullptr && *sharedIndex != noZeroPage) {
+            indices[i] = *sharedIndex;
+            continue;
+        }
+        MINIKIN_ASSERT(bitmaps.size() + kElementsPerPage < noZeroPage,
+                       "Exceeded the maximum number of pages.");
+        indices[i] = static_cast<uint16_t>(bitmaps.size());
+        if (sharedIndex != nullptr) {
+            *sharedIndex = indices[i];
+        }
+        bitmaps.insert(bitmaps.end(), page, page + kElementsPerPage);
+    }
+
+    if (isEmpty) {
+        mMaxVal = 0;
+        mIndices = nullptr;
+        mBitmaps = nullptr;
+        mOwnedIndices.reset();
+        mOwnedBitmaps.reset();
+        return;
+    }
+    mMaxVal = maxVal;
+    mIndicesCount = indicesCount;
+    mOwnedIndices = std::move(indices);
+    mIndices = mOwnedIndices.get();
+    mBitmapsCount = bitmaps.size();
+    mOwnedBitmaps.reset(new element[mBitmapsCount]);
+    std::copy(bitmaps.begin(), bitmaps.end(), mOwnedBitmaps.get());
+    mBitmaps = mOwnedBitmaps.get();
+    mZeroPageIndex = zeroPageIndex;
+    deduplicatePages();
+}
+
+bool SparseBitSet::intersects(const SparseBitSet& other) const {
+    const uint32_t pageCount = (std::min(mMaxVal, other.mMaxVal) + kPageMask) >> kLogValuesPerPage;
+    for (uint32_t i = 0; i < pageCount; i++) {
+        const element* a = pageBitmap(i);
+        const element* b = other.pageBitmap(i);
+        if (a == nullptr || b == nullptr) {
+            continue;
+        }
+        for (uint32_t j = 0; j < kElementsPerPage; j++) {
+            if ((a[j] & b[j]) != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t SparseBitSet::popcount() const {
+    const uint32_t pageCount = (mMaxVal + kPageMask) >> kLogValuesPerPage;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < pageCount; i++) {
+        const element* bitmap = pageBitmap(i);
+        if (bitmap == nullptr) {
+            continue;
+        }
+        for (uint32_t j = 0; j < kElementsPerPage; j++) {
+            count += __builtin_popcount(bitmap[j]);
+        }
+    }
+    return count;
+}
+
 int SparseBitSet::CountLeadingZeros(element x) {
     // Note: GCC / clang builtin
     return sizeof(element) <= sizeof(int) ? __builtin_clz(x) : __builtin_clzl(x);
 }
 
+// static
+uint32_t SparseBitSet::findFirstSetBitInPage(const element* bitmap, uint32_t fromElement) {
+    uint32_t j = fromElement;
+    if ((j & 1) != 0 && j < kElementsPerPage) {
+        if (bitmap[j] != 0) {
+            return (j << kLogBitsPerEl) + CountLeadingZeros(bitmap[j]);
+        }
+        j++;
+    }
+    // Test two elements at a time. The first element has the smaller values, i.e. the higher bits.
+    for (; j < kElementsPerPage; j += 2) {
+        const uint64_t pair = (static_cast<uint64_t>(bitmap[j]) << 32) | bitmap[j + 1];
+        if (pair != 0) {
+            return (j << kLogBitsPerEl) + __builtin_clzll(pair);
+        }
+    }
+    return kNotFound;
+}
+
 uint32_t SparseBitSet::nextSetBit(uint32_t fromIndex) const {
     if (fromIndex >= mMaxVal) {
         return kNotFound;
@@ -140,11 +473,9 @@ uint32_t SparseBitSet::nextSetBit(uint32_t fromIndex) const {
     if (e != 0) {
         return (fromIndex & ~kElMask) + CountLeadingZeros(e);
     }
-    for (uint32_t j = offset + 1; j < (1 << (kLogValuesPerPage - kLogBitsPerEl)); j++) {
-        e = bitmap[j];
-        if (e != 0) {
-            return (fromIndex & ~kPageMask) + (j << kLogBitsPerEl) + CountLeadingZeros(e);
-        }
+    uint32_t bit = findFirstSetBitInPage(bitmap, offset + 1);
+    if (bit != kNotFound) {
+        return (fromIndex & ~kPageMask) + bit;
     }
     uint32_t maxPage = (mMaxVal + kPageMask) >> kLogValuesPerPage;
     for (uint32_t page = fromPage + 1; page < maxPage; page++) {
@@ -152,15 +483,20 @@ uint32_t SparseBitSet::nextSetBit(uint32_t fromIndex) const {
         if (index == mZeroPageIndex) {
             continue;
         }
-        bitmap = &mBitmaps[index];
-        for (uint32_t j = 0; j < (1 << (kLogValuesPerPage - kLogBitsPerEl)); j++) {
-            e = bitmap[j];
-            if (e != 0) {
-                return (page << kLogValuesPerPage) + (j << kLogBitsPerEl) + CountLeadingZeros(e);
-            }
+        bit = findFirstSetBitInPage(&mBitmaps[index], 0);
+        if (bit != kNotFound) {
+            return (page << kLogValuesPerPage) + bit;
         }
     }
     return kNotFound;
 }
 
+bool SparseBitSet::intersectsPage(uint32_t page) const {
+    if (page >= ((mMaxVal + kPageMask) >> kLogValuesPerPage)) {
+        return false;
+    }
+    const uint16_t index = mIndices[page];
+    return index != mZeroPageIndex && findFirstSetBitInPage(&mBitmaps[index], 0) != kNotFound;
+}
+
 }  // namespace minikin
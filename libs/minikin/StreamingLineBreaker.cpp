@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/StreamingLineBreaker.h"
+
+#include "minikin/Characters.h"
+
+namespace minikin {
+
+void StreamingLineBreaker::breakText(const U16StringPiece& text, const AddRunsFunc& addRuns,
+                                     const LineBreakFunc& onLineBreaks) const {
+    std::vector<Range> window;
+    uint32_t windowLength = 0;
+    uint32_t paraStart = 0;
+    for (uint32_t i = 0; i < text.size(); ++i) {
+        if (text[i] != CHAR_LINE_FEED) {
+            continue;
+        }
+        window.emplace_back(paraStart, i + 1);
+        windowLength += i + 1 - paraStart;
+        paraStart = i + 1;
+        if (windowLength >= mWindowSize) {
+            breakWindow(text, window, addRuns, onLineBreaks);
+            window.clear();
+            windowLength = 0;
+        }
+    }
+    if (paraStart < text.size()) {
+        window.emplace_back(paraStart, text.size());
+    }
+    if (!window.empty()) {
+        breakWindow(text, window, addRuns, onLineBreaks);
+    }
+}
+
+void StreamingLineBreaker::breakWindow(const U16StringPiece& text,
+                                       const std::vector<Range>& paragraphs,
+                                       const AddRunsFunc& addRuns,
+                                       const LineBreakFunc& onLineBreaks) const {
+    const bool computeHyphenation = mFrequency != HyphenationFrequency::None;
+    std::vector<std::unique_ptr<MeasuredText>> measuredTexts;
+    std::vector<LineBreakJob> jobs;
+    measuredTexts.reserve(paragraphs.size());
+    jobs.reserve(paragraphs.size());
+    for (const Range& paragraph : paragraphs) {
+        const U16StringPiece paraText = text.substr(paragraph);
+        MeasuredTextBuilder builder;
+        addRuns(paragraph, &builder);
+        measuredTexts.push_back(builder.build(paraText, computeHyphenation,
+                                              false /* compute full layout */,
+                                              nullptr /* no hint */));
+        jobs.push_back({paraText, measuredTexts.back().get(), mLineWidth.get(), &mTabStops});
+    }
+
+    std::vector<LineBreakResult> results =
+            breakIntoLines(jobs, mStrategy, mFrequency, mJustified, mMaxThreads);
+    for (size_t i = 0; i < paragraphs.size(); ++i) {
+        onLineBreaks(paragraphs[i], std::move(results[i]));
+    }
+}
+
+}  // namespace minikin
@@ -18,6 +18,8 @@
 
 #include "minikin/SystemFonts.h"
 
+#include <unordered_set>
+
 namespace minikin {
 
 SystemFonts& SystemFonts::getInstance() {
@@ -27,19 +29,59 @@ SystemFonts& SystemFonts::getInstance() {
 
 std::shared_ptr<FontCollection> SystemFonts::findFontCollectionInternal(
         const std::string& familyName) {
-    std::lock_guard<std::mutex> lock(mMutex);
-    auto it = mSystemFallbacks.find(familyName);
-    if (it != mSystemFallbacks.end()) {
+    std::shared_ptr<const Snapshot> snapshot = loadSnapshot();
+    auto it = snapshot->systemFallbacks.find(familyName);
+    if (it != snapshot->systemFallbacks.end()) {
         return it->second;
     }
     // TODO: Lookup by PostScript name.
-    return mDefaultFallback;
+    return snapshot->defaultFallback;
+}
+
+void SystemFonts::registerFallbackInternal(const std::string& familyName,
+                                           const std::shared_ptr<FontCollection>& fc) {
+    updateSnapshot([&](Snapshot* snapshot) { snapshot->systemFallbacks[familyName] = fc; });
+}
+
+void SystemFonts::registerDefaultInternal(const std::shared_ptr<FontCollection>& fc) {
+    updateSnapshot([&](Snapshot* snapshot) { snapshot->defaultFallback = fc; });
+}
+
+void SystemFonts::addFontMapInternal(std::shared_ptr<FontCollection>&& collections) {
+    updateSnapshot(
+            [&](Snapshot* snapshot) { snapshot->collections.emplace_back(std::move(collections)); });
+}
+
+void SystemFonts::getFontMapInternal(
+        std::function<void(const std::vector<std::shared_ptr<FontCollection>>&)> func) {
+    std::shared_ptr<const Snapshot> snapshot = loadSnapshot();
+    func(snapshot->collections);
+}
+
+void SystemFonts::getFontSetInternal(
+        std::function<void(const std::vector<std::shared_ptr<Font>>&)> func) {
+    std::shared_ptr<const Snapshot> snapshot = loadSnapshot();
+    std::call_once(snapshot->fontsOnce, [&snapshot] { buildFontSet(*snapshot); });
+    func(snapshot->fonts);
+}
+
+void SystemFonts::updateSnapshot(const std::function<void(Snapshot*)>& update) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::shared_ptr<const Snapshot> current = loadSnapshot();
+    auto next = std::make_shared<Snapshot>();
+    next->systemFallbacks = current->systemFallbacks;
+    next->defaultFallback = current->defaultFallback;
+    next->collections = current->collections;
+    update(next.get());
+    std::atomic_store_explicit(&mSnapshot, std::shared_ptr<const Snapshot>(std::move(next)),
+                               std::memory_order_release);
 }
 
-void SystemFonts::buildFontSetLocked() {
+// static
+void SystemFonts::buildFontSet(const Snapshot& snapshot) {
     std::unordered_set<FontFamily*> uniqueFamilies;
 
-    for (const auto& collection : mCollections) {
+    for (const auto& collection : snapshot.collections) {
         for (const auto& family : collection->getFamilies()) {
             uniqueFamilies.insert(family.get());
         }
@@ -51,7 +93,7 @@ void SystemFonts::buildFontSetLocked() {
             result.push_back(family->getFontRef(i));
         }
     }
-    mFonts = std::move(result);
+    snapshot.fonts = std::move(result);
 }
 
 }  // namespace minikin
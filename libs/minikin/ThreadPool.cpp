@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "ThreadPool.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <log/log.h>
+
+namespace minikin {
+
+namespace {
+
+// The nice value of the background worker, the one of background threads on Android.
+constexpr int kBackgroundThreadPriority = 10;
+
+// The pool and the index of the foreground worker running on this thread, if any.
+thread_local const ThreadPool* gCurrentPool = nullptr;
+thread_local uint32_t gCurrentWorker = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t foregroundWorkerCount)
+        : mNextWorker(0), mPendingCount(0), mIsStopping(false) {
+    for (uint32_t i = 0; i < std::max(1u, foregroundWorkerCount); ++i) {
+        mWorkers.push_back(std::make_unique<Worker>());
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsStopping = true;
+    }
+    mForegroundCondition.notify_all();
+    mBackgroundCondition.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::execute(std::function<void()>&& task, Priority priority) {
+    std::call_once(mStartFlag, &ThreadPool::startThreads, this);
+    if (priority == Priority::kBackground) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBackgroundTasks.push_back(std::move(task));
+        }
+        mBackgroundCondition.notify_one();
+        return;
+    }
+
+    // The tasks posted by a worker, e.g. the ones of a parallel build running in a task, go to
+    // its own queue. The others are spread over the workers.
+    const uint32_t index =
+            gCurrentPool == this
+                    ? gCurrentWorker
+                    : mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    {
+        std::lock_guard<std::mutex> lock(mWorkers[index]->mutex);
+        mWorkers[index]->tasks.push_back(std::move(task));
+    }
+    mPendingCount.fetch_add(1);
+    {
+        // Taking the lock orders the count before the check of a worker about to sleep.
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mForegroundCondition.notify_one();
+}
+
+void ThreadPool::startThreads() {
+    for (uint32_t i = 0; i < mWorkers.size(); ++i) {
+        mThreads.emplace_back(&ThreadPool::runForeground, this, i);
+    }
+    mThreads.emplace_back(&ThreadPool::runBackground, this);
+}
+
+bool ThreadPool::takeTask(uint32_t index, std::function<void()>* task) {
+    const uint32_t workerCount = mWorkers.size();
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        Worker& worker = *mWorkers[(index + i) % workerCount];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            *task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            *task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+        mPendingCount.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::runForeground(uint32_t index) {
+    gCurrentPool = this;
+    gCurrentWorker = index;
+    while (true) {
+        std::function<void()> task;
+        if (takeTask(index, &task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        mForegroundCondition.wait(lock,
+                                  [this]() { return mIsStopping || mPendingCount.load() > 0; });
+        if (mIsStopping) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::runBackground() {
+    // On Linux, this only lowers the priority of the calling thread.
+    if (setpriority(PRIO_PROCESS, 0, kBackgroundThreadPriority) != 0) {
+        // The tasks still run, but compete with the foreground work at the default priority.
+        ALOGW("Failed to lower the priority of the background thread: %s", strerror(errno));
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mBackgroundCondition.wait(lock,
+                                  [this]() { return mIsStopping || !mBackgroundTasks.empty(); });
+        if (mBackgroundTasks.empty()) {
+            return;  // Stopping, after the tasks posted before.
+        }
+        std::function<void()> task = std::move(mBackgroundTasks.front());
+        mBackgroundTasks.pop_front();
+        lock.unlock();
+        task();
+        // The captures of the task are released before the next one starts.
+        task = nullptr;
+        lock.lock();
+    }
+}
+
+// static
+uint32_t ThreadPool::getPerformanceCoreCount() {
+    const uint32_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> capacities;
+    for (uint32_t i = 0; i < coreCount; ++i) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpu_capacity", i);
+        FILE* fp = fopen(path, "r");
+        if (fp == nullptr) {
+            return coreCount;
+        }
+        uint32_t capacity = 0;
+        const bool parsed = fscanf(fp, "%u", &capacity) == 1;
+        fclose(fp);
+        if (!parsed) {
+            return coreCount;
+        }
+        capacities.push_back(capacity);
+    }
+    const uint32_t maxCapacity = *std::max_element(capacities.begin(), capacities.end());
+    return std::count_if(capacities.begin(), capacities.end(),
+                         [maxCapacity](uint32_t capacity) { return capacity * 2 >= maxCapacity; });
+}
+
+}  // namespace minikin
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_THREAD_POOL_H
+#define MINIKIN_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "minikin/Executor.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// The default executor. Each foreground worker has its own queue, takes the tasks it posts itself
+// from the back of it, and steals from the front of the others when its queue is empty, so that
+// the nested parallel work stays on the thread that posted it. The background tasks run one by
+// one on a separate worker with a lower priority, so they never take a foreground worker.
+class ThreadPool : public Executor {
+public:
+    // The threads are started by the first task.
+    explicit ThreadPool(uint32_t foregroundWorkerCount);
+
+    // Runs the tasks already posted, and joins the threads. The workers only stop once the queues
+    // are empty, so the tasks posted before never get lost, e.g. the ones someone waits for.
+    virtual ~ThreadPool();
+
+    void execute(std::function<void()>&& task, Priority priority) override;
+
+    uint32_t getConcurrency() const override { return mWorkers.size(); }
+
+    // Returns the number of the performance cores, i.e. the cores whose capacity is at least half
+    // of the largest one, or the number of the cores if the kernel doesn't report the capacities.
+    static uint32_t getPerformanceCoreCount();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks GUARDED_BY(mutex);
+    };
+
+    void startThreads();
+    void runForeground(uint32_t index);
+    void runBackground();
+    // Takes a task from the back of the queue of the worker or from the front of another one.
+    bool takeTask(uint32_t index, std::function<void()>* task);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<uint32_t> mNextWorker;
+    // The number of the foreground tasks in the queues.
+    std::atomic<int32_t> mPendingCount;
+
+    std::once_flag mStartFlag;
+    std::vector<std::thread> mThreads;
+
+    std::deque<std::function<void()>> mBackgroundTasks GUARDED_BY(mMutex);
+    bool mIsStopping GUARDED_BY(mMutex);
+    // Notified when a task is posted or the pool is stopping.
+    std::condition_variable mForegroundCondition;
+    std::condition_variable mBackgroundCondition;
+    std::mutex mMutex;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_THREAD_POOL_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_VIEW
+
+#include "TraceSpan.h"
+
+#include <atomic>
+
+#ifdef __ANDROID__
+#include <cstdio>
+
+#include <cutils/trace.h>
+#endif
+
+namespace minikin {
+
+namespace {
+
+std::atomic<const TraceCallbacks*> gTraceCallbacks(nullptr);
+
+}  // namespace
+
+void setTraceCallbacks(const TraceCallbacks* callbacks) {
+    gTraceCallbacks.store(callbacks, std::memory_order_release);
+}
+
+TraceSpan::TraceSpan(const char* name, uint32_t textLength, uint32_t runCount)
+        : mCallbacks(gTraceCallbacks.load(std::memory_order_acquire)) {
+#ifdef __ANDROID__
+    mAtrace = false;
+    if (ATRACE_ENABLED()) {
+        // atrace has no arguments, so they are part of the name of the span.
+        char label[128];
+        snprintf(label, sizeof(label), "%s len=%u runs=%u", name, textLength, runCount);
+        ATRACE_BEGIN(label);
+        mAtrace = true;
+    }
+#endif
+    if (mCallbacks != nullptr) {
+        mCallbacks->beginSpan(name, textLength, runCount);
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (mCallbacks != nullptr) {
+        mCallbacks->endSpan();
+    }
+#ifdef __ANDROID__
+    if (mAtrace) {
+        ATRACE_END();
+    }
+#endif
+}
+
+}  // namespace minikin
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_TRACE_SPAN_H
+#define MINIKIN_TRACE_SPAN_H
+
+#include <cstdint>
+
+#include "minikin/Macros.h"
+#include "minikin/Tracing.h"
+
+namespace minikin {
+
+// Emits a tracing span for its lifetime to atrace on Android and to the TraceCallbacks.
+// Use MINIKIN_TRACE instead, which compiles to nothing without ENABLE_TRACING.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, uint32_t textLength, uint32_t runCount);
+    ~TraceSpan();
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(TraceSpan);
+
+private:
+    const TraceCallbacks* mCallbacks;
+#ifdef __ANDROID__
+    bool mAtrace;  // Whether the span was sent to atrace.
+#endif
+};
+
+#define MINIKIN_TRACE_CONCAT_INNER(a, b) a##b
+#define MINIKIN_TRACE_CONCAT(a, b) MINIKIN_TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing scope as a span of the given name, a string literal.
+#ifdef ENABLE_TRACING
+#define MINIKIN_TRACE(name, textLength, runCount) \
+    ::minikin::TraceSpan MINIKIN_TRACE_CONCAT(traceSpan_, __LINE__)(name, textLength, runCount)
+#else
+#define MINIKIN_TRACE(name, textLength, runCount) ((void)0)
+#endif
+
+}  // namespace minikin
+
+#endif  // MINIKIN_TRACE_SPAN_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "UnicodeProperties.h"
+
+#include <log/log.h>
+#include <unicode/uchar.h>
+#include <unicode/uversion.h>
+
+#include <algorithm>
+
+namespace minikin {
+
+uint16_t computeUnicodeProperties(uint32_t c) {
+    using namespace unicode_tables;
+    uint16_t props = u_getIntPropertyValue(c, UCHAR_GRAPHEME_CLUSTER_BREAK);
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI)) props |= EMOJI_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER)) props |= EMOJI_MODIFIER_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER_BASE)) props |= EMOJI_MODIFIER_BASE_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EXTENDED_PICTOGRAPHIC)) props |= EXTENDED_PICTOGRAPHIC_BIT;
+    if (u_getIntPropertyValue(c, UCHAR_CANONICAL_COMBINING_CLASS) == 9) props |= VIRAMA_BIT;
+    if (u_getIntPropertyValue(c, UCHAR_GENERAL_CATEGORY) == U_OTHER_LETTER) {
+        props |= OTHER_LETTER_BIT;
+    }
+    return props;
+}
+
+bool unicodeTablesMatchIcu() {
+    UVersionInfo version;
+    u_getVersion(version);
+    const bool match = std::equal(std::begin(unicode_tables::ICU_VERSION),
+                                  std::end(unicode_tables::ICU_VERSION), version);
+    if (!match) {
+        ALOGW("The Unicode tables are generated with ICU %u.%u but ICU %u.%u is used. "
+              "Falling back to the ICU calls.",
+              unicode_tables::ICU_VERSION[0], unicode_tables::ICU_VERSION[1], version[0],
+              version[1]);
+    }
+    return match;
+}
+
+}  // namespace minikin
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_UNICODE_PROPERTIES_H
+#define MINIKIN_UNICODE_PROPERTIES_H
+
+#include <cstdint>
+
+#include "MinikinInternal.h"
+
+// Generated by tools/gen_unicode_tables.cpp at build time.
+#include "UnicodeTables.h"
+
+namespace minikin {
+
+// Returns the properties of the code point with the ICU calls the tables are generated from. Keep
+// in sync with getProperties() in tools/gen_unicode_tables.cpp.
+uint16_t computeUnicodeProperties(uint32_t c);
+
+// Returns true if the ICU the library runs with has the version the tables are generated with.
+bool unicodeTablesMatchIcu();
+
+// Returns the properties of the code point minikin needs, packed as described by the constants in
+// unicode_tables. This is three table loads instead of an ICU call per property, unless the ICU
+// the library runs with isn't the one the tables are generated with, whose properties may differ.
+// Values above MAX_UNICODE_CODE_POINT have no properties.
+inline uint16_t getUnicodeProperties(uint32_t c) {
+    using namespace unicode_tables;
+    if (c > MAX_UNICODE_CODE_POINT) {
+        return 0;
+    }
+    static const bool kTablesMatchIcu = unicodeTablesMatchIcu();
+    if (!kTablesMatchIcu) [[unlikely]] {
+        return computeUnicodeProperties(c);
+    }
+    const uint32_t block = kBlockIndex[c >> BLOCK_SHIFT];
+    return kProperties[kBlocks[(block << BLOCK_SHIFT) | (c & BLOCK_MASK)]];
+}
+
+}  // namespace minikin
+
+#endif  // MINIKIN_UNICODE_PROPERTIES_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Utf8Text.h"
+
+#include <algorithm>
+
+#include <unicode/utf16.h>
+#include <unicode/utf8.h>
+
+namespace minikin {
+
+Utf8Text::Utf8Text(const char* text, uint32_t size) : mUtf8Size(size) {
+    // A character never takes more UTF-16 code units than bytes.
+    mUtf16.reserve(size);
+    mUtf8Offsets.reserve(size);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(text);
+    int32_t i = 0;
+    while (i < static_cast<int32_t>(size)) {
+        const uint32_t start = i;
+        UChar32 c;
+        U8_NEXT(bytes, i, static_cast<int32_t>(size), c);
+        if (c < 0) {
+            c = 0xFFFD;
+        }
+        if (U_IS_BMP(c)) {
+            mUtf16.push_back(c);
+            mUtf8Offsets.push_back(start);
+        } else {
+            mUtf16.push_back(U16_LEAD(c));
+            mUtf16.push_back(U16_TRAIL(c));
+            mUtf8Offsets.push_back(start);
+            mUtf8Offsets.push_back(start);
+        }
+    }
+}
+
+uint32_t Utf8Text::toUtf16(uint32_t byteOffset) const {
+    // The first code unit of the first character starting at or after the byte offset.
+    return std::lower_bound(mUtf8Offsets.begin(), mUtf8Offsets.end(), byteOffset) -
+           mUtf8Offsets.begin();
+}
+
+void Utf8Text::toUtf8Advances(const float* utf16Advances, const Range& utf16Range,
+                              const Range& byteRange, float* out) const {
+    std::fill(out, out + byteRange.getLength(), 0.0f);
+    for (uint32_t i = utf16Range.getStart(); i < utf16Range.getEnd(); ++i) {
+        // Both code units of a surrogate pair map to the first byte. Layout puts the advance of
+        // the pair on the lead, so the trail adds 0.
+        out[toUtf8(i) - byteRange.getStart()] += utf16Advances[i - utf16Range.getStart()];
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WordBreakCache.h"
+
+#include <cstring>
+
+#include "minikin/Hasher.h"
+
+#include "LineBreakerUtil.h"
+#include "WordBreaker.h"
+
+namespace minikin {
+
+WordBreakKey::WordBreakKey(const U16StringPiece& text,
+                           const std::vector<std::unique_ptr<Run>>& runs)
+        : mChars(text.data()), mLength(text.size()) {
+    Hasher hasher;
+    hasher.updateShorts(text.data(), text.size());
+    for (const std::unique_ptr<Run>& run : runs) {
+        const uint32_t localeListId = run->getLocaleListId();
+        if (mLocaleGroups.empty() || mLocaleGroups.back().second != localeListId) {
+            mLocaleGroups.emplace_back(run->getRange().getStart(), localeListId);
+            hasher.update(run->getRange().getStart()).update(localeListId);
+        }
+    }
+    mHash = hasher.hash();
+}
+
+bool WordBreakKey::operator==(const WordBreakKey& o) const {
+    return mHash == o.mHash && mLength == o.mLength && mLocaleGroups == o.mLocaleGroups &&
+           (mChars == o.mChars || memcmp(mChars, o.mChars, mLength * sizeof(uint16_t)) == 0);
+}
+
+std::shared_ptr<const WordBreaks> WordBreakCache::get(
+        const U16StringPiece& text, const std::vector<std::unique_ptr<Run>>& runs,
+        WordBreaker* breaker) {
+    if (text.size() == 0 || text.size() > MAX_TEXT_LENGTH) {
+        mStats.bypass();
+        return nullptr;
+    }
+    WordBreakKey key(text, runs);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const std::shared_ptr<const WordBreaks>& cached = mCache.get(key);
+        if (cached != nullptr) {
+            mStats.hit();
+            return cached;
+        }
+    }
+    mStats.miss();
+    // Compute without holding the lock, so that other threads can use the cache meanwhile.
+    auto result = std::make_shared<WordBreaks>();
+    compute(text, runs, breaker, result.get());
+    key.copyText();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCache.size() >= MAX_ENTRIES) {
+        mStats.evict();
+    }
+    mCache.put(key, result);
+    mStats.insert();
+    return result;
+}
+
+// static
+void WordBreakCache::compute(const U16StringPiece& text,
+                             const std::vector<std::unique_ptr<Run>>& runs, WordBreaker* breaker,
+                             WordBreaks* out) {
+    breaker->setText(text.data(), text.size());
+    for (uint32_t i = 0; i < runs.size();) {
+        // The runs with the same locale are iterated without moving the breaker.
+        const uint32_t localeListId = runs[i]->getLocaleListId();
+        const uint32_t start = runs[i]->getRange().getStart();
+        uint32_t end = runs[i]->getRange().getEnd();
+        for (++i; i < runs.size() && runs[i]->getLocaleListId() == localeListId; ++i) {
+            end = runs[i]->getRange().getEnd();
+        }
+
+        std::vector<WordBreakPoint> breaks;
+        uint32_t offset = breaker->followingWithLocale(getEffectiveLocale(localeListId), start);
+        breaks.emplace_back(offset, breaker->breakBadness(), breaker->wordRange());
+        while (offset <= end) {
+            offset = breaker->next();
+            breaks.emplace_back(offset, breaker->breakBadness(), breaker->wordRange());
+        }
+        out->emplace_back(start, std::move(breaks));
+    }
+    breaker->finish();
+}
+
+size_t WordBreakCache::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t result = sizeof(WordBreakCache);
+    android::LruCache<WordBreakKey, std::shared_ptr<const WordBreaks>>::Iterator it(mCache);
+    while (it.next()) {
+        result += it.key().getMemoryUsage() + sizeof(WordBreaks);
+        for (const auto& group : *it.value()) {
+            result += sizeof(group) + sizeof(WordBreakPoint) * group.second.capacity();
+        }
+    }
+    return result;
+}
+
+}  // namespace minikin
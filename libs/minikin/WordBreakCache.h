@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_WORD_BREAK_CACHE_H
+#define MINIKIN_WORD_BREAK_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <utils/LruCache.h>
+
+#include "minikin/CacheStats.h"
+#include "minikin/Macros.h"
+#include "minikin/MeasuredText.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+class WordBreaker;
+
+// The key of the word break cache, which is the text and the locale of each group of consecutive
+// runs with the same locale. The line break style is part of the locale. The text is only copied
+// when the key is stored in the cache.
+class WordBreakKey {
+public:
+    WordBreakKey(const U16StringPiece& text, const std::vector<std::unique_ptr<Run>>& runs);
+
+    void copyText() {
+        mOwnedText = std::make_shared<std::vector<uint16_t>>(mChars, mChars + mLength);
+        mChars = mOwnedText->data();
+    }
+
+    bool operator==(const WordBreakKey& o) const;
+
+    android::hash_t hash() const { return mHash; }
+
+    size_t getMemoryUsage() const {
+        return sizeof(WordBreakKey) + sizeof(uint16_t) * mLength +
+               sizeof(std::pair<uint32_t, uint32_t>) * mLocaleGroups.capacity();
+    }
+
+private:
+    const uint16_t* mChars;
+    std::shared_ptr<std::vector<uint16_t>> mOwnedText;  // null for the lookup keys.
+    uint32_t mLength;
+    // The start and the locale list ID of each group.
+    std::vector<std::pair<uint32_t, uint32_t>> mLocaleGroups;
+    android::hash_t mHash;
+};
+
+inline android::hash_t hash_type(const WordBreakKey& key) {
+    return key.hash();
+}
+
+// A process-wide cache of the word breaks of paragraphs, so that breaking the same paragraph again
+// at another width, e.g. after a rotation or a resize, or measuring it again, doesn't run the ICU
+// line break iterator over it. The line breakers use it unless the MeasuredText kept its own word
+// breaks.
+class WordBreakCache {
+public:
+    static WordBreakCache& getInstance() {
+        static WordBreakCache cache;
+        return cache;
+    }
+
+    // Returns the word breaks WordBreaker finds in the text with the locales of the runs, laid out
+    // as MeasuredText::getWordBreaks, computing them with breaker if they are not cached. Returns
+    // nullptr without computing anything if the text is empty or too long to be cached.
+    std::shared_ptr<const WordBreaks> get(const U16StringPiece& text,
+                                          const std::vector<std::unique_ptr<Run>>& runs,
+                                          WordBreaker* breaker);
+
+    // Computes the word breaks without the cache. The text of the breaker is replaced.
+    static void compute(const U16StringPiece& text, const std::vector<std::unique_ptr<Run>>& runs,
+                        WordBreaker* breaker, WordBreaks* out);
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCache.clear();
+    }
+
+    size_t getCacheSize() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCache.size();
+    }
+
+    size_t getMemoryUsage();
+
+    const CacheStats& getStats() const { return mStats; }
+
+protected:
+    // protected for testing purposes.
+    static constexpr size_t MAX_ENTRIES = 64;
+    // The longer paragraphs are rarely broken again, and would take most of the memory.
+    static constexpr size_t MAX_TEXT_LENGTH = 2048;
+    WordBreakCache() : mCache(MAX_ENTRIES) {}  // singleton.
+
+private:
+    android::LruCache<WordBreakKey, std::shared_ptr<const WordBreaks>> mCache GUARDED_BY(mMutex);
+    CacheStats mStats;
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_WORD_BREAK_CACHE_H
@@ -16,8 +16,8 @@
 
 #include "WordBreaker.h"
 
-#include <list>
-#include <map>
+#include <algorithm>
+#include <atomic>
 
 #include <unicode/ubrk.h>
 #include <unicode/uchar.h>
@@ -42,18 +42,54 @@ static UBreakIterator* createNewIterator(const Locale& locale) {
 }
 }  // namespace
 
+namespace {
+std::atomic<size_t> gMaxPoolSize(ICULineBreakerPoolImpl::DEFAULT_MAX_POOL_SIZE);
+std::atomic<size_t> gTotalPoolSize(0);
+}  // namespace
+
+// static
+void ICULineBreakerPoolImpl::setMaxPoolSize(size_t size) {
+    gMaxPoolSize.store(size, std::memory_order_relaxed);
+}
+
+// static
+size_t ICULineBreakerPoolImpl::getMaxPoolSize() {
+    return gMaxPoolSize.load(std::memory_order_relaxed);
+}
+
+// static
+size_t ICULineBreakerPoolImpl::getTotalPoolSize() {
+    return gTotalPoolSize.load(std::memory_order_relaxed);
+}
+
+// static
+CacheStats& ICULineBreakerPoolImpl::getSharedStats() {
+    static CacheStats stats;
+    return stats;
+}
+
+ICULineBreakerPoolImpl::~ICULineBreakerPoolImpl() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    gTotalPoolSize.fetch_sub(mPoolSize, std::memory_order_relaxed);
+}
+
 ICULineBreakerPool::Slot ICULineBreakerPoolImpl::acquire(const Locale& locale) {
     const uint64_t id = locale.getIdentifier();
-    std::lock_guard<std::mutex> lock(mMutex);
-    for (auto i = mPool.begin(); i != mPool.end(); i++) {
-        if (i->localeId == id) {
-            Slot slot = std::move(*i);
-            mPool.erase(i);
+    {
+        std::unique_lock<std::mutex> lock = getSharedStats().lock(mMutex);
+        auto it = mBuckets.find(id);
+        if (it != mBuckets.end() && !it->second.empty()) {
+            Slot slot(id, std::move(it->second.back()));
+            it->second.pop_back();
+            mPoolSize--;
+            gTotalPoolSize.fetch_sub(1, std::memory_order_relaxed);
+            getSharedStats().hit();
             return slot;
         }
     }
 
     // Not found in pool. Create new one.
+    getSharedStats().miss();
     return {id, IcuUbrkUniquePtr(createNewIterator(locale))};
 }
 
@@ -61,14 +97,18 @@ void ICULineBreakerPoolImpl::release(ICULineBreakerPool::Slot&& slot) {
     if (slot.breaker.get() == nullptr) {
         return;  // Already released slot. Do nothing.
     }
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mPool.size() >= MAX_POOL_SIZE) {
-        // Pool is full. Move to local variable, so that the given slot will be released when the
-        // variable leaves the scope.
-        Slot localSlot = std::move(slot);
+    // Move to local variable, so that the given slot will be released when the variable leaves
+    // the scope if the pool is full.
+    Slot localSlot = std::move(slot);
+    std::unique_lock<std::mutex> lock = getSharedStats().lock(mMutex);
+    if (mPoolSize >= getMaxPoolSize()) {
+        getSharedStats().evict();
         return;
     }
-    mPool.push_front(std::move(slot));
+    mBuckets[localSlot.localeId].push_back(std::move(localSlot.breaker));
+    mPoolSize++;
+    gTotalPoolSize.fetch_add(1, std::memory_order_relaxed);
+    getSharedStats().insert();
 }
 
 WordBreaker::WordBreaker() : mPool(&ICULineBreakerPoolImpl::getInstance()) {}
@@ -89,6 +129,11 @@ ssize_t WordBreaker::followingWithLocale(const Locale& locale, size_t from) {
         // general, but keeping old email/URL context works for LineBreaker since it just wants to
         // re-calculate the next break point with the new locale.
     } else {
+        if (from != 0 && mScanResults.empty() && mTextSize >= kMinScanTableLength) {
+            // Restarting the detection, e.g. for a new locale, may scan the run of the offset
+            // again. The scans of long texts are then looked up instead of repeated.
+            scanEmailsAndUrls();
+        }
         mCurrent = mLast = mScanOffset = from;
         next();
     }
@@ -102,6 +147,7 @@ void WordBreaker::setText(const uint16_t* data, size_t size) {
     mCurrent = 0;
     mScanOffset = 0;
     mInEmailOrUrl = false;
+    mScanResults.clear();
     UErrorCode status = U_ZERO_ERROR;
     utext_openUChars(&mUText, reinterpret_cast<const UChar*>(data), size, &status);
 }
@@ -159,9 +205,118 @@ static bool isValidBreak(const uint16_t* buf, size_t bufEnd, int32_t i) {
     return true;
 }
 
+// The line breaking classes of UAX #14 that the Latin fast path understands. Everything else,
+// including the classes whose rules look across spaces (OP, QU, CL, CP, B2) and the hyphens, is
+// OTHER and makes the fast path defer to ICU.
+enum class LatinLineBreakClass : uint8_t {
+    OTHER,
+    AL,  // Alphabetic: ASCII and Latin-1 letters.
+    NU,  // Numeric: ASCII digits.
+    SP,  // Space: U+0020 only.
+    IS,  // Infix numeric separator: . , : ;
+    EX,  // Exclamation/interrogation: ! ?
+};
+
+static LatinLineBreakClass getLatinLineBreakClass(uint16_t c) {
+    if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')) {
+        return LatinLineBreakClass::AL;
+    }
+    if ('0' <= c && c <= '9') {
+        return LatinLineBreakClass::NU;
+    }
+    switch (c) {
+        case ' ':
+            return LatinLineBreakClass::SP;
+        case '.':
+        case ',':
+        case ':':
+        case ';':
+            return LatinLineBreakClass::IS;
+        case '!':
+        case '?':
+            return LatinLineBreakClass::EX;
+        default:
+            break;
+    }
+    // Latin-1 letters, excluding MULTIPLICATION SIGN and DIVISION SIGN which are ambiguous (AI).
+    if (0x00C0 <= c && c <= 0x00FF && c != 0x00D7 && c != 0x00F7) {
+        return LatinLineBreakClass::AL;
+    }
+    return LatinLineBreakClass::OTHER;
+}
+
+// Finds the line break following |from| with a subset of the UAX #14 rules, without ICU.
+//
+// Within the supported classes the only break opportunities are the ones before a letter or a
+// digit that follows a space (LB18) or an EX (LB31): spaces, IS and EX never break before them
+// (LB7, LB13), and letters, digits and IS hold together (LB23, LB25, LB28, LB29). No locale
+// tailoring applies to these classes, and none of the adjustments of isValidBreak() can reject
+// such a break.
+//
+// Returns the break offset, the text size if there is no break before the end of the text, or
+// -1 if the text around |from| contains anything else and ICU has to be asked instead.
+static ssize_t findNextLatinBreak(const uint16_t* buf, size_t bufEnd, size_t from) {
+    if (from >= bufEnd) {
+        return -1;  // Let ICU report the end of the text.
+    }
+    // Rules like LB14 (OP SP* x) look back across spaces, so the character before the preceding
+    // spaces must be supported too.
+    size_t contextStart = from;
+    while (contextStart > 0 && buf[contextStart - 1] == ' ') {
+        contextStart--;
+    }
+    if (contextStart > 0) {
+        contextStart--;
+    }
+    for (size_t i = contextStart; i < from; i++) {
+        if (getLatinLineBreakClass(buf[i]) == LatinLineBreakClass::OTHER) {
+            return -1;
+        }
+    }
+
+    LatinLineBreakClass prev = getLatinLineBreakClass(buf[from]);
+    if (prev == LatinLineBreakClass::OTHER) {
+        return -1;
+    }
+    for (size_t i = from + 1; i < bufEnd; i++) {
+        const LatinLineBreakClass cur = getLatinLineBreakClass(buf[i]);
+        switch (cur) {
+            case LatinLineBreakClass::OTHER:
+                return -1;
+            case LatinLineBreakClass::AL:
+            case LatinLineBreakClass::NU:
+                if (prev == LatinLineBreakClass::SP || prev == LatinLineBreakClass::EX) {
+                    return i;
+                }
+                if (prev == LatinLineBreakClass::IS && cur == LatinLineBreakClass::NU) {
+                    // "1.5" holds together by LB25, but whether an IS that doesn't follow a number
+                    // breaks before a digit differs between Unicode versions. Leave it to ICU.
+                    size_t j = i - 1;
+                    while (j > 0 && getLatinLineBreakClass(buf[j - 1]) == LatinLineBreakClass::IS) {
+                        j--;
+                    }
+                    if (j == 0 || getLatinLineBreakClass(buf[j - 1]) != LatinLineBreakClass::NU) {
+                        return -1;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        prev = cur;
+    }
+    return bufEnd;
+}
+
 // Customized iteratorNext that takes care of both resets and our modifications
 // to ICU's behavior.
 int32_t WordBreaker::iteratorNext() {
+    if (mUseLatinFastPath) {
+        const ssize_t result = findNextLatinBreak(mText, mTextSize, mCurrent);
+        if (result >= 0) {
+            return result;
+        }
+    }
     int32_t result = ubrk_following(mIcuBreaker.breaker.get(), mCurrent);
     while (!isValidBreak(mText, mTextSize, result)) {
         result = ubrk_next(mIcuBreaker.breaker.get());
@@ -180,38 +335,95 @@ static bool breakBefore(uint16_t c) {
            c == '%' || c == '=' || c == '&';
 }
 
-enum ScanState {
+enum ScanState : uint8_t {
     START,
     SAW_AT,
     SAW_COLON,
     SAW_COLON_SLASH,
     SAW_COLON_SLASH_SLASH,
+    SCAN_STATE_COUNT,
 };
 
-void WordBreaker::detectEmailOrUrl() {
-    // scan forward from current ICU position for email address or URL
-    if (mLast >= mScanOffset) {
-        ScanState state = START;
-        size_t i;
-        for (i = mLast; i < mTextSize; i++) {
-            uint16_t c = mText[i];
-            // scan only ASCII characters, stop at space
-            if (!(' ' < c && c <= 0x007E)) {
-                break;
+// The characters the email address / URL scanner distinguishes.
+enum ScanClass : uint8_t {
+    SCAN_OTHER,
+    SCAN_AT,
+    SCAN_COLON,
+    SCAN_SLASH,
+    SCAN_CLASS_COUNT,
+};
+
+// The next state for each state and class: SCAN_OTHER, SCAN_AT, SCAN_COLON, SCAN_SLASH.
+// An '@' or "://" seen from START is final.
+static constexpr ScanState kScanTransitions[SCAN_STATE_COUNT][SCAN_CLASS_COUNT] = {
+        {START, SAW_AT, SAW_COLON, START},
+        {SAW_AT, SAW_AT, SAW_AT, SAW_AT},
+        {START, START, START, SAW_COLON_SLASH},
+        {START, START, START, SAW_COLON_SLASH_SLASH},
+        {SAW_COLON_SLASH_SLASH, SAW_COLON_SLASH_SLASH, SAW_COLON_SLASH_SLASH,
+         SAW_COLON_SLASH_SLASH},
+};
+
+// Set in a scan result if the scan started at the position finds an email address or a URL.
+static constexpr uint32_t EMAIL_OR_URL_BIT = 0x80000000u;
+
+static ScanClass getScanClass(uint16_t c) {
+    return c == '@' ? SCAN_AT : c == ':' ? SCAN_COLON : c == '/' ? SCAN_SLASH : SCAN_OTHER;
+}
+
+uint32_t WordBreaker::scanEmailOrUrl(size_t start) const {
+    ScanState state = START;
+    size_t i;
+    for (i = start; i < mTextSize; i++) {
+        const uint16_t c = mText[i];
+        // scan only ASCII characters, stop at space
+        if (!(' ' < c && c <= 0x007E)) {
+            break;
+        }
+        state = kScanTransitions[state][getScanClass(c)];
+    }
+    const bool found = state == SAW_AT || state == SAW_COLON_SLASH_SLASH;
+    return i | (found ? EMAIL_OR_URL_BIT : 0);
+}
+
+void WordBreaker::scanEmailsAndUrls() {
+    // The scan started at a position runs over the ASCII characters up to the next space. Instead
+    // of repeating it for every position the detector starts from, compute the outcome for all
+    // positions in one backward pass: finalStates[s] is the state the scan ends in if it reaches
+    // the current position in state s.
+    mScanResults.resize(mTextSize + 1);
+    ScanState finalStates[SCAN_STATE_COUNT] = {START, SAW_AT, SAW_COLON, SAW_COLON_SLASH,
+                                               SAW_COLON_SLASH_SLASH};
+    uint32_t runEnd = mTextSize;
+    mScanResults[mTextSize] = runEnd;
+    for (size_t i = mTextSize; i-- > 0;) {
+        const uint16_t c = mText[i];
+        // scan only ASCII characters, stop at space
+        if (!(' ' < c && c <= 0x007E)) {
+            for (uint8_t s = 0; s < SCAN_STATE_COUNT; s++) {
+                finalStates[s] = static_cast<ScanState>(s);
             }
-            if (state == START && c == '@') {
-                state = SAW_AT;
-            } else if (state == START && c == ':') {
-                state = SAW_COLON;
-            } else if (state == SAW_COLON || state == SAW_COLON_SLASH) {
-                if (c == '/') {
-                    state = static_cast<ScanState>((int)state + 1);  // next state adds a slash
-                } else {
-                    state = START;
-                }
+            runEnd = i;
+        } else {
+            const ScanClass cls = getScanClass(c);
+            ScanState states[SCAN_STATE_COUNT];
+            for (uint8_t s = 0; s < SCAN_STATE_COUNT; s++) {
+                states[s] = finalStates[kScanTransitions[s][cls]];
             }
+            std::copy(states, states + SCAN_STATE_COUNT, finalStates);
         }
-        if (state == SAW_AT || state == SAW_COLON_SLASH_SLASH) {
+        const bool found =
+                finalStates[START] == SAW_AT || finalStates[START] == SAW_COLON_SLASH_SLASH;
+        mScanResults[i] = runEnd | (found ? EMAIL_OR_URL_BIT : 0);
+    }
+}
+
+void WordBreaker::detectEmailOrUrl() {
+    // look up the scan forward from current ICU position for email address or URL
+    if (mLast >= mScanOffset) {
+        const uint32_t result = mScanResults.empty() ? scanEmailOrUrl(mLast) : mScanResults[mLast];
+        size_t i = result & ~EMAIL_OR_URL_BIT;
+        if (result & EMAIL_OR_URL_BIT) {
             if (!ubrk_isBoundary(mIcuBreaker.breaker.get(), i)) {
                 // If there are combining marks or such at the end of the URL or the email address,
                 // consider them a part of the URL or the email, and skip to the next actual
@@ -23,11 +23,13 @@
 #ifndef MINIKIN_WORD_BREAKER_H
 #define MINIKIN_WORD_BREAKER_H
 
-#include <list>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <unicode/ubrk.h>
 
+#include "minikin/CacheStats.h"
 #include "minikin/IcuUtils.h"
 #include "minikin/Macros.h"
 #include "minikin/Range.h"
@@ -60,29 +62,53 @@ public:
     virtual void release(Slot&& slot) = 0;
 };
 
-// An singleton implementation of the ICU line breaker pool.
-// Since creating ICU line breaker instance takes some time. Pool it for later use.
+// A per-thread implementation of the ICU line breaker pool.
+// Since creating ICU line breaker instance takes some time. Pool it for later use. Each thread has
+// its own pool so that threads don't contend on a lock or evict each others' breakers, and the
+// pooled breakers are bucketed by locale identifier, which includes the line break style.
 class ICULineBreakerPoolImpl : public ICULineBreakerPool {
 public:
+    static constexpr size_t DEFAULT_MAX_POOL_SIZE = 16;
+
     Slot acquire(const Locale& locale) override;
     void release(Slot&& slot) override;
 
     static ICULineBreakerPoolImpl& getInstance() {
-        static ICULineBreakerPoolImpl pool;
+        static thread_local ICULineBreakerPoolImpl pool;
         return pool;
     }
 
-protected:
-    // protected for testing purposes.
-    static constexpr size_t MAX_POOL_SIZE = 4;
-    ICULineBreakerPoolImpl(){};  // singleton.
+    // Sets the number of breakers each thread's pool keeps. Lowering it doesn't close breakers that
+    // are already pooled, but no more are pooled until the pool drains below the new size.
+    static void setMaxPoolSize(size_t size);
+    static size_t getMaxPoolSize();
+
     size_t getPoolSize() const {
         std::lock_guard<std::mutex> lock(mMutex);
-        return mPool.size();
+        return mPoolSize;
     }
 
+    // Returns the number of breakers pooled by all threads.
+    static size_t getTotalPoolSize();
+
+    // A hit is an acquire() served from the pool, an eviction is a release() to the full pool.
+    // The counters are shared by the pools of all threads.
+    const CacheStats& getStats() const { return getSharedStats(); }
+    static void resetStats() { getSharedStats().reset(); }
+
+    ~ICULineBreakerPoolImpl();
+
+protected:
+    // protected for testing purposes.
+    ICULineBreakerPoolImpl(){};  // one per thread, see getInstance().
+
 private:
-    std::list<Slot> mPool GUARDED_BY(mMutex);
+    static CacheStats& getSharedStats();
+
+    // The pool is only used by its own thread unless a WordBreaker is handed over to another
+    // thread, so the lock is practically never contended.
+    std::unordered_map<uint64_t, std::vector<IcuUbrkUniquePtr>> mBuckets GUARDED_BY(mMutex);
+    size_t mPoolSize GUARDED_BY(mMutex) = 0;
     mutable std::mutex mMutex;
 };
 
@@ -127,8 +153,17 @@ protected:
     // Caller must release the pool.
     WordBreaker(ICULineBreakerPool* pool);
 
+    // protected for testing purpose.
+    // Spans of plain Latin text are broken without asking ICU unless this is disabled.
+    void setLatinFastPathEnabled(bool enabled) { mUseLatinFastPath = enabled; }
+
 private:
     int32_t iteratorNext();
+    // Returns where the email address / URL scan started at the position ends, with
+    // EMAIL_OR_URL_BIT set if it finds one.
+    uint32_t scanEmailOrUrl(size_t start) const;
+    // Fills mScanResults with the scans started at each position.
+    void scanEmailsAndUrls();
     void detectEmailOrUrl();
     ssize_t findNextBreakInEmailOrUrl();
 
@@ -146,6 +181,13 @@ private:
     // state for the email address / url detector
     ssize_t mScanOffset;
     bool mInEmailOrUrl;
+    // For each offset, the scanEmailOrUrl() result of the offset. Only built for the texts of at
+    // least kMinScanTableLength code units once the detection restarts inside the text, since
+    // the scans of a single pass never overlap, and empty otherwise.
+    std::vector<uint32_t> mScanResults;
+    static constexpr size_t kMinScanTableLength = 1024;
+
+    bool mUseLatinFastPath = true;
 };
 
 }  // namespace minikin
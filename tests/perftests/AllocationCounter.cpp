@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace minikin {
+
+namespace {
+
+thread_local uint64_t gAllocationCount = 0;
+
+void* countedAlloc(size_t size) {
+    gAllocationCount++;
+    // malloc(0) may return nullptr, which operator new must not.
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+}  // namespace
+
+uint64_t getAllocationCount() {
+    return gAllocationCount;
+}
+
+}  // namespace minikin
+
+void* operator new(size_t size) {
+    return minikin::countedAlloc(size);
+}
+
+void* operator new[](size_t size) {
+    return minikin::countedAlloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    minikin::gAllocationCount++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    minikin::gAllocationCount++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
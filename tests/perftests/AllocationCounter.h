@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PERFTESTS_ALLOCATION_COUNTER_H
+#define MINIKIN_PERFTESTS_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+namespace minikin {
+
+// Returns the number of operator new calls made by the calling thread so far. minikin_perftests
+// replaces the global operator new to count them. The allocations done with malloc, e.g. by
+// HarfBuzz and ICU, are not counted.
+uint64_t getAllocationCount();
+
+// Returns the number of allocations done by the calling thread while running f.
+template <typename F>
+uint64_t countAllocations(F f) {
+    const uint64_t before = getAllocationCount();
+    f();
+    return getAllocationCount() - before;
+}
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PERFTESTS_ALLOCATION_COUNTER_H
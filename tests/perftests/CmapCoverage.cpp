@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CmapCoverage.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hb.h>
+
+#include "minikin/HbUtils.h"
+#include "minikin/MinikinFont.h"
+#include "minikin/SparseBitSet.h"
+
+#include "FreeTypeMinikinFontForTest.h"
+#include "MinikinInternal.h"
+#include "PathUtils.h"
+
+namespace minikin {
+
+// Returns a copy of the cmap table of the font.
+static std::vector<uint8_t> readCmapTable(const std::string& path, int index) {
+    FreeTypeMinikinFontForTest font(path, index);
+    HbBlobUniquePtr blob(hb_blob_create(reinterpret_cast<const char*>(font.GetFontData()),
+                                        font.GetFontSize(), HB_MEMORY_MODE_READONLY, nullptr,
+                                        nullptr));
+    HbFaceUniquePtr face(hb_face_create(blob.get(), index));
+    HbBlob cmap(face, MinikinFont::MakeTag('c', 'm', 'a', 'p'));
+    return std::vector<uint8_t>(cmap.get(), cmap.get() + cmap.size());
+}
+
+static void BM_CmapCoverage_getCoverage(benchmark::State& state, const std::string& path) {
+    const std::vector<uint8_t> cmap = readCmapTable(path, 0);
+    std::vector<std::unique_ptr<SparseBitSet>> vsCoverage;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(CmapCoverage::getCoverage(cmap.data(), cmap.size(), &vsCoverage));
+    }
+}
+
+BENCHMARK_CAPTURE(BM_CmapCoverage_getCoverage, Ascii, getTestFontPath("Ascii.ttf"));
+BENCHMARK_CAPTURE(BM_CmapCoverage_getCoverage, Emoji, getTestFontPath("Emoji.ttf"));
+BENCHMARK_CAPTURE(BM_CmapCoverage_getCoverage, VariationSelector,
+                  getTestFontPath("VariationSelectorTest-Regular.ttf"));
+BENCHMARK_CAPTURE(BM_CmapCoverage_getCoverage, CJK,
+                  std::string("/system/fonts/NotoSansCJK-Regular.ttc"));
+
+}  // namespace minikin
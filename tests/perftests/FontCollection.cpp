@@ -29,8 +29,8 @@
 
 namespace minikin {
 
-const char* SYSTEM_FONT_PATH = "/system/fonts/";
-const char* SYSTEM_FONT_XML = "/system/etc/fonts.xml";
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
 
 static void BM_FontCollection_construct(benchmark::State& state) {
     std::vector<std::shared_ptr<FontFamily>> families =
@@ -42,6 +42,17 @@ static void BM_FontCollection_construct(benchmark::State& state) {
 
 BENCHMARK(BM_FontCollection_construct);
 
+static void BM_FontCollection_construct_parallel(benchmark::State& state) {
+    std::vector<std::shared_ptr<FontFamily>> families =
+            getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML);
+    const uint32_t threadCount = state.range(0);
+    while (state.KeepRunning()) {
+        std::make_shared<FontCollection>(families, threadCount);
+    }
+}
+
+BENCHMARK(BM_FontCollection_construct_parallel)->Arg(1)->Arg(2)->Arg(4);
+
 static void BM_FontCollection_hasVariationSelector(benchmark::State& state) {
     auto collection =
             std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML));
@@ -77,6 +88,8 @@ struct ItemizeTestCases {
         {"'A' 'n' U+0E1A U+0E31 U+0645 U+062D U+0648", "en", "Mixture of English, Thai and Arabic"},
         {"U+2708 U+FE0E", "en", "Emoji with variation selector"},
         {"U+0031 U+FE0F U+20E3", "en", "KEYCAP"},
+        {"U+1F469 U+200D U+1F469 U+200D U+1F467", "en", "Emoji ZWJ sequence"},
+        {"U+1F1FA U+1F1F8 U+1F1EF U+1F1F5", "en", "Emoji flags"},
 };
 
 static void BM_FontCollection_itemize(benchmark::State& state) {
@@ -102,6 +115,15 @@ static void BM_FontCollection_itemize(benchmark::State& state) {
 }
 
 // TODO: Rewrite with BENCHMARK_CAPTURE once it is available in Android.
-BENCHMARK(BM_FontCollection_itemize)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(4)->Arg(5)->Arg(6);
+BENCHMARK(BM_FontCollection_itemize)
+        ->Arg(0)
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(3)
+        ->Arg(4)
+        ->Arg(5)
+        ->Arg(6)
+        ->Arg(7)
+        ->Arg(8);
 
 }  // namespace minikin
@@ -40,4 +40,11 @@ static void BM_Locale_en_Latn_US_u_em_emoji(benchmark::State& state) {
 }
 BENCHMARK(BM_Locale_en_Latn_US_u_em_emoji);
 
+static void BM_Locale_ja_JP_u_ca_japanese_lb_strict_em_text(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        Locale language(StringPiece("ja-JP-u-ca-japanese-lb-strict-em-text", 37));
+    }
+}
+BENCHMARK(BM_Locale_ja_JP_u_ca_japanese_lb_strict_em_text);
+
 }  // namespace minikin
@@ -77,4 +77,32 @@ BENCHMARK(BM_GraphemeBreak_Emoji_Flags)
         ->Arg(4)    // After flag sequence. Here is boundary of grapheme cluster.
         ->Arg(10);  // Middle of 3rd flag sequence.
 
+const char* MIXED_TEST_STR =
+        "'L' 'o' 'r' 'e' 'm' ' ' U+0915 U+094D U+0915 U+093F ' ' U+261D U+1F3FD ' ' U+1F469 U+200D "
+        "U+1F4BB ' ' U+1F1FA U+1F1F8 ' ' U+AC00 U+1100 U+1161 U+11A8 ' ' 'e' U+0301 '.'";
+
+static void BM_GraphemeBreak_EveryOffset(benchmark::State& state) {
+    size_t result_size;
+    uint16_t buffer[64];
+    ParseUnicode(buffer, 64, MIXED_TEST_STR, &result_size, nullptr);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i <= result_size; i++) {
+            benchmark::DoNotOptimize(
+                    GraphemeBreak::isGraphemeBreak(nullptr, buffer, 0, result_size, i));
+        }
+    }
+}
+BENCHMARK(BM_GraphemeBreak_EveryOffset);
+
+static void BM_GraphemeBreak_ComputeGraphemeBreaks(benchmark::State& state) {
+    size_t result_size;
+    uint16_t buffer[64];
+    ParseUnicode(buffer, 64, MIXED_TEST_STR, &result_size, nullptr);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(
+                GraphemeBreak::computeGraphemeBreaks(nullptr, buffer, 0, result_size));
+    }
+}
+BENCHMARK(BM_GraphemeBreak_ComputeGraphemeBreaks);
+
 }  // namespace minikin
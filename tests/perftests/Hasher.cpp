@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Hasher.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace minikin {
+
+template <typename H>
+static void BM_updateShorts(benchmark::State& state) {
+    const std::vector<uint16_t> text(state.range(0), 'a');
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(H().updateShorts(text.data(), text.size()).hash());
+    }
+}
+
+// Roughly the fields of a MinikinPaint and a LayoutCacheKey.
+template <typename H>
+static void BM_updateScalars(benchmark::State& state) {
+    uint32_t value = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(H().update(value)
+                                         .update(12.0f)
+                                         .update(1.0f)
+                                         .update(0.0f)
+                                         .update(0.0f)
+                                         .update(value >> 8)
+                                         .update(5)
+                                         .update(0)
+                                         .update(42)
+                                         .hash());
+        value++;
+    }
+}
+
+static void BM_Hasher_updateShorts(benchmark::State& state) {
+    BM_updateShorts<Hasher>(state);
+}
+BENCHMARK(BM_Hasher_updateShorts)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_WideHasher_updateShorts(benchmark::State& state) {
+    BM_updateShorts<WideHasher>(state);
+}
+BENCHMARK(BM_WideHasher_updateShorts)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_Hasher_updateScalars(benchmark::State& state) {
+    BM_updateScalars<Hasher>(state);
+}
+BENCHMARK(BM_Hasher_updateScalars);
+
+static void BM_WideHasher_updateScalars(benchmark::State& state) {
+    BM_updateScalars<WideHasher>(state);
+}
+BENCHMARK(BM_WideHasher_updateScalars);
+
+}  // namespace minikin
@@ -15,9 +15,13 @@
  */
 #include "minikin/Hyphenator.h"
 
+#include <unistd.h>
+
 #include <benchmark/benchmark.h>
 
 #include "FileUtils.h"
+#include "HybUtils.h"
+#include "LineBreakerUtil.h"
 #include "UnicodeUtils.h"
 
 namespace minikin {
@@ -26,9 +30,17 @@ const char* enUsHyph = "/system/usr/hyphen-data/hyph-en-us.hyb";
 const int enUsMinPrefix = 2;
 const int enUsMinSuffix = 3;
 
+// The hyb files are only on a device. On host, the hyphenation benchmarks are skipped.
+static Hyphenator* loadEnUsOrSkip(benchmark::State& state) {
+    Hyphenator* hyphenator = Hyphenator::loadFromFile(enUsHyph, enUsMinPrefix, enUsMinSuffix, "en");
+    if (hyphenator == nullptr) {
+        state.SkipWithError("No hyphenation pattern file");
+    }
+    return hyphenator;
+}
+
 static void BM_Hyphenator_short_word(benchmark::State& state) {
-    Hyphenator* hyphenator = Hyphenator::loadBinary(readWholeFile(enUsHyph).data(), enUsMinPrefix,
-                                                    enUsMinSuffix, "en");
+    Hyphenator* hyphenator = loadEnUsOrSkip(state);
     std::vector<uint16_t> word = utf8ToUtf16("hyphen");
     std::vector<HyphenationType> result;
     while (state.KeepRunning()) {
@@ -40,8 +52,7 @@ static void BM_Hyphenator_short_word(benchmark::State& state) {
 BENCHMARK(BM_Hyphenator_short_word);
 
 static void BM_Hyphenator_long_word(benchmark::State& state) {
-    Hyphenator* hyphenator = Hyphenator::loadBinary(readWholeFile(enUsHyph).data(), enUsMinPrefix,
-                                                    enUsMinSuffix, "en");
+    Hyphenator* hyphenator = loadEnUsOrSkip(state);
     std::vector<uint16_t> word = utf8ToUtf16("Pneumonoultramicroscopicsilicovolcanoconiosis");
     std::vector<HyphenationType> result;
     while (state.KeepRunning()) {
@@ -52,6 +63,67 @@ static void BM_Hyphenator_long_word(benchmark::State& state) {
 // TODO: Use BENCHMARK_CAPTURE for parametrise.
 BENCHMARK(BM_Hyphenator_long_word);
 
+static void BM_Hyphenator_trieVersion(benchmark::State& state, const char* hybPath,
+                                      const char* locale, const char* text, int trieVersion) {
+    if (access(hybPath, R_OK) != 0) {
+        state.SkipWithError("No hyphenation pattern file");
+        return;
+    }
+    std::vector<uint8_t> patternData = readWholeFile(hybPath);
+    if (trieVersion == 1) {
+        patternData = convertToTrieVersion1(patternData);
+    }
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 2, locale);
+    std::vector<uint16_t> word = utf8ToUtf16(text);
+    std::vector<HyphenationType> result;
+    while (state.KeepRunning()) {
+        hyphenator->hyphenate(word, &result);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, en_v0, enUsHyph, "en", "hyphenation", 0);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, en_v1, enUsHyph, "en", "hyphenation", 1);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, de_v0, "/system/usr/hyphen-data/hyph-de-1996.hyb",
+                  "de", "Silbentrennungsalgorithmus", 0);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, de_v1, "/system/usr/hyphen-data/hyph-de-1996.hyb",
+                  "de", "Silbentrennungsalgorithmus", 1);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, ru_v0, "/system/usr/hyphen-data/hyph-ru.hyb", "ru",
+                  "переносслов", 0);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, ru_v1, "/system/usr/hyphen-data/hyph-ru.hyb", "ru",
+                  "переносслов", 1);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, hi_v0, "/system/usr/hyphen-data/hyph-hi.hyb", "hi",
+                  "अनुच्छेद", 0);
+BENCHMARK_CAPTURE(BM_Hyphenator_trieVersion, hi_v1, "/system/usr/hyphen-data/hyph-hi.hyb", "hi",
+                  "अनुच्छेद", 1);
+
+// Hyphenates a paragraph word by word, as the line breakers do. Words are joined with NBSP so
+// that the helper has to find the word boundaries.
+static void BM_Hyphenator_paragraph(benchmark::State& state) {
+    Hyphenator* hyphenator = loadEnUsOrSkip(state);
+    std::string text;
+    for (int i = 0; i < 20; ++i) {
+        text += "Hyphenation\u00A0is\u00A0the\u00A0process\u00A0of\u00A0breaking\u00A0words ";
+    }
+    const std::vector<uint16_t> paragraph = utf8ToUtf16(text);
+    std::vector<Range> words;
+    uint32_t start = 0;
+    for (uint32_t i = 0; i <= paragraph.size(); ++i) {
+        if (i == paragraph.size() || paragraph[i] == ' ') {
+            words.emplace_back(start, i);
+            start = i + 1;
+        }
+    }
+    std::vector<HyphenationType> out(paragraph.size());
+    const U16StringPiece textBuf(paragraph);
+    while (state.KeepRunning()) {
+        for (const Range& word : words) {
+            hyphenate(textBuf.substr(word), *hyphenator, out.data() + word.getStart());
+        }
+    }
+}
+
+BENCHMARK(BM_Hyphenator_paragraph);
+
 // TODO: Add more tests for other languages.
 
 }  // namespace minikin
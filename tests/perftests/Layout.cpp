@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Layout.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <unicode/utf16.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/MinikinPaint.h"
+
+#include "AllocationCounter.h"
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+// The fonts are the ones in the test data, so that the benchmarks run on host as well. They have
+// no Arabic or Devanagari glyphs, so those texts are laid out with .notdef and mostly measure the
+// bidi, itemization and cache costs. BM_LayoutPiece_longRun covers the shaping with system fonts.
+// The "allocs" counter of the benchmarks is the number of heap allocations of one layout.
+const char* kTexts[] = {
+        "The quick brown fox jumps over the lazy dog. ",
+        "あいうえお花葛侮忍骨臭",
+        "مرحبا بالعالم كيف حالك؟ ",
+        "नमस्ते दुनिया कैसे हो? ",
+        "\U0001F467\U0001F469\u200D\U0001F467\U0001F470 ",
+};
+const char* kLabels[] = {"Latin", "CJK", "Arabic", "Devanagari", "Emoji"};
+constexpr int kScriptCount = sizeof(kTexts) / sizeof(kTexts[0]);
+constexpr int kLengths[] = {16, 128, 1024};
+
+const MinikinPaint& getPaint() {
+    static MinikinPaint* paint = [] {
+        std::vector<std::shared_ptr<FontFamily>> families = {
+                buildFontFamily("Ascii.ttf"), buildFontFamily("Ja.ttf", "ja-JP"),
+                buildFontFamily("Emoji.ttf", "und-Zsye"), buildFontFamily("Arabic.ttf", "ar")};
+        auto* p = new MinikinPaint(std::make_shared<FontCollection>(std::move(families)));
+        p->size = 10.0f;
+        return p;
+    }();
+    return *paint;
+}
+
+// Repeats the sentence up to the length in code units, without splitting a surrogate pair.
+std::vector<uint16_t> buildText(const char* sentence, size_t length, bool stripSpaces = false) {
+    std::vector<uint16_t> piece = utf8ToUtf16(sentence);
+    if (stripSpaces) {
+        piece.erase(std::remove(piece.begin(), piece.end(), ' '), piece.end());
+    }
+    std::vector<uint16_t> text;
+    while (text.size() < length) {
+        text.insert(text.end(), piece.begin(), piece.end());
+    }
+    text.resize(length);
+    if (U16_IS_LEAD(text.back())) {
+        text.back() = ' ';
+    }
+    return text;
+}
+
+float layOut(const std::vector<uint16_t>& text, const MinikinPaint& paint) {
+    Layout layout(text, Range(0, text.size()), Bidi::DEFAULT_LTR, paint, StartHyphenEdit::NO_EDIT,
+                  EndHyphenEdit::NO_EDIT);
+    return layout.getAdvance();
+}
+
+void scriptsAndLengths(benchmark::internal::Benchmark* b) {
+    for (int script = 0; script < kScriptCount; ++script) {
+        for (int length : kLengths) {
+            b->Args({script, length});
+        }
+    }
+}
+
+void setLabel(benchmark::State& state) {
+    state.SetLabel(std::string(kLabels[state.range(0)]) + "/" + std::to_string(state.range(1)));
+}
+
+}  // namespace
+
+// Lays out text whose words are all in the layout cache, as when a view is drawn again.
+static void BM_Layout_hit(benchmark::State& state) {
+    const std::vector<uint16_t> text = buildText(kTexts[state.range(0)], state.range(1));
+    const MinikinPaint& paint = getPaint();
+    layOut(text, paint);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(layOut(text, paint));
+    }
+    state.counters["allocs"] = countAllocations([&] { layOut(text, paint); });
+    setLabel(state);
+}
+
+BENCHMARK(BM_Layout_hit)->Apply(scriptsAndLengths);
+
+// Lays out text with an empty layout cache, as for text seen for the first time. The cache is
+// cleared outside of the timing, so this is the cost of shaping and inserting every word.
+static void BM_Layout_miss(benchmark::State& state) {
+    const std::vector<uint16_t> text = buildText(kTexts[state.range(0)], state.range(1));
+    const MinikinPaint& paint = getPaint();
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        LayoutCache::getInstance().clear();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(layOut(text, paint));
+    }
+    LayoutCache::getInstance().clear();
+    state.counters["allocs"] = countAllocations([&] { layOut(text, paint); });
+    setLabel(state);
+}
+
+BENCHMARK(BM_Layout_miss)->Apply(scriptsAndLengths);
+
+// Lays out a run without word breaks of LENGTH_LIMIT_LONG_CACHE code units, which is too long
+// to be cached and is shaped on every call. CJK and emoji are left out since every character of
+// them is a word break for the cache.
+static void BM_Layout_skipCache(benchmark::State& state) {
+    const std::vector<uint16_t> text =
+            buildText(kTexts[state.range(0)], LENGTH_LIMIT_LONG_CACHE, true /* stripSpaces */);
+    const MinikinPaint& paint = getPaint();
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(layOut(text, paint));
+    }
+    state.counters["allocs"] = countAllocations([&] { layOut(text, paint); });
+    state.SetLabel(kLabels[state.range(0)]);
+}
+
+BENCHMARK(BM_Layout_skipCache)->Arg(0)->Arg(2)->Arg(3);
+
+// Measures text with a warm cache from several threads at once, so that the threads contend on
+// the shard locks of the global cache for every word.
+static void BM_Layout_measureTextContended(benchmark::State& state) {
+    const std::vector<uint16_t> text = buildText(kTexts[state.range(0)], 128);
+    const MinikinPaint& paint = getPaint();
+    const Range range(0, text.size());
+    std::vector<float> advances(text.size());
+    Layout::measureText(text, range, Bidi::DEFAULT_LTR, paint, StartHyphenEdit::NO_EDIT,
+                        EndHyphenEdit::NO_EDIT, advances.data());
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(Layout::measureText(text, range, Bidi::DEFAULT_LTR, paint,
+                                                     StartHyphenEdit::NO_EDIT,
+                                                     EndHyphenEdit::NO_EDIT, advances.data()));
+    }
+    state.SetLabel(kLabels[state.range(0)]);
+}
+
+BENCHMARK(BM_Layout_measureTextContended)
+        ->Arg(0)
+        ->Arg(1)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+}  // namespace minikin
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCache.h"
+
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+
+namespace minikin {
+
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+namespace {
+
+class BenchmarkLayoutCache : public LayoutCache {
+public:
+    BenchmarkLayoutCache() : LayoutCache(5000, 16) {}
+};
+
+struct NoopCallback {
+    void operator()(const LayoutPiece& layout, const MinikinPaint& /* paint */) {
+        benchmark::DoNotOptimize(layout.advance());
+    }
+};
+
+std::unique_ptr<BenchmarkLayoutCache> gCache;
+std::unique_ptr<MinikinPaint> gPaint;
+
+// Returns a word which is unique for the iteration, so that every iteration is a miss for the
+// first thread reaching it, while the other threads look up the same word at about the same time.
+std::vector<uint16_t> wordForIteration(size_t iteration) {
+    const std::string digits = std::to_string(iteration);
+    std::vector<uint16_t> word;
+    for (char c : digits) {
+        word.push_back('a' + (c - '0'));
+    }
+    return word;
+}
+
+// Returns the index-th word of a trace scrolling through a long list of names at the bottom of a
+// screen with a fixed UI: one word out of four is one of the kHotWords reused words, the others
+// are only seen once. The reused words come back every 4 * kHotWords lookups, which is longer
+// than the LRU lifetime of an entry in a cache of 5000 entries.
+constexpr size_t kHotWords = 2000;
+std::vector<uint16_t> wordForScan(size_t index) {
+    if (index % 4 == 0) {
+        std::vector<uint16_t> word = wordForIteration((index / 4) % kHotWords);
+        for (uint16_t& c : word) {
+            c += 'A' - 'a';
+        }
+        return word;
+    }
+    return wordForIteration(index);
+}
+
+}  // namespace
+
+// Many threads lay out the same new words at the same time, as happens when a new screen is
+// inflated. The "shapes" counter is the number of shaping done per looked up word. It is close to
+// the thread count without single flight and close to 1 with it.
+static void BM_LayoutCache_contendedMiss(benchmark::State& state) {
+    const bool singleFlight = state.range(0) != 0;
+    if (state.thread_index() == 0) {
+        gCache = std::make_unique<BenchmarkLayoutCache>();
+        gCache->setSingleFlight(singleFlight);
+        gPaint = std::make_unique<MinikinPaint>(
+                std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+        gPaint->size = 10.0f;
+    }
+
+    NoopCallback callback;
+    size_t iteration = 0;
+    while (state.KeepRunning()) {
+        std::vector<uint16_t> word = wordForIteration(iteration++);
+        gCache->getOrCreate(word, Range(0, word.size()), *gPaint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, callback);
+    }
+
+    if (state.thread_index() == 0) {
+        const CacheStats& stats = gCache->getStats();
+        const uint64_t words = iteration;
+        state.counters["shapes"] = words == 0 ? 0.0 : static_cast<double>(stats.misses()) / words;
+        state.SetLabel(singleFlight ? "single flight" : "default");
+    }
+}
+
+BENCHMARK(BM_LayoutCache_contendedMiss)->Arg(0)->Arg(1)->Threads(8)->UseRealTime();
+
+// Lays out a trace of reused words mixed with words seen once. The "hitRate" counter is the ratio
+// of the lookups served from the cache, with plain LRU eviction and with the frequency admission.
+static void BM_LayoutCache_scanResistance(benchmark::State& state) {
+    const bool admission = state.range(0) != 0;
+    BenchmarkLayoutCache cache;
+    cache.setFrequencyAdmission(admission);
+    MinikinPaint paint(
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+    paint.size = 10.0f;
+
+    NoopCallback callback;
+    size_t index = 0;
+    while (state.KeepRunning()) {
+        std::vector<uint16_t> word = wordForScan(index++);
+        cache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, callback);
+    }
+
+    const CacheStats& stats = cache.getStats();
+    state.counters["hitRate"] = index == 0 ? 0.0 : static_cast<double>(stats.hits()) / index;
+    state.SetLabel(admission ? "frequency admission" : "LRU");
+}
+
+BENCHMARK(BM_LayoutCache_scanResistance)->Arg(0)->Arg(1)->Iterations(100000);
+
+}  // namespace minikin
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCore.h"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/MinikinPaint.h"
+
+#include "AllocationCounter.h"
+#include "FontTestUtils.h"
+#include "GlyphPositions.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+namespace {
+
+const char* kTexts[] = {
+        "The quick brown fox jumps over the lazy dog. ",
+        "नमस्ते दुनिया कैसे हो? ",
+        "مرحبا بالعالم كيف حالك؟ ",
+};
+const char* kLabels[] = {"Latin", "Devanagari", "Arabic"};
+
+// Repeats the sentence into a run of about 1000 code units.
+std::vector<uint16_t> longRun(const char* sentence) {
+    std::string text;
+    while (text.size() < 1000) {
+        text += sentence;
+    }
+    return utf8ToUtf16(text);
+}
+
+}  // namespace
+
+// Shapes long runs of text without the layout cache. The conversion of the HarfBuzz positions is
+// a part of every LayoutPiece construction. "allocs" is the number of heap allocations of one
+// piece.
+static void BM_LayoutPiece_longRun(benchmark::State& state) {
+    const int index = state.range(0);
+    MinikinPaint paint(
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+    paint.size = 10.0f;
+    const std::vector<uint16_t> text = longRun(kTexts[index]);
+    const bool isRtl = index == 2;
+
+    auto shape = [&] {
+        LayoutPiece piece(text, Range(0, text.size()), isRtl, paint, StartHyphenEdit::NO_EDIT,
+                          EndHyphenEdit::NO_EDIT);
+        return piece.advance();
+    };
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(shape());
+    }
+    state.counters["allocs"] = countAllocations(shape);
+    state.SetLabel(kLabels[index]);
+}
+
+BENCHMARK(BM_LayoutPiece_longRun)->Arg(0)->Arg(1)->Arg(2);
+
+// Converts the positions of 1000 glyphs with the SIMD path (1) and the scalar path (0).
+static void BM_GlyphPositions_convert(benchmark::State& state) {
+    const bool simd = state.range(0) != 0;
+    constexpr uint32_t kCount = 1000;
+    std::mt19937 mt(0);
+    std::uniform_int_distribution<hb_position_t> dist(-10000, 10000);
+    std::vector<hb_glyph_position_t> positions(kCount);
+    for (hb_glyph_position_t& position : positions) {
+        position.x_advance = dist(mt);
+        position.x_offset = dist(mt);
+        position.y_offset = dist(mt);
+    }
+    std::vector<float> xAdvances(kCount), xOffsets(kCount), yOffsets(kCount);
+
+    while (state.KeepRunning()) {
+        if (simd) {
+            convertGlyphPositions(positions.data(), kCount, -0.25f, xAdvances.data(),
+                                  xOffsets.data(), yOffsets.data());
+        } else {
+            convertGlyphPositionsScalar(positions.data(), kCount, -0.25f, xAdvances.data(),
+                                        xOffsets.data(), yOffsets.data());
+        }
+        benchmark::DoNotOptimize(xOffsets.data());
+    }
+    state.SetLabel(simd ? "simd" : "scalar");
+}
+
+BENCHMARK(BM_GlyphPositions_convert)->Arg(0)->Arg(1);
+
+}  // namespace minikin
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LineBreaker.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/MeasuredText.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+namespace {
+
+class ConstantLineWidth : public LineWidth {
+public:
+    explicit ConstantLineWidth(float width) : mWidth(width) {}
+    float getAt(size_t) const override { return mWidth; }
+    float getMin() const override { return mWidth; }
+
+private:
+    float mWidth;
+};
+
+// Repeats a sentence into a paragraph of about 12000 words, each of them a break candidate.
+std::vector<uint16_t> longParagraph() {
+    const char* kSentence = "The quick brown fox jumps over the lazy dog. ";
+    std::string text;
+    for (int i = 0; i < 1300; i++) {
+        text += kSentence;
+    }
+    return utf8ToUtf16(text);
+}
+
+}  // namespace
+
+// Breaks a paragraph with 10k+ candidates with the optimal line breaker. The first argument is the
+// line width in pixels: wide lines can hold many candidates, which is the slow case for the
+// dynamic programming. The second argument enables justification.
+static void BM_LineBreaker_optimalLongParagraph(benchmark::State& state) {
+    const std::vector<uint16_t> text = longParagraph();
+    MinikinPaint paint(
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+    paint.size = 10.0f;
+    MeasuredTextBuilder builder;
+    builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+    std::unique_ptr<MeasuredText> measured = builder.build(
+            text, false /* compute hyphenation */, false /* compute full layout */, nullptr);
+
+    const ConstantLineWidth lineWidth(state.range(0));
+    const TabStops tabStops(nullptr, 0, 10);
+    const bool justified = state.range(1) != 0;
+    while (state.KeepRunning()) {
+        LineBreakResult result = breakIntoLines(text, BreakStrategy::HighQuality,
+                                                HyphenationFrequency::None, justified, *measured,
+                                                lineWidth, tabStops);
+        benchmark::DoNotOptimize(result.breakPoints.data());
+    }
+}
+
+BENCHMARK(BM_LineBreaker_optimalLongParagraph)
+        ->Args({500, 0})
+        ->Args({500, 1})
+        ->Args({50000, 0})
+        ->Args({50000, 1});
+
+// Breaks 64 paragraphs of about 200 words at once. The argument is the maximum number of
+// threads.
+static void BM_LineBreaker_parallelParagraphs(benchmark::State& state) {
+    MinikinPaint paint(
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+    paint.size = 10.0f;
+    std::string paragraph;
+    for (int i = 0; i < 20; i++) {
+        paragraph += "The quick brown fox jumps over the lazy dog. ";
+    }
+    const std::vector<uint16_t> text = utf8ToUtf16(paragraph);
+    std::vector<std::unique_ptr<MeasuredText>> measuredTexts;
+    for (int i = 0; i < 64; i++) {
+        MeasuredTextBuilder builder;
+        builder.addStyleRun(0, text.size(), MinikinPaint(paint), false /* is RTL */);
+        measuredTexts.push_back(builder.build(text, false /* compute hyphenation */,
+                                              false /* compute full layout */, nullptr));
+    }
+
+    const ConstantLineWidth lineWidth(500);
+    const TabStops tabStops(nullptr, 0, 10);
+    std::vector<LineBreakJob> jobs;
+    for (const std::unique_ptr<MeasuredText>& measured : measuredTexts) {
+        jobs.push_back({text, measured.get(), &lineWidth, &tabStops});
+    }
+    while (state.KeepRunning()) {
+        std::vector<LineBreakResult> results =
+                breakIntoLines(jobs, BreakStrategy::HighQuality, HyphenationFrequency::None,
+                               false /* justified */, state.range(0));
+        benchmark::DoNotOptimize(results.data());
+    }
+}
+
+BENCHMARK(BM_LineBreaker_parallelParagraphs)->Arg(1)->Arg(4);
+
+}  // namespace minikin
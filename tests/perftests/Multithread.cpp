@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/BoundsCache.h"
+#include "minikin/FontCollection.h"
+#include "minikin/Layout.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/LocaleList.h"
+#include "minikin/Measurement.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "Locale.h"
+#include "LocaleListCache.h"
+#include "WordBreaker.h"
+
+namespace minikin {
+
+namespace {
+
+constexpr int kMaxCollectionCount = 8;
+constexpr int kWordsInParagraph = 10;
+constexpr int kSharedVocabularySize = 100;
+const char* kLocales[] = {"en-US", "en-GB", "de-DE", "fr-FR"};
+
+const std::vector<std::shared_ptr<FontCollection>>& getCollections() {
+    static auto* collections = [] {
+        auto* result = new std::vector<std::shared_ptr<FontCollection>>();
+        for (int i = 0; i < kMaxCollectionCount; ++i) {
+            result->push_back(buildFontCollection("Ascii.ttf"));
+        }
+        return result;
+    }();
+    return *collections;
+}
+
+// Appends a 3-letter upper case word out of a small vocabulary, which all threads look up.
+void appendSharedWord(std::mt19937* mt, std::vector<uint16_t>* text) {
+    const int word = std::uniform_int_distribution<int>(0, kSharedVocabularySize - 1)(*mt);
+    text->push_back('A' + word % 26);
+    text->push_back('A' + (word / 26) % 26);
+    text->push_back('A');
+}
+
+// Appends a lower case word which no other thread or paragraph uses.
+void appendUniqueWord(int threadIndex, uint64_t* counter, std::vector<uint16_t>* text) {
+    text->push_back('a' + threadIndex % 26);
+    for (uint64_t n = (*counter)++; n != 0; n /= 26) {
+        text->push_back('a' + n % 26);
+    }
+}
+
+void resetStats() {
+    LayoutCache::getInstance().resetStats();
+    BoundsCache::getInstance().resetStats();
+    LocaleListCache::resetStats();
+    ICULineBreakerPoolImpl::resetStats();
+}
+
+}  // namespace
+
+// The workload of the MultithreadTest stress test as a scaling benchmark. Every iteration lays out,
+// measures the bounds of and word breaks a paragraph of 3-letter words with a paint of one of the
+// font collections and locales. The arguments are the percentage of the words shared by all
+// threads, the others being unique, and the number of font collections.
+//
+// "paragraphs" is the throughput per thread, which stays flat as long as the threads scale. The
+// "*_wait_ns" counters are the average time per paragraph spent waiting for the lock of a cache.
+static void BM_Multithread_layout(benchmark::State& state) {
+    const int sharedPercent = state.range(0);
+    const int collectionCount = state.range(1);
+    const std::vector<std::shared_ptr<FontCollection>>& collections = getCollections();
+    if (state.thread_index() == 0) {
+        Layout::purgeCaches();
+        resetStats();
+    }
+
+    std::mt19937 mt(state.thread_index());
+    std::uniform_int_distribution<int> percent(0, 99);
+    uint64_t uniqueCounter = 0;
+    uint64_t iteration = 0;
+    std::vector<uint16_t> text;
+    WordBreaker breaker;
+    while (state.KeepRunning()) {
+        MinikinPaint paint(collections[iteration % collectionCount]);
+        paint.size = 10.0f;
+        const char* locale = kLocales[iteration % 4];
+        paint.localeListId = registerLocaleList(locale);
+        iteration++;
+
+        text.clear();
+        for (int i = 0; i < kWordsInParagraph; ++i) {
+            if (i != 0) {
+                text.push_back(' ');
+            }
+            if (percent(mt) < sharedPercent) {
+                appendSharedWord(&mt, &text);
+            } else {
+                appendUniqueWord(state.thread_index(), &uniqueCounter, &text);
+            }
+        }
+        const Range range(0, text.size());
+
+        Layout layout(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                      EndHyphenEdit::NO_EDIT);
+        benchmark::DoNotOptimize(layout.getAdvance());
+        MinikinRect rect;
+        getBounds(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                  &rect);
+        benchmark::DoNotOptimize(rect);
+
+        breaker.setText(text.data(), text.size());
+        breaker.followingWithLocale(Locale(locale), 0);
+        while (breaker.next() != -1) {
+        }
+        breaker.finish();
+    }
+
+    state.counters["paragraphs"] =
+            benchmark::Counter(state.iterations(), benchmark::Counter::kAvgThreadsRate);
+    if (state.thread_index() == 0) {
+        const double paragraphs = static_cast<double>(state.iterations()) * state.threads();
+        auto waitPerParagraph = [paragraphs](const CacheStats& stats) {
+            return paragraphs == 0 ? 0.0 : stats.lockWaitNanos() / paragraphs;
+        };
+        state.counters["LayoutCache_wait_ns"] =
+                waitPerParagraph(LayoutCache::getInstance().getStats());
+        state.counters["BoundsCache_wait_ns"] =
+                waitPerParagraph(BoundsCache::getInstance().getStats());
+        state.counters["LocaleListCache_wait_ns"] = waitPerParagraph(LocaleListCache::getStats());
+        state.counters["ICULineBreakerPool_wait_ns"] =
+                waitPerParagraph(ICULineBreakerPoolImpl::getInstance().getStats());
+    }
+}
+
+BENCHMARK(BM_Multithread_layout)
+        ->Args({90, 1})
+        ->Args({50, 1})
+        ->Args({0, 1})
+        ->Args({50, kMaxCollectionCount})
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
+}  // namespace minikin
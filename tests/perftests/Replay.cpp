@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CallRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/Layout.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/LineBreaker.h"
+#include "minikin/LocaleList.h"
+#include "minikin/MeasuredText.h"
+
+#include "FontTestUtils.h"
+
+namespace minikin {
+
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+extern const char* REPLAY_TRACE;
+
+namespace {
+
+constexpr uint32_t kTypeCount = 4;
+const char* const kTypeLabels[kTypeCount] = {"Layout", "measureText", "build", "breakIntoLines"};
+
+// The recorded widths of the lines, the last one repeating for the lines after it.
+class ReplayLineWidth : public LineWidth {
+public:
+    ReplayLineWidth(const std::vector<float>& widths, float minWidth)
+            : mWidths(widths), mMinWidth(minWidth) {}
+
+    float getAt(size_t lineNo) const override {
+        if (mWidths.empty()) {
+            return mMinWidth;
+        }
+        return mWidths[std::min(lineNo, mWidths.size() - 1)];
+    }
+
+    float getMin() const override { return mMinWidth; }
+
+private:
+    const std::vector<float>& mWidths;
+    const float mMinWidth;
+};
+
+std::vector<uint8_t> readFile(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+// Returns the value below which the given fraction of the sorted values are, in microseconds.
+double getPercentileMicros(const std::vector<uint64_t>& sortedNanos, double fraction) {
+    if (sortedNanos.empty()) {
+        return 0;
+    }
+    const size_t index = std::min(sortedNanos.size() - 1,
+                                  static_cast<size_t>(sortedNanos.size() * fraction));
+    return sortedNanos[index] / 1000.0;
+}
+
+void addPercentiles(benchmark::State& state, const std::string& prefix,
+                    std::vector<uint64_t>* nanos) {
+    std::sort(nanos->begin(), nanos->end());
+    state.counters[prefix + "_p50"] = getPercentileMicros(*nanos, 0.5);
+    state.counters[prefix + "_p90"] = getPercentileMicros(*nanos, 0.9);
+    state.counters[prefix + "_p99"] = getPercentileMicros(*nanos, 0.99);
+}
+
+// Replays the calls of a trace in order with one collection, keeping the measured texts until
+// the last breakIntoLines call using them.
+class Replayer {
+public:
+    Replayer(const std::vector<RecordedCall>& calls, std::shared_ptr<FontCollection> collection)
+            : mCalls(calls), mCollection(std::move(collection)) {
+        for (size_t i = 0; i < calls.size(); i++) {
+            if (calls[i].measuredTextId != 0) {
+                mLastUses[calls[i].measuredTextId] = i;
+            }
+        }
+    }
+
+    // Replays all the calls and appends the time of each replayed call to nanos by type. Returns
+    // the number of breakIntoLines calls skipped, whose measured text was not recorded.
+    uint32_t replay(std::vector<uint64_t> (&nanos)[kTypeCount]) {
+        uint32_t skipped = 0;
+        for (size_t i = 0; i < mCalls.size(); i++) {
+            const RecordedCall& call = mCalls[i];
+            uint64_t elapsed = 0;
+            if (!replayCall(call, &elapsed)) {
+                skipped++;
+                continue;
+            }
+            nanos[static_cast<uint32_t>(call.type)].push_back(elapsed);
+            if (call.measuredTextId != 0 && mLastUses[call.measuredTextId] == i) {
+                mMeasuredTexts.erase(call.measuredTextId);
+            }
+        }
+        mMeasuredTexts.clear();
+        return skipped;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static uint64_t nanosSince(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    bool replayCall(const RecordedCall& call, uint64_t* elapsed) {
+        switch (call.type) {
+            case RecordedCall::Type::kLayout: {
+                const MinikinPaint paint = call.paint.toPaint(mCollection);
+                const Clock::time_point start = Clock::now();
+                Layout layout(call.text, call.range, call.bidiFlags, paint, call.startHyphen,
+                              call.endHyphen);
+                *elapsed = nanosSince(start);
+                benchmark::DoNotOptimize(layout.getAdvance());
+                return true;
+            }
+            case RecordedCall::Type::kMeasureText: {
+                const MinikinPaint paint = call.paint.toPaint(mCollection);
+                const Clock::time_point start = Clock::now();
+                const float advance =
+                        Layout::measureText(call.text, call.range, call.bidiFlags, paint,
+                                            call.startHyphen, call.endHyphen, nullptr);
+                *elapsed = nanosSince(start);
+                benchmark::DoNotOptimize(advance);
+                return true;
+            }
+            case RecordedCall::Type::kMeasuredTextBuild: {
+                std::vector<MinikinPaint> paints;
+                std::vector<uint32_t> localeListIds;
+                for (const RecordedCall::Run& run : call.runs) {
+                    paints.push_back(run.paint.toPaint(mCollection));
+                    localeListIds.push_back(registerLocaleList(run.locales));
+                }
+                const Clock::time_point start = Clock::now();
+                MeasuredTextBuilder builder;
+                for (size_t i = 0; i < call.runs.size(); i++) {
+                    const RecordedCall::Run& run = call.runs[i];
+                    if (run.isReplacement) {
+                        builder.addReplacementRun(run.range.getStart(), run.range.getEnd(),
+                                                  run.width, localeListIds[i]);
+                    } else {
+                        builder.addStyleRun(run.range.getStart(), run.range.getEnd(),
+                                            std::move(paints[i]), run.isRtl);
+                    }
+                }
+                builder.setCompactWidths(call.compactWidths);
+                builder.setKeepWordBreaks(call.keepWordBreaks);
+                builder.setLineBreakCacheSize(call.lineBreakCacheSize);
+                builder.setApproximateHyphenPieces(call.approximateHyphenPieces);
+                std::unique_ptr<MeasuredText> measured =
+                        builder.build(call.text, call.computeHyphenation, call.computeLayout,
+                                      call.lazyHyphenation, nullptr /* hint */, call.maxThreads);
+                *elapsed = nanosSince(start);
+                if (call.measuredTextId != 0) {
+                    mMeasuredTexts[call.measuredTextId] = std::move(measured);
+                }
+                return true;
+            }
+            case RecordedCall::Type::kBreakIntoLines: {
+                auto it = mMeasuredTexts.find(call.measuredTextId);
+                if (it == mMeasuredTexts.end()) {
+                    return false;
+                }
+                const ReplayLineWidth lineWidth(call.lineWidths, call.minLineWidth);
+                const TabStops tabStops(call.tabStops.data(), call.tabStops.size(),
+                                        call.tabWidth);
+                const Clock::time_point start = Clock::now();
+                LineBreakResult result =
+                        breakIntoLines(call.text, call.strategy, call.frequency, call.justified,
+                                       *it->second, lineWidth, tabStops);
+                *elapsed = nanosSince(start);
+                benchmark::DoNotOptimize(result.breakPoints.data());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<RecordedCall>& mCalls;
+    const std::shared_ptr<FontCollection> mCollection;
+    std::unordered_map<uint32_t, size_t> mLastUses;
+    std::unordered_map<uint32_t, std::unique_ptr<MeasuredText>> mMeasuredTexts;
+};
+
+}  // namespace
+
+// Replays a trace recorded with CallRecorder, given with --replay_trace=<file>, with the fonts of
+// the benchmarks, to evaluate a change against a real workload. Every iteration starts with an
+// empty layout cache and replays the whole trace. All the calls are laid out with the same
+// collection, whatever collection they were recorded with; "collections" is the number of
+// different ones in the trace. The other counters are the hit rates of the layout and the
+// itemization caches, and the percentiles of the latencies of each type of call in microseconds,
+// of the replay and, with the "recorded_" prefix, of the recording. "skipped" counts the
+// breakIntoLines calls whose MeasuredText was built before the recording started.
+static void BM_Replay(benchmark::State& state) {
+    if (REPLAY_TRACE == nullptr) {
+        state.SkipWithError("No trace, pass it with --replay_trace=<file>.");
+        return;
+    }
+    const std::vector<uint8_t> trace = readFile(REPLAY_TRACE);
+    std::vector<RecordedCall> calls;
+    if (!CallRecorder::readTrace(trace.data(), trace.size(), &calls)) {
+        state.SkipWithError("The trace can't be read.");
+        return;
+    }
+    auto collection =
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML));
+    Replayer replayer(calls, collection);
+
+    const CacheStats& layoutStats = LayoutCache::getInstance().getStats();
+    const CacheStats& itemizeStats = collection->getItemizeCacheStats();
+    const uint64_t layoutHits = layoutStats.hits();
+    const uint64_t layoutMisses = layoutStats.misses();
+    const uint64_t itemizeHits = itemizeStats.hits();
+    const uint64_t itemizeMisses = itemizeStats.misses();
+    std::vector<uint64_t> nanos[kTypeCount];
+    uint32_t skipped = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        Layout::purgeCaches();
+        state.ResumeTiming();
+        skipped = replayer.replay(nanos);
+    }
+
+    const auto hitRate = [](uint64_t hits, uint64_t misses) {
+        return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+    };
+    state.counters["layout_hit_rate"] =
+            hitRate(layoutStats.hits() - layoutHits, layoutStats.misses() - layoutMisses);
+    state.counters["itemize_hit_rate"] =
+            hitRate(itemizeStats.hits() - itemizeHits, itemizeStats.misses() - itemizeMisses);
+    state.counters["skipped"] = skipped;
+
+    std::vector<uint64_t> recordedNanos[kTypeCount];
+    std::unordered_set<uint32_t> fingerprints;
+    for (const RecordedCall& call : calls) {
+        recordedNanos[static_cast<uint32_t>(call.type)].push_back(call.durationNanos);
+        fingerprints.insert(call.paint.collectionFingerprint);
+        for (const RecordedCall::Run& run : call.runs) {
+            fingerprints.insert(run.paint.collectionFingerprint);
+        }
+    }
+    // The calls without a paint have no fingerprint.
+    fingerprints.erase(0);
+    state.counters["collections"] = fingerprints.size();
+    for (uint32_t type = 0; type < kTypeCount; type++) {
+        if (recordedNanos[type].empty()) {
+            continue;
+        }
+        addPercentiles(state, kTypeLabels[type], &nanos[type]);
+        addPercentiles(state, std::string("recorded_") + kTypeLabels[type], &recordedNanos[type]);
+    }
+    state.SetItemsProcessed(state.iterations() * calls.size());
+}
+
+BENCHMARK(BM_Replay);
+
+}  // namespace minikin
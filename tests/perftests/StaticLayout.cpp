@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/AndroidLineBreakerHelper.h"
+#include "minikin/FontCollection.h"
+#include "minikin/Hyphenator.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/LocaleList.h"
+#include "minikin/MeasuredText.h"
+#include "minikin/MinikinPaint.h"
+
+#include "AllocationCounter.h"
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+namespace {
+
+struct Corpus {
+    const char* label;
+    const char* locale;
+    bool isRtl;
+    const char* paragraph;
+};
+
+const Corpus kCorpora[] = {
+        {"English", "en-US", false,
+         "Typography is the art and technique of arranging type to make written language "
+         "legible, readable and appealing when displayed. The arrangement of type involves "
+         "selecting typefaces, point sizes, line lengths, line spacing, and letter spacing, and "
+         "adjusting the space between pairs of letters. "},
+        {"German", "de-DE", false,
+         "Die Donaudampfschifffahrtsgesellschaft veröffentlichte das "
+         "Rechtsschutzversicherungsgesellschaftenverzeichnis, während die "
+         "Grundstücksverkehrsgenehmigungszuständigkeitsübertragungsverordnung noch geprüft "
+         "wurde. "},
+        {"CJKLatin", "ja-JP", false,
+         "Androidのテキストレイアウトは、minikinというライブラリで行われます。"
+         "HarfBuzzでシェーピングした結果をLayoutCacheに保存し、行分割の際に再利用します。"},
+        {"RTL", "ar", true,
+         "الطباعة هي فن وتقنية ترتيب الحروف لجعل اللغة المكتوبة مقروءة وواضحة وجذابة عند "
+         "عرضها. ويشمل ترتيب الحروف اختيار الخطوط وأحجامها وأطوال الأسطر والمسافات بينها. "},
+};
+constexpr int kCorpusCount = sizeof(kCorpora) / sizeof(kCorpora[0]);
+
+const BreakStrategy kStrategies[] = {BreakStrategy::Greedy, BreakStrategy::HighQuality,
+                                     BreakStrategy::Balanced};
+const char* kStrategyLabels[] = {"Greedy", "HighQuality", "Balanced"};
+const HyphenationFrequency kFrequencies[] = {HyphenationFrequency::None,
+                                             HyphenationFrequency::Normal,
+                                             HyphenationFrequency::Full};
+const char* kFrequencyLabels[] = {"None", "Normal", "Full"};
+
+constexpr float kTextSize = 42.0f;
+constexpr float kLineWidth = 1000.0f;
+constexpr float kDefaultTabStop = 40.0f;
+
+// Registers the hyphenators of the corpora once. A locale without a hyb file is not hyphenated.
+void loadHyphenators() {
+    static const bool loaded = [] {
+        addHyphenatorFromFile("en-US", "/system/usr/hyphen-data/hyph-en-us.hyb", 2, 3);
+        addHyphenatorFromFile("de-DE", "/system/usr/hyphen-data/hyph-de-1996.hyb", 2, 2);
+        return true;
+    }();
+    (void)loaded;
+}
+
+// Repeats the paragraph of the corpus into at least 2000 code units, the size of a long article
+// paragraph.
+std::vector<uint16_t> buildParagraph(const Corpus& corpus) {
+    const std::vector<uint16_t> paragraph = utf8ToUtf16(corpus.paragraph);
+    std::vector<uint16_t> text;
+    while (text.size() < 2000) {
+        text.insert(text.end(), paragraph.begin(), paragraph.end());
+    }
+    while (text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+MinikinPaint buildPaint(const Corpus& corpus) {
+    static std::shared_ptr<FontCollection> collection =
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML));
+    MinikinPaint paint(collection);
+    paint.size = kTextSize;
+    paint.localeListId = registerLocaleList(corpus.locale);
+    return paint;
+}
+
+std::unique_ptr<MeasuredText> measure(const std::vector<uint16_t>& text, const Corpus& corpus,
+                                      bool computeHyphenation) {
+    MeasuredTextBuilder builder;
+    builder.addStyleRun(0, text.size(), buildPaint(corpus), corpus.isRtl);
+    return builder.build(text, computeHyphenation, false /* compute full layout */, nullptr);
+}
+
+void allConfigurations(benchmark::internal::Benchmark* b) {
+    for (int corpus = 0; corpus < kCorpusCount; ++corpus) {
+        for (int strategy = 0; strategy < 3; ++strategy) {
+            for (int frequency = 0; frequency < 3; ++frequency) {
+                for (int justified = 0; justified < 2; ++justified) {
+                    b->Args({corpus, strategy, frequency, justified});
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+// Builds the MeasuredText of a paragraph with the hyphenation points, as StaticLayout does before
+// breaking it. The second argument clears the layout cache before every build, as for text shown
+// for the first time. The items per second are code units per second, and "allocs" is the number
+// of heap allocations of one build.
+static void BM_StaticLayout_measure(benchmark::State& state) {
+    loadHyphenators();
+    const Corpus& corpus = kCorpora[state.range(0)];
+    const bool cold = state.range(1) != 0;
+    const std::vector<uint16_t> text = buildParagraph(corpus);
+
+    while (state.KeepRunning()) {
+        if (cold) {
+            state.PauseTiming();
+            LayoutCache::getInstance().clear();
+            state.ResumeTiming();
+        }
+        std::unique_ptr<MeasuredText> measured = measure(text, corpus, true /* hyphenation */);
+        benchmark::DoNotOptimize(measured.get());
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+    if (cold) {
+        LayoutCache::getInstance().clear();
+    }
+    state.counters["allocs"] = countAllocations([&] { measure(text, corpus, true); });
+    state.SetLabel(std::string(corpus.label) + (cold ? "/cold" : "/warm"));
+}
+
+BENCHMARK(BM_StaticLayout_measure)
+        ->Args({0, 0})
+        ->Args({0, 1})
+        ->Args({1, 0})
+        ->Args({1, 1})
+        ->Args({2, 0})
+        ->Args({2, 1})
+        ->Args({3, 0})
+        ->Args({3, 1});
+
+// Breaks a measured paragraph into lines through StaticLayoutNative, as the framework does. The
+// arguments are the corpus, the break strategy, the hyphenation frequency and the
+// justification. The items per second are code units per second, and "allocs" is the number of
+// heap allocations of one call.
+static void BM_StaticLayout_computeBreaks(benchmark::State& state) {
+    loadHyphenators();
+    const Corpus& corpus = kCorpora[state.range(0)];
+    const BreakStrategy strategy = kStrategies[state.range(1)];
+    const HyphenationFrequency frequency = kFrequencies[state.range(2)];
+    const bool justified = state.range(3) != 0;
+    const std::vector<uint16_t> text = buildParagraph(corpus);
+    std::unique_ptr<MeasuredText> measured =
+            measure(text, corpus, frequency != HyphenationFrequency::None);
+
+    android::StaticLayoutNative layoutNative(strategy, frequency, justified,
+                                             std::vector<float>() /* indents */);
+    LineBreakResult result;
+    while (state.KeepRunning()) {
+        layoutNative.computeBreaks(text, *measured, kLineWidth, 1 /* first width line count */,
+                                   kLineWidth, 0 /* indents offset */, nullptr /* tab stops */,
+                                   0 /* tab stop size */, kDefaultTabStop,
+                                   false /* compute extents */, &result);
+        benchmark::DoNotOptimize(result.breakPoints.data());
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+    // The result and the scratch memory are reused, so this is what a steady state relayout of
+    // the paragraph allocates.
+    state.counters["allocs"] = countAllocations([&] {
+        layoutNative.computeBreaks(text, *measured, kLineWidth, 1, kLineWidth, 0, nullptr, 0,
+                                   kDefaultTabStop, false /* compute extents */, &result);
+    });
+    state.SetLabel(std::string(corpus.label) + "/" + kStrategyLabels[state.range(1)] + "/" +
+                   kFrequencyLabels[state.range(2)] + (justified ? "/justified" : ""));
+}
+
+BENCHMARK(BM_StaticLayout_computeBreaks)->Apply(allConfigurations);
+
+}  // namespace minikin
@@ -38,6 +38,42 @@ static void BM_WordBreaker_English(benchmark::State& state) {
 }
 BENCHMARK(BM_WordBreaker_English);
 
+static void BM_WordBreaker_EmailsAndUrls(benchmark::State& state) {
+    const char* kText =
+            "Mail minikin@example.com or see https://example.com/minikin/docs/index.html for "
+            "the details, or file a bug at http://bugs.example.com/new?component=text.";
+
+    WordBreaker wb;
+    wb.followingWithLocale(Locale("en-US"), 0);
+    std::vector<uint16_t> text = utf8ToUtf16(kText);
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        while (wb.next() != -1) {
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_EmailsAndUrls);
+
+// Restarts the iteration at the breaks of a long text, as the line breakers do at each locale
+// change, which looks the email address / URL scans up in a table instead of repeating them.
+static void BM_WordBreaker_LongTextRestarts(benchmark::State& state) {
+    std::string longText;
+    while (longText.size() < 4096) {
+        longText += "Mail minikin@example.com or see https://example.com/minikin/docs/index.html. ";
+    }
+
+    WordBreaker wb;
+    std::vector<uint16_t> text = utf8ToUtf16(longText);
+    const Locale locale("en-US");
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        for (ssize_t i = wb.followingWithLocale(locale, 0); i != -1; i = wb.next()) {
+            wb.followingWithLocale(locale, i);
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_LongTextRestarts);
+
 // TODO: Add more tests for other languages.
 
 }  // namespace minikin
@@ -14,9 +14,65 @@
  * limitations under the License.
  */
 
+#include <cstring>
+#include <string>
+
 #include <benchmark/benchmark.h>
 
+#include "PathUtils.h"
+
+namespace minikin {
+
+// The fonts the benchmarks lay out with. They are the system fonts on a device and the fonts of
+// the test data elsewhere, so that the benchmarks also run on host. The --font_dir and --font_xml
+// flags override them, e.g. with a copy of the system fonts of a device.
+const char* SYSTEM_FONT_PATH = nullptr;
+const char* SYSTEM_FONT_XML = nullptr;
+// The trace BM_Replay replays, set with the --replay_trace flag.
+const char* REPLAY_TRACE = nullptr;
+
+namespace {
+
+const char kFontDirFlag[] = "--font_dir=";
+const char kFontXmlFlag[] = "--font_xml=";
+const char kReplayTraceFlag[] = "--replay_trace=";
+
+// Sets the fonts and the trace to replay from the command line, removing the flags so that the
+// benchmark library does not see them.
+void initFlags(int* argc, char** argv) {
+#ifdef __ANDROID__
+    static std::string fontDir = "/system/fonts/";
+    static std::string fontXml = "/system/etc/fonts.xml";
+#else
+    static std::string fontDir = getTestDataDir();
+    static std::string fontXml = getTestDataDir() + "perftests.xml";
+#endif
+    int kept = 1;
+    for (int i = 1; i < *argc; ++i) {
+        if (strncmp(argv[i], kFontDirFlag, strlen(kFontDirFlag)) == 0) {
+            fontDir = argv[i] + strlen(kFontDirFlag);
+            if (!fontDir.empty() && fontDir.back() != '/') {
+                fontDir += '/';
+            }
+        } else if (strncmp(argv[i], kFontXmlFlag, strlen(kFontXmlFlag)) == 0) {
+            fontXml = argv[i] + strlen(kFontXmlFlag);
+        } else if (strncmp(argv[i], kReplayTraceFlag, strlen(kReplayTraceFlag)) == 0) {
+            REPLAY_TRACE = argv[i] + strlen(kReplayTraceFlag);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    SYSTEM_FONT_PATH = fontDir.c_str();
+    SYSTEM_FONT_XML = fontXml.c_str();
+}
+
+}  // namespace
+
+}  // namespace minikin
+
 int main(int argc, char** argv) {
+    minikin::initFlags(&argc, argv);
     benchmark::Initialize(&argc, argv);
     benchmark::RunSpecifiedBenchmarks();
 
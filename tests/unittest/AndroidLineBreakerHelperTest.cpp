@@ -16,8 +16,17 @@
 
 #include "minikin/AndroidLineBreakerHelper.h"
 
+#include <memory>
+#include <random>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "minikin/MeasuredText.h"
+
+#include "LineBreakerTestHelper.h"
+#include "UnicodeUtils.h"
+
 namespace minikin {
 namespace android {
 
@@ -54,5 +63,55 @@ TEST(AndroidLineWidth, negativeWidthTest) {
     }
 }
 
+TEST(AndroidLineWidth, indentTableTest) {
+    std::mt19937 mt(0);
+    for (size_t indentCount : {0, 1, 2, 3, 7, 64, 1000}) {
+        SCOPED_TRACE(indentCount);
+        std::vector<float> values(indentCount);
+        for (float& value : values) {
+            value = mt() % 100;
+        }
+        const LineIndents indents{std::vector<float>(values)};
+        for (int32_t firstLineCount : {-1, 0, 1, 2, 5, 500, 2000}) {
+            for (int32_t offset : {0, 1, 3, 900}) {
+                const AndroidLineWidth expected(80, firstLineCount, 60, values, offset);
+                const AndroidLineWidth actual(80, firstLineCount, 60, indents, offset);
+                EXPECT_EQ(expected.getMin(), actual.getMin());
+                for (size_t lineNo = 0; lineNo < indentCount + 2; lineNo += 7) {
+                    EXPECT_EQ(expected.getAt(lineNo), actual.getAt(lineNo));
+                }
+            }
+        }
+    }
+}
+
+TEST(StaticLayoutNative, reusedResultTest) {
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    MeasuredTextBuilder builder;
+    builder.addCustomRun<line_breaker_test_helper::ConstantRun>(Range(0, text.size()), "en-US",
+                                                                10.0f, -80.0f, 20.0f);
+    std::unique_ptr<MeasuredText> measuredText =
+            builder.build(text, false /* compute hyphenation */, false /* compute full layout */,
+                          nullptr /* no hint */);
+
+    StaticLayoutNative layout(BreakStrategy::HighQuality, HyphenationFrequency::None,
+                              false /* justified */, std::vector<float>());
+    for (const float width : {100.0f, 60.0f, 100.0f}) {
+        SCOPED_TRACE(width);
+        const LineBreakResult expected =
+                static_cast<const StaticLayoutNative&>(layout).computeBreaks(
+                        text, *measuredText, width, 1, width, 0, nullptr, 0, 10.0f);
+        const LineBreakResult& actual = layout.computeBreaks(text, *measuredText, width, 1, width,
+                                                             0, nullptr, 0, 10.0f, true);
+        EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+        EXPECT_EQ(expected.widths, actual.widths);
+        EXPECT_EQ(expected.ascents, actual.ascents);
+        EXPECT_EQ(expected.descents, actual.descents);
+        EXPECT_EQ(expected.flags, actual.flags);
+        EXPECT_EQ(&actual, &layout.computeBreaks(text, *measuredText, width, 1, width, 0, nullptr,
+                                                 0, 10.0f, true));
+    }
+}
+
 }  // namespace android
 }  // namespace minikin
@@ -16,6 +16,9 @@
 
 #include "BidiUtils.h"
 
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "minikin/Range.h"
@@ -533,4 +536,124 @@ TEST(BidiUtilsTest, RTL_LTR_RTL_CharText) {
     }
 }
 
+TEST(BidiUtilsTest, LTRTextWithoutRtlChars) {
+    // Latin, CJK, Devanagari and emoji. No character can make an RTL run in a LTR paragraph.
+    auto text = utf8ToUtf16("Hello, World. \u4F60\u597D \u0928\u092E\u0938\u094D\u0924\u0947 "
+                            "\U0001F600 12.5%");
+    for (Bidi bidi : {Bidi::LTR, Bidi::DEFAULT_LTR}) {
+        BidiText bidiText(text, Range(2, text.size() - 3), bidi);
+        auto it = bidiText.begin();
+        EXPECT_NE(bidiText.end(), it);
+        EXPECT_EQ(Range(2, text.size() - 3), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(bidiText.end(), it);
+    }
+}
+
+TEST(BidiUtilsTest, LTRTextWithBidiChars) {
+    // Arabic numbers get a higher level than the Latin letters even in a LTR paragraph.
+    {
+        auto text = utf8ToUtf16("Hello World \u0661\u0662");
+        BidiText bidiText(text, Range(0, text.size()), Bidi::LTR);
+        auto it = bidiText.begin();
+        EXPECT_EQ(Range(0, 12), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(Range(12, 14), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(bidiText.end(), it);
+    }
+    // The right-to-left mark is a strong RTL character.
+    {
+        auto text = utf8ToUtf16("Hello World\u200F World");
+        BidiText bidiText(text, Range(0, text.size()), Bidi::DEFAULT_LTR);
+        auto it = bidiText.begin();
+        EXPECT_EQ(Range(0, 11), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(Range(11, 12), (*it).range);
+        EXPECT_TRUE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(Range(12, text.size()), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(bidiText.end(), it);
+    }
+    // An RTL paragraph with LTR text still has its trailing space in an RTL run.
+    {
+        auto text = utf8ToUtf16("Hello ");
+        BidiText bidiText(text, Range(0, text.size()), Bidi::RTL);
+        auto it = bidiText.begin();
+        EXPECT_EQ(Range(5, 6), (*it).range);
+        EXPECT_TRUE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(Range(0, 5), (*it).range);
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(bidiText.end(), it);
+    }
+}
+
+class TestableUBiDiPool : public UBiDiPool {
+public:
+    TestableUBiDiPool() : UBiDiPool() {}
+
+    using UBiDiPool::MAX_POOL_SIZE;
+    using UBiDiPool::MAX_POOLED_TEXT_LENGTH;
+};
+
+TEST(BidiUtilsTest, UBiDiPool_acquire_release) {
+    TestableUBiDiPool pool;
+    UBiDiUniquePtr bidi = pool.acquire();
+    ASSERT_NE(nullptr, bidi.get());
+    EXPECT_EQ(0u, pool.getPoolSize());
+    EXPECT_EQ(1u, pool.getStats().misses());
+
+    UBiDi* raw = bidi.get();
+    pool.release(std::move(bidi), 10);
+    EXPECT_EQ(1u, pool.getPoolSize());
+
+    // The released object is reused.
+    bidi = pool.acquire();
+    EXPECT_EQ(raw, bidi.get());
+    EXPECT_EQ(0u, pool.getPoolSize());
+    EXPECT_EQ(1u, pool.getStats().hits());
+
+    // Objects used for a long text are not kept.
+    pool.release(std::move(bidi), TestableUBiDiPool::MAX_POOLED_TEXT_LENGTH + 1);
+    EXPECT_EQ(0u, pool.getPoolSize());
+    EXPECT_EQ(1u, pool.getStats().evictions());
+}
+
+TEST(BidiUtilsTest, UBiDiPool_max_pool_size) {
+    TestableUBiDiPool pool;
+    std::vector<UBiDiUniquePtr> bidis;
+    for (size_t i = 0; i < TestableUBiDiPool::MAX_POOL_SIZE + 1; ++i) {
+        bidis.push_back(pool.acquire());
+    }
+    for (UBiDiUniquePtr& bidi : bidis) {
+        pool.release(std::move(bidi), 10);
+    }
+    EXPECT_EQ(TestableUBiDiPool::MAX_POOL_SIZE, pool.getPoolSize());
+    EXPECT_EQ(1u, pool.getStats().evictions());
+}
+
+TEST(BidiUtilsTest, BidiTextReusesPooledUBiDi) {
+    auto text = utf8ToUtf16(std::string(LTR_1) + RTL_1);
+    const uint64_t hits = UBiDiPool::getInstance().getStats().hits();
+    for (int i = 0; i < 2; ++i) {
+        BidiText bidiText(text, Range(0, text.size()), Bidi::LTR);
+        auto it = bidiText.begin();
+        EXPECT_FALSE((*it).isRtl);
+        ++it;
+        EXPECT_TRUE((*it).isRtl);
+        ++it;
+        EXPECT_EQ(bidiText.end(), it);
+    }
+    // At least the second construction gets the object released by the first one.
+    EXPECT_LE(hits + 1, UBiDiPool::getInstance().getStats().hits());
+}
+
 }  // namespace minikin
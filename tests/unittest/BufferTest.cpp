@@ -87,4 +87,102 @@ TEST(BufferTest, testSkip) {
     ASSERT_EQ(reader.pos(), 20u);
 }
 
+TEST(BufferTest, testValidator) {
+    TestObject testObject;
+    BufferWriter fakeWriter(nullptr);
+    testObject.writeTo(&fakeWriter);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    testObject.writeTo(&writer);
+
+    BufferValidator validator(buffer.data(), buffer.size());
+    EXPECT_EQ(validator.read<uint8_t>(), 0xABu);
+    EXPECT_EQ(validator.read<uint16_t>(), 0xCDEFu);
+    EXPECT_EQ(validator.pos(), 4u);
+    validator.skip<uint8_t>();
+    auto [uint32Array, size] = validator.readArray<uint32_t>();
+    ASSERT_EQ(size, 2u);
+    EXPECT_EQ(uint32Array[1], 0x98765433u);
+    EXPECT_EQ(validator.pos(), 20u);
+    EXPECT_TRUE(validator.ok());
+
+    // Reading past the end fails, and so do all the reads after it.
+    validator.skip<uint8_t>();
+    EXPECT_FALSE(validator.ok());
+    EXPECT_EQ(validator.pos(), 20u);
+
+    // Every truncated buffer fails.
+    for (size_t truncated = 0; truncated < buffer.size(); truncated++) {
+        SCOPED_TRACE(truncated);
+        BufferValidator truncatedValidator(buffer.data(), truncated);
+        truncatedValidator.skip<uint8_t>();
+        truncatedValidator.skip<uint16_t>();
+        truncatedValidator.skip<uint8_t>();
+        auto [array, arraySize] = truncatedValidator.readArray<uint32_t>();
+        EXPECT_FALSE(truncatedValidator.ok());
+        EXPECT_EQ(array, nullptr);
+        EXPECT_EQ(arraySize, 0u);
+    }
+
+    // An array size larger than the buffer fails without overflowing.
+    uint32_t hugeArray[] = {0xFFFFFFFF, 0};
+    BufferValidator hugeValidator(hugeArray, sizeof(hugeArray));
+    EXPECT_EQ(hugeValidator.readArray<uint32_t>().first, nullptr);
+    EXPECT_FALSE(hugeValidator.ok());
+
+    BufferValidator skipValidator(buffer.data(), buffer.size());
+    skipValidator.skipBytes(20);
+    EXPECT_TRUE(skipValidator.ok());
+    skipValidator.skipBytes(0xFFFFFFFFFFFFFFFFull);
+    EXPECT_FALSE(skipValidator.ok());
+}
+
+TEST(BufferTest, testReserveWriteAt) {
+    auto writeTo = [](BufferWriter* writer) {
+        writer->write<uint8_t>(0xAB);
+        // padding (3), uint32_t (4)
+        const size_t pos = writer->reserve<uint32_t>();
+        writer->write<uint16_t>(0xCDEF);
+        writer->writeAt<uint32_t>(pos, writer->size());
+        return pos;
+    };
+    BufferWriter fakeWriter(nullptr);
+    EXPECT_EQ(writeTo(&fakeWriter), 4u);
+    ASSERT_EQ(fakeWriter.size(), 10u);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    EXPECT_EQ(writeTo(&writer), 4u);
+
+    BufferReader reader(buffer.data());
+    EXPECT_EQ(reader.read<uint8_t>(), 0xABu);
+    EXPECT_EQ(reader.read<uint32_t>(), 10u);
+    EXPECT_EQ(reader.read<uint16_t>(), 0xCDEFu);
+}
+
+TEST(BufferTest, testReserveArray) {
+    auto writeTo = [](BufferWriter* writer) {
+        writer->write<uint16_t>(0xCDEF);
+        // array size (4), padding (2), uint64_t (8) * 2
+        const size_t pos = writer->reserveArray<uint64_t>(2);
+        writer->write<uint8_t>(0xAB);
+        writer->writeAt<uint64_t>(pos, 0x9876543210ull);
+        writer->writeAt<uint64_t>(pos + sizeof(uint64_t), writer->size());
+        return pos;
+    };
+    BufferWriter fakeWriter(nullptr);
+    EXPECT_EQ(writeTo(&fakeWriter), 8u);
+    ASSERT_EQ(fakeWriter.size(), 25u);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    writeTo(&writer);
+
+    BufferReader reader(buffer.data());
+    EXPECT_EQ(reader.read<uint16_t>(), 0xCDEFu);
+    auto [array, size] = reader.readArray<uint64_t>();
+    ASSERT_EQ(size, 2u);
+    EXPECT_EQ(array[0], 0x9876543210ull);
+    EXPECT_EQ(array[1], 25u);
+    EXPECT_EQ(reader.read<uint8_t>(), 0xABu);
+}
+
 }  // namespace minikin
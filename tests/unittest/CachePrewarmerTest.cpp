@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CachePrewarmer.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/Executor.h"
+#include "minikin/LayoutCache.h"
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+class TestableLayoutCache : public LayoutCache {
+public:
+    TestableLayoutCache(uint32_t maxEntries) : LayoutCache(maxEntries) {}
+    using LayoutCache::getCacheSize;
+};
+
+class TestableCachePrewarmer : public CachePrewarmer {
+public:
+    TestableCachePrewarmer(LayoutCache* cache, const std::shared_ptr<FontCollection>& collection,
+                           const std::vector<MinikinPaint>& paints,
+                           const std::vector<std::vector<uint16_t>>& strings)
+            : CachePrewarmer(cache, collection, paints, strings) {}
+};
+
+// Keeps the tasks until they are run on the calling thread.
+class HeldExecutor : public Executor {
+public:
+    HeldExecutor() { setExecutor(this); }
+    ~HeldExecutor() { setExecutor(nullptr); }
+
+    void execute(std::function<void()>&& task, Priority) override {
+        tasks.push_back(std::move(task));
+    }
+
+    uint32_t getConcurrency() const override { return 1; }
+
+    std::vector<std::function<void()>> tasks;
+};
+
+class LayoutCapture {
+public:
+    void operator()(const LayoutPiece& layout, const MinikinPaint&) { mLayout = &layout; }
+    const LayoutPiece* get() const { return mLayout; }
+
+private:
+    const LayoutPiece* mLayout = nullptr;
+};
+
+}  // namespace
+
+TEST(CachePrewarmerTest, prewarmTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint1(collection);
+    paint1.size = 10.0f;
+    MinikinPaint paint2(collection);
+    paint2.size = 20.0f;
+    TestableLayoutCache cache(10);
+
+    TestableCachePrewarmer prewarmer(&cache, collection, {paint1, paint2},
+                                     {utf8ToUtf16("android"), utf8ToUtf16("minikin")});
+    EXPECT_TRUE(prewarmer.wait());
+    EXPECT_EQ(4u, cache.getCacheSize());
+    // Prewarming does not count as lookups.
+    EXPECT_EQ(0u, cache.getStats().hits());
+    EXPECT_EQ(0u, cache.getStats().misses());
+
+    auto text = utf8ToUtf16("minikin");
+    LayoutCapture layout;
+    cache.getOrCreate(text, Range(0, text.size()), paint2, false /* LTR */,
+                      StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_NE(nullptr, layout.get());
+    EXPECT_EQ(1u, cache.getStats().hits());
+    EXPECT_EQ(0u, cache.getStats().misses());
+}
+
+TEST(CachePrewarmerTest, prewarmWordsTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    TestableLayoutCache cache(10);
+
+    // The text is cached by word, as Layout looks it up.
+    TestableCachePrewarmer prewarmer(&cache, collection, {MinikinPaint(collection)},
+                                     {utf8ToUtf16("android minikin")});
+    EXPECT_TRUE(prewarmer.wait());
+    EXPECT_EQ(2u, cache.getCacheSize());
+}
+
+TEST(CachePrewarmerTest, cancelTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    TestableLayoutCache cache(10);
+
+    TestableCachePrewarmer prewarmer(&cache, collection, {MinikinPaint(collection)},
+                                     {utf8ToUtf16("android"), utf8ToUtf16("minikin")});
+    prewarmer.cancel();
+    // The thread may have finished before the cancellation, otherwise the string being laid out
+    // and the ones after it are not in the cache.
+    if (prewarmer.wait()) {
+        EXPECT_EQ(2u, cache.getCacheSize());
+    } else {
+        EXPECT_GT(2u, cache.getCacheSize());
+    }
+}
+
+TEST(CachePrewarmerTest, cancelAfterCompletionTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    TestableLayoutCache cache(10);
+    HeldExecutor executor;
+
+    TestableCachePrewarmer prewarmer(&cache, collection, {MinikinPaint(collection)},
+                                     {utf8ToUtf16("android"), utf8ToUtf16("minikin")});
+    ASSERT_EQ(1u, executor.tasks.size());
+    executor.tasks[0]();
+    prewarmer.cancel();
+    // The cancellation doesn't undo the finished prewarming.
+    EXPECT_TRUE(prewarmer.wait());
+    EXPECT_EQ(2u, cache.getCacheSize());
+}
+
+TEST(CachePrewarmerTest, cancelBeforeStartTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    TestableLayoutCache cache(10);
+    HeldExecutor executor;
+
+    {
+        TestableCachePrewarmer prewarmer(&cache, collection, {MinikinPaint(collection)},
+                                         {utf8ToUtf16("android"), utf8ToUtf16("minikin")});
+        ASSERT_EQ(1u, executor.tasks.size());
+        prewarmer.cancel();
+        // Neither wait() nor the destructor blocks on the task which hasn't started.
+        EXPECT_FALSE(prewarmer.wait());
+    }
+
+    // The task starting after the prewarmer is gone doesn't lay out anything.
+    executor.tasks[0]();
+    EXPECT_EQ(0u, cache.getCacheSize());
+}
+
+}  // namespace minikin
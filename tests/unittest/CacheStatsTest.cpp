@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CacheStats.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(CacheStatsTest, uncontendedLock) {
+    CacheStats stats;
+    std::mutex mutex;
+    {
+        std::unique_lock<std::mutex> lock = stats.lock(mutex);
+        EXPECT_TRUE(lock.owns_lock());
+    }
+    EXPECT_EQ(0u, stats.lockWaits());
+    EXPECT_EQ(0u, stats.lockWaitNanos());
+}
+
+TEST(CacheStatsTest, contendedLock) {
+    CacheStats stats;
+    std::mutex mutex;
+    std::unique_lock<std::mutex> held(mutex);
+    std::atomic<bool> locked(false);
+    std::thread thread([&] {
+        std::unique_lock<std::mutex> lock = stats.lock(mutex);
+        locked = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(locked);
+    held.unlock();
+    thread.join();
+
+    EXPECT_TRUE(locked);
+    EXPECT_EQ(1u, stats.lockWaits());
+    EXPECT_LT(0u, stats.lockWaitNanos());
+
+    stats.reset();
+    EXPECT_EQ(0u, stats.lockWaits());
+    EXPECT_EQ(0u, stats.lockWaitNanos());
+}
+
+}  // namespace minikin
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/CallRecorder.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/LineBreaker.h"
+#include "minikin/LocaleList.h"
+#include "minikin/MeasuredText.h"
+
+#include "FontTestUtils.h"
+#include "LineBreakerUtil.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+MinikinPaint buildPaint() {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+    paint.letterSpacing = 0.5f;
+    paint.localeListId = registerLocaleList("en-US");
+    paint.fontFeatureSettings = "\"liga\" 0";
+    return paint;
+}
+
+}  // namespace
+
+TEST(CallRecorderTest, recordAndReadTest) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<uint16_t> text = utf8ToUtf16("Hello, world.");
+    const float tabStops[] = {40.0f};
+
+    CallRecorder::start();
+    EXPECT_TRUE(CallRecorder::isRecording());
+    Layout layout(text, Range(0, 5), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                  EndHyphenEdit::INSERT_HYPHEN);
+    Layout::measureText(text, Range(7, 13), Bidi::FORCE_RTL, paint, StartHyphenEdit::NO_EDIT,
+                        EndHyphenEdit::NO_EDIT, nullptr);
+    MeasuredTextBuilder builder;
+    builder.addStyleRun(0, 7, MinikinPaint(paint), false /* is RTL */);
+    builder.addReplacementRun(7, 13, 20.0f, registerLocaleList("ja-JP"));
+    std::unique_ptr<MeasuredText> measured =
+            builder.build(text, true /* hyphenation */, true /* layout */, nullptr /* hint */);
+    breakIntoLines(text, BreakStrategy::HighQuality, HyphenationFrequency::Normal,
+                   true /* justified */, *measured, ConstantLineWidth(30.0f),
+                   TabStops(tabStops, 1, 10.0f));
+    const std::vector<uint8_t> trace = CallRecorder::stop();
+    EXPECT_FALSE(CallRecorder::isRecording());
+    EXPECT_EQ(0u, CallRecorder::getDroppedCallCount());
+
+    // The calls after stop() are not recorded.
+    Layout::measureText(text, Range(0, 5), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                        EndHyphenEdit::NO_EDIT, nullptr);
+
+    std::vector<RecordedCall> calls;
+    ASSERT_TRUE(CallRecorder::readTrace(trace.data(), trace.size(), &calls));
+    // The calls made inside the recorded ones, e.g. the layouts of measuring, are not recorded.
+    ASSERT_EQ(4u, calls.size());
+
+    const RecordedCall& layoutCall = calls[0];
+    EXPECT_EQ(RecordedCall::Type::kLayout, layoutCall.type);
+    EXPECT_EQ(text, layoutCall.text);
+    EXPECT_EQ(Range(0, 5), layoutCall.range);
+    EXPECT_EQ(Bidi::LTR, layoutCall.bidiFlags);
+    EXPECT_EQ(EndHyphenEdit::INSERT_HYPHEN, layoutCall.endHyphen);
+    EXPECT_EQ(10.0f, layoutCall.paint.size);
+    EXPECT_EQ(0.5f, layoutCall.paint.letterSpacing);
+    EXPECT_EQ("en-US", layoutCall.paint.locales);
+    EXPECT_EQ("\"liga\" 0", layoutCall.paint.fontFeatureSettings);
+    EXPECT_EQ(CallRecorder::getCollectionFingerprint(*paint.font),
+              layoutCall.paint.collectionFingerprint);
+
+    const RecordedCall& measureCall = calls[1];
+    EXPECT_EQ(RecordedCall::Type::kMeasureText, measureCall.type);
+    EXPECT_EQ(Range(7, 13), measureCall.range);
+    EXPECT_EQ(Bidi::FORCE_RTL, measureCall.bidiFlags);
+
+    const RecordedCall& buildCall = calls[2];
+    EXPECT_EQ(RecordedCall::Type::kMeasuredTextBuild, buildCall.type);
+    ASSERT_EQ(2u, buildCall.runs.size());
+    EXPECT_FALSE(buildCall.runs[0].isReplacement);
+    EXPECT_EQ(Range(0, 7), buildCall.runs[0].range);
+    EXPECT_EQ("en-US", buildCall.runs[0].paint.locales);
+    EXPECT_TRUE(buildCall.runs[1].isReplacement);
+    EXPECT_EQ(20.0f, buildCall.runs[1].width);
+    EXPECT_EQ("ja-JP", buildCall.runs[1].locales);
+    EXPECT_TRUE(buildCall.computeHyphenation);
+    EXPECT_TRUE(buildCall.computeLayout);
+    EXPECT_FALSE(buildCall.hasHint);
+    EXPECT_NE(0u, buildCall.measuredTextId);
+    EXPECT_EQ(measured->getRecordedId(), buildCall.measuredTextId);
+
+    const RecordedCall& breakCall = calls[3];
+    EXPECT_EQ(RecordedCall::Type::kBreakIntoLines, breakCall.type);
+    EXPECT_EQ(buildCall.measuredTextId, breakCall.measuredTextId);
+    EXPECT_EQ(BreakStrategy::HighQuality, breakCall.strategy);
+    EXPECT_EQ(HyphenationFrequency::Normal, breakCall.frequency);
+    EXPECT_TRUE(breakCall.justified);
+    ASSERT_FALSE(breakCall.lineWidths.empty());
+    EXPECT_EQ(30.0f, breakCall.lineWidths[0]);
+    EXPECT_EQ(30.0f, breakCall.minLineWidth);
+    EXPECT_EQ(std::vector<float>({40.0f}), breakCall.tabStops);
+    EXPECT_EQ(10.0f, breakCall.tabWidth);
+}
+
+TEST(CallRecorderTest, maxBytesTest) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<uint16_t> text = utf8ToUtf16("Hello, world.");
+
+    // Room for the header and one call.
+    CallRecorder::start(200);
+    for (int i = 0; i < 3; i++) {
+        Layout::measureText(text, Range(0, text.size()), Bidi::LTR, paint,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, nullptr);
+    }
+    const std::vector<uint8_t> trace = CallRecorder::stop();
+    EXPECT_LE(trace.size(), 200u);
+
+    std::vector<RecordedCall> calls;
+    ASSERT_TRUE(CallRecorder::readTrace(trace.data(), trace.size(), &calls));
+    EXPECT_EQ(3u, calls.size() + CallRecorder::getDroppedCallCount());
+    EXPECT_LT(calls.size(), 3u);
+}
+
+TEST(CallRecorderTest, readTraceInvalidTest) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<uint16_t> text = utf8ToUtf16("Hello");
+    CallRecorder::start();
+    Layout::measureText(text, Range(0, text.size()), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                        EndHyphenEdit::NO_EDIT, nullptr);
+    const std::vector<uint8_t> trace = CallRecorder::stop();
+
+    std::vector<RecordedCall> calls;
+    ASSERT_TRUE(CallRecorder::readTrace(trace.data(), trace.size(), &calls));
+    EXPECT_EQ(1u, calls.size());
+
+    // A trace cut inside a record or the header is rejected.
+    for (size_t size = 0; size < trace.size(); size++) {
+        if (size == 2 * sizeof(uint32_t)) {
+            // The trace without calls.
+            EXPECT_TRUE(CallRecorder::readTrace(trace.data(), size, &calls));
+            EXPECT_TRUE(calls.empty());
+            continue;
+        }
+        EXPECT_FALSE(CallRecorder::readTrace(trace.data(), size, &calls)) << size;
+    }
+
+    // So is a trace of another version.
+    std::vector<uint8_t> otherVersion = trace;
+    otherVersion[sizeof(uint32_t)]++;
+    EXPECT_FALSE(CallRecorder::readTrace(otherVersion.data(), otherVersion.size(), &calls));
+}
+
+}  // namespace minikin
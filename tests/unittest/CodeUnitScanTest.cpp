@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CodeUnitScan.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+namespace {
+
+// Returns a text of the length filled with 'a', with the code units at the positions replaced.
+std::vector<uint16_t> makeText(uint32_t length, const std::vector<std::pair<uint32_t, uint16_t>>&
+                                                         replacements = {}) {
+    std::vector<uint16_t> text(length, 'a');
+    for (const auto& [pos, c] : replacements) {
+        text[pos] = c;
+    }
+    return text;
+}
+
+}  // namespace
+
+TEST(CodeUnitScanTest, findAnyCodeUnitTest) {
+    // Covers the vectorized loop and the tail for every position.
+    for (uint32_t length = 0; length < 40; ++length) {
+        SCOPED_TRACE(length);
+        std::vector<uint16_t> text = makeText(length);
+        EXPECT_EQ(length, findAnyCodeUnit(text.data(), 0, length, 'b', 'c'));
+        EXPECT_EQ(length, findCodeUnit(text.data(), 0, length, 'b'));
+        for (uint32_t pos = 0; pos < length; ++pos) {
+            text = makeText(length, {{pos, 'c'}});
+            EXPECT_EQ(pos, findAnyCodeUnit(text.data(), 0, length, 'b', 'c'));
+            EXPECT_EQ(pos, findCodeUnit(text.data(), 0, length, 'c'));
+            EXPECT_EQ(length, findCodeUnit(text.data(), 0, length, 'b'));
+            // The search starts at start and stops at end.
+            EXPECT_EQ(length, findAnyCodeUnit(text.data(), pos + 1, length, 'b', 'c'));
+            EXPECT_EQ(pos, findAnyCodeUnit(text.data(), 0, pos, 'b', 'c'));
+        }
+    }
+
+    // The first of several matches.
+    const std::vector<uint16_t> text = makeText(20, {{3, 0x00A0}, {10, 0x0009}, {12, 0x00A0}});
+    EXPECT_EQ(3u, findAnyCodeUnit(text.data(), 0, 20, 0x0009, 0x00A0));
+    EXPECT_EQ(10u, findAnyCodeUnit(text.data(), 4, 20, 0x0009, 0x00A0));
+    EXPECT_EQ(10u, findAnyCodeUnit(text.data(), 0, 20, 0x0009));
+    EXPECT_EQ(12u, findAnyCodeUnit(text.data(), 11, 20, 0x0009, 0x00A0, 0xFFFF));
+}
+
+TEST(CodeUnitScanTest, findCodeUnitNotAnyOfTest) {
+    for (uint32_t length = 0; length < 40; ++length) {
+        SCOPED_TRACE(length);
+        std::vector<uint16_t> text(length, '\n');
+        for (uint32_t i = 0; i < length; i += 3) {
+            text[i] = '\r';
+        }
+        EXPECT_EQ(length, findCodeUnitNotAnyOf(text.data(), 0, length, '\n', '\r'));
+        EXPECT_EQ(std::min(length, 1u), findCodeUnitNotAnyOf(text.data(), 0, length, '\r'));
+        for (uint32_t pos = 0; pos < length; ++pos) {
+            const uint16_t saved = text[pos];
+            text[pos] = 'a';
+            EXPECT_EQ(pos, findCodeUnitNotAnyOf(text.data(), 0, length, '\n', '\r'));
+            EXPECT_EQ(length, findCodeUnitNotAnyOf(text.data(), pos + 1, length, '\n', '\r'));
+            text[pos] = saved;
+        }
+    }
+}
+
+}  // namespace minikin
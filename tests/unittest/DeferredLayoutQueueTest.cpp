@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeferredLayoutQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/Executor.h"
+
+namespace minikin {
+namespace {
+
+class TestableDeferredLayoutQueue : public DeferredLayoutQueue {
+public:
+    TestableDeferredLayoutQueue() : DeferredLayoutQueue() {}
+    virtual ~TestableDeferredLayoutQueue() {}
+
+    bool post(std::function<void()>&& task) { return postInternal(std::move(task)); }
+
+    void waitForIdle() { DeferredLayoutQueue::waitForIdle(); }
+};
+
+// Keeps the tasks until they are run on the calling thread.
+class HeldExecutor : public Executor {
+public:
+    HeldExecutor() { setExecutor(this); }
+    ~HeldExecutor() { setExecutor(nullptr); }
+
+    void execute(std::function<void()>&& task, Priority) override {
+        tasks.push_back(std::move(task));
+    }
+
+    uint32_t getConcurrency() const override { return 1; }
+
+    // Runs the oldest task.
+    void runNext() {
+        std::function<void()> task = std::move(tasks.front());
+        tasks.erase(tasks.begin());
+        task();
+    }
+
+    std::vector<std::function<void()>> tasks;
+};
+
+TEST(DeferredLayoutQueueTest, runInOrder) {
+    TestableDeferredLayoutQueue queue;
+    std::vector<int> order;
+    std::thread::id threadId = std::this_thread::get_id();
+    for (int i = 0; i < 10; ++i) {
+        queue.post([&order, &threadId, i]() {
+            order.push_back(i);
+            threadId = std::this_thread::get_id();
+        });
+    }
+    queue.waitForIdle();
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), order);
+    EXPECT_NE(std::this_thread::get_id(), threadId);
+}
+
+TEST(DeferredLayoutQueueTest, releaseCaptures) {
+    TestableDeferredLayoutQueue queue;
+    std::shared_ptr<int> captured = std::make_shared<int>(1);
+    queue.post([captured]() {});
+    queue.waitForIdle();
+    EXPECT_EQ(1, captured.use_count());
+}
+
+TEST(DeferredLayoutQueueTest, oneLayoutPerTask) {
+    HeldExecutor executor;
+    TestableDeferredLayoutQueue queue;
+    std::vector<int> order;
+    queue.post([&order]() { order.push_back(0); });
+    queue.post([&order]() { order.push_back(1); });
+    ASSERT_EQ(1u, executor.tasks.size());
+
+    // Each task runs a single layout, and posts the next one behind the other background work.
+    executor.runNext();
+    EXPECT_EQ(std::vector<int>({0}), order);
+    ASSERT_EQ(1u, executor.tasks.size());
+    executor.runNext();
+    EXPECT_EQ(std::vector<int>({0, 1}), order);
+    ASSERT_EQ(1u, executor.tasks.size());
+    // The last task finds the queue empty.
+    executor.runNext();
+    EXPECT_TRUE(executor.tasks.empty());
+    queue.waitForIdle();
+}
+
+TEST(DeferredLayoutQueueTest, destroyWithPendingTasks) {
+    // The pending tasks still run before the destructor returns.
+    auto queue = std::make_unique<TestableDeferredLayoutQueue>();
+    std::atomic<int> count(0);
+    queue->post([&count]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        count++;
+    });
+    queue->post([&count]() { count++; });
+    queue.reset();
+    EXPECT_EQ(2, count.load());
+}
+
+TEST(DeferredLayoutQueueTest, boundedQueue) {
+    HeldExecutor executor;
+    TestableDeferredLayoutQueue queue;
+    int count = 0;
+    for (size_t i = 0; i < DeferredLayoutQueue::kMaxPendingTasks; ++i) {
+        EXPECT_TRUE(queue.post([&count]() { count++; }));
+    }
+    // The rejected task is left to the caller.
+    std::function<void()> rejected = [&count]() { count += 100; };
+    EXPECT_FALSE(queue.post(std::move(rejected)));
+    ASSERT_TRUE(rejected);
+
+    // Room is made as the tasks run.
+    executor.runNext();
+    EXPECT_TRUE(queue.post([&count]() { count++; }));
+    while (!executor.tasks.empty()) {
+        executor.runNext();
+    }
+    EXPECT_EQ(static_cast<int>(DeferredLayoutQueue::kMaxPendingTasks) + 1, count);
+}
+
+}  // namespace
+}  // namespace minikin
@@ -19,6 +19,8 @@
 #include <gtest/gtest.h>
 #include <unicode/uchar.h>
 
+#include "EmojiSequence.h"
+
 namespace minikin {
 
 TEST(EmojiTest, isEmojiTest) {
@@ -121,4 +123,43 @@ TEST(EmojiTest, emojiBidiOverrideTest) {
     EXPECT_EQ(U_OTHER_NEUTRAL, emojiBidiOverride(nullptr, 0x1F9E6));  // SOCKS
 }
 
+// Returns, for each code point, whether it continues the emoji sequence of the previous ones.
+static std::vector<bool> recognize(std::initializer_list<uint32_t> codePoints) {
+    EmojiSequenceRecognizer recognizer;
+    std::vector<bool> result;
+    for (uint32_t c : codePoints) {
+        result.push_back(recognizer.next(c));
+    }
+    return result;
+}
+
+TEST(EmojiTest, emojiSequenceRecognizerTest) {
+    using V = std::vector<bool>;
+    // WOMAN ZWJ WOMAN ZWJ GIRL
+    EXPECT_EQ(V({false, true, true, true, true}),
+              recognize({0x1F469, 0x200D, 0x1F469, 0x200D, 0x1F467}));
+    // WOMAN, skin tone modifier, ZWJ, LAPTOP
+    EXPECT_EQ(V({false, true, true, true}), recognize({0x1F469, 0x1F3FD, 0x200D, 0x1F4BB}));
+    // WOMAN ZWJ STAFF OF AESCULAPIUS VS16
+    EXPECT_EQ(V({false, true, true, true}), recognize({0x1F469, 0x200D, 0x2695, 0xFE0F}));
+    // Two flags: US, JP.
+    EXPECT_EQ(V({false, true, false, true}), recognize({0x1F1FA, 0x1F1F8, 0x1F1EF, 0x1F1F5}));
+    // Keycaps, with and without VS16.
+    EXPECT_EQ(V({false, true, true}), recognize({'1', 0xFE0F, 0x20E3}));
+    EXPECT_EQ(V({false, true}), recognize({'#', 0x20E3}));
+    // The flag of England: WAVING BLACK FLAG, tags "gbeng", CANCEL TAG.
+    EXPECT_EQ(V({false, true, true, true, true, true, true}),
+              recognize({0x1F3F4, 0xE0067, 0xE0062, 0xE0065, 0xE006E, 0xE0067, 0xE007F}));
+
+    // Adjacent emoji are separate sequences.
+    EXPECT_EQ(V({false, false}), recognize({0x1F600, 0x1F601}));
+    // A ZWJ only joins emoji.
+    EXPECT_EQ(V({false, false, false}), recognize({'a', 0x200D, 0x1F469}));
+    EXPECT_EQ(V({false, true, false}), recognize({0x1F469, 0x200D, 'a'}));
+    // A modifier or a keycap without base starts a sequence, or is not part of one.
+    EXPECT_EQ(V({false, false, true}), recognize({'a', 0x1F3FB, 0x1F3FB}));
+    EXPECT_EQ(V({false, false}), recognize({'a', 0x20E3}));
+    EXPECT_EQ(V({false, false}), recognize({0x1F3F4, 0xE007F}));
+}
+
 }  // namespace minikin
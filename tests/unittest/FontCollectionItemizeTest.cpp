@@ -975,6 +975,51 @@ TEST(FontCollectionItemizeTest, itemize_LocaleScore) {
     }
 }
 
+TEST(FontCollectionItemizeTest, itemize_ManyLocaleLists) {
+    const std::vector<std::string> fontLocales = {"en-Latn", "ar-Arab", "bn-Beng", "ja-Jpan"};
+    std::vector<std::shared_ptr<FontFamily>> families;
+    std::unordered_map<MinikinFont*, int> fontLocaleIdxMap;
+    std::vector<std::shared_ptr<Font>> fonts;
+    fonts.push_back(Font::Builder(std::make_shared<FreeTypeMinikinFontForTest>(
+                                          getTestFontPath(kNoGlyphFont)))
+                            .build());
+    families.push_back(std::make_shared<FontFamily>(registerLocaleList("und"),
+                                                    FamilyVariant::DEFAULT, std::move(fonts),
+                                                    false /* isCustomFallback */));
+    for (size_t i = 0; i < fontLocales.size(); ++i) {
+        auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath(kJAFont));
+        std::vector<std::shared_ptr<Font>> fonts;
+        fonts.push_back(Font::Builder(minikinFont).build());
+        families.push_back(std::make_shared<FontFamily>(registerLocaleList(fontLocales[i]),
+                                                        FamilyVariant::DEFAULT, std::move(fonts),
+                                                        false /* isCustomFallback */));
+        fontLocaleIdxMap.insert(std::make_pair(minikinFont.get(), i));
+    }
+    std::shared_ptr<FontCollection> collection(new FontCollection(families));
+
+    // More locale lists than the collection keeps the locale scores for.
+    const struct {
+        std::string userPreferredLocale;
+        int selectedFontIndex;
+    } testCases[] = {
+            {"en-Latn", 0},         {"ar-Arab", 1},         {"bn-Beng", 2},
+            {"ja-Jpan", 3},         {"fr-Latn,ja-Jpan", 0}, {"ja-Jpan,fr-Latn", 3},
+            {"fa-Arab,en-Latn", 1}, {"as-Beng,ar-Arab", 2}, {"ja-Hira,bn-Beng", 3},
+            {"de-Latn,bn-Beng", 0},
+    };
+    for (int round = 0; round < 2; ++round) {
+        for (const auto& testCase : testCases) {
+            SCOPED_TRACE("Test of user preferred locale: \"" + testCase.userPreferredLocale +
+                         "\"");
+            auto runs = itemize(collection, "U+9AA8", testCase.userPreferredLocale);
+            ASSERT_EQ(1U, runs.size());
+            ASSERT_NE(nullptr, runs[0].fakedFont.font.get());
+            EXPECT_EQ(testCase.selectedFontIndex,
+                      fontLocaleIdxMap[runs[0].fakedFont.font.get()->typeface().get()]);
+        }
+    }
+}
+
 TEST(FontCollectionItemizeTest, itemize_LocaleAndCoverage) {
     struct TestCase {
         std::string testString;
@@ -1516,6 +1561,45 @@ TEST(FontCollectionItemizeTest, itemize_genderBalancedEmoji) {
     EXPECT_EQ(kColorEmojiFont, getFontName(runs[0]));
 }
 
+TEST(FontCollectionItemizeTest, itemize_emojiSequenceComponentWithVS) {
+    auto collection = buildFontCollectionFromXml(kEmojiXmlFile);
+
+    // U+2695 U+FE0E is only available in TextEmojiFont.ttf, so the text presentation requested
+    // for the component breaks the ZWJ sequence out of ColorEmojiFont.ttf.
+    auto runs = itemize(collection, "U+1F469 U+200D U+2695 U+FE0E");
+    ASSERT_EQ(2U, runs.size());
+    EXPECT_EQ(0, runs[0].start);
+    EXPECT_EQ(3, runs[0].end);
+    EXPECT_EQ(kColorEmojiFont, getFontName(runs[0]));
+    EXPECT_EQ(3, runs[1].start);
+    EXPECT_EQ(5, runs[1].end);
+    EXPECT_EQ(kTextEmojiFont, getFontName(runs[1]));
+}
+
+TEST(FontCollectionItemizeTest, itemize_emojiSequenceInSeveralColorEmojiFamilies) {
+    auto dummyFamily = buildFontFamily(kNoGlyphFont);
+    auto textEmojiFamily = buildFontFamily(kTextEmojiFont, "und-Zsye");
+    auto colorEmojiFamily = buildFontFamily(kColorEmojiFont, "und-Zsye");
+
+    std::vector<std::shared_ptr<FontFamily>> families = {dummyFamily, textEmojiFamily,
+                                                         colorEmojiFamily};
+    auto collection = std::make_shared<FontCollection>(families);
+
+    // Both families support U+2695 and U+2623, so the sequence stays in a single run.
+    auto runs = itemize(collection, "U+2695 U+200D U+2623");
+    ASSERT_EQ(1U, runs.size());
+    EXPECT_EQ(0, runs[0].start);
+    EXPECT_EQ(3, runs[0].end);
+
+    // Only TextEmojiFont.ttf has U+2623 U+FE0E, so the scored lookup of the component narrows the
+    // run to it.
+    runs = itemize(collection, "U+2695 U+200D U+2623 U+FE0E");
+    ASSERT_EQ(1U, runs.size());
+    EXPECT_EQ(0, runs[0].start);
+    EXPECT_EQ(4, runs[0].end);
+    EXPECT_EQ(textEmojiFamily->getFont(0), runs[0].fakedFont.font.get());
+}
+
 // For b/29585939
 TEST(FontCollectionItemizeTest, itemizeShouldKeepOrderForVS) {
     std::shared_ptr<FontFamily> dummyFamily = buildFontFamily(kNoGlyphFont);
@@ -1678,4 +1762,144 @@ TEST(FontCollectionItemizeTest, emojiFlagFallback) {
     EXPECT_EQ("OverrideEmojiFont", itemizeEmojiAndFontPostScriptName("U+1F1E6 U+1F1E7"));
 }
 
+TEST(FontCollectionItemizeTest, itemizeCacheTest) {
+    auto collection = buildFontCollectionFromXml(kItemizeFontXml);
+    const uint32_t jaId = registerLocaleList("ja-JP");
+    const uint32_t zhId = registerLocaleList("zh-Hans");
+    std::vector<uint16_t> text = utf8ToUtf16("abc \u81ED\u82B1\u5FCD def");
+    const CacheStats& stats = collection->getItemizeCacheStats();
+
+    auto expectSameRuns = [](const std::vector<FontCollection::Run>& expected,
+                             const std::vector<FontCollection::Run>& actual) {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(expected[i].start, actual[i].start);
+            EXPECT_EQ(expected[i].end, actual[i].end);
+            EXPECT_EQ(expected[i].familyMatch, actual[i].familyMatch);
+        }
+    };
+
+    auto jaRuns = collection->itemize(text, FontStyle(), jaId, FamilyVariant::DEFAULT);
+    EXPECT_EQ(0u, stats.hits());
+    EXPECT_EQ(1u, stats.misses());
+    expectSameRuns(jaRuns, collection->itemize(text, FontStyle(), jaId, FamilyVariant::DEFAULT));
+    EXPECT_EQ(1u, stats.hits());
+
+    // The locale list, the variant and the run limit are a part of the key.
+    auto zhRuns = collection->itemize(text, FontStyle(), zhId, FamilyVariant::DEFAULT);
+    EXPECT_FALSE(jaRuns[1].familyMatch == zhRuns[1].familyMatch);
+    collection->itemize(text, FontStyle(), jaId, FamilyVariant::ELEGANT);
+    auto limitedRuns = collection->itemize(text, FontStyle(), jaId, FamilyVariant::DEFAULT, 1);
+    EXPECT_EQ(1u, limitedRuns.size());
+    EXPECT_EQ(1u, stats.hits());
+    EXPECT_EQ(4u, stats.misses());
+
+    // A modified copy of the text is not a hit.
+    std::vector<uint16_t> modified = text;
+    modified.back() = 'x';
+    collection->itemize(modified, FontStyle(), jaId, FamilyVariant::DEFAULT);
+    EXPECT_EQ(1u, stats.hits());
+
+    // Long texts are not cached.
+    std::vector<uint16_t> longText(FontCollection::MAX_ITEMIZE_CACHE_TEXT_LENGTH + 1, 'a');
+    collection->itemize(longText, FontStyle(), jaId, FamilyVariant::DEFAULT);
+    collection->itemize(longText, FontStyle(), jaId, FamilyVariant::DEFAULT);
+    EXPECT_EQ(1u, stats.hits());
+    EXPECT_EQ(5u, stats.misses());
+}
+
+TEST(FontCollectionItemizeTest, fallbackTablePerLocaleTest) {
+    auto collection = buildFontCollectionFromXml(kItemizeFontXml);
+    const uint32_t jaId = registerLocaleList("ja-JP");
+    const uint32_t zhId = registerLocaleList("zh-Hans");
+    // Longer than the itemize cache limit, so that every call goes through the fallback table.
+    std::string utf8;
+    while (utf8.size() <= FontCollection::MAX_ITEMIZE_CACHE_TEXT_LENGTH * 3) {
+        utf8 += "ab \u81ED\u82B1\u5FCD ";
+    }
+    std::vector<uint16_t> text = utf8ToUtf16(utf8);
+
+    auto jaRuns = collection->itemize(text, FontStyle(), jaId, FamilyVariant::DEFAULT);
+    auto zhRuns = collection->itemize(text, FontStyle(), zhId, FamilyVariant::DEFAULT);
+    ASSERT_LT(1u, jaRuns.size());
+    ASSERT_EQ(jaRuns.size(), zhRuns.size());
+    EXPECT_FALSE(jaRuns[1].familyMatch == zhRuns[1].familyMatch);
+
+    // The second lookups are served by the tables and give the same results.
+    for (const auto& [localeId, expected] : {std::make_pair(jaId, jaRuns),
+                                             std::make_pair(zhId, zhRuns)}) {
+        auto runs = collection->itemize(text, FontStyle(), localeId, FamilyVariant::DEFAULT);
+        ASSERT_EQ(expected.size(), runs.size());
+        for (size_t i = 0; i < runs.size(); ++i) {
+            EXPECT_EQ(expected[i].start, runs[i].start);
+            EXPECT_EQ(expected[i].end, runs[i].end);
+            EXPECT_EQ(expected[i].familyMatch, runs[i].familyMatch);
+        }
+    }
+}
+
+TEST(FontCollectionItemizeTest, asciiFastPathTest) {
+    auto collection = buildFontCollectionFromXml(kItemizeFontXml);
+    const CacheStats& stats = collection->getItemizeCacheStats();
+    std::vector<uint16_t> text = utf8ToUtf16("Hello, world! (1 + 2 = 3) ~");
+
+    for (const char* locale : {"", "en-US", "ja-JP"}) {
+        for (FamilyVariant variant : {FamilyVariant::DEFAULT, FamilyVariant::ELEGANT}) {
+            auto runs = collection->itemize(text, FontStyle(), registerLocaleList(locale),
+                                            variant);
+            ASSERT_EQ(1u, runs.size());
+            EXPECT_EQ(0, runs[0].start);
+            EXPECT_EQ(static_cast<int>(text.size()), runs[0].end);
+            EXPECT_EQ(FontCollection::FamilyMatchResult::Builder().add(0).build(),
+                      runs[0].familyMatch);
+        }
+    }
+    // The printable ASCII text doesn't need the cache.
+    EXPECT_EQ(0u, stats.misses());
+
+    // A control character takes the slow path.
+    std::vector<uint16_t> textWithNewLine = utf8ToUtf16("Hello\n");
+    auto runs = collection->itemize(textWithNewLine, FontStyle(), registerLocaleList("en-US"),
+                                    FamilyVariant::DEFAULT);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(FontCollection::FamilyMatchResult::Builder().add(0).build(), runs[0].familyMatch);
+    EXPECT_EQ(1u, stats.misses());
+}
+
+TEST(FontCollectionItemizeTest, itemizeBatchTest) {
+    auto collection = buildFontCollectionFromXml(kItemizeFontXml);
+    const uint32_t localeListId = registerLocaleList("ja-JP");
+
+    std::vector<std::vector<uint16_t>> texts = {
+            utf8ToUtf16("Hello"),
+            utf8ToUtf16("あ一a"),
+            utf8ToUtf16(""),
+            utf8ToUtf16("aאbあ"),
+            utf8ToUtf16("Hello"),
+    };
+    std::vector<U16StringPiece> pieces(texts.begin(), texts.end());
+
+    FontCollection::ItemizedTexts batch;
+    // Stale contents must be replaced.
+    batch.offsets.push_back(42);
+    collection->itemizeBatch(pieces.data(), pieces.size(), FontStyle(), localeListId,
+                             FamilyVariant::DEFAULT, &batch);
+
+    ASSERT_EQ(texts.size() + 1, batch.offsets.size());
+    EXPECT_EQ(0u, batch.offsets[0]);
+    EXPECT_EQ(batch.runs.size(), batch.offsets.back());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        SCOPED_TRACE(i);
+        auto expected = collection->itemize(texts[i], FontStyle(), localeListId,
+                                            FamilyVariant::DEFAULT);
+        ASSERT_EQ(expected.size(), batch.offsets[i + 1] - batch.offsets[i]);
+        for (size_t j = 0; j < expected.size(); ++j) {
+            const FontCollection::Run& run = batch.runs[batch.offsets[i] + j];
+            EXPECT_EQ(expected[j].start, run.start);
+            EXPECT_EQ(expected[j].end, run.end);
+            EXPECT_EQ(expected[j].familyMatch, run.familyMatch);
+        }
+    }
+}
+
 }  // namespace minikin
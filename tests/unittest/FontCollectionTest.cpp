@@ -16,11 +16,15 @@
 
 #include "minikin/FontCollection.h"
 
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "FontTestUtils.h"
 #include "FreeTypeMinikinFontForTest.h"
 #include "MinikinInternal.h"
+#include "UnicodeUtils.h"
 
 namespace minikin {
 
@@ -110,6 +114,23 @@ TEST(FontCollectionTest, hasVariationSelectorTest_emoji) {
     EXPECT_FALSE(collection->hasVariationSelector(0x2229, 0xFE0F));
 }
 
+TEST(FontCollectionTest, hasVariationSelectorTest_multipleFamilies) {
+    // The sequences of the families are merged, regardless of the family order.
+    std::vector<std::shared_ptr<FontFamily>> families = {buildFontFamily("TextEmojiFont.ttf"),
+                                                         buildFontFamily(kVsTestFont),
+                                                         buildFontFamily("ColorEmojiFont.ttf")};
+    auto collection = std::make_shared<FontCollection>(families);
+    expectVSGlyphs(collection.get(), 0x82A6,
+                   std::set<uint32_t>({0xFE00, 0xFE0E, 0xE0100, 0xE0101, 0xE0102}));
+    expectVSGlyphs(collection.get(), 0x717D, std::set<uint32_t>({0xFE02, 0xE0102, 0xE0103}));
+
+    EXPECT_TRUE(collection->hasVariationSelector(0x2623, 0xFE0E));
+    EXPECT_TRUE(collection->hasVariationSelector(0x2623, 0xFE0F));
+    EXPECT_TRUE(collection->hasVariationSelector(0x262A, 0xFE0F));
+    EXPECT_FALSE(collection->hasVariationSelector(0x2626, 0xFE0F));
+    EXPECT_FALSE(collection->hasVariationSelector(0x2229, 0xFE0E));
+}
+
 TEST(FontCollectionTest, newEmojiTest) {
     auto collection = buildFontCollectionFromXml(kEmojiXmlFile);
 
@@ -187,6 +208,68 @@ std::vector<uint8_t> writeToBuffer(
     return buffer;
 }
 
+TEST(FontCollectionTest, createWithVariations_cache) {
+    // This font has 'wdth' and 'wght' axes.
+    std::shared_ptr<FontCollection> fc = buildFontCollection("MultiAxis.ttf");
+    const CacheStats& stats = fc->getVariationCacheStats();
+    const AxisTag wdth = MinikinFont::MakeTag('w', 'd', 't', 'h');
+    const AxisTag wght = MinikinFont::MakeTag('w', 'g', 'h', 't');
+    const AxisTag slnt = MinikinFont::MakeTag('s', 'l', 'n', 't');
+
+    std::shared_ptr<FontCollection> newFc = fc->createCollectionWithVariation({{wdth, 1.0f}});
+    ASSERT_NE(nullptr, newFc.get());
+    EXPECT_EQ(1u, stats.misses());
+
+    // The same settings return the same instance, thus the same layout cache entries.
+    std::shared_ptr<FontCollection> sameFc = fc->createCollectionWithVariation({{wdth, 1.0f}});
+    EXPECT_EQ(newFc.get(), sameFc.get());
+    EXPECT_EQ(newFc->getId(), sameFc->getId());
+    EXPECT_EQ(1u, stats.hits());
+
+    // The axis order and the unsupported axes don't matter.
+    std::shared_ptr<FontCollection> bothFc =
+            fc->createCollectionWithVariation({{wght, 2.0f}, {wdth, 1.0f}});
+    EXPECT_NE(newFc.get(), bothFc.get());
+    EXPECT_EQ(bothFc.get(),
+              fc->createCollectionWithVariation({{wdth, 1.0f}, {slnt, 3.0f}, {wght, 2.0f}}).get());
+
+    // A different value creates a new instance.
+    EXPECT_NE(newFc.get(), fc->createCollectionWithVariation({{wdth, 2.0f}}).get());
+    EXPECT_EQ(3u, stats.misses());
+    EXPECT_EQ(2u, stats.hits());
+}
+
+TEST(FontCollectionTest, getMemoryUsage) {
+    std::shared_ptr<FontCollection> fc = buildFontCollection("MultiAxis.ttf");
+    const size_t usage = fc->getMemoryUsage();
+    EXPECT_LT(sizeof(FontCollection), usage);
+
+    // The collections created with variations are kept by the collection.
+    const AxisTag wdth = MinikinFont::MakeTag('w', 'd', 't', 'h');
+    std::shared_ptr<FontCollection> newFc = fc->createCollectionWithVariation({{wdth, 1.0f}});
+    ASSERT_NE(nullptr, newFc.get());
+    EXPECT_LE(usage + newFc->getMemoryUsage(), fc->getMemoryUsage());
+}
+
+TEST(FontCollectionTest, hasFakeBoldTest) {
+    std::shared_ptr<FontCollection> regular = buildFontCollection("Ascii.ttf");
+    EXPECT_FALSE(regular->hasFakeBold(FontStyle(FontStyle::Weight::NORMAL)));
+    EXPECT_FALSE(regular->hasFakeBold(FontStyle(FontStyle::Weight::MEDIUM)));
+    EXPECT_TRUE(regular->hasFakeBold(FontStyle(FontStyle::Weight::SEMI_BOLD)));
+    EXPECT_TRUE(regular->hasFakeBold(FontStyle(FontStyle::Weight::BOLD)));
+    // The memoized result is returned again.
+    EXPECT_TRUE(regular->hasFakeBold(FontStyle(FontStyle::Weight::BOLD)));
+
+    std::shared_ptr<FontCollection> bold = buildFontCollection("Bold.ttf");
+    EXPECT_FALSE(bold->hasFakeBold(FontStyle(FontStyle::Weight::BOLD)));
+    EXPECT_FALSE(bold->hasFakeBold(FontStyle(FontStyle::Weight::BLACK)));
+
+    // Any family faking bold counts.
+    auto mixed = std::make_shared<FontCollection>(std::vector<std::shared_ptr<FontFamily>>{
+            buildFontFamily("Bold.ttf"), buildFontFamily("Ascii.ttf")});
+    EXPECT_TRUE(mixed->hasFakeBold(FontStyle(FontStyle::Weight::BOLD)));
+}
+
 TEST(FontCollectionTest, bufferTest) {
     {
         std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kVsTestFont)});
@@ -229,11 +312,162 @@ TEST(FontCollectionTest, bufferTest) {
                   copied[0]->getSupportedTags().count(MinikinFont::MakeTag('w', 'd', 't', 'h')));
         EXPECT_EQ(1u,
                   copied[0]->getSupportedTags().count(MinikinFont::MakeTag('w', 'g', 'h', 't')));
+        const std::vector<AxisTag> expectedAxes = {MinikinFont::MakeTag('w', 'd', 't', 'h'),
+                                                   MinikinFont::MakeTag('w', 'g', 'h', 't')};
+        EXPECT_EQ(expectedAxes, copied[0]->getSortedSupportedTags());
+        EXPECT_TRUE(copied[0]->isAxisSupported(MinikinFont::MakeTag('w', 'd', 't', 'h')));
+        EXPECT_TRUE(copied[0]->isAxisSupported(MinikinFont::MakeTag('w', 'g', 'h', 't')));
+        EXPECT_FALSE(copied[0]->isAxisSupported(MinikinFont::MakeTag('s', 'l', 'n', 't')));
         std::vector<uint8_t> newBuffer = writeToBuffer(copied);
         EXPECT_EQ(buffer, newBuffer);
     }
 }
 
+TEST(FontCollectionTest, validateVectorTest) {
+    std::vector<std::shared_ptr<FontFamily>> families = {buildFontFamily(kVsTestFont)};
+    std::vector<uint8_t> buffer = writeToBuffer(
+            {buildFontCollection("MultiAxis.ttf"), std::make_shared<FontCollection>(families),
+             std::make_shared<FontCollection>(families)});
+    EXPECT_TRUE(FontCollection::validateVector(buffer.data(), buffer.size()));
+
+    for (size_t truncated = 0; truncated < buffer.size(); truncated++) {
+        EXPECT_FALSE(FontCollection::validateVector(buffer.data(), truncated)) << truncated;
+    }
+
+    // A buffer of another version is rejected by both.
+    std::vector<uint8_t> otherVersion = buffer;
+    otherVersion[sizeof(uint32_t)]++;
+    EXPECT_FALSE(FontCollection::validateVector(otherVersion.data(), otherVersion.size()));
+    BufferReader reader(otherVersion.data());
+    EXPECT_TRUE(FontCollection::readVector<readFreeTypeMinikinFontForTest>(&reader).empty());
+}
+
+TEST(FontCollectionTest, bufferTest_sharedCoveragePages) {
+    // Two families of the same font have the same coverage, whose pages are written once.
+    auto fc1 = std::make_shared<FontCollection>(buildFontFamily(kVsTestFont));
+    auto fc2 = std::make_shared<FontCollection>(
+            std::vector<std::shared_ptr<FontFamily>>{buildFontFamily(kVsTestFont),
+                                                     buildFontFamily(kVsTestFont)});
+    std::vector<uint8_t> oneFamilyBuffer = writeToBuffer({fc1});
+    std::vector<uint8_t> buffer = writeToBuffer({fc2});
+    BufferWriter familyWriter(nullptr);
+    fc1->getFamilies()[0]->writeTo<writeFreeTypeMinikinFontForTest>(&familyWriter);
+    EXPECT_LT(buffer.size(), oneFamilyBuffer.size() + familyWriter.size());
+
+    BufferReader reader(buffer.data());
+    auto copied = FontCollection::readVector<readFreeTypeMinikinFontForTest>(&reader);
+    ASSERT_EQ(1u, copied.size());
+    expectVSGlyphsForVsTestFont(copied[0].get());
+    EXPECT_EQ(buffer, writeToBuffer(copied));
+}
+
+TEST(FontCollectionTest, vectorReaderTest) {
+    std::vector<std::shared_ptr<FontFamily>> families = {buildFontFamily(kVsTestFont)};
+    std::vector<std::shared_ptr<FontCollection>> original(
+            {buildFontCollection("MultiAxis.ttf"), std::make_shared<FontCollection>(families),
+             std::make_shared<FontCollection>(families)});
+    std::vector<uint8_t> buffer = writeToBuffer(original);
+
+    FontCollection::VectorReader<readFreeTypeMinikinFontForTest> reader(
+            BufferReader(buffer.data()));
+    ASSERT_EQ(3u, reader.size());
+    // The collections can be read in any order, and are read once.
+    std::shared_ptr<FontCollection> third = reader.get(2);
+    expectVSGlyphsForVsTestFont(third.get());
+    EXPECT_EQ(third, reader.get(2));
+    std::shared_ptr<FontCollection> second = reader.get(1);
+    EXPECT_EQ(second->getFamilies()[0], third->getFamilies()[0]);
+    std::shared_ptr<FontCollection> first = reader.get(0);
+    EXPECT_EQ(original[0]->getSupportedTags(), first->getSupportedTags());
+
+    EXPECT_EQ(buffer, writeToBuffer({first, second, third}));
+
+    // A buffer of another version has no collections.
+    std::vector<uint8_t> otherVersion = buffer;
+    otherVersion[sizeof(uint32_t)]++;
+    FontCollection::VectorReader<readFreeTypeMinikinFontForTest> otherReader(
+            BufferReader(otherVersion.data()));
+    EXPECT_EQ(0u, otherReader.size());
+}
+
+TEST(FontCollectionTest, parallelInitTest) {
+    std::vector<std::shared_ptr<FontFamily>> families =
+            getFontFamilies(getTestDataDir(), getTestDataDir() + "itemize.xml");
+    // This font reaches the variation selectors supplement, i.e. thousands of pages.
+    families.push_back(buildFontFamily(kVsTestFont));
+
+    std::vector<uint8_t> serialBuffer =
+            writeToBuffer({std::make_shared<FontCollection>(families)});
+    for (uint32_t threadCount : {0u, 1u, 2u, 3u, 8u, 1000u}) {
+        SCOPED_TRACE(threadCount);
+        std::vector<uint8_t> parallelBuffer =
+                writeToBuffer({std::make_shared<FontCollection>(families, threadCount)});
+        EXPECT_EQ(serialBuffer, parallelBuffer);
+    }
+}
+
+TEST(FontCollectionTest, createCollectionWithFamiliesTest) {
+    std::vector<std::shared_ptr<FontFamily>> families =
+            getFontFamilies(getTestDataDir(), getTestDataDir() + "itemize.xml");
+    // This font reaches the variation selectors supplement, i.e. thousands of pages.
+    families.push_back(buildFontFamily(kVsTestFont));
+
+    std::vector<uint8_t> fullBuffer = writeToBuffer({std::make_shared<FontCollection>(families)});
+    for (size_t parentCount = 1; parentCount < families.size(); ++parentCount) {
+        SCOPED_TRACE(parentCount);
+        auto parent = std::make_shared<FontCollection>(std::vector<std::shared_ptr<FontFamily>>(
+                families.begin(), families.begin() + parentCount));
+        auto derived = parent->createCollectionWithFamilies(
+                std::vector<std::shared_ptr<FontFamily>>(families.begin() + parentCount,
+                                                         families.end()));
+        EXPECT_NE(parent->getId(), derived->getId());
+        EXPECT_EQ(fullBuffer, writeToBuffer({derived}));
+    }
+}
+
+TEST(FontCollectionTest, compressedRangesTest) {
+    std::vector<std::shared_ptr<FontFamily>> families =
+            getFontFamilies(getTestDataDir(), getTestDataDir() + "itemize.xml");
+    // This font reaches the variation selectors supplement, i.e. thousands of pages.
+    families.push_back(buildFontFamily(kVsTestFont));
+    auto fc = std::make_shared<FontCollection>(families);
+
+    // Most of the pages are empty, and their blocks are stored once.
+    const uint32_t pageCount = (fc->mMaxChar + 0xFF) >> 8;
+    EXPECT_LT(fc->mRangesCount, pageCount / 4);
+    for (uint32_t page = 0; page < pageCount; page++) {
+        std::vector<uint8_t> expected;
+        for (size_t i = 0; i < fc->mFamilies.size(); i++) {
+            if (fc->mFamilies[i]->getCoverage().intersectsPage(page)) {
+                expected.push_back(i);
+            }
+        }
+        const FontCollection::Range& range = fc->getRange(page);
+        EXPECT_EQ(expected, std::vector<uint8_t>(fc->mFamilyVec + range.start,
+                                                 fc->mFamilyVec + range.end))
+                << std::hex << page;
+    }
+}
+
+TEST(FontCollectionTest, getLayoutCacheIdTest) {
+    // Regular.ttf covers a-z and Ja.ttf covers U+3042, U+3044, U+3046 and U+3048.
+    auto parent = std::make_shared<FontCollection>(buildFontFamily("Regular.ttf"));
+    auto derived = parent->createCollectionWithFamilies({buildFontFamily("Ja.ttf", "ja")});
+    auto grandchild = derived->createCollectionWithFamilies({buildFontFamily("Ko.ttf", "ko")});
+
+    EXPECT_EQ(parent->getId(), parent->getLayoutCacheId(utf8ToUtf16("abc")));
+
+    // The new families only change the fallback of the characters they cover.
+    EXPECT_EQ(parent->getId(), derived->getLayoutCacheId(utf8ToUtf16("abc")));
+    EXPECT_EQ(derived->getId(), derived->getLayoutCacheId(utf8ToUtf16("a\u3042")));
+    EXPECT_EQ(parent->getId(), grandchild->getLayoutCacheId(utf8ToUtf16("abc")));
+    EXPECT_EQ(derived->getId(), grandchild->getLayoutCacheId(utf8ToUtf16("a\u3042")));
+    EXPECT_EQ(grandchild->getId(), grandchild->getLayoutCacheId(utf8ToUtf16("a\uB300\u3042")));
+
+    // The characters no family covers fall back to their decompositions.
+    EXPECT_EQ(derived->getId(), derived->getLayoutCacheId(utf8ToUtf16("a\u00E9")));
+}
+
 TEST(FontCollectionTest, FamilyMatchResultBuilderTest) {
     using Builder = FontCollection::FamilyMatchResult::Builder;
     EXPECT_TRUE(Builder().empty());
@@ -265,21 +499,69 @@ TEST(FontCollectionTest, FamilyMatchResultTest) {
     EXPECT_EQ(2u, r[1]);
 }
 
-TEST(FontCollectionTest, FamilyMatchResultTest_BuilderHoldeFirst7) {
+TEST(FontCollectionTest, FamilyMatchResultTest_BuilderHoldsAll) {
     auto b = FontCollection::FamilyMatchResult::Builder();
     for (uint8_t i = 0; i < 128; ++i) {
         b.add(i);
     }
     auto r = b.build();
-    EXPECT_EQ(7u, r.size());
+    EXPECT_EQ(128u, r.size());
     EXPECT_FALSE(r.empty());
-    EXPECT_EQ(0u, r[0]);
-    EXPECT_EQ(1u, r[1]);
-    EXPECT_EQ(2u, r[2]);
-    EXPECT_EQ(3u, r[3]);
-    EXPECT_EQ(4u, r[4]);
-    EXPECT_EQ(5u, r[5]);
-    EXPECT_EQ(6u, r[6]);
+    for (uint8_t i = 0; i < 128; ++i) {
+        EXPECT_EQ(i, r[i]);
+    }
+}
+
+TEST(FontCollectionTest, FamilyMatchResultTest_overflowEquality) {
+    auto build = [](uint8_t first, uint8_t count) {
+        auto b = FontCollection::FamilyMatchResult::Builder();
+        for (uint8_t i = 0; i < count; ++i) {
+            b.add(first + i);
+        }
+        return b.build();
+    };
+    // The large results are interned, so the equal ones have the equal bits.
+    EXPECT_EQ(build(0, 10), build(0, 10));
+    EXPECT_FALSE(build(0, 10) == build(1, 10));
+    EXPECT_FALSE(build(0, 10) == build(0, 11));
+    EXPECT_FALSE(build(0, 7) == build(0, 8));
+
+    EXPECT_EQ(build(5, 9), FontCollection::FamilyMatchResult::intersect(build(0, 20), build(5, 9)));
+    EXPECT_EQ(build(5, 3), FontCollection::FamilyMatchResult::intersect(build(0, 8), build(5, 10)));
+}
+
+TEST(FontCollectionTest, FamilyMatchResultTest_overflowFromThreads) {
+    auto build = [](uint8_t first, uint8_t count) {
+        auto b = FontCollection::FamilyMatchResult::Builder();
+        for (uint8_t i = 0; i < count; ++i) {
+            b.add(first + i);
+        }
+        return b.build();
+    };
+    // The threads intern the same new results at once, and all get the same ones.
+    constexpr int kThreadCount = 8;
+    constexpr uint8_t kResultCount = 32;
+    std::vector<std::vector<FontCollection::FamilyMatchResult>> results(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i]() {
+            for (uint8_t first = 0; first < kResultCount; ++first) {
+                results[i].push_back(build(100 + first, 20));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int i = 0; i < kThreadCount; ++i) {
+        ASSERT_EQ(kResultCount, results[i].size());
+        for (uint8_t first = 0; first < kResultCount; ++first) {
+            EXPECT_EQ(results[0][first], results[i][first]);
+            EXPECT_EQ(20u, results[i][first].size());
+            EXPECT_EQ(100 + first, results[i][first][0]);
+            EXPECT_EQ(100 + first + 19, results[i][first][19]);
+        }
+    }
 }
 
 TEST(FontCollectionTest, FamilyMatchResultTest_iterator) {
@@ -18,6 +18,7 @@
 
 #include <gtest/gtest.h>
 
+#include "minikin/FontCoverageCache.h"
 #include "minikin/LocaleList.h"
 
 #include "BufferUtils.h"
@@ -129,6 +130,33 @@ TEST(LocaleTest, invalidLanguageTagTest) {  // just make sure no crash happens
     LocaleListCache::getId("ja-JP-u-lb-lb-strict");
 }
 
+TEST(LocaleTest, unicodeExtensionTest) {
+    // Other keywords may precede the line break and emoji keywords.
+    Locale locale = createLocaleWithoutICUSanitization("ja-JP-u-ca-japanese-lb-strict-em-text");
+    EXPECT_EQ("ja-JP-u-lb-strict", locale.getString());
+    EXPECT_EQ(EmojiStyle::TEXT, locale.getEmojiStyle());
+
+    // Only the first occurrence of a keyword is used.
+    locale = createLocaleWithoutICUSanitization("ja-JP-u-lb-loose-u-lb-strict-em-emoji");
+    EXPECT_EQ("ja-JP-u-lb-loose", locale.getString());
+    EXPECT_EQ(EmojiStyle::EMOJI, locale.getEmojiStyle());
+
+    // A key without a known type is ignored.
+    locale = createLocaleWithoutICUSanitization("ja-JP-u-lb-em-emoji");
+    EXPECT_EQ("ja-JP", locale.getString());
+    EXPECT_EQ(EmojiStyle::EMOJI, locale.getEmojiStyle());
+
+    // Keywords are whole subtags.
+    locale = createLocaleWithoutICUSanitization("ja-JP-u-xlb-loose-xem-emoji");
+    EXPECT_EQ("ja-JP", locale.getString());
+    EXPECT_EQ(EmojiStyle::EMPTY, locale.getEmojiStyle());
+
+    // Keywords outside of the Unicode extension are ignored.
+    locale = createLocaleWithoutICUSanitization("ja-JP-lb-loose-em-emoji");
+    EXPECT_EQ("ja-JP", locale.getString());
+    EXPECT_EQ(EmojiStyle::EMPTY, locale.getEmojiStyle());
+}
+
 TEST(LocaleTest, testReconstruction) {
     EXPECT_EQ("en", createLocaleWithoutICUSanitization("en").getString());
     EXPECT_EQ("fil", createLocaleWithoutICUSanitization("fil").getString());
@@ -627,6 +655,11 @@ TEST_F(FontFamilyTest, createFamilyWithVariationTest) {
         EXPECT_NE(nullptr, newFamily.get());
         EXPECT_NE(multiAxisFamily.get(), newFamily.get());
         EXPECT_EQ(nullptr, noAxisFamily->createFamilyWithVariation(variations));
+
+        // Font variations don't change cmap, so the coverage is shared.
+        EXPECT_EQ(&multiAxisFamily->getCoverage(), &newFamily->getCoverage());
+        EXPECT_EQ(&multiAxisFamily->getVSCoverage(), &newFamily->getVSCoverage());
+        EXPECT_EQ(multiAxisFamily->supportedAxes(), newFamily->supportedAxes());
     }
     {
         // New instance should be used for supported variation. (multiple variations case)
@@ -794,6 +827,37 @@ TEST_F(FontFamilyTest, closestMatch) {
     }
 }
 
+TEST_F(FontFamilyTest, closestMatchCacheTest) {
+    std::vector<std::shared_ptr<Font>> fonts;
+    for (uint16_t weight : {300, 400, 700}) {
+        for (FontStyle::Slant slant : {FontStyle::Slant::UPRIGHT, FontStyle::Slant::ITALIC}) {
+            auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(
+                    getTestFontPath("Ascii.ttf"));
+            fonts.push_back(Font::Builder(minikinFont).setStyle(FontStyle(weight, slant)).build());
+        }
+    }
+    std::vector<std::shared_ptr<Font>> familyFonts = fonts;
+    FontFamily family(std::move(familyFonts));
+
+    // Includes the styles sharing a cache slot, e.g. 300 and 700, and the non-standard weights.
+    const std::vector<FontStyle> wantedStyles = {
+            FontStyle(300, FontStyle::Slant::UPRIGHT), FontStyle(700, FontStyle::Slant::UPRIGHT),
+            FontStyle(350, FontStyle::Slant::ITALIC),  FontStyle(900, FontStyle::Slant::ITALIC),
+            FontStyle(400, FontStyle::Slant::ITALIC),  FontStyle(1000, FontStyle::Slant::UPRIGHT),
+    };
+    for (int round = 0; round < 3; ++round) {
+        for (FontStyle style : wantedStyles) {
+            // A new family has nothing cached for the style.
+            std::vector<std::shared_ptr<Font>> uncachedFonts = fonts;
+            FontFamily uncached(std::move(uncachedFonts));
+            FakedFont expected = uncached.getClosestMatch(style);
+            FakedFont actual = family.getClosestMatch(style);
+            EXPECT_EQ(expected.font, actual.font) << fontStyleToString(style);
+            EXPECT_EQ(expected.fakery, actual.fakery) << fontStyleToString(style);
+        }
+    }
+}
+
 TEST_F(FontFamilyTest, bufferTest) {
     {
         // Font with variation selectors
@@ -825,10 +889,120 @@ TEST_F(FontFamilyTest, bufferTest) {
         std::shared_ptr<FontFamily> copied =
                 FontFamily::readFrom<readFreeTypeMinikinFontForTest>(&reader);
         ASSERT_EQ(original->supportedAxes(), copied->supportedAxes());
+        // The axes of the copy are read from the buffer in place.
+        EXPECT_TRUE(copied->isAxisSupported(MinikinFont::MakeTag('w', 'd', 't', 'h')));
+        EXPECT_TRUE(copied->isAxisSupported(MinikinFont::MakeTag('w', 'g', 'h', 't')));
+        EXPECT_FALSE(copied->isAxisSupported(MinikinFont::MakeTag('Z', 'Z', 'Z', 'Z')));
         std::vector<uint8_t> newBuffer =
                 writeToBuffer<FontFamily, writeFreeTypeMinikinFontForTest>(*copied);
         ASSERT_EQ(buffer, newBuffer);
     }
 }
 
+TEST_F(FontFamilyTest, supportedAxesTest) {
+    std::shared_ptr<FontFamily> family = buildFontFamily("MultiAxis.ttf");
+    const std::vector<AxisTag> expected = {MinikinFont::MakeTag('w', 'd', 't', 'h'),
+                                           MinikinFont::MakeTag('w', 'g', 'h', 't')};
+    EXPECT_EQ(expected, family->getSortedSupportedAxes());
+    EXPECT_EQ(std::unordered_set<AxisTag>(expected.begin(), expected.end()),
+              family->supportedAxes());
+    // The set is built once.
+    EXPECT_EQ(&family->supportedAxes(), &family->supportedAxes());
+}
+
+TEST_F(FontFamilyTest, coverageCacheTest) {
+    FontCoverageCache::clear();
+    const std::string vsFontPath = getTestFontPath(kVsTestFont);
+    std::shared_ptr<FontFamily> original = buildFontFamily(kVsTestFont);
+    std::shared_ptr<const std::vector<uint8_t>> blob = FontCoverageCache::getBlob(vsFontPath, 0);
+    ASSERT_NE(nullptr, blob);
+
+    // The second family of the same file reads its coverage from the blob.
+    std::shared_ptr<FontFamily> cached = buildFontFamily(kVsTestFont);
+    EXPECT_EQ(writeToBuffer(original->getCoverage()), writeToBuffer(cached->getCoverage()));
+    expectVSGlyphsForVsTestFont(cached.get());
+
+    // Give the Ascii font the coverage of the VS test font, keeping the file size and revision
+    // of the Ascii font, to make sure that the blob is used instead of the cmap.
+    const std::string asciiPath = getTestFontPath("Ascii.ttf");
+    std::shared_ptr<FontFamily> ascii = buildFontFamily("Ascii.ttf");
+    std::shared_ptr<const std::vector<uint8_t>> asciiBlob =
+            FontCoverageCache::getBlob(asciiPath, 0);
+    ASSERT_NE(nullptr, asciiBlob);
+    constexpr size_t kHeaderSize = 3 * sizeof(uint32_t);
+    std::vector<uint8_t> forged(asciiBlob->begin(), asciiBlob->begin() + kHeaderSize);
+    forged.insert(forged.end(), blob->begin() + kHeaderSize, blob->end());
+    FontCoverageCache::putBlob(asciiPath, 0, std::move(forged));
+    std::shared_ptr<FontFamily> forgedAscii = buildFontFamily("Ascii.ttf");
+    EXPECT_EQ(writeToBuffer(original->getCoverage()), writeToBuffer(forgedAscii->getCoverage()));
+
+    // A blob of another file is stale, so the cmap is parsed and the blob is replaced.
+    FontCoverageCache::putBlob(asciiPath, 0, std::vector<uint8_t>(*blob));
+    std::shared_ptr<FontFamily> reparsed = buildFontFamily("Ascii.ttf");
+    EXPECT_EQ(writeToBuffer(ascii->getCoverage()), writeToBuffer(reparsed->getCoverage()));
+    EXPECT_EQ(*asciiBlob, *FontCoverageCache::getBlob(asciiPath, 0));
+
+    // A truncated blob of the same file is invalid, so the cmap is parsed too.
+    std::vector<uint8_t> truncated(asciiBlob->begin(), asciiBlob->end() - 1);
+    FontCoverageCache::putBlob(asciiPath, 0, std::move(truncated));
+    std::shared_ptr<FontFamily> untruncated = buildFontFamily("Ascii.ttf");
+    EXPECT_EQ(writeToBuffer(ascii->getCoverage()), writeToBuffer(untruncated->getCoverage()));
+    EXPECT_EQ(*asciiBlob, *FontCoverageCache::getBlob(asciiPath, 0));
+    FontCoverageCache::clear();
+}
+
+TEST_F(FontFamilyTest, coverageCacheEvictionTest) {
+    FontCoverageCache::clear();
+    for (uint32_t i = 0; i <= FontCoverageCache::kMaxEntries; ++i) {
+        FontCoverageCache::putBlob("/fonts/" + std::to_string(i), 0, std::vector<uint8_t>(1, i));
+    }
+    // The least recently used blob is evicted.
+    EXPECT_EQ(nullptr, FontCoverageCache::getBlob("/fonts/0", 0));
+    EXPECT_NE(nullptr, FontCoverageCache::getBlob("/fonts/1", 0));
+    EXPECT_NE(nullptr, FontCoverageCache::getBlob(
+                               "/fonts/" + std::to_string(FontCoverageCache::kMaxEntries), 0));
+    FontCoverageCache::clear();
+}
+
+TEST_F(FontFamilyTest, buildFontFamiliesTest) {
+    const char* kFonts[] = {kVsTestFont, "MultiAxis.ttf", "Ascii.ttf", "Bold.ttf", "Italic.ttf"};
+    std::vector<FontFamilySpec> specs;
+    for (const char* fontName : kFonts) {
+        FontFamilySpec spec;
+        auto typeface = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath(fontName));
+        spec.fonts.push_back(Font::Builder(typeface));
+        // The overridden style is kept.
+        spec.fonts.push_back(
+                Font::Builder(typeface).setStyle(FontStyle(300, FontStyle::Slant::ITALIC)));
+        spec.variant = FamilyVariant::ELEGANT;
+        specs.push_back(std::move(spec));
+    }
+    specs[1].isCustomFallback = true;
+
+    std::vector<std::shared_ptr<FontFamily>> expected;
+    for (const FontFamilySpec& spec : specs) {
+        std::vector<std::shared_ptr<Font>> fonts;
+        for (Font::Builder builder : spec.fonts) {
+            fonts.push_back(builder.build());
+        }
+        expected.push_back(std::make_shared<FontFamily>(spec.localeListId, spec.variant,
+                                                        std::move(fonts), spec.isCustomFallback));
+    }
+
+    for (uint32_t maxThreads : {0u, 1u, 2u, 8u}) {
+        SCOPED_TRACE(maxThreads);
+        std::vector<std::shared_ptr<FontFamily>> families = buildFontFamilies(specs, maxThreads);
+        ASSERT_EQ(expected.size(), families.size());
+        for (size_t i = 0; i < families.size(); i++) {
+            std::vector<uint8_t> expectedBuffer =
+                    writeToBuffer<FontFamily, writeFreeTypeMinikinFontForTest>(*expected[i]);
+            std::vector<uint8_t> buffer =
+                    writeToBuffer<FontFamily, writeFreeTypeMinikinFontForTest>(*families[i]);
+            EXPECT_EQ(expectedBuffer, buffer);
+        }
+    }
+    EXPECT_EQ(FontStyle(300, FontStyle::Slant::ITALIC),
+              buildFontFamilies(specs)[0]->getStyle(1));
+}
+
 }  // namespace minikin
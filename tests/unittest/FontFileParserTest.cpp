@@ -43,8 +43,43 @@ class TestableFontFileParser : public FontFileParser {
 public:
     using FontFileParser::analyzeFontRevision;
     using FontFileParser::checkPSName;
+    using FontFileParser::parseTableDirectory;
+    using FontFileParser::TableRecord;
 };
 
+const uint32_t kHeadTag = MinikinFont::MakeTag('h', 'e', 'a', 'd');
+const uint32_t kOS2Tag = MinikinFont::MakeTag('O', 'S', '/', '2');
+const uint32_t kCFFTag = MinikinFont::MakeTag('C', 'F', 'F', ' ');
+
+// Appends a font of the given tables to the file, with the table directory in the given order.
+static void appendFont(const std::vector<std::pair<uint32_t, std::vector<uint8_t>>>& tables,
+                       std::vector<uint8_t>* out) {
+    const size_t start = out->size();
+    size_t tableOffset = start + 12 + 16 * tables.size();
+    out->resize(tableOffset);
+    size_t pos = writeU32(0x00010000, out->data(), start);  // sfntVersion
+    pos = writeU16(tables.size(), out->data(), pos);        // numTables
+    pos += 6;  // searchRange, entrySelector, rangeShift
+    for (const auto& [tag, table] : tables) {
+        pos = writeU32(tag, out->data(), pos);
+        pos = writeU32(0, out->data(), pos);  // checksum
+        pos = writeU32(tableOffset, out->data(), pos);
+        pos = writeU32(table.size(), out->data(), pos);
+        tableOffset += table.size();
+    }
+    for (const auto& table : tables) {
+        out->insert(out->end(), table.second.begin(), table.second.end());
+    }
+}
+
+// Returns an OS/2 table of the given weight and italic.
+static std::vector<uint8_t> buildOS2Table(uint16_t weight, bool italic) {
+    std::vector<uint8_t> out(78);
+    writeU16(weight, out.data(), 4);          // usWeightClass
+    writeU16(italic ? 1 : 0, out.data(), 62);  // fsSelection
+    return out;
+}
+
 // Returns valid head table contents.
 static std::vector<uint8_t> buildHeadTable(uint32_t fontRevision) {
     std::vector<uint8_t> out(46);
@@ -96,6 +131,104 @@ TEST(FontFileParserTest, parseFontForRev) {
     EXPECT_EQ(0x00010000u, revision.value());
 }
 
+TEST(FontFileParserTest, parseTableDirectory) {
+    std::vector<uint8_t> file;
+    appendFont({{kOS2Tag, buildOS2Table(700, true)},
+                {kHeadTag, buildHeadTable(0x12345678)},
+                {kCFFTag, std::vector<uint8_t>(4)}},
+               &file);
+
+    std::vector<TestableFontFileParser::TableRecord> tables;
+    ASSERT_TRUE(TestableFontFileParser::parseTableDirectory(file.data(), file.size(), 0, &tables));
+    // Sorted by tag.
+    ASSERT_EQ(3u, tables.size());
+    EXPECT_EQ(kCFFTag, tables[0].tag);
+    EXPECT_EQ(kOS2Tag, tables[1].tag);
+    EXPECT_EQ(kHeadTag, tables[2].tag);
+    EXPECT_EQ(12u + 16 * 3, tables[1].offset);
+    EXPECT_EQ(78u, tables[1].length);
+    EXPECT_EQ(4u, tables[0].length);
+
+    // The tables beyond the end of the file are clamped or dropped.
+    ASSERT_TRUE(TestableFontFileParser::parseTableDirectory(file.data(), file.size() - 2, 0,
+                                                            &tables));
+    ASSERT_EQ(3u, tables.size());
+    EXPECT_EQ(2u, tables[0].length);
+    ASSERT_TRUE(TestableFontFileParser::parseTableDirectory(file.data(), file.size() - 4, 0,
+                                                            &tables));
+    EXPECT_EQ(2u, tables.size());
+
+    // A truncated directory or another file type is not parsed.
+    EXPECT_FALSE(TestableFontFileParser::parseTableDirectory(file.data(), 40, 0, &tables));
+    EXPECT_TRUE(tables.empty());
+    std::vector<uint8_t> unknown = file;
+    writeU32(MinikinFont::MakeTag('w', 'O', 'F', 'F'), unknown.data(), 0);
+    EXPECT_FALSE(TestableFontFileParser::parseTableDirectory(unknown.data(), unknown.size(), 0,
+                                                             &tables));
+}
+
+TEST(FontFileParserTest, parseTableDirectory_collection) {
+    std::vector<uint8_t> file(20);
+    size_t pos = writeU32(MinikinFont::MakeTag('t', 't', 'c', 'f'), file.data(), 0);
+    pos = writeU16(1, file.data(), pos);  // majorVersion
+    pos = writeU16(0, file.data(), pos);  // minorVersion
+    pos = writeU32(2, file.data(), pos);  // numFonts
+    writeU32(file.size(), file.data(), pos);
+    appendFont({{kHeadTag, buildHeadTable(1)}}, &file);
+    writeU32(file.size(), file.data(), pos + 4);
+    appendFont({{kOS2Tag, buildOS2Table(400, false)}, {kCFFTag, std::vector<uint8_t>(4)}},
+               &file);
+
+    std::vector<TestableFontFileParser::TableRecord> tables;
+    ASSERT_TRUE(TestableFontFileParser::parseTableDirectory(file.data(), file.size(), 0, &tables));
+    ASSERT_EQ(1u, tables.size());
+    EXPECT_EQ(kHeadTag, tables[0].tag);
+    ASSERT_TRUE(TestableFontFileParser::parseTableDirectory(file.data(), file.size(), 1, &tables));
+    ASSERT_EQ(2u, tables.size());
+    EXPECT_EQ(kOS2Tag, tables[1].tag);
+    EXPECT_FALSE(TestableFontFileParser::parseTableDirectory(file.data(), file.size(), 2, &tables));
+}
+
+TEST(FontFileParserTest, queriesFromTableDirectory) {
+    std::vector<uint8_t> file;
+    appendFont({{kHeadTag, buildHeadTable(0x00020000)},
+                {kOS2Tag, buildOS2Table(700, true)},
+                {kCFFTag, std::vector<uint8_t>(4)}},
+               &file);
+    FontFileParser parser(file.data(), file.size(), 0);
+    EXPECT_EQ(0x00020000u, parser.getFontRevision().value());
+    EXPECT_TRUE(parser.isPostScriptType1Font().value());
+    EXPECT_EQ(FontStyle(700, FontStyle::Slant::ITALIC), parser.getStyle().value());
+    EXPECT_TRUE(parser.getSupportedAxes().empty());
+
+    std::vector<uint8_t> noTables;
+    appendFont({}, &noTables);
+    FontFileParser noTablesParser(noTables.data(), noTables.size(), 0);
+    EXPECT_FALSE(noTablesParser.getFontRevision().has_value());
+    EXPECT_FALSE(noTablesParser.isPostScriptType1Font().value());
+    EXPECT_FALSE(noTablesParser.getStyle().has_value());
+}
+
+TEST(FontFileParserTest, parseFontFromFace) {
+    // The parser of the face reads the tables from the font file of the face.
+    std::shared_ptr<Font> font = Font::Builder(std::make_shared<FreeTypeMinikinFontForTest>(
+                                                       getTestFontPath("MultiAxis.ttf")))
+                                         .build();
+    FontFileParser parser(font->baseFont());
+    const MinikinFont* typeface = font->typeface().get();
+    FontFileParser fileParser(typeface->GetFontData(), typeface->GetFontSize(), 0);
+    EXPECT_EQ(fileParser.getFontRevision(), parser.getFontRevision());
+    EXPECT_EQ(fileParser.getStyle(), parser.getStyle());
+    std::unordered_set<AxisTag> expectedAxes = {MinikinFont::MakeTag('w', 'd', 't', 'h'),
+                                                MinikinFont::MakeTag('w', 'g', 'h', 't')};
+    EXPECT_EQ(expectedAxes, parser.getSupportedAxes());
+    EXPECT_EQ(expectedAxes, fileParser.getSupportedAxes());
+    std::vector<AxisTag> expectedSortedAxes = {MinikinFont::MakeTag('w', 'd', 't', 'h'),
+                                               MinikinFont::MakeTag('w', 'g', 'h', 't')};
+    EXPECT_EQ(expectedSortedAxes, parser.getSortedSupportedAxes());
+    EXPECT_EQ(expectedSortedAxes, fileParser.getSortedSupportedAxes());
+}
+
 TEST(FontFileParser, checkPSName) {
     EXPECT_TRUE(TestableFontFileParser::checkPSName("Roboto-Regular"));
     EXPECT_TRUE(TestableFontFileParser::checkPSName("NotoColorEmoji"));
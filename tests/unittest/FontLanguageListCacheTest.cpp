@@ -16,6 +16,10 @@
 
 #include "minikin/FontFamily.h"
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "minikin/LocaleList.h"
@@ -82,4 +86,70 @@ TEST(LocaleListCacheTest, buffer) {
     }
 }
 
+TEST(LocaleListCacheTest, getByIdWhileInserting) {
+    const std::vector<std::string> languages = {"en", "ja", "ko", "fr", "de", "es",
+                                                "it", "ru", "ar", "hi", "th", "el"};
+    std::vector<std::string> inputs;
+    for (const std::string& first : languages) {
+        for (const std::string& second : languages) {
+            if (first != second) {
+                inputs.push_back(first + "," + second + ",zh-Hant");
+            }
+        }
+    }
+
+    const uint32_t enId = LocaleListCache::getId("en");
+    const LocaleList& enLocales = LocaleListCache::getById(enId);
+    const Locale english = enLocales[0];
+
+    // Read the published lists from another thread while new lists are being appended.
+    const size_t initialSize = LocaleListCache::getCacheSize();
+    std::thread reader([initialSize] {
+        for (int i = 0; i < 1000; ++i) {
+            const size_t size = LocaleListCache::getCacheSize();
+            ASSERT_LE(initialSize, size);
+            for (uint32_t id = 0; id < size; ++id) {
+                LocaleListCache::getById(id).size();
+            }
+        }
+    });
+    std::vector<uint32_t> ids;
+    for (const std::string& input : inputs) {
+        ids.push_back(LocaleListCache::getId(input));
+    }
+    reader.join();
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        EXPECT_EQ(ids[i], LocaleListCache::getId(inputs[i])) << inputs[i];
+        EXPECT_EQ(3u, LocaleListCache::getById(ids[i]).size()) << inputs[i];
+    }
+    // The references to the lists stay valid while the store grows.
+    EXPECT_EQ(&enLocales, &LocaleListCache::getById(enId));
+    EXPECT_EQ(english, enLocales[0]);
+}
+
+TEST(LocaleListCacheTest, getIdFromThreads) {
+    const std::vector<std::string> inputs = {"en-US,ja-JP", "ja-JP,en-US", "ko-KR", "fr-CA,en-CA"};
+    std::vector<uint32_t> expected;
+    for (const std::string& input : inputs) {
+        expected.push_back(LocaleListCache::getId(input));
+    }
+
+    const uint64_t hits = LocaleListCache::getStats().hits();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&inputs, &expected] {
+            for (int j = 0; j < 1000; ++j) {
+                for (size_t k = 0; k < inputs.size(); ++k) {
+                    ASSERT_EQ(expected[k], LocaleListCache::getId(inputs[k])) << inputs[k];
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_LE(hits + 4 * 1000 * inputs.size(), LocaleListCache::getStats().hits());
+}
+
 }  // namespace minikin
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FontPreloader.h"
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/LocaleList.h"
+
+#include "BufferUtils.h"
+#include "FontTestUtils.h"
+#include "FreeTypeMinikinFontForTest.h"
+
+namespace minikin {
+namespace {
+
+class TestableFontPreloader : public FontPreloader {
+public:
+    TestableFontPreloader() : FontPreloader() {}
+    virtual ~TestableFontPreloader() {}
+
+    void preload(const std::shared_ptr<Font>& font) { preloadInternal(font); }
+
+    void preloadForLocales(const FontCollection& collection, uint32_t localeListId) {
+        preloadForLocalesInternal(collection, localeListId);
+    }
+
+    void waitForIdle() { FontPreloader::waitForIdle(); }
+};
+
+// Records the typeface loads of the fonts read with recordingReader.
+std::atomic<int> gLoadCount;
+std::thread::id gLoadThreadId;
+Font::TypefaceLoader* gLoader = nullptr;
+
+std::shared_ptr<MinikinFont> recordingLoader(BufferReader reader) {
+    gLoadCount++;
+    gLoadThreadId = std::this_thread::get_id();
+    return gLoader(reader);
+}
+
+Font::TypefaceLoader* recordingReader(BufferReader* reader) {
+    gLoader = readFreeTypeMinikinFontForTest(reader);
+    return &recordingLoader;
+}
+
+TEST(FontPreloaderTest, preloadFont) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> original = Font::Builder(minikinFont).build();
+    std::vector<uint8_t> buffer = writeToBuffer<Font, writeFreeTypeMinikinFontForTest>(*original);
+    BufferReader reader(buffer.data());
+    std::shared_ptr<Font> font = Font::readFrom<recordingReader>(&reader, kEmptyLocaleListId);
+
+    gLoadCount = 0;
+    TestableFontPreloader preloader;
+    preloader.preload(font);
+    preloader.waitForIdle();
+    EXPECT_EQ(1, gLoadCount);
+    EXPECT_NE(std::this_thread::get_id(), gLoadThreadId);
+
+    // Already loaded.
+    EXPECT_NE(nullptr, font->baseFont());
+    EXPECT_EQ(minikinFont->GetFontPath(), font->typeface()->GetFontPath());
+    EXPECT_EQ(1, gLoadCount);
+}
+
+TEST(FontPreloaderTest, preloadForLocales) {
+    std::vector<std::shared_ptr<FontCollection>> original = {
+            buildFontCollectionFromXml("itemize.xml")};
+    BufferWriter fakeWriter(nullptr);
+    FontCollection::writeVector<writeFreeTypeMinikinFontForTest>(&fakeWriter, original);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    FontCollection::writeVector<writeFreeTypeMinikinFontForTest>(&writer, original);
+    BufferReader reader(buffer.data());
+    std::vector<std::shared_ptr<FontCollection>> collections =
+            FontCollection::readVector<recordingReader>(&reader);
+    ASSERT_EQ(1u, collections.size());
+
+    gLoadCount = 0;
+    TestableFontPreloader preloader;
+    // Only the Cherokee family has the Cherokee script.
+    preloader.preloadForLocales(*collections[0], registerLocaleList("und-Cher"));
+    preloader.waitForIdle();
+    EXPECT_EQ(1, gLoadCount);
+
+    // The families without locales are not preloaded.
+    preloader.preloadForLocales(*collections[0], registerLocaleList(""));
+    preloader.waitForIdle();
+    EXPECT_EQ(1, gLoadCount);
+}
+
+}  // namespace
+}  // namespace minikin
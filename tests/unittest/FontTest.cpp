@@ -16,7 +16,12 @@
 
 #include "minikin/Font.h"
 
+#include <thread>
+
 #include <gtest/gtest.h>
+#include <hb.h>
+
+#include "minikin/MinikinPaint.h"
 
 #include "BufferUtils.h"
 #include "FontTestUtils.h"
@@ -39,4 +44,170 @@ TEST(FontTest, BufferTest) {
     EXPECT_EQ(buffer, newBuffer);
 }
 
+TEST(FontTest, LazyLoadFromThreadsTest) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> original = Font::Builder(minikinFont).build();
+    std::vector<uint8_t> buffer = writeToBuffer<Font, writeFreeTypeMinikinFontForTest>(*original);
+
+    BufferReader reader(buffer.data());
+    std::shared_ptr<Font> font =
+            Font::readFrom<readFreeTypeMinikinFontForTest>(&reader, kEmptyLocaleListId);
+    constexpr int kThreadCount = 8;
+    std::vector<const hb_font_t*> baseFonts(kThreadCount);
+    std::vector<const MinikinFont*> typefaces(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i]() {
+            typefaces[i] = font->typeface().get();
+            baseFonts[i] = font->baseFont().get();
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    // All the threads see the single loaded instance.
+    for (int i = 0; i < kThreadCount; ++i) {
+        EXPECT_EQ(font->typeface().get(), typefaces[i]);
+        EXPECT_EQ(font->baseFont().get(), baseFonts[i]);
+    }
+    EXPECT_NE(nullptr, baseFonts[0]);
+}
+
+static int gLoadCount = 0;
+static Font::TypefaceLoader* gLoader = nullptr;
+
+static std::shared_ptr<MinikinFont> countingLoader(BufferReader reader) {
+    gLoadCount++;
+    return gLoader(reader);
+}
+
+static Font::TypefaceLoader* countingReader(BufferReader* reader) {
+    gLoader = readFreeTypeMinikinFontForTest(reader);
+    return &countingLoader;
+}
+
+TEST(FontTest, ReleaseUnusedTypefacesTest) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> original = Font::Builder(minikinFont).build();
+    std::vector<uint8_t> buffer = writeToBuffer<Font, writeFreeTypeMinikinFontForTest>(*original);
+
+    BufferReader reader(buffer.data());
+    std::shared_ptr<Font> font = Font::readFrom<countingReader>(&reader, kEmptyLocaleListId);
+    gLoadCount = 0;
+    EXPECT_NE(nullptr, font->baseFont());
+    EXPECT_EQ(1, gLoadCount);
+
+    // Used in the current period.
+    Font::releaseUnusedTypefaces();
+    std::shared_ptr<MinikinFont> typeface = font->acquireTypeface();
+    HbFontUniquePtr baseFont = font->acquireBaseFont();
+    EXPECT_NE(nullptr, baseFont);
+    EXPECT_EQ(1, gLoadCount);
+
+    // The first call ends the period of the last use, and the second one releases it.
+    Font::releaseUnusedTypefaces();
+    Font::releaseUnusedTypefaces();
+    EXPECT_EQ(1, gLoadCount);
+
+    // The acquired references are still valid after the release.
+    EXPECT_EQ(minikinFont->GetFontPath(), typeface->GetFontPath());
+    hb_codepoint_t glyph;
+    EXPECT_TRUE(hb_font_get_nominal_glyph(baseFont.get(), 'a', &glyph));
+
+    // Loaded again on demand.
+    EXPECT_EQ(minikinFont->GetFontPath(), font->typeface()->GetFontPath());
+    EXPECT_NE(nullptr, font->baseFont());
+    EXPECT_EQ(2, gLoadCount);
+
+    // The fonts from the builder are never released.
+    Font::releaseUnusedTypefaces();
+    Font::releaseUnusedTypefaces();
+    EXPECT_EQ(minikinFont, original->typeface());
+}
+
+TEST(FontTest, ShapePlanTest) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> font = Font::Builder(minikinFont).build();
+
+    hb_segment_properties_t latin = HB_SEGMENT_PROPERTIES_DEFAULT;
+    latin.direction = HB_DIRECTION_LTR;
+    latin.script = HB_SCRIPT_LATIN;
+    latin.language = hb_language_from_string("en", -1);
+    hb_segment_properties_t arabic = latin;
+    arabic.direction = HB_DIRECTION_RTL;
+    arabic.script = HB_SCRIPT_ARABIC;
+    const std::vector<hb_feature_t> noFeatures;
+    const std::vector<hb_feature_t> noLiga = {{HB_TAG('l', 'i', 'g', 'a'), 0, 0, ~0u}};
+
+    HbShapePlanUniquePtr plan = font->getShapePlan(latin, noFeatures);
+    ASSERT_NE(nullptr, plan);
+    EXPECT_EQ(plan.get(), font->getShapePlan(latin, noFeatures).get());
+    EXPECT_NE(plan.get(), font->getShapePlan(arabic, noFeatures).get());
+    EXPECT_NE(plan.get(), font->getShapePlan(latin, noLiga).get());
+    EXPECT_EQ(font->getShapePlan(latin, noLiga).get(), font->getShapePlan(latin, noLiga).get());
+}
+
+TEST(FontTest, ExtentTest) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> font = Font::Builder(minikinFont).build();
+    MinikinPaint paint(nullptr);
+    // The ascent and the descent of Ascii.ttf are 8em and 2em.
+    for (float size : {10.0f, 20.0f, 10.0f, 30.0f, 40.0f, 50.0f, 10.0f}) {
+        SCOPED_TRACE(size);
+        paint.size = size;
+        EXPECT_EQ(MinikinExtent(-8.0f * size, 2.0f * size), font->getExtent(paint, FontFakery()));
+    }
+}
+
+TEST(FontTest, SharedFaceTest) {
+    auto asciiFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    auto boldFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Bold.ttf"));
+    std::shared_ptr<Font> font1 = Font::Builder(asciiFont).build();
+    std::shared_ptr<Font> font2 = Font::Builder(asciiFont).build();
+    std::shared_ptr<Font> font3 = Font::Builder(boldFont).build();
+
+    // The fonts of the same data share the face, but each has its own font for its variations.
+    EXPECT_NE(font1->baseFont().get(), font2->baseFont().get());
+    EXPECT_EQ(hb_font_get_face(font1->baseFont().get()),
+              hb_font_get_face(font2->baseFont().get()));
+    EXPECT_EQ(hb_font_get_parent(font1->baseFont().get()),
+              hb_font_get_parent(font2->baseFont().get()));
+    EXPECT_NE(hb_font_get_face(font1->baseFont().get()),
+              hb_font_get_face(font3->baseFont().get()));
+
+    // The face stays usable once the font which created it is gone.
+    font1.reset();
+    EXPECT_NE(0, font2->getSimpleGlyphs().get('a'));
+    std::shared_ptr<Font> font4 = Font::Builder(asciiFont).build();
+    EXPECT_EQ(hb_font_get_face(font2->baseFont().get()),
+              hb_font_get_face(font4->baseFont().get()));
+}
+
+TEST(FontTest, SimpleGlyphsTest) {
+    {
+        SCOPED_TRACE("No lookups");
+        auto minikinFont =
+                std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+        std::shared_ptr<Font> font = Font::Builder(minikinFont).build();
+        const Font::SimpleGlyphs& glyphs = font->getSimpleGlyphs();
+        EXPECT_NE(0, glyphs.get('a'));
+        EXPECT_NE(0, glyphs.get(' '));
+        EXPECT_EQ(0, glyphs.get('\n'));
+        EXPECT_EQ(0, glyphs.get(0x00AD));  // SOFT HYPHEN
+        EXPECT_EQ(0, glyphs.get(0x3042));  // HIRAGANA LETTER A
+        EXPECT_EQ(&glyphs, &font->getSimpleGlyphs());
+    }
+    {
+        SCOPED_TRACE("Ligatures");
+        // Ligature.ttf has the fi and ff ligatures, and maps 'a' to a glyph no lookup uses.
+        auto minikinFont =
+                std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ligature.ttf"));
+        std::shared_ptr<Font> font = Font::Builder(minikinFont).build();
+        const Font::SimpleGlyphs& glyphs = font->getSimpleGlyphs();
+        EXPECT_NE(0, glyphs.get('a'));
+        EXPECT_EQ(0, glyphs.get('f'));
+        EXPECT_EQ(0, glyphs.get('i'));
+    }
+}
+
 }  // namespace minikin
@@ -85,17 +85,29 @@ TEST(FontUtilsTest, analyzeAxes_tagCount) {
             Fvar(MakeTag('w', 'g', 'h', 't'), 0.0f, 1.0f, 2.0f),
     });
 
-    std::unordered_set<uint32_t> axes;
+    std::vector<uint32_t> axes;
     ASSERT_TRUE(analyzeAxes(fvarTable.data(), fvarTable.size(), &axes));
     ASSERT_EQ(2u, axes.size());
-    EXPECT_EQ(1u, axes.count(MakeTag('w', 'd', 't', 'h')));
-    EXPECT_EQ(1u, axes.count(MakeTag('w', 'g', 'h', 't')));
-    EXPECT_EQ(0u, axes.count(MakeTag('s', 'l', 'n', 't')));
+    EXPECT_EQ(MakeTag('w', 'd', 't', 'h'), axes[0]);
+    EXPECT_EQ(MakeTag('w', 'g', 'h', 't'), axes[1]);
+}
+
+TEST(FontUtilsTest, analyzeAxes_sortedUnique) {
+    std::vector<uint8_t> fvarTable = buildFvarTable({
+            Fvar(MakeTag('w', 'g', 'h', 't'), 0.0f, 1.0f, 2.0f),
+            Fvar(MakeTag('s', 'l', 'n', 't'), 0.0f, 1.0f, 2.0f),
+            Fvar(MakeTag('w', 'g', 'h', 't'), 0.0f, 1.0f, 2.0f),
+    });
+
+    std::vector<uint32_t> axes;
+    ASSERT_TRUE(analyzeAxes(fvarTable.data(), fvarTable.size(), &axes));
+    EXPECT_EQ(std::vector<uint32_t>({MakeTag('s', 'l', 'n', 't'), MakeTag('w', 'g', 'h', 't')}),
+              axes);
 }
 
 TEST(FontUtilsTest, analyzeAxes_emptyBuffer) {
     std::vector<uint8_t> fvarTable;
-    std::unordered_set<uint32_t> axes;
+    std::vector<uint32_t> axes;
     ASSERT_FALSE(analyzeAxes(fvarTable.data(), fvarTable.size(), &axes));
 }
 
@@ -108,7 +120,7 @@ TEST(FontUtilsTest, analyzeAxes_invalidTableSize) {
     fvarTable.resize(1000);
     writeU16(50, fvarTable.data(), 8);  // Set axisCount = 50
 
-    std::unordered_set<uint32_t> axes;
+    std::vector<uint32_t> axes;
     ASSERT_FALSE(analyzeAxes(fvarTable.data(), fvarTable.size(), &axes));
 }
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FrequencySketch.h"
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(FrequencySketchTest, countTest) {
+    FrequencySketch sketch(1024);
+    EXPECT_EQ(0u, sketch.frequency(1));
+
+    for (uint32_t i = 0; i < 5; ++i) {
+        sketch.increment(1);
+    }
+    sketch.increment(2);
+    EXPECT_EQ(5u, sketch.frequency(1));
+    EXPECT_EQ(1u, sketch.frequency(2));
+    EXPECT_EQ(0u, sketch.frequency(3));
+}
+
+TEST(FrequencySketchTest, saturationTest) {
+    FrequencySketch sketch(1024);
+    for (uint32_t i = 0; i < 100; ++i) {
+        sketch.increment(1);
+    }
+    EXPECT_EQ(15u, sketch.frequency(1));
+}
+
+TEST(FrequencySketchTest, agingTest) {
+    FrequencySketch sketch(16);
+    for (uint32_t i = 0; i < 10; ++i) {
+        sketch.increment(1);
+    }
+    EXPECT_EQ(10u, sketch.frequency(1));
+
+    // The sample size of the sketch is ten times its capacity. Counting that many other keys
+    // halves the counters.
+    for (uint32_t i = 0; i < 160; ++i) {
+        sketch.increment(1000 + i);
+    }
+    EXPECT_GT(10u, sketch.frequency(1));
+}
+
+TEST(FrequencySketchTest, estimateTest) {
+    // The frequencies are never underestimated, and rarely overestimated by much while the keys
+    // fit in the capacity.
+    FrequencySketch sketch(512);
+    for (uint32_t key = 0; key < 512; ++key) {
+        for (uint32_t i = 0; i < key % 4; ++i) {
+            sketch.increment(key * 2654435761u);
+        }
+    }
+    uint32_t overestimated = 0;
+    for (uint32_t key = 0; key < 512; ++key) {
+        const uint32_t frequency = sketch.frequency(key * 2654435761u);
+        EXPECT_LE(key % 4, frequency);
+        if (frequency != key % 4) {
+            overestimated++;
+        }
+    }
+    EXPECT_GT(512u / 10, overestimated);
+}
+
+}  // namespace minikin
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GlyphAdvanceCache.h"
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(GlyphAdvanceCacheTest, denseTest) {
+    GlyphAdvanceCache cache;
+    float advance = -1.0f;
+    EXPECT_FALSE(cache.get(0, &advance));
+    EXPECT_FALSE(cache.get(GlyphAdvanceCache::kDenseGlyphCount - 1, &advance));
+
+    cache.put(0, 0.0f);
+    cache.put(42, 10.5f);
+    cache.put(GlyphAdvanceCache::kDenseGlyphCount - 1, 3.0f);
+    EXPECT_TRUE(cache.get(0, &advance));
+    EXPECT_EQ(0.0f, advance);
+    EXPECT_TRUE(cache.get(42, &advance));
+    EXPECT_EQ(10.5f, advance);
+    EXPECT_TRUE(cache.get(GlyphAdvanceCache::kDenseGlyphCount - 1, &advance));
+    EXPECT_EQ(3.0f, advance);
+    EXPECT_FALSE(cache.get(43, &advance));
+
+    cache.put(42, -2.0f);
+    EXPECT_TRUE(cache.get(42, &advance));
+    EXPECT_EQ(-2.0f, advance);
+}
+
+TEST(GlyphAdvanceCacheTest, sparseTest) {
+    GlyphAdvanceCache cache;
+    const uint32_t first = GlyphAdvanceCache::kDenseGlyphCount;
+    float advance = -1.0f;
+    EXPECT_FALSE(cache.get(first, &advance));
+    cache.put(first, 7.0f);
+    cache.put(70000, 8.0f);
+    EXPECT_TRUE(cache.get(first, &advance));
+    EXPECT_EQ(7.0f, advance);
+    EXPECT_TRUE(cache.get(70000, &advance));
+    EXPECT_EQ(8.0f, advance);
+    EXPECT_FALSE(cache.get(first + 1, &advance));
+}
+
+TEST(GlyphAdvanceCacheTest, sparseLimitTest) {
+    GlyphAdvanceCache cache;
+    const uint32_t first = GlyphAdvanceCache::kDenseGlyphCount;
+    cache.put(1, 1.0f);
+    for (uint32_t i = 0; i < GlyphAdvanceCache::kMaxSparseGlyphCount; ++i) {
+        cache.put(first + i, i);
+    }
+    float advance;
+    EXPECT_TRUE(cache.get(first, &advance));
+
+    // The sparse glyphs are dropped when the limit is reached, but the dense ones are kept.
+    cache.put(first + GlyphAdvanceCache::kMaxSparseGlyphCount, 5.0f);
+    EXPECT_FALSE(cache.get(first, &advance));
+    EXPECT_TRUE(cache.get(first + GlyphAdvanceCache::kMaxSparseGlyphCount, &advance));
+    EXPECT_EQ(5.0f, advance);
+    EXPECT_TRUE(cache.get(1, &advance));
+    EXPECT_EQ(1.0f, advance);
+}
+
+}  // namespace minikin
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GlyphPositions.h"
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/HbUtils.h"
+
+namespace minikin {
+
+namespace {
+
+std::vector<hb_glyph_position_t> randomPositions(uint32_t count, uint32_t seed) {
+    std::mt19937 mt(seed);
+    std::uniform_int_distribution<hb_position_t> dist(-100000, 100000);
+    std::vector<hb_glyph_position_t> positions(count);
+    for (hb_glyph_position_t& position : positions) {
+        position.x_advance = dist(mt);
+        position.y_advance = dist(mt);
+        position.x_offset = dist(mt);
+        position.y_offset = dist(mt);
+    }
+    return positions;
+}
+
+}  // namespace
+
+TEST(GlyphPositionsTest, scalarTest) {
+    hb_glyph_position_t positions[2] = {};
+    positions[0].x_advance = 256 * 10;
+    positions[0].x_offset = 128;
+    positions[0].y_offset = 256 * 2;
+    positions[1].x_advance = -64;
+
+    float xAdvances[2], xOffsets[2], yOffsets[2];
+    convertGlyphPositionsScalar(positions, 2, -0.25f, xAdvances, xOffsets, yOffsets);
+    EXPECT_EQ(10.0f, xAdvances[0]);
+    EXPECT_EQ(1.0f, xOffsets[0]);  // 0.5 + (-2.0 * -0.25)
+    EXPECT_EQ(-2.0f, yOffsets[0]);
+    EXPECT_EQ(-0.25f, xAdvances[1]);
+    EXPECT_EQ(0.0f, xOffsets[1]);
+    EXPECT_EQ(0.0f, yOffsets[1]);
+}
+
+TEST(GlyphPositionsTest, matchesScalarTest) {
+    // Covers the counts which are not a multiple of the vector width.
+    for (uint32_t count = 0; count < 20; ++count) {
+        for (float skewX : {0.0f, -0.25f, 0.3f}) {
+            std::vector<hb_glyph_position_t> positions = randomPositions(count, count);
+            std::vector<float> xAdvances(count), xOffsets(count), yOffsets(count);
+            std::vector<float> expectedXAdvances(count), expectedXOffsets(count),
+                    expectedYOffsets(count);
+            convertGlyphPositions(positions.data(), count, skewX, xAdvances.data(),
+                                  xOffsets.data(), yOffsets.data());
+            convertGlyphPositionsScalar(positions.data(), count, skewX, expectedXAdvances.data(),
+                                        expectedXOffsets.data(), expectedYOffsets.data());
+            for (uint32_t i = 0; i < count; ++i) {
+                SCOPED_TRACE(testing::Message() << "count=" << count << ", i=" << i);
+                EXPECT_EQ(HBFixedToFloat(positions[i].x_advance), xAdvances[i]);
+                EXPECT_EQ(expectedXAdvances[i], xAdvances[i]);
+                EXPECT_EQ(expectedXOffsets[i], xOffsets[i]);
+                EXPECT_EQ(expectedYOffsets[i], yOffsets[i]);
+            }
+        }
+    }
+}
+
+TEST(GlyphPositionsTest, extremeValuesTest) {
+    // Values above 2^24 are rounded when converted to float, in the same way for both paths.
+    const hb_position_t values[] = {std::numeric_limits<hb_position_t>::max(),
+                                    std::numeric_limits<hb_position_t>::min(), (1 << 24) + 1, 0};
+    std::vector<hb_glyph_position_t> positions(4);
+    for (uint32_t i = 0; i < 4; ++i) {
+        positions[i].x_advance = values[i];
+        positions[i].x_offset = values[(i + 1) % 4];
+        positions[i].y_offset = values[(i + 2) % 4];
+    }
+    float xAdvances[4], xOffsets[4], yOffsets[4];
+    convertGlyphPositions(positions.data(), 4, 0.0f, xAdvances, xOffsets, yOffsets);
+    for (uint32_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(HBFixedToFloat(positions[i].x_advance), xAdvances[i]);
+        EXPECT_EQ(HBFixedToFloat(positions[i].x_offset), xOffsets[i]);
+        EXPECT_EQ(-HBFixedToFloat(positions[i].y_offset), yOffsets[i]);
+    }
+}
+
+TEST(GlyphPositionsTest, advancesToFixedScalarTest) {
+    const float advances[] = {10.0f, -0.25f, 0.001f, -0.001f, 1.999f};
+    hb_position_t fixed[5];
+    convertAdvancesToFixedScalar(advances, 5, fixed, sizeof(hb_position_t));
+    EXPECT_EQ(2560, fixed[0]);
+    EXPECT_EQ(-64, fixed[1]);
+    EXPECT_EQ(0, fixed[2]);  // Truncated toward zero.
+    EXPECT_EQ(0, fixed[3]);
+    EXPECT_EQ(511, fixed[4]);
+}
+
+TEST(GlyphPositionsTest, advancesToFixedMatchesScalarTest) {
+    std::mt19937 mt(0);
+    std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+    for (uint32_t count = 0; count < 20; ++count) {
+        std::vector<float> advances(count);
+        for (float& advance : advances) {
+            advance = dist(mt);
+        }
+        {
+            SCOPED_TRACE(testing::Message() << "contiguous, count=" << count);
+            std::vector<hb_position_t> fixed(count), expected(count);
+            convertAdvancesToFixed(advances.data(), count, fixed.data(), sizeof(hb_position_t));
+            convertAdvancesToFixedScalar(advances.data(), count, expected.data(),
+                                         sizeof(hb_position_t));
+            EXPECT_EQ(expected, fixed);
+        }
+        {
+            SCOPED_TRACE(testing::Message() << "strided, count=" << count);
+            // The x advances of HarfBuzz positions, the other fields must be left untouched.
+            std::vector<hb_glyph_position_t> positions = randomPositions(count, count);
+            std::vector<hb_glyph_position_t> original = positions;
+            convertAdvancesToFixed(advances.data(), count, &positions[0].x_advance,
+                                   sizeof(hb_glyph_position_t));
+            for (uint32_t i = 0; i < count; ++i) {
+                EXPECT_EQ(HBFloatToFixed(advances[i]), positions[i].x_advance);
+                EXPECT_EQ(original[i].y_advance, positions[i].y_advance);
+                EXPECT_EQ(original[i].x_offset, positions[i].x_offset);
+                EXPECT_EQ(original[i].y_offset, positions[i].y_offset);
+            }
+        }
+    }
+}
+
+}  // namespace minikin
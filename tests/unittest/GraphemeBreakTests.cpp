@@ -16,10 +16,13 @@
 
 #include "minikin/GraphemeBreak.h"
 
+#include <iterator>
+#include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
 
+#include "LayoutBudget.h"
 #include "UnicodeUtils.h"
 
 namespace minikin {
@@ -317,4 +320,58 @@ TEST(GraphemeBreak, startWithZWJ) {
     IsBreak("U+200D | U+1F5E8");  // UB sanitizer will catch if minikin looks the char before ZWJ
 }
 
+TEST(GraphemeBreak, cursorClusterBudget) {
+    // An 'a' with 100 combining acute accents, then a 'b'.
+    std::vector<uint16_t> buf = {'a'};
+    buf.insert(buf.end(), 100, 0x0301);
+    buf.push_back('b');
+    const size_t count = buf.size();
+    EXPECT_EQ(101u, GraphemeBreak::getTextRunCursor(nullptr, buf.data(), 0, count, 0,
+                                                    GraphemeBreak::AFTER));
+
+    LayoutBudget::resetTriggerCounts();
+    LayoutBudget::setLimit(LayoutBudget::kClusterLength, 10);
+    EXPECT_EQ(11u, GraphemeBreak::getTextRunCursor(nullptr, buf.data(), 0, count, 0,
+                                                   GraphemeBreak::AFTER));
+    EXPECT_EQ(90u, GraphemeBreak::getTextRunCursor(nullptr, buf.data(), 0, count, 100,
+                                                   GraphemeBreak::AT_OR_BEFORE));
+    // The breaks are found within the budget.
+    EXPECT_EQ(102u, GraphemeBreak::getTextRunCursor(nullptr, buf.data(), 0, count, 101,
+                                                    GraphemeBreak::AFTER));
+    LayoutBudget::setLimit(LayoutBudget::kClusterLength, 0);
+    EXPECT_EQ(2u, LayoutBudget::getTriggerCount(LayoutBudget::kClusterLength));
+}
+
+TEST(GraphemeBreak, computeGraphemeBreaks) {
+    // Code units exercising all the rules, including broken surrogate pairs.
+    const uint16_t pool[] = {'a',    ' ',    0x000D, 0x000A, 0x0007, 0x1100, 0x1161, 0x11A8,
+                             0xAC00, 0xAC01, 0x0301, 0x200D, 0x0903, 0x0600, 0x0915, 0x094D,
+                             0x0E3A, 0x0E33, 0x00AD, 0x2764, 0xD83D, 0xDC69, 0xD83C, 0xDDFA,
+                             0xDDF8, 0xDFFB, 0xDB40, 0xDC61};
+    std::mt19937 random(0);
+    for (int trial = 0; trial < 500; trial++) {
+        std::vector<uint16_t> buf(1 + random() % 24);
+        for (uint16_t& c : buf) {
+            c = pool[random() % std::size(pool)];
+        }
+        std::vector<float> advances(buf.size());
+        for (float& advance : advances) {
+            advance = random() % 3 == 0 ? 0.0f : 1.0f;
+        }
+        const size_t start = random() % buf.size();
+        const size_t count = random() % (buf.size() - start + 1);
+        const float* const advanceOptions[] = {nullptr, advances.data() + start};
+        for (const float* adv : advanceOptions) {
+            const std::vector<bool> breaks =
+                    GraphemeBreak::computeGraphemeBreaks(adv, buf.data(), start, count);
+            ASSERT_EQ(count + 1, breaks.size());
+            for (size_t offset = start; offset <= start + count; offset++) {
+                EXPECT_EQ(GraphemeBreak::isGraphemeBreak(adv, buf.data(), start, count, offset),
+                          breaks[offset - start])
+                        << trial << " " << offset;
+            }
+        }
+    }
+}
+
 }  // namespace minikin
@@ -15,6 +15,7 @@
  */
 
 #include <memory>
+#include <random>
 
 #include <gtest/gtest.h>
 
@@ -34,6 +35,7 @@ namespace minikin {
 namespace {
 
 using line_breaker_test_helper::ConstantRun;
+using line_breaker_test_helper::expectKeptWordBreaksMatch;
 using line_breaker_test_helper::LineBreakExpectation;
 using line_breaker_test_helper::RectangleLineWidth;
 using line_breaker_test_helper::sameLineBreak;
@@ -1587,5 +1589,63 @@ TEST_F(GreedyLineBreakerTest, testControllCharAfterSpace) {
                                                    << toString(textBuf, actual);
     }
 }
+
+TEST_F(GreedyLineBreakerTest, testUniformWidth) {
+    // A single run whose characters have the same width is broken per word. Splitting the same
+    // run in two goes through the per character loop, which must give the same result.
+    constexpr bool NO_HYPHEN = false;
+    const char kChars[] = "aaaaaabc   -./@";
+    std::mt19937 mt(0);
+    for (const float charWidth : {10.0f, 7.3f, 0.1f}) {
+        for (const float lineWidth : {0.0f, 35.0f, 73.0f, 100.0f, 1000.0f}) {
+            for (int trial = 0; trial < 20; ++trial) {
+                std::string text;
+                const size_t length = 2 + mt() % 200;
+                for (size_t i = 0; i < length; ++i) {
+                    text += kChars[mt() % (sizeof(kChars) - 1)];
+                }
+                const std::vector<uint16_t> textBuf = utf8ToUtf16(text);
+                const uint32_t split = 1 + mt() % (textBuf.size() - 1);
+
+                MeasuredTextBuilder uniformBuilder;
+                uniformBuilder.addCustomRun<ConstantRun>(Range(0, textBuf.size()), "en-US",
+                                                         charWidth, ASCENT, DESCENT);
+                std::unique_ptr<MeasuredText> uniform = uniformBuilder.build(
+                        textBuf, false /* compute hyphenation */, false /* compute full layout */,
+                        nullptr /* no hint */);
+                MeasuredTextBuilder splitBuilder;
+                splitBuilder.addCustomRun<ConstantRun>(Range(0, split), "en-US", charWidth,
+                                                       ASCENT, DESCENT);
+                splitBuilder.addCustomRun<ConstantRun>(Range(split, textBuf.size()), "en-US",
+                                                       charWidth, ASCENT, DESCENT);
+                std::unique_ptr<MeasuredText> perCharacter = splitBuilder.build(
+                        textBuf, false /* compute hyphenation */, false /* compute full layout */,
+                        nullptr /* no hint */);
+
+                RectangleLineWidth rectangleLineWidth(lineWidth);
+                TabStops tabStops(nullptr, 0, 10);
+                const LineBreakResult expected = breakLineGreedy(
+                        textBuf, *perCharacter, rectangleLineWidth, tabStops, NO_HYPHEN);
+                const LineBreakResult actual =
+                        breakLineGreedy(textBuf, *uniform, rectangleLineWidth, tabStops, NO_HYPHEN);
+                SCOPED_TRACE(text);
+                EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+                EXPECT_EQ(expected.widths, actual.widths);
+                EXPECT_EQ(expected.flags, actual.flags);
+            }
+        }
+    }
+}
+
+TEST_F(GreedyLineBreakerTest, testKeptWordBreaks) {
+    expectKeptWordBreaksMatch([](const std::vector<uint16_t>& textBuf,
+                                 const MeasuredText& measuredText, bool doHyphenation,
+                                 float lineWidth) {
+        RectangleLineWidth rectangleLineWidth(lineWidth);
+        TabStops tabStops(nullptr, 0, 10);
+        return breakLineGreedy(textBuf, measuredText, rectangleLineWidth, tabStops,
+                               doHyphenation);
+    });
+}
 }  // namespace
 }  // namespace minikin
@@ -16,6 +16,11 @@
 
 #include "minikin/Hasher.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace minikin {
@@ -35,9 +40,130 @@ TEST(HasherTest, hasherTest) {
     EXPECT_EQ(hasher.hash(), hasher.hash());
 }
 
+TEST(HasherTest, updateShortsTest) {
+    const uint16_t shorts[] = {'a', 'n', 'd', 'r', 'o', 'i', 'd', 'o', 's'};
+    for (uint32_t length = 0; length <= 9; ++length) {
+        SCOPED_TRACE(length);
+        const uint32_t hash = Hasher().updateShorts(shorts, length).hash();
+        EXPECT_EQ(hash, Hasher().updateShorts(shorts, length).hash());
+        if (length < 9) {
+            EXPECT_NE(hash, Hasher().updateShorts(shorts, length + 1).hash());
+        }
+
+        // Changing any code unit changes the hash.
+        for (uint32_t i = 0; i < length; ++i) {
+            uint16_t modified[9];
+            std::copy(shorts, shorts + 9, modified);
+            modified[i] = 'x';
+            EXPECT_NE(hash, Hasher().updateShorts(modified, length).hash());
+        }
+    }
+}
+
+TEST(HasherTest, updateShortsBitFlipTest) {
+    // The code units are mixed four at a time, so a single bit flip in any lane of a block or in
+    // the remainder changes the hash.
+    const uint16_t shorts[] = {'a', 'n', 'd', 'r', 'o', 'i', 'd', 'o', 's'};
+    for (uint32_t length = 1; length <= 9; ++length) {
+        SCOPED_TRACE(length);
+        const uint32_t hash = Hasher().updateShorts(shorts, length).hash();
+        for (uint32_t i = 0; i < length; ++i) {
+            for (uint32_t bit = 0; bit < 16; ++bit) {
+                uint16_t modified[9];
+                std::copy(shorts, shorts + 9, modified);
+                modified[i] ^= 1 << bit;
+                EXPECT_NE(hash, Hasher().updateShorts(modified, length).hash()) << i << " " << bit;
+            }
+        }
+    }
+}
+
 TEST(HasherTest, hasherTestFloat) {
     float x = 1.1f;
     EXPECT_NE(Hasher().update(x).hash(), Hasher().update(1).hash());
 }
 
+TEST(HasherTest, wideHasherTest) {
+    EXPECT_EQ(WideHasher().hash(), WideHasher().hash());
+    EXPECT_EQ(WideHasher().update(1).hash(), WideHasher().update(1).hash());
+    EXPECT_NE(WideHasher().update(1).hash(), WideHasher().update(2).hash());
+    EXPECT_NE(WideHasher().update(1).update(2).hash(), WideHasher().update(2).update(1).hash());
+    EXPECT_NE(WideHasher().update(1.1f).hash(), WideHasher().update(1).hash());
+    const uint64_t highBit = static_cast<uint64_t>(1) << 32;
+    EXPECT_NE(WideHasher().update(highBit).hash(), WideHasher().update(0).hash());
+
+    WideHasher hasher;
+    hasher.update(1);
+    EXPECT_EQ(hasher.hash(), hasher.hash());
+    hasher.update(2);
+    EXPECT_EQ(hasher.hash(), hasher.hash());
+}
+
+TEST(HasherTest, wideHasherArraysTest) {
+    // Longer than two blocks, and not a multiple of the block size.
+    const uint16_t shorts[] = {'a', 'n', 'd', 'r', 'o', 'i', 'd', 'o', 's',
+                               'm', 'i', 'n', 'i', 'k', 'i', 'n', 't', 'e', 'x'};
+    constexpr uint32_t kLength = sizeof(shorts) / sizeof(shorts[0]);
+    for (uint32_t length = 0; length <= kLength; ++length) {
+        SCOPED_TRACE(length);
+        const uint32_t hash = WideHasher().updateShorts(shorts, length).hash();
+        EXPECT_EQ(hash, WideHasher().updateShorts(shorts, length).hash());
+        if (length < kLength) {
+            EXPECT_NE(hash, WideHasher().updateShorts(shorts, length + 1).hash());
+        }
+
+        // Changing any code unit changes the hash.
+        for (uint32_t i = 0; i < length; ++i) {
+            uint16_t modified[kLength];
+            std::copy(shorts, shorts + kLength, modified);
+            modified[i] ^= 1;
+            EXPECT_NE(hash, WideHasher().updateShorts(modified, length).hash());
+        }
+    }
+
+    // The zero padding of the last block is told apart by the length.
+    const char zeros[4] = {};
+    EXPECT_NE(WideHasher().updateBytes(zeros, 3).hash(), WideHasher().updateBytes(zeros, 4).hash());
+    EXPECT_EQ(WideHasher().updateString("hello").hash(),
+              WideHasher().updateBytes("hello", 5).hash());
+}
+
+TEST(HasherTest, wideHasherCollisionTest) {
+    // All the strings of one or two code units of the first 256 code points, and pairs of scalars
+    // differing in one bit. A good 32-bit hash has about n^2 / 2^33 collisions, i.e. less than one
+    // for these 65792 + 64 * 64 keys, and every bit of the hash flips about half of the time.
+    std::unordered_set<uint32_t> hashes;
+    size_t count = 0;
+    for (uint16_t first = 0; first < 256; first++) {
+        hashes.insert(WideHasher().updateShorts(&first, 1).hash());
+        count++;
+        for (uint16_t second = 0; second < 256; second++) {
+            const uint16_t text[] = {first, second};
+            hashes.insert(WideHasher().updateShorts(text, 2).hash());
+            count++;
+        }
+    }
+    std::vector<uint32_t> bitFlips(32);
+    for (uint32_t a = 0; a < 64; a++) {
+        for (uint32_t b = 0; b < 64; b++) {
+            const uint64_t value =
+                    (static_cast<uint64_t>(a) << 48) | (static_cast<uint64_t>(b) << 8);
+            const uint32_t hash = WideHasher().update(value).update(1).hash();
+            hashes.insert(hash);
+            count++;
+            const uint32_t flipped = WideHasher().update(value ^ 1).update(1).hash();
+            for (int bit = 0; bit < 32; bit++) {
+                bitFlips[bit] += ((hash ^ flipped) >> bit) & 1;
+            }
+        }
+    }
+    EXPECT_LE(count - hashes.size(), 4u);
+    for (int bit = 0; bit < 32; bit++) {
+        SCOPED_TRACE(bit);
+        // 4096 trials, about 2048 flips each.
+        EXPECT_GT(bitFlips[bit], 1800u);
+        EXPECT_LT(bitFlips[bit], 2300u);
+    }
+}
+
 }  // namespace minikin
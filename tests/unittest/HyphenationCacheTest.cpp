@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HyphenationCache.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/Hyphenator.h"
+
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+class TestableHyphenationCache : public HyphenationCache {
+public:
+    TestableHyphenationCache() : HyphenationCache() {}
+    using HyphenationCache::MAX_ENTRIES;
+    using HyphenationCache::MAX_WORD_LENGTH;
+};
+
+static std::vector<HyphenationType> hyphenateWithCache(HyphenationCache* cache,
+                                                       const Hyphenator& hyphenator,
+                                                       const std::vector<uint16_t>& word) {
+    std::vector<HyphenationType> result(word.size());
+    cache->hyphenate(hyphenator, word, result.data());
+    return result;
+}
+
+TEST(HyphenationCacheTest, sameResultAsHyphenator) {
+    TestableHyphenationCache cache;
+    const Hyphenator* hyphenator = Hyphenator::loadBinary(nullptr, 2, 2, "en");
+    const std::vector<uint16_t> word = utf8ToUtf16("hyphen-ation");
+
+    std::vector<HyphenationType> expected;
+    hyphenator->hyphenate(word, &expected);
+
+    EXPECT_EQ(expected, hyphenateWithCache(&cache, *hyphenator, word));
+    EXPECT_EQ(0u, cache.getStats().hits());
+    EXPECT_EQ(1u, cache.getStats().misses());
+    EXPECT_EQ(1u, cache.getCacheSize());
+
+    EXPECT_EQ(expected, hyphenateWithCache(&cache, *hyphenator, word));
+    EXPECT_EQ(1u, cache.getStats().hits());
+    EXPECT_EQ(1u, cache.getCacheSize());
+}
+
+TEST(HyphenationCacheTest, keyedByHyphenator) {
+    TestableHyphenationCache cache;
+    // Catalan hyphenates "l·l" differently from the other languages.
+    const Hyphenator* english = Hyphenator::loadBinary(nullptr, 2, 2, "en");
+    const Hyphenator* catalan = Hyphenator::loadBinary(nullptr, 2, 2, "ca");
+    const std::vector<uint16_t> word = utf8ToUtf16("col·lecció");
+
+    std::vector<HyphenationType> englishResult;
+    english->hyphenate(word, &englishResult);
+    std::vector<HyphenationType> catalanResult;
+    catalan->hyphenate(word, &catalanResult);
+    ASSERT_NE(englishResult, catalanResult);
+
+    EXPECT_EQ(englishResult, hyphenateWithCache(&cache, *english, word));
+    EXPECT_EQ(catalanResult, hyphenateWithCache(&cache, *catalan, word));
+    EXPECT_EQ(englishResult, hyphenateWithCache(&cache, *english, word));
+    EXPECT_EQ(catalanResult, hyphenateWithCache(&cache, *catalan, word));
+    EXPECT_EQ(2u, cache.getCacheSize());
+    EXPECT_EQ(2u, cache.getStats().hits());
+}
+
+TEST(HyphenationCacheTest, longWordIsNotCached) {
+    TestableHyphenationCache cache;
+    const Hyphenator* hyphenator = Hyphenator::loadBinary(nullptr, 2, 2, "en");
+    const std::vector<uint16_t> word(TestableHyphenationCache::MAX_WORD_LENGTH + 1, 'a');
+
+    std::vector<HyphenationType> expected;
+    hyphenator->hyphenate(word, &expected);
+    EXPECT_EQ(expected, hyphenateWithCache(&cache, *hyphenator, word));
+    EXPECT_EQ(0u, cache.getCacheSize());
+    EXPECT_EQ(1u, cache.getStats().bypasses());
+}
+
+TEST(HyphenationCacheTest, clear) {
+    TestableHyphenationCache cache;
+    const Hyphenator* hyphenator = Hyphenator::loadBinary(nullptr, 2, 2, "en");
+    hyphenateWithCache(&cache, *hyphenator, utf8ToUtf16("hyphen-ation"));
+    EXPECT_EQ(1u, cache.getCacheSize());
+    cache.clear();
+    EXPECT_EQ(0u, cache.getCacheSize());
+}
+
+}  // namespace minikin
@@ -68,6 +68,7 @@ public:
 
     using HyphenatorMap::addAliasInternal;
     using HyphenatorMap::addInternal;
+    using HyphenatorMap::getMemoEntryCountInternal;
     using HyphenatorMap::lookupInternal;
 };
 
@@ -143,6 +144,16 @@ protected:
         return mMap.lookupInternal(getLocale(localeStr));
     }
 
+    void add(const std::string& localeStr, const Hyphenator* hyphenator) {
+        mMap.addInternal(localeStr, hyphenator);
+    }
+
+    void addAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr) {
+        mMap.addAliasInternal(fromLocaleStr, toLocaleStr);
+    }
+
+    size_t getMemoEntryCount() { return mMap.getMemoEntryCountInternal(); }
+
 private:
     TestableHyphenatorMap mMap;
 };
@@ -303,5 +314,45 @@ TEST_F(HyphenatorMapTest, CyrlScriptFallback) {
     EXPECT_NE(MN_CYRL_HYPHENATOR, lookup("und-Cyrl"));
 }
 
+TEST_F(HyphenatorMapTest, memoInvalidation) {
+    const Hyphenator* newHyphenator = FAKE_ADDRESS++;
+    EXPECT_EQ(EN_US_HYPHENATOR, lookup("en-US"));
+    EXPECT_EQ(EN_US_HYPHENATOR, lookup("en-US"));  // From the memo.
+    add("en-US", newHyphenator);
+    EXPECT_EQ(newHyphenator, lookup("en-US"));
+
+    EXPECT_EQ(DE_1996_HYPHENATOR, lookup("de"));
+    addAlias("de", "de-1901");
+    EXPECT_EQ(DE_1901_HYPHENATOR, lookup("de"));
+}
+
+// Invalidating the memo reuses the entries of the locales looked up before.
+TEST_F(HyphenatorMapTest, memoInvalidationKeepsMemory) {
+    EXPECT_EQ(EN_US_HYPHENATOR, lookup("en-US"));
+    EXPECT_EQ(DE_1996_HYPHENATOR, lookup("de"));
+    EXPECT_EQ(2u, getMemoEntryCount());
+    for (int i = 0; i < 100; ++i) {
+        const Hyphenator* newHyphenator = FAKE_ADDRESS++;
+        add("en-US", newHyphenator);
+        EXPECT_EQ(newHyphenator, lookup("en-US"));
+        EXPECT_EQ(DE_1996_HYPHENATOR, lookup("de"));
+    }
+    EXPECT_EQ(2u, getMemoEntryCount());
+}
+
+// Many locales share the memo slots. All of them must keep resolving to the right hyphenator.
+TEST_F(HyphenatorMapTest, memoCollision) {
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(AS_HYPHENATOR, lookup("as"));
+        EXPECT_EQ(BG_HYPHENATOR, lookup("bg"));
+        EXPECT_EQ(DE_1996_HYPHENATOR, lookup("de"));
+        EXPECT_EQ(DE_CH_1901_HYPHENATOR, lookup("de-LI-1901"));
+        EXPECT_EQ(EN_US_HYPHENATOR, lookup("en-US"));
+        EXPECT_EQ(ES_HYPHENATOR, lookup("es-GB"));
+        EXPECT_EQ(UND_ETHI_HYPHENATOR, lookup("am"));
+        EXPECT_EQ(UND_ETHI_HYPHENATOR, lookup("ti"));
+    }
+}
+
 }  // namespace
 }  // namespace minikin
@@ -16,9 +16,14 @@
 
 #include "minikin/Hyphenator.h"
 
+#include <algorithm>
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "FileUtils.h"
+#include "HybUtils.h"
+#include "UnicodeUtils.h"
 
 #ifndef NELEM
 #define NELEM(x) ((sizeof(x) / sizeof((x)[0])))
@@ -184,6 +189,20 @@ TEST(HyphenatorTest, malayalamAutomaticHyphenation) {
     EXPECT_EQ(HyphenationType::DONT_BREAK, result[4]);
 }
 
+// A code unit missing from the alphabet disables automatic hyphenation for the whole word, even if
+// the rest of the word is in the alphabet.
+TEST(HyphenatorTest, malayalamWordWithUnmappedCharacter) {
+    std::vector<uint8_t> patternData = readWholeFile(malayalamHyph);
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 2, "en");
+    const uint16_t word[] = {MALAYALAM_KA, MALAYALAM_KA, 'a', MALAYALAM_KA, MALAYALAM_KA};
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(word, &result);
+    EXPECT_EQ((size_t)5, result.size());
+    for (HyphenationType type : result) {
+        EXPECT_EQ(HyphenationType::DONT_BREAK, type);
+    }
+}
+
 // In Armenian script text, soft hyphens should insert an Armenian hyphen if broken at.
 TEST(HyphenatorTest, aremenianSoftHyphen) {
     Hyphenator* hyphenator = Hyphenator::loadBinary(nullptr, 2, 2, "en");
@@ -338,4 +357,110 @@ TEST(HyphenatorTest, startingHyphenMinus) {
     EXPECT_EQ(HyphenationType::DONT_BREAK, result[1]);
 }
 
+TEST(HyphenatorTest, loadFromFile) {
+    Hyphenator* hyphenator = Hyphenator::loadFromFile(usHyph, 2, 3, "en");
+    ASSERT_NE(nullptr, hyphenator);
+    const uint16_t word[] = {'t', 'a', 'b', 'l', 'e'};
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(word, &result);
+    EXPECT_EQ((size_t)5, result.size());
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[2]);
+
+    EXPECT_EQ(nullptr, Hyphenator::loadFromFile("/nonexistent/hyph-en-us.hyb", 2, 3, "en"));
+}
+
+TEST(HyphenatorTest, isValidBinary) {
+    std::vector<uint8_t> patternData = readWholeFile(usHyph);
+    EXPECT_TRUE(Hyphenator::isValidBinary(patternData.data(), patternData.size()));
+    // Truncated file.
+    EXPECT_FALSE(Hyphenator::isValidBinary(patternData.data(), patternData.size() - 1));
+    EXPECT_FALSE(Hyphenator::isValidBinary(patternData.data(), 8));
+    // Broken magic.
+    patternData[0] ^= 0xFF;
+    EXPECT_FALSE(Hyphenator::isValidBinary(patternData.data(), patternData.size()));
+
+    // A Hyphenator for broken data only processes soft hyphens.
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+    const uint16_t word[] = {'t', 'a', 'b', 'l', 'e'};
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(word, &result);
+    for (HyphenationType type : result) {
+        EXPECT_EQ(HyphenationType::DONT_BREAK, type);
+    }
+}
+
+// Words which don't fit into the stack buffer are still hyphenated with patterns.
+TEST(HyphenatorTest, longWord) {
+    std::vector<uint8_t> patternData = readWholeFile(usHyph);
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+    std::string text;
+    for (int i = 0; i < 8; ++i) {
+        text += "hyphenation";
+    }
+    const std::vector<uint16_t> word = utf8ToUtf16(text);
+    ASSERT_LT(64u, word.size());
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(word, &result);
+    EXPECT_EQ(word.size(), result.size());
+    EXPECT_NE(result.end(), std::find(result.begin(), result.end(),
+                                      HyphenationType::BREAK_AND_INSERT_HYPHEN));
+
+    // The result must not depend on the previous contents of the buffer.
+    std::vector<HyphenationType> second;
+    hyphenator->hyphenate(word, &second);
+    EXPECT_EQ(result, second);
+}
+
+TEST(HyphenatorTest, longestHyphenatedWord) {
+    EXPECT_EQ(Hyphenator::DEFAULT_LONGEST_HYPHENATED_WORD, Hyphenator::getLongestHyphenatedWord());
+    Hyphenator::setLongestHyphenatedWord(100);
+    EXPECT_EQ(100u, Hyphenator::getLongestHyphenatedWord());
+    Hyphenator::setLongestHyphenatedWord(Hyphenator::DEFAULT_LONGEST_HYPHENATED_WORD);
+}
+
+// The version 1 trie table must produce the same hyphenation as the version 0 one.
+TEST(HyphenatorTest, trieVersion1) {
+    std::vector<uint8_t> patternData = readWholeFile(usHyph);
+    std::vector<uint8_t> patternData1 = convertToTrieVersion1(patternData);
+    // The tables have the same size, only the padding before the trie table may differ.
+    EXPECT_LT(patternData1.size(), patternData.size() + 64);
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+    Hyphenator* hyphenator1 = Hyphenator::loadBinary(patternData1.data(), 2, 3, "en");
+    for (const char* word : {"table", "hyphen", "hyphenation", "minikin", "supercalifragilistic",
+                             "Pneumonoultramicroscopicsilicovolcanoconiosis"}) {
+        std::vector<uint16_t> utf16 = utf8ToUtf16(word);
+        std::vector<HyphenationType> expected;
+        std::vector<HyphenationType> actual;
+        hyphenator->hyphenate(utf16, &expected);
+        hyphenator1->hyphenate(utf16, &actual);
+        EXPECT_EQ(expected, actual) << word;
+    }
+}
+
+// Hyphenating the words of a paragraph at once must give the same result as one by one.
+TEST(HyphenatorTest, batchHyphenation) {
+    std::vector<uint8_t> patternData = readWholeFile(usHyph);
+    for (const auto& data : {patternData, convertToTrieVersion1(patternData)}) {
+        Hyphenator* hyphenator = Hyphenator::loadBinary(data.data(), 2, 3, "en");
+        const std::vector<uint16_t> text =
+                utf8ToUtf16("table hyphenation ex\u00ADample minikin a-b supercalifragilistic");
+        const std::vector<Range> words = {Range(0, 5),   Range(6, 17),  Range(18, 26),
+                                          Range(27, 34), Range(35, 38), Range(39, 59)};
+        std::vector<HyphenationType> actual(text.size(), HyphenationType::BREAK_AND_INSERT_HYPHEN);
+        hyphenator->hyphenate(text, words, actual.data());
+
+        const U16StringPiece textPiece(text);
+        for (const Range& range : words) {
+            std::vector<HyphenationType> expected;
+            hyphenator->hyphenate(textPiece.substr(range), &expected);
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                                   actual.begin() + range.getStart()));
+        }
+        // The separators between the words are left untouched.
+        for (size_t offset : {5, 17, 26, 34, 38}) {
+            EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, actual[offset]);
+        }
+    }
+}
+
 }  // namespace minikin
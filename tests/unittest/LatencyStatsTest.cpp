@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyStats.h"
+
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(LatencyStatsTest, getBucketIndex) {
+    EXPECT_EQ(0u, LatencyStats::getBucketIndex(0));
+    EXPECT_EQ(0u, LatencyStats::getBucketIndex(1));
+    EXPECT_EQ(1u, LatencyStats::getBucketIndex(2));
+    EXPECT_EQ(1u, LatencyStats::getBucketIndex(3));
+    EXPECT_EQ(10u, LatencyStats::getBucketIndex(1024));
+    EXPECT_EQ(10u, LatencyStats::getBucketIndex(2047));
+    EXPECT_EQ(LatencyStats::kBucketCount - 1, LatencyStats::getBucketIndex(UINT64_MAX));
+}
+
+TEST(LatencyStatsTest, mergeThreads) {
+    LatencyStats::reset();
+    LatencyStats::record(LatencyStats::kItemize, 100);
+    std::thread thread([] {
+        LatencyStats::record(LatencyStats::kItemize, 100);
+        LatencyStats::record(LatencyStats::kItemize, 5000);
+    });
+    thread.join();
+
+    // The counts of the exited thread are kept.
+    const LatencyStats::Buckets buckets = LatencyStats::getBuckets(LatencyStats::kItemize);
+    EXPECT_EQ(2u, buckets[LatencyStats::getBucketIndex(100)]);
+    EXPECT_EQ(1u, buckets[LatencyStats::getBucketIndex(5000)]);
+    EXPECT_EQ(0u, LatencyStats::getBuckets(LatencyStats::kLayoutPiece)[6]);  // 100 ns
+
+    LatencyStats::reset();
+    EXPECT_EQ(0u, LatencyStats::getBuckets(LatencyStats::kItemize)[6]);
+}
+
+TEST(LatencyStatsTest, scopedLatency) {
+    LatencyStats::reset();
+    LatencyStats::setEnabled(false);
+    { ScopedLatency latency(LatencyStats::kLayoutPiece); }
+    uint64_t count = 0;
+    for (uint64_t bucketCount : LatencyStats::getBuckets(LatencyStats::kLayoutPiece)) {
+        count += bucketCount;
+    }
+    EXPECT_EQ(0u, count);
+
+    LatencyStats::setEnabled(true);
+    { ScopedLatency latency(LatencyStats::kLayoutPiece); }
+    { ScopedLatency latency(LatencyStats::kMeasurePerKiloCodeUnit, 2000); }
+    LatencyStats::setEnabled(false);
+    for (uint64_t bucketCount : LatencyStats::getBuckets(LatencyStats::kLayoutPiece)) {
+        count += bucketCount;
+    }
+    EXPECT_EQ(1u, count);
+}
+
+TEST(LatencyStatsTest, toString) {
+    LatencyStats::reset();
+    for (int i = 0; i < 10; ++i) {
+        LatencyStats::record(LatencyStats::kBreakLineOptimal, 1000);  // The bucket 9.
+    }
+    const std::string out = LatencyStats::toString();
+    EXPECT_NE(std::string::npos,
+              out.find("  breakLineOptimal: count=10 p50<1024 p90<1024 p99<1024 buckets=9:10\n"));
+    EXPECT_NE(std::string::npos, out.find("  itemize: count=0 p50<0 p90<0 p99<0 buckets=\n"));
+    LatencyStats::reset();
+}
+
+}  // namespace minikin
@@ -16,9 +16,16 @@
 
 #include "minikin/Layout.h"
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "minikin/LayoutCache.h"
+#include "minikin/LocaleList.h"
 
 #include "FontTestUtils.h"
 #include "LocaleListCache.h"
@@ -28,8 +35,10 @@ namespace minikin {
 
 class TestableLayoutCache : public LayoutCache {
 public:
-    TestableLayoutCache(uint32_t maxEntries) : LayoutCache(maxEntries) {}
+    TestableLayoutCache(uint32_t maxEntries, uint32_t shardCount = 1, size_t maxLongBytes = 0)
+            : LayoutCache(maxEntries, shardCount, maxLongBytes) {}
     using LayoutCache::getCacheSize;
+    using LayoutCache::getShardCount;
 };
 
 class LayoutCapture {
@@ -249,6 +258,36 @@ TEST(LayoutCacheTest, cacheMissTest) {
     }
 }
 
+TEST(LayoutCacheTest, fontFeatureSettingsCacheTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    auto collection = buildFontCollection("Ascii.ttf");
+
+    TestableLayoutCache layoutCache(10);
+
+    MinikinPaint paint1(collection);
+    paint1.fontFeatureSettings = "'tnum' on";
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(text, range, paint1, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout1);
+
+    // The key needs to hold its own copy of the settings, not the paint's.
+    MinikinPaint paint2(collection);
+    paint2.fontFeatureSettings = "'tnum' on";
+    paint1.fontFeatureSettings = "'liga' on";
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(text, range, paint2, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(layout1.get(), layout2.get());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    LayoutCapture layout3;
+    layoutCache.getOrCreate(text, range, paint1, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout3);
+    EXPECT_NE(layout1.get(), layout3.get());
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+}
+
 TEST(LayoutCacheTest, cacheOverflowTest) {
     auto text = utf8ToUtf16("android");
     Range range(0, text.size());
@@ -273,6 +312,83 @@ TEST(LayoutCacheTest, cacheOverflowTest) {
     EXPECT_NE(layout1.get(), layout3.get());
 }
 
+TEST(LayoutCacheTest, purgeTest) {
+    std::shared_ptr<FontCollection> collection1 = buildFontCollection("Ascii.ttf");
+    std::shared_ptr<FontCollection> collection2 = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint1(collection1);
+    MinikinPaint paint2(collection2);
+
+    TestableLayoutCache layoutCache(100, 4 /* shardCount */);
+    auto layoutAll = [&]() {
+        for (const MinikinPaint* paint : {&paint1, &paint2}) {
+            for (const char* word : {"android", "ANDROID", "minikin"}) {
+                auto text = utf8ToUtf16(word);
+                LayoutCapture layout;
+                layoutCache.getOrCreate(text, Range(0, text.size()), *paint, false /* LTR */,
+                                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+            }
+        }
+    };
+    layoutAll();
+    EXPECT_EQ(6u, layoutCache.getCacheSize());
+
+    // Only the layouts of the collection are purged.
+    layoutCache.purgeCollection(collection1->getId());
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+    layoutCache.purgeCollection(collection1->getId());
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+
+    // The purged layouts are created again.
+    const auto missCount = layoutCache.getStats().misses();
+    layoutAll();
+    EXPECT_EQ(missCount + 3, layoutCache.getStats().misses());
+    EXPECT_EQ(6u, layoutCache.getCacheSize());
+
+    // Only the layouts using the font are purged.
+    layoutCache.purgeFont(collection2->getFamilies()[0]->getFont(0));
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+    layoutCache.purgeFont(collection1->getFamilies()[0]->getFont(0));
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, frequencyAdmissionTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache(3);
+    layoutCache.setFrequencyAdmission(true);
+    auto layout = [&](const std::string& word) {
+        auto text = utf8ToUtf16(word);
+        LayoutCapture capture;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, capture);
+    };
+    for (int i = 0; i < 3; ++i) {
+        for (const char* word : {"android", "ANDROID", "minikin"}) {
+            layout(word);
+        }
+    }
+    EXPECT_EQ(6u, layoutCache.getStats().hits());
+
+    // The words seen once don't evict the popular ones.
+    for (char c = 'a'; c <= 'z'; c++) {
+        layout(std::string(10, c));
+    }
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+    for (const char* word : {"android", "ANDROID", "minikin"}) {
+        layout(word);
+    }
+    EXPECT_EQ(9u, layoutCache.getStats().hits());
+
+    // Without the admission, they do.
+    layoutCache.setFrequencyAdmission(false);
+    for (char c = 'a'; c <= 'z'; c++) {
+        layout(std::string(10, c));
+    }
+    for (const char* word : {"android", "ANDROID", "minikin"}) {
+        layout(word);
+    }
+    EXPECT_EQ(9u, layoutCache.getStats().hits());
+}
+
 TEST(LayoutCacheTest, cacheLengthLimitTest) {
     auto text = utf8ToUtf16(std::string(130, 'a'));
     Range range(0, text.size());
@@ -287,4 +403,638 @@ TEST(LayoutCacheTest, cacheLengthLimitTest) {
     EXPECT_EQ(layoutCache.getCacheSize(), 0u);
 }
 
+TEST(LayoutCacheTest, shardedCacheTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(40, 4);
+    EXPECT_EQ(4u, layoutCache.getShardCount());
+
+    std::vector<const LayoutPiece*> pieces;
+    for (char c = 'a'; c <= 'j'; c++) {
+        auto text = utf8ToUtf16(std::string(5, c));
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+        pieces.push_back(layout.get());
+    }
+    EXPECT_EQ(10u, layoutCache.getCacheSize());
+
+    // The same key must always be routed to the same shard.
+    for (char c = 'a'; c <= 'j'; c++) {
+        auto text = utf8ToUtf16(std::string(5, c));
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+        EXPECT_EQ(pieces[c - 'a'], layout.get());
+    }
+}
+
+TEST(LayoutCacheTest, shardedCacheOverflowTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(8, 4);
+
+    for (int i = 0; i < 100; i++) {
+        auto text = utf8ToUtf16(std::to_string(i));
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    }
+    EXPECT_GE(8u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, statsTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(1);
+
+    LayoutCapture layout;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout);
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(1u, layoutCache.getStats().hits());
+    EXPECT_EQ(1u, layoutCache.getStats().misses());
+    EXPECT_EQ(1u, layoutCache.getStats().inserts());
+    EXPECT_EQ(0u, layoutCache.getStats().evictions());
+
+    // Inserting another entry evicts the first one.
+    auto text2 = utf8ToUtf16("ANDROID");
+    layoutCache.getOrCreate(text2, Range(0, text2.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(2u, layoutCache.getStats().inserts());
+    EXPECT_EQ(1u, layoutCache.getStats().evictions());
+
+    // Too long text is not cached.
+    auto longText = utf8ToUtf16(std::string(LENGTH_LIMIT_CACHE, 'a'));
+    layoutCache.getOrCreate(longText, Range(0, longText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(1u, layoutCache.getStats().bypasses());
+    EXPECT_EQ(2u, layoutCache.getStats().misses());
+
+    // Purging is not an eviction.
+    layoutCache.clear();
+    EXPECT_EQ(1u, layoutCache.getStats().evictions());
+}
+
+TEST(LayoutCacheTest, ancestorPaintIdTest) {
+    // Regular.ttf covers a-z, so the derived collection lays out "abc" as its parent does.
+    auto parent = std::make_shared<FontCollection>(buildFontFamily("Regular.ttf"));
+    auto derived = parent->createCollectionWithFamilies({buildFontFamily("Ja.ttf", "ja")});
+    MinikinPaint parentPaint(parent);
+    MinikinPaint paint(derived);
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    auto text = utf8ToUtf16("abc");
+    const Range range(0, text.size());
+
+    const LayoutCacheKey parentKey(text, range, parentPaint, PaintIdCache::getId(parentPaint),
+                                   false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                   EndHyphenEdit::NO_EDIT);
+    const LayoutCacheKey key(text, range, paint, paintId, false /* LTR */,
+                             StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_TRUE(parentKey == key);
+
+    // The ID of the paint with the parent is only looked up once.
+    const uint64_t lookups = PaintIdCache::getStats().hits() + PaintIdCache::getStats().misses();
+    const LayoutCacheKey otherKey(text, Range(0, 1), paint, paintId, false /* LTR */,
+                                  StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(lookups, PaintIdCache::getStats().hits() + PaintIdCache::getStats().misses());
+}
+
+TEST(LayoutCacheTest, runTest) {
+    // The pieces of "abc de abc", each being its own context as with LayoutSplitter.
+    auto text = utf8ToUtf16("abc de abc");
+    const U16StringPiece textBuf(text);
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    std::vector<LayoutCache::RunPiece> pieces;
+    for (const Range& range : {Range(0, 3), Range(3, 4), Range(4, 6), Range(6, 7), Range(7, 10)}) {
+        pieces.push_back({range, range, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT});
+    }
+
+    TestableLayoutCache layoutCache(10, 4 /* shards */);
+    std::vector<uint32_t> indices;
+    std::vector<const LayoutPiece*> layouts;
+    auto capture = [&](uint32_t index, const LayoutPiece& layout, const MinikinPaint&) {
+        indices.push_back(index);
+        layouts.push_back(&layout);
+    };
+
+    // The first run shapes "abc", " " and "de". Their second occurrences share the shaped
+    // pieces, and count as hits.
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 3, 4}), indices);
+    EXPECT_EQ(3u, layoutCache.getStats().misses());
+    EXPECT_EQ(2u, layoutCache.getStats().hits());
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+    EXPECT_EQ(layouts[0], layouts[4]);
+    EXPECT_EQ(layouts[1], layouts[3]);
+
+    // The second run hits every piece, in the same order.
+    indices.clear();
+    layouts.clear();
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 3, 4}), indices);
+    EXPECT_EQ(3u, layoutCache.getStats().misses());
+    EXPECT_EQ(7u, layoutCache.getStats().hits());
+    EXPECT_EQ(layouts[0], layouts[4]);
+    EXPECT_EQ(layouts[1], layouts[3]);
+
+    // The pieces are the ones getOrCreate() returns.
+    LayoutCapture layout;
+    layoutCache.getOrCreate(textBuf.substr(pieces[2].context), Range(0, 2), paint, paintId,
+                            false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                            layout);
+    EXPECT_EQ(layouts[2], layout.get());
+}
+
+TEST(LayoutCacheTest, threadCacheTest) {
+    auto text = utf8ToUtf16("abc de abc");
+    const U16StringPiece textBuf(text);
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    std::vector<LayoutCache::RunPiece> pieces;
+    for (const Range& range : {Range(0, 3), Range(3, 4), Range(4, 6), Range(6, 7), Range(7, 10)}) {
+        pieces.push_back({range, range, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT});
+    }
+
+    TestableLayoutCache layoutCache(10, 4 /* shards */);
+    layoutCache.setThreadCacheEnabled(true);
+    std::vector<const LayoutPiece*> layouts;
+    auto capture = [&](uint32_t, const LayoutPiece& layout, const MinikinPaint&) {
+        layouts.push_back(&layout);
+    };
+
+    // The pieces go to the thread cache once they are found in the shards.
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    EXPECT_EQ(3u, layoutCache.getStats().misses());
+    EXPECT_EQ(7u, layoutCache.getStats().hits());
+    const std::vector<const LayoutPiece*> cachedLayouts(layouts.begin() + 5, layouts.end());
+
+    // The third run only uses the thread cache, which does not count its hits.
+    layouts.clear();
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    EXPECT_EQ(cachedLayouts, layouts);
+    EXPECT_EQ(3u, layoutCache.getStats().misses());
+    EXPECT_EQ(7u, layoutCache.getStats().hits());
+
+    LayoutCapture layout;
+    layoutCache.getOrCreate(textBuf.substr(pieces[2].context), Range(0, 2), paint, paintId,
+                            false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                            layout);
+    EXPECT_EQ(cachedLayouts[2], layout.get());
+    EXPECT_EQ(7u, layoutCache.getStats().hits());
+
+    // Other threads have their own thread cache.
+    std::thread thread([&]() {
+        LayoutCapture otherLayout;
+        layoutCache.getOrCreate(textBuf.substr(pieces[2].context), Range(0, 2), paint, paintId,
+                                false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, otherLayout);
+        EXPECT_EQ(cachedLayouts[2], otherLayout.get());
+    });
+    thread.join();
+    EXPECT_EQ(8u, layoutCache.getStats().hits());
+
+    // Clearing the cache invalidates the thread caches.
+    layoutCache.clear();
+    layouts.clear();
+    layoutCache.getOrCreateRun(textBuf, pieces, paint, paintId, false /* LTR */, capture);
+    EXPECT_EQ(6u, layoutCache.getStats().misses());
+}
+
+TEST(LayoutCacheTest, singleFlightTest) {
+    constexpr int kThreadCount = 8;
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(10);
+    layoutCache.setSingleFlight(true);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&]() {
+            LayoutCapture layout;
+            layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                    EndHyphenEdit::NO_EDIT, layout);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Whether the threads overlapped or not, the text is shaped exactly once.
+    EXPECT_EQ(1u, layoutCache.getStats().misses());
+    EXPECT_EQ(kThreadCount - 1u, layoutCache.getStats().hits());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, boundsTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(10);
+
+    LayoutCapture layout;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout);
+    const MinikinRect expected = layout.get()->calculateBounds(paint);
+    const float expectedAdvance = layout.get()->advance();
+    EXPECT_EQ(0u, layoutCache.getBoundsCount());
+
+    // The bounds are computed from the cached layout without shaping again.
+    MinikinRect rect;
+    float advance = 0;
+    auto boundsCapture = [&](const MinikinRect& r, float a) {
+        rect = r;
+        advance = a;
+    };
+    layoutCache.getOrCreateBounds(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                  EndHyphenEdit::NO_EDIT, boundsCapture);
+    EXPECT_EQ(expected, rect);
+    EXPECT_EQ(expectedAdvance, advance);
+    EXPECT_EQ(1u, layoutCache.getStats().misses());
+    EXPECT_EQ(1u, layoutCache.getStats().hits());
+    EXPECT_EQ(1u, layoutCache.getBoundsStats().misses());
+    EXPECT_EQ(1u, layoutCache.getBoundsCount());
+
+    layoutCache.getOrCreateBounds(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                  EndHyphenEdit::NO_EDIT, boundsCapture);
+    EXPECT_EQ(expected, rect);
+    EXPECT_EQ(1u, layoutCache.getBoundsStats().hits());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    layoutCache.clear();
+    EXPECT_EQ(0u, layoutCache.getBoundsCount());
+}
+
+TEST(LayoutCacheTest, letterSpacingTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+
+    TestableLayoutCache layoutCache(10);
+    std::optional<LayoutPiece> cached;
+    auto capture = [&](const LayoutPiece& layout, const MinikinPaint&) { cached.emplace(layout); };
+    auto expectSameAsDirectLayout = [&](float letterSpacing) {
+        SCOPED_TRACE(letterSpacing);
+        paint.letterSpacing = letterSpacing;
+        layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, capture);
+        const LayoutPiece expected(text, range, false /* LTR */, paint, StartHyphenEdit::NO_EDIT,
+                                   EndHyphenEdit::NO_EDIT);
+        EXPECT_FLOAT_EQ(expected.advance(), cached->advance());
+        ASSERT_EQ(expected.glyphCount(), cached->glyphCount());
+        for (uint32_t i = 0; i < expected.glyphCount(); ++i) {
+            EXPECT_EQ(expected.glyphIdAt(i), cached->glyphIdAt(i));
+            EXPECT_FLOAT_EQ(expected.pointAt(i).x, cached->pointAt(i).x);
+        }
+        ASSERT_EQ(expected.advances().size(), cached->advances().size());
+        for (uint32_t i = 0; i < expected.advances().size(); ++i) {
+            EXPECT_FLOAT_EQ(expected.advances()[i], cached->advances()[i]);
+        }
+    };
+
+    // The frames of an animation of the spacing are shaped once.
+    expectSameAsDirectLayout(0.1f);
+    expectSameAsDirectLayout(0.2f);
+    expectSameAsDirectLayout(-0.5f);
+    EXPECT_EQ(1u, layoutCache.getStats().misses());
+    EXPECT_EQ(2u, layoutCache.getStats().hits());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    // A spacing keeping the optional ligatures is shaped separately.
+    expectSameAsDirectLayout(0.02f);
+    expectSameAsDirectLayout(0.01f);
+    EXPECT_EQ(2u, layoutCache.getStats().misses());
+    EXPECT_EQ(3u, layoutCache.getStats().hits());
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+
+    // The bounds are the ones of the spaced layout.
+    paint.letterSpacing = 0.3f;
+    const LayoutPiece expected(text, range, false /* LTR */, paint, StartHyphenEdit::NO_EDIT,
+                               EndHyphenEdit::NO_EDIT);
+    MinikinRect rect;
+    float advance = 0;
+    auto boundsCapture = [&](const MinikinRect& r, float a) {
+        rect = r;
+        advance = a;
+    };
+    layoutCache.getOrCreateBounds(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                  EndHyphenEdit::NO_EDIT, boundsCapture);
+    EXPECT_FLOAT_EQ(expected.calculateBounds(paint).mRight, rect.mRight);
+    EXPECT_FLOAT_EQ(expected.advance(), advance);
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, sizeInvariantTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.fontFlags = LinearMetrics_Flag;
+
+    TestableLayoutCache layoutCache(10);
+    layoutCache.setSizeInvariantLayouts(true);
+    std::optional<LayoutPiece> cached;
+    auto capture = [&](const LayoutPiece& layout, const MinikinPaint&) { cached.emplace(layout); };
+    auto expectSameAsDirectLayout = [&](float size, float letterSpacing) {
+        SCOPED_TRACE(size);
+        paint.size = size;
+        paint.letterSpacing = letterSpacing;
+        layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, capture);
+        const LayoutPiece expected(text, range, false /* LTR */, paint, StartHyphenEdit::NO_EDIT,
+                                   EndHyphenEdit::NO_EDIT);
+        EXPECT_NEAR(expected.advance(), cached->advance(), 0.01f);
+        EXPECT_NEAR(expected.extent().ascent, cached->extent().ascent, 0.01f);
+        ASSERT_EQ(expected.glyphCount(), cached->glyphCount());
+        for (uint32_t i = 0; i < expected.glyphCount(); ++i) {
+            EXPECT_NEAR(expected.pointAt(i).x, cached->pointAt(i).x, 0.01f);
+        }
+        for (uint32_t i = 0; i < expected.advances().size(); ++i) {
+            EXPECT_NEAR(expected.advances()[i], cached->advances()[i], 0.01f);
+        }
+    };
+
+    // A zoom shapes the text once.
+    expectSameAsDirectLayout(10.0f, 0.0f);
+    expectSameAsDirectLayout(13.5f, 0.0f);
+    expectSameAsDirectLayout(40.0f, 0.0f);
+    EXPECT_EQ(1u, layoutCache.getStats().misses());
+    EXPECT_EQ(2u, layoutCache.getStats().hits());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    // The letter spacing is applied at the size of the paint.
+    expectSameAsDirectLayout(10.0f, 0.1f);
+    expectSameAsDirectLayout(20.0f, 0.1f);
+    EXPECT_EQ(2u, layoutCache.getStats().misses());
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+
+    // Without linear metrics, each size is shaped.
+    paint.fontFlags = 0;
+    expectSameAsDirectLayout(10.0f, 0.0f);
+    expectSameAsDirectLayout(20.0f, 0.0f);
+    EXPECT_EQ(4u, layoutCache.getStats().misses());
+    EXPECT_EQ(4u, layoutCache.getCacheSize());
+
+    // A style the font fakes bold is shaped and cached at each size, and found again.
+    paint.fontFlags = LinearMetrics_Flag;
+    paint.fontStyle = FontStyle(FontStyle::Weight::BOLD);
+    expectSameAsDirectLayout(10.0f, 0.0f);
+    expectSameAsDirectLayout(20.0f, 0.0f);
+    expectSameAsDirectLayout(20.0f, 0.0f);
+    EXPECT_EQ(6u, layoutCache.getStats().misses());
+    EXPECT_EQ(6u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, snapshotTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint(collection);
+    paint.localeListId = registerLocaleList("en-US");
+    paint.fontFeatureSettings = "'liga' off";
+    MinikinPaint otherPaint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(10, 4);
+    std::vector<std::vector<uint16_t>> texts = {utf8ToUtf16("android"), utf8ToUtf16("minikin"),
+                                                utf8ToUtf16("layout")};
+    for (const auto& text : texts) {
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    }
+    // Not written since the collection is not in the snapshot.
+    LayoutCapture otherLayout;
+    layoutCache.getOrCreate(texts[0], Range(0, texts[0].size()), otherPaint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, otherLayout);
+
+    BufferWriter fakeWriter(nullptr);
+    layoutCache.writeSnapshot(&fakeWriter, {collection});
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    layoutCache.writeSnapshot(&writer, {collection});
+    EXPECT_EQ(fakeWriter.size(), writer.size());
+
+    TestableLayoutCache restoredCache(10);
+    BufferReader reader(buffer.data());
+    restoredCache.readSnapshot(&reader, {collection});
+    EXPECT_EQ(buffer.size(), reader.pos());
+    EXPECT_EQ(texts.size(), restoredCache.getCacheSize());
+    EXPECT_EQ(texts.size(), restoredCache.getStats().inserts());
+
+    // The restored entries are hits and have the same layout.
+    for (const auto& text : texts) {
+        LayoutCapture expected;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, expected);
+        LayoutCapture restored;
+        restoredCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                  StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, restored);
+        EXPECT_EQ(expected.get()->advance(), restored.get()->advance());
+        EXPECT_EQ(expected.get()->glyphCount(), restored.get()->glyphCount());
+        EXPECT_EQ(expected.get()->fontAt(0), restored.get()->fontAt(0));
+        EXPECT_EQ(expected.get()->pointAt(1), restored.get()->pointAt(1));
+    }
+    EXPECT_EQ(0u, restoredCache.getStats().misses());
+}
+
+TEST(LayoutCacheTest, sharedTableTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint(collection);
+    paint.localeListId = registerLocaleList("en-US");
+    MinikinPaint otherPaint(collection);
+    otherPaint.size = 20.0f;
+
+    TestableLayoutCache layoutCache(10, 4);
+    std::vector<std::vector<uint16_t>> texts = {utf8ToUtf16("OK"), utf8ToUtf16("Cancel"),
+                                                utf8ToUtf16("Settings"), utf8ToUtf16("0123")};
+    for (const auto& text : texts) {
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    }
+
+    BufferWriter fakeWriter(nullptr);
+    layoutCache.writeSharedTable(&fakeWriter, {collection});
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    layoutCache.writeSharedTable(&writer, {collection});
+    EXPECT_EQ(fakeWriter.size(), writer.size());
+
+    TestableLayoutCache appCache(10);
+    // A truncated table, or one for other fonts, is rejected.
+    EXPECT_FALSE(appCache.setSharedTable(buffer.data(), buffer.size() - 1, {collection}));
+    EXPECT_FALSE(appCache.setSharedTable(buffer.data(), buffer.size(), {}));
+    std::vector<uint8_t> corrupted = buffer;
+    std::fill(corrupted.begin(), corrupted.begin() + sizeof(uint32_t), 0xFF);  // The paint count.
+    EXPECT_FALSE(appCache.setSharedTable(corrupted.data(), corrupted.size(), {collection}));
+    ASSERT_TRUE(appCache.setSharedTable(buffer.data(), buffer.size(), {collection}));
+    // Nothing is copied until it is looked up.
+    EXPECT_EQ(0u, appCache.getCacheSize());
+
+    for (const auto& text : texts) {
+        LayoutCapture expected;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, expected);
+        LayoutCapture shared;
+        appCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                             StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, shared);
+        EXPECT_EQ(expected.get()->advance(), shared.get()->advance());
+        EXPECT_EQ(expected.get()->glyphCount(), shared.get()->glyphCount());
+        EXPECT_EQ(expected.get()->fontAt(0), shared.get()->fontAt(0));
+        EXPECT_EQ(expected.get()->pointAt(1), shared.get()->pointAt(1));
+    }
+    EXPECT_EQ(texts.size(), appCache.getSharedTableStats().hits());
+    EXPECT_EQ(texts.size(), appCache.getCacheSize());
+
+    // The table hits are cached, so they are not looked up in the table again.
+    LayoutCapture layout;
+    appCache.getOrCreate(texts[0], Range(0, texts[0].size()), paint, false /* LTR */,
+                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(texts.size(), appCache.getSharedTableStats().hits());
+    EXPECT_EQ(1u, appCache.getStats().hits());
+
+    // Another text, or the same text with another paint, is shaped.
+    const std::vector<uint16_t> otherText = utf8ToUtf16("Done");
+    appCache.getOrCreate(otherText, Range(0, otherText.size()), paint, false /* LTR */,
+                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    appCache.getOrCreate(texts[1], Range(0, texts[1].size()), otherPaint, false /* LTR */,
+                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(2u, appCache.getSharedTableStats().misses());
+    EXPECT_EQ(texts.size(), appCache.getSharedTableStats().hits());
+
+    // Without the table, a cleared cache shapes the texts again.
+    EXPECT_TRUE(appCache.setSharedTable(nullptr, 0, {}));
+    appCache.clear();
+    appCache.getOrCreate(texts[0], Range(0, texts[0].size()), paint, false /* LTR */,
+                         StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(texts.size(), appCache.getSharedTableStats().hits());
+    EXPECT_EQ(2u, appCache.getSharedTableStats().misses());
+}
+
+TEST(LayoutCacheTest, longTextCacheTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    auto longText = utf8ToUtf16(std::string(LENGTH_LIMIT_CACHE, 'a'));
+    auto longText2 = utf8ToUtf16(std::string(LENGTH_LIMIT_CACHE, 'b'));
+    auto tooLongText = utf8ToUtf16(std::string(LENGTH_LIMIT_LONG_CACHE, 'a'));
+
+    TestableLayoutCache layoutCache(10, 1, 1024 * 1024);
+
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(longText, Range(0, longText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(longText, Range(0, longText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(layout1.get(), layout2.get());
+    EXPECT_EQ(1u, layoutCache.getLongStats().hits());
+    EXPECT_EQ(1u, layoutCache.getLongStats().misses());
+    EXPECT_EQ(0u, layoutCache.getStats().misses());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    layoutCache.getOrCreate(tooLongText, Range(0, tooLongText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    EXPECT_EQ(1u, layoutCache.getStats().bypasses());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    // The long pieces have their own budget.
+    const size_t entryUsage = layoutCache.getMemoryUsage();
+    layoutCache.setMaxLongMemoryUsage(entryUsage);
+    layoutCache.getOrCreate(longText2, Range(0, longText2.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    EXPECT_EQ(1u, layoutCache.getLongStats().evictions());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    // Disabling the long cache drops the long pieces and bypasses them.
+    layoutCache.setMaxLongMemoryUsage(0);
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    layoutCache.getOrCreate(longText2, Range(0, longText2.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    EXPECT_EQ(2u, layoutCache.getStats().bypasses());
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, memoryBudgetTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    // The entry count limit is large enough not to be reached.
+    TestableLayoutCache layoutCache(1000);
+
+    auto text = utf8ToUtf16("android");
+    LayoutCapture layout;
+    layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    const size_t entryUsage = layoutCache.getMemoryUsage();
+    EXPECT_LT(0u, entryUsage);
+
+    // Each entry below uses the same amount of memory since they have the same length.
+    const size_t budget = entryUsage * 3;
+    layoutCache.setMaxMemoryUsage(budget);
+    for (char c = 'a'; c <= 'z'; c++) {
+        auto text1 = utf8ToUtf16(std::string(7, c));
+        LayoutCapture layout1;
+        layoutCache.getOrCreate(text1, Range(0, text1.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+        EXPECT_GE(budget, layoutCache.getMemoryUsage());
+    }
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+
+    // Shrinking the budget evicts immediately.
+    layoutCache.setMaxMemoryUsage(entryUsage);
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    layoutCache.clear();
+    EXPECT_EQ(0u, layoutCache.getMemoryUsage());
+}
+
+TEST(LayoutCacheTest, sharedTextTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    const uint32_t paintId = PaintIdCache::getId(paint);
+    auto text = std::make_shared<const std::vector<uint16_t>>(utf8ToUtf16("android"));
+    const Range range(0, text->size());
+
+    TestableLayoutCache layoutCache(10);
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(*text, text, range, paint, paintId, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+    // The entry refers to the text instead of retaining a copy.
+    EXPECT_EQ(nullptr, layout1.get()->text());
+    EXPECT_EQ(2, text.use_count());
+
+    // The same text in another buffer hits the entry.
+    auto copy = utf8ToUtf16("android");
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(copy, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(layout1.get(), layout2.get());
+    EXPECT_EQ(1u, layoutCache.getStats().hits());
+
+    // The text the entry keeps alive is counted as if the entry retained a copy.
+    TestableLayoutCache copyingCache(10);
+    copyingCache.getOrCreate(copy, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                             EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(copyingCache.getMemoryUsage(), layoutCache.getMemoryUsage());
+
+    // The entry is not in the snapshot, since the text is not.
+    BufferWriter fakeWriter(nullptr);
+    layoutCache.writeSnapshot(&fakeWriter, {paint.font});
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    layoutCache.writeSnapshot(&writer, {paint.font});
+    TestableLayoutCache restoredCache(10);
+    BufferReader reader(buffer.data());
+    restoredCache.readSnapshot(&reader, {paint.font});
+    EXPECT_EQ(0u, restoredCache.getCacheSize());
+
+    // Evicting the entry releases the text.
+    layoutCache.clear();
+    EXPECT_EQ(1, text.use_count());
+}
+
 }  // namespace minikin
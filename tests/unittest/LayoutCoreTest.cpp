@@ -22,6 +22,8 @@
 #include "minikin/LayoutPieces.h"
 
 #include "FontTestUtils.h"
+#include "LayoutBudget.h"
+#include "MinikinInternal.h"
 #include "UnicodeUtils.h"
 
 namespace minikin {
@@ -154,6 +156,43 @@ TEST(LayoutPieceTest, doLayoutTest_MultiFont) {
     }
 }
 
+TEST(LayoutPieceTest, budgetTest) {
+    // See doLayoutTest_MultiFont for the details of the fonts.
+    const std::vector<std::string> fonts = {"LayoutTestFont.ttf", "Hiragana.ttf"};
+    LayoutBudget::resetTriggerCounts();
+    {
+        // The shaping in chunks doesn't change the layout without kerning or ligatures.
+        LayoutBudget::setLimit(LayoutBudget::kShapingLength, 2);
+        auto layout = buildLayout("IVIVI", fonts);
+        LayoutBudget::setLimit(LayoutBudget::kShapingLength, 0);
+        EXPECT_EQ(1u, LayoutBudget::getTriggerCount(LayoutBudget::kShapingLength));
+        EXPECT_EQ(5u, layout.glyphCount());
+        EXPECT_EQ(Point(60.0f, 0), layout.pointAt(2));
+        EXPECT_EQ(130.0f, layout.advance());
+    }
+    {
+        // The text after the first font run is laid out with its font.
+        LayoutBudget::setLimit(LayoutBudget::kItemizeRuns, 1);
+        auto layout = buildLayout("I\u3042I", fonts);
+        LayoutBudget::setLimit(LayoutBudget::kItemizeRuns, 0);
+        EXPECT_EQ(1u, LayoutBudget::getTriggerCount(LayoutBudget::kItemizeRuns));
+        EXPECT_EQ(3u, layout.advances().size());
+        EXPECT_EQ(1u, layout.fonts().size());
+    }
+    {
+        // Within the budgets.
+        LayoutBudget::setLimit(LayoutBudget::kShapingLength, 5);
+        LayoutBudget::setLimit(LayoutBudget::kItemizeRuns, 3);
+        auto layout = buildLayout("I\u3042I", fonts);
+        LayoutBudget::setLimit(LayoutBudget::kShapingLength, 0);
+        LayoutBudget::setLimit(LayoutBudget::kItemizeRuns, 0);
+        EXPECT_EQ(1u, LayoutBudget::getTriggerCount(LayoutBudget::kShapingLength));
+        EXPECT_EQ(1u, LayoutBudget::getTriggerCount(LayoutBudget::kItemizeRuns));
+        EXPECT_EQ(2u, layout.fonts().size());
+        EXPECT_EQ(40.0f, layout.advance());
+    }
+}
+
 TEST(LayoutPieceTest, doLayoutTest_Ligature) {
     // Ligature.ttf support all ASCII characters.
     // Ascender: 8em, Descender: -2em
@@ -240,5 +279,231 @@ TEST(LayoutPieceTest, doLayoutTest_Ligature) {
     }
 }
 
+TEST(LayoutPieceTest, copyAndMoveTest) {
+    auto original = buildLayout("CIV", {"LayoutTestFont.ttf"});
+    ASSERT_EQ(3u, original.glyphCount());
+
+    auto expectSameLayout = [&original](const LayoutPiece& layout) {
+        ASSERT_EQ(original.glyphCount(), layout.glyphCount());
+        for (uint32_t i = 0; i < layout.glyphCount(); ++i) {
+            EXPECT_EQ(original.glyphIdAt(i), layout.glyphIdAt(i));
+            EXPECT_EQ(original.pointAt(i), layout.pointAt(i));
+            EXPECT_EQ(original.fontAt(i), layout.fontAt(i));
+        }
+        ASSERT_EQ(original.advances().size(), layout.advances().size());
+        for (uint32_t i = 0; i < layout.advances().size(); ++i) {
+            EXPECT_EQ(original.advances()[i], layout.advances()[i]);
+        }
+        EXPECT_EQ(original.advance(), layout.advance());
+        EXPECT_EQ(original.extent(), layout.extent());
+        EXPECT_EQ(original.getMemoryUsage(), layout.getMemoryUsage());
+    };
+
+    LayoutPiece copied(original);
+    expectSameLayout(copied);
+
+    LayoutPiece moved(std::move(copied));
+    expectSameLayout(moved);
+    EXPECT_EQ(0u, copied.glyphCount());
+    EXPECT_EQ(0u, copied.advances().size());
+
+    auto assigned = buildLayout("I", {"LayoutTestFont.ttf"});
+    assigned = moved;
+    expectSameLayout(assigned);
+}
+
+TEST(LayoutPieceTest, sizeChangeTest) {
+    // The HarfBuzz fonts are reused across pieces, and must follow the size of each paint.
+    auto fc = std::make_shared<FontCollection>(buildFontFamily("LayoutTestFont.ttf"));
+    MinikinPaint paint(fc);
+    for (float size : {10.0f, 20.0f, 10.0f}) {
+        SCOPED_TRACE(size);
+        paint.size = size;
+        auto layout = buildLayout("CIV", paint);
+        EXPECT_EQ(106.0f * size, layout.advance());
+        EXPECT_EQ(Point(100.0f * size, 0), layout.pointAt(1));
+        EXPECT_EQ(1.0f * size, layout.advances()[1]);
+    }
+}
+
+TEST(LayoutPieceTest, retainTextTest) {
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // make 1em = 10px
+
+    auto text = utf8ToUtf16("CIV XL");
+    const Range range(0, 3);
+    LayoutPiece withoutText(text, range, false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(nullptr, withoutText.text());
+
+    LayoutPiece withText(text, range, false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                         EndHyphenEdit::NO_EDIT, true /* retainText */);
+    ASSERT_NE(nullptr, withText.text());
+    EXPECT_NE(text.data(), withText.text());
+    EXPECT_TRUE(std::equal(text.begin(), text.end(), withText.text()));
+    EXPECT_EQ(withoutText.getMemoryUsage() + sizeof(uint16_t) * text.size(),
+              withText.getMemoryUsage());
+
+    // The retained text does not change the layout.
+    EXPECT_EQ(withoutText.glyphCount(), withText.glyphCount());
+    EXPECT_EQ(withoutText.advance(), withText.advance());
+
+    // Copies do not retain the text.
+    LayoutPiece copied(withText);
+    EXPECT_EQ(nullptr, copied.text());
+    EXPECT_EQ(withoutText.getMemoryUsage(), copied.getMemoryUsage());
+}
+
+TEST(LayoutPieceTest, copiesShareArraysTest) {
+    std::unique_ptr<LayoutPiece> original =
+            std::make_unique<LayoutPiece>(buildLayout("CIV", {"LayoutTestFont.ttf"}));
+    const uint32_t glyphCount = original->glyphCount();
+    const std::vector<uint32_t> glyphIds(original->glyphIds().begin(), original->glyphIds().end());
+    const float advance = original->advance();
+
+    LayoutPiece copied(*original);
+    EXPECT_EQ(original->glyphIds().data(), copied.glyphIds().data());
+    EXPECT_EQ(original->advances().data(), copied.advances().data());
+
+    // The arrays stay valid after the original is gone.
+    original.reset();
+    ASSERT_EQ(glyphCount, copied.glyphCount());
+    for (uint32_t i = 0; i < glyphCount; ++i) {
+        EXPECT_EQ(glyphIds[i], copied.glyphIdAt(i));
+        EXPECT_TRUE(copied.fontAt(i).font);
+    }
+    EXPECT_EQ(advance, copied.advance());
+}
+
+TEST(LayoutPieceTest, calculateBoundsTest) {
+    auto fc = std::make_shared<FontCollection>(std::vector<std::shared_ptr<FontFamily>>{
+            buildFontFamily("LayoutTestFont.ttf"), buildFontFamily("Hiragana.ttf")});
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // make 1em = 10px
+
+    // The batched bounds of the font runs match the bounds queried glyph by glyph.
+    auto layout = buildLayout("II\u3042\u3044I", paint);
+    MinikinRect expected;
+    for (uint32_t i = 0; i < layout.glyphCount(); ++i) {
+        const FakedFont& font = layout.fontAt(i);
+        MinikinRect rect;
+        font.font->typeface()->GetBounds(&rect, layout.glyphIdAt(i), paint, font.fakery);
+        rect.offset(layout.pointAt(i).x, layout.pointAt(i).y);
+        expected.join(rect);
+    }
+    EXPECT_EQ(expected, layout.calculateBounds(paint));
+    EXPECT_FALSE(layout.calculateBounds(paint).isEmpty());
+}
+
+static void expectSameLayout(const LayoutPiece& expected, const LayoutPiece& actual) {
+    ASSERT_EQ(expected.glyphCount(), actual.glyphCount());
+    for (uint32_t i = 0; i < expected.glyphCount(); ++i) {
+        EXPECT_EQ(expected.glyphIdAt(i), actual.glyphIdAt(i));
+        EXPECT_EQ(expected.pointAt(i), actual.pointAt(i));
+        EXPECT_EQ(expected.fontAt(i), actual.fontAt(i));
+    }
+    ASSERT_EQ(expected.advances().size(), actual.advances().size());
+    for (uint32_t i = 0; i < expected.advances().size(); ++i) {
+        EXPECT_EQ(expected.advances()[i], actual.advances()[i]);
+    }
+    EXPECT_EQ(expected.advance(), actual.advance());
+    EXPECT_EQ(expected.extent(), actual.extent());
+    ASSERT_EQ(expected.safeBreaks().size(), actual.safeBreaks().size());
+    for (uint32_t i = 0; i < expected.safeBreaks().size(); ++i) {
+        EXPECT_EQ(expected.safeBreaks()[i].offset, actual.safeBreaks()[i].offset);
+        EXPECT_EQ(expected.safeBreaks()[i].glyphIndex, actual.safeBreaks()[i].glyphIndex);
+    }
+}
+
+TEST(LayoutPieceTest, safeBreaksTest) {
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // make 1em = 10px
+
+    auto text = utf8ToUtf16("IVX");
+    LayoutPiece withoutBreaks(text, Range(0, text.size()), false /* rtl */, paint,
+                              StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_TRUE(withoutBreaks.safeBreaks().empty());
+
+    // Every cluster boundary is safe with this font. The range boundaries are not recorded.
+    LayoutPiece ltr(text, Range(0, text.size()), false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                    EndHyphenEdit::NO_EDIT, false /* retainText */, true /* recordSafeBreaks */);
+    ASSERT_EQ(2u, ltr.safeBreaks().size());
+    EXPECT_EQ(1u, ltr.safeBreaks()[0].offset);
+    EXPECT_EQ(1u, ltr.safeBreaks()[0].glyphIndex);
+    EXPECT_EQ(2u, ltr.safeBreaks()[1].offset);
+    EXPECT_EQ(2u, ltr.safeBreaks()[1].glyphIndex);
+
+    // In RTL, the glyphs visually before a break are the ones of the text after it.
+    LayoutPiece rtl(text, Range(0, text.size()), true /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                    EndHyphenEdit::NO_EDIT, false /* retainText */, true /* recordSafeBreaks */);
+    ASSERT_EQ(2u, rtl.safeBreaks().size());
+    EXPECT_EQ(1u, rtl.safeBreaks()[0].offset);
+    EXPECT_EQ(2u, rtl.safeBreaks()[0].glyphIndex);
+    EXPECT_EQ(2u, rtl.safeBreaks()[1].offset);
+    EXPECT_EQ(1u, rtl.safeBreaks()[1].glyphIndex);
+
+    // The breaks are kept by copies.
+    LayoutPiece copied(ltr);
+    EXPECT_EQ(2u, copied.safeBreaks().size());
+}
+
+TEST(LayoutPieceTest, invalidateSubFontCachesTest) {
+    std::shared_ptr<FontFamily> family = buildFontFamily("Ascii.ttf");
+    const std::shared_ptr<MinikinFont> typeface = family->getFont(0)->typeface();
+    const long unusedCount = typeface.use_count();
+    MinikinPaint paint(std::make_shared<FontCollection>(
+            std::vector<std::shared_ptr<FontFamily>>{family}));
+    buildLayout("abc", paint);
+    // The sub-font the thread reuses keeps the typeface alive.
+    EXPECT_LT(unusedCount, typeface.use_count());
+
+    // The thread drops it before its next layout.
+    invalidateSubFontCaches();
+    MinikinPaint otherPaint(std::make_shared<FontCollection>(
+            std::vector<std::shared_ptr<FontFamily>>{buildFontFamily("LayoutTestFont.ttf")}));
+    buildLayout("abc", otherPaint);
+    EXPECT_EQ(unusedCount, typeface.use_count());
+}
+
+TEST(LayoutPieceTest, relayoutTest) {
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // make 1em = 10px
+
+    struct Edit {
+        const char* oldText;
+        const char* newText;
+        uint32_t editStart;
+        uint32_t oldEditEnd;
+        uint32_t newEditEnd;
+    };
+    const Edit edits[] = {
+            {"IVXLC", "IVCCXLC", 2, 2, 4},  // Insertion
+            {"IVXLC", "IVC", 2, 4, 2},      // Deletion
+            {"IVXLC", "IVILC", 2, 3, 3},    // Replacement
+            {"IVXLC", "CIVXLC", 0, 0, 1},   // At the start
+            {"IVXLC", "IVXLCI", 5, 5, 6},   // At the end
+    };
+    for (bool isRtl : {false, true}) {
+        for (const Edit& edit : edits) {
+            SCOPED_TRACE(std::string(edit.newText) + (isRtl ? " RTL" : " LTR"));
+            auto oldText = utf8ToUtf16(edit.oldText);
+            auto newText = utf8ToUtf16(edit.newText);
+            LayoutPiece old(oldText, Range(0, oldText.size()), isRtl, paint,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                            false /* retainText */, true /* recordSafeBreaks */);
+            LayoutPiece expected(newText, Range(0, newText.size()), isRtl, paint,
+                                 StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                                 false /* retainText */, true /* recordSafeBreaks */);
+            LayoutPiece relaidOut =
+                    LayoutPiece::relayout(old, newText, Range(0, newText.size()), edit.editStart,
+                                          edit.oldEditEnd, edit.newEditEnd, isRtl, paint);
+            expectSameLayout(expected, relaidOut);
+        }
+    }
+}
+
 }  // namespace
 }  // namespace minikin
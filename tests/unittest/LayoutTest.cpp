@@ -16,9 +16,14 @@
 
 #include "minikin/Layout.h"
 
+#include <cstring>
+#include <future>
+
 #include <gtest/gtest.h>
 
+#include "minikin/BoundsCache.h"
 #include "minikin/FontCollection.h"
+#include "minikin/LayoutCache.h"
 #include "minikin/LayoutPieces.h"
 #include "minikin/Measurement.h"
 
@@ -430,6 +435,123 @@ TEST_F(LayoutTest, hyphenationTest) {
     }
 }
 
+TEST_F(LayoutTest, layoutModeTest) {
+    MinikinPaint paint(mCollection);
+    paint.size = 10.0f;
+    paint.wordSpacing = 5.0f;
+    std::vector<uint16_t> text = utf8ToUtf16("two words");
+    Range range(0, text.size());
+    Layout all(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    {
+        SCOPED_TRACE("glyphs only");
+        Layout layout(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                      EndHyphenEdit::NO_EDIT, LayoutMode::GLYPHS_ONLY);
+        EXPECT_EQ(all.getAdvance(), layout.getAdvance());
+        EXPECT_TRUE(layout.getAdvances().empty());
+        ASSERT_EQ(all.nGlyphs(), layout.nGlyphs());
+        for (size_t i = 0; i < all.nGlyphs(); ++i) {
+            EXPECT_EQ(all.getFont(i), layout.getFont(i));
+            EXPECT_EQ(all.getGlyphId(i), layout.getGlyphId(i));
+            EXPECT_EQ(all.getX(i), layout.getX(i));
+            EXPECT_EQ(all.getY(i), layout.getY(i));
+        }
+    }
+    {
+        SCOPED_TRACE("advances only");
+        Layout layout(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                      EndHyphenEdit::NO_EDIT, LayoutMode::ADVANCES_ONLY);
+        EXPECT_EQ(all.getAdvance(), layout.getAdvance());
+        EXPECT_EQ(0u, layout.nGlyphs());
+        expectAdvances(all.getAdvances(), layout.getAdvances());
+    }
+}
+
+TEST_F(LayoutTest, relayoutTest) {
+    MinikinPaint paint(mCollection);
+    paint.size = 10.0f;
+    std::vector<uint16_t> longText = utf8ToUtf16("a longer text");
+    std::vector<uint16_t> text = utf8ToUtf16("two words");
+    Range range(0, text.size());
+    Layout expected(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                    EndHyphenEdit::NO_EDIT);
+
+    Layout& layout = Layout::getThreadLocal();
+    EXPECT_EQ(&layout, &Layout::getThreadLocal());
+    layout.relayout(longText, Range(0, longText.size()), Bidi::LTR, paint,
+                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    const uint32_t* glyphIds = layout.getGlyphIds().data();
+    const float* advances = layout.getAdvances().data();
+
+    // A shorter text is laid out in the same arrays, with no trace of the previous one.
+    layout.relayout(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                    EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(glyphIds, layout.getGlyphIds().data());
+    EXPECT_EQ(advances, layout.getAdvances().data());
+    EXPECT_EQ(expected.getAdvance(), layout.getAdvance());
+    EXPECT_EQ(expected.getAdvances(), layout.getAdvances());
+    ASSERT_EQ(expected.nGlyphs(), layout.nGlyphs());
+    for (size_t i = 0; i < expected.nGlyphs(); ++i) {
+        EXPECT_EQ(expected.getFont(i), layout.getFont(i));
+        EXPECT_EQ(expected.getGlyphId(i), layout.getGlyphId(i));
+        EXPECT_EQ(expected.getX(i), layout.getX(i));
+    }
+
+    layout.relayout(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                    EndHyphenEdit::NO_EDIT, LayoutMode::GLYPHS_ONLY);
+    EXPECT_TRUE(layout.getAdvances().empty());
+    EXPECT_EQ(expected.nGlyphs(), layout.nGlyphs());
+    EXPECT_EQ(expected.getAdvance(), layout.getAdvance());
+
+    // A reset layout has room for the advances of the text appended to it.
+    layout.reset(longText.size());
+    EXPECT_EQ(std::vector<float>(longText.size(), 0), layout.getAdvances());
+    EXPECT_EQ(0u, layout.nGlyphs());
+    EXPECT_EQ(0, layout.getAdvance());
+    layout.reset(longText.size(), LayoutMode::GLYPHS_ONLY);
+    EXPECT_TRUE(layout.getAdvances().empty());
+}
+
+TEST_F(LayoutTest, fontExtentBoundsTest) {
+    MinikinPaint paint(mCollection);
+    paint.size = 10.0f;
+    paint.wordSpacing = 5.0f;
+    std::vector<uint16_t> text = utf8ToUtf16("two words");
+    const CacheStats& boundsStats = BoundsCache::getInstance().getStats();
+    const uint64_t boundsMisses = boundsStats.misses();
+    const uint64_t boundsHits = boundsStats.hits();
+
+    // The ascent and the descent of Ascii.ttf are 80 and 20 at 10px.
+    MinikinRect rect;
+    getBounds(text, Range(0, text.size()), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+              EndHyphenEdit::NO_EDIT, &rect, BoundsPrecision::FONT_EXTENT);
+    EXPECT_EQ(MinikinRect(0.0f, -80.0f, 95.0f, 20.0f), rect);
+
+    // No glyph bounds are looked up.
+    EXPECT_EQ(boundsMisses, boundsStats.misses());
+    EXPECT_EQ(boundsHits, boundsStats.hits());
+}
+
+TEST_F(LayoutTest, fontTableTest) {
+    MinikinPaint paint(mCollection);
+    paint.size = 10.0f;
+    std::vector<uint16_t> text = utf8ToUtf16("three words test");
+    Layout layout(text, Range(0, text.size()), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                  EndHyphenEdit::NO_EDIT);
+    ASSERT_EQ(text.size(), layout.nGlyphs());
+    // Every piece uses the same font, which is stored once.
+    ASSERT_EQ(1u, layout.getFonts().size());
+    EXPECT_EQ(mCollection->getFamilies()[0]->getFont(0), layout.getFonts()[0].font.get());
+    ASSERT_EQ(layout.nGlyphs(), layout.getGlyphIds().size());
+    ASSERT_EQ(layout.nGlyphs(), layout.getPoints().size());
+    for (size_t i = 0; i < layout.nGlyphs(); ++i) {
+        EXPECT_EQ(0u, layout.getFontIndex(i));
+        EXPECT_EQ(layout.getFonts()[0].font.get(), layout.getFont(i));
+        EXPECT_EQ(layout.getGlyphIds()[i], layout.getGlyphId(i));
+        EXPECT_EQ(10.0f * i, layout.getX(i));
+        EXPECT_EQ(layout.getPoints()[i].y, layout.getY(i));
+    }
+}
+
 TEST_F(LayoutTest, measuredTextTest) {
     // The test font has following coverage and width.
     // U+0020: 10em
@@ -479,6 +601,101 @@ TEST_F(LayoutTest, measuredTextTest) {
     }
 }
 
+TEST_F(LayoutTest, measureTextUtf8) {
+    // U+0049 (I): 1em
+    // U+0056 (V): 5em
+    // U+10331 (\xF0\x90\x8C\xB1): 10em
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    const char text[] = "I\xF0\x90\x8C\xB1V";
+    const uint32_t size = strlen(text);
+    {
+        std::vector<float> advances(size);
+        EXPECT_EQ(16.0f, Layout::measureTextUtf8(text, size, Range(0, size), Bidi::LTR, paint,
+                                                 StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                                                 advances.data()));
+        EXPECT_EQ(std::vector<float>({1.0f, 10.0f, 0.0f, 0.0f, 0.0f, 5.0f}), advances);
+    }
+    {
+        // The range starts at the first byte of U+10331.
+        std::vector<float> advances(size - 1);
+        EXPECT_EQ(15.0f, Layout::measureTextUtf8(text, size, Range(1, size), Bidi::LTR, paint,
+                                                 StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                                                 advances.data()));
+        EXPECT_EQ(std::vector<float>({10.0f, 0.0f, 0.0f, 0.0f, 5.0f}), advances);
+    }
+    EXPECT_EQ(1.0f, Layout::measureTextUtf8(text, size, Range(0, 1), Bidi::LTR, paint,
+                                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                                            nullptr));
+}
+
+TEST_F(LayoutTest, measureTextBounded) {
+    // U+0020: 10em
+    // U+0049 (I): 1em
+    // U+0056 (V): 5em
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    const std::vector<uint16_t> text = utf8ToUtf16("IV IV IV IV");
+    const Range range(0, text.size());
+    Layout::purgeCaches();
+
+    // The prefix ends with the first code unit crossing the limit, and the pieces after it are
+    // not laid out.
+    const CacheStats& stats = LayoutCache::getInstance().getStats();
+    const uint64_t lookups = stats.hits() + stats.misses();
+    Layout::BoundedMeasurement result =
+            Layout::measureTextBounded(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                                       EndHyphenEdit::NO_EDIT, 20.0f);
+    EXPECT_EQ(4u, result.length);
+    EXPECT_EQ(17.0f, result.advance);
+    EXPECT_EQ(lookups + 3, stats.hits() + stats.misses());
+
+    result = Layout::measureTextBounded(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                                        EndHyphenEdit::NO_EDIT, 0.5f);
+    EXPECT_EQ(0u, result.length);
+    EXPECT_EQ(0.0f, result.advance);
+
+    // The whole range fits.
+    result = Layout::measureTextBounded(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                                        EndHyphenEdit::NO_EDIT, 1000.0f);
+    EXPECT_EQ(text.size(), result.length);
+    EXPECT_EQ(Layout::measureText(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                                  EndHyphenEdit::NO_EDIT, nullptr),
+              result.advance);
+}
+
+TEST_F(LayoutTest, measureTextCoarse) {
+    // U+0049 (I): 1em
+    // U+0056 (V): 5em
+    // U+10331: 10em
+    auto fc = buildFontCollection("LayoutTestFont.ttf");
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // make 1em = 10px
+    paint.scaleX = 1.0f;
+    const std::vector<uint16_t> text = utf8ToUtf16("I\xF0\x90\x8C\xB1V");
+    const Range range(0, text.size());
+
+    // The font is loaded, so the estimate has the advances of the glyphs, which are not shaped.
+    std::promise<std::pair<float, std::vector<float>>> precise;
+    std::vector<float> advances(text.size());
+    EXPECT_EQ(160.0f,
+              Layout::measureTextCoarse(text, range, Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                                        EndHyphenEdit::NO_EDIT, advances.data(),
+                                        [&precise](float advance, const std::vector<float>& adv) {
+                                            precise.set_value(std::make_pair(advance, adv));
+                                        }));
+    EXPECT_EQ(std::vector<float>({10.0f, 100.0f, 0.0f, 50.0f}), advances);
+
+    const std::pair<float, std::vector<float>> result = precise.get_future().get();
+    EXPECT_EQ(160.0f, result.first);
+    EXPECT_EQ(std::vector<float>({10.0f, 100.0f, 0.0f, 50.0f}), result.second);
+
+    // The font has no hyphen, which is guessed to be half an em.
+    EXPECT_EQ(55.0f, Layout::measureTextCoarse(text, Range(3, 4), Bidi::LTR, paint,
+                                              StartHyphenEdit::NO_EDIT,
+                                              EndHyphenEdit::INSERT_HYPHEN, nullptr, nullptr));
+}
+
 // TODO: Add more test cases, e.g. measure text, letter spacing.
 
 }  // namespace minikin
@@ -16,6 +16,9 @@
 
 #include "LayoutUtils.h"
 
+#include <random>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "UnicodeUtils.h"
@@ -502,4 +505,65 @@ TEST(WordBreakTest, goPrevWordBreakTest) {
     ExpectPrevWordBreakForCache(1000, "U+4444 U+302D U+302D | U+4444");
 }
 
+namespace {
+
+// The character-by-character scan which the word break functions used to do.
+bool isWordBreakAfterForTest(uint16_t c) {
+    return c == ' ' || (0x2000 <= c && c <= 0x200A) || c == 0x3000 ||
+           (0x2066 <= c && c <= 0x2069) || (0x202A <= c && c <= 0x202E) || c == 0x200E ||
+           c == 0x200F;
+}
+
+bool isWordBreakBeforeForTest(uint16_t c) {
+    return isWordBreakAfterForTest(c) || (0x3400 <= c && c <= 0x9FFF);
+}
+
+uint32_t referencePrevWordBreak(const std::vector<uint16_t>& text, uint32_t offset) {
+    if (offset == 0) return 0;
+    if (offset > text.size()) offset = text.size();
+    if (isWordBreakBeforeForTest(text[offset - 1])) return offset - 1;
+    for (uint32_t i = offset - 1; i > 0; i--) {
+        if (isWordBreakBeforeForTest(text[i]) || isWordBreakAfterForTest(text[i - 1])) return i;
+    }
+    return 0;
+}
+
+uint32_t referenceNextWordBreak(const std::vector<uint16_t>& text, uint32_t offset) {
+    if (offset >= text.size()) return text.size();
+    if (isWordBreakAfterForTest(text[offset])) return offset + 1;
+    for (uint32_t i = offset + 1; i < text.size(); i++) {
+        if (isWordBreakBeforeForTest(text[i])) return i;
+    }
+    return text.size();
+}
+
+}  // namespace
+
+TEST(WordBreakTest, randomTextTest) {
+    // Mostly letters with the break characters, and the non break characters which share the
+    // upper bits with them, so that both the bulk scan and the per character checks are used.
+    const uint16_t kChars[] = {'a',    'b',    ' ',    0x00A0, 0x1FFF, 0x2000, 0x200A,
+                               0x200B, 0x200E, 0x202A, 0x2030, 0x2066, 0x3000, 0x3001,
+                               0x3400, 0x4E00, 0x9FFF, 0xA000, 0xD83D, 0xFFFF};
+    std::mt19937 mt(0);
+    std::uniform_int_distribution<uint32_t> charDist(0, sizeof(kChars) / sizeof(kChars[0]) - 1);
+    std::uniform_int_distribution<uint32_t> letterDist(0, 9);
+    for (uint32_t length = 1; length < 70; ++length) {
+        for (uint32_t trial = 0; trial < 10; ++trial) {
+            std::vector<uint16_t> text(length);
+            for (uint16_t& c : text) {
+                // Keep the break characters sparse so that long runs of letters are covered.
+                c = letterDist(mt) < 8 ? 'a' : kChars[charDist(mt)];
+            }
+            const U16StringPiece textBuf(text);
+            for (uint32_t offset = 0; offset <= length + 1; ++offset) {
+                EXPECT_EQ(referenceNextWordBreak(text, offset),
+                          getNextWordBreakForCache(textBuf, offset));
+                EXPECT_EQ(referencePrevWordBreak(text, offset),
+                          getPrevWordBreakForCache(textBuf, offset));
+            }
+        }
+    }
+}
+
 }  // namespace minikin
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LineBreakResultCache.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "minikin/LineBreaker.h"
+#include "minikin/MeasuredText.h"
+
+#include "LineBreakerTestHelper.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+namespace {
+
+using line_breaker_test_helper::ConstantRun;
+using line_breaker_test_helper::RectangleLineWidth;
+
+constexpr float CHAR_WIDTH = 10.0f;
+constexpr float ASCENT = -80.0f;
+constexpr float DESCENT = 20.0f;
+
+// A ConstantRun which counts the extent queries, which the line breakers make for every line.
+class CountingRun : public ConstantRun {
+public:
+    CountingRun(const Range& range, int* extentCount)
+            : ConstantRun(range, "en-US", CHAR_WIDTH, ASCENT, DESCENT),
+              mExtentCount(extentCount) {}
+
+    MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
+                            const LayoutPieces& pieces) const override {
+        (*mExtentCount)++;
+        return ConstantRun::getExtent(text, range, pieces);
+    }
+
+private:
+    int* mExtentCount;
+};
+
+// The first line is narrower than the others.
+class IndentedLineWidth : public LineWidth {
+public:
+    IndentedLineWidth(float firstWidth, float restWidth)
+            : mFirstWidth(firstWidth), mRestWidth(restWidth) {}
+
+    float getAt(size_t lineNo) const override { return lineNo == 0 ? mFirstWidth : mRestWidth; }
+    float getMin() const override { return std::min(mFirstWidth, mRestWidth); }
+
+private:
+    float mFirstWidth;
+    float mRestWidth;
+};
+
+std::unique_ptr<MeasuredText> buildMeasuredText(const std::vector<uint16_t>& text,
+                                                uint32_t cacheSize, int* extentCount) {
+    MeasuredTextBuilder builder;
+    builder.addCustomRun<CountingRun>(Range(0, text.size()), extentCount);
+    builder.setLineBreakCacheSize(cacheSize);
+    return builder.build(text, false /* compute hyphenation */, false /* compute full layout */,
+                         nullptr /* no hint */);
+}
+
+void expectSameResult(const LineBreakResult& expected, const LineBreakResult& actual) {
+    EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+    EXPECT_EQ(expected.widths, actual.widths);
+    EXPECT_EQ(expected.ascents, actual.ascents);
+    EXPECT_EQ(expected.descents, actual.descents);
+    EXPECT_EQ(expected.flags, actual.flags);
+}
+
+TEST(LineBreakResultCacheTest, repeatedCall) {
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    int extentCount = 0;
+    std::unique_ptr<MeasuredText> uncached = buildMeasuredText(text, 0, &extentCount);
+    std::unique_ptr<MeasuredText> cached = buildMeasuredText(text, 2, &extentCount);
+    EXPECT_EQ(nullptr, uncached->getLineBreakCache());
+    EXPECT_NE(nullptr, cached->getLineBreakCache());
+
+    const TabStops tabStops(nullptr, 0, CHAR_WIDTH);
+    for (const BreakStrategy strategy : {BreakStrategy::Greedy, BreakStrategy::HighQuality}) {
+        SCOPED_TRACE(static_cast<int>(strategy));
+        const RectangleLineWidth lineWidth(100);
+        const LineBreakResult expected =
+                breakIntoLines(text, strategy, HyphenationFrequency::None, false, *uncached,
+                               lineWidth, tabStops);
+        const LineBreakResult first = breakIntoLines(
+                text, strategy, HyphenationFrequency::None, false, *cached, lineWidth, tabStops);
+        expectSameResult(expected, first);
+
+        extentCount = 0;
+        const LineBreakResult second = breakIntoLines(
+                text, strategy, HyphenationFrequency::None, false, *cached, lineWidth, tabStops);
+        EXPECT_EQ(0, extentCount);
+        expectSameResult(expected, second);
+    }
+}
+
+TEST(LineBreakResultCacheTest, differentArguments) {
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    int extentCount = 0;
+    std::unique_ptr<MeasuredText> uncached = buildMeasuredText(text, 0, &extentCount);
+    std::unique_ptr<MeasuredText> cached = buildMeasuredText(text, 4, &extentCount);
+
+    const float tabStopValues[] = {50};
+    const TabStops tabStops(nullptr, 0, CHAR_WIDTH);
+    const TabStops otherTabStops(tabStopValues, 1, CHAR_WIDTH);
+    const IndentedLineWidth lineWidth(50, 100);
+    const IndentedLineWidth otherLineWidth(100, 100);
+    breakIntoLines(text, BreakStrategy::Greedy, HyphenationFrequency::None, false, *cached,
+                   lineWidth, tabStops);
+
+    const auto expectBrokenAgain = [&](BreakStrategy strategy, const LineWidth& width,
+                                       const TabStops& stops) {
+        const LineBreakResult expected = breakIntoLines(
+                text, strategy, HyphenationFrequency::None, false, *uncached, width, stops);
+        extentCount = 0;
+        const LineBreakResult actual = breakIntoLines(text, strategy, HyphenationFrequency::None,
+                                                      false, *cached, width, stops);
+        EXPECT_NE(0, extentCount);
+        expectSameResult(expected, actual);
+    };
+    expectBrokenAgain(BreakStrategy::Greedy, otherLineWidth, tabStops);
+    expectBrokenAgain(BreakStrategy::HighQuality, lineWidth, tabStops);
+    expectBrokenAgain(BreakStrategy::Greedy, lineWidth, otherTabStops);
+}
+
+TEST(LineBreakResultCacheTest, evictsLeastRecentlyUsed) {
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    int extentCount = 0;
+    std::unique_ptr<MeasuredText> cached = buildMeasuredText(text, 2, &extentCount);
+
+    const TabStops tabStops(nullptr, 0, CHAR_WIDTH);
+    const RectangleLineWidth widths[] = {RectangleLineWidth(50), RectangleLineWidth(100),
+                                         RectangleLineWidth(150)};
+    const auto breakWith = [&](int widthIndex) {
+        extentCount = 0;
+        breakIntoLines(text, BreakStrategy::Greedy, HyphenationFrequency::None, false, *cached,
+                       widths[widthIndex], tabStops);
+        return extentCount != 0;  // Returns true if the text was broken.
+    };
+    EXPECT_TRUE(breakWith(0));
+    EXPECT_TRUE(breakWith(1));
+    EXPECT_FALSE(breakWith(0));
+    EXPECT_TRUE(breakWith(2));  // Evicts width 1.
+    EXPECT_FALSE(breakWith(0));
+    EXPECT_TRUE(breakWith(1));
+}
+
+}  // namespace
+}  // namespace minikin
@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 
+#include <memory>
+
 #include <gtest/gtest.h>
 
 #include "minikin/Hyphenator.h"
 #include "minikin/LineBreaker.h"
+#include "minikin/MeasuredText.h"
 
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
@@ -200,5 +203,47 @@ static std::string toString(const U16StringPiece& textBuf, const LineBreakResult
     return out;
 }
 
+// Expects the word breaks kept in a MeasuredText to give the same result as running WordBreaker
+// again, including the locale switches and the email/URL context across them. breakLine(textBuf,
+// measuredText, doHyphenation, lineWidth) returns the LineBreakResult of the breaker.
+template <typename BreakLine>
+static void expectKeptWordBreaksMatch(const BreakLine& breakLine) {
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "This is an example text. Mail example@example.com or see https://example.com/a/b "
+            "for more information about it.");
+    const std::vector<std::pair<uint32_t, std::string>> runStarts = {
+            {0, "en-US"}, {20, "pl"}, {36, "pl"}, {60, "en-US"}, {90, "pl"}};
+    for (const bool doHyphenation : {false, true}) {
+        for (const float lineWidth : {30.0f, 70.0f, 150.0f, 1000.0f}) {
+            SCOPED_TRACE(std::string(doHyphenation ? "hyphenated, " : "") + "width " +
+                         std::to_string(lineWidth));
+            std::unique_ptr<MeasuredText> measuredTexts[2];
+            for (const bool keepWordBreaks : {false, true}) {
+                MeasuredTextBuilder builder;
+                for (uint32_t i = 0; i < runStarts.size(); ++i) {
+                    const uint32_t end = i + 1 < runStarts.size() ? runStarts[i + 1].first
+                                                                  : textBuf.size();
+                    builder.addCustomRun<ConstantRun>(Range(runStarts[i].first, end),
+                                                      runStarts[i].second, 10.0f, -80.0f, 20.0f);
+                }
+                builder.setKeepWordBreaks(keepWordBreaks);
+                measuredTexts[keepWordBreaks] = builder.build(
+                        textBuf, doHyphenation /* compute hyphenation */,
+                        false /* compute full layout */, nullptr /* no hint */);
+            }
+            EXPECT_FALSE(measuredTexts[0]->hasWordBreaks());
+            EXPECT_TRUE(measuredTexts[1]->hasWordBreaks());
+
+            const LineBreakResult expected =
+                    breakLine(textBuf, *measuredTexts[0], doHyphenation, lineWidth);
+            const LineBreakResult actual =
+                    breakLine(textBuf, *measuredTexts[1], doHyphenation, lineWidth);
+            EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+            EXPECT_EQ(expected.widths, actual.widths);
+            EXPECT_EQ(expected.flags, actual.flags);
+        }
+    }
+}
+
 }  // namespace line_breaker_test_helper
 }  // namespace minikin
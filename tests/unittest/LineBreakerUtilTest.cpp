@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LineBreakerUtil.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/Hyphenator.h"
+
+#include "FileUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+static constexpr const char* kUsHyph = "/system/usr/hyphen-data/hyph-en-us.hyb";
+
+// Returns the expected result of hyphenate(), i.e. every NBSP separated word hyphenated alone.
+static std::vector<HyphenationType> hyphenateWords(const std::vector<uint16_t>& text,
+                                                   const Hyphenator& hyphenator) {
+    std::vector<HyphenationType> expected(text.size(), HyphenationType::DONT_BREAK);
+    size_t start = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == CHAR_NBSP) {
+            if (i > start) {
+                std::vector<uint16_t> word(text.begin() + start, text.begin() + i);
+                std::vector<HyphenationType> result;
+                hyphenator.hyphenate(word, &result);
+                std::copy(result.begin(), result.end(), expected.begin() + start);
+            }
+            start = i + 1;
+        }
+    }
+    return expected;
+}
+
+TEST(LineBreakerUtilTest, hyphenateWithNbsp) {
+    std::vector<uint8_t> patternData = readWholeFile(kUsHyph);
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+
+    // U+00A0 is NO-BREAK SPACE.
+    for (const char* text : {
+                 "",
+                 "\u00A0",
+                 "hyphenation",
+                 "hyphenation\u00A0",
+                 "\u00A0hyphenation",
+                 "hyphenation\u00A0\u00A0international",
+                 "un\u00A0hyphenation\u00A0representation\u00A0of\u00A0a\u00A0paragraph",
+         }) {
+        const std::vector<uint16_t> utf16 = utf8ToUtf16(text);
+        const std::vector<HyphenationType> expected = hyphenateWords(utf16, *hyphenator);
+        EXPECT_EQ(expected, hyphenate(utf16, *hyphenator)) << text;
+
+        // The output is written in place without growing.
+        std::vector<HyphenationType> out(utf16.size() + 1,
+                                         HyphenationType::BREAK_AND_INSERT_HYPHEN);
+        hyphenate(utf16, *hyphenator, out.data());
+        EXPECT_EQ(expected, std::vector<HyphenationType>(out.begin(), out.end() - 1)) << text;
+        EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, out.back()) << text;
+    }
+}
+
+TEST(LineBreakerUtilTest, hyphenateTooLongWord) {
+    std::vector<uint8_t> patternData = readWholeFile(kUsHyph);
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+
+    std::string text;
+    while (text.size() <= Hyphenator::getLongestHyphenatedWord()) {
+        text += "hyphenation";
+    }
+    const std::vector<uint16_t> utf16 = utf8ToUtf16(text);
+    for (HyphenationType type : hyphenate(utf16, *hyphenator)) {
+        EXPECT_EQ(HyphenationType::DONT_BREAK, type);
+    }
+}
+
+}  // namespace minikin
@@ -18,10 +18,13 @@
 
 #include <gtest/gtest.h>
 
+#include <functional>
+
 #include "minikin/LineBreaker.h"
 #include "minikin/Measurement.h"
 
 #include "FontTestUtils.h"
+#include "LocaleListCache.h"
 #include "UnicodeUtils.h"
 
 namespace minikin {
@@ -172,6 +175,38 @@ TEST(MeasuredTextTest, getExtentTest_multiStyle) {
     EXPECT_EQ(MinikinExtent(-160.0f, 40.0f), mt->getExtent(text, Range(0, text.size())));
 }
 
+TEST(MeasuredTextTest, getExtentTest_precomputedPieces) {
+    // With the full layout, the extents come from the precomputed piece extents. They must be the
+    // same as the ones computed piece by piece.
+    auto text = utf8ToUtf16("Hello, World! This text has three styles.");
+    auto font = buildFontCollection("Ascii.ttf");
+    auto customFont = buildFontCollection("CustomExtent.ttf");
+
+    std::unique_ptr<MeasuredText> measuredTexts[2];
+    for (const bool fullLayout : {false, true}) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, 9, std::move(paint), false /* is RTL */);
+        MinikinPaint paint2(customFont);
+        paint2.size = 20.0f;
+        builder.addStyleRun(9, 20, std::move(paint2), true /* is RTL */);
+        MinikinPaint paint3(font);
+        paint3.size = 30.0f;
+        builder.addStyleRun(20, text.size(), std::move(paint3), false /* is RTL */);
+        measuredTexts[fullLayout] = builder.build(text, false /* hyphenation */, fullLayout,
+                                                  nullptr /* no hint */);
+    }
+
+    for (uint32_t start = 0; start <= text.size(); ++start) {
+        for (uint32_t end = start; end <= text.size(); ++end) {
+            EXPECT_EQ(measuredTexts[false]->getExtent(text, Range(start, end)),
+                      measuredTexts[true]->getExtent(text, Range(start, end)))
+                    << "range [" << start << ", " << end << ")";
+        }
+    }
+}
+
 TEST(MeasuredTextTest, buildLayoutTest) {
     auto text = utf8ToUtf16("Hello, World!");
     auto font = buildFontCollection("Ascii.ttf");
@@ -251,6 +286,53 @@ TEST(MeasuredTextTest, buildLayoutTest) {
     EXPECT_EQ(MinikinRect(0.0f, 10.0f, 130.0f, 0.0f), rect);
 }
 
+TEST(MeasuredTextTest, buildLayoutTest_sameAsWithoutPieces) {
+    auto text = utf8ToUtf16("Hello, World! This is an example.");
+    auto font = buildFontCollection("Ascii.ttf");
+    Range fullContext(0, text.size());
+    const auto build = [&](bool computeLayout, bool isRtl) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        paint.wordSpacing = 5.0f;
+        builder.addStyleRun(0, 20, std::move(paint), isRtl);
+        MinikinPaint paint2(font);
+        paint2.size = 20.0f;
+        builder.addStyleRun(20, text.size(), std::move(paint2), isRtl);
+        return builder.build(text, false /* hyphenation */, computeLayout, nullptr /* no hint */);
+    };
+
+    MinikinPaint samePaint(font);
+    samePaint.size = 10.0f;
+    samePaint.wordSpacing = 5.0f;
+    for (bool isRtl : {false, true}) {
+        auto withPieces = build(true /* full layout */, isRtl);
+        auto withoutPieces = build(false /* full layout */, isRtl);
+        for (uint32_t start = 0; start < text.size(); ++start) {
+            for (uint32_t end = start; end <= text.size(); ++end) {
+                for (EndHyphenEdit endHyphen :
+                     {EndHyphenEdit::NO_EDIT, EndHyphenEdit::INSERT_HYPHEN}) {
+                    const Range range(start, end);
+                    Layout expected =
+                            withoutPieces->buildLayout(text, range, fullContext, samePaint,
+                                                       StartHyphenEdit::INSERT_HYPHEN, endHyphen);
+                    Layout actual =
+                            withPieces->buildLayout(text, range, fullContext, samePaint,
+                                                    StartHyphenEdit::INSERT_HYPHEN, endHyphen);
+                    ASSERT_EQ(expected.nGlyphs(), actual.nGlyphs()) << start << " " << end;
+                    for (uint32_t i = 0; i < expected.nGlyphs(); ++i) {
+                        EXPECT_EQ(expected.getGlyphId(i), actual.getGlyphId(i));
+                        EXPECT_EQ(expected.getX(i), actual.getX(i));
+                    }
+                    EXPECT_EQ(expected.getAdvance(), actual.getAdvance()) << start << " " << end;
+                    EXPECT_EQ(expected.getAdvances(), actual.getAdvances())
+                            << start << " " << end;
+                }
+            }
+        }
+    }
+}
+
 TEST(MeasuredTextTest, buildLayoutTest_multiStyle) {
     auto text = utf8ToUtf16("Hello, World!");
     auto font = buildFontCollection("Ascii.ttf");
@@ -532,4 +614,217 @@ TEST(MeasuredTextTest, buildLayoutTest_multiStyle_differentPaint) {
     EXPECT_EQ(MinikinRect(0.0f, 30.0f, 390.0f, 0.0f), rect);
 }
 
+TEST(MeasuredTextTest, buildInParallel) {
+    auto text = utf8ToUtf16(
+            "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs.");
+    auto font = buildFontCollection("Ascii.ttf");
+
+    const auto build = [&](uint32_t maxThreads) {
+        MeasuredTextBuilder builder;
+        for (uint32_t start = 0; start < text.size(); start += 7) {
+            MinikinPaint paint(font);
+            paint.size = 10.0f + (start % 3) * 5.0f;
+            builder.addStyleRun(start, std::min<uint32_t>(start + 7, text.size()),
+                                std::move(paint), false /* is RTL */);
+        }
+        return builder.build(text, true /* hyphenation */, true /* full layout */,
+                             false /* lazy hyphenation */, nullptr /* no hint */, maxThreads);
+    };
+    auto serial = build(1);
+    auto parallel = build(4);
+
+    EXPECT_EQ(serial->widths, parallel->widths);
+    ASSERT_EQ(serial->hyphenBreaks.size(), parallel->hyphenBreaks.size());
+    for (uint32_t i = 0; i < serial->hyphenBreaks.size(); ++i) {
+        EXPECT_EQ(serial->hyphenBreaks[i].offset, parallel->hyphenBreaks[i].offset);
+        EXPECT_EQ(serial->hyphenBreaks[i].first, parallel->hyphenBreaks[i].first);
+        EXPECT_EQ(serial->hyphenBreaks[i].second, parallel->hyphenBreaks[i].second);
+    }
+
+    EXPECT_EQ(serial->layoutPieces.paintIds, parallel->layoutPieces.paintIds);
+    ASSERT_EQ(serial->layoutPieces.offsetMap.size(), parallel->layoutPieces.offsetMap.size());
+    for (const auto& [key, piece] : serial->layoutPieces.offsetMap) {
+        auto it = parallel->layoutPieces.offsetMap.find(key);
+        ASSERT_NE(parallel->layoutPieces.offsetMap.end(), it);
+        EXPECT_EQ(piece.advance(), it->second.advance());
+    }
+}
+
+TEST(MeasuredTextTest, buildWithEditedHint) {
+    auto font = buildFontCollection("Ascii.ttf");
+    const auto build = [&](const std::vector<uint16_t>& text, MeasuredText* hint,
+                           const TextEdit* edit) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        if (edit == nullptr) {
+            return builder.build(text, false /* hyphenation */, true /* full layout */, hint);
+        }
+        return builder.build(text, false /* hyphenation */, true /* full layout */,
+                             false /* lazy hyphenation */, hint, *edit);
+    };
+    const auto cacheLookups = []() {
+        const CacheStats& stats = LayoutCache::getInstance().getStats();
+        return stats.hits() + stats.misses();
+    };
+
+    auto oldText = utf8ToUtf16("This is an example text.");
+    auto hint = build(oldText, nullptr, nullptr);
+
+    // Insert "n" after "an".
+    auto text = utf8ToUtf16("This is ann example text.");
+    const TextEdit edit = {10 /* start */, 0 /* removed length */, 1 /* inserted length */};
+    const uint64_t lookupsBefore = cacheLookups();
+    auto mt = build(text, hint.get(), &edit);
+    // Only "ann" and the following space are laid out again.
+    EXPECT_EQ(2u, cacheLookups() - lookupsBefore);
+
+    auto expected = build(text, nullptr, nullptr);
+    EXPECT_EQ(expected->widths, mt->widths);
+    EXPECT_EQ(expected->layoutPieces.offsetMap.size(), mt->layoutPieces.offsetMap.size());
+}
+
+TEST(MeasuredTextTest, compactWidths) {
+    auto text = utf8ToUtf16("Hello, World!");
+    const std::vector<float> runWidths = {10.25f, 100000.0f, -1.0f, 3.3f, 0.0f, 1.0f / 128};
+    const auto build = [&](bool compact) {
+        MeasuredTextBuilder builder;
+        for (uint32_t i = 0; i < text.size(); ++i) {
+            builder.addReplacementRun(i, i + 1, runWidths[i % runWidths.size()],
+                                      LocaleListCache::getId("en-US"));
+        }
+        builder.setCompactWidths(compact);
+        return builder.build(text, false /* hyphenation */, false /* full layout */,
+                             nullptr /* no hint */);
+    };
+    auto mt = build(false);
+    auto compact = build(true);
+
+    EXPECT_FALSE(mt->hasCompactWidths());
+    ASSERT_TRUE(compact->hasCompactWidths());
+    EXPECT_TRUE(compact->widths.empty());
+    for (uint32_t i = 0; i < text.size(); ++i) {
+        EXPECT_EQ(mt->widths[i], mt->widthAt(i)) << i;
+        // The widths which fit are rounded to 1/64 px, the others are kept as is.
+        EXPECT_NEAR(mt->widths[i], compact->widthAt(i), 1.0f / 128) << i;
+    }
+    EXPECT_EQ(10.25f, compact->widthAt(0));
+    EXPECT_EQ(100000.0f, compact->widthAt(1));
+    EXPECT_EQ(-1.0f, compact->widthAt(2));
+}
+
+TEST(MeasuredTextTest, compactWidthsKeepTinyWidthsNonZero) {
+    auto text = utf8ToUtf16("abc");
+    MeasuredTextBuilder builder;
+    builder.addReplacementRun(0, 1, 0.001f, LocaleListCache::getId("en-US"));
+    builder.addReplacementRun(1, 2, 0.0f, LocaleListCache::getId("en-US"));
+    builder.addReplacementRun(2, 3, 1.0f / 256, LocaleListCache::getId("en-US"));
+    builder.setCompactWidths(true);
+    auto mt = builder.build(text, false /* hyphenation */, false /* full layout */,
+                            nullptr /* no hint */);
+
+    ASSERT_TRUE(mt->hasCompactWidths());
+    EXPECT_EQ(1.0f / MeasuredText::COMPACT_WIDTH_SCALE, mt->widthAt(0));
+    EXPECT_EQ(0.0f, mt->widthAt(1));
+    EXPECT_EQ(1.0f / MeasuredText::COMPACT_WIDTH_SCALE, mt->widthAt(2));
+}
+
+class QueuedExecutor : public Executor {
+public:
+    void execute(std::function<void()>&& job, Priority /* priority */) override {
+        jobs.push_back(std::move(job));
+    }
+
+    uint32_t getConcurrency() const override { return 1; }
+
+    std::vector<std::function<void()>> jobs;
+};
+
+// Counts the times it is measured and cancels the build.
+class CancellingRun : public ReplacementRun {
+public:
+    CancellingRun(const Range& range, std::shared_ptr<MeasuredTextBuild>* build,
+                  uint32_t* measuredCount)
+            : ReplacementRun(range, 20.0f, LocaleListCache::getId("en-US")),
+              mBuild(build),
+              mMeasuredCount(measuredCount) {}
+
+    void getMetrics(const U16StringPiece& text, std::vector<float>* advances,
+                    LayoutPieces* precomputed, LayoutPieces* outPieces) const override {
+        ReplacementRun::getMetrics(text, advances, precomputed, outPieces);
+        (*mMeasuredCount)++;
+        (*mBuild)->cancel();
+    }
+
+private:
+    std::shared_ptr<MeasuredTextBuild>* mBuild;
+    uint32_t* mMeasuredCount;
+};
+
+TEST(MeasuredTextTest, buildAsync) {
+    auto font = buildFontCollection("Ascii.ttf");
+    QueuedExecutor executor;
+    std::unique_ptr<MeasuredText> result;
+    bool called = false;
+    {
+        auto text = utf8ToUtf16("Hello, World!");
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        builder.buildAsync(text, true /* hyphenation */, true /* full layout */,
+                           false /* lazy hyphenation */, 1 /* max threads */, &executor,
+                           [&](std::unique_ptr<MeasuredText>&& mt) {
+                               called = true;
+                               result = std::move(mt);
+                           });
+    }
+    // The text is copied, so it may be gone before the job runs.
+    ASSERT_EQ(1u, executor.jobs.size());
+    EXPECT_FALSE(called);
+    executor.jobs[0]();
+    ASSERT_TRUE(called);
+    ASSERT_NE(nullptr, result);
+    EXPECT_EQ(std::vector<float>(13, CHAR_WIDTH), result->widths);
+    EXPECT_FALSE(result->layoutPieces.offsetMap.empty());
+}
+
+TEST(MeasuredTextTest, buildAsync_cancelled) {
+    auto text = utf8ToUtf16("Hello, World!");
+    QueuedExecutor executor;
+    const auto build = [&](MeasuredTextBuilder& builder, bool* called) {
+        return builder.buildAsync(text, false /* hyphenation */, false /* full layout */,
+                                  false /* lazy hyphenation */, 1 /* max threads */, &executor,
+                                  [called](std::unique_ptr<MeasuredText>&& mt) {
+                                      *called = true;
+                                      EXPECT_EQ(nullptr, mt);
+                                  });
+    };
+
+    // Cancelled before the job starts.
+    {
+        MeasuredTextBuilder builder;
+        builder.addReplacementRun(0, text.size(), 20.0f, LocaleListCache::getId("en-US"));
+        bool called = false;
+        auto handle = build(builder, &called);
+        handle->cancel();
+        executor.jobs.back()();
+        EXPECT_TRUE(called);
+    }
+    // Cancelled in the middle, so the runs after the cancelling one are not measured.
+    {
+        std::shared_ptr<MeasuredTextBuild> handle;
+        uint32_t measuredRuns = 0;
+        MeasuredTextBuilder builder;
+        builder.addCustomRun<CancellingRun>(Range(0, 5), &handle, &measuredRuns);
+        builder.addCustomRun<CancellingRun>(Range(5, text.size()), &handle, &measuredRuns);
+        bool called = false;
+        handle = build(builder, &called);
+        executor.jobs.back()();
+        EXPECT_TRUE(called);
+        EXPECT_EQ(1u, measuredRuns);
+    }
+}
+
 }  // namespace minikin
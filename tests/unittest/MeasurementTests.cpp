@@ -59,4 +59,31 @@ TEST(Measurement, getRunAdvance_kka) {
     EXPECT_EQ(30.0, getAdvance(ligated, "U+0915 U+094D U+0915 |"));
 }
 
+TEST(Measurement, caretIndex) {
+    // Latin, a ligature, a Devanagari conjunct and an emoji sequence.
+    const std::vector<uint16_t> text =
+            utf8ToUtf16("ab fi \u0915\u094D\u0915 \U0001F468\u200D\U0001F469 cd");
+    std::vector<float> advances(text.size(), 10.0f);
+    advances[4] = 0.0f;                                                // "fi" ligature
+    advances[7] = advances[8] = 0.0f;                                  // ka+virama+ka conjunct
+    advances[11] = advances[12] = advances[13] = advances[14] = 0.0f;  // ZWJ sequence
+
+    for (size_t start : {0u, 3u}) {
+        const size_t count = text.size() - start;
+        const CaretIndex index(advances.data() + start, text.data(), start, count);
+        for (size_t offset = start; offset <= start + count; offset++) {
+            EXPECT_EQ(getRunAdvance(advances.data() + start, text.data(), start, count, offset),
+                      index.getRunAdvance(offset))
+                    << start << " " << offset;
+        }
+    }
+
+    const CaretIndex index(advances.data(), text.data(), 0, text.size());
+    for (float advance = -10.0f; advance < 200.0f; advance += 2.5f) {
+        EXPECT_EQ(getOffsetForAdvance(advances.data(), text.data(), 0, text.size(), advance),
+                  index.getOffsetForAdvance(advance))
+                << advance;
+    }
+}
+
 }  // namespace minikin
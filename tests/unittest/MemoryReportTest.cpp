@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/MemoryReport.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/Layout.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+TEST(MemoryReportTest, collect) {
+    const MemoryReport report = MemoryReport::collect();
+    EXPECT_EQ(report.layoutCache + report.boundsCache + report.localeListCache +
+                      report.paintIdCache + report.hyphenationCache + report.wordBreakCache +
+                      report.fontCollections + report.fontFamilies + report.hyphenators,
+              report.getTotal());
+    // The hyphenator map always has the hyphenator for the soft hyphens, which has no patterns.
+    EXPECT_LT(0u, report.hyphenators);
+
+    const std::string out = report.toString();
+    EXPECT_NE(std::string::npos, out.find("total=" + std::to_string(report.getTotal()) + " "));
+    EXPECT_NE(std::string::npos, out.find("harfBuzzFaces="));
+}
+
+TEST(MemoryReportTest, purgeCaches) {
+    Layout::purgeCaches();
+    const MemoryReport purged = MemoryReport::collect();
+    EXPECT_EQ(0u, purged.layoutCache);
+
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+    const std::vector<uint16_t> text = utf8ToUtf16("android minikin");
+    Layout::measureText(text, Range(0, text.size()), Bidi::LTR, paint, StartHyphenEdit::NO_EDIT,
+                        EndHyphenEdit::NO_EDIT, nullptr /* advances */);
+    // The pieces of the text show up in the layout cache.
+    const MemoryReport populated = MemoryReport::collect();
+    EXPECT_LT(purged.layoutCache, populated.layoutCache);
+    EXPECT_LT(purged.getTotal(), populated.getTotal());
+
+    Layout::purgeCaches();
+    const MemoryReport repurged = MemoryReport::collect();
+    EXPECT_EQ(0u, repurged.layoutCache);
+    EXPECT_GT(populated.getTotal(), repurged.getTotal());
+}
+
+}  // namespace minikin
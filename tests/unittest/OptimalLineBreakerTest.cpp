@@ -15,6 +15,8 @@
  */
 
 #include <memory>
+#include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -34,6 +36,7 @@ namespace minikin {
 namespace {
 
 using line_breaker_test_helper::ConstantRun;
+using line_breaker_test_helper::expectKeptWordBreaksMatch;
 using line_breaker_test_helper::LineBreakExpectation;
 using line_breaker_test_helper::RectangleLineWidth;
 using line_breaker_test_helper::sameLineBreak;
@@ -2108,5 +2111,430 @@ TEST_F(OptimalLineBreakerTest, roundingError) {
     EXPECT_EQ(1u, r.breakPoints.size());
 }
 
+TEST_F(OptimalLineBreakerTest, lazyHyphenation) {
+    const std::vector<uint16_t> textBuffer = utf8ToUtf16("This is an example text.");
+    auto buildMeasuredText = [&](bool lazyHyphenation) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ascii.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        auto fc = std::make_shared<FontCollection>(families);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        return builder.build(textBuffer, true /* compute hyphenation */,
+                             false /* compute full layout */, lazyHyphenation,
+                             nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> eager = buildMeasuredText(false /* lazy hyphenation */);
+    std::unique_ptr<MeasuredText> lazy = buildMeasuredText(true /* lazy hyphenation */);
+    EXPECT_FALSE(eager->isHyphenationLazy());
+    EXPECT_TRUE(lazy->isHyphenationLazy());
+    EXPECT_FALSE(eager->hyphenBreaks.empty());
+    EXPECT_TRUE(lazy->hyphenBreaks.empty());
+
+    for (float lineWidth : {1000.0f, 240.0f, 130.0f, 80.0f, 70.0f, 50.0f, 30.0f}) {
+        for (BreakStrategy strategy : {BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+            for (HyphenationFrequency frequency :
+                 {HyphenationFrequency::None, HyphenationFrequency::Normal}) {
+                LineBreakResult expected =
+                        doLineBreak(textBuffer, *eager, strategy, frequency, lineWidth);
+                LineBreakResult actual =
+                        doLineBreak(textBuffer, *lazy, strategy, frequency, lineWidth);
+                EXPECT_EQ(expected.breakPoints, actual.breakPoints) << lineWidth;
+                EXPECT_EQ(expected.widths, actual.widths) << lineWidth;
+                EXPECT_EQ(expected.flags, actual.flags) << lineWidth;
+            }
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, lazyHyphenationFromThreads) {
+    const std::vector<uint16_t> textBuffer = utf8ToUtf16("This is an example text.");
+    auto buildMeasuredText = [&](bool lazyHyphenation) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ascii.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        auto fc = std::make_shared<FontCollection>(families);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        return builder.build(textBuffer, true /* compute hyphenation */,
+                             false /* compute full layout */, lazyHyphenation,
+                             nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> eager = buildMeasuredText(false /* lazy hyphenation */);
+    std::unique_ptr<MeasuredText> lazy = buildMeasuredText(true /* lazy hyphenation */);
+    const LineBreakResult expected = doLineBreak(textBuffer, *eager, BreakStrategy::HighQuality,
+                                                 HyphenationFrequency::Normal, 50.0f);
+
+    // The threads compute the same hyphenation points of the shared text at once.
+    constexpr int kThreadCount = 4;
+    std::vector<LineBreakResult> results(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i]() {
+            results[i] = doLineBreak(textBuffer, *lazy, BreakStrategy::HighQuality,
+                                     HyphenationFrequency::Normal, 50.0f);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const LineBreakResult& actual : results) {
+        EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+        EXPECT_EQ(expected.widths, actual.widths);
+        EXPECT_EQ(expected.flags, actual.flags);
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, approximateHyphenPieces) {
+    const std::vector<uint16_t> textBuffer = utf8ToUtf16("This is an example text.");
+    auto buildMeasuredText = [&](bool approximate, bool lazyHyphenation) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ascii.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        auto fc = std::make_shared<FontCollection>(families);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        builder.setApproximateHyphenPieces(approximate);
+        return builder.build(textBuffer, true /* compute hyphenation */,
+                             false /* compute full layout */, lazyHyphenation,
+                             nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> exact = buildMeasuredText(false, false /* lazy hyphenation */);
+    std::unique_ptr<MeasuredText> approximate =
+            buildMeasuredText(true, false /* lazy hyphenation */);
+    std::unique_ptr<MeasuredText> lazy = buildMeasuredText(true, true /* lazy hyphenation */);
+    EXPECT_FALSE(exact->hasApproximateHyphenPieces());
+    EXPECT_TRUE(approximate->hasApproximateHyphenPieces());
+
+    // Every glyph of the font is 1em wide, so the approximation is exact.
+    ASSERT_FALSE(exact->hyphenBreaks.empty());
+    ASSERT_EQ(exact->hyphenBreaks.size(), approximate->hyphenBreaks.size());
+    for (uint32_t i = 0; i < exact->hyphenBreaks.size(); ++i) {
+        EXPECT_EQ(exact->hyphenBreaks[i].offset, approximate->hyphenBreaks[i].offset);
+        EXPECT_EQ(exact->hyphenBreaks[i].first, approximate->hyphenBreaks[i].first);
+        EXPECT_EQ(exact->hyphenBreaks[i].second, approximate->hyphenBreaks[i].second);
+    }
+
+    for (float lineWidth : {1000.0f, 240.0f, 130.0f, 80.0f, 70.0f, 50.0f, 30.0f}) {
+        LineBreakResult expected = doLineBreak(textBuffer, *exact, BreakStrategy::HighQuality,
+                                               HyphenationFrequency::Normal, lineWidth);
+        for (const MeasuredText* measured : {approximate.get(), lazy.get()}) {
+            LineBreakResult actual = doLineBreak(textBuffer, *measured, BreakStrategy::HighQuality,
+                                                 HyphenationFrequency::Normal, lineWidth);
+            EXPECT_EQ(expected.breakPoints, actual.breakPoints) << lineWidth;
+            EXPECT_EQ(expected.widths, actual.widths) << lineWidth;
+            EXPECT_EQ(expected.flags, actual.flags) << lineWidth;
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, approximateHyphenPiecesInCluster) {
+    // Ligature.ttf forms the fi ligature, which puts the advance of "fi" on the f and none on the
+    // i, so "self-ish" breaks inside the cluster and its pieces must be laid out.
+    const std::vector<uint16_t> textBuffer = utf8ToUtf16("A selfish text.");
+    auto buildMeasuredText = [&](bool approximate) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ligature.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        auto fc = std::make_shared<FontCollection>(families);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        builder.setApproximateHyphenPieces(approximate);
+        return builder.build(textBuffer, true /* compute hyphenation */,
+                             false /* compute full layout */, nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> exact = buildMeasuredText(false);
+    std::unique_ptr<MeasuredText> approximate = buildMeasuredText(true);
+
+    ASSERT_EQ(exact->hyphenBreaks.size(), approximate->hyphenBreaks.size());
+    for (uint32_t i = 0; i < exact->hyphenBreaks.size(); ++i) {
+        EXPECT_EQ(exact->hyphenBreaks[i].offset, approximate->hyphenBreaks[i].offset);
+        EXPECT_EQ(exact->hyphenBreaks[i].first, approximate->hyphenBreaks[i].first);
+        EXPECT_EQ(exact->hyphenBreaks[i].second, approximate->hyphenBreaks[i].second);
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, longParagraphWithWideLines) {
+    // 10000 words of 40px each, separated by 10px spaces. A 4990px line holds at most 100 words
+    // and the paragraph needs at least 100 lines, so every line must hold exactly 100 words.
+    constexpr size_t WORD_COUNT = 10000;
+    constexpr size_t WORDS_PER_LINE = 100;
+    std::string text;
+    for (size_t i = 0; i < WORD_COUNT; i++) {
+        text += "aaaa ";
+    }
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(text);
+
+    const LineBreakResult actual = doLineBreak(textBuf, BreakStrategy::HighQuality,
+                                               HyphenationFrequency::None, 4990);
+    ASSERT_EQ(WORD_COUNT / WORDS_PER_LINE, actual.breakPoints.size());
+    for (size_t i = 0; i < actual.breakPoints.size(); i++) {
+        EXPECT_EQ(static_cast<int>((i + 1) * WORDS_PER_LINE * 5), actual.breakPoints[i]);
+        EXPECT_EQ(4990, actual.widths[i]);
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, rebreakAfterEdit) {
+    auto buildMeasuredText = [&](const std::vector<uint16_t>& textBuffer) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ascii.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        auto fc = std::make_shared<FontCollection>(families);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        return builder.build(textBuffer, true /* compute hyphenation */,
+                             false /* compute full layout */, nullptr /* no hint */);
+    };
+    std::string head;
+    for (int i = 0; i < 20; i++) {
+        head += "This is an example text. ";
+    }
+    // Each edit is the text and the first offset that differs from the previous text.
+    const std::vector<std::pair<std::string, uint32_t>> edits = {
+            {head + "Typing", 0},
+            {head + "Typing more", head.size() + 6},
+            {head + "Typing more words", head.size() + 11},
+            {head + "Typing", head.size() + 6},
+            {"That" + head.substr(4) + "Typing", 0},
+            {"That" + head.substr(4, 100) + "examples" + head.substr(111) + "Typing", 104},
+    };
+
+    for (BreakStrategy strategy : {BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+        for (HyphenationFrequency frequency :
+             {HyphenationFrequency::None, HyphenationFrequency::Normal}) {
+            LineBreakerState state;
+            for (const auto& edit : edits) {
+                const std::vector<uint16_t> textBuffer = utf8ToUtf16(edit.first);
+                std::unique_ptr<MeasuredText> measured = buildMeasuredText(textBuffer);
+                RectangleLineWidth lineWidth(130);
+                LineBreakResult expected = breakLineOptimal(textBuffer, *measured, lineWidth,
+                                                            strategy, frequency, false);
+                LineBreakResult actual =
+                        breakLineOptimal(textBuffer, *measured, lineWidth, strategy, frequency,
+                                         false, edit.second, &state);
+                EXPECT_EQ(expected.breakPoints, actual.breakPoints) << edit.first;
+                EXPECT_EQ(expected.widths, actual.widths) << edit.first;
+                EXPECT_EQ(expected.flags, actual.flags) << edit.first;
+            }
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, breakParagraphsInParallel) {
+    std::vector<std::vector<uint16_t>> texts;
+    std::string text;
+    for (int i = 0; i < 32; i++) {
+        text += i % 2 ? "This is an example text. " : "Hyphenation ";
+        texts.push_back(utf8ToUtf16(text));
+    }
+    std::vector<std::unique_ptr<MeasuredText>> measuredTexts;
+    for (const std::vector<uint16_t>& textBuffer : texts) {
+        MeasuredTextBuilder builder;
+        auto family1 = buildFontFamily("Ascii.ttf");
+        std::vector<std::shared_ptr<FontFamily>> families = {family1};
+        MinikinPaint paint(std::make_shared<FontCollection>(families));
+        paint.size = 10.0f;  // Make 1em=1px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuffer.size(), std::move(paint), false);
+        measuredTexts.push_back(builder.build(textBuffer, true /* compute hyphenation */,
+                                              false /* compute full layout */,
+                                              nullptr /* no hint */));
+    }
+    RectangleLineWidth lineWidth(130);
+    TabStops tabStops(nullptr, 0, 10);
+    std::vector<LineBreakJob> jobs;
+    for (size_t i = 0; i < texts.size(); i++) {
+        jobs.push_back({texts[i], measuredTexts[i].get(), &lineWidth, &tabStops});
+    }
+
+    for (BreakStrategy strategy : {BreakStrategy::Greedy, BreakStrategy::HighQuality}) {
+        for (uint32_t maxThreads : {0u, 1u, 4u}) {
+            const std::vector<LineBreakResult> actual =
+                    breakIntoLines(jobs, strategy, HyphenationFrequency::Normal,
+                                   false /* justified */, maxThreads);
+            ASSERT_EQ(jobs.size(), actual.size());
+            for (size_t i = 0; i < jobs.size(); i++) {
+                const LineBreakResult expected =
+                        breakIntoLines(texts[i], strategy, HyphenationFrequency::Normal,
+                                       false /* justified */, *measuredTexts[i], lineWidth,
+                                       tabStops);
+                EXPECT_EQ(expected.breakPoints, actual[i].breakPoints) << i;
+                EXPECT_EQ(expected.widths, actual[i].widths) << i;
+                EXPECT_EQ(expected.flags, actual[i].flags) << i;
+            }
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, testKeptWordBreaks) {
+    expectKeptWordBreaksMatch([this](const std::vector<uint16_t>& textBuf,
+                                     const MeasuredText& measuredText, bool doHyphenation,
+                                     float lineWidth) {
+        return doLineBreak(textBuf, measuredText, BreakStrategy::HighQuality,
+                           doHyphenation ? HyphenationFrequency::Normal
+                                         : HyphenationFrequency::None,
+                           lineWidth);
+    });
+}
+
+// A ConstantRun with a text size, which the hyphen and line penalties scale with.
+class SizedConstantRun : public ConstantRun {
+public:
+    SizedConstantRun(const Range& range, float width, float size)
+            : ConstantRun(range, "en-US", width, ASCENT, DESCENT), mSizedPaint(nullptr) {
+        mSizedPaint.size = size;
+        mSizedPaint.scaleX = 1.0f;
+    }
+
+    const MinikinPaint* getPaint() const override { return &mSizedPaint; }
+
+private:
+    MinikinPaint mSizedPaint;
+};
+
+TEST_F(OptimalLineBreakerTest, testBreakForWidths) {
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "This is an example text with an extraordinarily long word, "
+            "Pneumonoultramicroscopicsilicovolcanoconiosis, a URL https://example.com/a/b and "
+            "hyphenation.");
+    MeasuredTextBuilder builder;
+    builder.addCustomRun<SizedConstantRun>(Range(0, 30), 10.0f, 10.0f);
+    builder.addCustomRun<SizedConstantRun>(Range(30, textBuf.size()), 7.5f, 20.0f);
+    std::unique_ptr<MeasuredText> measuredText = builder.build(
+            textBuf, true /* compute hyphenation */, false /* compute full layout */,
+            nullptr /* no hint */);
+
+    const std::vector<float> lineWidths = {0.0f, 35.0f, 80.0f, 120.0f, 250.0f, 5000.0f};
+    const TabStops tabStops(nullptr, 0, 10);
+    for (const BreakStrategy strategy :
+         {BreakStrategy::Greedy, BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+        for (const HyphenationFrequency frequency :
+             {HyphenationFrequency::None, HyphenationFrequency::Normal,
+              HyphenationFrequency::Full}) {
+            for (const bool justified : {false, true}) {
+                const std::vector<LineBreakResult> actual =
+                        breakIntoLinesForWidths(textBuf, strategy, frequency, justified,
+                                                *measuredText, lineWidths, tabStops);
+                ASSERT_EQ(lineWidths.size(), actual.size());
+                for (size_t i = 0; i < lineWidths.size(); ++i) {
+                    const LineBreakResult expected =
+                            breakIntoLines(textBuf, strategy, frequency, justified, *measuredText,
+                                           RectangleLineWidth(lineWidths[i]), tabStops);
+                    SCOPED_TRACE(lineWidths[i]);
+                    EXPECT_EQ(expected.breakPoints, actual[i].breakPoints);
+                    EXPECT_EQ(expected.widths, actual[i].widths);
+                    EXPECT_EQ(expected.flags, actual[i].flags);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, testBreakWithScratch) {
+    const std::vector<std::vector<uint16_t>> paragraphs = {
+            utf8ToUtf16("This is an example text with an extraordinarily long word, "
+                        "Pneumonoultramicroscopicsilicovolcanoconiosis, and a URL "
+                        "https://example.com/a/b in it."),
+            utf8ToUtf16("A short one."),
+            utf8ToUtf16("Tab\tseparated\ttext goes to the greedy line breaker."),
+            utf8ToUtf16(""),
+            utf8ToUtf16("Another paragraph, shorter than the first one.")};
+    const TabStops tabStops(nullptr, 0, 10);
+    const RectangleLineWidth lineWidth(100);
+
+    LineBreakScratch scratch;
+    LineBreakResult actual;
+    for (const BreakStrategy strategy :
+         {BreakStrategy::Greedy, BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+        for (size_t i = 0; i < paragraphs.size(); ++i) {
+            const std::vector<uint16_t>& textBuf = paragraphs[i];
+            MeasuredTextBuilder builder;
+            if (!textBuf.empty()) {
+                builder.addCustomRun<ConstantRun>(Range(0, textBuf.size()), "en-US", 10.0f, ASCENT,
+                                                  DESCENT);
+            }
+            std::unique_ptr<MeasuredText> measuredText =
+                    builder.build(textBuf, false /* compute hyphenation */,
+                                  false /* compute full layout */, nullptr /* no hint */);
+            const LineBreakResult expected =
+                    breakIntoLines(textBuf, strategy, HyphenationFrequency::None, false,
+                                   *measuredText, lineWidth, tabStops);
+            breakIntoLines(textBuf, strategy, HyphenationFrequency::None, false, *measuredText,
+                           lineWidth, tabStops, true /* compute extents */, &scratch, &actual);
+            SCOPED_TRACE(i);
+            EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+            EXPECT_EQ(expected.widths, actual.widths);
+            EXPECT_EQ(expected.ascents, actual.ascents);
+            EXPECT_EQ(expected.descents, actual.descents);
+            EXPECT_EQ(expected.flags, actual.flags);
+        }
+    }
+
+    // A result no longer than the previous ones is written to the same memory.
+    const std::vector<uint16_t>& textBuf = paragraphs[1];
+    MeasuredTextBuilder builder;
+    builder.addCustomRun<ConstantRun>(Range(0, textBuf.size()), "en-US", 10.0f, ASCENT, DESCENT);
+    std::unique_ptr<MeasuredText> measuredText =
+            builder.build(textBuf, false /* compute hyphenation */, false /* compute full layout */,
+                          nullptr /* no hint */);
+    const int* breakPoints = actual.breakPoints.data();
+    breakIntoLines(textBuf, BreakStrategy::HighQuality, HyphenationFrequency::None, false,
+                   *measuredText, lineWidth, tabStops, true /* compute extents */, &scratch,
+                   &actual);
+    EXPECT_EQ(breakPoints, actual.breakPoints.data());
+}
+
+TEST_F(OptimalLineBreakerTest, testSkipExtents) {
+    const std::vector<uint16_t> textBuf = utf8ToUtf16("This is an example text.");
+    MeasuredTextBuilder builder;
+    builder.addCustomRun<ConstantRun>(Range(0, textBuf.size()), "en-US", 10.0f, ASCENT, DESCENT);
+    std::unique_ptr<MeasuredText> measuredText =
+            builder.build(textBuf, false /* compute hyphenation */,
+                          false /* compute full layout */, nullptr /* no hint */);
+    const TabStops tabStops(nullptr, 0, 10);
+    const RectangleLineWidth lineWidth(100);
+
+    LineBreakScratch scratch;
+    for (const BreakStrategy strategy : {BreakStrategy::Greedy, BreakStrategy::HighQuality}) {
+        const LineBreakResult expected =
+                breakIntoLines(textBuf, strategy, HyphenationFrequency::None, false,
+                               *measuredText, lineWidth, tabStops);
+        EXPECT_TRUE(expected.hasExtents());
+
+        LineBreakResult actual;
+        breakIntoLines(textBuf, strategy, HyphenationFrequency::None, false, *measuredText,
+                       lineWidth, tabStops, false /* compute extents */, &scratch, &actual);
+        EXPECT_FALSE(actual.hasExtents());
+        EXPECT_EQ(expected.breakPoints, actual.breakPoints);
+        EXPECT_EQ(expected.widths, actual.widths);
+        EXPECT_EQ(expected.flags, actual.flags);
+
+        std::vector<LineBreakLine> lines;
+        expected.getLines(&lines);
+        ASSERT_EQ(expected.breakPoints.size(), lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            EXPECT_EQ(expected.breakPoints[i], lines[i].breakPoint);
+            EXPECT_EQ(expected.widths[i], lines[i].width);
+            EXPECT_EQ(ASCENT, lines[i].ascent);
+            EXPECT_EQ(DESCENT, lines[i].descent);
+            EXPECT_EQ(expected.flags[i], lines[i].flags);
+        }
+        actual.getLines(&lines);
+        ASSERT_EQ(expected.breakPoints.size(), lines.size());
+        EXPECT_EQ(0.0f, lines[0].ascent);
+        EXPECT_EQ(0.0f, lines[0].descent);
+    }
+}
+
 }  // namespace
 }  // namespace minikin
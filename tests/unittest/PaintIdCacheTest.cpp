@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/PaintIdCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/LocaleList.h"
+
+#include "FontTestUtils.h"
+
+namespace minikin {
+
+class TestablePaintIdCache : public PaintIdCache {
+public:
+    using PaintIdCache::kMaxEntriesPerShard;
+    using PaintIdCache::kShardCount;
+};
+
+TEST(PaintIdCacheTest, getId) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint(collection);
+    paint.size = 10.0f;
+    paint.fontFeatureSettings = "'liga' off";
+    const uint32_t id = PaintIdCache::getId(paint);
+
+    MinikinPaint samePaint(collection);
+    samePaint.size = 10.0f;
+    samePaint.fontFeatureSettings = "'liga' off";
+    EXPECT_EQ(id, PaintIdCache::getId(samePaint));
+    EXPECT_EQ(id, PaintIdCache::getId(paint));
+
+    std::vector<MinikinPaint> otherPaints(6, paint);
+    otherPaints[0].size = 11.0f;
+    otherPaints[1].letterSpacing = 0.1f;
+    otherPaints[2].fontFlags = Embolden_Flag;
+    otherPaints[3].localeListId = registerLocaleList("en-US");
+    otherPaints[4].fontFeatureSettings = "'liga' on";
+    otherPaints[5].fontStyle = FontStyle(FontStyle::Weight::BOLD);
+    for (const MinikinPaint& otherPaint : otherPaints) {
+        EXPECT_NE(id, PaintIdCache::getId(otherPaint));
+    }
+
+    // Same fields with another collection.
+    MinikinPaint otherCollectionPaint(paint);
+    otherCollectionPaint.font = buildFontCollection("Ascii.ttf");
+    EXPECT_NE(id, PaintIdCache::getId(otherCollectionPaint));
+}
+
+TEST(PaintIdCacheTest, getIdNaN) {
+    // A NaN never compares equal, but it must not register a new paint for every lookup.
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.skewX = std::nanf("");
+    const uint32_t id = PaintIdCache::getId(paint);
+    const size_t size = PaintIdCache::getCacheSize();
+    EXPECT_EQ(id, PaintIdCache::getId(paint));
+    EXPECT_EQ(size, PaintIdCache::getCacheSize());
+}
+
+TEST(PaintIdCacheTest, bufferTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint(collection);
+    paint.size = 12.0f;
+    paint.scaleX = 1.5f;
+    paint.localeListId = registerLocaleList("ja-JP");
+    paint.familyVariant = FamilyVariant::ELEGANT;
+    paint.fontFeatureSettings = "'palt' on";
+    const uint32_t id = PaintIdCache::getId(paint);
+    PaintIdCache::Key key;
+    ASSERT_TRUE(PaintIdCache::getKey(id, &key));
+
+    BufferWriter fakeWriter(nullptr);
+    PaintIdCache::writeTo(&fakeWriter, key);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    PaintIdCache::writeTo(&writer, key);
+
+    BufferReader reader(buffer.data());
+    EXPECT_EQ(id, PaintIdCache::readFrom(&reader, collection->getId()));
+    EXPECT_EQ(buffer.size(), reader.pos());
+
+    // The collection is not written, so the paint can be read for another one.
+    auto otherCollection = buildFontCollection("Ascii.ttf");
+    BufferReader otherReader(buffer.data());
+    const uint32_t otherId = PaintIdCache::readFrom(&otherReader, otherCollection->getId());
+    EXPECT_NE(id, otherId);
+    MinikinPaint otherPaint(paint);
+    otherPaint.font = otherCollection;
+    EXPECT_EQ(otherId, PaintIdCache::getId(otherPaint));
+}
+
+TEST(PaintIdCacheTest, evictionTest) {
+    const size_t maxEntries =
+            TestablePaintIdCache::kShardCount * TestablePaintIdCache::kMaxEntriesPerShard;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+    paint.fontFeatureSettings = "'liga' off";
+    const uint32_t id = PaintIdCache::getId(paint);
+    PaintIdCache::Key key;
+    EXPECT_TRUE(PaintIdCache::getKey(id, &key));
+    EXPECT_EQ("'liga' off", key.fontFeatureSettings);
+
+    // Animating the size registers a paint per frame, which must not grow the cache without
+    // bound.
+    MinikinPaint animated(paint);
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < 2 * maxEntries; ++i) {
+        animated.size = 20.0f + i * 0.01f;
+        ids.push_back(PaintIdCache::getId(animated));
+    }
+    EXPECT_GE(maxEntries, PaintIdCache::getCacheSize());
+    EXPECT_FALSE(PaintIdCache::getKey(id, &key));
+    // The key which was copied out stays valid.
+    EXPECT_EQ("'liga' off", key.fontFeatureSettings);
+
+    // An evicted paint gets a new ID, and the IDs are never reused.
+    const uint32_t newId = PaintIdCache::getId(paint);
+    EXPECT_NE(id, newId);
+    EXPECT_EQ(ids.end(), std::find(ids.begin(), ids.end(), newId));
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids.end(), std::adjacent_find(ids.begin(), ids.end()));
+}
+
+TEST(PaintIdCacheTest, pinnedTest) {
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint pinnedPaint(collection);
+    pinnedPaint.size = 14.0f;
+    PaintIdCache::Key key;
+    ASSERT_TRUE(PaintIdCache::getKey(PaintIdCache::getId(pinnedPaint), &key));
+    BufferWriter fakeWriter(nullptr);
+    PaintIdCache::writeTo(&fakeWriter, key);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    PaintIdCache::writeTo(&writer, key);
+
+    // The paint was registered unpinned, so it gets a new pinned entry once evicted.
+    MinikinPaint animated(pinnedPaint);
+    const size_t maxEntries =
+            TestablePaintIdCache::kShardCount * TestablePaintIdCache::kMaxEntriesPerShard;
+    auto animate = [&animated, maxEntries](float baseSize) {
+        for (size_t i = 0; i < 2 * maxEntries; ++i) {
+            animated.size = baseSize + i * 0.01f;
+            PaintIdCache::getId(animated);
+        }
+    };
+    animate(40.0f);
+    BufferReader reader(buffer.data());
+    const uint32_t pinnedId = PaintIdCache::readFrom(&reader, collection->getId(), true /* pin */);
+
+    // A pinned paint is not evicted by the other paints.
+    animate(80.0f);
+    EXPECT_TRUE(PaintIdCache::getKey(pinnedId, &key));
+    EXPECT_EQ(pinnedId, PaintIdCache::getId(pinnedPaint));
+}
+
+}  // namespace minikin
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PieceExtentTable.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/MeasuredText.h"
+
+#include "UnicodeUtils.h"
+
+namespace minikin {
+namespace {
+
+// A run split into pieces before and after each space, like LayoutSplitter does. The extent of a
+// piece depends on its range, so that a piece cut by the end of a range has a different extent.
+class SpaceSplitRun : public Run {
+public:
+    SpaceSplitRun(const Range& range, bool isRtl) : Run(range), mIsRtl(isRtl) {}
+
+    bool isRtl() const override { return mIsRtl; }
+    bool canBreak() const override { return true; }
+    uint32_t getLocaleListId() const override { return 0; }
+
+    void getMetrics(const U16StringPiece&, std::vector<float>*, LayoutPieces*,
+                    LayoutPieces*) const override {}
+
+    std::pair<float, MinikinRect> getBounds(const U16StringPiece&, const Range&,
+                                            const LayoutPieces&) const override {
+        return std::make_pair(0.0f, MinikinRect());
+    }
+
+    MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
+                            const LayoutPieces&) const override {
+        MinikinExtent extent;
+        for (const Range& piece : split(text, range)) {
+            extent.extendBy(pieceExtent(piece));
+        }
+        return extent;
+    }
+
+    void getPieceExtents(const U16StringPiece& text, const LayoutPieces&,
+                         std::vector<std::pair<Range, MinikinExtent>>* out) const override {
+        std::vector<Range> pieces = split(text, mRange);
+        if (mIsRtl) {
+            std::reverse(pieces.begin(), pieces.end());
+        }
+        for (const Range& piece : pieces) {
+            out->emplace_back(piece, pieceExtent(piece));
+        }
+    }
+
+    void appendLayout(const U16StringPiece&, const Range&, const Range&, const LayoutPieces&,
+                      const MinikinPaint&, uint32_t, StartHyphenEdit, EndHyphenEdit,
+                      Layout*) const override {}
+
+private:
+    static std::vector<Range> split(const U16StringPiece& text, const Range& range) {
+        std::vector<Range> pieces;
+        uint32_t start = range.getStart();
+        for (uint32_t i = range.getStart() + 1; i < range.getEnd(); ++i) {
+            if (text[i] == ' ' || text[i - 1] == ' ') {
+                pieces.emplace_back(start, i);
+                start = i;
+            }
+        }
+        if (start < range.getEnd()) {
+            pieces.emplace_back(start, range.getEnd());
+        }
+        return pieces;
+    }
+
+    static MinikinExtent pieceExtent(const Range& piece) {
+        return MinikinExtent(-10.0f * piece.getLength(), piece.getStart() % 7);
+    }
+
+    const bool mIsRtl;
+};
+
+// A run without pieces.
+class FixedExtentRun : public SpaceSplitRun {
+public:
+    FixedExtentRun(const Range& range) : SpaceSplitRun(range, false) {}
+
+    MinikinExtent getExtent(const U16StringPiece&, const Range&,
+                            const LayoutPieces&) const override {
+        return MinikinExtent(-1000.0f, 1000.0f);
+    }
+
+    void getPieceExtents(const U16StringPiece&, const LayoutPieces&,
+                         std::vector<std::pair<Range, MinikinExtent>>*) const override {}
+};
+
+TEST(PieceExtentTableTest, sameAsRunExtent) {
+    const std::vector<uint16_t> text =
+            utf8ToUtf16("This is an  example text with a verylongword in it. And more.");
+    std::vector<std::unique_ptr<minikin::Run>> runs;
+    runs.push_back(std::make_unique<SpaceSplitRun>(Range(0, 13), false));
+    runs.push_back(std::make_unique<SpaceSplitRun>(Range(13, 36), true));
+    runs.push_back(std::make_unique<FixedExtentRun>(Range(36, 40)));
+    runs.push_back(std::make_unique<SpaceSplitRun>(Range(40, text.size()), false));
+    const LayoutPieces pieces;
+    const PieceExtentTable table(text, runs, pieces);
+
+    for (uint32_t i = 0; i < runs.size(); ++i) {
+        const Range& runRange = runs[i]->getRange();
+        for (uint32_t start = runRange.getStart(); start <= runRange.getEnd(); ++start) {
+            for (uint32_t end = start; end <= runRange.getEnd(); ++end) {
+                SCOPED_TRACE(testing::Message() << "range [" << start << ", " << end << ")");
+                EXPECT_EQ(runs[i]->getExtent(text, Range(start, end), pieces),
+                          table.getExtent(text, i, *runs[i], Range(start, end), pieces));
+            }
+        }
+    }
+}
+
+}  // namespace
+}  // namespace minikin
@@ -79,4 +79,268 @@ TEST(SparseBitSetTest, emptyBitSetBufferTest) {
     ASSERT_EQ(buffer, newBuffer);
 }
 
+TEST(SparseBitSetTest, validateTest) {
+    std::vector<uint32_t> range({10, 20, 1000, 1100});
+    std::vector<uint8_t> buffer = writeToBuffer(SparseBitSet(range.data(), range.size() / 2));
+    BufferValidator validator(buffer.data(), buffer.size());
+    SparseBitSet::validate(&validator);
+    EXPECT_TRUE(validator.ok());
+    EXPECT_EQ(buffer.size(), validator.pos());
+
+    for (size_t truncated = 0; truncated < buffer.size(); truncated++) {
+        BufferValidator truncatedValidator(buffer.data(), truncated);
+        SparseBitSet::validate(&truncatedValidator);
+        EXPECT_FALSE(truncatedValidator.ok()) << truncated;
+    }
+
+    // maxVal (4), the size of the page indices (4), then the first page index.
+    std::vector<uint8_t> badIndex = buffer;
+    uint16_t index = 0xFFFF;
+    memcpy(badIndex.data() + 8, &index, sizeof(index));
+    BufferValidator badIndexValidator(badIndex.data(), badIndex.size());
+    SparseBitSet::validate(&badIndexValidator);
+    EXPECT_FALSE(badIndexValidator.ok());
+
+    std::vector<uint8_t> emptyBuffer = writeToBuffer(SparseBitSet());
+    BufferValidator emptyValidator(emptyBuffer.data(), emptyBuffer.size());
+    SparseBitSet::validate(&emptyValidator);
+    EXPECT_TRUE(emptyValidator.ok());
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> getRanges(const SparseBitSet& set) {
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    set.forEachSetRange([&](uint32_t start, uint32_t end) { ranges.emplace_back(start, end); });
+    return ranges;
+}
+
+// Writes the pool and then the sets with it, as FontCollection::writeVector() does.
+std::vector<uint8_t> writeWithPool(const std::vector<const SparseBitSet*>& sets) {
+    SparseBitSet::PagePool pool;
+    for (const SparseBitSet* set : sets) {
+        pool.add(*set);
+    }
+    auto writeTo = [&](BufferWriter* writer) {
+        pool.writeTo(writer);
+        for (const SparseBitSet* set : sets) {
+            set->writeTo(writer, pool);
+        }
+    };
+    BufferWriter fakeWriter(nullptr);
+    writeTo(&fakeWriter);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    writeTo(&writer);
+    return buffer;
+}
+
+TEST(SparseBitSetTest, pagePoolTest) {
+    // The sets share the full pages of [0x4E00, 0x9FFF) and the page of [10, 20).
+    std::vector<uint32_t> range1({10, 20, 0x4E00, 0x9F00});
+    std::vector<uint32_t> range2({10, 20, 0x5000, 0x9FFF});
+    SparseBitSet set1(range1.data(), range1.size() / 2);
+    SparseBitSet set2(range2.data(), range2.size() / 2);
+    SparseBitSet empty;
+
+    std::vector<uint8_t> buffer = writeWithPool({&set1, &set2, &empty});
+    EXPECT_LT(buffer.size(), writeToBuffer(set1).size() + writeToBuffer(set2).size());
+
+    BufferValidator validator(buffer.data(), buffer.size());
+    const uint32_t poolBitmapsCount = SparseBitSet::PagePool::validate(&validator);
+    for (int i = 0; i < 3; i++) {
+        SparseBitSet::validate(&validator, poolBitmapsCount);
+    }
+    EXPECT_TRUE(validator.ok());
+    EXPECT_EQ(buffer.size(), validator.pos());
+
+    BufferReader reader(buffer.data());
+    SparseBitSet::PagePool pool(&reader);
+    SparseBitSet copied1(&reader, pool);
+    SparseBitSet copied2(&reader, pool);
+    SparseBitSet copiedEmpty(&reader, pool);
+    EXPECT_EQ(getRanges(set1), getRanges(copied1));
+    EXPECT_EQ(getRanges(set2), getRanges(copied2));
+    EXPECT_TRUE(copied1.get(0x9EFF));
+    EXPECT_FALSE(copied1.get(0x9F00));
+    EXPECT_EQ(0u, copiedEmpty.length());
+    EXPECT_EQ(buffer, writeWithPool({&copied1, &copied2, &copiedEmpty}));
+}
+
+TEST(SparseBitSetTest, pagePoolOverflowTest) {
+    // Each set has 5000 distinct pages, so they don't both fit in the 16-bit page indices.
+    auto makeRanges = [](uint32_t offset) {
+        std::vector<uint32_t> ranges;
+        for (uint32_t page = 0; page < 5000; page++) {
+            const uint32_t base = page << 8;
+            ranges.insert(ranges.end(), {base + page % 128, base + page % 128 + 1,
+                                         base + 128 + (page / 128 + offset) % 128,
+                                         base + 129 + (page / 128 + offset) % 128});
+        }
+        return ranges;
+    };
+    std::vector<uint32_t> ranges1 = makeRanges(0);
+    std::vector<uint32_t> ranges2 = makeRanges(64);
+    SparseBitSet set1(ranges1.data(), ranges1.size() / 2);
+    SparseBitSet set2(ranges2.data(), ranges2.size() / 2);
+
+    std::vector<uint8_t> buffer = writeWithPool({&set1, &set2});
+    BufferValidator validator(buffer.data(), buffer.size());
+    const uint32_t poolBitmapsCount = SparseBitSet::PagePool::validate(&validator);
+    SparseBitSet::validate(&validator, poolBitmapsCount);
+    SparseBitSet::validate(&validator, poolBitmapsCount);
+    EXPECT_TRUE(validator.ok());
+
+    BufferReader reader(buffer.data());
+    SparseBitSet::PagePool pool(&reader);
+    SparseBitSet copied1(&reader, pool);
+    SparseBitSet copied2(&reader, pool);
+    EXPECT_EQ(getRanges(set1), getRanges(copied1));
+    EXPECT_EQ(getRanges(set2), getRanges(copied2));
+    // The second set doesn't fit in the pool, so it is written as is.
+    EXPECT_EQ(writeToBuffer(set2), writeToBuffer(copied2));
+}
+
+TEST(SparseBitSetTest, nextSetBitTest) {
+    std::vector<uint32_t> range({0x10, 0x11, 0x1F, 0x21, 0x3F, 0x40, 0x4FF, 0x501, 0x2000, 0x2100});
+    SparseBitSet bitset(range.data(), range.size() / 2);
+
+    uint32_t expected = SparseBitSet::kNotFound;
+    for (uint32_t ch = 0x2200; ch > 0; --ch) {
+        if (bitset.get(ch - 1)) {
+            expected = ch - 1;
+        }
+        ASSERT_EQ(expected, bitset.nextSetBit(ch - 1)) << std::hex << (ch - 1);
+    }
+}
+
+TEST(SparseBitSetTest, forEachSetRangeTest) {
+    std::mt19937 mt;  // Fix seeds to be able to reproduce the result.
+    std::uniform_int_distribution<uint16_t> distribution(1, 512);
+
+    std::vector<uint32_t> range{distribution(mt)};
+    for (size_t i = 1; i < 1024 * 2; ++i) {
+        range.push_back(range.back() + distribution(mt));
+    }
+    // Ranges ending at page and element boundaries.
+    range.push_back(range.back() + 0x1000);
+    range.push_back(((range.back() >> 8) + 2) << 8);
+    range.push_back(range.back() + 0x20);
+    range.push_back(range.back() + 0x40);
+    SparseBitSet bitset(range.data(), range.size() / 2);
+
+    std::vector<uint32_t> actual;
+    bitset.forEachSetRange([&actual](uint32_t start, uint32_t end) {
+        actual.push_back(start);
+        actual.push_back(end);
+    });
+    EXPECT_EQ(range, actual);
+
+    SparseBitSet empty;
+    empty.forEachSetRange([](uint32_t, uint32_t) { FAIL(); });
+}
+
+TEST(SparseBitSetTest, intersectsPageTest) {
+    std::vector<uint32_t> range({0x10, 0x11, 0x2FF, 0x301, 0x1000, 0x1100});
+    SparseBitSet bitset(range.data(), range.size() / 2);
+
+    for (uint32_t page = 0; page < 0x20; ++page) {
+        bool expected = false;
+        for (uint32_t ch = page << 8; ch < (page + 1) << 8; ++ch) {
+            expected |= bitset.get(ch);
+        }
+        EXPECT_EQ(expected, bitset.intersectsPage(page)) << std::hex << page;
+    }
+    EXPECT_FALSE(SparseBitSet().intersectsPage(0));
+}
+
+TEST(SparseBitSetTest, unionAndIntersectTest) {
+    std::vector<uint32_t> rangeA({0x10, 0x20, 0x100, 0x300, 0x1000, 0x1010});
+    std::vector<uint32_t> rangeB({0x18, 0x30, 0x200, 0x400, 0x2000, 0x2001});
+    SparseBitSet a(rangeA.data(), rangeA.size() / 2);
+    SparseBitSet b(rangeB.data(), rangeB.size() / 2);
+
+    SparseBitSet unionSet;
+    unionSet.unionWith(a);
+    unionSet.unionWith(b);
+    SparseBitSet intersection;
+    intersection.unionWith(a);
+    intersection.intersect(b);
+    for (uint32_t ch = 0; ch < 0x2100; ++ch) {
+        ASSERT_EQ(a.get(ch) || b.get(ch), unionSet.get(ch)) << std::hex << ch;
+        ASSERT_EQ(a.get(ch) && b.get(ch), intersection.get(ch)) << std::hex << ch;
+    }
+    EXPECT_EQ(0x10u + 0x200u + 0x10u, a.popcount());
+    EXPECT_EQ(0x20u + 0x300u + 0x10u + 0x1u, unionSet.popcount());
+    EXPECT_EQ(0x8u + 0x100u, intersection.popcount());
+    EXPECT_TRUE(a.intersects(b));
+
+    // The result of the operations can be serialized.
+    std::vector<uint8_t> buffer = writeToBuffer(unionSet);
+    BufferReader reader(buffer.data());
+    SparseBitSet restored(&reader);
+    for (uint32_t ch = 0; ch < 0x2100; ++ch) {
+        ASSERT_EQ(unionSet.get(ch), restored.get(ch)) << std::hex << ch;
+    }
+}
+
+TEST(SparseBitSetTest, disjointSetsTest) {
+    std::vector<uint32_t> rangeA({0x10, 0x20});
+    std::vector<uint32_t> rangeB({0x20, 0x30});
+    SparseBitSet a(rangeA.data(), rangeA.size() / 2);
+    SparseBitSet b(rangeB.data(), rangeB.size() / 2);
+    EXPECT_FALSE(a.intersects(b));
+    EXPECT_FALSE(a.intersects(SparseBitSet()));
+
+    a.intersect(b);
+    EXPECT_EQ(0u, a.popcount());
+    EXPECT_EQ(0u, a.length());
+    EXPECT_EQ(SparseBitSet::kNotFound, a.nextSetBit(0));
+    EXPECT_EQ(0u, SparseBitSet().popcount());
+}
+
+TEST(SparseBitSetTest, sharedPagesTest) {
+    // The full pages of [0x4E00, 0xA000) and the pages of the even values in [0xAC00, 0xD700) are
+    // each stored once, so the set has three pages with the zero page.
+    std::vector<uint32_t> range({0x4E00, 0xA000});
+    for (uint32_t i = 0xAC00; i < 0xD700; i += 2) {
+        range.insert(range.end(), {i, i + 1});
+    }
+    SparseBitSet set(range.data(), range.size() / 2);
+    const size_t indicesSize = sizeof(uint16_t) * (0xD700 >> 8);
+    EXPECT_EQ(sizeof(SparseBitSet) + indicesSize + 3 * 32, set.getMemoryUsage());
+
+    for (uint32_t i = 0; i < 0xD800; i++) {
+        const bool expected =
+                (0x4E00 <= i && i < 0xA000) || (0xAC00 <= i && i < 0xD700 && i % 2 == 0);
+        ASSERT_EQ(expected, set.get(i)) << i;
+    }
+    EXPECT_EQ(0xA000u - 0x4E00u + (0xD700u - 0xAC00u) / 2, set.popcount());
+
+    SparseBitSet::Builder builder;
+    for (size_t i = 0; i < range.size(); i += 2) {
+        builder.addRange(range[i], range[i + 1]);
+    }
+    EXPECT_EQ(writeToBuffer(set), writeToBuffer(builder.build()));
+}
+
+TEST(SparseBitSetTest, builderTest) {
+    std::mt19937 mt;  // Fix seeds to be able to reproduce the result.
+    std::uniform_int_distribution<uint16_t> distribution(1, 1024);
+
+    std::vector<uint32_t> range{distribution(mt)};
+    for (size_t i = 1; i < 1024 * 2; ++i) {
+        range.push_back(range.back() + distribution(mt));
+    }
+    SparseBitSet expected(range.data(), range.size() / 2);
+
+    SparseBitSet::Builder builder;
+    for (size_t i = 0; i < range.size(); i += 2) {
+        builder.addRange(range[i], range[i + 1]);
+        // Overlapping with the previous range is allowed.
+        builder.addRange(range[i], range[i + 1]);
+    }
+    EXPECT_EQ(writeToBuffer(expected), writeToBuffer(builder.build()));
+
+    EXPECT_EQ(writeToBuffer(SparseBitSet()), writeToBuffer(SparseBitSet::Builder().build()));
+}
+
 }  // namespace minikin
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/StreamingLineBreaker.h"
+
+#include <gtest/gtest.h>
+
+#include "LineBreakerTestHelper.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+namespace {
+
+using line_breaker_test_helper::ConstantRun;
+using line_breaker_test_helper::RectangleLineWidth;
+
+constexpr float CHAR_WIDTH = 10.0;
+
+void addConstantRun(const Range& paragraph, MeasuredTextBuilder* builder) {
+    builder->addCustomRun<ConstantRun>(Range(0, paragraph.getLength()), "en-US", CHAR_WIDTH,
+                                       0.0f /* ascent */, 0.0f /* descent */);
+}
+
+TEST(StreamingLineBreakerTest, sameAsBreakingEachParagraph) {
+    const std::vector<uint16_t> text = utf8ToUtf16(
+            "This is an example text.\n"
+            "\n"
+            "Short.\n"
+            "A somewhat longer paragraph that needs to be broken into a few lines.\n"
+            "No trailing line feed");
+    const std::vector<Range> paragraphs = {Range(0, 25), Range(25, 26), Range(26, 33),
+                                           Range(33, 103), Range(103, text.size())};
+    auto lineWidth = std::make_shared<RectangleLineWidth>(100);
+    TabStops tabStops(nullptr, 0, 10);
+
+    for (BreakStrategy strategy : {BreakStrategy::Greedy, BreakStrategy::HighQuality}) {
+        std::vector<LineBreakResult> expected;
+        for (const Range& paragraph : paragraphs) {
+            const U16StringPiece paraText = U16StringPiece(text).substr(paragraph);
+            MeasuredTextBuilder builder;
+            addConstantRun(paragraph, &builder);
+            auto measuredText = builder.build(paraText, false /* compute hyphenation */,
+                                              false /* compute full layout */,
+                                              nullptr /* no hint */);
+            expected.push_back(breakIntoLines(paraText, strategy, HyphenationFrequency::None,
+                                              false /* justified */, *measuredText, *lineWidth,
+                                              tabStops));
+        }
+
+        for (uint32_t windowSize : {1u, 30u, StreamingLineBreaker::DEFAULT_WINDOW_SIZE}) {
+            StreamingLineBreaker breaker(strategy, HyphenationFrequency::None,
+                                         false /* justified */, lineWidth, tabStops, windowSize);
+            std::vector<Range> actualParagraphs;
+            std::vector<LineBreakResult> actual;
+            breaker.breakText(text, addConstantRun,
+                              [&](const Range& paragraph, LineBreakResult&& result) {
+                                  actualParagraphs.push_back(paragraph);
+                                  actual.push_back(std::move(result));
+                              });
+            EXPECT_EQ(paragraphs, actualParagraphs) << windowSize;
+            ASSERT_EQ(expected.size(), actual.size()) << windowSize;
+            for (size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(expected[i].breakPoints, actual[i].breakPoints) << i;
+                EXPECT_EQ(expected[i].widths, actual[i].widths) << i;
+            }
+        }
+    }
+}
+
+TEST(StreamingLineBreakerTest, ownsLineWidthAndTabStops) {
+    const std::vector<uint16_t> text = utf8ToUtf16("a\tb\nc\td");
+    std::unique_ptr<StreamingLineBreaker> breaker;
+    std::weak_ptr<RectangleLineWidth> weakLineWidth;
+    {
+        // The line width and the tab stops go out of scope before the text is broken.
+        auto lineWidth = std::make_shared<RectangleLineWidth>(100);
+        weakLineWidth = lineWidth;
+        const std::vector<float> stops = {30.0f};
+        breaker = std::make_unique<StreamingLineBreaker>(
+                BreakStrategy::Greedy, HyphenationFrequency::None, false /* justified */,
+                lineWidth, TabStops(stops.data(), stops.size(), 10));
+    }
+    EXPECT_FALSE(weakLineWidth.expired());
+
+    std::vector<float> widths;
+    breaker->breakText(text, addConstantRun, [&](const Range&, LineBreakResult&& result) {
+        widths.insert(widths.end(), result.widths.begin(), result.widths.end());
+    });
+    // Each line is the tab stop at 30 plus the advance of the character after the tab.
+    ASSERT_EQ(2u, widths.size());
+    EXPECT_EQ(30.0f + CHAR_WIDTH, widths[0]);
+    EXPECT_EQ(30.0f + CHAR_WIDTH, widths[1]);
+
+    breaker.reset();
+    EXPECT_TRUE(weakLineWidth.expired());
+}
+
+}  // namespace
+}  // namespace minikin
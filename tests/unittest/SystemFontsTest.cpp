@@ -16,6 +16,8 @@
 
 #include "minikin/SystemFonts.h"
 
+#include <unordered_set>
+
 #include <gtest/gtest.h>
 
 #include "minikin/FontCollection.h"
@@ -49,6 +51,11 @@ public:
     }
 
     void registerDefault(const std::shared_ptr<FontCollection>& fc) { registerDefaultInternal(fc); }
+
+    void getFontMap(
+            std::function<void(const std::vector<std::shared_ptr<FontCollection>>&)> func) {
+        getFontMapInternal(func);
+    }
 };
 
 TEST(SystemFontsTest, registerAndLookup) {
@@ -114,5 +121,38 @@ TEST(SystemFontTest, getAvailableFont_dedupFonts) {
     });
 }
 
+TEST(SystemFontTest, getFontSet_afterAddFontMap) {
+    TestableSystemFonts systemFonts;
+    systemFonts.addFontMap(buildFontCollection("Ascii.ttf"));
+    systemFonts.getFontSet([](const std::vector<std::shared_ptr<Font>>& fonts) {
+        EXPECT_EQ(1u, fonts.size());
+    });
+
+    // The font set is rebuilt for the new font map.
+    systemFonts.addFontMap(buildFontCollection("Bold.ttf"));
+    systemFonts.getFontSet([](const std::vector<std::shared_ptr<Font>>& fonts) {
+        EXPECT_EQ(2u, fonts.size());
+    });
+}
+
+TEST(SystemFontTest, getFontMap_updateInCallback) {
+    TestableSystemFonts systemFonts;
+    auto fc1 = buildFontCollection("Ascii.ttf");
+    auto fc2 = buildFontCollection("Bold.ttf");
+    systemFonts.addFontMap(std::shared_ptr<FontCollection>(fc1));
+
+    // The callback sees the font map at the time of the call, and doesn't block the updates.
+    systemFonts.getFontMap([&](const std::vector<std::shared_ptr<FontCollection>>& collections) {
+        systemFonts.addFontMap(std::shared_ptr<FontCollection>(fc2));
+        systemFonts.registerDefault(fc2);
+        ASSERT_EQ(1u, collections.size());
+        EXPECT_EQ(fc1, collections[0]);
+        EXPECT_EQ(fc2, systemFonts.findFontCollection("unknown-name"));
+    });
+    systemFonts.getFontMap([&](const std::vector<std::shared_ptr<FontCollection>>& collections) {
+        EXPECT_EQ(2u, collections.size());
+    });
+}
+
 }  // namespace
 }  // namespace minikin
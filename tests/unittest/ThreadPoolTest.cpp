@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ParallelFor.h"
+
+namespace minikin {
+namespace {
+
+// Runs the tasks one by one on the calling thread when asked to.
+class QueuedExecutor : public Executor {
+public:
+    void execute(std::function<void()>&& task, Priority priority) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        priorities.push_back(priority);
+    }
+
+    uint32_t getConcurrency() const override { return 3; }
+
+    void runAll() {
+        std::vector<std::function<void()>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.swap(tasks);
+        }
+        for (std::function<void()>& task : pending) {
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::vector<std::function<void()>> tasks;
+    std::vector<Priority> priorities;
+};
+
+class ScopedExecutor {
+public:
+    explicit ScopedExecutor(Executor* executor) { setExecutor(executor); }
+    ~ScopedExecutor() { setExecutor(nullptr); }
+};
+
+TEST(ThreadPoolTest, runTasks) {
+    ThreadPool pool(2);
+    EXPECT_EQ(2u, pool.getConcurrency());
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint32_t count = 0;
+    std::set<std::thread::id> threadIds;
+    const auto task = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        count++;
+        threadIds.insert(std::this_thread::get_id());
+        condition.notify_all();
+    };
+    for (uint32_t i = 0; i < 100; i++) {
+        pool.execute(task, Executor::Priority::kForeground);
+    }
+    pool.execute(task, Executor::Priority::kBackground);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return count == 101; });
+    EXPECT_EQ(0u, threadIds.count(std::this_thread::get_id()));
+    // The two foreground workers and the background one.
+    EXPECT_GE(3u, threadIds.size());
+}
+
+TEST(ThreadPoolTest, nestedTasks) {
+    // A task waiting for the tasks it posted doesn't block the pool, since the calling thread of
+    // parallelFor doesn't wait for the workers which haven't started.
+    ThreadPool pool(1);
+    ScopedExecutor scopedExecutor(&pool);
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done = false;
+    std::atomic<uint32_t> sum(0);
+    pool.execute(
+            [&]() {
+                parallelFor(10, 0 /* max threads */, [&](size_t i) { sum += i; });
+                std::lock_guard<std::mutex> lock(mutex);
+                done = true;
+                condition.notify_all();
+            },
+            Executor::Priority::kForeground);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return done; });
+    EXPECT_EQ(45u, sum.load());
+}
+
+TEST(ThreadPoolTest, performanceCoreCount) {
+    const uint32_t count = ThreadPool::getPerformanceCoreCount();
+    EXPECT_LE(1u, count);
+    EXPECT_GE(std::max(1u, std::thread::hardware_concurrency()), count);
+}
+
+TEST(ParallelForTest, callsEachIndexOnce) {
+    std::vector<std::atomic<uint32_t>> calls(1000);
+    parallelFor(calls.size(), 0 /* max threads */, [&](size_t i) { calls[i]++; });
+    for (size_t i = 0; i < calls.size(); i++) {
+        EXPECT_EQ(1u, calls[i].load()) << i;
+    }
+}
+
+TEST(ParallelForTest, usesExecutor) {
+    QueuedExecutor executor;
+    ScopedExecutor scopedExecutor(&executor);
+    std::vector<uint32_t> calls(10);
+    // The tasks of the executor never start, so the calling thread makes all the calls.
+    parallelFor(calls.size(), 0 /* max threads */, [&](size_t i) { calls[i]++; });
+    EXPECT_EQ(std::vector<uint32_t>(10, 1), calls);
+    // One task for each thread of the executor.
+    ASSERT_EQ(3u, executor.priorities.size());
+    for (Executor::Priority priority : executor.priorities) {
+        EXPECT_EQ(Executor::Priority::kForeground, priority);
+    }
+    // The late tasks find no index left.
+    executor.runAll();
+    EXPECT_EQ(std::vector<uint32_t>(10, 1), calls);
+
+    // Only the calling thread if maxThreads is 1.
+    parallelFor(calls.size(), 1 /* max threads */, [&](size_t i) { calls[i]++; });
+    EXPECT_TRUE(executor.tasks.empty());
+    EXPECT_EQ(std::vector<uint32_t>(10, 2), calls);
+}
+
+}  // namespace
+}  // namespace minikin
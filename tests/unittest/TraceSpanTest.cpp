@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TraceSpan.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+namespace {
+
+std::vector<std::string> gEvents;
+
+void beginSpan(const char* name, uint32_t textLength, uint32_t runCount) {
+    gEvents.push_back(std::string("B ") + name + " " + std::to_string(textLength) + " " +
+                      std::to_string(runCount));
+}
+
+void endSpan() {
+    gEvents.push_back("E");
+}
+
+const TraceCallbacks kCallbacks = {beginSpan, endSpan};
+
+}  // namespace
+
+TEST(TraceSpanTest, callbacks) {
+    gEvents.clear();
+    setTraceCallbacks(&kCallbacks);
+    {
+        TraceSpan outer("outer", 10, 2);
+        TraceSpan inner("inner", 5, 0);
+    }
+    setTraceCallbacks(nullptr);
+    {
+        TraceSpan ignored("ignored", 1, 1);
+    }
+    EXPECT_EQ((std::vector<std::string>{"B outer 10 2", "B inner 5 0", "E", "E"}), gEvents);
+}
+
+TEST(TraceSpanTest, endsWithStartCallbacks) {
+    gEvents.clear();
+    {
+        TraceSpan untraced("untraced", 1, 0);
+        setTraceCallbacks(&kCallbacks);
+        TraceSpan traced("traced", 2, 0);
+    }
+    setTraceCallbacks(nullptr);
+    // The span started without callbacks does not end with the new ones.
+    EXPECT_EQ((std::vector<std::string>{"B traced 2 0", "E"}), gEvents);
+}
+
+TEST(TraceSpanTest, macro) {
+    gEvents.clear();
+    setTraceCallbacks(&kCallbacks);
+    {
+        MINIKIN_TRACE("scope", 3, 1);
+        MINIKIN_TRACE("nested", 3, 1);
+    }
+    setTraceCallbacks(nullptr);
+#ifdef ENABLE_TRACING
+    EXPECT_EQ((std::vector<std::string>{"B scope 3 1", "B nested 3 1", "E", "E"}), gEvents);
+#else
+    EXPECT_TRUE(gEvents.empty());
+#endif
+}
+
+}  // namespace minikin
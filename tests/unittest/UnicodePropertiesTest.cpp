@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UnicodeProperties.h"
+
+#include <gtest/gtest.h>
+#include <unicode/uchar.h>
+
+namespace minikin {
+
+using namespace unicode_tables;
+
+TEST(UnicodePropertiesTest, matchesIcu) {
+    for (uint32_t c = 0; c <= MAX_UNICODE_CODE_POINT; ++c) {
+        SCOPED_TRACE(c);
+        const uint16_t props = getUnicodeProperties(c);
+        ASSERT_EQ(u_getIntPropertyValue(c, UCHAR_GRAPHEME_CLUSTER_BREAK), props & GCB_MASK);
+        ASSERT_EQ(static_cast<bool>(u_hasBinaryProperty(c, UCHAR_EMOJI)),
+                  static_cast<bool>(props & EMOJI_BIT));
+        ASSERT_EQ(static_cast<bool>(u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER)),
+                  static_cast<bool>(props & EMOJI_MODIFIER_BIT));
+        ASSERT_EQ(static_cast<bool>(u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER_BASE)),
+                  static_cast<bool>(props & EMOJI_MODIFIER_BASE_BIT));
+        ASSERT_EQ(static_cast<bool>(u_hasBinaryProperty(c, UCHAR_EXTENDED_PICTOGRAPHIC)),
+                  static_cast<bool>(props & EXTENDED_PICTOGRAPHIC_BIT));
+        ASSERT_EQ(u_getIntPropertyValue(c, UCHAR_CANONICAL_COMBINING_CLASS) == 9,
+                  static_cast<bool>(props & VIRAMA_BIT));
+        ASSERT_EQ(u_getIntPropertyValue(c, UCHAR_GENERAL_CATEGORY) == U_OTHER_LETTER,
+                  static_cast<bool>(props & OTHER_LETTER_BIT));
+    }
+}
+
+TEST(UnicodePropertiesTest, fallbackMatchesTables) {
+    // The tests run with the ICU the tables are generated with.
+    EXPECT_TRUE(unicodeTablesMatchIcu());
+    for (uint32_t c = 0; c <= MAX_UNICODE_CODE_POINT; ++c) {
+        SCOPED_TRACE(c);
+        ASSERT_EQ(getUnicodeProperties(c), computeUnicodeProperties(c));
+    }
+}
+
+TEST(UnicodePropertiesTest, outOfRange) {
+    EXPECT_EQ(0, getUnicodeProperties(MAX_UNICODE_CODE_POINT + 1));
+    EXPECT_EQ(0, getUnicodeProperties(0xFFFFFFFF));
+}
+
+}  // namespace minikin
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Utf8Text.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+namespace {
+
+std::vector<uint16_t> toVector(const U16StringPiece& text) {
+    return std::vector<uint16_t>(text.data(), text.data() + text.size());
+}
+
+}  // namespace
+
+TEST(Utf8TextTest, convert) {
+    // a (1 byte), U+00E9 (2 bytes), U+3042 (3 bytes), U+1F600 (4 bytes, a surrogate pair).
+    const char text[] = "a\xC3\xA9\xE3\x81\x82\xF0\x9F\x98\x80";
+    const Utf8Text utf8Text(text, strlen(text));
+    EXPECT_EQ(10u, utf8Text.utf8Size());
+    EXPECT_EQ(std::vector<uint16_t>({'a', 0x00E9, 0x3042, 0xD83D, 0xDE00}),
+              toVector(utf8Text.utf16()));
+
+    EXPECT_EQ(0u, utf8Text.toUtf8(0));
+    EXPECT_EQ(1u, utf8Text.toUtf8(1));
+    EXPECT_EQ(3u, utf8Text.toUtf8(2));
+    EXPECT_EQ(6u, utf8Text.toUtf8(3));
+    EXPECT_EQ(6u, utf8Text.toUtf8(4));
+    EXPECT_EQ(10u, utf8Text.toUtf8(5));
+
+    EXPECT_EQ(0u, utf8Text.toUtf16(0));
+    EXPECT_EQ(1u, utf8Text.toUtf16(1));
+    EXPECT_EQ(2u, utf8Text.toUtf16(2));  // In the middle of U+00E9.
+    EXPECT_EQ(2u, utf8Text.toUtf16(3));
+    EXPECT_EQ(3u, utf8Text.toUtf16(6));
+    EXPECT_EQ(5u, utf8Text.toUtf16(8));  // In the middle of U+1F600.
+    EXPECT_EQ(5u, utf8Text.toUtf16(10));
+
+    EXPECT_EQ(Range(1, 3), utf8Text.toUtf16(Range(1, 6)));
+    EXPECT_EQ(Range(1, 6), utf8Text.toUtf8(Range(1, 3)));
+}
+
+TEST(Utf8TextTest, invalidSequence) {
+    // A lone continuation byte and a truncated 3-byte sequence.
+    const char text[] = "a\x80" "b\xE3\x81";
+    const Utf8Text utf8Text(text, strlen(text));
+    EXPECT_EQ(std::vector<uint16_t>({'a', 0xFFFD, 'b', 0xFFFD}), toVector(utf8Text.utf16()));
+    EXPECT_EQ(3u, utf8Text.toUtf8(3));
+    EXPECT_EQ(5u, utf8Text.toUtf8(4));
+}
+
+TEST(Utf8TextTest, toUtf8Advances) {
+    const char text[] = "a\xC3\xA9\xF0\x9F\x98\x80z";
+    const Utf8Text utf8Text(text, strlen(text));
+    // The advance of a surrogate pair is on its lead code unit.
+    const float utf16Advances[] = {1.0f, 2.0f, 3.0f, 0.0f, 4.0f};
+    {
+        std::vector<float> out(utf8Text.utf8Size(), -1.0f);
+        utf8Text.toUtf8Advances(utf16Advances, Range(0, 5), Range(0, 8), out.data());
+        EXPECT_EQ(std::vector<float>({1.0f, 2.0f, 0.0f, 3.0f, 0.0f, 0.0f, 0.0f, 4.0f}), out);
+    }
+    {
+        std::vector<float> out(5, -1.0f);
+        utf8Text.toUtf8Advances(utf16Advances + 2, Range(2, 4), Range(3, 8), out.data());
+        EXPECT_EQ(std::vector<float>({3.0f, 0.0f, 0.0f, 0.0f, 0.0f}), out);
+    }
+}
+
+}  // namespace minikin
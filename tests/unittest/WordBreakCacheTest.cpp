@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WordBreakCache.h"
+
+#include <gtest/gtest.h>
+
+#include "LineBreakerTestHelper.h"
+#include "UnicodeUtils.h"
+#include "WordBreaker.h"
+
+namespace minikin {
+
+using line_breaker_test_helper::ConstantRun;
+
+class TestableWordBreakCache : public WordBreakCache {
+public:
+    TestableWordBreakCache() : WordBreakCache() {}
+    using WordBreakCache::MAX_TEXT_LENGTH;
+};
+
+// Declared outside the tests, where Run would name testing::Test::Run.
+using Runs = std::vector<std::unique_ptr<Run>>;
+
+static Runs makeRuns(
+        const std::vector<uint16_t>& text,
+        const std::vector<std::pair<uint32_t, std::string>>& runStarts) {
+    Runs runs;
+    for (uint32_t i = 0; i < runStarts.size(); ++i) {
+        const uint32_t end = i + 1 < runStarts.size() ? runStarts[i + 1].first : text.size();
+        runs.emplace_back(std::make_unique<ConstantRun>(Range(runStarts[i].first, end),
+                                                        runStarts[i].second, 10.0f, -10.0f, 3.0f));
+    }
+    return runs;
+}
+
+static void expectSameWordBreaks(const WordBreaks& expected, const WordBreaks& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].first, actual[i].first);
+        ASSERT_EQ(expected[i].second.size(), actual[i].second.size());
+        for (size_t j = 0; j < expected[i].second.size(); ++j) {
+            const WordBreakPoint& e = expected[i].second[j];
+            const WordBreakPoint& a = actual[i].second[j];
+            EXPECT_EQ(e.offset, a.offset);
+            EXPECT_EQ(e.badness, a.badness);
+            EXPECT_EQ(e.wordRange, a.wordRange);
+        }
+    }
+}
+
+TEST(WordBreakCacheTest, sameResultAsWordBreaker) {
+    TestableWordBreakCache cache;
+    const std::vector<uint16_t> text =
+            utf8ToUtf16("This is an example. Mail example@example.com for more.");
+    const Runs runs = makeRuns(text, {{0, "en-US"}, {20, "pl"}});
+
+    WordBreaker breaker;
+    WordBreaks expected;
+    WordBreakCache::compute(text, runs, &breaker, &expected);
+    ASSERT_EQ(2u, expected.size());
+
+    std::shared_ptr<const WordBreaks> first = cache.get(text, runs, &breaker);
+    ASSERT_NE(nullptr, first);
+    expectSameWordBreaks(expected, *first);
+    EXPECT_EQ(0u, cache.getStats().hits());
+    EXPECT_EQ(1u, cache.getStats().misses());
+
+    // The same text in another buffer is a hit.
+    const std::vector<uint16_t> copy = text;
+    EXPECT_EQ(first, cache.get(copy, runs, &breaker));
+    EXPECT_EQ(1u, cache.getStats().hits());
+    EXPECT_EQ(1u, cache.getCacheSize());
+}
+
+TEST(WordBreakCacheTest, keyedByLocales) {
+    TestableWordBreakCache cache;
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    const Runs english = makeRuns(text, {{0, "en-US"}});
+    const Runs mixed = makeRuns(text, {{0, "en-US"}, {8, "pl"}});
+    const Runs strict = makeRuns(text, {{0, "en-US-u-lb-strict"}});
+    // Consecutive runs with the same locale are one group, so they share the entry.
+    const Runs split = makeRuns(text, {{0, "en-US"}, {8, "en-US"}});
+
+    WordBreaker breaker;
+    std::shared_ptr<const WordBreaks> englishBreaks = cache.get(text, english, &breaker);
+    EXPECT_NE(englishBreaks, cache.get(text, mixed, &breaker));
+    EXPECT_NE(englishBreaks, cache.get(text, strict, &breaker));
+    EXPECT_EQ(englishBreaks, cache.get(text, split, &breaker));
+    EXPECT_EQ(3u, cache.getCacheSize());
+}
+
+TEST(WordBreakCacheTest, longTextIsNotCached) {
+    TestableWordBreakCache cache;
+    const std::vector<uint16_t> text(TestableWordBreakCache::MAX_TEXT_LENGTH + 1, 'a');
+    const Runs runs = makeRuns(text, {{0, "en-US"}});
+
+    WordBreaker breaker;
+    EXPECT_EQ(nullptr, cache.get(text, runs, &breaker));
+    EXPECT_EQ(0u, cache.getCacheSize());
+    EXPECT_EQ(1u, cache.getStats().bypasses());
+}
+
+TEST(WordBreakCacheTest, clear) {
+    TestableWordBreakCache cache;
+    const std::vector<uint16_t> text = utf8ToUtf16("This is an example text.");
+    const Runs runs = makeRuns(text, {{0, "en-US"}});
+
+    WordBreaker breaker;
+    cache.get(text, runs, &breaker);
+    EXPECT_EQ(1u, cache.getCacheSize());
+    EXPECT_LT(0u, cache.getMemoryUsage());
+    cache.clear();
+    EXPECT_EQ(0u, cache.getCacheSize());
+}
+
+}  // namespace minikin
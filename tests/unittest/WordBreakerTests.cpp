@@ -17,6 +17,9 @@
 #include "WordBreaker.h"
 
 #include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 #include <unicode/uclean.h>
@@ -443,6 +446,32 @@ TEST(WordBreakerTest, urlBreakChars) {
     EXPECT_EQ(0, breaker.breakBadness());
 }
 
+TEST(WordBreakerTest, severalEmailsAndUrls) {
+    std::vector<uint16_t> buf = utf8ToUtf16("see a@b.c and x://y, not z");
+    WordBreaker breaker;
+    breaker.setText(buf.data(), buf.size());
+    EXPECT_EQ(4, breaker.followingWithLocale(Locale("en-US"), 0));  // after "see "
+    EXPECT_EQ(0, breaker.breakBadness());
+    EXPECT_EQ(7, breaker.next());  // after "a@b"
+    EXPECT_EQ(1, breaker.breakBadness());
+    EXPECT_EQ(10, breaker.next());  // after ".c "
+    EXPECT_EQ(0, breaker.breakBadness());
+    EXPECT_EQ(14, breaker.next());  // after "and "
+    EXPECT_EQ(0, breaker.breakBadness());
+    EXPECT_EQ(16, breaker.next());  // after "x:"
+    EXPECT_EQ(1, breaker.breakBadness());
+    EXPECT_EQ(18, breaker.next());  // after "//"
+    EXPECT_EQ(1, breaker.breakBadness());
+    EXPECT_EQ(19, breaker.next());  // after "y"
+    EXPECT_EQ(1, breaker.breakBadness());
+    EXPECT_EQ(21, breaker.next());  // after ", "
+    EXPECT_EQ(0, breaker.breakBadness());
+    EXPECT_EQ(25, breaker.next());  // after "not "
+    EXPECT_EQ(0, breaker.breakBadness());
+    EXPECT_EQ((ssize_t)buf.size(), breaker.next());  // end
+    EXPECT_EQ(0, breaker.breakBadness());
+}
+
 TEST(WordBreakerTest, urlNoHyphenBreak) {
     uint16_t buf[] = {'h', 't', 't', 'p', ':', '/', '/', 'a', '-', '/', 'b'};
     WordBreaker breaker;
@@ -552,12 +581,81 @@ TEST(WordBreakerTest, spaceAfterSpace) {
     }
 }
 
+class TestableWordBreaker : public WordBreaker {
+public:
+    using WordBreaker::setLatinFastPathEnabled;
+};
+
+TEST(WordBreakerTest, latinFastPath) {
+    // A mix of the characters the fast path handles and ones it must leave to ICU.
+    const std::vector<uint16_t> alphabet = {'a', 'Z', 0x00E9, '0', '7', ' ',    ' ',    '.',
+                                            ',', ':', ';',    '!', '?', '(',    ')',    '"',
+                                            '-', '/', '@',    '%', '$', 0x0301, 0x3042, 0x00A0};
+    const char* locales[] = {"en-US", "fr-FR", "fi-FI", "ja-JP-u-lb-loose", "ja-JP-u-lb-strict"};
+    std::mt19937 random(0);
+    for (int n = 0; n < 2000; n++) {
+        std::vector<uint16_t> text(1 + random() % 24);
+        for (uint16_t& c : text) {
+            c = alphabet[random() % alphabet.size()];
+        }
+        const Locale locale(locales[n % NELEM(locales)]);
+        const size_t from = random() % text.size();
+        SCOPED_TRACE(utf16ToUtf8(U16StringPiece(text)) + " from " + std::to_string(from));
+
+        TestableWordBreaker fast;
+        TestableWordBreaker icu;
+        icu.setLatinFastPathEnabled(false);
+        fast.setText(text.data(), text.size());
+        icu.setText(text.data(), text.size());
+        EXPECT_EQ(icu.followingWithLocale(locale, from), fast.followingWithLocale(locale, from));
+        while (icu.current() < static_cast<ssize_t>(text.size())) {
+            EXPECT_EQ(icu.next(), fast.next());
+            ASSERT_EQ(icu.current(), fast.current());
+            EXPECT_EQ(icu.wordStart(), fast.wordStart());
+            EXPECT_EQ(icu.wordEnd(), fast.wordEnd());
+            EXPECT_EQ(icu.breakBadness(), fast.breakBadness());
+        }
+    }
+}
+
+TEST(WordBreakerTest, restartInLongTextWithUrls) {
+    // A restart inside a long text looks the email address / URL scans up in a table, which must
+    // find the same breaks as the scans of a single pass.
+    std::string utf8;
+    while (utf8.size() < 2048) {
+        utf8 += "see http://example.com/a/b or mail x@example.org now ";
+    }
+    const std::vector<uint16_t> text = utf8ToUtf16(utf8);
+    const Locale locale("en-US");
+
+    WordBreaker single;
+    single.setText(text.data(), text.size());
+    std::vector<ssize_t> breaks;
+    for (ssize_t i = single.followingWithLocale(locale, 0); i != -1; i = single.next()) {
+        breaks.push_back(i);
+    }
+
+    for (size_t k = 0; k < breaks.size(); k += 7) {
+        if (text[breaks[k] - 1] != ' ' || breaks[k] == static_cast<ssize_t>(text.size())) {
+            continue;
+        }
+        SCOPED_TRACE("from " + std::to_string(breaks[k]));
+        WordBreaker restarted;
+        restarted.setText(text.data(), text.size());
+        restarted.followingWithLocale(locale, 0);
+        EXPECT_EQ(breaks[k + 1], restarted.followingWithLocale(locale, breaks[k]));
+        for (size_t j = k + 2; j < breaks.size(); j++) {
+            ASSERT_EQ(breaks[j], restarted.next());
+        }
+        EXPECT_EQ(-1, restarted.next());
+    }
+}
+
 class TestableICULineBreakerPoolImpl : public ICULineBreakerPoolImpl {
 public:
     TestableICULineBreakerPoolImpl() : ICULineBreakerPoolImpl() {}
 
     using ICULineBreakerPoolImpl::getPoolSize;
-    using ICULineBreakerPoolImpl::MAX_POOL_SIZE;
 };
 
 TEST(WordBreakerTest, LineBreakerPool_acquire_without_release) {
@@ -611,7 +709,7 @@ TEST(WordBreakerTest, LineBreakerPool_acquire_with_release) {
 }
 
 TEST(WordBreakerTest, LineBreakerPool_exceeds_pool_size) {
-    const size_t MAX_POOL_SIZE = TestableICULineBreakerPoolImpl::MAX_POOL_SIZE;
+    const size_t MAX_POOL_SIZE = ICULineBreakerPoolImpl::DEFAULT_MAX_POOL_SIZE;
     TestableICULineBreakerPoolImpl pool;
 
     const Locale enUS("en-Latn-US");
@@ -635,4 +733,62 @@ TEST(WordBreakerTest, LineBreakerPool_exceeds_pool_size) {
     }
 }
 
+TEST(WordBreakerTest, LineBreakerPool_bucketsByLocale) {
+    TestableICULineBreakerPoolImpl pool;
+
+    const Locale enUS("en-Latn-US");
+    const Locale jaJP("ja-JP-u-lb-strict");
+    const Locale jaJPLoose("ja-JP-u-lb-loose");
+
+    ICULineBreakerPool::Slot enUSBreaker = pool.acquire(enUS);
+    ICULineBreakerPool::Slot jaJPBreaker = pool.acquire(jaJP);
+    ICULineBreakerPool::Slot jaJPLooseBreaker = pool.acquire(jaJPLoose);
+    EXPECT_NE(jaJPBreaker.localeId, jaJPLooseBreaker.localeId);
+
+    UBreakIterator* enUSBreakerPtr = enUSBreaker.breaker.get();
+    UBreakIterator* jaJPBreakerPtr = jaJPBreaker.breaker.get();
+    UBreakIterator* jaJPLooseBreakerPtr = jaJPLooseBreaker.breaker.get();
+    pool.release(std::move(enUSBreaker));
+    pool.release(std::move(jaJPBreaker));
+    pool.release(std::move(jaJPLooseBreaker));
+    EXPECT_EQ(3U, pool.getPoolSize());
+
+    // Each breaker is returned for its own locale and line break style regardless of the release
+    // order.
+    const uint64_t hits = pool.getStats().hits();
+    EXPECT_EQ(jaJPLooseBreakerPtr, pool.acquire(jaJPLoose).breaker.get());
+    EXPECT_EQ(enUSBreakerPtr, pool.acquire(enUS).breaker.get());
+    EXPECT_EQ(jaJPBreakerPtr, pool.acquire(jaJP).breaker.get());
+    EXPECT_EQ(hits + 3, pool.getStats().hits());
+    EXPECT_EQ(0U, pool.getPoolSize());
+}
+
+TEST(WordBreakerTest, LineBreakerPool_setMaxPoolSize) {
+    TestableICULineBreakerPoolImpl pool;
+    const Locale enUS("en-Latn-US");
+
+    ICULineBreakerPoolImpl::setMaxPoolSize(1);
+    ICULineBreakerPool::Slot slot1 = pool.acquire(enUS);
+    ICULineBreakerPool::Slot slot2 = pool.acquire(enUS);
+    pool.release(std::move(slot1));
+    pool.release(std::move(slot2));
+    EXPECT_EQ(1U, pool.getPoolSize());
+    ICULineBreakerPoolImpl::setMaxPoolSize(ICULineBreakerPoolImpl::DEFAULT_MAX_POOL_SIZE);
+
+    ICULineBreakerPool::Slot slot3 = pool.acquire(enUS);
+    ICULineBreakerPool::Slot slot4 = pool.acquire(enUS);
+    pool.release(std::move(slot3));
+    pool.release(std::move(slot4));
+    EXPECT_EQ(2U, pool.getPoolSize());
+}
+
+TEST(WordBreakerTest, LineBreakerPool_perThread) {
+    ICULineBreakerPoolImpl* mainPool = &ICULineBreakerPoolImpl::getInstance();
+    ICULineBreakerPoolImpl* otherPool = nullptr;
+    std::thread thread([&otherPool]() { otherPool = &ICULineBreakerPoolImpl::getInstance(); });
+    thread.join();
+    EXPECT_NE(mainPool, otherPool);
+    EXPECT_EQ(mainPool, &ICULineBreakerPoolImpl::getInstance());
+}
+
 }  // namespace minikin
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HybUtils.h"
+
+#include <cstring>
+
+#include <cutils/log.h>
+
+namespace minikin {
+
+namespace {
+
+constexpr uint32_t kHeaderSize = 6 * sizeof(uint32_t);
+constexpr uint32_t kTrieHeaderSize = 6 * sizeof(uint32_t);
+constexpr uint32_t kCacheLineSize = 64;
+
+uint32_t readU32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void writeU32(uint8_t* p, uint32_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+}  // namespace
+
+std::vector<uint8_t> convertToTrieVersion1(const std::vector<uint8_t>& hyb) {
+    LOG_ALWAYS_FATAL_IF(hyb.size() < kHeaderSize);
+    const uint32_t alphabetOffset = readU32(hyb.data() + 2 * sizeof(uint32_t));
+    const uint32_t trieOffset = readU32(hyb.data() + 3 * sizeof(uint32_t));
+    const uint32_t patternOffset = readU32(hyb.data() + 4 * sizeof(uint32_t));
+    const uint32_t fileSize = readU32(hyb.data() + 5 * sizeof(uint32_t));
+    LOG_ALWAYS_FATAL_IF(fileSize > hyb.size() || alphabetOffset > trieOffset);
+
+    const uint8_t* trie = hyb.data() + trieOffset;
+    LOG_ALWAYS_FATAL_IF(readU32(trie) != 0, "Only version 0 trie table can be converted.");
+    const uint32_t charMask = readU32(trie + 1 * sizeof(uint32_t));
+    const uint32_t linkShift = readU32(trie + 2 * sizeof(uint32_t));
+    const uint32_t linkMask = readU32(trie + 3 * sizeof(uint32_t));
+    const uint32_t patternShift = readU32(trie + 4 * sizeof(uint32_t));
+    const uint32_t nEntries = readU32(trie + 5 * sizeof(uint32_t));
+    auto trieEntry = [&](uint32_t i) { return readU32(trie + kTrieHeaderSize + i * 4); };
+
+    // Pad the alphabet table so that the new trie data starts at a cache line boundary.
+    uint32_t newTrieOffset = trieOffset;
+    while ((newTrieOffset + kTrieHeaderSize) % kCacheLineSize != 0) {
+        newTrieOffset += sizeof(uint32_t);
+    }
+    const uint32_t newPatternOffset = newTrieOffset + kTrieHeaderSize + nEntries * 4;
+    const uint32_t patternSize = fileSize - patternOffset;
+    const uint32_t newFileSize = newPatternOffset + patternSize;
+
+    std::vector<uint8_t> result(newFileSize, 0);
+    memcpy(result.data(), hyb.data(), trieOffset);  // Header and alphabet table.
+    writeU32(result.data() + 3 * sizeof(uint32_t), newTrieOffset);
+    writeU32(result.data() + 4 * sizeof(uint32_t), newPatternOffset);
+    writeU32(result.data() + 5 * sizeof(uint32_t), newFileSize);
+
+    uint8_t* newTrie = result.data() + newTrieOffset;
+    writeU32(newTrie, 1);
+    writeU32(newTrie + 1 * sizeof(uint32_t), charMask);
+    writeU32(newTrie + 2 * sizeof(uint32_t), linkShift);
+    writeU32(newTrie + 3 * sizeof(uint32_t), linkMask);
+    writeU32(newTrie + 4 * sizeof(uint32_t), patternShift);
+    writeU32(newTrie + 5 * sizeof(uint32_t), nEntries);
+    for (uint32_t i = 0; i < nEntries; ++i) {
+        const uint32_t edge = trieEntry(i);
+        const uint32_t link = (edge & linkMask) >> linkShift;
+        const uint32_t linkPattern = link < nEntries ? trieEntry(link) >> patternShift : 0;
+        const uint32_t entry = (linkPattern << patternShift) | (edge & (linkMask | charMask));
+        writeU32(newTrie + kTrieHeaderSize + i * 4, entry);
+    }
+
+    memcpy(result.data() + newPatternOffset, hyb.data() + patternOffset, patternSize);
+    return result;
+}
+
+}  // namespace minikin
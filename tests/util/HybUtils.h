@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_TEST_HYB_UTILS_H
+#define MINIKIN_TEST_HYB_UTILS_H
+
+#include <cstdint>
+#include <vector>
+
+namespace minikin {
+
+// Converts a hyb file with a version 0 trie table into the equivalent file with a version 1 trie
+// table, the same as mk_hyb_file.py -t 1 would produce from the source patterns.
+std::vector<uint8_t> convertToTrieVersion1(const std::vector<uint8_t>& hyb);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_TEST_HYB_UTILS_H
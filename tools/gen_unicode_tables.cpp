@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Generates the Unicode property tables used by minikin, see libs/minikin/UnicodeProperties.h.
+// The tables are written to stdout as a C++ header, with the properties and the version of the
+// ICU the generator is linked with. The library only uses the tables if it runs with the same ICU
+// version, and falls back to the ICU calls otherwise.
+//
+// Usage: gen_unicode_tables > UnicodeTables.h
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include <unicode/uchar.h>
+#include <unicode/uversion.h>
+
+namespace {
+
+constexpr uint32_t CODE_POINT_COUNT = 0x110000;
+constexpr uint32_t BLOCK_SHIFT = 7;
+constexpr uint32_t BLOCK_SIZE = 1 << BLOCK_SHIFT;
+
+// The layout of the packed properties. Keep in sync with the constants written by main().
+constexpr uint16_t GCB_MASK = 0x1F;
+constexpr uint16_t EMOJI_BIT = 1 << 5;
+constexpr uint16_t EMOJI_MODIFIER_BIT = 1 << 6;
+constexpr uint16_t EMOJI_MODIFIER_BASE_BIT = 1 << 7;
+constexpr uint16_t EXTENDED_PICTOGRAPHIC_BIT = 1 << 8;
+constexpr uint16_t VIRAMA_BIT = 1 << 9;
+constexpr uint16_t OTHER_LETTER_BIT = 1 << 10;
+
+// Keep in sync with computeUnicodeProperties() in libs/minikin/UnicodeProperties.cpp.
+uint16_t getProperties(UChar32 c) {
+    uint16_t props = u_getIntPropertyValue(c, UCHAR_GRAPHEME_CLUSTER_BREAK);
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI)) props |= EMOJI_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER)) props |= EMOJI_MODIFIER_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EMOJI_MODIFIER_BASE)) props |= EMOJI_MODIFIER_BASE_BIT;
+    if (u_hasBinaryProperty(c, UCHAR_EXTENDED_PICTOGRAPHIC)) props |= EXTENDED_PICTOGRAPHIC_BIT;
+    if (u_getIntPropertyValue(c, UCHAR_CANONICAL_COMBINING_CLASS) == 9) props |= VIRAMA_BIT;
+    if (u_getIntPropertyValue(c, UCHAR_GENERAL_CATEGORY) == U_OTHER_LETTER) {
+        props |= OTHER_LETTER_BIT;
+    }
+    return props;
+}
+
+void printArray(const char* type, const char* name, const std::vector<uint32_t>& values) {
+    printf("constexpr %s %s[] = {", type, name);
+    for (size_t i = 0; i < values.size(); ++i) {
+        printf(i % 16 == 0 ? "\n        %u," : " %u,", values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+}  // namespace
+
+int main() {
+    // The distinct property values, the distinct blocks of value indices, and the block of each
+    // range of BLOCK_SIZE code points.
+    std::vector<uint32_t> values;
+    std::map<uint16_t, uint32_t> valueIndices;
+    std::vector<uint32_t> blocks;
+    std::map<std::vector<uint32_t>, uint32_t> blockIndices;
+    std::vector<uint32_t> blockIndex;
+    for (uint32_t blockStart = 0; blockStart < CODE_POINT_COUNT; blockStart += BLOCK_SIZE) {
+        std::vector<uint32_t> block;
+        for (uint32_t c = blockStart; c < blockStart + BLOCK_SIZE; ++c) {
+            const uint16_t props = getProperties(c);
+            auto it = valueIndices.emplace(props, values.size()).first;
+            if (it->second == values.size()) {
+                values.push_back(props);
+            }
+            block.push_back(it->second);
+        }
+        auto it = blockIndices.emplace(block, blockIndices.size()).first;
+        if (it->second == blocks.size() / BLOCK_SIZE) {
+            blocks.insert(blocks.end(), block.begin(), block.end());
+        }
+        blockIndex.push_back(it->second);
+    }
+    if (values.size() > 256 || blockIndices.size() > 256) {
+        fprintf(stderr, "The indices don't fit in uint8_t.\n");
+        return 1;
+    }
+
+    UVersionInfo icuVersion;
+    u_getVersion(icuVersion);
+    char icuVersionString[U_MAX_VERSION_STRING_LENGTH];
+    u_versionToString(icuVersion, icuVersionString);
+    printf("// This file is generated by tools/gen_unicode_tables.cpp with ICU %s. "
+           "Do not edit.\n\n",
+           icuVersionString);
+    printf("#ifndef MINIKIN_UNICODE_TABLES_H\n#define MINIKIN_UNICODE_TABLES_H\n\n");
+    printf("#include <cstdint>\n\n");
+    printf("namespace minikin {\nnamespace unicode_tables {\n\n");
+    printf("// The version of the ICU the tables are generated with, see u_getVersion().\n");
+    printf("constexpr uint8_t ICU_VERSION[] = {%u, %u, %u, %u};\n\n", icuVersion[0],
+           icuVersion[1], icuVersion[2], icuVersion[3]);
+    printf("constexpr uint32_t BLOCK_SHIFT = %u;\n", BLOCK_SHIFT);
+    printf("constexpr uint32_t BLOCK_MASK = %u;\n\n", BLOCK_SIZE - 1);
+    printf("constexpr uint16_t GCB_MASK = 0x%X;\n", GCB_MASK);
+    printf("constexpr uint16_t EMOJI_BIT = 0x%X;\n", EMOJI_BIT);
+    printf("constexpr uint16_t EMOJI_MODIFIER_BIT = 0x%X;\n", EMOJI_MODIFIER_BIT);
+    printf("constexpr uint16_t EMOJI_MODIFIER_BASE_BIT = 0x%X;\n", EMOJI_MODIFIER_BASE_BIT);
+    printf("constexpr uint16_t EXTENDED_PICTOGRAPHIC_BIT = 0x%X;\n", EXTENDED_PICTOGRAPHIC_BIT);
+    printf("constexpr uint16_t VIRAMA_BIT = 0x%X;\n", VIRAMA_BIT);
+    printf("constexpr uint16_t OTHER_LETTER_BIT = 0x%X;\n\n", OTHER_LETTER_BIT);
+    printArray("uint8_t", "kBlockIndex", blockIndex);
+    printArray("uint8_t", "kBlocks", blocks);
+    printArray("uint16_t", "kProperties", values);
+    printf("}  // namespace unicode_tables\n}  // namespace minikin\n\n");
+    printf("#endif  // MINIKIN_UNICODE_TABLES_H\n");
+    return 0;
+}
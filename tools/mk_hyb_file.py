@@ -18,9 +18,17 @@
 Convert hyphen files in standard TeX format (a trio of pat, chr, and hyp)
 into binary format. See doc/hyb_file_format.md for more information.
 
-Usage: mk_hyb_file.py [-v] hyph-foo.pat.txt hyph-foo.hyb
+Usage: mk_hyb_file.py [-v] [-s] [-l] [-t trie_version] [-c corpus.txt] hyph-foo.pat.txt hyph-foo.hyb
 
 Optional -v parameter turns on verbose debugging.
+Optional -t parameter selects the trie table version (0 or 1, default 0).
+Optional -c parameter gives a frequency corpus, with a word per line, optionally followed by a tab
+and the count of the word.
+Optional -l parameter orders the trie nodes by how often the hyphenation of the words of the
+corpus visits them, so that the hot prefixes get packed together at the start of the table.
+Optional -s parameter prints the size of the file and the estimated lookup cost, the average
+number of cache lines of the trie table touched to hyphenate a word of the corpus (or of the
+patterns if there is no corpus), and the number of cache lines serving 90% of the loads.
 
 """
 
@@ -35,6 +43,12 @@ import getopt
 
 VERBOSE = False
 
+# Size of a cache line. The version 1 trie data is aligned to this boundary.
+CACHE_LINE_SIZE = 64
+
+# Size of the trie table header, the same for both versions.
+TRIE_HEADER_SIZE = 6 * 4
+
 # U+00DF is LATIN SMALL LETTER SHARP S
 # U+1E9E is LATIN CAPITAL LETTER SHARP S
 SHARP_S_TO_DOUBLE = u'\u00dfSS'
@@ -301,6 +315,117 @@ def load_chr(fn):
     return ch_map
 
 
+# load the frequency corpus, a word per line with an optional tab separated count
+def load_corpus(fn):
+    words = {}
+    with io.open(fn, encoding='UTF-8') as f:
+        for l in f:
+            fields = l.strip().split('\t')
+            if not fields[0]:
+                continue
+            count = int(fields[1]) if len(fields) > 1 else 1
+            words[fields[0]] = words.get(fields[0], 0) + count
+    return words
+
+
+# return the words of the patterns, to estimate the lookup cost when there is no corpus
+def pattern_words(hyph):
+    words = {}
+    for node in hyph.node_list:
+        if node.res is not None:
+            word = node.str.strip('.')
+            if word:
+                words[word] = words.get(word, 0) + 1
+    return words
+
+
+# return the alphabet codes of the word padded with '.' like Hyphenator::alphabetLookup does, or
+# None if a character is not in the alphabet
+def word_codes(word, ch_map):
+    codes = [0]
+    for c in word:
+        if c not in ch_map:
+            return None
+        codes.append(ch_map[c])
+    codes.append(0)
+    return codes
+
+
+# call visit(node, code) for each edge of the original trie the hyphenation of the codes looks
+# up, including the missing ones ending the walks, and visit(node, None) for each node it moves to
+def walk_trie(hyph, codes, visit):
+    for i in range(len(codes) - 1):
+        node = hyph.root
+        for c in codes[i:]:
+            visit(node, c)
+            node = node.code_succ.get(c)
+            if node is None:
+                break
+            visit(node, None)
+
+
+def index_edges(hyph, ch_map):
+    for node in hyph.node_list:
+        node.code_succ = {ch_map[c]: next for c, next in node.succ.items()}
+
+
+# order the unique nodes by decreasing visit count of the corpus, keeping the root first and the
+# unvisited nodes in their original order
+def order_nodes_by_frequency(hyph, ch_map, dedup_ix, dedup_nodes, corpus):
+    index_edges(hyph, ch_map)
+    counts = {}
+
+    def visit(node, c):
+        unique = hyph.bfs_order[dedup_ix[node.bfs_ix]]
+        counts[id(unique)] = counts.get(id(unique), 0) + count
+
+    for word, count in corpus.items():
+        codes = word_codes(word, ch_map)
+        if codes is not None:
+            walk_trie(hyph, codes, visit)
+    position = {id(node): i for i, node in enumerate(dedup_nodes)}
+    rest = sorted(dedup_nodes[1:], key=lambda n: (-counts.get(id(n), 0), position[id(n)]))
+    return [dedup_nodes[0]] + rest
+
+
+# estimate the average number of cache lines of the trie table touched to hyphenate a word, and
+# the number of cache lines serving 90% of the loads, assumes hyph structure has been packed
+def estimate_lookup_cost(hyph, ch_map, dedup_ix, corpus, trie_data_off, trie_version):
+    index_edges(hyph, ch_map)
+    total_lines = 0
+    total_words = 0
+    line_loads = {}
+    for word, count in corpus.items():
+        codes = word_codes(word, ch_map)
+        if codes is None:
+            continue
+        lines = set()
+
+        def visit(node, c):
+            entry = hyph.bfs_order[dedup_ix[node.bfs_ix]].ix
+            if c is not None:
+                entry += c
+            elif trie_version == 1:
+                # version 1 reads the pattern of the node with the edge
+                return
+            line = (trie_data_off + entry * 4) // CACHE_LINE_SIZE
+            lines.add(line)
+            line_loads[line] = line_loads.get(line, 0) + count
+
+        walk_trie(hyph, codes, visit)
+        total_lines += len(lines) * count
+        total_words += count
+    all_loads = sum(line_loads.values())
+    hot_lines = 0
+    hot_loads = 0
+    for loads in sorted(line_loads.values(), reverse=True):
+        if hot_loads >= 0.9 * all_loads:
+            break
+        hot_loads += loads
+        hot_lines += 1
+    return (total_lines / float(total_words) if total_words else 0.0), hot_lines
+
+
 # load exceptions with explicit hyphens
 def load_hyp(hyph, fn):
     with io.open(fn, encoding='UTF-8') as f:
@@ -344,7 +469,7 @@ def generate_alphabet(ch_map):
 
 
 # assumes hyph structure has been packed, ie node.ix values have been set
-def generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap):
+def generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap, trie_version=0):
     ch_array = [0] * n_trie
     link_array = [0] * n_trie
     pat_array = [0] * n_trie
@@ -352,7 +477,8 @@ def generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap):
     char_mask = (1 << link_shift) - 1
     pattern_shift = link_shift + num_bits(n_trie - 1)
     link_mask = (1 << pattern_shift) - (1 << link_shift)
-    result = [struct.pack('<6I', 0, char_mask, link_shift, link_mask, pattern_shift, n_trie)]
+    result = [struct.pack('<6I', trie_version, char_mask, link_shift, link_mask, pattern_shift,
+                          n_trie)]
 
     for node in dedup_nodes:
         ix = node.ix
@@ -370,7 +496,13 @@ def generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap):
 
     for i in range(n_trie):
         #print((pat_array[i], link_array[i], ch_array[i]))
-        packed = (pat_array[i] << pattern_shift) | (link_array[i] << link_shift) | ch_array[i]
+        if trie_version == 1:
+            # Store the pattern of the destination node instead of the one of the node at i, so
+            # that following an edge and reading the pattern of the new node is a single load.
+            pat = pat_array[link_array[i]]
+        else:
+            pat = pat_array[i]
+        packed = (pat << pattern_shift) | (link_array[i] << link_shift) | ch_array[i]
         result.append(struct.pack('<I', packed))
     return b''.join(result)
 
@@ -407,13 +539,20 @@ def generate_pattern(pats):
     return patmap, b''.join(result)
 
 
-def generate_hyb_file(hyph, ch_map, hyb_fn):
+def generate_hyb_file(hyph, ch_map, hyb_fn, trie_version=0, corpus=None, locality=False,
+                      stats=False):
     bfs = hyph.bfs(ch_map)
     dedup_ix, dedup_nodes = hyph.dedup()
+    if locality:
+        dedup_nodes = order_nodes_by_frequency(hyph, ch_map, dedup_ix, dedup_nodes, corpus)
     n_trie = hyph.pack(dedup_nodes, ch_map)
     alphabet = generate_alphabet(ch_map)
+    if trie_version == 1:
+        # pad the alphabet so that the trie data starts at a cache line boundary
+        trie_data_off = 6 * 4 + len(alphabet) + TRIE_HEADER_SIZE
+        alphabet += b'\x00' * ((CACHE_LINE_SIZE - trie_data_off % CACHE_LINE_SIZE) % CACHE_LINE_SIZE)
     patmap, pattern = generate_pattern([n.res for n in hyph.node_list])
-    trie = generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap)
+    trie = generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap, trie_version)
     header = generate_header(alphabet, trie, pattern)
 
     with open(hyb_fn, 'wb') as f:
@@ -422,6 +561,16 @@ def generate_hyb_file(hyph, ch_map, hyb_fn):
         f.write(trie)
         f.write(pattern)
 
+    if stats:
+        trie_data_off = 6 * 4 + len(alphabet) + TRIE_HEADER_SIZE
+        cost, hot_lines = estimate_lookup_cost(hyph, ch_map, dedup_ix,
+                                    corpus if corpus is not None else pattern_words(hyph),
+                                    trie_data_off, trie_version)
+        file_size = len(header) + len(alphabet) + len(trie) + len(pattern)
+        print('%s: %d bytes, trie %d bytes (%d entries), %.2f cache lines per word, '
+              '%d cache lines for 90%% of the loads' %
+              (hyb_fn, file_size, len(trie), n_trie, cost, hot_lines))
+
 
 # Verify that the file contains the same lines as the lines argument, in arbitrary order
 def verify_file_sorted(lines, fn):
@@ -466,10 +615,16 @@ def get_pattern(pattern_data, ix):
     return pattern_data[offset: offset + pat_len] + b'\0' * pat_shift
 
 
-def traverse_trie(ix, s, trie_data, ch_map, pattern_data, patterns, exceptions):
+def get_trie_entry(trie_data, ix):
+    offset = TRIE_HEADER_SIZE + ix * 4
+    return struct.unpack('<I', trie_data[offset: offset + 4])[0]
+
+
+def traverse_trie(ix, s, trie_data, ch_map, pattern_data, patterns, exceptions, pattern=None):
     (char_mask, link_shift, link_mask, pattern_shift) = struct.unpack('<4I', trie_data[4:20])
-    node_entry = struct.unpack('<I', trie_data[24 + ix * 4: 24 + ix * 4 + 4])[0]
-    pattern = node_entry >> pattern_shift
+    if pattern is None:
+        # version 0 stores the pattern in the node slot, version 1 in the incoming edge
+        pattern = get_trie_entry(trie_data, ix) >> pattern_shift
     if pattern:
         result = []
         is_exception = False
@@ -499,12 +654,15 @@ def traverse_trie(ix, s, trie_data, ch_map, pattern_data, patterns, exceptions):
             exceptions.append(pat_str[1:-1])  # strip leading and trailing '.'
         else:
             patterns.append(pat_str)
+    trie_version = struct.unpack('<I', trie_data[:4])[0]
     for ch in ch_map:
-        edge_entry = struct.unpack('<I', trie_data[24 + (ix + ch) * 4: 24 + (ix + ch) * 4 + 4])[0]
+        edge_entry = get_trie_entry(trie_data, ix + ch)
         link = (edge_entry & link_mask) >> link_shift
         if link != 0 and ch == (edge_entry & char_mask):
             sch = s + ch_map[ch]
-            traverse_trie(link, sch, trie_data, ch_map, pattern_data, patterns, exceptions)
+            link_pattern = (edge_entry >> pattern_shift) if trie_version == 1 else None
+            traverse_trie(link, sch, trie_data, ch_map, pattern_data, patterns, exceptions,
+                          link_pattern)
 
 
 # Verify the generated binary file by reconstructing the textual representations
@@ -564,13 +722,27 @@ def verify_hyb_file(hyb_fn, pat_fn, chr_fn, hyp_fn):
 def main():
     global VERBOSE
     try:
-        opts, args = getopt.getopt(sys.argv[1:], 'v')
+        opts, args = getopt.getopt(sys.argv[1:], 'vslt:c:')
     except getopt.GetoptError as err:
         print(str(err))
         sys.exit(1)
-    for o, _ in opts:
+    trie_version = 0
+    corpus = None
+    locality = False
+    stats = False
+    for o, a in opts:
         if o == '-v':
             VERBOSE = True
+        elif o == '-s':
+            stats = True
+        elif o == '-l':
+            locality = True
+        elif o == '-c':
+            corpus = load_corpus(a)
+        elif o == '-t':
+            trie_version = int(a)
+            assert trie_version in (0, 1), 'unsupported trie version'
+    assert corpus is not None or not locality, 'the node ordering needs a corpus'
     pat_fn, out_fn = args
     hyph = load(pat_fn)
     if pat_fn.endswith('.pat.txt'):
@@ -578,7 +750,7 @@ def main():
         ch_map = load_chr(chr_fn)
         hyp_fn = pat_fn[:-8] + '.hyp.txt'
         load_hyp(hyph, hyp_fn)
-        generate_hyb_file(hyph, ch_map, out_fn)
+        generate_hyb_file(hyph, ch_map, out_fn, trie_version, corpus, locality, stats)
         verify_hyb_file(out_fn, pat_fn, chr_fn, hyp_fn)
 
 if __name__ == '__main__':